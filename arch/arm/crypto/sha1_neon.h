@@ -0,0 +1,14 @@
+#ifndef __SHA1_NEON_H__
+#define __SHA1_NEON_H__
+
+/*
+ * NEON SHA-1 block function. It lives in its own compilation unit
+ * (built with -mfpu=neon) and must only be called between
+ * kernel_neon_begin() and kernel_neon_end().
+ *
+ * Hashes 'blocks' consecutive 64-byte blocks from 'data' into 'state'.
+ */
+void sha1_neon_transform(unsigned int state[5], const unsigned char *data,
+			 unsigned int blocks);
+
+#endif /* __SHA1_NEON_H__ */
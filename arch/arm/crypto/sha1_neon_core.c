@@ -0,0 +1,135 @@
+/*
+ * SHA-1 block function using NEON for the message schedule.
+ *
+ * The A8 pays a long stall for every NEON to ARM register move, so the
+ * 80 W[t] + K values are expanded four at a time in NEON registers and
+ * stored to the stack, and the rounds themselves run on the ARM side
+ * reading them back with plain loads.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include "sha1_neon.h"
+
+#undef __STDC_HOSTED__
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+#define K1	0x5a827999
+#define K2	0x6ed9eba1
+#define K3	0x8f1bbcdc
+#define K4	0xca62c1d6
+
+#define rol32(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static inline uint32x4_t vrol1q_u32(uint32x4_t x)
+{
+	return vsriq_n_u32(vshlq_n_u32(x, 1), x, 31);
+}
+
+/*
+ * W[t..t+3] = rol1(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16])
+ *
+ * W[t+3] depends on W[t], which is only known once the first lane is
+ * done: compute lane 3 with W[t-3+3] taken as 0, then fold in rol1(W[t]),
+ * which is the same as rotating after the XOR.
+ */
+static inline uint32x4_t sha1_expand(uint32x4_t w16, uint32x4_t w12,
+				     uint32x4_t w8, uint32x4_t w4)
+{
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t t, r;
+
+	t = veorq_u32(w16, vextq_u32(w16, w12, 2));	/* t-16, t-14 */
+	t = veorq_u32(t, w8);				/* t-8 */
+	t = veorq_u32(t, vextq_u32(w4, zero, 1));	/* t-3, lane 3 = 0 */
+	r = vrol1q_u32(t);
+
+	return veorq_u32(r, vrol1q_u32(vextq_u32(zero, r, 1)));
+}
+
+#define F1(b, c, d)	((((c) ^ (d)) & (b)) ^ (d))
+#define F2(b, c, d)	((b) ^ (c) ^ (d))
+#define F3(b, c, d)	(((b) & (c)) | (((b) | (c)) & (d)))
+
+#define ROUND(f, a, b, c, d, e, wk)				\
+	do {							\
+		e += rol32(a, 5) + f(b, c, d) + (wk);		\
+		b = rol32(b, 30);				\
+	} while (0)
+
+#define ROUND5(f, i)						\
+	do {							\
+		ROUND(f, a, b, c, d, e, wk[(i) + 0]);		\
+		ROUND(f, e, a, b, c, d, wk[(i) + 1]);		\
+		ROUND(f, d, e, a, b, c, wk[(i) + 2]);		\
+		ROUND(f, c, d, e, a, b, wk[(i) + 3]);		\
+		ROUND(f, b, c, d, e, a, wk[(i) + 4]);		\
+	} while (0)
+
+void sha1_neon_transform(unsigned int state[5], const unsigned char *data,
+			 unsigned int blocks)
+{
+	uint32_t wk[80] __attribute__((aligned(16)));
+	uint32x4_t w[4], k;
+	uint32_t a, b, c, d, e;
+	int i;
+
+	while (blocks--) {
+		/* Big endian message words */
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(data + 16 * i)));
+		data += 64;
+
+		k = vdupq_n_u32(K1);
+		for (i = 0; i < 4; i++)
+			vst1q_u32(&wk[4 * i], vaddq_u32(w[i], k));
+
+		/* w[] is a ring of the last 16 words, oldest first */
+		for (i = 4; i < 20; i++) {
+			uint32x4_t n = sha1_expand(w[i & 3], w[(i + 1) & 3],
+						   w[(i + 2) & 3],
+						   w[(i + 3) & 3]);
+
+			w[i & 3] = n;
+			if (i == 5)
+				k = vdupq_n_u32(K2);
+			else if (i == 10)
+				k = vdupq_n_u32(K3);
+			else if (i == 15)
+				k = vdupq_n_u32(K4);
+			vst1q_u32(&wk[4 * i], vaddq_u32(n, k));
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		for (i = 0; i < 20; i += 5)
+			ROUND5(F1, i);
+		for (; i < 40; i += 5)
+			ROUND5(F2, i);
+		for (; i < 60; i += 5)
+			ROUND5(F3, i);
+		for (; i < 80; i += 5)
+			ROUND5(F2, i);
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+
+	/* Don't leave message schedule behind on the stack */
+	for (i = 0; i < 80; i += 4)
+		vst1q_u32(&wk[i], vdupq_n_u32(0));
+	__asm__ __volatile__("" : : "r" (wk) : "memory");
+}
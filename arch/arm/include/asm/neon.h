@@ -7,11 +7,21 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
 
+#include <linux/hardirq.h>
 #include <asm/hwcap.h>
 
 #define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
 
+/*
+ * Whether kernel_neon_begin() may be called from here. Callers that can
+ * run in interrupt context must check this and fall back to plain ARM
+ * code when it is false.
+ */
+#define kernel_neon_usable()	(cpu_has_neon() && !in_interrupt())
+
 #ifdef __ARM_NEON__
 
 /*
@@ -33,4 +43,6 @@
 #else
 void kernel_neon_begin(void);
 #endif
-void kernel_neon_end(void);
\ No newline at end of file
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
\ No newline at end of file
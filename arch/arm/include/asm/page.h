@@ -150,6 +150,12 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
 extern void copy_page(void *to, const void *from);
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void __copy_page_neon(void *to, const void *from);
+extern void copy_page_neon(void *to, const void *from);
+#else
+#define copy_page_neon(to, from)	copy_page(to, from)
+#endif
 
 #undef STRICT_MM_TYPECHECKS
 
@@ -26,6 +26,21 @@ extern void * memset(void *, int, __kernel_size_t);
 
 extern void __memzero(void *ptr, __kernel_size_t n);
 
+/*
+ * NEON variants for large buffers, only worth it from process context.
+ * They fall back to memcpy()/memset() when the buffer is small or NEON
+ * can't be used here.
+ */
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void *__memcpy_neon(void *, const void *, __kernel_size_t);
+extern void *__memset_neon(void *, int, __kernel_size_t);
+extern void *memcpy_neon(void *, const void *, __kernel_size_t);
+extern void *memset_neon(void *, int, __kernel_size_t);
+#else
+#define memcpy_neon(d, s, n)	memcpy(d, s, n)
+#define memset_neon(p, v, n)	memset(p, v, n)
+#endif
+
 #define memset(p,v,n)							\
 	({								\
 	 	void *__p = (p); size_t __n = n;			\
@@ -0,0 +1,14 @@
+#ifndef __ASM_ARM_SUSPEND_H
+#define __ASM_ARM_SUSPEND_H
+
+/* stack swsusp_arch_resume() runs on while the image is copied back */
+#define HIBERNATE_STACK_SIZE	2048
+
+#ifndef __ASSEMBLY__
+static inline int arch_prepare_suspend(void)
+{
+	return 0;
+}
+#endif
+
+#endif
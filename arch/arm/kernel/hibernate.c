@@ -0,0 +1,60 @@
+/*
+ * Hibernation support for ARMv7 uniprocessors.
+ *
+ * The image is always restored by the same kernel binary that wrote it,
+ * so putting the pages of the image back where they were and loading
+ * the CPU state saved by swsusp_arch_suspend() is all it takes, see
+ * hibernate_asm.S.
+ */
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/suspend.h>
+#include <linux/cpumask.h>
+#include <asm/cacheflush.h>
+#include <asm/mmu_context.h>
+#include <asm/tlbflush.h>
+#include <asm/suspend.h>
+
+extern const void __nosave_begin, __nosave_end;
+extern struct pbe *restore_pblist;
+
+u8 hibernate_resume_stack[HIBERNATE_STACK_SIZE] __nosavedata __aligned(8);
+
+int pfn_is_nosave(unsigned long pfn)
+{
+	unsigned long nosave_begin_pfn = __pa(&__nosave_begin) >> PAGE_SHIFT;
+	unsigned long nosave_end_pfn = PAGE_ALIGN(__pa(&__nosave_end)) >> PAGE_SHIFT;
+
+	return (pfn >= nosave_begin_pfn) && (pfn < nosave_end_pfn);
+}
+
+void notrace save_processor_state(void)
+{
+	WARN_ON(num_online_cpus() != 1);
+	local_fiq_disable();
+}
+
+void notrace restore_processor_state(void)
+{
+	local_fiq_enable();
+}
+
+/*
+ * Called by swsusp_arch_resume() on hibernate_resume_stack, with
+ * interrupts off.  The page tables of the current task may be
+ * overwritten by the copy, so run on swapper_pg_dir: the image has the
+ * same linear mapping in it, which is all the copy loop needs.
+ */
+void notrace hibernate_copy_image(void)
+{
+	struct pbe *pbe;
+
+	cpu_switch_mm(init_mm.pgd, &init_mm);
+	local_flush_tlb_all();
+
+	for (pbe = restore_pblist; pbe; pbe = pbe->next)
+		copy_page(pbe->orig_address, pbe->address);
+
+	/* the restored text has to be fetched from memory */
+	flush_cache_all();
+}
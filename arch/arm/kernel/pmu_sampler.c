@@ -0,0 +1,399 @@
+/*
+ * linux/arch/arm/kernel/pmu_sampler.c
+ *
+ * Low rate, always available PMU sampling profiler.
+ *
+ * A cycle counter and a cache miss counter are run as kernel perf
+ * events on the boot CPU.  Each overflow stores the interrupted task,
+ * which counter fired and a short kernel + user call chain into a
+ * fixed size ring buffer allocated once at boot, so a production
+ * kernel can be profiled without the perf tool or a debug build.
+ *
+ * Everything is controlled from debugfs, pmu_sampler/:
+ *   enable         write 1/0 to start/stop sampling
+ *   cycles_period  cycles between samples (0 disables the counter)
+ *   misses_period  cache misses between samples (0 disables the counter)
+ *   samples        one line per sample, oldest first:
+ *                  <ns> <pid> <tgid> <c|m> <ip> <caller> ...
+ *                  kernel frames first, then "u" and the user frames
+ *   stats          sample, overwrite and error counts; writing clears
+ *                  the buffer and the counts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/perf_event.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+
+#define PMU_SAMPLER_DEPTH	16
+
+enum {
+	PMU_SAMPLER_CYCLES,
+	PMU_SAMPLER_MISSES,
+	PMU_SAMPLER_EVENTS,
+};
+
+struct pmu_sample {
+	u64	time;
+	pid_t	pid;
+	pid_t	tgid;
+	u8	event;
+	u8	nr_kernel;
+	u8	nr_user;
+	u32	ip[PMU_SAMPLER_DEPTH];
+};
+
+static unsigned int buf_kb = 128;
+module_param(buf_kb, uint, S_IRUGO);
+MODULE_PARM_DESC(buf_kb, "Sample buffer size in KiB, allocated at boot");
+
+static int enable;
+module_param(enable, bool, S_IRUGO);
+MODULE_PARM_DESC(enable, "Start sampling at boot");
+
+/* About 100 Hz at the 800 MHz the i.MX50 normally runs at */
+static u64 cycles_period = 8000000;
+static u64 misses_period = 20000;
+
+static DEFINE_MUTEX(sampler_mutex);
+static DEFINE_SPINLOCK(sampler_lock);
+static struct perf_event *sampler_event[PMU_SAMPLER_EVENTS];
+static bool sampler_running;
+
+static struct pmu_sample *ring;
+static unsigned int ring_size;		/* in samples */
+static unsigned int ring_head;		/* next slot to write */
+static unsigned int ring_count;		/* valid samples */
+static u32 nr_samples, nr_overwritten, nr_errors;
+
+static void pmu_sampler_overflow(struct perf_event *event, int nmi,
+				 struct perf_sample_data *data,
+				 struct pt_regs *regs)
+{
+	struct perf_callchain_entry *chain;
+	struct pmu_sample *s;
+	unsigned long flags;
+	int user = 0;
+	u64 i;
+
+	chain = perf_callchain(regs);
+
+	spin_lock_irqsave(&sampler_lock, flags);
+	s = &ring[ring_head];
+	if (++ring_head == ring_size)
+		ring_head = 0;
+	if (ring_count == ring_size)
+		nr_overwritten++;
+	else
+		ring_count++;
+	nr_samples++;
+
+	s->time = sched_clock();
+	s->pid = current->pid;
+	s->tgid = current->tgid;
+	s->event = event == sampler_event[PMU_SAMPLER_MISSES] ?
+		PMU_SAMPLER_MISSES : PMU_SAMPLER_CYCLES;
+	s->nr_kernel = s->nr_user = 0;
+
+	/*
+	 * The chain is PERF_CONTEXT_KERNEL pc lr... when a kernel context
+	 * was interrupted, followed by PERF_CONTEXT_USER and the return
+	 * addresses found through the user frame pointers; the user pc
+	 * itself is not part of it.
+	 */
+	if (user_mode(regs))
+		s->ip[s->nr_user++] = instruction_pointer(regs);
+
+	for (i = 0; i < chain->nr; i++) {
+		u64 ip = chain->ip[i];
+
+		if (ip == PERF_CONTEXT_KERNEL)
+			continue;
+		if (ip == PERF_CONTEXT_USER) {
+			user = 1;
+			continue;
+		}
+		if (s->nr_kernel + s->nr_user == PMU_SAMPLER_DEPTH)
+			break;
+		if (user)
+			s->ip[s->nr_kernel + s->nr_user++] = ip;
+		else
+			s->ip[s->nr_kernel++] = ip;
+	}
+	spin_unlock_irqrestore(&sampler_lock, flags);
+}
+
+static struct perf_event *pmu_sampler_create(u64 config, u64 period)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.config		= config,
+		.size		= sizeof(attr),
+		.sample_period	= period,
+		.pinned		= 1,
+	};
+
+	return perf_event_create_kernel_counter(&attr, 0, -1,
+						pmu_sampler_overflow);
+}
+
+/* Called with sampler_mutex held */
+static void pmu_sampler_stop(void)
+{
+	int i;
+
+	for (i = 0; i < PMU_SAMPLER_EVENTS; i++) {
+		if (sampler_event[i]) {
+			perf_event_release_kernel(sampler_event[i]);
+			sampler_event[i] = NULL;
+		}
+	}
+	sampler_running = false;
+}
+
+/* Called with sampler_mutex held */
+static int pmu_sampler_start(void)
+{
+	static const u64 config[PMU_SAMPLER_EVENTS] = {
+		[PMU_SAMPLER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+		[PMU_SAMPLER_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+	};
+	u64 period[PMU_SAMPLER_EVENTS] = {
+		[PMU_SAMPLER_CYCLES] = cycles_period,
+		[PMU_SAMPLER_MISSES] = misses_period,
+	};
+	struct perf_event *event;
+	int i;
+
+	if (!ring)
+		return -ENOMEM;
+	if (sampler_running)
+		return 0;
+
+	for (i = 0; i < PMU_SAMPLER_EVENTS; i++) {
+		if (!period[i])
+			continue;
+		event = pmu_sampler_create(config[i], period[i]);
+		if (IS_ERR(event)) {
+			pr_err("pmu_sampler: can't create counter %d: %ld\n",
+			       i, PTR_ERR(event));
+			nr_errors++;
+			pmu_sampler_stop();
+			return PTR_ERR(event);
+		}
+		sampler_event[i] = event;
+	}
+	sampler_running = true;
+	return 0;
+}
+
+static ssize_t enable_read(struct file *file, char __user *ubuf,
+			   size_t count, loff_t *ppos)
+{
+	char buf[3] = { sampler_running ? '1' : '0', '\n', 0 };
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, 2);
+}
+
+static ssize_t enable_write(struct file *file, const char __user *ubuf,
+			    size_t count, loff_t *ppos)
+{
+	char buf[8];
+	size_t len = min(count, sizeof(buf) - 1);
+	unsigned long val;
+	int ret = 0;
+
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = 0;
+	if (strict_strtoul(strstrip(buf), 0, &val))
+		return -EINVAL;
+
+	mutex_lock(&sampler_mutex);
+	if (val)
+		ret = pmu_sampler_start();
+	else
+		pmu_sampler_stop();
+	mutex_unlock(&sampler_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations enable_fops = {
+	.read		= enable_read,
+	.write		= enable_write,
+};
+
+/*
+ * samples: take a copy of the ring on open so that reading a large
+ * buffer out does not hold off the sampling interrupt.
+ */
+struct sampler_snapshot {
+	unsigned int count;
+	struct pmu_sample s[0];
+};
+
+static void *samples_start(struct seq_file *m, loff_t *pos)
+{
+	struct sampler_snapshot *snap = m->private;
+
+	return *pos < snap->count ? &snap->s[*pos] : NULL;
+}
+
+static void *samples_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return samples_start(m, pos);
+}
+
+static void samples_stop(struct seq_file *m, void *v)
+{
+}
+
+static int samples_show(struct seq_file *m, void *v)
+{
+	struct pmu_sample *s = v;
+	int i;
+
+	seq_printf(m, "%llu %d %d %c", s->time, s->pid, s->tgid,
+		   s->event == PMU_SAMPLER_MISSES ? 'm' : 'c');
+	for (i = 0; i < s->nr_kernel; i++)
+		seq_printf(m, " %08x", s->ip[i]);
+	if (s->nr_user) {
+		seq_puts(m, " u");
+		for (; i < s->nr_kernel + s->nr_user; i++)
+			seq_printf(m, " %08x", s->ip[i]);
+	}
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static const struct seq_operations samples_seq_ops = {
+	.start	= samples_start,
+	.next	= samples_next,
+	.stop	= samples_stop,
+	.show	= samples_show,
+};
+
+static int samples_open(struct inode *inode, struct file *file)
+{
+	struct sampler_snapshot *snap;
+	unsigned int first, n;
+	unsigned long flags;
+	int ret;
+
+	snap = vmalloc(sizeof(*snap) + ring_size * sizeof(struct pmu_sample));
+	if (!snap)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&sampler_lock, flags);
+	snap->count = ring_count;
+	first = (ring_head + ring_size - ring_count) % ring_size;
+	n = min(ring_count, ring_size - first);
+	memcpy(snap->s, &ring[first], n * sizeof(struct pmu_sample));
+	memcpy(&snap->s[n], ring, (ring_count - n) * sizeof(struct pmu_sample));
+	spin_unlock_irqrestore(&sampler_lock, flags);
+
+	ret = seq_open(file, &samples_seq_ops);
+	if (ret) {
+		vfree(snap);
+		return ret;
+	}
+	((struct seq_file *)file->private_data)->private = snap;
+	return 0;
+}
+
+static int samples_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	vfree(m->private);
+	return seq_release(inode, file);
+}
+
+static const struct file_operations samples_fops = {
+	.open		= samples_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= samples_release,
+};
+
+static int stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "running:     %d\n", sampler_running);
+	seq_printf(m, "buffer:      %u/%u\n", ring_count, ring_size);
+	seq_printf(m, "samples:     %u\n", nr_samples);
+	seq_printf(m, "overwritten: %u\n", nr_overwritten);
+	seq_printf(m, "errors:      %u\n", nr_errors);
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, NULL);
+}
+
+static ssize_t stats_write(struct file *file, const char __user *ubuf,
+			   size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&sampler_lock, flags);
+	ring_head = ring_count = 0;
+	nr_samples = nr_overwritten = nr_errors = 0;
+	spin_unlock_irqrestore(&sampler_lock, flags);
+	return count;
+}
+
+static const struct file_operations stats_fops = {
+	.open		= stats_open,
+	.read		= seq_read,
+	.write		= stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init pmu_sampler_init(void)
+{
+	struct dentry *dir;
+
+	ring_size = buf_kb * 1024 / sizeof(struct pmu_sample);
+	if (!ring_size)
+		return 0;
+	ring = vmalloc(ring_size * sizeof(struct pmu_sample));
+	if (!ring) {
+		pr_err("pmu_sampler: can't allocate %u KiB buffer\n", buf_kb);
+		return -ENOMEM;
+	}
+
+	dir = debugfs_create_dir("pmu_sampler", NULL);
+	if (dir) {
+		debugfs_create_file("enable", 0644, dir, NULL, &enable_fops);
+		debugfs_create_u64("cycles_period", 0644, dir, &cycles_period);
+		debugfs_create_u64("misses_period", 0644, dir, &misses_period);
+		debugfs_create_file("samples", 0444, dir, NULL, &samples_fops);
+		debugfs_create_file("stats", 0644, dir, NULL, &stats_fops);
+	}
+
+	if (enable) {
+		mutex_lock(&sampler_mutex);
+		pmu_sampler_start();
+		mutex_unlock(&sampler_mutex);
+	}
+	return 0;
+}
+late_initcall(pmu_sampler_init);
@@ -0,0 +1,95 @@
+/*
+ *  linux/arch/arm/lib/neon_string.c
+ *
+ *  Size dispatch for the NEON string functions.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NEON moves 64 bytes per loop iteration and keeps the A8 load/store
+ * pipeline busier than LDM/STM, but it can only be used from process
+ * context between kernel_neon_begin() and kernel_neon_end(). The first
+ * kernel_neon_begin() after a task used VFP saves that state, which costs
+ * about as much as copying a few hundred bytes, so small calls and calls
+ * from interrupt context keep using the ARM versions.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+#include <asm/sizes.h>
+
+/* Don't keep preemption disabled longer than it takes to move this */
+#define NEON_STRING_CHUNK	SZ_64K
+
+/* Smallest memcpy/memset done with NEON, 0 disables them */
+static unsigned int neon_string_threshold = 512;
+module_param_named(threshold, neon_string_threshold, uint, 0644);
+
+/* Use NEON for copy_page() */
+static int neon_string_copy_page = 1;
+module_param_named(copy_page, neon_string_copy_page, bool, 0644);
+
+static inline bool neon_string_usable(size_t n)
+{
+	return neon_string_threshold && n >= neon_string_threshold &&
+		kernel_neon_usable();
+}
+
+void *memcpy_neon(void *dst, const void *src, size_t n)
+{
+	char *d = dst;
+	const char *s = src;
+	size_t chunk;
+
+	if (!neon_string_usable(n))
+		return memcpy(dst, src, n);
+
+	while (n) {
+		chunk = min_t(size_t, n, NEON_STRING_CHUNK);
+		kernel_neon_begin();
+		__memcpy_neon(d, s, chunk);
+		kernel_neon_end();
+		d += chunk;
+		s += chunk;
+		n -= chunk;
+	}
+	return dst;
+}
+EXPORT_SYMBOL(memcpy_neon);
+
+void *memset_neon(void *dst, int c, size_t n)
+{
+	char *d = dst;
+	size_t chunk;
+
+	if (!neon_string_usable(n))
+		return memset(dst, c, n);
+
+	while (n) {
+		chunk = min_t(size_t, n, NEON_STRING_CHUNK);
+		kernel_neon_begin();
+		__memset_neon(d, c, chunk);
+		kernel_neon_end();
+		d += chunk;
+		n -= chunk;
+	}
+	return dst;
+}
+EXPORT_SYMBOL(memset_neon);
+
+void copy_page_neon(void *to, const void *from)
+{
+	if (!neon_string_copy_page || !kernel_neon_usable()) {
+		copy_page(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(copy_page_neon);
@@ -0,0 +1,117 @@
+/*
+ *  linux/arch/arm/lib/neon_string_bench.c
+ *
+ *  Compare memcpy, memset and copy_page with their NEON variants.
+ *  Loading the module prints the throughput for each size to the log.
+ *  The init then returns an error so nothing stays loaded and the
+ *  benchmark can simply be run again.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/gfp.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <asm/page.h>
+
+/* Bytes moved per measurement */
+static unsigned int total = 8 << 20;
+module_param(total, uint, 0444);
+
+static const size_t bench_sizes[] = {
+	64, 256, 512, 1024, 4096, 16384, 65536, 262144,
+};
+
+enum { BENCH_MEMCPY, BENCH_MEMCPY_NEON, BENCH_MEMSET, BENCH_MEMSET_NEON };
+
+static unsigned long bench_one(int op, void *dst, void *src, size_t size)
+{
+	unsigned int i, loops = max_t(unsigned int, total / size, 1);
+	ktime_t start;
+	s64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		switch (op) {
+		case BENCH_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case BENCH_MEMCPY_NEON:
+			memcpy_neon(dst, src, size);
+			break;
+		case BENCH_MEMSET:
+			memset(dst, i, size);
+			break;
+		case BENCH_MEMSET_NEON:
+			memset_neon(dst, i, size);
+			break;
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* MB/s */
+	return ns ? div64_u64((u64)loops * size * 1000, ns) : 0;
+}
+
+static unsigned long bench_copy_page(void *dst, void *src, bool neon)
+{
+	unsigned int i, loops = max_t(unsigned int, total / PAGE_SIZE, 1);
+	ktime_t start;
+	s64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		if (neon)
+			copy_page_neon(dst, src);
+		else
+			copy_page(dst, src);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return ns ? div64_u64((u64)loops * PAGE_SIZE * 1000, ns) : 0;
+}
+
+static int __init neon_string_bench_init(void)
+{
+	size_t max = bench_sizes[ARRAY_SIZE(bench_sizes) - 1];
+	int order = get_order(max);
+	void *src, *dst;
+	int i;
+
+	src = (void *)__get_free_pages(GFP_KERNEL, order);
+	dst = (void *)__get_free_pages(GFP_KERNEL, order);
+	if (!src || !dst) {
+		free_pages((unsigned long)src, order);
+		free_pages((unsigned long)dst, order);
+		return -ENOMEM;
+	}
+	memset(src, 0x5a, max);
+
+	pr_info("neon_string_bench: MB/s    memcpy  neon    memset  neon\n");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		size_t size = bench_sizes[i];
+
+		pr_info("neon_string_bench: %7zu %7lu %7lu %7lu %7lu\n", size,
+			bench_one(BENCH_MEMCPY, dst, src, size),
+			bench_one(BENCH_MEMCPY_NEON, dst, src, size),
+			bench_one(BENCH_MEMSET, dst, src, size),
+			bench_one(BENCH_MEMSET_NEON, dst, src, size));
+	}
+	pr_info("neon_string_bench: copy_page %lu, neon %lu MB/s\n",
+		bench_copy_page(dst, src, false),
+		bench_copy_page(dst, src, true));
+
+	free_pages((unsigned long)src, order);
+	free_pages((unsigned long)dst, order);
+	return -EAGAIN;
+}
+module_init(neon_string_bench_init);
+
+MODULE_DESCRIPTION("NEON string function benchmark");
+MODULE_LICENSE("GPL");
@@ -19,6 +19,12 @@
  *
  * The APIs are for setting bus frequency to low or high.
  *
+ * Requests to raise the bus setpoint are applied at once. Requests to
+ * lower it are batched: they are re-evaluated down_delay_ms after the
+ * last one, against the current CPU rate and clock demand, so a burst
+ * of clock enables/disables (an EPD page render) costs at most one DDR
+ * switch each way instead of one per clock.
+ *
  * @ingroup PM
  */
 #include <asm/io.h>
@@ -30,6 +36,8 @@
 #include <linux/regulator/consumer.h>
 #include <linux/iram_alloc.h>
 #include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <mach/hardware.h>
 #include <mach/clock.h>
 #include <mach/mxc_dvfs.h>
@@ -53,6 +61,15 @@
 #define SPIN_DELAY	1000000 /* in nanoseconds */
 #define DDR_TYPE_DDR3		0x0
 #define DDR_TYPE_DDR2		0x1
+#define BUSFREQ_DOWN_DELAY_MS	500
+#define BUSFREQ_BW_HOLD_MBPS	100
+
+enum {
+	BUSFREQ_LOW,
+	BUSFREQ_MED,
+	BUSFREQ_HIGH,
+	BUSFREQ_NR_MODES,
+};
 
 DEFINE_SPINLOCK(ddr_freq_lock);
 
@@ -133,6 +150,71 @@ struct mutex bus_freq_mutex;
 struct timeval start_time;
 struct timeval end_time;
 
+static unsigned int busfreq_down_delay_ms = BUSFREQ_DOWN_DELAY_MS;
+static void busfreq_down_handler(struct work_struct *work);
+static DECLARE_DELAYED_WORK(busfreq_down_work, busfreq_down_handler);
+
+static struct {
+	unsigned int transitions[BUSFREQ_NR_MODES][BUSFREQ_NR_MODES];
+	unsigned int deferred;		/* downward requests batched */
+	unsigned int cancelled;		/* batched ones overtaken by a raise */
+	unsigned int bw_held;		/* step-downs postponed by bandwidth */
+	unsigned int bw_raised;		/* raises asked for by bandwidth */
+	unsigned int ddr_switches;
+	u64 ddr_stall_us;		/* time in update_ddr_freq, irqs off */
+	u32 ddr_stall_max_us;
+	u64 transition_us;		/* whole setpoint changes */
+	u32 transition_max_us;
+} busfreq_stats;
+
+static int busfreq_cur_mode(void)
+{
+	if (low_bus_freq_mode)
+		return BUSFREQ_LOW;
+	if (med_bus_freq_mode)
+		return BUSFREQ_MED;
+	return BUSFREQ_HIGH;
+}
+
+/* Called with bus_freq_mutex held, after a setpoint change attempt. */
+static void busfreq_account(int from, ktime_t start)
+{
+	int to = busfreq_cur_mode();
+	u32 us;
+
+	if (from == to)
+		return;
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	busfreq_stats.transitions[from][to]++;
+	busfreq_stats.transition_us += us;
+	if (us > busfreq_stats.transition_max_us)
+		busfreq_stats.transition_max_us = us;
+}
+
+/*
+ * Measured DDR demand, from the perfmon bandwidth monitor when it runs.
+ * Above bw_hold_mbps the bus is raised and not stepped down again until
+ * a fresh sample says the demand is gone.
+ */
+static unsigned int busfreq_bw_hold_mbps = BUSFREQ_BW_HOLD_MBPS;
+static unsigned int busfreq_bw_mbps;
+static unsigned long busfreq_bw_stamp;
+
+static int busfreq_bw_busy(void)
+{
+	return busfreq_bw_hold_mbps && busfreq_bw_mbps >= busfreq_bw_hold_mbps
+		&& time_before(jiffies, busfreq_bw_stamp + HZ);
+}
+
+/* Queue a batched re-evaluation; a later request restarts the delay. */
+static void busfreq_defer_down(void)
+{
+	busfreq_stats.deferred++;
+	cancel_delayed_work(&busfreq_down_work);
+	schedule_delayed_work(&busfreq_down_work,
+			      msecs_to_jiffies(busfreq_down_delay_ms));
+}
+
 static void voltage_work_handler(struct work_struct *work)
 {
 	if (lp_regulator != NULL) {
@@ -148,11 +230,14 @@ static void voltage_work_handler(struct work_struct *work)
 	complete_all(&voltage_change_cmpl);
 }
 
-int set_low_bus_freq(void)
+static int __set_low_bus_freq(void)
 {
 	if (busfreq_suspended)
 		return 0;
 	if (bus_freq_scaling_initialized) {
+		int from;
+		ktime_t start;
+
 		/* can not enter low bus freq, when cpu is in higher freq
 		 * or only have one working point */
 		if ((clk_get_rate(cpu_clk) >
@@ -162,6 +247,8 @@ int set_low_bus_freq(void)
 		}
 
 		mutex_lock(&bus_freq_mutex);
+		from = busfreq_cur_mode();
+		start = ktime_get();
 
 		stop_dvfs_per();
 
@@ -173,11 +260,22 @@ int set_low_bus_freq(void)
 			enter_lpapm_mode_mx51();
 		else
 			enter_lpapm_mode_mx53();
+		busfreq_account(from, start);
 		mutex_unlock(&bus_freq_mutex);
 	}
 	return 0;
 }
 
+int set_low_bus_freq(void)
+{
+	if (busfreq_suspended || !bus_freq_scaling_initialized)
+		return 0;
+	if (!busfreq_down_delay_ms)
+		return __set_low_bus_freq();
+	busfreq_defer_down();
+	return 0;
+}
+
 void enter_lpapm_mode_mx50()
 {
 	u32 reg;
@@ -375,11 +473,16 @@ void enter_lpapm_mode_mx53()
 	}
 }
 
-int set_high_bus_freq(int high_bus_freq)
+static int __set_high_bus_freq(int high_bus_freq)
 {
 	u32 reg;
 	if (bus_freq_scaling_initialized) {
+		int from;
+		ktime_t start;
+
 		mutex_lock(&bus_freq_mutex);
+		from = busfreq_cur_mode();
+		start = ktime_get();
 		/*
 		 * If the CPU freq is 800MHz, set the bus to the high
 		 * setpoint (133MHz) and DDR to 200MHz.
@@ -484,11 +587,70 @@ int set_high_bus_freq(int high_bus_freq)
 			}
 		}
 		start_sdram_autogating();
+		busfreq_account(from, start);
 		mutex_unlock(&bus_freq_mutex);
 	}
 	return 0;
 }
 
+int set_high_bus_freq(int high_bus_freq)
+{
+	if (!bus_freq_scaling_initialized)
+		return 0;
+	/* high -> medium is a step down, batch it like low */
+	if (!high_bus_freq && high_bus_freq_mode && busfreq_down_delay_ms
+	    && !busfreq_suspended) {
+		busfreq_defer_down();
+		return 0;
+	}
+	if (cancel_delayed_work(&busfreq_down_work))
+		busfreq_stats.cancelled++;
+	return __set_high_bus_freq(high_bus_freq);
+}
+
+/*
+ * Settle on the lowest setpoint the CPU rate and the clocks in use allow
+ * now, rather than the one asked for when the request was batched.
+ */
+static void busfreq_down_handler(struct work_struct *work)
+{
+	if (busfreq_suspended)
+		return;
+	if (busfreq_bw_busy()) {
+		busfreq_stats.bw_held++;
+		schedule_delayed_work(&busfreq_down_work,
+				      msecs_to_jiffies(busfreq_down_delay_ms));
+		return;
+	}
+	if (low_freq_bus_used() && !low_bus_freq_mode)
+		__set_low_bus_freq();
+	if (!low_bus_freq_mode)
+		__set_high_bus_freq(0);
+}
+
+/**
+ * bus_freq_update_bandwidth - report measured DDR demand
+ * @mbps: read plus write MB/s over all sampled masters, 0 when unknown
+ *
+ * Process context only; it may change the bus setpoint.
+ */
+void bus_freq_update_bandwidth(unsigned int mbps)
+{
+	busfreq_bw_mbps = mbps;
+	busfreq_bw_stamp = jiffies;
+	sdram_autogating_update_bandwidth(mbps);
+
+	if (!bus_freq_scaling_initialized || busfreq_suspended ||
+	    !busfreq_bw_busy())
+		return;
+	if (low_bus_freq_mode ||
+	    (bus_freq_scaling_is_active && !high_bus_freq_mode)) {
+		busfreq_stats.bw_raised++;
+		set_high_bus_freq(1);
+	}
+}
+EXPORT_SYMBOL(bus_freq_update_bandwidth);
+
 void exit_lpapm_mode_mx50(int high_bus_freq)
 {
 	u32 reg;
@@ -721,23 +883,26 @@ void set_ddr_freq(int ddr_rate)
 {
 	unsigned long flags;
 	unsigned int ret = 0;
+	ktime_t start;
+	u32 us;
 
 	spin_lock_irqsave(&ddr_freq_lock, flags);
 
+	start = ktime_get();
 	if (cpu_is_mx50())
 		ret = update_ddr_freq(ddr_rate);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
 
-#if 1
-{
-	unsigned int reg;
-    printk(KERN_NOTICE "set_ddr_freq ddr_rate =%d ret = %d \n",ddr_rate, ret);
-
-	reg = __raw_readl(MXC_CCM_CLK_DDR);
-    printk(KERN_NOTICE "after ddr divider = 0x%x \n",reg&0x3f);
-}
-#endif
+	busfreq_stats.ddr_switches++;
+	busfreq_stats.ddr_stall_us += us;
+	if (us > busfreq_stats.ddr_stall_max_us)
+		busfreq_stats.ddr_stall_max_us = us;
 
 	spin_unlock_irqrestore(&ddr_freq_lock, flags);
+
+	/* not from under the lock: a console printk there stalls the bus */
+	pr_debug("set_ddr_freq ddr_rate=%d ret=%d divider=0x%x %uus\n",
+		 ddr_rate, ret, __raw_readl(MXC_CCM_CLK_DDR) & 0x3f, us);
 	if (!ret)
 		cur_ddr_rate = ddr_rate;
 	udelay(100);
@@ -795,8 +960,91 @@ static ssize_t bus_freq_scaling_enable_store(struct device *dev,
 	return size;
 }
 
+static ssize_t bus_freq_down_delay_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", busfreq_down_delay_ms);
+}
+
+static ssize_t bus_freq_down_delay_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > 10000)
+		return -EINVAL;
+	busfreq_down_delay_ms = val;
+	return size;
+}
+
+static ssize_t bus_freq_bw_hold_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", busfreq_bw_hold_mbps);
+}
+
+static ssize_t bus_freq_bw_hold_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+	busfreq_bw_hold_mbps = val;
+	return size;
+}
+
+static ssize_t bus_freq_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	static const char *names[BUSFREQ_NR_MODES] = { "low", "med", "high" };
+	ssize_t len = 0;
+	int i, j;
+
+	len += sprintf(buf + len, "mode: %s\n", names[busfreq_cur_mode()]);
+	for (i = 0; i < BUSFREQ_NR_MODES; i++)
+		for (j = 0; j < BUSFREQ_NR_MODES; j++)
+			if (i != j)
+				len += sprintf(buf + len, "%s->%s: %u\n",
+					names[i], names[j],
+					busfreq_stats.transitions[i][j]);
+	len += sprintf(buf + len, "deferred: %u\ncancelled: %u\n",
+		       busfreq_stats.deferred, busfreq_stats.cancelled);
+	len += sprintf(buf + len, "bw_MBps: %u\nbw_held: %u\nbw_raised: %u\n",
+		       busfreq_bw_mbps, busfreq_stats.bw_held,
+		       busfreq_stats.bw_raised);
+	len += sprintf(buf + len, "transition_us: %llu\n"
+		       "transition_max_us: %u\n",
+		       (unsigned long long)busfreq_stats.transition_us,
+		       busfreq_stats.transition_max_us);
+	len += sprintf(buf + len, "ddr_switches: %u\nddr_stall_us: %llu\n"
+		       "ddr_stall_max_us: %u\n",
+		       busfreq_stats.ddr_switches,
+		       (unsigned long long)busfreq_stats.ddr_stall_us,
+		       busfreq_stats.ddr_stall_max_us);
+	return len;
+}
+
+/* any write clears the counters */
+static ssize_t bus_freq_stats_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned long flags;
+
+	mutex_lock(&bus_freq_mutex);
+	spin_lock_irqsave(&ddr_freq_lock, flags);
+	memset(&busfreq_stats, 0, sizeof(busfreq_stats));
+	spin_unlock_irqrestore(&ddr_freq_lock, flags);
+	mutex_unlock(&bus_freq_mutex);
+	return size;
+}
+
 static int busfreq_suspend(struct platform_device *pdev, pm_message_t message)
 {
+	cancel_delayed_work_sync(&busfreq_down_work);
 	if (low_bus_freq_mode)
 		set_high_bus_freq(1);
 	busfreq_suspended = 1;
@@ -811,6 +1059,23 @@ static int busfreq_resume(struct platform_device *pdev)
 
 static DEVICE_ATTR(enable, 0644, bus_freq_scaling_enable_show,
 			bus_freq_scaling_enable_store);
+static DEVICE_ATTR(down_delay_ms, 0644, bus_freq_down_delay_show,
+			bus_freq_down_delay_store);
+static DEVICE_ATTR(bw_hold_mbps, 0644, bus_freq_bw_hold_show,
+			bus_freq_bw_hold_store);
+static DEVICE_ATTR(stats, 0644, bus_freq_stats_show, bus_freq_stats_store);
+
+static struct attribute *busfreq_attrs[] = {
+	&dev_attr_enable.attr,
+	&dev_attr_down_delay_ms.attr,
+	&dev_attr_bw_hold_mbps.attr,
+	&dev_attr_stats.attr,
+	NULL,
+};
+
+static struct attribute_group busfreq_attr_group = {
+	.attrs = busfreq_attrs,
+};
 
 /*!
  * This is the probe routine for the bus frequency driver.
@@ -952,7 +1217,7 @@ static int __devinit busfreq_probe(struct platform_device *pdev)
 		return PTR_ERR(gpc_dvfs_clk);
 	}
 
-	err = sysfs_create_file(&busfreq_dev->kobj, &dev_attr_enable.attr);
+	err = sysfs_create_group(&busfreq_dev->kobj, &busfreq_attr_group);
 	if (err) {
 		printk(KERN_ERR
 		       "Unable to register sysdev entry for BUSFREQ");
@@ -1074,7 +1339,8 @@ static int __init busfreq_init(void)
 
 static void __exit busfreq_cleanup(void)
 {
-	sysfs_remove_file(&busfreq_dev->kobj, &dev_attr_enable.attr);
+	cancel_delayed_work_sync(&busfreq_down_work);
+	sysfs_remove_group(&busfreq_dev->kobj, &busfreq_attr_group);
 
 	/* Unregister the device structure */
 	platform_driver_unregister(&busfreq_driver);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc. All Rights Reserved.
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*!
+ * @file mach-mx5/cpuidle.c
+ *
+ * @brief cpuidle driver for i.MX5: three WFI based states
+ *
+ * #1 WFI, ARM clock running
+ * #2 WFI with the ARM clock and power gated, DDR in self-refresh (MX50)
+ * #3 as #2, with ARM moved to the 24MHz XTAL in low bus frequency mode
+ *
+ * State #3 only differs from #2 while bus_freq is in its low setpoint;
+ * otherwise it is entered as, and accounted to, #2.
+ *
+ * The exit latencies start at conservative floors and are raised to the
+ * worst transition cost (time outside WFI) seen over each window of
+ * MX5_IDLE_WINDOW entries, so the governor sees what the clock and
+ * DDR handling around WFI really costs on this board.
+ *
+ * @ingroup MSL_MX5
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpuidle.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <mach/hardware.h>
+#include "cpuidle.h"
+
+#define MX5_IDLE_WINDOW		256
+
+struct mx5_idle_params {
+	const char *name;
+	const char *desc;
+	unsigned int exit_latency;	/* floor, us */
+	unsigned int target_residency;	/* floor, us */
+};
+
+static const struct mx5_idle_params mx5_idle_params[MX5_IDLE_NR] = {
+	[MX5_IDLE_WFI] = {
+		.name = "WFI",
+		.desc = "Wait for interrupt",
+		.exit_latency = 1,
+		.target_residency = 1,
+	},
+	[MX5_IDLE_GATED] = {
+		.name = "WFI-GATED",
+		.desc = "WFI, ARM gated, DDR in SR",
+		.exit_latency = 30,
+		.target_residency = 300,
+	},
+	[MX5_IDLE_LPBUS] = {
+		.name = "WFI-LPBUS",
+		.desc = "WFI-GATED, ARM on 24MHz XTAL",
+		.exit_latency = 100,
+		.target_residency = 1000,
+	},
+};
+
+/* transition cost seen in the current window, per state */
+static struct {
+	unsigned int entries;
+	u32 max_us;
+} mx5_idle_window[MX5_IDLE_NR];
+
+static struct cpuidle_driver mx5_idle_driver = {
+	.name =		"mx5_idle",
+	.owner =	THIS_MODULE,
+};
+
+static DEFINE_PER_CPU(struct cpuidle_device, mx5_cpuidle_device);
+
+static void mx5_idle_measure(struct cpuidle_state *state, int depth, u32 us)
+{
+	const struct mx5_idle_params *p = &mx5_idle_params[depth];
+
+	if (us > mx5_idle_window[depth].max_us)
+		mx5_idle_window[depth].max_us = us;
+	if (++mx5_idle_window[depth].entries < MX5_IDLE_WINDOW)
+		return;
+
+	state->exit_latency = max(p->exit_latency,
+				  mx5_idle_window[depth].max_us);
+	/* not worth going deeper unless the sleep dwarfs the transition */
+	state->target_residency = max(p->target_residency,
+				      4 * state->exit_latency);
+	mx5_idle_window[depth].entries = 0;
+	mx5_idle_window[depth].max_us = 0;
+}
+
+static int mx5_enter_idle(struct cpuidle_device *dev,
+			  struct cpuidle_state *state)
+{
+	ktime_t start, sleep, wake, end;
+	int depth = state - dev->states;
+
+	local_irq_disable();
+	start = ktime_get();
+	depth = mx5_cpu_idle(depth, &sleep, &wake);
+	end = ktime_get();
+	local_irq_enable();
+
+	if (state != &dev->states[depth]) {
+		state = &dev->states[depth];
+		dev->last_state = state;
+	}
+	mx5_idle_measure(state, depth,
+			 ktime_to_us(ktime_sub(sleep, start)) +
+			 ktime_to_us(ktime_sub(end, wake)));
+
+	return ktime_to_us(ktime_sub(end, start));
+}
+
+static int __init mx5_init_cpuidle(void)
+{
+	struct cpuidle_device *device;
+	int i;
+
+	if (!cpu_is_mx5())
+		return 0;
+
+	cpuidle_register_driver(&mx5_idle_driver);
+
+	device = &per_cpu(mx5_cpuidle_device, smp_processor_id());
+	/* the low bus state only exists on MX50 */
+	device->state_count = cpu_is_mx50() ? MX5_IDLE_NR : MX5_IDLE_LPBUS;
+
+	for (i = 0; i < device->state_count; i++) {
+		struct cpuidle_state *state = &device->states[i];
+
+		state->enter = mx5_enter_idle;
+		state->exit_latency = mx5_idle_params[i].exit_latency;
+		state->target_residency = mx5_idle_params[i].target_residency;
+		state->flags = CPUIDLE_FLAG_TIME_VALID;
+		strlcpy(state->name, mx5_idle_params[i].name,
+			sizeof(state->name));
+		strlcpy(state->desc, mx5_idle_params[i].desc,
+			sizeof(state->desc));
+	}
+	device->states[MX5_IDLE_WFI].flags |= CPUIDLE_FLAG_SHALLOW;
+	device->states[MX5_IDLE_GATED].flags |= CPUIDLE_FLAG_BALANCED;
+	if (cpu_is_mx50())
+		device->states[MX5_IDLE_LPBUS].flags |= CPUIDLE_FLAG_DEEP;
+
+	if (cpuidle_register_device(device)) {
+		printk(KERN_ERR "mx5_init_cpuidle: Failed registering\n");
+		return -EIO;
+	}
+	return 0;
+}
+
+device_initcall(mx5_init_cpuidle);
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc. All Rights Reserved.
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __ARCH_ARM_MACH_MX5_CPUIDLE_H__
+#define __ARCH_ARM_MACH_MX5_CPUIDLE_H__
+
+#include <linux/ktime.h>
+
+/* idle depths, see mx5_cpu_idle() in system.c */
+enum {
+	MX5_IDLE_WFI,
+	MX5_IDLE_GATED,
+	MX5_IDLE_LPBUS,
+	MX5_IDLE_NR,
+};
+
+extern int mx5_cpu_idle(int depth, ktime_t *sleep, ktime_t *wake);
+
+#endif /* __ARCH_ARM_MACH_MX5_CPUIDLE_H__ */
@@ -992,6 +992,9 @@ static struct resource mxc_m4if_resources[] = {
 struct platform_device sdram_autogating_device = {
 	.name = "sdram_autogating",
 	.id = 0,
+	.dev = {
+		.coherent_dma_mask = DMA_BIT_MASK(32),
+		},
 	.resource = mxc_m4if_resources,
 	.num_resources = ARRAY_SIZE(mxc_m4if_resources),
 };
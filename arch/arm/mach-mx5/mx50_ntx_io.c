@@ -21,9 +21,16 @@
 #include <linux/miscdevice.h>
 #include <linux/irq.h>
 #include <linux/freezer.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/earlysuspend.h>
+#include <linux/backlight.h>
+#include <linux/fb.h>
 
 #include <mach/common.h>
 #include <linux/gpio_keys.h>
+#include <linux/fsl_devices.h>
 #include <linux/input.h>
 
 
@@ -198,12 +205,12 @@
 #define DEVICE_SLEEP_STATE      2
 
 #ifdef GPIOFN_PWRKEY//[
-static void power_key_chk(unsigned long v);
+void power_key_int_function(void);
 
 static int PWR_SW_func(int iGPIOVal)
 {
 	printk("[%s]\n",__FUNCTION__);
-	power_key_chk(0);
+	power_key_int_function();
 }
 
 static GPIODATA gtNTX_PWR_GPIO_data = {
@@ -460,7 +467,6 @@ extern void set_want_to_check_fb_state(int want_to_check);
 int ntx_charge_status (void);
 int ntx_get_battery_vol (void);
 
-static struct timer_list power_key_timer;
 extern void mxc_kpp_report_power(int isDown);
 
 int g_pwr_key = 0;
@@ -709,6 +715,150 @@ unsigned long gLastBatTick, gUSB_Change_Tick;
 int gLastBatValue;
 int g_power_key_debounce;		// Joseph 20100921 for ESD
 
+/*
+ * Battery state as last sampled from the MSP430.  Readers only look at the
+ * cache; ntx_batt_work samples again on MSP430 interrupts and every
+ * NTX_BATT_POLL_SECS otherwise, so frequent battery reads do not touch I2C.
+ */
+#define NTX_BATT_POLL_SECS	60
+static DEFINE_MUTEX(ntx_batt_lock);
+static int gBattRaw;			// MSP430 value, 0x8000 critical, 0x7FFF failed
+static int gBattPercent = -1;		// -1 until the first sample
+static int gBattOnAC = -1;
+static struct delayed_work ntx_batt_work;
+extern void ntx_battery_changed_event_callback(void);
+
+static int ntx_battery_percent (int battValue)
+{
+	int i, result = 4200000;
+	const unsigned short battGasgauge[] = {
+	//	3.0V, 3.1V, 3.2V, 3.3V, 3.4V, 3.5V, 3.6V, 3.7V, 3.8V, 3.9V, 4.0V, 4.1V, 4.2V,
+//		 743,  767,  791,  812,  835,  860,  885,  909,  935,  960,  985, 1010, 1023,
+		 767,  791,  812,  833,  852,  877,  903,  928,  950,  979,  993, 1019, 1023,
+	};
+
+	// transfer to uV to pmic interface.
+	for (i=0; i< ARRAY_SIZE (battGasgauge); i++) {
+		if (battValue <= battGasgauge[i]) {
+			if (i && (battValue != battGasgauge[i])) {
+				result = 3000000+ (i-1)*100000;
+				result += ((battValue-battGasgauge[i-1]) * 100000 / (battGasgauge[i]-battGasgauge[i-1]));
+			}
+			else
+				result = 3000000+ i*100000;
+			break;
+		}
+	}
+//	printk ("[%s-%d] battery %d (%d)\n", __func__, __LINE__, battValue,result);
+	if (4100000 <= result) {
+		printk("%s : full !! %d\n",__FUNCTION__,result);
+		return 100;
+	}
+	if (3400000 > result) {
+		printk("%s : empty !! %d\n",__FUNCTION__,result);
+		return 0;
+	}
+	result = 4100000 - result;
+	result /= 7000;
+	printk ("[%s-%d] %d,bat=%d\n", __func__, __LINE__, (100-result),battValue);
+	return 100-result;
+}
+
+/* Called with ntx_batt_lock held */
+static void ntx_battery_sample (void)
+{
+	int battValue, onAC, critical = 0;
+	unsigned int temp;
+
+	// the reading settles for a while after the charger is (un)plugged
+	onAC = gpio_get_value (GPIO_ACIN_PG)?0:1;
+	if (gBattOnAC != onAC) {
+		if (-1 != gBattOnAC)
+			gUSB_Change_Tick = jiffies;
+		gBattOnAC = onAC;
+	}
+	if (gUSB_Change_Tick) {
+		if (500 < (jiffies - gUSB_Change_Tick)) {
+			gUSB_Change_Tick = 0;
+			gLastBatValue = 0;
+		}
+		else if (gLastBatValue)
+			return;
+	}
+
+	battValue = msp430_battery ();
+	if (!battValue) {
+		printk ("[%s-%d] MSP430 read failed\n", __func__, __LINE__);
+		gBattRaw = 0x7FFF;
+		gBattPercent = 0;
+		return;
+	}
+	gLastBatTick = jiffies;
+
+	temp = msp430_read (0x60);
+	if (-1 != temp) {
+		if (0x8000 & temp) {
+			printk ("[%s-%d] =================> Micro P MSP430 alarm triggered <===================\n", __func__, __LINE__);
+			g_wakeup_by_alarm = 1;
+		}
+		if ((0x01 & temp) || (0x8000 & battValue)) {
+			printk ("[%s-%d] =================> Micro P MSP430 Critical_Battery_Low <===================\n", __func__, __LINE__);
+			gIsMSP430IntTriggered = 1;
+			critical = 1;
+		}
+	}
+	battValue &= ~0x8000;
+
+	if (!gLastBatValue)
+		gLastBatValue = battValue;
+	if (!onAC) {// not charging
+		if (gLastBatValue > battValue)
+			gLastBatValue = battValue;
+	}
+	else {
+		if (gLastBatValue < battValue)
+			gLastBatValue = battValue;
+	}
+	gBattRaw = gLastBatValue | (critical?0x8000:0);
+	gBattPercent = (critical && !onAC)?0:ntx_battery_percent (gLastBatValue);
+}
+
+static void ntx_batt_work_func (struct work_struct *work)
+{
+	int old;
+
+	mutex_lock (&ntx_batt_lock);
+	old = gBattPercent;
+	gIsMSP430IntTriggered = 0;	// set again if the battery is critical
+	ntx_battery_sample ();
+	mutex_unlock (&ntx_batt_lock);
+
+	if (old != gBattPercent)
+		ntx_battery_changed_event_callback ();
+	// come back once the reading has settled after a charger change
+	schedule_delayed_work (&ntx_batt_work,
+			gUSB_Change_Tick?501:NTX_BATT_POLL_SECS * HZ);
+}
+
+/* Sample again soon, e.g. from the MSP430 interrupt */
+static void ntx_battery_kick (unsigned long delay)
+{
+	cancel_delayed_work (&ntx_batt_work);
+	schedule_delayed_work (&ntx_batt_work, delay);
+}
+
+/* Raw MSP430 value as returned by CM_GET_BATTERY_STATUS */
+static int ntx_battery_raw (void)
+{
+	if (-1 == gBattPercent) {
+		mutex_lock (&ntx_batt_lock);
+		if (-1 == gBattPercent)
+			ntx_battery_sample ();
+		mutex_unlock (&ntx_batt_lock);
+	}
+	return gBattRaw;
+}
+
 
 unsigned long long hwconfig = 0x0000000011000001LL;
 EXPORT_SYMBOL(hwconfig);
@@ -750,12 +900,171 @@ int getDeviceState () {
     return g_device_state;
 }
 
+/*
+ * Front light level control.  A brightness slider sends dozens of levels
+ * a second and each one costs several MSP430 I2C writes, so a request
+ * only records the wanted level; fl_work applies whichever level is the
+ * latest when it gets to run and the ones in between are never sent.
+ * fl_lock serialises the front light registers against the raw
+ * DUTY/FREQUENCY ioctls.
+ */
+static unsigned int last_FL_duty;
+static unsigned int current_FL_freq = 0xFFFF;
+static DEFINE_MUTEX(fl_lock);
+static int fl_pending = -1;
+#ifdef CONFIG_BACKLIGHT_CLASS_DEVICE
+static struct backlight_device *fl_bl;
+#endif
+
+static void fl_set_freq(unsigned int freq)
+{
+	if (freq == current_FL_freq)
+		return;
+	msp430_write (0xA5, freq&0xFF00);	// Set Frequency 8M/freq
+	msp430_write (0xA4, freq<<8);
+	current_FL_freq = freq;
+}
+
+static void fl_set_duty(unsigned int duty)
+{
+	msp430_write (0xA7, duty&0xFF00);	// Set PWM duty
+	msp430_write (0xA6, duty<<8);
+}
+
+/* level 0..100, called with fl_lock held */
+static void fl_set_level(unsigned int p)
+{
+	const struct front_light_setting *fl = NULL;
+
+	if (p == last_FL_duty)
+		return;
+
+	if (0 == p) {
+		msp430_write(0xA3, 0);
+		/* the frequency is written again on the next power up */
+		current_FL_freq = 0xFFFF;
+		schedule_delayed_work(&FL_off, 120);
+		last_FL_duty = 0;
+		return;
+	}
+
+	cancel_delayed_work_sync(&FL_off);
+
+	switch (gptHWCFG->m_val.bFrontLight) {
+	case 3:		// TABLE0a
+		fl_set_freq(0x190);	// 8M/400 = 20K Hz
+		fl_set_duty(FL_table0[p-1]);
+		break;
+	case 1:		// TABLE0
+	case 2:		// TABLE0+
+		fl_set_freq(0x190);
+		if (p <= 50) {
+			gpio_direction_output(FL_R_EN,0);
+			fl_set_duty(FL_table0[2*(p-1)]);
+		}
+		else {
+			gpio_direction_output(FL_R_EN,1);
+			fl_set_duty(FL_table0[p-1]);
+		}
+		break;
+	case 4:		// TABLE1
+		fl = &FL_table1[p-1];
+		break;
+	case 5:		// TABLE2
+		fl = &FL_table2[p-1];
+		break;
+	case 6:		// TABLE3
+		fl = &FL_table3[p-1];
+		break;
+	case 7:		// TABLE4+
+		fl = &FL_table4[p-1];
+		break;
+	}
+
+	if (fl) {
+		/* TABLE3 only raises FL_R_EN once the new duty is in place */
+		if (gptHWCFG->m_val.bFrontLight != 6 || last_FL_duty >= p)
+			gpio_direction_output (FL_R_EN, fl->fl_r_en);
+		fl_set_freq(8000000/fl->freq);
+		fl_set_duty(fl->duty);
+		if (gptHWCFG->m_val.bFrontLight == 6 && last_FL_duty < p)
+			gpio_direction_output (FL_R_EN, fl->fl_r_en);
+	}
+
+	if (0 == last_FL_duty) {
+		msp430_write (0xA1, 0xFF00);	// Disable front light auto off timer
+		msp430_write (0xA2, 0xFF00);
+
+		msp430_write (0xA3, 0x0100);	// enable front light pwm
+
+		msleep(100);
+		gpio_direction_output(FL_EN,0);
+	}
+	last_FL_duty = p;
+}
+
+static void fl_work_func(struct work_struct *work)
+{
+	int p = xchg(&fl_pending, -1);
+
+	if (p < 0)
+		return;
+	mutex_lock(&fl_lock);
+	fl_set_level(p);
+	mutex_unlock(&fl_lock);
+}
+static DECLARE_WORK(fl_work, fl_work_func);
+
+static void fl_queue_level(unsigned int p)
+{
+	xchg(&fl_pending, p);
+	schedule_work(&fl_work);
+}
+
+#ifdef CONFIG_BACKLIGHT_CLASS_DEVICE
+static int fl_bl_update_status(struct backlight_device *bd)
+{
+	unsigned int level = bd->props.brightness;
+
+	if (bd->props.power != FB_BLANK_UNBLANK ||
+	    bd->props.fb_blank != FB_BLANK_UNBLANK)
+		level = 0;
+	fl_queue_level(level);
+	return 0;
+}
+
+static int fl_bl_get_brightness(struct backlight_device *bd)
+{
+	return last_FL_duty;
+}
+
+static const struct backlight_ops fl_bl_ops = {
+	.update_status	= fl_bl_update_status,
+	.get_brightness	= fl_bl_get_brightness,
+};
+
+static void fl_bl_register(struct device *parent)
+{
+	struct backlight_properties props;
+
+	memset(&props, 0, sizeof(props));
+	props.max_brightness = 100;
+	fl_bl = backlight_device_register("mxc_msp430_fl", parent, NULL,
+					  &fl_bl_ops, &props);
+	if (IS_ERR(fl_bl)) {
+		printk(KERN_ERR "front light: backlight register failed %ld\n",
+		       PTR_ERR(fl_bl));
+		fl_bl = NULL;
+	}
+}
+#else
+static inline void fl_bl_register(struct device *parent) {}
+#endif
+
 static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int command, unsigned long arg)
 {
 	unsigned long i = 0, temp;
 	unsigned int p = arg;//*(unsigned int *)arg;
-	static unsigned int  last_FL_duty = 0;
-	static unsigned int  current_FL_freq = 0xFFFF;
   struct ebook_device_info info;
    int FB_state = UNSET;
    int want_to_check = UNSET;
@@ -815,13 +1124,6 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 			break;
 
 		case CM_GET_BATTERY_STATUS:
-			if (gUSB_Change_Tick) {
-				if (500 < (jiffies - gUSB_Change_Tick)) {
-					gUSB_Change_Tick = 0;
-					gLastBatValue = 0;
-				}
-			}
-
 			if ((6 == check_hardware_name()) || (2 == check_hardware_name())) {		// E60632 || E50602
 				i = 1023;
 				copy_to_user((void __user *)arg, &i, sizeof(unsigned long));
@@ -829,45 +1131,7 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 				break;
 			}
 
-			if (gIsMSP430IntTriggered || !gLastBatValue || ((0==gUSB_Change_Tick) && (200 < (jiffies - gLastBatTick)))) {
-				i = msp430_battery ();
-	 			if (i) {
-					gLastBatTick = jiffies;
-					temp = msp430_read (0x60);
-					if (0x8000 & temp) {
-						printk ("[%s-%d] =================> Micro P MSP430 alarm triggered <===================\n", __func__, __LINE__);
-						g_wakeup_by_alarm = 1;
-					}
-					if ((0x01 & temp) || (0x8000 & i)) {
-						printk ("[%s-%d] =================> Micro P MSP430 Critical_Battery_Low <===================\n", __func__, __LINE__);
-						i |= 0x8000;
-						gIsMSP430IntTriggered = 1;
-					}
-					else {
-//						printk ("[%s-%d] battery ===> %d\n", __func__, __LINE__,i);
-						if (!gLastBatValue)
-							gLastBatValue = i;
-						if (gpio_get_value (GPIO_ACIN_PG)) {// not charging
-							if (gLastBatValue > i)
-								gLastBatValue = i;
-							else
-								i = gLastBatValue;
-						}
-						else {
-							if (gLastBatValue < i)
-								gLastBatValue = i;
-							else
-								i = gLastBatValue;
-						}
-					}
-				}
-				else {
-					printk ("[%s-%d] MSP430 read failed\n", __func__, __LINE__);
-					i = 0x7FFF;
-				}
-			}
-			else
-				i = gLastBatValue;
+			i = ntx_battery_raw ();
 			copy_to_user((void __user *)arg, &i, sizeof(unsigned long));
 
 			break;
@@ -1177,117 +1441,15 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 		case CM_FRONT_LIGHT_SET:
 			if(0!=gptHWCFG->m_val.bFrontLight)
 			{
-				if (p) {
-					if(delayed_work_pending(&FL_off)){
-						cancel_delayed_work_sync(&FL_off);
-						printk("FL_off delayed work canceled");
-					}
-					printk ("\nset front light level : %d\n",p);
-					if(p>0 && p<=100)
-					{
-						if( gptHWCFG->m_val.bFrontLight == 3){  //TABLE0a
-							msp430_write (0xA5, 0x0100);	// Set Frequency 8M/400 (0x190) = 20K Hz
-							msp430_write (0xA4, 0x9000);
-							msp430_write (0xA7, FL_table0[p-1]&0xFF00);   // Set PWM duty
-							msp430_write (0xA6, FL_table0[p-1]<<8);
-							printk("PWMCNT : 0x%04x\n", FL_table0[p-1]);
-						}
-						else if( gptHWCFG->m_val.bFrontLight == 4 ){  //TABLE1
-							int freq = 8000000/FL_table1[p-1].freq;
-
-							gpio_direction_output (FL_R_EN, FL_table1[p-1].fl_r_en);				
-							if( freq != current_FL_freq){
-								printk ("Set front light Frequency : %d\n",FL_table1[p-1].freq);	
-								msp430_write (0xA5, freq&0xFF00);	// Set Frequency 8M/freq
-								msp430_write (0xA4, freq<<8);
-								current_FL_freq = freq;
-							}
-							msp430_write (0xA7, FL_table1[p-1].duty&0xFF00);	// Set PWM duty
-							msp430_write (0xA6, FL_table1[p-1].duty<<8);
-						}
-						else if( gptHWCFG->m_val.bFrontLight == 1 || gptHWCFG->m_val.bFrontLight == 2 ){  //TABLE0, TABLE0+
-							if (0 == last_FL_duty){
-								msp430_write (0xA5, 0x0100);	// Set Frequency 8M/400 (0x190) = 20K Hz
-								msp430_write (0xA4, 0x9000);
-							}
-							if(p<=50){
-								gpio_direction_output(FL_R_EN,0);
-								msp430_write (0xA7, FL_table0[2*(p-1)]&0xFF00);	// Set PWM duty
-								msp430_write (0xA6, FL_table0[2*(p-1)]<<8);
-								printk("PWMCNT : 0x%04x\n", FL_table0[2*(p-1)]);
-							}else{
-								gpio_direction_output(FL_R_EN,1);
-								msp430_write (0xA7, FL_table0[p-1]&0xFF00);	// Set PWM duty
-								msp430_write (0xA6, FL_table0[p-1]<<8);
-								printk("PWMCNT : 0x%04x\n", FL_table0[p-1]);
-							}
-						}
-						else if( gptHWCFG->m_val.bFrontLight == 5 ){  //TABLE2 
-							int freq = 8000000/FL_table2[p-1].freq;
-
-							gpio_direction_output (FL_R_EN, FL_table2[p-1].fl_r_en);				
-							if( freq != current_FL_freq){
-								printk ("Set front light Frequency : %d\n",FL_table2[p-1].freq);	
-								msp430_write (0xA5, freq&0xFF00);	// Set Frequency 8M/freq
-								msp430_write (0xA4, freq<<8);
-								current_FL_freq = freq;
-							}
-							msp430_write (0xA7, FL_table2[p-1].duty&0xFF00);	// Set PWM duty
-							msp430_write (0xA6, FL_table2[p-1].duty<<8);
-							printk ("Set front light duty : %d\n",FL_table2[p-1].duty);	
-						}
-						else if( gptHWCFG->m_val.bFrontLight == 6 ){  //TABLE3 
-							int freq = 8000000/FL_table3[p-1].freq;
-		
-							if (last_FL_duty >= p)
-								gpio_direction_output (FL_R_EN, FL_table3[p-1].fl_r_en);					
-
-							if( freq != current_FL_freq){
-								printk ("Set front light Frequency : %d\n",FL_table3[p-1].freq);	
-								msp430_write (0xA5, freq&0xFF00);	// Set Frequency 8M/freq
-								msp430_write (0xA4, freq<<8);
-								current_FL_freq = freq;
-							}
-							msp430_write (0xA7, FL_table3[p-1].duty&0xFF00);	// Set PWM duty
-							msp430_write (0xA6, FL_table3[p-1].duty<<8);
-							printk ("Set front light duty : %d\n",FL_table3[p-1].duty);	
-
-							if (last_FL_duty < p)
-								gpio_direction_output (FL_R_EN, FL_table3[p-1].fl_r_en);			
-						}
-						else if( gptHWCFG->m_val.bFrontLight == 7 ){  //TABLE4+  
-							int freq = 8000000/FL_table4[p-1].freq;
-
-							gpio_direction_output (FL_R_EN, FL_table4[p-1].fl_r_en);				
-							if( freq != current_FL_freq){
-								printk ("Set front light Frequency : %d\n",FL_table4[p-1].freq);	
-								msp430_write (0xA5, freq&0xFF00);	// Set Frequency 8M/freq
-								msp430_write (0xA4, freq<<8);
-								current_FL_freq = freq;
-							}
-							msp430_write (0xA7, FL_table4[p-1].duty&0xFF00);	// Set PWM duty
-							msp430_write (0xA6, FL_table4[p-1].duty<<8);
-							printk ("Set front light duty : %d\n",FL_table4[p-1].duty);	
-						}
-					}else{
-						printk("Wrong number! level range from 0 to 100\n");
-					}
-					if (0 == last_FL_duty){
-						msp430_write (0xA1, 0xFF00);	// Disable front light auto off timer
-						msp430_write (0xA2, 0xFF00);
-
-						msp430_write (0xA3, 0x0100);	// enable front light pwm
-
-						msleep(100);
-						gpio_direction_output(FL_EN,0);
-					}
+				if (p > 100) {
+					printk("Wrong number! level range from 0 to 100\n");
+					break;
 				}
-				else if(last_FL_duty != 0){
-					printk ("FL PWM off command\n");
-					msp430_write(0xA3, 0); 
-					schedule_delayed_work(&FL_off, 120);
-				}
-				last_FL_duty = p;
+#ifdef CONFIG_BACKLIGHT_CLASS_DEVICE
+				if (fl_bl)
+					fl_bl->props.brightness = p;
+#endif
+				fl_queue_level(p);
 			}
 			break;
 
@@ -1301,6 +1463,7 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 		case CM_FRONT_LIGHT_DUTY:
 			if(0!=gptHWCFG->m_val.bFrontLight)
 			{
+				mutex_lock(&fl_lock);
 				if (p) {			
 					printk ("\nSet front light PWMCNT : 0x%4X\n",p);
 					printk ("Current front light Frequency : (8MHz/0x%4X)\n",current_FL_freq);		
@@ -1324,6 +1487,7 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 					gpio_direction_input(FL_EN);
 				}
 				last_FL_duty = p;
+				mutex_unlock(&fl_lock);
 			}
 			break;
 
@@ -1333,9 +1497,11 @@ static int  ioctlDriver(struct inode *inode, struct file *filp, unsigned int com
 				if (p) {
 					printk ("set front light Frequency : (8MHz/0x%4X)\n",p);		
 //					msp430_write (0xA4, (p<<8));
+					mutex_lock(&fl_lock);
 					msp430_write (0xA5, p&0xFF00);   
 					msp430_write (0xA4, (p<<8));
 					current_FL_freq = p;
+					mutex_unlock(&fl_lock);
 				}
 			}
 			break;
@@ -1554,6 +1720,8 @@ void FL_off_func(struct work_struct *work)
 }
 
 int FL_suspend(void){
+	/* let a queued level reach the MSP430 before deciding */
+	flush_work(&fl_work);
 	if(delayed_work_pending(&FL_off)){
 		return -1;
 	}	
@@ -1696,7 +1864,27 @@ int pxa168_chechk_suspend (void)
 	return 1;
 }
 
-static struct timer_list power_key_timer;
+/*
+ * The power key only interrupts on the press edge.  The press is
+ * reported from the interrupt, read again pwrkey_debounce_ms later to
+ * drop contact bounce and ESD glitches, then polled every pwrkey_poll_ms
+ * until it is released.
+ */
+static struct hrtimer power_key_timer;
+static ktime_t power_key_down;		// time of the press edge
+static unsigned int pwrkey_debounce_ms = 20;
+static unsigned int pwrkey_poll_ms = 20;
+module_param(pwrkey_debounce_ms, uint, 0644);
+MODULE_PARM_DESC(pwrkey_debounce_ms, "power key confirmation delay in ms");
+module_param(pwrkey_poll_ms, uint, 0644);
+MODULE_PARM_DESC(pwrkey_poll_ms, "power key release poll period in ms");
+
+static void power_key_timer_start(unsigned int ms)
+{
+	hrtimer_start(&power_key_timer,
+		      ktime_set(ms / MSEC_PER_SEC, (ms % MSEC_PER_SEC) * NSEC_PER_MSEC),
+		      HRTIMER_MODE_REL);
+}
 
 extern void mxc_kpp_report_sw(int isDown,__u16 wKeyCode);
 extern void gpiokeys_report_sw(int isDown,__u16 wKeyCode);
@@ -1731,49 +1919,44 @@ void ntx_report_power(int isDown)
 	ntx_report_key(isDown, KEY_POWER);	
 }
 
-static void power_key_chk(unsigned long v)
+static enum hrtimer_restart power_key_chk(struct hrtimer *timer)
 {
-#if 1 // Angor
 	int pwr_key = power_key_status();
 	static bool islongpress = false;
 
 	g_pwr_key = pwr_key;
 
 	if (pwr_key) {
-		++g_power_key_debounce;
-
-		if (2 == g_power_key_debounce)
-			ntx_report_power(1);
+		// held time in the 10ms steps the ESD check in the ioctl expects
+		g_power_key_debounce = ktime_to_ms(ktime_sub(ktime_get(), power_key_down)) / 10;
 
 		if (g_power_key_debounce > 100 && islongpress == false) {
 		    LED(1);
 		    islongpress = false;
 		}
 
-		mod_timer(&power_key_timer, jiffies + 1);
-	}
-	else {
-		ntx_report_power(0);
-		LED(0);
-		islongpress = false;
-	}
-#else
-	if (power_key_status()) {
-		++g_power_key_debounce;
-		if ((2 == g_power_key_debounce) && gIsCustomerUi)
-			ntx_report_power(1);
-		mod_timer(&power_key_timer, jiffies + 1);
+		hrtimer_forward_now(timer, ktime_set(0, pwrkey_poll_ms * NSEC_PER_MSEC));
+		return HRTIMER_RESTART;
 	}
-	else if (gIsCustomerUi)
-		ntx_report_power(0);
-#endif
+
+	ntx_report_power(0);
+	LED(0);
+	islongpress = false;
+	return HRTIMER_NORESTART;
 }
 
 void power_key_int_function(void)
 {
 	gMxcPowerKeyIrqTriggered = 1;
 	g_power_key_debounce = 0;
-	mod_timer(&power_key_timer, jiffies + 1);
+	late_resume_fast_wake();
+	// a bounce inside the window only pushes the confirmation read out
+	if (!hrtimer_active(&power_key_timer)) {
+		power_key_down = ktime_get();
+		if (power_key_status())
+			ntx_report_power(1);
+	}
+	power_key_timer_start(pwrkey_debounce_ms);
 }
 
 static irqreturn_t power_key_int(int irq, void *dev_id)
@@ -1786,6 +1969,8 @@ static irqreturn_t power_key_int(int irq, void *dev_id)
 static unsigned long gdwTheTickToChkACINPlug;
 static struct timer_list acin_pg_timer;
 static int g_acin_pg_debounce;
+static unsigned long g_acin_pg_tick;	// jiffies at the last ACIN_PG edge
+static int g_usb_plug_charger;		// plug kept from userspace
 typedef void (*usb_insert_handler) (char inserted);
 extern usb_insert_handler mxc_misc_report_usb;
 extern void ntx_charger_online_event_callback(void);
@@ -1799,8 +1984,20 @@ static void acin_pg_chk(unsigned long v)
 	if (!gpio_get_value (GPIO_ACIN_PG)) {
 		++g_acin_pg_debounce;
 		if (10 == g_acin_pg_debounce) {
+			// a dedicated charger only needs the battery code told,
+			// bringing up the USB stack for it is wasted work
+			enum fsl_usb2_cable cable = fsl_udc_detect_cable ();
+
+			printk (KERN_INFO "usb plug: %s, classified in %u ms\n",
+				(FSL_USB2_CABLE_CHARGER == cable) ? "charger" :
+				(FSL_USB2_CABLE_HOST == cable) ? "host" : "unknown",
+				jiffies_to_msecs (jiffies - g_acin_pg_tick));
 			if (gIsCustomerUi) {
-				if(mxc_misc_report_usb) {
+				g_usb_plug_charger = (FSL_USB2_CABLE_CHARGER == cable);
+				if (g_usb_plug_charger) {
+					ntx_charger_online_event_callback ();
+				}
+				else if(mxc_misc_report_usb) {
 					mxc_misc_report_usb(1);
 					ntx_charger_online_event_callback ();
 				}
@@ -1816,12 +2013,10 @@ static void acin_pg_chk(unsigned long v)
 		//	gLastBatValue += 50;
 
 		if (gIsCustomerUi) {
-			if(mxc_misc_report_usb) {
+			if(mxc_misc_report_usb && !g_usb_plug_charger)
 				mxc_misc_report_usb(0);
-				ntx_charger_online_event_callback ();
-			}
-			else {
-			}
+			g_usb_plug_charger = 0;
+			ntx_charger_online_event_callback ();
 		}
 	}
 }
@@ -1837,84 +2032,8 @@ int ntx_charge_status (void)
 }
 int ntx_get_battery_vol (void)
 {
-	int i, battValue, temp, result;
-	const unsigned short battGasgauge[] = {
-	//	3.0V, 3.1V, 3.2V, 3.3V, 3.4V, 3.5V, 3.6V, 3.7V, 3.8V, 3.9V, 4.0V, 4.1V, 4.2V,
-//		 743,  767,  791,  812,  835,  860,  885,  909,  935,  960,  985, 1010, 1023,
-		 767,  791,  812,  833,  852,  877,  903,  928,  950,  979,  993, 1019, 1023,
-	};
-
-	gIsMSP430IntTriggered = 0;
-	if (gUSB_Change_Tick) {
-		if (500 < (jiffies - gUSB_Change_Tick)) {
-			gUSB_Change_Tick = 0;
-			gLastBatValue = 0;
-		}
-	}
-
-	if (gIsMSP430IntTriggered || !gLastBatValue || ((0 == gUSB_Change_Tick) && (200 < (jiffies - gLastBatTick)))) {
-		battValue = msp430_battery ();
-		if (battValue) {
-			gLastBatTick = jiffies;
-			if (gpio_get_value (GPIO_ACIN_PG)) {// not charging
-				temp = msp430_read (0x60);
-				if (-1 != temp ) {
-					if (0x8000 & temp) {
-						printk ("[%s-%d] =================> Micro P MSP430 alarm triggered <===================\n", __func__, __LINE__);
-						g_wakeup_by_alarm = 1;
-					}
-					if (0x01 & temp) {
-						printk ("[%s-%d] =================> Micro P MSP430 Critical_Battery_Low <===================\n", __func__, __LINE__);
-						return 0;
-					}
-					else if (!gLastBatValue) 
-						gLastBatValue = battValue;
-					else if (gLastBatValue > battValue)
-						gLastBatValue = battValue;
-					else
-						battValue = gLastBatValue;
-				}
-			}
-			else {
-				if (gLastBatValue < battValue)
-					gLastBatValue = battValue;
-				else
-					battValue = gLastBatValue;
-			}
-		}
-		else {
-			printk ("[%s-%d] MSP430 read failed\n", __func__, __LINE__);
-			battValue = 0;
-		}
-	}
-	else
-		battValue = gLastBatValue;
-
-	// transfer to uV to pmic interface.
-	for (i=0; i< sizeof (battGasgauge); i++) {
-		if (battValue <= battGasgauge[i]) {
-			if (i && (battValue != battGasgauge[i])) {
-				result = 3000000+ (i-1)*100000;
-				result += ((battValue-battGasgauge[i-1]) * 100000 / (battGasgauge[i]-battGasgauge[i-1]));
-			}
-			else
-				result = 3000000+ i*100000;
-			break;
-		}
-	}
-//	printk ("[%s-%d] battery %d (%d)\n", __func__, __LINE__, battValue,result);
-	if (4100000 <= result) {
-		printk("%s : full !! %d\n",__FUNCTION__,result);
-		return 100;
-	}
-	if (3400000 > result) {
-		printk("%s : empty !! %d\n",__FUNCTION__,result);
-		return 0;
-	}
-	result = 4100000 - result;
-	result /= 7000;
-	printk ("[%s-%d] %d,bat=%d\n", __func__, __LINE__, (100-result),battValue);
-	return 100-result;
+	ntx_battery_raw ();
+	return gBattPercent;
 }
 
 static irqreturn_t ac_in_int(int irq, void *dev_id)
@@ -1922,6 +2041,7 @@ static irqreturn_t ac_in_int(int irq, void *dev_id)
 	del_timer_sync(&acin_pg_timer);
 
 	gUSB_Change_Tick = jiffies;	// do not check battery value in 6 seconds
+	ntx_battery_kick (501);
 	if (gpio_get_value (GPIO_ACIN_PG))
 		set_irq_type(irq, IRQF_TRIGGER_FALLING);
 	else {
@@ -1929,6 +2049,7 @@ static irqreturn_t ac_in_int(int irq, void *dev_id)
 	}
 
 	g_acin_pg_debounce = 0;
+	g_acin_pg_tick = jiffies;
 
 	if(time_after(jiffies,gdwTheTickToChkACINPlug)) {
 		//printk(KERN_ERR"%s(%d) %d,%d\n",__FUNCTION__,__LINE__,jiffies,gdwTheTickToChkACINPlug);
@@ -1955,6 +2076,8 @@ static irqreturn_t msp_int(int irq, void *dev_id)
 {
 	printk ("[%s-%d] MSP430 interrupt triggered !!!\n",__func__,__LINE__);
 	gIsMSP430IntTriggered = 1;
+	late_resume_fast_wake();
+	ntx_battery_kick (0);
 	return 0;
 }
 
@@ -2106,8 +2229,8 @@ static int gpio_initials(void)
 			enable_irq_wake(irq);
 	}
 	#endif //]GPIOFN_PWRKEY
+	hrtimer_init(&power_key_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	power_key_timer.function = power_key_chk;
-	init_timer(&power_key_timer);
 
 	tle4913_init();
 
@@ -2379,6 +2502,8 @@ static int gpio_initials(void)
 	gpio_direction_input (GPIO_MSP_INT);
 	irq = gpio_to_irq(GPIO_MSP_INT);
 	set_irq_type(irq, IRQF_TRIGGER_FALLING);
+	INIT_DELAYED_WORK_DEFERRABLE(&ntx_batt_work, ntx_batt_work_func);
+	schedule_delayed_work(&ntx_batt_work, NTX_BATT_POLL_SECS * HZ);
 	ret = request_irq(irq, msp_int, 0, "msp_int", 0);
 	if (ret)
 		pr_info("register MSP430 interrupt failed\n");
@@ -2639,6 +2764,8 @@ static int __init initDriver(void)
 
     gpio_initials();
 
+	if (0 != gptHWCFG->m_val.bFrontLight)
+		fl_bl_register(driverDevice.this_device);
 
 	//NTX_GPIO_KEYS //[
     if(NTXHWCFG_TST_FLAG(gptHWCFG->m_val.bPCB_Flags,0)){
@@ -2695,6 +2822,10 @@ static int __init initDriver(void)
 	init_timer(&blue_led_timer);
 	red_led_timer.function = red_led_blink_func;
 	init_timer(&red_led_timer);
+	// let the blink timers share wakeups, 40ms of jitter is not visible
+	set_timer_slack (&green_led_timer, HZ/25);
+	set_timer_slack (&blue_led_timer, HZ/25);
+	set_timer_slack (&red_led_timer, HZ/25);
 
 //	Angor: turn off LED blinking
 	LED_conitnuous = 0;
@@ -2704,6 +2835,10 @@ static int __init initDriver(void)
 	return 0;
 }
 static void __exit exitDriver(void) {
+#ifdef CONFIG_BACKLIGHT_CLASS_DEVICE
+	if (fl_bl)
+		backlight_device_unregister(fl_bl);
+#endif
 	misc_deregister(&driverDevice);
 }
 MODULE_LICENSE("GPL");
@@ -1861,6 +1861,15 @@ static struct imxi2c_platform_data mxci2c_100K_data = {
 static struct imxi2c_platform_data mxci2c_50K_data = {
        .bitrate = 50000,
 };
+/*
+ * Touch bus: the zForce, elan/it7260, MSP430 touch and the g-sensor all
+ * handle fast mode.  Run it at 400K and let the driver drop back to the
+ * proven 50K if a panel cable can't take it.
+ */
+static struct imxi2c_platform_data mxci2c_touch_data = {
+       .bitrate = 50000,
+       .fast_bitrate = 400000,
+};
 
 static MXC_GPIO_CFGS mma7660_gpio5_27_cfgs = {
 	.tPad_Cfg = MX50_PAD_SD3_D7__GPIO_5_27,
@@ -2339,7 +2348,10 @@ static char *usb_functions_rndis[] = {
 static char *usb_functions_all[] = {
 	"rndis",
 	"usb_mass_storage",
-	"adb"
+	"adb",
+#ifdef CONFIG_USB_ANDROID_MTP
+	"mtp",
+#endif
 };
 
 static struct android_usb_product usb_products[] = {
@@ -2909,13 +2921,14 @@ static void __init mxc_board_init(void)
 //	if (board_is_mx50_rd3())
 //		bus_freq_data.gp_reg_id = "SW1A";
 	mxc_register_device(&busfreq_device, &bus_freq_data);
+	mxc_register_device(&sdram_autogating_device, NULL);
 
 	mxc_register_device(&mxc_dma_device, NULL);
 	mxc_register_device(&mxs_dma_apbh_device, &dma_apbh_data);
 //	mxc_register_device(&mxc_wdt_device, NULL);
 //	mxc_register_device(&mxci2c_devices[0], &mxci2c_data);
 	//mxc_register_device(&mxci2c_devices[0], &mxci2c_100K_data);
-	mxc_register_device(&mxci2c_devices[0], &mxci2c_50K_data);
+	mxc_register_device(&mxci2c_devices[0], &mxci2c_touch_data);
 //	mxc_register_device(&mxci2c_devices[1], &mxci2c_data);
 	mxc_register_device(&mxci2c_devices[1], &mxci2c_100K_data);
 	mxc_register_device(&mxci2c_devices[2], &mxci2c_100K_data);
@@ -3218,6 +3231,29 @@ static void __init fixup_android_board(struct machine_desc *desc, struct tag *ta
 // Angor
 #endif
 
+/*
+ * Display and touch interrupts first, SDIO (WiFi, SD) and USB, whose
+ * handlers can run long during transfers, last.
+ */
+static const struct tzic_irq_priority mx50_rdp_irq_priorities[] = {
+	{ MXC_INT_EPDC,		TZIC_PRIO_HIGH },
+	{ MXC_INT_GPIO5_LOW,	TZIC_PRIO_HIGH },	/* TOUCH_INT */
+	{ MXC_INT_GPIO5_HIGH,	TZIC_PRIO_HIGH },	/* C_TOUCH_INT */
+	{ MXC_INT_MMC_SDHC1,	TZIC_PRIO_LOW },
+	{ MXC_INT_MMC_SDHC2,	TZIC_PRIO_LOW },
+	{ MXC_INT_MMC_SDHC3,	TZIC_PRIO_LOW },
+	{ MXC_INT_MMC_SDHC4,	TZIC_PRIO_LOW },
+	{ MXC_INT_USB_H1,	TZIC_PRIO_LOW },
+	{ MXC_INT_USB_OTG,	TZIC_PRIO_LOW },
+};
+
+static void __init mx50_rdp_init_irq(void)
+{
+	mx5_init_irq();
+	mxc_tzic_set_priorities(mx50_rdp_irq_priorities,
+				ARRAY_SIZE(mx50_rdp_irq_priorities));
+}
+
 /*
  * The following uses standard kernel macros define in arch.h in order to
  * initialize __mach_desc_MX50_RDP data structure.
@@ -3230,7 +3266,7 @@ MACHINE_START(MX50_RDP, "Freescale MX50 Reference Design Platform")
 	.fixup = fixup_mxc_board,
 //#endif
 	.map_io = mx5_map_io,
-	.init_irq = mx5_init_irq,
+	.init_irq = mx50_rdp_init_irq,
 	.init_machine = mxc_board_init,
 	.timer = &mxc_timer,
 MACHINE_END
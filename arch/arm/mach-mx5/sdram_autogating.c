@@ -17,6 +17,8 @@
  * @brief Enable auto clock gating of the EMI_FAST clock using M4IF.
  *
  * The APIs are for enabling and disabling automatic clock gating of EMI_FAST.
+ * On MX50, which has no M4IF gating, they control the automatic entry of
+ * the DDR into self-refresh (DATABAHN low power mode 4) instead.
  *
  * @ingroup PM
  */
@@ -26,6 +28,12 @@
 #include <linux/delay.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
+#include <linux/dma-mapping.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 #include <mach/hardware.h>
 #include <mach/clock.h>
 #include <mach/sdram_autogating.h>
@@ -34,6 +42,12 @@
 static struct device *sdram_autogating_dev;
 #define M4IF_CNTL_REG0		0x8c
 #define M4IF_CNTL_REG1		0x90
+#define M4IF_PSV_TIMER_MASK	0xFF		/* fast arbitration power saving */
+
+#define DATABAHN_CTL_LPM4	(1 << 1)	/* LOWPOWER_CONTROL, self-refresh */
+#define DATABAHN_CKE_STATUS	(1 << 16)	/* CTL_REG63, CKE low in LPM */
+
+extern void __iomem *databahn_base;
 
 /* Flag used to indicate if SDRAM M4IF autoclock gating feature is active. */
 static int sdram_autogating_is_active;
@@ -44,33 +58,206 @@ void start_sdram_autogating(void);
 void stop_sdram_autogating(void);
 int sdram_autogating_active(void);
 
+/*
+ * The controller gates the EMI clock (M4IF) or puts the DDR in
+ * self-refresh (DATABAHN) after an idle count without any access.  A
+ * short count saves the most between bursts, but EPDC scanout during an
+ * update leaves many short gaps, and each of them then costs an exit.
+ * So while the bandwidth monitor (mxs-perfmon, through
+ * bus_freq_update_bandwidth()) reports at least busy_mbps, and for
+ * SDRAM_AG_HOLD after that, the longer busy count is used.
+ */
+enum {
+	SDRAM_AG_OFF,
+	SDRAM_AG_IDLE,
+	SDRAM_AG_BUSY,
+	SDRAM_AG_LEVELS,
+};
+
+static const char *sdram_ag_level_name[SDRAM_AG_LEVELS] = {
+	"off", "idle", "busy",
+};
+
+#define SDRAM_AG_M4IF_IDLE_CNT	0x09
+#define SDRAM_AG_M4IF_BUSY_CNT	0x48
+#define SDRAM_AG_DDR_BUSY_CNT	1024
+#define SDRAM_AG_BUSY_MBPS	50
+#define SDRAM_AG_HOLD		(HZ / 2)
+#define SDRAM_AG_PROBE_IDLE_US	1000
+
+static DEFINE_SPINLOCK(sdram_ag_lock);
+static unsigned int sdram_ag_cnt[SDRAM_AG_LEVELS];
+static unsigned int sdram_ag_cnt_max;
+static unsigned int sdram_ag_busy_mbps = SDRAM_AG_BUSY_MBPS;
+static int sdram_ag_busy;
+static unsigned long sdram_ag_busy_until;
+static int sdram_ag_level;
+static ktime_t sdram_ag_since;
+
+static struct {
+	u64		residency_ns[SDRAM_AG_LEVELS];
+	unsigned long	switches;
+	unsigned long	probes;
+	unsigned long	probes_missed;
+	u64		wake_ns;
+	u64		wake_ns_max;
+	u64		awake_ns;
+} sdram_ag_stats;
+
+/* uncached, so that the probe's reads really go to the DDR */
+static u32 *sdram_ag_probe_buf;
+static dma_addr_t sdram_ag_probe_phys;
+
+static void set_idle_count(unsigned int cnt)
+{
+	u32 reg;
+
+	if (cpu_is_mx50()) {
+		reg = __raw_readl(databahn_base + DATABAHN_CTL_REG21);
+		reg &= ~LOWPOWER_EXTERNAL_CNT_MASK;
+		reg |= cnt << LOWPOWER_EXTERNAL_CNT_OFFSET;
+		__raw_writel(reg, databahn_base + DATABAHN_CTL_REG21);
+	} else {
+		/* Set the Fast arbitration Power saving timer */
+		reg = __raw_readl(m4if_base + M4IF_CNTL_REG1);
+		reg &= ~M4IF_PSV_TIMER_MASK;
+		reg |= cnt;
+		__raw_writel(reg, m4if_base + M4IF_CNTL_REG1);
+	}
+}
+
+static int wanted_level(void)
+{
+	if (sdram_ag_busy && time_after_eq(jiffies, sdram_ag_busy_until))
+		sdram_ag_busy = 0;
+	return sdram_ag_busy ? SDRAM_AG_BUSY : SDRAM_AG_IDLE;
+}
+
+/* Account the time spent at the current level and move to @level. */
+static void set_level(int level)
+{
+	ktime_t now = ktime_get();
+
+	sdram_ag_stats.residency_ns[sdram_ag_level] +=
+		ktime_to_ns(ktime_sub(now, sdram_ag_since));
+	sdram_ag_since = now;
+
+	if (level == sdram_ag_level)
+		return;
+	if (level != SDRAM_AG_OFF)
+		set_idle_count(sdram_ag_cnt[level]);
+	sdram_ag_level = level;
+	sdram_ag_stats.switches++;
+}
+
 static void enable(void)
 {
+	unsigned long flags;
 	u32 reg;
 
-	/* Set the Fast arbitration Power saving timer */
-	reg = __raw_readl(m4if_base + M4IF_CNTL_REG1);
-	reg &= ~0xFF;
-	reg |= 0x09;
-	__raw_writel(reg, m4if_base + M4IF_CNTL_REG1);
-	/*Allow for automatic gating of the EMI internal clock.
-	 * If this is done, emi_intr CCGR bits should be set to 11.
-	 */
-	reg = __raw_readl(m4if_base + M4IF_CNTL_REG0);
-	reg &= ~0x5;
-	__raw_writel(reg, m4if_base + M4IF_CNTL_REG0);
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	set_level(wanted_level());
+
+	if (cpu_is_mx50()) {
+		reg = __raw_readl(databahn_base + DATABAHN_CTL_REG20);
+		reg |= DATABAHN_CTL_LPM4;
+		__raw_writel(reg, databahn_base + DATABAHN_CTL_REG20);
+	} else {
+		/*Allow for automatic gating of the EMI internal clock.
+		 * If this is done, emi_intr CCGR bits should be set to 11.
+		 */
+		reg = __raw_readl(m4if_base + M4IF_CNTL_REG0);
+		reg &= ~0x5;
+		__raw_writel(reg, m4if_base + M4IF_CNTL_REG0);
+	}
 
 	sdram_autogating_is_active = 1;
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
 }
 
 static void disable(void)
 {
+	unsigned long flags;
 	u32 reg;
 
-	reg = __raw_readl(m4if_base + M4IF_CNTL_REG0);
-	reg |= 0x4;
-	__raw_writel(reg, m4if_base + M4IF_CNTL_REG0);
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	if (cpu_is_mx50()) {
+		reg = __raw_readl(databahn_base + DATABAHN_CTL_REG20);
+		reg &= ~DATABAHN_CTL_LPM4;
+		__raw_writel(reg, databahn_base + DATABAHN_CTL_REG20);
+	} else {
+		reg = __raw_readl(m4if_base + M4IF_CNTL_REG0);
+		reg |= 0x4;
+		__raw_writel(reg, m4if_base + M4IF_CNTL_REG0);
+	}
+	set_level(SDRAM_AG_OFF);
 	sdram_autogating_is_active = 0;
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
+}
+
+/*!
+ * Choose the idle count for the DDR demand reported by the bandwidth
+ * monitor.
+ *
+ * @param   mbps   read plus write MB/s of all sampled masters, 0 when
+ *                 the monitor stops
+ */
+void sdram_autogating_update_bandwidth(unsigned int mbps)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	if (sdram_ag_busy_mbps && mbps >= sdram_ag_busy_mbps) {
+		sdram_ag_busy = 1;
+		sdram_ag_busy_until = jiffies + SDRAM_AG_HOLD;
+	} else if (!mbps)
+		sdram_ag_busy = 0;
+
+	if (sdram_autogating_is_active && sdram_autogating_dev)
+		set_level(wanted_level());
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
+}
+
+/*
+ * Measure what leaving the low power state costs: time one uncached read
+ * with the DDR awake, stay off the bus for longer than the idle count,
+ * then time another.  Other masters may keep the DDR awake meanwhile; on
+ * MX50 CKE tells, and such probes only count as missed.
+ */
+static void sdram_wake_probe(void)
+{
+	u32 *p = sdram_ag_probe_buf;
+	unsigned long flags;
+	u64 t0, awake, wake;
+	int asleep;
+
+	local_irq_save(flags);
+	(void)ACCESS_ONCE(*p);
+	t0 = sched_clock();
+	(void)ACCESS_ONCE(*p);
+	awake = sched_clock() - t0;
+
+	udelay(SDRAM_AG_PROBE_IDLE_US);
+	asleep = sdram_autogating_is_active;
+	if (cpu_is_mx50() && (__raw_readl(databahn_base + DATABAHN_CTL_REG63)
+			      & DATABAHN_CKE_STATUS))
+		asleep = 0;
+
+	t0 = sched_clock();
+	(void)ACCESS_ONCE(*p);
+	wake = sched_clock() - t0;
+	local_irq_restore(flags);
+
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	sdram_ag_stats.probes++;
+	if (asleep) {
+		sdram_ag_stats.wake_ns += wake;
+		if (wake > sdram_ag_stats.wake_ns_max)
+			sdram_ag_stats.wake_ns_max = wake;
+		sdram_ag_stats.awake_ns += awake;
+	} else
+		sdram_ag_stats.probes_missed++;
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
 }
 
 int sdram_autogating_active()
@@ -126,6 +313,151 @@ static ssize_t sdram_autogating_enable_store(struct device *dev,
 static DEVICE_ATTR(enable, 0644, sdram_autogating_enable_show,
 			sdram_autogating_enable_store);
 
+static ssize_t sdram_ag_cnt_store(int level, const char *buf, size_t size)
+{
+	unsigned long val, flags;
+
+	if (strict_strtoul(buf, 0, &val) || val > sdram_ag_cnt_max)
+		return -EINVAL;
+
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	sdram_ag_cnt[level] = val;
+	if (sdram_ag_level == level)
+		set_idle_count(val);
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
+	return size;
+}
+
+static ssize_t sdram_autogating_idle_cnt_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sdram_ag_cnt[SDRAM_AG_IDLE]);
+}
+
+static ssize_t sdram_autogating_idle_cnt_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	return sdram_ag_cnt_store(SDRAM_AG_IDLE, buf, size);
+}
+
+static DEVICE_ATTR(idle_cnt, 0644, sdram_autogating_idle_cnt_show,
+			sdram_autogating_idle_cnt_store);
+
+static ssize_t sdram_autogating_busy_cnt_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sdram_ag_cnt[SDRAM_AG_BUSY]);
+}
+
+static ssize_t sdram_autogating_busy_cnt_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	return sdram_ag_cnt_store(SDRAM_AG_BUSY, buf, size);
+}
+
+static DEVICE_ATTR(busy_cnt, 0644, sdram_autogating_busy_cnt_show,
+			sdram_autogating_busy_cnt_store);
+
+static ssize_t sdram_autogating_busy_mbps_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sdram_ag_busy_mbps);
+}
+
+static ssize_t sdram_autogating_busy_mbps_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+	sdram_ag_busy_mbps = val;
+	return size;
+}
+
+static DEVICE_ATTR(busy_mbps, 0644, sdram_autogating_busy_mbps_show,
+			sdram_autogating_busy_mbps_store);
+
+static ssize_t sdram_autogating_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	u64 res[SDRAM_AG_LEVELS], wake, wake_max, awake;
+	unsigned long flags, switches, probes, missed, ok;
+	int i, level, len = 0;
+
+	spin_lock_irqsave(&sdram_ag_lock, flags);
+	set_level(sdram_ag_level);
+	level = sdram_ag_level;
+	memcpy(res, sdram_ag_stats.residency_ns, sizeof(res));
+	switches = sdram_ag_stats.switches;
+	probes = sdram_ag_stats.probes;
+	missed = sdram_ag_stats.probes_missed;
+	wake = sdram_ag_stats.wake_ns;
+	wake_max = sdram_ag_stats.wake_ns_max;
+	awake = sdram_ag_stats.awake_ns;
+	spin_unlock_irqrestore(&sdram_ag_lock, flags);
+
+	ok = probes - missed;
+	if (ok) {
+		wake = div_u64(wake, ok);
+		awake = div_u64(awake, ok);
+	}
+
+	len += sprintf(buf + len, "level: %s\n", sdram_ag_level_name[level]);
+	for (i = 0; i < SDRAM_AG_LEVELS; i++)
+		len += sprintf(buf + len, "%s_ms: %llu\n",
+			       sdram_ag_level_name[i],
+			       (unsigned long long)div_u64(res[i],
+							   NSEC_PER_MSEC));
+	len += sprintf(buf + len, "switches: %lu\n", switches);
+	len += sprintf(buf + len, "wake_probes: %lu\nwake_missed: %lu\n",
+		       probes, missed);
+	len += sprintf(buf + len, "wake_ns: %llu\nwake_max_ns: %llu\n"
+		       "awake_ns: %llu\n", (unsigned long long)wake,
+		       (unsigned long long)wake_max,
+		       (unsigned long long)awake);
+	return len;
+}
+
+static DEVICE_ATTR(stats, 0444, sdram_autogating_stats_show, NULL);
+
+static ssize_t sdram_autogating_wake_probe_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned long n;
+
+	if (strict_strtoul(buf, 0, &n) || !n || n > 100)
+		return -EINVAL;
+	if (!sdram_ag_probe_buf)
+		return -ENOMEM;
+
+	while (n--) {
+		sdram_wake_probe();
+		msleep(10);
+	}
+	return size;
+}
+
+static DEVICE_ATTR(wake_probe, 0200, NULL, sdram_autogating_wake_probe_store);
+
+static struct attribute *sdram_autogating_attrs[] = {
+	&dev_attr_enable.attr,
+	&dev_attr_idle_cnt.attr,
+	&dev_attr_busy_cnt.attr,
+	&dev_attr_busy_mbps.attr,
+	&dev_attr_stats.attr,
+	&dev_attr_wake_probe.attr,
+	NULL,
+};
+
+static struct attribute_group sdram_autogating_attr_group = {
+	.attrs = sdram_autogating_attrs,
+};
+
 /*!
  * This is the probe routine for the auto clockgating of sdram driver.
  *
@@ -139,23 +471,53 @@ static int __devinit sdram_autogating_probe(struct platform_device *pdev)
 	struct resource *res;
 	int err = 0;
 
-	sdram_autogating_dev = &pdev->dev;
-
-	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
-	if (!res) {
-		return -ENOMEM;
+	if (cpu_is_mx50()) {
+		/* init_ddr_settings() has set up self-refresh entry */
+		sdram_ag_cnt_max = LOWPOWER_EXTERNAL_CNT_MASK >>
+					LOWPOWER_EXTERNAL_CNT_OFFSET;
+		sdram_ag_cnt[SDRAM_AG_IDLE] =
+			(__raw_readl(databahn_base + DATABAHN_CTL_REG21) &
+			 LOWPOWER_EXTERNAL_CNT_MASK) >>
+					LOWPOWER_EXTERNAL_CNT_OFFSET;
+		sdram_ag_cnt[SDRAM_AG_BUSY] = SDRAM_AG_DDR_BUSY_CNT;
+		sdram_autogating_is_active =
+			!!(__raw_readl(databahn_base + DATABAHN_CTL_REG20) &
+			   DATABAHN_CTL_LPM4);
+	} else {
+		res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+		if (!res) {
+			return -ENOMEM;
+		}
+		m4if_base = ioremap(res->start, res->end - res->start + 1);
+
+		sdram_ag_cnt_max = M4IF_PSV_TIMER_MASK;
+		sdram_ag_cnt[SDRAM_AG_IDLE] = SDRAM_AG_M4IF_IDLE_CNT;
+		sdram_ag_cnt[SDRAM_AG_BUSY] = SDRAM_AG_M4IF_BUSY_CNT;
+		sdram_autogating_is_active = 0;
 	}
-	m4if_base = ioremap(res->start, res->end - res->start + 1);
+	sdram_ag_level = sdram_autogating_is_active ? SDRAM_AG_IDLE :
+						      SDRAM_AG_OFF;
+	sdram_ag_since = ktime_get();
 
-	err = sysfs_create_file(&sdram_autogating_dev->kobj,
-							&dev_attr_enable.attr);
+	/* only the wake probe needs it */
+	sdram_ag_probe_buf = dma_alloc_coherent(&pdev->dev, PAGE_SIZE,
+						&sdram_ag_probe_phys,
+						GFP_KERNEL);
+
+	err = sysfs_create_group(&pdev->dev.kobj,
+				 &sdram_autogating_attr_group);
 	if (err) {
 		printk(KERN_ERR
 		       "Unable to register sysdev entry for sdram_autogating");
+		if (sdram_ag_probe_buf)
+			dma_free_coherent(&pdev->dev, PAGE_SIZE,
+					  sdram_ag_probe_buf,
+					  sdram_ag_probe_phys);
+		sdram_ag_probe_buf = NULL;
 		return err;
 	}
 
-	sdram_autogating_is_active = 0;
+	sdram_autogating_dev = &pdev->dev;
 
 	return 0;
 }
@@ -186,7 +548,11 @@ static int __init sdram_autogating_init(void)
 
 static void __exit sdram_autogating_cleanup(void)
 {
-	sysfs_remove_file(&sdram_autogating_dev->kobj, &dev_attr_enable.attr);
+	sysfs_remove_group(&sdram_autogating_dev->kobj,
+			   &sdram_autogating_attr_group);
+	if (sdram_ag_probe_buf)
+		dma_free_coherent(sdram_autogating_dev, PAGE_SIZE,
+				  sdram_ag_probe_buf, sdram_ag_probe_phys);
 
 	/* Unregister the device structure */
 	platform_driver_unregister(&sdram_autogating_driver);
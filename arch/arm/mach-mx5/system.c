@@ -16,6 +16,7 @@
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
 #include <linux/pmic_external.h>
+#include <linux/hrtimer.h>
 #include <asm/io.h>
 #include <mach/hardware.h>
 #include <mach/clock.h>
@@ -23,6 +24,7 @@
 #include <asm/proc-fns.h>
 #include <asm/system.h>
 #include "crm_regs.h"
+#include "cpuidle.h"
 
 /*!
  * @defgroup MSL_MX51 i.MX51 Machine Specific Layer (MSL)
@@ -171,78 +173,130 @@ EXPORT_SYMBOL(mxc_pg_disable);
  * May allow dynamically changing the idle mode.
  */
 static int arch_idle_mode = WAIT_UNCLOCKED_POWER_OFF;
+
+/*!
+ * Enter one idle period at the given depth, with IRQs disabled.
+ *
+ * MX5_IDLE_WFI:	WFI with the ARM clock running.
+ * MX5_IDLE_GATED:	WFI with the ARM clock gated and the core power
+ *			gated (SRPG); on MX50 DDR goes to self-refresh
+ *			from IRAM when nothing holds ddr_clk.
+ * MX5_IDLE_LPBUS:	as MX5_IDLE_GATED, and in low bus frequency mode
+ *			ARM is also moved to the 24MHz XTAL while in WFI.
+ *
+ * @sleep and @wake, if not NULL, are set just before the WFI and right
+ * after it returns, so callers can tell the transition cost from the
+ * time actually spent asleep. Returns the depth really used.
+ */
+int mx5_cpu_idle(int depth, ktime_t *sleep, ktime_t *wake)
+{
+	if (unlikely(mxc_jtag_enabled)) {
+		if (sleep)
+			*sleep = *wake = ktime_get();
+		return MX5_IDLE_WFI;
+	}
+
+	if (depth == MX5_IDLE_WFI) {
+		mxc_cpu_lp_set(WAIT_CLOCKED);
+		if (sleep)
+			*sleep = ktime_get();
+		cpu_do_idle();
+		if (wake)
+			*wake = ktime_get();
+		return depth;
+	}
+
+	if (!low_bus_freq_mode || !cpu_is_mx50())
+		depth = MX5_IDLE_GATED;
+
+	if (ddr_clk == NULL)
+		ddr_clk = clk_get(NULL, "ddr_clk");
+	if (gpc_dvfs_clk == NULL)
+		gpc_dvfs_clk = clk_get(NULL, "gpc_dvfs_clk");
+	/* gpc clock is needed for SRPG */
+	clk_enable(gpc_dvfs_clk);
+	mxc_cpu_lp_set(arch_idle_mode);
+
+	if (cpu_is_mx50() && (clk_get_usecount(ddr_clk) == 0)) {
+		if (sys_clk == NULL)
+			sys_clk = clk_get(NULL, "sys_clk");
+
+		memcpy(wait_in_iram_base, mx50_wait, SZ_4K);
+		wait_in_iram = (void *)wait_in_iram_base;
+		if (depth == MX5_IDLE_LPBUS) {
+			u32 reg, cpu_podf;
+
+			reg = __raw_readl(apll_base + 0x50);
+			reg = 0x120490;
+			__raw_writel(reg, apll_base + 0x50);
+			reg = __raw_readl(apll_base + 0x80);
+			reg |= 1;
+			__raw_writel(reg, apll_base + 0x80);
+
+			if (mx50_ddr_type != MX50_DDR2) {
+
+			/* Move ARM to be sourced from 24MHz XTAL.
+			 * when ARM is in WFI.
+			 */
+			if (pll1_sw_clk == NULL)
+				pll1_sw_clk = clk_get(NULL,
+						"pll1_sw_clk");
+			if (osc == NULL)
+				osc = clk_get(NULL, "lp_apm");
+			if (pll1_main_clk == NULL)
+				pll1_main_clk = clk_get(NULL,
+						"pll1_main_clk");
+
+			clk_set_parent(pll1_sw_clk, osc);
+			/* Set the ARM-PODF divider to 1. */
+			cpu_podf = __raw_readl(MXC_CCM_CACRR);
+			__raw_writel(0x01, MXC_CCM_CACRR);
+
+			}
+
+			if (sleep)
+				*sleep = ktime_get();
+			wait_in_iram(ccm_base, databahn_base,
+				clk_get_usecount(sys_clk));
+			if (wake)
+				*wake = ktime_get();
+
+			if (mx50_ddr_type != MX50_DDR2) {
+
+			/* Set the ARM-POD divider back
+			 * to the original.
+			 */
+			__raw_writel(cpu_podf, MXC_CCM_CACRR);
+			clk_set_parent(pll1_sw_clk, pll1_main_clk);
+
+			}
+		} else {
+			if (sleep)
+				*sleep = ktime_get();
+			wait_in_iram(ccm_base, databahn_base,
+				clk_get_usecount(sys_clk));
+			if (wake)
+				*wake = ktime_get();
+		}
+	} else {
+		if (sleep)
+			*sleep = ktime_get();
+		cpu_do_idle();
+		if (wake)
+			*wake = ktime_get();
+	}
+	clk_disable(gpc_dvfs_clk);
+	clk_put(ddr_clk);
+	return depth;
+}
+
 /*!
  * This function puts the CPU into idle mode. It is called by default_idle()
- * in process.c file.
+ * in process.c file, unless the cpuidle driver has taken over.
  */
 void arch_idle(void)
 {
-	if (likely(!mxc_jtag_enabled)) {
-		if (ddr_clk == NULL)
-			ddr_clk = clk_get(NULL, "ddr_clk");
-		if (gpc_dvfs_clk == NULL)
-			gpc_dvfs_clk = clk_get(NULL, "gpc_dvfs_clk");
-		/* gpc clock is needed for SRPG */
-		clk_enable(gpc_dvfs_clk);
-		mxc_cpu_lp_set(arch_idle_mode);
-
-		if (cpu_is_mx50() && (clk_get_usecount(ddr_clk) == 0)) {
-			if (sys_clk == NULL)
-				sys_clk = clk_get(NULL, "sys_clk");
-
-			memcpy(wait_in_iram_base, mx50_wait, SZ_4K);
-			wait_in_iram = (void *)wait_in_iram_base;
-			if (low_bus_freq_mode) {
-				u32 reg, cpu_podf;
-
-				reg = __raw_readl(apll_base + 0x50);
-				reg = 0x120490;
-				__raw_writel(reg, apll_base + 0x50);
-				reg = __raw_readl(apll_base + 0x80);
-				reg |= 1;
-				__raw_writel(reg, apll_base + 0x80);
-
-				if (mx50_ddr_type != MX50_DDR2) {
-				
-				/* Move ARM to be sourced from 24MHz XTAL.
-				 * when ARM is in WFI.
-				 */
-				if (pll1_sw_clk == NULL)
-					pll1_sw_clk = clk_get(NULL,
-							"pll1_sw_clk");
-				if (osc == NULL)
-					osc = clk_get(NULL, "lp_apm");
-				if (pll1_main_clk == NULL)
-					pll1_main_clk = clk_get(NULL,
-							"pll1_main_clk");
-
-				clk_set_parent(pll1_sw_clk, osc);
-				/* Set the ARM-PODF divider to 1. */
-				cpu_podf = __raw_readl(MXC_CCM_CACRR);
-				__raw_writel(0x01, MXC_CCM_CACRR);
-
-				}
-
-				wait_in_iram(ccm_base, databahn_base,
-					clk_get_usecount(sys_clk));
-
-				if (mx50_ddr_type != MX50_DDR2) {
-
-				/* Set the ARM-POD divider back
-				 * to the original.
-				 */
-				__raw_writel(cpu_podf, MXC_CCM_CACRR);
-				clk_set_parent(pll1_sw_clk, pll1_main_clk);
-
-				}
-			} else
-				wait_in_iram(ccm_base, databahn_base,
-					clk_get_usecount(sys_clk));
-		} else
-			cpu_do_idle();
-		clk_disable(gpc_dvfs_clk);
-		clk_put(ddr_clk);
-	}
+	mx5_cpu_idle(MX5_IDLE_LPBUS, NULL, NULL);
 }
 
 static int __mxs_reset_block(void __iomem *hwreg, int just_enable)
@@ -40,7 +40,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 
 	kfrom = kmap_atomic(from, KM_USER0);
 	kto = kmap_atomic(to, KM_USER1);
-	copy_page(kto, kfrom);
+	copy_page_neon(kto, kfrom);
 	__cpuc_flush_dcache_area(kto, PAGE_SIZE);
 	kunmap_atomic(kto, KM_USER1);
 	kunmap_atomic(kfrom, KM_USER0);
@@ -53,7 +53,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 static void v6_clear_user_highpage_nonaliasing(struct page *page, unsigned long vaddr)
 {
 	void *kaddr = kmap_atomic(page, KM_USER0);
-	clear_page(kaddr);
+	memset_neon(kaddr, 0, PAGE_SIZE);
 	kunmap_atomic(kaddr, KM_USER0);
 }
 
@@ -41,6 +41,7 @@
 #include <linux/input.h>
 #include <linux/platform_device.h>
 #include <linux/cpufreq.h>
+#include <linux/hrtimer.h>
 #include <mach/hardware.h>
 #include <mach/mxc_dvfs.h>
 
@@ -100,6 +101,7 @@ struct timeval core_prev_intr;
 void dump_dvfs_core_regs(void);
 void stop_dvfs(void);
 static struct delayed_work dvfs_core_handler;
+static struct dvfs_stats core_stats;
 
 /*
  * Clock structures
@@ -175,6 +177,7 @@ static int set_cpu_freq(int wp)
 	u32 reg1;
 	u32 en_sw_dvfs = 0;
 	unsigned long flags;
+	ktime_t start = ktime_get();
 
 	if (cpu_wp_tbl[wp].pll_rate != cpu_wp_tbl[old_wp].pll_rate) {
 		org_cpu_rate = clk_get_rate(cpu_clk);
@@ -361,6 +364,7 @@ static int set_cpu_freq(int wp)
 #if defined(CONFIG_CPU_FREQ)
 		cpufreq_trig_needed = 1;
 #endif
+	dvfs_stats_transition(&core_stats, wp, start);
 	old_wp = wp;
 	return ret;
 }
@@ -385,6 +389,7 @@ static int start_dvfs(void)
 			break;
 	} while (--curr_wp >= 0);
 	old_wp = curr_wp;
+	dvfs_stats_set(&core_stats, curr_wp);
 
 	dvfs_load_config(curr_wp);
 
@@ -513,6 +518,9 @@ static void dvfs_core_work_handler(struct work_struct *work)
 	/* If FSVAI indicate freq down,
 	   check arm-clk is not in lowest frequency*/
 	if (fsvai == FSVAI_FREQ_DECREASE) {
+		/* Keep a recent step-up for a while to avoid bouncing */
+		if (dvfs_stats_hold_down(&core_stats))
+			goto END;
 		if (curr_cpu == cpu_wp_tbl[cpu_wp_nr - 1].cpu_rate) {
 			minf = 1;
 			if (low_bus_freq_mode)
@@ -753,6 +761,36 @@ static ssize_t downcount_store(struct device *dev,
 	return size;
 }
 
+static int dvfs_core_wp_label(int wp, char *buf)
+{
+	return sprintf(buf, "%uMHz %umV", cpu_wp_tbl[wp].cpu_rate / 1000000,
+		       cpu_wp_tbl[wp].cpu_voltage / 1000);
+}
+
+static ssize_t dvfs_stats_sysfs_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return dvfs_stats_show(&core_stats, buf, dvfs_core_wp_label);
+}
+
+static ssize_t downhold_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", core_stats.down_hold_ms);
+}
+
+static ssize_t downhold_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t size)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+	core_stats.down_hold_ms = val;
+
+	return size;
+}
 
 static ssize_t dvfs_enable_show(struct device *dev,
 				struct device_attribute *attr, char *buf)
@@ -801,6 +839,8 @@ static DEVICE_ATTR(show_regs, 0644, dvfs_regs_show, dvfs_regs_store);
 static DEVICE_ATTR(down_threshold, 0644, downthreshold_show,
 						downthreshold_store);
 static DEVICE_ATTR(down_count, 0644, downcount_show, downcount_store);
+static DEVICE_ATTR(stats, 0444, dvfs_stats_sysfs_show, NULL);
+static DEVICE_ATTR(down_hold_ms, 0644, downhold_show, downhold_store);
 
 /*!
  * This is the probe routine for the DVFS driver.
@@ -914,8 +954,23 @@ static int __devinit mxc_dvfs_core_probe(struct platform_device *pdev)
 		goto err3;
 	}
 
+	err = sysfs_create_file(&dvfs_dev->kobj, &dev_attr_stats.attr);
+	if (err) {
+		printk(KERN_ERR
+		       "DVFS: Unable to register sysdev entry for DVFS");
+		goto err3;
+	}
+
+	err = sysfs_create_file(&dvfs_dev->kobj, &dev_attr_down_hold_ms.attr);
+	if (err) {
+		printk(KERN_ERR
+		       "DVFS: Unable to register sysdev entry for DVFS");
+		goto err3;
+	}
+
 	/* Set the current working point. */
 	cpu_wp_tbl = get_cpu_wp(&cpu_wp_nr);
+	dvfs_stats_init(&core_stats, "core", cpu_wp_nr);
 	old_wp = 0;
 	curr_wp = 0;
 	dvfs_core_resume = 0;
@@ -42,6 +42,7 @@
 #include <linux/workqueue.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/hrtimer.h>
 
 #include <mach/hardware.h>
 #include <mach/mxc_dvfs.h>
@@ -118,6 +119,7 @@ struct dvfs_wp dvfs_per_setpoint[] = {{33, 7, 33, 20, 40, 0x10},
 				{18, 0, 33, 25, 10, 0x10},
 				/* When LP is at 24MHz */
 				{8, 0, 10, 5, 5, 0x2E},};
+static struct dvfs_stats per_stats;
 
 enum {
 	FSVAI_FREQ_NOCHANGE = 0x0,
@@ -276,6 +278,7 @@ static void dvfs_per_handler(struct work_struct *work)
 	u32 ret;
 	unsigned long flags;
 	int retry = 20;
+	ktime_t start = ktime_get();
 
 	/* Check DVFS frequency adjustment interrupt status */
 	reg = __raw_readl(dvfsper_plt_data->membase + MXC_DVFS_PER_PMCR0);
@@ -291,6 +294,9 @@ static void dvfs_per_handler(struct work_struct *work)
 #endif
 	/* If FSVAI indicate freq down. */
 	if (fsvai == FSVAI_FREQ_DECREASE) {
+		/* Keep a recent step-up for a while to avoid bouncing */
+		if (dvfs_stats_hold_down(&per_stats))
+			goto END;
 		if (cpu_is_mx51()) {
 			/*Change the DDR freq to 133Mhz. */
 			clk_set_rate(ddr_hf_clk,
@@ -362,6 +368,7 @@ static void dvfs_per_handler(struct work_struct *work)
 		udelay(100);
 #endif
 		dvfs_per_load_config();
+		dvfs_stats_transition(&per_stats, cur_setpoint, start);
 	} else if ((fsvai == FSVAI_FREQ_INCREASE) ||
 			(fsvai == FSVAI_FREQ_EMERG)) {
 #ifndef DVFS_SW_WORKAROUND
@@ -437,6 +444,7 @@ static void dvfs_per_handler(struct work_struct *work)
 #endif
 		}
 		dvfs_per_load_config();
+		dvfs_stats_transition(&per_stats, cur_setpoint, start);
 		freq_increased = 1;
 	}
 
@@ -547,6 +555,7 @@ static int start(void)
 	clk_enable(dvfs_clk);
 
 	cur_setpoint = 0;
+	dvfs_stats_set(&per_stats, cur_setpoint);
 	init_dvfs_per_controller();
 
 	/* config reg GPC_CNTR */
@@ -754,7 +763,43 @@ static ssize_t dvfsper_status_show(struct device *dev,
 	return size;
 }
 
+static int dvfs_per_wp_label(int wp, char *buf)
+{
+	static const char *const names[] = { "high", "low", "24MHz" };
+
+	return sprintf(buf, "%s", names[wp]);
+}
+
+static ssize_t dvfsper_stats_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return dvfs_stats_show(&per_stats, buf, dvfs_per_wp_label);
+}
+
+static ssize_t dvfsper_downhold_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf, "%u\n", per_stats.down_hold_ms);
+}
+
+static ssize_t dvfsper_downhold_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t size)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+	per_stats.down_hold_ms = val;
+	return size;
+}
+
 static DEVICE_ATTR(enable, 0644, dvfsper_status_show, dvfsper_enable_store);
+static DEVICE_ATTR(stats, 0444, dvfsper_stats_show, NULL);
+static DEVICE_ATTR(down_hold_ms, 0644, dvfsper_downhold_show,
+		   dvfsper_downhold_store);
 
 /*!
  * This is the probe routine for the DVFS PER driver.
@@ -831,6 +876,8 @@ static int __devinit mxc_dvfsper_probe(struct platform_device *pdev)
 	dvfsper_device_data->dvfs_clk = clk_get(NULL, dvfsper_data->clk_id);
 	dvfs_clk = dvfsper_device_data->dvfs_clk;
 
+	dvfs_stats_init(&per_stats, "per", ARRAY_SIZE(dvfs_per_setpoint));
+
 	ret = sysfs_create_file(&pdev->dev.kobj, &dev_attr_enable.attr);
 
 	if (ret) {
@@ -839,6 +886,20 @@ static int __devinit mxc_dvfsper_probe(struct platform_device *pdev)
 		goto err1;
 	}
 
+	ret = sysfs_create_file(&pdev->dev.kobj, &dev_attr_stats.attr);
+	if (ret) {
+		printk(KERN_ERR
+		       "DVFS: Unable to register sysdev entry for dvfs");
+		goto err1;
+	}
+
+	ret = sysfs_create_file(&pdev->dev.kobj, &dev_attr_down_hold_ms.attr);
+	if (ret) {
+		printk(KERN_ERR
+		       "DVFS: Unable to register sysdev entry for dvfs");
+		goto err1;
+	}
+
 	return 0;
 err1:
 	dev_err(&pdev->dev, "Failed to probe DVFS\n");
@@ -0,0 +1,182 @@
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*!
+ * @file dvfs_stats.c
+ *
+ * @brief Working point statistics and step-down hysteresis for the DVFS
+ * core and PER drivers.
+ *
+ * The GPC load tracking raises a frequency decrease request as soon as the
+ * load drops below the down threshold for downcnt samples, which during
+ * continuous page rendering means stepping down between every frame only
+ * to step back up for the next one.  Each domain therefore keeps its last
+ * step-up for at least down_hold_ms before honouring a decrease.  When a
+ * step-down still gets undone within DVFS_BOUNCE_MS the hold is doubled,
+ * up to DVFS_MAX_BACKOFF times, and it is halved again whenever a
+ * step-down lasts longer than that.
+ *
+ * @ingroup PM
+ */
+
+#include <linux/kernel.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <mach/mxc_dvfs.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/mxc_dvfs.h>
+
+#define DVFS_DOWN_HOLD_MS	50
+#define DVFS_BOUNCE_MS		250
+#define DVFS_MAX_BACKOFF	3
+
+static void dvfs_stats_account(struct dvfs_stats *s, ktime_t now)
+{
+	s->time_ns[s->cur] += ktime_to_ns(ktime_sub(now, s->last_change));
+	s->last_change = now;
+}
+
+void dvfs_stats_init(struct dvfs_stats *s, const char *name, int nr)
+{
+	memset(s, 0, sizeof(*s));
+	spin_lock_init(&s->lock);
+	s->name = name;
+	s->nr = min(nr, DVFS_STATS_MAX_WP);
+	s->last_up = 1;
+	s->last_change = ktime_get();
+	s->down_hold_ms = DVFS_DOWN_HOLD_MS;
+}
+
+/*!
+ * Resynchronise with a working point that was set outside of DVFS, e.g.
+ * when it is restarted.  Not counted as a transition.
+ */
+void dvfs_stats_set(struct dvfs_stats *s, int wp)
+{
+	unsigned long flags;
+
+	if (wp < 0 || wp >= s->nr)
+		return;
+
+	spin_lock_irqsave(&s->lock, flags);
+	dvfs_stats_account(s, ktime_get());
+	s->cur = wp;
+	s->last_up = 1;
+	spin_unlock_irqrestore(&s->lock, flags);
+}
+
+/*!
+ * Account a change to working point @wp that started at @start.
+ */
+void dvfs_stats_transition(struct dvfs_stats *s, int wp, ktime_t start)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	s64 since_us;
+	int from, up;
+
+	if (wp < 0 || wp >= s->nr)
+		return;
+
+	spin_lock_irqsave(&s->lock, flags);
+	from = s->cur;
+	if (wp == from) {
+		spin_unlock_irqrestore(&s->lock, flags);
+		return;
+	}
+	since_us = ktime_us_delta(now, s->last_change);
+	dvfs_stats_account(s, now);
+
+	up = wp < from;
+	if (up && !s->last_up) {
+		if (since_us < DVFS_BOUNCE_MS * USEC_PER_MSEC) {
+			s->bounces++;
+			if (s->backoff < DVFS_MAX_BACKOFF)
+				s->backoff++;
+		} else if (s->backoff) {
+			s->backoff--;
+		}
+	}
+	s->trans[from][wp]++;
+	s->cur = wp;
+	s->last_up = up;
+	spin_unlock_irqrestore(&s->lock, flags);
+
+	trace_dvfs_transition(s->name, from, wp,
+			      (u32)ktime_us_delta(now, start));
+}
+
+/*!
+ * @return non-zero if a decrease request should be ignored for now.
+ */
+int dvfs_stats_hold_down(struct dvfs_stats *s)
+{
+	unsigned long flags;
+	unsigned int hold_ms;
+	int held = 0;
+
+	spin_lock_irqsave(&s->lock, flags);
+	hold_ms = s->down_hold_ms << s->backoff;
+	if (s->down_hold_ms && s->last_up &&
+	    ktime_us_delta(ktime_get(), s->last_change) <
+	    (s64)hold_ms * USEC_PER_MSEC) {
+		s->held++;
+		held = 1;
+	}
+	spin_unlock_irqrestore(&s->lock, flags);
+
+	if (held)
+		trace_dvfs_hold(s->name, s->cur, hold_ms);
+	return held;
+}
+
+ssize_t dvfs_stats_show(struct dvfs_stats *s, char *buf,
+			int (*label)(int wp, char *buf))
+{
+	u64 time_ns[DVFS_STATS_MAX_WP];
+	unsigned int trans[DVFS_STATS_MAX_WP][DVFS_STATS_MAX_WP];
+	unsigned int bounces, held, hold_ms;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i, j;
+
+	spin_lock_irqsave(&s->lock, flags);
+	dvfs_stats_account(s, ktime_get());
+	memcpy(time_ns, s->time_ns, sizeof(time_ns));
+	memcpy(trans, s->trans, sizeof(trans));
+	bounces = s->bounces;
+	held = s->held;
+	hold_ms = s->down_hold_ms << s->backoff;
+	spin_unlock_irqrestore(&s->lock, flags);
+
+	for (i = 0; i < s->nr; i++) {
+		len += sprintf(buf + len, "wp%d ", i);
+		if (label)
+			len += label(i, buf + len);
+		do_div(time_ns[i], NSEC_PER_MSEC);
+		len += sprintf(buf + len, " %llu ms\n",
+			       (unsigned long long)time_ns[i]);
+	}
+
+	len += sprintf(buf + len, "from\\to");
+	for (j = 0; j < s->nr; j++)
+		len += sprintf(buf + len, " %8d", j);
+	len += sprintf(buf + len, "\n");
+	for (i = 0; i < s->nr; i++) {
+		len += sprintf(buf + len, "%7d", i);
+		for (j = 0; j < s->nr; j++)
+			len += sprintf(buf + len, " %8u", trans[i][j]);
+		len += sprintf(buf + len, "\n");
+	}
+
+	len += sprintf(buf + len, "bounces %u\nheld %u\nhold_ms %u\n",
+		       bounces, held, hold_ms);
+	return len;
+}
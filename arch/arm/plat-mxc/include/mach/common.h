@@ -34,6 +34,22 @@ extern void mx35_init_irq(void);
 extern void mx5_init_irq(void);
 extern void mxc91231_init_irq(void);
 extern void mxc_tzic_init_irq(unsigned long);
+
+/*
+ * TZIC priorities, lower values win.  An interrupt's handlers can be
+ * preempted by interrupts of a higher priority, see tzic.c.
+ */
+#define TZIC_PRIO_HIGH		0x40
+#define TZIC_PRIO_NORMAL	0x80	/* default */
+#define TZIC_PRIO_LOW		0xc0
+
+struct tzic_irq_priority {
+	unsigned int	irq;
+	u8		priority;
+};
+
+extern void mxc_tzic_set_priorities(const struct tzic_irq_priority *prio,
+				    int count);
 extern void mxc_timer_init(struct clk *timer_clk, void __iomem *, int);
 extern int mx1_clocks_init(unsigned long fref);
 extern int mx21_clocks_init(unsigned long lref, unsigned long fref);
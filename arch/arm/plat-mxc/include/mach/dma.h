@@ -258,6 +258,39 @@ extern int mxc_dma_sg_config(int channel_num, struct scatterlist *sg,
 			     int num_buf, int num_of_bytes,
 			     mxc_dma_mode_t mode);
 
+/*!
+ * This function sets the channel up for continuous (cyclic) transfers: the
+ * buffer is split into a ring of periods buffer descriptors of period_len
+ * bytes each, and every descriptor the SDMA closes is handed straight back
+ * to it, so the channel streams without being reprogrammed. The callback
+ * runs once every intr_every completed periods (interrupt moderation) with
+ * the number of bytes completed since the previous call; the client keeps
+ * track of its position in the ring and must consume a period before the
+ * SDMA comes round to it again. Start and pause the channel with
+ * mxc_dma_enable() / mxc_dma_disable(); mxc_dma_config() is refused until
+ * mxc_dma_cyclic_stop().
+ *
+ * @param channel_num  the channel number returned at request time
+ * @param buf          physical address of the ring buffer
+ * @param period_len   bytes per period, less than 64KiB
+ * @param periods      number of periods, at most the channel's BD count
+ * @param intr_every   periods per callback, clamped to 1..periods
+ * @param mode         specifies whether this is READ or WRITE operation
+ * @return This function returns a negative number on error, 0 on success
+ */
+extern int mxc_dma_cyclic_config(int channel_num, dma_addr_t buf,
+				 int period_len, int periods, int intr_every,
+				 mxc_dma_mode_t mode);
+
+/*!
+ * This function stops a channel set up with mxc_dma_cyclic_config() and
+ * returns it to normal, one shot, operation.
+ *
+ * @param channel_num  the channel number returned at request time
+ * @return returns a negative number on error or 0 on success
+ */
+extern int mxc_dma_cyclic_stop(int channel_num);
+
 /*!
  * This function is provided if the driver would like to set/change its
  * callback function.
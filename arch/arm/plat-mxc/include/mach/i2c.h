@@ -14,12 +14,15 @@
  * @init:	Initialise gpio's and other board specific things
  * @exit:	Free everything initialised by @init
  * @bitrate:	Bus speed measured in Hz
+ * @fast_bitrate: Optional faster speed to run the bus at.  The driver drops
+ *		back to @bitrate for good if the bus misbehaves at this speed.
  *
  **/
 struct imxi2c_platform_data {
 	int (*init)(struct device *dev);
 	void (*exit)(struct device *dev);
 	int bitrate;
+	int fast_bitrate;
 };
 
 #endif /* __ASM_ARCH_I2C_H_ */
@@ -33,6 +33,8 @@
 #include <linux/types.h>
 #include <linux/workqueue.h>
 #include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
 
 extern void __iomem *gpc_base;
 extern void __iomem *ccm_base;
@@ -236,6 +238,40 @@ struct mxc_bus_freq_platform_data {
 	char *lp_reg_id;
 };
 
+#define DVFS_STATS_MAX_WP	8
+
+/*!
+ * Working point residency and transition accounting, and the step-down
+ * hysteresis shared by the DVFS core and PER drivers.  Working point 0 is
+ * the fastest one.  A step-down that follows a step-up by less than
+ * down_hold_ms << backoff is ignored; backoff grows every time a step-down
+ * is undone within the bounce window and decays when one sticks.
+ */
+struct dvfs_stats {
+	const char *name;
+	spinlock_t lock;
+	int nr;
+	int cur;
+	int last_up;
+	ktime_t last_change;
+	u64 time_ns[DVFS_STATS_MAX_WP];
+	unsigned int trans[DVFS_STATS_MAX_WP][DVFS_STATS_MAX_WP];
+	unsigned int bounces;
+	unsigned int held;
+	unsigned int backoff;
+	unsigned int down_hold_ms;
+};
+
+extern void dvfs_stats_init(struct dvfs_stats *s, const char *name, int nr);
+extern void dvfs_stats_set(struct dvfs_stats *s, int wp);
+extern void dvfs_stats_transition(struct dvfs_stats *s, int wp, ktime_t start);
+extern int dvfs_stats_hold_down(struct dvfs_stats *s);
+extern ssize_t dvfs_stats_show(struct dvfs_stats *s, char *buf,
+			       int (*label)(int wp, char *buf));
+
+/* DDR demand in MB/s, as measured by the perfmon bandwidth monitor */
+extern void bus_freq_update_bandwidth(unsigned int mbps);
+
 #if defined(CONFIG_MXC_DVFS_PER)
 extern int start_dvfs_per(void);
 extern void stop_dvfs_per(void);
@@ -155,6 +155,15 @@ typedef struct {
 	 * DMA ID for receive
 	 */
 	mxc_dma_device_t dma_rx_id;
+	/*!
+	 * Interrupt and receive statistics since stats_since (jiffies),
+	 * shown in debugfs mxc_uart/ttymxc<n>
+	 */
+	unsigned long irq_count;
+	unsigned long rx_events;
+	unsigned long rx_bytes;
+	unsigned long stats_since;
+	struct dentry *debugfs;
 } uart_mxc_port;
 
 /* Address offsets of the UART registers */
@@ -368,6 +368,10 @@ typedef struct mxc_dma_channel_private {
 	struct tasklet_struct chnl_tasklet;
 	/*! Flag indicates if interrupt is required after every BD transfer */
 	int intr_after_every_bd;
+	/*! Number of BDs in the ring, non-zero in cyclic mode */
+	int cyclic_periods;
+	/*! Bytes per BD in cyclic mode */
+	int cyclic_len;
 } mxc_dma_channel_private_t;
 
 /*!
@@ -537,6 +541,27 @@ void mxc_dma_set_bd_intr(int channel, int bd_index, int bd_intr);
  */
 int mxc_dma_get_bd_intr(int channel, int bd_index);
 
+/*!
+ * Configures the BD_WRAP bit on a buffer descriptor, making it the last
+ * one of the ring.
+ *
+ * @param   channel           channel number
+ * @param   bd_index          index of buffer descriptor to set
+ * @param   bd_wrap           flag to set or clear the BD_WRAP bit
+ */
+void mxc_dma_set_bd_wrap(int channel, int bd_index, int bd_wrap);
+
+/*!
+ * Hands a completed buffer descriptor back to the SDMA, keeping its
+ * addresses and flags.
+ *
+ * @param   channel           channel number
+ * @param   bd_index          index of buffer descriptor to re-arm
+ * @param   count             number of bytes to transfer
+ * @return  0 on success, error code on fail
+ */
+int mxc_dma_rearm_bd(int channel, int bd_index, int count);
+
 /*!
  * Stop the current transfer
  *
@@ -39,6 +39,7 @@
 extern void start_sdram_autogating(void);
 extern void stop_sdram_autogating(void);
 extern int sdram_autogating_active(void);
+extern void sdram_autogating_update_bandwidth(unsigned int mbps);
 #else
 static inline void start_sdram_autogating(void)
 {}
@@ -50,6 +51,9 @@ static inline int sdram_autogating_active(void)
 {
 	return 0;
 }
+
+static inline void sdram_autogating_update_bandwidth(unsigned int mbps)
+{}
 #endif
 
 #endif				/*__KERNEL__ */
@@ -18,16 +18,115 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/init.h>
 #include <linux/io.h>
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/genalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/iram_alloc.h>
 
+/*
+ * Placement policy: the IRAM is split in two pools that never overlap.
+ *
+ * The system pool, mapped uncached, serves iram_alloc(): suspend code,
+ * DDR frequency switching, SDMA scripts and other users that need the
+ * memory to be there no matter what.
+ *
+ * The hot pool is carved from the top of the IRAM only when requested
+ * with "iram_hot=<size>" on the command line, is mapped cacheable and
+ * serves iram_alloc_hot(): small, frequently used driver data that merely
+ * runs faster there. Its users must cope with getting nothing, and it
+ * can never eat into what the system users rely on.
+ */
 static unsigned long iram_phys_base;
 static __iomem void *iram_virt_base;
 static struct gen_pool *iram_pool;
+static unsigned long iram_size;
+
+static unsigned long iram_hot_phys;
+static void *iram_hot_virt;
+static struct gen_pool *iram_hot_pool;
+static unsigned long iram_hot_size;
 
 #define iram_phys_to_virt(p) (iram_virt_base + ((p) - iram_phys_base))
+#define iram_hot_phys_to_virt(p) (iram_hot_virt + ((p) - iram_hot_phys))
+
+/* Allocation granule of both pools */
+#define IRAM_ORDER	12
+
+/* Registry of the IRAM consumers, shown in debugfs "iram" */
+struct iram_user {
+	struct list_head list;
+	unsigned long phys;
+	unsigned int size;
+	const char *name;	/* NULL: identified by caller */
+	void *caller;
+	bool hot;
+};
+
+static LIST_HEAD(iram_users);
+static DEFINE_SPINLOCK(iram_users_lock);
+static unsigned long iram_used, iram_hot_used;
+static unsigned long iram_failed, iram_hot_failed;
+
+static int __init iram_hot_setup(char *str)
+{
+	iram_hot_size = memparse(str, &str);
+	return 1;
+}
+__setup("iram_hot=", iram_hot_setup);
+
+static void iram_register(unsigned long phys, unsigned int size,
+			  const char *name, void *caller, bool hot)
+{
+	struct iram_user *u = kzalloc(sizeof(*u), GFP_ATOMIC);
+	unsigned long flags;
+
+	spin_lock_irqsave(&iram_users_lock, flags);
+	if (hot)
+		iram_hot_used += size;
+	else
+		iram_used += size;
+	if (u) {
+		u->phys = phys;
+		u->size = size;
+		u->name = name;
+		u->caller = caller;
+		u->hot = hot;
+		list_add_tail(&u->list, &iram_users);
+	}
+	spin_unlock_irqrestore(&iram_users_lock, flags);
+}
+
+static void iram_unregister(unsigned long phys, unsigned int size, bool hot)
+{
+	struct iram_user *u;
+	unsigned long flags;
+
+	spin_lock_irqsave(&iram_users_lock, flags);
+	if (hot)
+		iram_hot_used -= size;
+	else
+		iram_used -= size;
+	list_for_each_entry(u, &iram_users, list) {
+		if (u->phys == phys) {
+			list_del(&u->list);
+			kfree(u);
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&iram_users_lock, flags);
+}
+
+static inline bool iram_is_hot(unsigned long addr)
+{
+	return iram_hot_pool && addr >= iram_hot_phys &&
+		addr < iram_hot_phys + iram_hot_size;
+}
 
 void *iram_alloc(unsigned int size, unsigned long *dma_addr)
 {
@@ -38,19 +137,49 @@ void *iram_alloc(unsigned int size, unsigned long *dma_addr)
 	pr_debug("iram alloc - %dB@0x%p\n", size, (void *)*dma_addr);
 
 	WARN_ON(!*dma_addr);
-	if (!*dma_addr)
+	if (!*dma_addr) {
+		iram_failed++;
 		return NULL;
+	}
 
+	iram_register(*dma_addr, size, NULL, __builtin_return_address(0),
+		      false);
 	return iram_phys_to_virt(*dma_addr);
 }
 EXPORT_SYMBOL(iram_alloc);
 
+void *iram_alloc_hot(unsigned int size, unsigned long *dma_addr,
+		     const char *name)
+{
+	if (!iram_hot_pool)
+		return NULL;
+
+	*dma_addr = gen_pool_alloc(iram_hot_pool, size);
+	pr_debug("iram hot alloc - %dB@0x%p for %s\n", size,
+		 (void *)*dma_addr, name);
+	if (!*dma_addr) {
+		iram_hot_failed++;
+		return NULL;
+	}
+
+	iram_register(*dma_addr, size, name, __builtin_return_address(0),
+		      true);
+	return iram_hot_phys_to_virt(*dma_addr);
+}
+EXPORT_SYMBOL(iram_alloc_hot);
+
 void iram_free(unsigned long addr, unsigned int size)
 {
 	if (!iram_pool)
 		return;
 
-	gen_pool_free(iram_pool, addr, size);
+	if (iram_is_hot(addr)) {
+		gen_pool_free(iram_hot_pool, addr, size);
+		iram_unregister(addr, size, true);
+	} else {
+		gen_pool_free(iram_pool, addr, size);
+		iram_unregister(addr, size, false);
+	}
 }
 EXPORT_SYMBOL(iram_free);
 
@@ -58,10 +187,81 @@ int __init iram_init(unsigned long base, unsigned long size)
 {
 	iram_phys_base = base;
 
-	iram_pool = gen_pool_create(12, -1);
+	/* The hot pool takes at most half of the IRAM */
+	iram_hot_size = min(ALIGN(iram_hot_size, 1 << IRAM_ORDER),
+			    (size / 2) & ~((1UL << IRAM_ORDER) - 1));
+	if (iram_hot_size) {
+		iram_hot_phys = base + size - iram_hot_size;
+		iram_hot_virt = ioremap_cached(iram_hot_phys, iram_hot_size);
+		iram_hot_pool = gen_pool_create(IRAM_ORDER, -1);
+		if (!iram_hot_virt || !iram_hot_pool ||
+		    gen_pool_add(iram_hot_pool, iram_hot_phys,
+				 iram_hot_size, -1)) {
+			pr_warning("i.MX IRAM: no hot pool\n");
+			if (iram_hot_virt)
+				iounmap(iram_hot_virt);
+			if (iram_hot_pool)
+				gen_pool_destroy(iram_hot_pool);
+			iram_hot_pool = NULL;
+			iram_hot_size = 0;
+		}
+		size -= iram_hot_size;
+	}
+	iram_size = size;
+
+	iram_pool = gen_pool_create(IRAM_ORDER, -1);
 	gen_pool_add(iram_pool, base, size, -1);
 	iram_virt_base = ioremap(iram_phys_base, size);
 
 	pr_info("i.MX IRAM pool: %ld KB@0x%p\n", size / 1024, iram_virt_base);
+	if (iram_hot_size)
+		pr_info("i.MX IRAM hot pool: %ld KB@0x%p\n",
+			iram_hot_size / 1024, iram_hot_virt);
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int iram_users_show(struct seq_file *m, void *v)
+{
+	struct iram_user *u;
+	unsigned long flags;
+
+	spin_lock_irqsave(&iram_users_lock, flags);
+	seq_printf(m, "system: 0x%08lx %lu KB, %lu bytes used, %lu failed\n",
+		   iram_phys_base, iram_size / 1024, iram_used, iram_failed);
+	seq_printf(m, "hot:    0x%08lx %lu KB, %lu bytes used, %lu failed\n",
+		   iram_hot_phys, iram_hot_size / 1024, iram_hot_used,
+		   iram_hot_failed);
+	list_for_each_entry(u, &iram_users, list) {
+		seq_printf(m, "0x%08lx %6u %-6s ", u->phys, u->size,
+			   u->hot ? "hot" : "system");
+		if (u->name)
+			seq_printf(m, "%s\n", u->name);
+		else
+			seq_printf(m, "%pS\n", u->caller);
+	}
+	spin_unlock_irqrestore(&iram_users_lock, flags);
+	return 0;
+}
+
+static int iram_users_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, iram_users_show, NULL);
+}
+
+static const struct file_operations iram_users_fops = {
+	.open		= iram_users_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init iram_debugfs_init(void)
+{
+	if (!iram_pool)
+		return 0;
+	debugfs_create_file("iram", S_IRUGO, NULL, NULL, &iram_users_fops);
 	return 0;
 }
+late_initcall(iram_debugfs_init);
+#endif
@@ -34,6 +34,43 @@ static mxc_dma_channel_private_t mxc_sdma_private[MAX_DMA_CHANNELS];
 
 extern struct clk *mxc_sdma_ahb_clk, *mxc_sdma_ipg_clk;
 
+/*!
+ * Cyclic mode part of the channel tasklet: re-arms every BD the SDMA has
+ * closed since the last run and reports them to the client in one go.
+ *
+ * @param arg channel id
+ */
+static void mxc_sdma_cyclic_tasklet(unsigned long arg)
+{
+	dma_request_t request_t;
+	mxc_dma_channel_t *chnl_info = &mxc_sdma_channels[arg];
+	mxc_dma_channel_private_t *data_priv = chnl_info->private;
+	int done = 0, error = MXC_DMA_DONE;
+
+	memset(&request_t, 0, sizeof(dma_request_t));
+	mxc_dma_get_config(arg, &request_t, data_priv->buf_tail);
+	while (request_t.bd_done == 0 && done < data_priv->cyclic_periods) {
+		if (request_t.bd_error)
+			error = MXC_DMA_TRANSFER_ERROR;
+		mxc_dma_rearm_bd(arg, data_priv->buf_tail,
+				 data_priv->cyclic_len);
+		if (++data_priv->buf_tail >= data_priv->cyclic_periods)
+			data_priv->buf_tail = 0;
+		done++;
+		memset(&request_t, 0, sizeof(dma_request_t));
+		mxc_dma_get_config(arg, &request_t, data_priv->buf_tail);
+	}
+
+	if (!done)
+		return;
+
+	/* Restart the channel in case it ran out of BDs meanwhile */
+	mxc_dma_start(arg);
+	if (chnl_info->cb_fn)
+		chnl_info->cb_fn(chnl_info->cb_args, error,
+				 done * data_priv->cyclic_len);
+}
+
 /*!
  * Tasket to handle processing the channel buffers
  *
@@ -49,6 +86,10 @@ static void mxc_sdma_channeltasklet(unsigned long arg)
 
 	chnl_info = &mxc_sdma_channels[arg];
 	data_priv = chnl_info->private;
+	if (data_priv->cyclic_periods) {
+		mxc_sdma_cyclic_tasklet(arg);
+		return;
+	}
 	chnl_param =
 	    mxc_sdma_get_channel_params(chnl_info->channel)->chnl_params;
 
@@ -229,6 +270,7 @@ int mxc_dma_free(int channel_num)
 	mxc_sdma_channels[channel_num].curr_buf = 0;
 	data_priv = mxc_sdma_channels[channel_num].private;
 	data_priv->buf_tail = 0;
+	data_priv->cyclic_periods = 0;
 	tasklet_kill(&data_priv->chnl_tasklet);
 
 	return 0;
@@ -251,54 +293,22 @@ static void mxc_dma_chnl_callback(void *arg)
 }
 
 /*!
- * This function would just configure the buffers specified by the user into
- * dma channel. The caller must call mxc_dma_enable to start this transfer.
+ * Re-setup the SDMA channel if the transfer direction is changed
  *
- * @param channel_num  the channel number returned at request time. This
- *                     would be used by the DMA driver to identify the calling
- *                     driver and do the necessary cleanup on the channel
- *                     associated with the particular peripheral
- * @param dma_buf      an array of physical addresses to the user defined
- *                     buffers. The caller must guarantee the dma_buf is
- *                     available until the transfer is completed.
- * @param num_buf      number of buffers in the array
+ * @param channel_num  the channel number returned at request time
  * @param mode         specifies whether this is READ or WRITE operation
- * @return This function returns a negative number on error if buffer could not be
- *         added with DMA for transfer. On Success, it returns 0
+ * @return 0 on success, a negative number on error
  */
-int mxc_dma_config(int channel_num, mxc_dma_requestbuf_t *dma_buf,
-		   int num_buf, mxc_dma_mode_t mode)
+static int mxc_dma_set_mode(int channel_num, mxc_dma_mode_t mode)
 {
-	int ret = 0, i = 0, prev_buf;
-	mxc_dma_channel_t *chnl_info;
-	mxc_dma_channel_private_t *data_priv;
+	int ret = 0;
+	mxc_dma_channel_t *chnl_info = &mxc_sdma_channels[channel_num];
 	mxc_sdma_channel_params_t *chnl;
 	dma_channel_params chnl_param;
-	dma_request_t request_t;
-
-	if ((channel_num >= MAX_DMA_CHANNELS) || (channel_num < 0)) {
-		return -EINVAL;
-	}
-
-	if (num_buf <= 0) {
-		return -EINVAL;
-	}
-
-	chnl_info = &mxc_sdma_channels[channel_num];
-	data_priv = chnl_info->private;
-	if (chnl_info->lock != 1) {
-		return -ENODEV;
-	}
-
-	/* Check to see if all buffers are taken */
-	if (chnl_info->active == 1) {
-		return -EBUSY;
-	}
 
 	chnl = mxc_sdma_get_channel_params(chnl_info->channel);
 	chnl_param = chnl->chnl_params;
 
-	/* Re-setup the SDMA channel if the transfer direction is changed */
 	if ((chnl_param.peripheral_type != MEMORY) && (mode != chnl_info->mode)) {
 		if (chnl_param.peripheral_type == DSP) {
 			if (mode == MXC_DMA_MODE_READ) {
@@ -338,6 +348,61 @@ int mxc_dma_config(int channel_num, mxc_dma_requestbuf_t *dma_buf,
 		chnl_info->mode = mode;
 	}
 
+	return 0;
+}
+
+/*!
+ * This function would just configure the buffers specified by the user into
+ * dma channel. The caller must call mxc_dma_enable to start this transfer.
+ *
+ * @param channel_num  the channel number returned at request time. This
+ *                     would be used by the DMA driver to identify the calling
+ *                     driver and do the necessary cleanup on the channel
+ *                     associated with the particular peripheral
+ * @param dma_buf      an array of physical addresses to the user defined
+ *                     buffers. The caller must guarantee the dma_buf is
+ *                     available until the transfer is completed.
+ * @param num_buf      number of buffers in the array
+ * @param mode         specifies whether this is READ or WRITE operation
+ * @return This function returns a negative number on error if buffer could not be
+ *         added with DMA for transfer. On Success, it returns 0
+ */
+int mxc_dma_config(int channel_num, mxc_dma_requestbuf_t *dma_buf,
+		   int num_buf, mxc_dma_mode_t mode)
+{
+	int ret = 0, i = 0, prev_buf;
+	mxc_dma_channel_t *chnl_info;
+	mxc_dma_channel_private_t *data_priv;
+	mxc_sdma_channel_params_t *chnl;
+	dma_channel_params chnl_param;
+	dma_request_t request_t;
+
+	if ((channel_num >= MAX_DMA_CHANNELS) || (channel_num < 0)) {
+		return -EINVAL;
+	}
+
+	if (num_buf <= 0) {
+		return -EINVAL;
+	}
+
+	chnl_info = &mxc_sdma_channels[channel_num];
+	data_priv = chnl_info->private;
+	if (chnl_info->lock != 1) {
+		return -ENODEV;
+	}
+
+	/* Check to see if all buffers are taken */
+	if (chnl_info->active == 1 || data_priv->cyclic_periods) {
+		return -EBUSY;
+	}
+
+	ret = mxc_dma_set_mode(channel_num, mode);
+	if (ret != 0) {
+		return ret;
+	}
+	chnl = mxc_sdma_get_channel_params(chnl_info->channel);
+	chnl_param = chnl->chnl_params;
+
 	for (i = 0; i < num_buf; i++, dma_buf++) {
 		/* Check to see if all buffers are taken */
 		if (chnl_info->active == 1) {
@@ -454,6 +519,113 @@ int mxc_dma_sg_config(int channel_num, struct scatterlist *sg,
 	return ret;
 }
 
+/*!
+ * This function sets the channel up as a continuous ring of periods BDs of
+ * period_len bytes each over the buffer at buf. See mxc_dma_cyclic_config()
+ * in <mach/dma.h>.
+ */
+int mxc_dma_cyclic_config(int channel_num, dma_addr_t buf, int period_len,
+			  int periods, int intr_every, mxc_dma_mode_t mode)
+{
+	int ret, i;
+	mxc_dma_channel_t *chnl_info;
+	mxc_dma_channel_private_t *data_priv;
+	dma_channel_params chnl_param;
+	dma_request_t request_t;
+
+	if ((channel_num >= MAX_DMA_CHANNELS) || (channel_num < 0)) {
+		return -EINVAL;
+	}
+
+	chnl_info = &mxc_sdma_channels[channel_num];
+	data_priv = chnl_info->private;
+	if (chnl_info->lock != 1) {
+		return -ENODEV;
+	}
+
+	chnl_param =
+	    mxc_sdma_get_channel_params(chnl_info->channel)->chnl_params;
+	/* The BD count field is 16 bits wide */
+	if (periods <= 0 || periods > chnl_param.bd_number ||
+	    period_len <= 0 || period_len > 0xFFFF) {
+		return -EINVAL;
+	}
+	if (intr_every <= 0 || intr_every > periods) {
+		intr_every = periods;
+	}
+
+	if (chnl_info->active == 1 || data_priv->cyclic_periods) {
+		return -EBUSY;
+	}
+
+	ret = mxc_dma_set_mode(channel_num, mode);
+	if (ret != 0) {
+		return ret;
+	}
+
+	memset(&request_t, 0, sizeof(dma_request_t));
+	for (i = 0; i < periods; i++) {
+		request_t.destAddr = (__u8 *) (buf + i * period_len);
+		request_t.sourceAddr = (__u8 *) (buf + i * period_len);
+		request_t.count = period_len;
+		request_t.bd_cont = 1;
+		ret = mxc_dma_set_config(channel_num, &request_t, i);
+		if (ret != 0) {
+			mxc_dma_reset(channel_num, i);
+			return ret;
+		}
+		/* Interrupt moderation: one every intr_every BDs */
+		mxc_dma_set_bd_intr(channel_num, i,
+				    ((i + 1) % intr_every == 0) ||
+				    (i == periods - 1));
+	}
+	mxc_dma_set_bd_wrap(channel_num, periods - 1, 1);
+
+	data_priv->buf_tail = 0;
+	data_priv->cyclic_len = period_len;
+	data_priv->cyclic_periods = periods;
+	chnl_info->curr_buf = 0;
+	chnl_info->active = 1;
+
+	return 0;
+}
+
+/*!
+ * This function stops a cyclic channel and returns it to normal mode.
+ */
+int mxc_dma_cyclic_stop(int channel_num)
+{
+	mxc_dma_channel_t *chnl_info;
+	mxc_dma_channel_private_t *data_priv;
+
+	if ((channel_num >= MAX_DMA_CHANNELS) || (channel_num < 0)) {
+		return -EINVAL;
+	}
+
+	chnl_info = &mxc_sdma_channels[channel_num];
+	data_priv = chnl_info->private;
+	if (chnl_info->lock != 1) {
+		return -ENODEV;
+	}
+	if (!data_priv->cyclic_periods) {
+		return 0;
+	}
+
+	mxc_dma_stop(channel_num);
+	tasklet_kill(&data_priv->chnl_tasklet);
+	mxc_dma_reset(channel_num, data_priv->cyclic_periods);
+	mxc_dma_set_bd_wrap(channel_num, data_priv->cyclic_periods - 1,
+			    data_priv->cyclic_periods ==
+			    mxc_sdma_get_channel_params(chnl_info->channel)->
+			    chnl_params.bd_number);
+	data_priv->cyclic_periods = 0;
+	data_priv->buf_tail = 0;
+	chnl_info->curr_buf = 0;
+	chnl_info->active = 0;
+
+	return 0;
+}
+
 /*!
  * This function is provided if the driver would like to set/change its
  * callback function.
@@ -668,6 +840,17 @@ int mxc_dma_enable(int channel_num)
 	return -ENODEV;
 }
 
+int mxc_dma_cyclic_config(int channel_num, dma_addr_t buf, int period_len,
+			  int periods, int intr_every, mxc_dma_mode_t mode)
+{
+	return -ENODEV;
+}
+
+int mxc_dma_cyclic_stop(int channel_num)
+{
+	return -ENODEV;
+}
+
 EXPORT_SYMBOL(mxc_request_dma);
 EXPORT_SYMBOL(mxc_dma_setup_channel);
 EXPORT_SYMBOL(mxc_dma_set_channel_priority);
@@ -688,6 +871,8 @@ EXPORT_SYMBOL(mxc_dma_request_ext);
 EXPORT_SYMBOL(mxc_dma_free);
 EXPORT_SYMBOL(mxc_dma_config);
 EXPORT_SYMBOL(mxc_dma_sg_config);
+EXPORT_SYMBOL(mxc_dma_cyclic_config);
+EXPORT_SYMBOL(mxc_dma_cyclic_stop);
 EXPORT_SYMBOL(mxc_dma_callback_set);
 EXPORT_SYMBOL(mxc_dma_disable);
 EXPORT_SYMBOL(mxc_dma_enable);
@@ -62,6 +62,7 @@ static struct semaphore sdma_synch_mutex[MAX_DMA_CHANNELS];
  * SDMA buffers pool initialization function
  */
 extern void init_sdma_pool(void);
+extern const struct file_operations sdma_malloc_proc_fops;
 
 /*!
  * Flags are save and restored during interrupt handler
@@ -951,6 +952,61 @@ int mxc_dma_get_bd_intr(int channel, int bd_index)
 	return bd_status & BD_INTR;
 }
 
+/*!
+ * Configures the BD_WRAP bit on a buffer descriptor.
+ *
+ * @param   channel           channel number
+ * @param   bd_index          index of buffer descriptor to set
+ * @param   bd_wrap           flag to set or clear the BD_WRAP bit
+ */
+void mxc_dma_set_bd_wrap(int channel, int bd_index, int bd_wrap)
+{
+	unsigned long param;
+
+	iapi_IoCtl(sdma_data[channel].cd,
+		   (bd_index << BD_NUM_OFFSET) |
+		   IAPI_CHANGE_GET_STATUS, (unsigned long)&param);
+
+	if (bd_wrap) {
+		param |= BD_WRAP;
+	} else {
+		param &= ~BD_WRAP;
+	}
+	iapi_IoCtl(sdma_data[channel].cd,
+		   (bd_index << BD_NUM_OFFSET) | IAPI_CHANGE_SET_STATUS, param);
+}
+
+/*!
+ * Hands a completed buffer descriptor back to the SDMA.
+ *
+ * @param   channel           channel number
+ * @param   bd_index          index of buffer descriptor to re-arm
+ * @param   count             number of bytes to transfer
+ * @return  0 on success, error code on fail
+ */
+int mxc_dma_rearm_bd(int channel, int bd_index, int count)
+{
+	unsigned long param;
+
+	if (!sdma_data[channel].in_use) {
+		return -EINVAL;
+	}
+
+	/* The scripts write back the transferred count, restore it */
+	iapi_IoCtl(sdma_data[channel].cd,
+		   (bd_index << BD_NUM_OFFSET) |
+		   IAPI_CHANGE_SET_COUNT, count);
+
+	iapi_IoCtl(sdma_data[channel].cd,
+		   (bd_index << BD_NUM_OFFSET) |
+		   IAPI_CHANGE_GET_STATUS, (unsigned long)&param);
+	param = (param & ~BD_RROR) | BD_DONE;
+	iapi_IoCtl(sdma_data[channel].cd,
+		   (bd_index << BD_NUM_OFFSET) | IAPI_CHANGE_SET_STATUS, param);
+
+	return 0;
+}
+
 /*!
  * Stop the current transfer
  *
@@ -1351,6 +1407,7 @@ static int __init init_proc_fs(void)
 	sdma_proc_dir = proc_mkdir("sdma", NULL);
 	create_proc_read_entry("channels", 0, sdma_proc_dir,
 			       proc_read_channels, NULL);
+	proc_create("malloc", 0, sdma_proc_dir, &sdma_malloc_proc_fops);
 
 	if (res < 0) {
 		printk(KERN_WARNING "Failed create SDMA proc entry\n");
@@ -1532,6 +1589,8 @@ EXPORT_SYMBOL(mxc_dma_set_config);
 EXPORT_SYMBOL(mxc_dma_get_config);
 EXPORT_SYMBOL(mxc_dma_set_bd_intr);
 EXPORT_SYMBOL(mxc_dma_get_bd_intr);
+EXPORT_SYMBOL(mxc_dma_set_bd_wrap);
+EXPORT_SYMBOL(mxc_dma_rearm_bd);
 EXPORT_SYMBOL(mxc_dma_reset);
 EXPORT_SYMBOL(mxc_sdma_write_ipcv2);
 EXPORT_SYMBOL(mxc_sdma_read_ipcv2);
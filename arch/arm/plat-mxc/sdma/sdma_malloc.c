@@ -29,6 +29,10 @@
 #include <linux/slab.h>
 #include <linux/genalloc.h>
 #include <linux/iram_alloc.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/fs.h>
+#include <linux/seq_file.h>
 #include <asm/dma.h>
 #include <mach/hardware.h>
 
@@ -52,10 +56,10 @@ static struct dma_pool *pool;
 static struct gen_pool *sdma_iram_pool;
 
 /*!
- * SDMA memory conversion hashing structure
+ * SDMA memory conversion hashing structure, one per allocation
  */
 typedef struct {
-	struct list_head node;
+	struct hlist_node node;
 	/*! Virtual address */
 	void *virt;
 	/*! Physical address */
@@ -64,7 +68,41 @@ typedef struct {
 	bool in_iram;
 } virt_phys_struct;
 
-static struct list_head alloc_list;
+/*!
+ * Translation of one page holding SDMA buffers. Buffers are translated at
+ * page granularity, so all the allocations sharing a page share its entry.
+ */
+struct sdma_page {
+	struct hlist_node vnode;	/* In page_virt_hash */
+	struct hlist_node pnode;	/* In page_phys_hash */
+	unsigned long vpage;		/* Virtual page frame */
+	unsigned long ppage;		/* Physical page frame */
+	int refs;			/* Allocations touching the page */
+};
+
+#define SDMA_HASH_BITS	6
+#define SDMA_HASH_SIZE	(1 << SDMA_HASH_BITS)
+
+static struct hlist_head alloc_hash[SDMA_HASH_SIZE];
+static struct hlist_head page_virt_hash[SDMA_HASH_SIZE];
+static struct hlist_head page_phys_hash[SDMA_HASH_SIZE];
+static DEFINE_SPINLOCK(sdma_malloc_lock);
+
+/*!
+ * Per segment (DMA pool or IRAM) statistics
+ */
+struct sdma_seg_stats {
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long failed;
+	unsigned long bytes;		/* Currently allocated */
+	unsigned long peak_bytes;
+};
+
+enum { SDMA_SEG_POOL, SDMA_SEG_IRAM, SDMA_SEG_NUM };
+
+static struct sdma_seg_stats seg_stats[SDMA_SEG_NUM];
+static unsigned long v2p_lookups, v2p_misses, p2v_lookups, p2v_misses;
 
 /*!
  * Defines the size of each buffer in SDMA pool.
@@ -80,6 +118,125 @@ static void *iram_vaddr;
 #define iram_virt_to_phys(v) (iram_paddr + ((v) - iram_vaddr))
 #endif
 
+static inline struct hlist_head *page_hash(struct hlist_head *table,
+					   unsigned long pfn)
+{
+	return &table[hash_long(pfn, SDMA_HASH_BITS)];
+}
+
+/* Called with sdma_malloc_lock held */
+static struct sdma_page *sdma_find_virt_page(unsigned long vpage)
+{
+	struct sdma_page *pg;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(pg, n, page_hash(page_virt_hash, vpage), vnode)
+		if (pg->vpage == vpage)
+			return pg;
+	return NULL;
+}
+
+/* Called with sdma_malloc_lock held */
+static struct sdma_page *sdma_find_phys_page(unsigned long ppage)
+{
+	struct sdma_page *pg;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(pg, n, page_hash(page_phys_hash, ppage), pnode)
+		if (pg->ppage == ppage)
+			return pg;
+	return NULL;
+}
+
+static void sdma_seg_account(virt_phys_struct *p, bool alloc)
+{
+	struct sdma_seg_stats *st =
+		&seg_stats[p->in_iram ? SDMA_SEG_IRAM : SDMA_SEG_POOL];
+
+	if (alloc) {
+		st->allocs++;
+		st->bytes += p->size;
+		if (st->bytes > st->peak_bytes)
+			st->peak_bytes = st->bytes;
+	} else {
+		st->frees++;
+		st->bytes -= p->size;
+	}
+}
+
+/*!
+ * Records an allocation and the translation of every page it covers.
+ * The page entries are preallocated by the caller, @pages being an
+ * array of as many entries as the allocation spans pages; the unused
+ * ones are freed here.
+ */
+static void sdma_track(virt_phys_struct *p, struct sdma_page **pages, int n)
+{
+	unsigned long vpage = (unsigned long)p->virt >> PAGE_SHIFT;
+	unsigned long ppage = p->phys >> PAGE_SHIFT;
+	unsigned long flags;
+	struct sdma_page *pg;
+	int i;
+
+	spin_lock_irqsave(&sdma_malloc_lock, flags);
+	hlist_add_head(&p->node, &alloc_hash[hash_ptr(p->virt, SDMA_HASH_BITS)]);
+	for (i = 0; i < n; i++, vpage++, ppage++) {
+		pg = sdma_find_virt_page(vpage);
+		if (pg) {
+			pg->refs++;
+			continue;
+		}
+		pg = pages[i];
+		pages[i] = NULL;
+		pg->vpage = vpage;
+		pg->ppage = ppage;
+		pg->refs = 1;
+		hlist_add_head(&pg->vnode, page_hash(page_virt_hash, vpage));
+		hlist_add_head(&pg->pnode, page_hash(page_phys_hash, ppage));
+	}
+	sdma_seg_account(p, true);
+	spin_unlock_irqrestore(&sdma_malloc_lock, flags);
+
+	for (i = 0; i < n; i++)
+		kfree(pages[i]);
+}
+
+/* Number of pages the allocation at @virt of @size bytes spans */
+static inline int sdma_span(void *virt, int size)
+{
+	unsigned long start = (unsigned long)virt >> PAGE_SHIFT;
+	unsigned long end = ((unsigned long)virt + max(size, 1) - 1)
+		>> PAGE_SHIFT;
+
+	return end - start + 1;
+}
+
+/* Allocates the page entries sdma_track() may need */
+static int sdma_alloc_pages(struct sdma_page **pages, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		pages[i] = kzalloc(sizeof(struct sdma_page), GFP_KERNEL);
+		if (!pages[i]) {
+			while (i--)
+				kfree(pages[i]);
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
+#ifdef CONFIG_SDMA_IRAM
+#define IRAM_SDMA_MAX	IRAM_SDMA_SIZE
+#else
+#define IRAM_SDMA_MAX	0
+#endif
+
+/* An allocation never spans more pages than this */
+#define SDMA_MAX_SPAN	(((IRAM_SDMA_MAX > SDMA_POOL_SIZE ? \
+	IRAM_SDMA_MAX : SDMA_POOL_SIZE) + PAGE_SIZE - 2) / PAGE_SIZE + 1)
+
 /*!
  * Virtual to physical address conversion functio
  *
@@ -90,15 +247,22 @@ static void *iram_vaddr;
 unsigned long sdma_virt_to_phys(void *buf)
 {
 	u32 offset = (u32) buf & (~PAGE_MASK);
-	virt_phys_struct *p;
+	struct sdma_page *pg;
+	unsigned long flags, phys = 0;
 
 	DPRINTK("searching for vaddr 0x%p\n", buf);
 
-	list_for_each_entry(p, &alloc_list, node) {
-		if (((u32)p->virt & PAGE_MASK) == ((u32) buf & PAGE_MASK)) {
-			return (p->phys & PAGE_MASK) | offset;
-		}
-	}
+	spin_lock_irqsave(&sdma_malloc_lock, flags);
+	v2p_lookups++;
+	pg = sdma_find_virt_page((unsigned long)buf >> PAGE_SHIFT);
+	if (pg)
+		phys = (pg->ppage << PAGE_SHIFT) | offset;
+	else
+		v2p_misses++;
+	spin_unlock_irqrestore(&sdma_malloc_lock, flags);
+
+	if (pg)
+		return phys;
 
 	if (virt_addr_valid(buf)) {
 		return virt_to_phys(buf);
@@ -119,15 +283,23 @@ unsigned long sdma_virt_to_phys(void *buf)
 void *sdma_phys_to_virt(unsigned long buf)
 {
 	u32 offset = buf & (~PAGE_MASK);
-	virt_phys_struct *p;
+	struct sdma_page *pg;
+	unsigned long flags;
+	void *virt = NULL;
 
 	DPRINTK("searching for paddr 0x%p\n", buf);
 
-	list_for_each_entry(p, &alloc_list, node) {
-		if ((p->phys & PAGE_MASK) == (buf & PAGE_MASK)) {
-			return (void *)(((u32)p->virt & PAGE_MASK) | offset);
-		}
-	}
+	spin_lock_irqsave(&sdma_malloc_lock, flags);
+	p2v_lookups++;
+	pg = sdma_find_phys_page(buf >> PAGE_SHIFT);
+	if (pg)
+		virt = (void *)((pg->vpage << PAGE_SHIFT) | offset);
+	else
+		p2v_misses++;
+	spin_unlock_irqrestore(&sdma_malloc_lock, flags);
+
+	if (pg)
+		return virt;
 
 	printk(KERN_WARNING
 	       "SDMA malloc: could not translate phys address 0x%lx\n", buf);
@@ -145,6 +317,8 @@ void *sdma_malloc(size_t size)
 	void *buf;
 	dma_addr_t dma_addr;
 	virt_phys_struct *p;
+	struct sdma_page *pages[SDMA_MAX_SPAN];
+	int n;
 
 	if (size > SDMA_POOL_SIZE) {
 		printk(KERN_WARNING
@@ -155,15 +329,26 @@ void *sdma_malloc(size_t size)
 
 	buf = dma_pool_alloc(pool, GFP_KERNEL, &dma_addr);
 	if (buf == 0)
-		return 0;
+		goto fail;
 
+	n = sdma_span(buf, SDMA_POOL_SIZE);
 	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p || sdma_alloc_pages(pages, n)) {
+		kfree(p);
+		dma_pool_free(pool, buf, dma_addr);
+		goto fail;
+	}
 	p->virt = buf;
 	p->phys = dma_addr;
-	list_add_tail(&p->node, &alloc_list);
+	p->size = SDMA_POOL_SIZE;
+	sdma_track(p, pages, n);
 
 	DPRINTK("allocated vaddr 0x%p\n", buf);
 	return buf;
+
+fail:
+	seg_stats[SDMA_SEG_POOL].failed++;
+	return 0;
 }
 
 /*!
@@ -174,18 +359,39 @@ void *sdma_malloc(size_t size)
 void sdma_free(void *buf)
 {
 	virt_phys_struct *p;
-
-	list_for_each_entry(p, &alloc_list, node) {
-		if (p->virt == buf) {
-			if (p->in_iram)
-				gen_pool_free(sdma_iram_pool, p->phys, p->size);
-			else
-				dma_pool_free(pool, p->virt, p->phys);
-			list_del(&p->node);
-			kfree(p);
-			return;
+	struct sdma_page *pg;
+	struct hlist_node *n;
+	unsigned long flags, vpage;
+	int i, span;
+
+	spin_lock_irqsave(&sdma_malloc_lock, flags);
+	hlist_for_each_entry(p, n, &alloc_hash[hash_ptr(buf, SDMA_HASH_BITS)],
+			     node) {
+		if (p->virt != buf)
+			continue;
+
+		hlist_del(&p->node);
+		vpage = (unsigned long)p->virt >> PAGE_SHIFT;
+		span = sdma_span(p->virt, p->size);
+		for (i = 0; i < span; i++, vpage++) {
+			pg = sdma_find_virt_page(vpage);
+			if (pg && --pg->refs == 0) {
+				hlist_del(&pg->vnode);
+				hlist_del(&pg->pnode);
+				kfree(pg);
+			}
 		}
+		sdma_seg_account(p, false);
+		spin_unlock_irqrestore(&sdma_malloc_lock, flags);
+
+		if (p->in_iram)
+			gen_pool_free(sdma_iram_pool, p->phys, p->size);
+		else
+			dma_pool_free(pool, p->virt, p->phys);
+		kfree(p);
+		return;
 	}
+	spin_unlock_irqrestore(&sdma_malloc_lock, flags);
 }
 
 #ifdef CONFIG_SDMA_IRAM
@@ -195,20 +401,33 @@ void sdma_free(void *buf)
 void *sdma_iram_malloc(size_t size)
 {
 	virt_phys_struct *p = kzalloc(sizeof(*p), GFP_KERNEL);
+	struct sdma_page *pages[SDMA_MAX_SPAN];
 	unsigned long buf;
+	int n;
+
+	if (!p || size > IRAM_SDMA_SIZE)
+		goto fail;
 
 	buf = gen_pool_alloc(sdma_iram_pool, size);
-	if (!buf) {
-		kfree(p);
-		return NULL;
-	}
+	if (!buf)
+		goto fail;
 
 	p->virt = iram_vaddr + (buf - iram_paddr);
 	p->phys = buf;
 	p->size = size;
 	p->in_iram = true;
-	list_add_tail(&p->node, &alloc_list);
+	n = sdma_span(p->virt, size);
+	if (sdma_alloc_pages(pages, n)) {
+		gen_pool_free(sdma_iram_pool, buf, size);
+		goto fail;
+	}
+	sdma_track(p, pages, n);
 	return p->virt;
+
+fail:
+	kfree(p);
+	seg_stats[SDMA_SEG_IRAM].failed++;
+	return NULL;
 }
 #endif				/*CONFIG_SDMA_IRAM */
 
@@ -224,10 +443,42 @@ void __init init_sdma_pool(void)
 	sdma_iram_pool = gen_pool_create(6, -1);
 	gen_pool_add(sdma_iram_pool, iram_paddr, SZ_4K, -1);
 #endif
+}
 
-	INIT_LIST_HEAD(&alloc_list);
+/*!
+ * /proc/sdma/malloc: per segment allocation and translation statistics
+ */
+static int sdma_malloc_show(struct seq_file *m, void *v)
+{
+	static const char *seg_name[SDMA_SEG_NUM] = { "pool", "iram" };
+	int i;
+
+	seq_printf(m, "%-6s %8s %8s %8s %8s %10s\n", "seg", "allocs",
+		   "frees", "failed", "bytes", "peak_bytes");
+	for (i = 0; i < SDMA_SEG_NUM; i++)
+		seq_printf(m, "%-6s %8lu %8lu %8lu %8lu %10lu\n", seg_name[i],
+			   seg_stats[i].allocs, seg_stats[i].frees,
+			   seg_stats[i].failed, seg_stats[i].bytes,
+			   seg_stats[i].peak_bytes);
+	seq_printf(m, "virt_to_phys: %lu lookups, %lu not SDMA buffers\n",
+		   v2p_lookups, v2p_misses);
+	seq_printf(m, "phys_to_virt: %lu lookups, %lu failed\n",
+		   p2v_lookups, p2v_misses);
+	return 0;
 }
 
+static int sdma_malloc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdma_malloc_show, NULL);
+}
+
+const struct file_operations sdma_malloc_proc_fops = {
+	.open		= sdma_malloc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 MODULE_AUTHOR("Freescale Semiconductor, Inc.");
 MODULE_DESCRIPTION("MXC Linux SDMA API");
 MODULE_LICENSE("GPL");
@@ -16,6 +16,7 @@
 #include <linux/errno.h>
 #include <mach/hardware.h>
 #include <linux/io.h>
+#include <linux/interrupt.h>
 #include <asm/irq.h>
 #include <asm/mach/irq.h>
 #include <mach/common.h>
@@ -48,6 +49,25 @@ void __iomem *tzic_base;
 
 #define TZIC_NUM_IRQS		128
 
+/* only interrupts with a lower priority value than this are signalled */
+#define TZIC_PRIOMASK_ALL	0xf0
+
+static u8 tzic_prio[TZIC_NUM_IRQS];
+static irq_flow_handler_t tzic_flow[TZIC_NUM_IRQS];
+
+static void tzic_write_prio(unsigned int irq, u8 prio)
+{
+	void __iomem *reg = TZIC_PRIORITY0 + (irq & ~3);
+	int shift = (irq & 3) * 8;
+	u32 v;
+
+	v = __raw_readl(reg);
+	v &= ~(0xff << shift);
+	v |= prio << shift;
+	__raw_writel(v, reg);
+	tzic_prio[irq] = prio;
+}
+
 /**
  * tzic_mask_irq() - Disable interrupt number "irq" in the TZIC
  *
@@ -105,6 +125,85 @@ static int mxc_set_wake_irq(unsigned int irq, unsigned int enable)
 	return 0;
 }
 
+/*
+ * Flow handler for interrupts that higher priority ones may preempt: the
+ * priority mask is raised to this interrupt's level and the cpu takes
+ * interrupts again while the original flow handler runs.  The nested ones
+ * come in on other lines, with their own irq_desc and lock, and nesting
+ * is bounded by the number of priority levels in use.  Lines with an
+ * IRQF_DISABLED handler are run with interrupts off as before.
+ */
+static void tzic_handle_preemptible_irq(unsigned int irq,
+					struct irq_desc *desc)
+{
+	struct irqaction *action = desc->action;
+	u32 prio_mask;
+
+	if (action && (action->flags & IRQF_DISABLED)) {
+		tzic_flow[irq](irq, desc);
+		return;
+	}
+
+	prio_mask = __raw_readl(TZIC_PRIOMASK);
+	__raw_writel(tzic_prio[irq], TZIC_PRIOMASK);
+	/* this line is still asserted, the mask must be in place first */
+	__raw_readl(TZIC_PRIOMASK);
+	local_irq_enable();
+
+	tzic_flow[irq](irq, desc);
+
+	local_irq_disable();
+	__raw_writel(prio_mask, TZIC_PRIOMASK);
+}
+
+/**
+ * mxc_tzic_set_priorities() - Set the priorities of interrupts from board data
+ *
+ * @param  prio         irqs and their TZIC_PRIO_* priority
+ * @param  count        number of entries in @prio
+ *
+ * Once some interrupt has a higher priority than others, those others
+ * run with interrupts enabled and can be preempted by it, so e.g. the
+ * display and touch interrupts need not wait for a long SDIO or USB
+ * handler.  Call it after mxc_tzic_init_irq(), once the flow handlers of
+ * the TZIC lines (including the GPIO port chained handlers) are set.
+ */
+void __init mxc_tzic_set_priorities(const struct tzic_irq_priority *prio,
+				    int count)
+{
+	u8 top = TZIC_PRIO_NORMAL;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (prio[i].irq >= TZIC_NUM_IRQS ||
+		    prio[i].priority >= TZIC_PRIOMASK_ALL) {
+			printk(KERN_ERR "TZIC: bad priority %#x for irq %u\n",
+			       prio[i].priority, prio[i].irq);
+			continue;
+		}
+		tzic_write_prio(prio[i].irq, prio[i].priority);
+	}
+
+	for (i = 0; i < TZIC_NUM_IRQS; i++)
+		top = min(top, tzic_prio[i]);
+
+	for (i = 0; i < TZIC_NUM_IRQS; i++) {
+		struct irq_desc *desc = irq_to_desc(i);
+		unsigned long flags;
+
+		raw_spin_lock_irqsave(&desc->lock, flags);
+		if (tzic_prio[i] > top &&
+		    desc->handle_irq != tzic_handle_preemptible_irq) {
+			tzic_flow[i] = desc->handle_irq;
+			desc->handle_irq = tzic_handle_preemptible_irq;
+		} else if (tzic_prio[i] == top &&
+			   desc->handle_irq == tzic_handle_preemptible_irq) {
+			desc->handle_irq = tzic_flow[i];
+		}
+		raw_spin_unlock_irqrestore(&desc->lock, flags);
+	}
+}
+
 static struct irq_chip mxc_tzic_chip = {
 	.name = "MXC_TZIC",
 	.ack = mxc_mask_irq,
@@ -131,7 +230,7 @@ void __init mxc_tzic_init_irq(unsigned long base)
 
 	__raw_writel(0x80010001, TZIC_INTCNTL);
 	i = __raw_readl(TZIC_INTCNTL);
-	__raw_writel(0x1f, TZIC_PRIOMASK);
+	__raw_writel(TZIC_PRIOMASK_ALL, TZIC_PRIOMASK);
 	i = __raw_readl(TZIC_PRIOMASK);
 	__raw_writel(0x02, TZIC_SYNCCTRL);
 	i = __raw_readl(TZIC_SYNCCTRL);
@@ -146,6 +245,7 @@ void __init mxc_tzic_init_irq(unsigned long base)
 	/* all IRQ no FIQ Warning :: No selection */
 
 	for (i = 0; i < TZIC_NUM_IRQS; i++) {
+		tzic_write_prio(i, TZIC_PRIO_NORMAL);
 		set_irq_chip(i, &mxc_tzic_chip);
 		set_irq_handler(i, handle_level_irq);
 		set_irq_flags(i, IRQF_VALID);
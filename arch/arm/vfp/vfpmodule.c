@@ -488,6 +488,14 @@ void vfp_flush_hwstate(struct thread_info *thread)
 
 #ifdef CONFIG_KERNEL_MODE_NEON
 
+/*
+ * Nesting depth of kernel mode NEON sections. Only the outermost
+ * kernel_neon_begin() saves the user state and only the outermost
+ * kernel_neon_end() turns the unit off again, so a helper that brackets
+ * its own NEON code can be called from inside another section.
+ */
+static unsigned int kernel_neon_depth[NR_CPUS];
+
 /*
  * Kernel-side NEON support functions
  */
@@ -505,6 +513,9 @@ void kernel_neon_begin(void)
 	BUG_ON(in_interrupt());
 	cpu = get_cpu();
 
+	if (kernel_neon_depth[cpu]++)
+		return;
+
 	fpexc = fmrx(FPEXC) | FPEXC_EN;
 	fmxr(FPEXC, fpexc);
 
@@ -524,8 +535,14 @@ EXPORT_SYMBOL(kernel_neon_begin);
 
 void kernel_neon_end(void)
 {
+	unsigned int cpu = smp_processor_id();
+
+	if (WARN_ON(!kernel_neon_depth[cpu]))
+		return;
+
 	/* Disable the NEON/VFP unit. */
-	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	if (!--kernel_neon_depth[cpu])
+		fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
 	put_cpu();
 }
 EXPORT_SYMBOL(kernel_neon_end);
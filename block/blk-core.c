@@ -32,6 +32,7 @@
 #include <trace/events/block.h>
 
 #include "blk.h"
+#include "blk-wbt.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -624,6 +625,7 @@ blk_init_allocated_queue_node(struct request_queue *q, request_fn_proc *rfn,
 	 */
 	if (!elevator_init(q, NULL)) {
 		blk_queue_congestion_threshold(q);
+		blk_wbt_init(q);
 		return q;
 	}
 
@@ -1103,6 +1105,7 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 		return;
 
 	elv_completed_request(q, req);
+	blk_wbt_put(q, req);
 
 	/* this is a bio leak */
 	WARN_ON(req->bio != NULL);
@@ -1179,6 +1182,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 {
 	struct request *req;
 	int el_ret;
+	bool wbt;
 	unsigned int bytes = bio->bi_size;
 	const unsigned short prio = bio_prio(bio);
 	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
@@ -1277,6 +1281,12 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_RW_SYNC;
 
+	/*
+	 * Background writes may have to wait for their turn first, see
+	 * blk-wbt.c.  This might drop the queue lock and sleep.
+	 */
+	wbt = blk_wbt_wait(q, bio);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
@@ -1290,6 +1300,10 @@ get_rq:
 	 * often, and the elevators are able to handle it.
 	 */
 	init_request_from_bio(req, bio);
+	if (wbt)
+		req->cmd_flags |= REQ_WBT;
+	else if (bio_data_dir(bio) == READ)
+		blk_wbt_queued(req);
 
 	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
@@ -2132,6 +2146,7 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	blk_wbt_done(req->q, req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -9,6 +9,7 @@
 #include <linux/blktrace_api.h>
 
 #include "blk.h"
+#include "blk-wbt.h"
 
 struct queue_sysfs_entry {
 	struct attribute attr;
@@ -374,6 +375,19 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_WBT
+static struct queue_sysfs_entry queue_wbt_lat_entry = {
+	.attr = {.name = "wbt_lat_usec", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_wbt_lat_show,
+	.store = blk_wbt_lat_store,
+};
+
+static struct queue_sysfs_entry queue_wbt_stats_entry = {
+	.attr = {.name = "wbt_stats", .mode = S_IRUGO },
+	.show = blk_wbt_stats_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +408,10 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_WBT
+	&queue_wbt_lat_entry.attr,
+	&queue_wbt_stats_entry.attr,
+#endif
 	NULL,
 };
 
@@ -463,6 +481,7 @@ static void blk_release_queue(struct kobject *kobj)
 	struct request_list *rl = &q->rq;
 
 	blk_sync_queue(q);
+	blk_wbt_exit(q);
 
 	if (rl->rq_pool)
 		mempool_destroy(rl->rq_pool);
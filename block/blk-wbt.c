@@ -0,0 +1,327 @@
+/*
+ * Writeback throttling
+ *
+ * A large download or a copy from USB leaves the flusher threads and
+ * balance_dirty_pages() pushing long streams of background writes at
+ * the device, and the reads of whatever is in the foreground (page
+ * faults, mostly) queue up behind them.  This watches how long reads
+ * take from being queued to completing and, when even the fastest read
+ * of a window is slower than the target, halves the number of
+ * background write requests that may be in the queue at once.  The
+ * depth is given back one step per window once reads are fast again,
+ * or after a few windows without any read.
+ *
+ * Only writes that nobody is waiting for are throttled: sync, metadata,
+ * barrier and discard bios, and writes issued from memory reclaim, go
+ * straight through.  The writer sleeps before a request is allocated
+ * for its bio, so a throttled stream holds no request while it waits.
+ *
+ * Everything here runs under the queue lock.
+ *
+ * See Documentation/block/queue-sysfs.txt, wbt_lat_usec and wbt_stats.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <linux/wait.h>
+#include <linux/math64.h>
+
+#include "blk.h"
+#include "blk-wbt.h"
+
+#define WBT_DEFAULT_LAT		(20 * NSEC_PER_MSEC)
+#define WBT_WINDOW		msecs_to_jiffies(50)
+#define WBT_IDLE_WINDOWS	4	/* read-less windows before a step up */
+
+struct rq_wb {
+	struct request_queue	*q;
+	wait_queue_head_t	wait;
+	struct timer_list	window;
+
+	u64			min_lat_nsec;	/* read latency target, 0: off */
+	unsigned int		inflight;	/* throttled writes queued */
+	int			scale_step;	/* depth is halved this often */
+	int			idle_windows;
+
+	/* current window */
+	unsigned int		nr_reads;
+	u64			min_read_lat;
+	bool			writes;
+
+	/* statistics */
+	unsigned long		throttled;	/* writers that had to wait */
+	u64			wait_nsec;
+	u64			max_wait_nsec;
+	unsigned long		windows_over;	/* windows over the target */
+	unsigned long		scale_downs;
+	unsigned long		scale_ups;
+	u64			last_read_lat;	/* fastest read, last window */
+};
+
+/* throttled writes allowed in the queue: half of it, halved per step */
+static unsigned int wbt_limit(struct rq_wb *rwb)
+{
+	unsigned int depth = (rwb->q->nr_requests / 2) >> rwb->scale_step;
+
+	return max(depth, 1U);
+}
+
+static inline void wbt_arm(struct rq_wb *rwb)
+{
+	if (!timer_pending(&rwb->window))
+		mod_timer(&rwb->window, jiffies + WBT_WINDOW);
+}
+
+static void wbt_scale_down(struct rq_wb *rwb)
+{
+	if (wbt_limit(rwb) == 1)
+		return;
+
+	rwb->scale_step++;
+	rwb->scale_downs++;
+}
+
+static void wbt_scale_up(struct rq_wb *rwb)
+{
+	rwb->scale_step--;
+	rwb->scale_ups++;
+	wake_up_all(&rwb->wait);
+}
+
+static void wbt_window_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(rwb->q->queue_lock, flags);
+
+	if (rwb->nr_reads) {
+		rwb->last_read_lat = rwb->min_read_lat;
+		rwb->idle_windows = 0;
+
+		if (rwb->min_read_lat > rwb->min_lat_nsec) {
+			rwb->windows_over++;
+			/* slow reads are only our business if we write */
+			if (rwb->writes || rwb->inflight)
+				wbt_scale_down(rwb);
+		} else if (rwb->scale_step > 0)
+			wbt_scale_up(rwb);
+	} else if (rwb->scale_step > 0 &&
+		   ++rwb->idle_windows >= WBT_IDLE_WINDOWS) {
+		rwb->idle_windows = 0;
+		wbt_scale_up(rwb);
+	}
+
+	rwb->nr_reads = 0;
+	rwb->writes = false;
+
+	if (rwb->min_lat_nsec && (rwb->inflight || rwb->scale_step > 0))
+		wbt_arm(rwb);
+
+	spin_unlock_irqrestore(rwb->q->queue_lock, flags);
+}
+
+static bool wbt_should_throttle(struct rq_wb *rwb, struct bio *bio)
+{
+	if (!rwb || !rwb->min_lat_nsec)
+		return false;
+
+	if (bio_data_dir(bio) != WRITE)
+		return false;
+
+	if (bio_rw_flagged(bio, BIO_RW_SYNCIO) ||
+	    bio_rw_flagged(bio, BIO_RW_META) ||
+	    bio_rw_flagged(bio, BIO_RW_BARRIER) ||
+	    bio_rw_flagged(bio, BIO_RW_DISCARD))
+		return false;
+
+	/* reclaim writing pages out must not wait for reads */
+	if (current->flags & PF_MEMALLOC)
+		return false;
+
+	return true;
+}
+
+/*
+ * Called from __make_request() with the queue lock held, before a
+ * request is allocated for @bio.  May drop the lock and sleep.  Returns
+ * true if the request for @bio has to be marked REQ_WBT.
+ */
+bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!wbt_should_throttle(rwb, bio))
+		return false;
+
+	if (rwb->inflight >= wbt_limit(rwb)) {
+		DEFINE_WAIT(wait);
+		u64 start = sched_clock(), delta;
+
+		do {
+			prepare_to_wait_exclusive(&rwb->wait, &wait,
+						  TASK_UNINTERRUPTIBLE);
+			if (rwb->inflight < wbt_limit(rwb) ||
+			    !rwb->min_lat_nsec)
+				break;
+
+			__generic_unplug_device(q);
+			spin_unlock_irq(q->queue_lock);
+			io_schedule();
+			spin_lock_irq(q->queue_lock);
+		} while (1);
+		finish_wait(&rwb->wait, &wait);
+
+		delta = sched_clock() - start;
+		rwb->throttled++;
+		rwb->wait_nsec += delta;
+		if (delta > rwb->max_wait_nsec)
+			rwb->max_wait_nsec = delta;
+	}
+
+	rwb->inflight++;
+	rwb->writes = true;
+	wbt_arm(rwb);
+	return true;
+}
+
+/*
+ * A request is being completed, queue lock held.  Reads feed the
+ * latency of the current window.
+ */
+void blk_wbt_done(struct request_queue *q, struct request *rq)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	u64 lat;
+
+	if (!rwb || !rwb->min_lat_nsec)
+		return;
+	if (!blk_fs_request(rq) || rq_data_dir(rq) != READ || !rq->wbt_time)
+		return;
+
+	lat = sched_clock() - rq->wbt_time;
+	if (!rwb->nr_reads || lat < rwb->min_read_lat)
+		rwb->min_read_lat = lat;
+	rwb->nr_reads++;
+}
+
+/*
+ * A throttled write request is freed, completed or merged into another
+ * one, queue lock held.
+ */
+void __blk_wbt_put(struct request_queue *q, struct request *rq)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	rq->cmd_flags &= ~REQ_WBT;
+	rwb->inflight--;
+	if (rwb->inflight < wbt_limit(rwb))
+		wake_up(&rwb->wait);
+}
+
+ssize_t blk_wbt_lat_show(struct request_queue *q, char *page)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return sprintf(page, "0\n");
+
+	return sprintf(page, "%llu\n",
+		       (unsigned long long)div_u64(rwb->min_lat_nsec, 1000));
+}
+
+ssize_t blk_wbt_lat_store(struct request_queue *q, const char *page,
+			  size_t count)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	unsigned long usec;
+	char *p = (char *)page;
+
+	if (!rwb)
+		return -EINVAL;
+
+	usec = simple_strtoul(p, &p, 10);
+
+	spin_lock_irq(q->queue_lock);
+	rwb->min_lat_nsec = (u64)usec * NSEC_PER_USEC;
+	if (!usec) {
+		rwb->scale_step = 0;
+		wake_up_all(&rwb->wait);
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+ssize_t blk_wbt_stats_show(struct request_queue *q, char *page)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	unsigned int inflight, limit;
+	unsigned long throttled, windows_over, scale_downs, scale_ups;
+	u64 wait_nsec, max_wait_nsec, read_lat;
+
+	if (!rwb)
+		return 0;
+
+	spin_lock_irq(q->queue_lock);
+	inflight = rwb->inflight;
+	limit = wbt_limit(rwb);
+	throttled = rwb->throttled;
+	wait_nsec = rwb->wait_nsec;
+	max_wait_nsec = rwb->max_wait_nsec;
+	windows_over = rwb->windows_over;
+	scale_downs = rwb->scale_downs;
+	scale_ups = rwb->scale_ups;
+	read_lat = rwb->last_read_lat;
+	spin_unlock_irq(q->queue_lock);
+
+	return sprintf(page,
+		       "inflight %u\n"
+		       "limit %u\n"
+		       "throttled %lu\n"
+		       "wait_us %llu\n"
+		       "max_wait_us %llu\n"
+		       "windows_over %lu\n"
+		       "scale_downs %lu\n"
+		       "scale_ups %lu\n"
+		       "read_lat_us %llu\n",
+		       inflight, limit, throttled,
+		       (unsigned long long)div_u64(wait_nsec, 1000),
+		       (unsigned long long)div_u64(max_wait_nsec, 1000),
+		       windows_over, scale_downs, scale_ups,
+		       (unsigned long long)div_u64(read_lat, 1000));
+}
+
+/*
+ * Request based queues only.  Throttling is simply off if this fails.
+ */
+void blk_wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return;
+
+	rwb->q = q;
+	rwb->min_lat_nsec = WBT_DEFAULT_LAT;
+	init_waitqueue_head(&rwb->wait);
+	setup_timer(&rwb->window, wbt_window_fn, (unsigned long)rwb);
+	q->rq_wb = rwb;
+}
+
+void blk_wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	del_timer_sync(&rwb->window);
+	q->rq_wb = NULL;
+	kfree(rwb);
+}
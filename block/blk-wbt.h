@@ -0,0 +1,55 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+/*
+ * Writeback throttling, see block/blk-wbt.c
+ */
+
+#ifdef CONFIG_BLK_WBT
+
+extern void blk_wbt_init(struct request_queue *q);
+extern void blk_wbt_exit(struct request_queue *q);
+extern bool blk_wbt_wait(struct request_queue *q, struct bio *bio);
+extern void blk_wbt_done(struct request_queue *q, struct request *rq);
+extern void __blk_wbt_put(struct request_queue *q, struct request *rq);
+extern ssize_t blk_wbt_lat_show(struct request_queue *q, char *page);
+extern ssize_t blk_wbt_lat_store(struct request_queue *q, const char *page,
+				 size_t count);
+extern ssize_t blk_wbt_stats_show(struct request_queue *q, char *page);
+
+static inline void blk_wbt_queued(struct request *rq)
+{
+	rq->wbt_time = sched_clock();
+}
+
+static inline void blk_wbt_put(struct request_queue *q, struct request *rq)
+{
+	if (rq->cmd_flags & REQ_WBT)
+		__blk_wbt_put(q, rq);
+}
+
+#else
+
+static inline void blk_wbt_init(struct request_queue *q)
+{
+}
+static inline void blk_wbt_exit(struct request_queue *q)
+{
+}
+static inline bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	return false;
+}
+static inline void blk_wbt_done(struct request_queue *q, struct request *rq)
+{
+}
+static inline void blk_wbt_queued(struct request *rq)
+{
+}
+static inline void blk_wbt_put(struct request_queue *q, struct request *rq)
+{
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ *  Flash I/O scheduler.
+ *
+ *  Deadline derived scheduler for eMMC and SD, where seeking is free but
+ *  writes are slow and a read queued behind a long run of writes stalls
+ *  whatever waits for it.  Reads are served in arrival order ahead of
+ *  writes.  Writes wait until there are no reads, until reads have been
+ *  preferred writes_starved times, or until the oldest write expires, and
+ *  then go out in sector order one erase unit at a time, so the device
+ *  sees each erase block written in one pass.  Nothing ever idles.
+ *
+ *  Based on the deadline scheduler, Copyright (C) 2002 Jens Axboe.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 20;	/* a read this old cuts a write batch */
+static const int write_expire = 2 * HZ;	/* bound on how long reads starve writes */
+static const int writes_starved = 16;	/* reads dispatched per write batch */
+static const int write_batch = 32;	/* max writes in one batch */
+
+struct flash_data {
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * write batch in progress
+	 */
+	struct request *next_write;
+	sector_t batch_unit;		/* erase unit being written */
+	sector_t last_sector;		/* end of the last write dispatched */
+	unsigned int batching;		/* writes dispatched in this batch */
+	unsigned int starved;		/* reads dispatched while writes wait */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int writes_starved;
+	int write_batch;
+	int erase_kb;			/* 0: the device's optimal I/O size */
+	int front_merges;
+};
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+static inline struct request *flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	return node ? rb_entry_rq(node) : NULL;
+}
+
+static inline struct request *flash_former_request(struct request *rq)
+{
+	struct rb_node *node = rb_prev(&rq->rb_node);
+
+	return node ? rb_entry_rq(node) : NULL;
+}
+
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq);
+
+static void flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static inline void flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	flash_remove_request(q, next);
+}
+
+static void flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+static inline int flash_fifo_expired(struct flash_data *fd, int ddir)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[ddir].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/* Erase unit size in sectors, 0 if unknown */
+static sector_t flash_erase_sectors(struct request_queue *q,
+				    struct flash_data *fd)
+{
+	if (fd->erase_kb)
+		return (sector_t)fd->erase_kb << 1;
+	return queue_io_opt(q) >> 9;
+}
+
+static inline sector_t flash_unit(sector_t sector, sector_t unit_sectors)
+{
+	if (!unit_sectors)
+		return 0;
+	sector_div(sector, unit_sectors);
+	return sector;
+}
+
+/*
+ * Start a write batch at the erase unit of the oldest write, from the
+ * lowest sector queued in that unit.
+ */
+static struct request *flash_start_write_batch(struct request_queue *q,
+					       struct flash_data *fd)
+{
+	sector_t unit_sectors = flash_erase_sectors(q, fd);
+	struct request *rq, *prev;
+
+	rq = rq_entry_fifo(fd->fifo_list[WRITE].next);
+	fd->batch_unit = flash_unit(blk_rq_pos(rq), unit_sectors);
+	while ((prev = flash_former_request(rq)) &&
+	       flash_unit(blk_rq_pos(prev), unit_sectors) == fd->batch_unit)
+		rq = prev;
+
+	fd->batching = 0;
+	return rq;
+}
+
+/*
+ * Keep a write batch going while it stays in its erase unit, or while it
+ * is a sequential stream running into the next one.
+ */
+static int flash_continue_write_batch(struct request_queue *q,
+				      struct flash_data *fd)
+{
+	struct request *rq = fd->next_write;
+	sector_t unit;
+
+	if (!rq || fd->batching >= fd->write_batch)
+		return 0;
+
+	unit = flash_unit(blk_rq_pos(rq), flash_erase_sectors(q, fd));
+	if (unit == fd->batch_unit)
+		return 1;
+	if (blk_rq_pos(rq) == fd->last_sector) {
+		fd->batch_unit = unit;
+		return 1;
+	}
+	return 0;
+}
+
+static void flash_dispatch_write(struct flash_data *fd, struct request *rq)
+{
+	fd->next_write = flash_latter_request(rq);
+	fd->last_sector = rq_end_sector(rq);
+	fd->batching++;
+	flash_move_to_dispatch(fd, rq);
+}
+
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+
+	/* A write batch that was started runs to its end, unless a read expires */
+	if (writes && !(reads && flash_fifo_expired(fd, READ)) &&
+	    flash_continue_write_batch(q, fd)) {
+		flash_dispatch_write(fd, fd->next_write);
+		return 1;
+	}
+	fd->next_write = NULL;
+
+	if (reads) {
+		if (writes && (fd->starved >= fd->writes_starved ||
+			       flash_fifo_expired(fd, WRITE)))
+			goto dispatch_writes;
+
+		if (writes)
+			fd->starved++;
+		flash_move_to_dispatch(fd,
+				rq_entry_fifo(fd->fifo_list[READ].next));
+		return 1;
+	}
+
+	if (writes) {
+dispatch_writes:
+		fd->starved = 0;
+		flash_dispatch_write(fd, flash_start_write_batch(q, fd));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[WRITE])
+		&& list_empty(&fd->fifo_list[READ]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[READ] = read_expire;
+	fd->fifo_expire[WRITE] = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[READ], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_erase_kb_show, fd->erase_kb, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_erase_kb_store, &fd->erase_kb, 0, INT_MAX / 2, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR(erase_kb),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
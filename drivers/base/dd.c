@@ -24,6 +24,7 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/hrtimer.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -104,6 +105,7 @@ static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
+	ktime_t calltime;
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -117,15 +119,27 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		goto probe_failed;
 	}
 
-	if (dev->bus->probe) {
+	/*
+	 * initcall_debug only times the driver's initcall, which for bus
+	 * drivers hides every probe behind a single driver_register().
+	 * Report each probe as well so slow devices can be spotted.
+	 */
+	if (initcall_debug)
+		calltime = ktime_get();
+
+	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
-		if (ret)
-			goto probe_failed;
-	} else if (drv->probe) {
+	else if (drv->probe)
 		ret = drv->probe(dev);
-		if (ret)
-			goto probe_failed;
+
+	if (initcall_debug) {
+		s64 delta = ktime_to_us(ktime_sub(ktime_get(), calltime));
+
+		printk("probe of %s (%s) returned %d after %Ld usecs\n",
+		       dev_name(dev), drv->name, ret, (long long)delta);
 	}
+	if (ret)
+		goto probe_failed;
 
 	driver_bound(dev);
 	ret = 1;
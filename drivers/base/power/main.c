@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <linux/async.h>
+#include <linux/suspend.h>
 
 #include "../base.h"
 #include "power.h"
@@ -228,17 +229,27 @@ static void suspend_time_debug_report(const char *name, struct device *dev,
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
- * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ * @async: If unset, wait only if the device's power.async_suspend or
+ *	power.async_resume flag is set.
  */
 static void dpm_wait(struct device *dev, bool async)
 {
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || (pm_async_enabled && (dev->power.async_suspend ||
+					   dev->power.async_resume)))
 		wait_for_completion(&dev->power.completion);
 }
 
+/*
+ * Devices retaining their state are not touched during a micro suspend.
+ */
+static bool dpm_skip(struct device *dev)
+{
+	return pm_micro_suspend_active && dev->power.retains_state;
+}
+
 static int dpm_wait_fn(struct device *dev, void *async_ptr)
 {
 	dpm_wait(dev, *((bool *)async_ptr));
@@ -469,8 +480,12 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
  */
 static int device_resume_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t starttime = suspend_timing_start();
 	int error = 0;
 
+	if (dpm_skip(dev))
+		return 0;
+
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
@@ -494,6 +509,8 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 	}
 
 End:
+	suspend_timing_device(dev, SUSPEND_TIMING_RESUME_NOIRQ, starttime,
+			      error, false);
 	TRACE_RESUME(error);
 	return error;
 }
@@ -523,6 +540,7 @@ void dpm_resume_noirq(pm_message_t state)
 		}
 	mutex_unlock(&dpm_list_mtx);
 	dpm_show_time(starttime, state, "early");
+	suspend_timing_phase(SUSPEND_TIMING_RESUME_NOIRQ, starttime);
 	resume_device_irqs();
 }
 EXPORT_SYMBOL_GPL(dpm_resume_noirq);
@@ -555,6 +573,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -562,9 +581,13 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
 	dpm_wait(dev->parent, async);
 	device_lock(dev);
+	starttime = suspend_timing_start();
 
 	dev->power.status = DPM_RESUMING;
 
+	if (dpm_skip(dev))
+		goto End;
+
 	if (dev->bus) {
 		if (dev->bus->pm) {
 			pm_dev_dbg(dev, state, "");
@@ -596,6 +619,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 		}
 	}
  End:
+	suspend_timing_device(dev, SUSPEND_TIMING_RESUME, starttime,
+			      error, async);
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
 
@@ -616,8 +641,8 @@ static void async_resume(void *data, async_cookie_t cookie)
 
 static bool is_async(struct device *dev)
 {
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
+	return (dev->power.async_suspend || dev->power.async_resume)
+		&& pm_async_enabled && !pm_trace_is_enabled();
 }
 
 /**
@@ -673,6 +698,7 @@ static void dpm_resume(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+	suspend_timing_phase(SUSPEND_TIMING_RESUME, starttime);
 }
 
 /**
@@ -682,6 +708,9 @@ static void dpm_resume(pm_message_t state)
  */
 static void device_complete(struct device *dev, pm_message_t state)
 {
+	if (dpm_skip(dev))
+		return;
+
 	device_lock(dev);
 
 	if (dev->class && dev->class->pm && dev->class->pm->complete) {
@@ -712,6 +741,7 @@ static void device_complete(struct device *dev, pm_message_t state)
 static void dpm_complete(pm_message_t state)
 {
 	struct list_head list;
+	ktime_t starttime = suspend_timing_start();
 
 	INIT_LIST_HEAD(&list);
 	mutex_lock(&dpm_list_mtx);
@@ -735,6 +765,7 @@ static void dpm_complete(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	suspend_timing_phase(SUSPEND_TIMING_COMPLETE, starttime);
 }
 
 /**
@@ -786,8 +817,12 @@ static pm_message_t resume_event(pm_message_t sleep_state)
  */
 static int device_suspend_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t starttime = suspend_timing_start();
 	int error = 0;
 
+	if (dpm_skip(dev))
+		return 0;
+
 	if (dev->class && dev->class->pm) {
 		pm_dev_dbg(dev, state, "LATE class ");
 		error = pm_noirq_op(dev, dev->class->pm, state);
@@ -808,6 +843,8 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 	}
 
 End:
+	suspend_timing_device(dev, SUSPEND_TIMING_SUSPEND_NOIRQ, starttime,
+			      error, false);
 	return error;
 }
 
@@ -835,6 +872,7 @@ int dpm_suspend_noirq(pm_message_t state)
 		dev->power.status = DPM_OFF_IRQ;
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_timing_phase(SUSPEND_TIMING_SUSPEND_NOIRQ, starttime);
 	if (error)
 		dpm_resume_noirq(resume_event(state));
 	else
@@ -875,14 +913,21 @@ static int async_error;
  */
 static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t starttime;
 	int error = 0;
 
 	dpm_wait_for_children(dev, async);
 	device_lock(dev);
+	starttime = suspend_timing_start();
 
 	if (async_error)
 		goto End;
 
+	if (dpm_skip(dev)) {
+		dev->power.status = DPM_OFF;
+		goto End;
+	}
+
 	if (dev->class) {
 		if (dev->class->pm) {
 			pm_dev_dbg(dev, state, "class ");
@@ -918,6 +963,8 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 		dev->power.status = DPM_OFF;
 
  End:
+	suspend_timing_device(dev, SUSPEND_TIMING_SUSPEND, starttime,
+			      error, async);
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
 
@@ -988,6 +1035,7 @@ static int dpm_suspend(pm_message_t state)
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_timing_phase(SUSPEND_TIMING_SUSPEND, starttime);
 	if (!error)
 		error = async_error;
 	if (!error)
@@ -1007,6 +1055,9 @@ static int device_prepare(struct device *dev, pm_message_t state)
 {
 	int error = 0;
 
+	if (dpm_skip(dev))
+		return 0;
+
 	device_lock(dev);
 
 	if (dev->bus && dev->bus->pm && dev->bus->pm->prepare) {
@@ -1045,6 +1096,7 @@ static int device_prepare(struct device *dev, pm_message_t state)
 static int dpm_prepare(pm_message_t state)
 {
 	struct list_head list;
+	ktime_t starttime = suspend_timing_start();
 	int error = 0;
 
 	INIT_LIST_HEAD(&list);
@@ -1087,6 +1139,7 @@ static int dpm_prepare(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	suspend_timing_phase(SUSPEND_TIMING_PREPARE, starttime);
 	return error;
 }
 
@@ -1123,6 +1176,7 @@ EXPORT_SYMBOL_GPL(__suspend_report_result);
  */
 void device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 {
-	dpm_wait(dev, subordinate->power.async_suspend);
+	dpm_wait(dev, subordinate->power.async_suspend ||
+		 subordinate->power.async_resume);
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
@@ -73,6 +73,7 @@
 #include <linux/highmem.h>
 #include <linux/kthread.h>
 #include <linux/splice.h>
+#include <linux/vmalloc.h>
 
 #include <asm/uaccess.h>
 
@@ -81,6 +82,7 @@ static DEFINE_MUTEX(loop_devices_mutex);
 
 static int max_part;
 static int part_shift;
+static int direct_io;
 
 /*
  * Transfer functions
@@ -522,6 +524,289 @@ static struct bio *loop_get_bio(struct loop_device *lo)
 	return bio_list_pop(&lo->lo_bio_list);
 }
 
+/*
+ * Direct mapping of a read-only backing file.
+ *
+ * Going through the backing file means every page is cached twice, once
+ * for the loop device and once for the file, and all I/O is serialised
+ * through the loop thread.  When the backing file is fully allocated on a
+ * block device, its extents are mapped up front with bmap() and reads are
+ * remapped onto the underlying device straight from make_request, in
+ * parallel and without touching the file's page cache.  Like a swap file,
+ * the backing file must not be rewritten or moved while it is mapped, so
+ * this is only offered for read-only devices without a transfer function.
+ */
+struct loop_extent {
+	sector_t	fsec;		/* in 512 byte sectors of the file */
+	sector_t	psec;		/* on dmap->bdev */
+	sector_t	nr;
+};
+
+struct loop_dmap {
+	struct block_device	*bdev;
+	unsigned int		nr;
+	unsigned int		max;
+	struct loop_extent	ext[0];
+};
+
+struct loop_dio {
+	struct bio	*bio;
+	atomic_t	remaining;
+	int		error;
+};
+
+static struct loop_dmap *loop_dmap_alloc(struct loop_dmap *old,
+					 unsigned int max)
+{
+	struct loop_dmap *m;
+
+	m = vmalloc(sizeof(*m) + max * sizeof(struct loop_extent));
+	if (!m)
+		return NULL;
+	if (old) {
+		memcpy(m, old, sizeof(*m) + old->nr * sizeof(struct loop_extent));
+		vfree(old);
+	} else {
+		m->bdev = NULL;
+		m->nr = 0;
+	}
+	m->max = max;
+	return m;
+}
+
+static int loop_dmap_add(struct loop_dmap **mp, sector_t fsec, sector_t psec,
+			 sector_t nr)
+{
+	struct loop_dmap *m = *mp;
+	struct loop_extent *e = m->nr ? &m->ext[m->nr - 1] : NULL;
+
+	if (e && e->fsec + e->nr == fsec && e->psec + e->nr == psec) {
+		e->nr += nr;
+		return 0;
+	}
+	if (m->nr == m->max) {
+		m = loop_dmap_alloc(m, m->max * 2);
+		if (!m)
+			return -ENOMEM;
+		*mp = m;
+	}
+	e = &m->ext[m->nr++];
+	e->fsec = fsec;
+	e->psec = psec;
+	e->nr = nr;
+	return 0;
+}
+
+static struct loop_dmap *loop_build_dmap(struct loop_device *lo)
+{
+	struct address_space *mapping = lo->lo_backing_file->f_mapping;
+	struct inode *inode = mapping->host;
+	sector_t first = lo->lo_offset >> 9;
+	sector_t end = first + get_capacity(lo->lo_disk);
+	struct loop_dmap *m;
+	unsigned int shift;
+	sector_t blk;
+	int err;
+
+	if (lo->lo_offset & 511)
+		return ERR_PTR(-EINVAL);
+
+	m = loop_dmap_alloc(NULL, 64);
+	if (!m)
+		return ERR_PTR(-ENOMEM);
+
+	if (S_ISBLK(inode->i_mode)) {
+		m->bdev = inode->i_bdev;
+		err = loop_dmap_add(&m, first, first, end - first);
+		if (err)
+			goto out_free;
+		return m;
+	}
+
+	err = -EINVAL;
+	if (!S_ISREG(inode->i_mode) || !mapping->a_ops->bmap ||
+	    !inode->i_sb->s_bdev || inode->i_blkbits < 9)
+		goto out_free;
+	m->bdev = inode->i_sb->s_bdev;
+
+	/* Nothing may be left in the page cache only */
+	err = filemap_write_and_wait(mapping);
+	if (err)
+		goto out_free;
+
+	shift = inode->i_blkbits - 9;
+	for (blk = first >> shift; (blk << shift) < end; blk++) {
+		sector_t phys = bmap(inode, blk);
+
+		/* Holes would have to be read as zeroes: not supported */
+		err = -EINVAL;
+		if (!phys)
+			goto out_free;
+		err = loop_dmap_add(&m, blk << shift, phys << shift,
+				    (sector_t)1 << shift);
+		if (err)
+			goto out_free;
+		cond_resched();
+	}
+	return m;
+
+out_free:
+	vfree(m);
+	return ERR_PTR(err);
+}
+
+static struct loop_extent *loop_dmap_find(struct loop_dmap *m, sector_t fsec)
+{
+	unsigned int lo = 0, hi = m->nr;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		struct loop_extent *e = &m->ext[mid];
+
+		if (fsec < e->fsec)
+			hi = mid;
+		else if (fsec >= e->fsec + e->nr)
+			lo = mid + 1;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+static void loop_dio_put(struct loop_dio *dio)
+{
+	if (atomic_dec_and_test(&dio->remaining)) {
+		bio_endio(dio->bio, dio->error);
+		kfree(dio);
+	}
+}
+
+static void loop_dio_end_io(struct bio *bio, int error)
+{
+	struct loop_dio *dio = bio->bi_private;
+
+	if (error)
+		dio->error = error;
+	bio_put(bio);
+	loop_dio_put(dio);
+}
+
+static void loop_dio_submit(struct loop_dio *dio, struct bio *bio)
+{
+	atomic_inc(&dio->remaining);
+	generic_make_request(bio);
+}
+
+/*
+ * Remap a read onto the underlying device.  Returns -ENOMEM, without
+ * having done anything, when it has to go through the loop thread after
+ * all.
+ */
+static int loop_dmap_bio(struct loop_device *lo, struct loop_dmap *m,
+			 struct bio *bio)
+{
+	sector_t fsec = bio->bi_sector + (lo->lo_offset >> 9);
+	struct bio *child = NULL;
+	struct bio_vec *bvec;
+	struct loop_dio *dio;
+	int i;
+
+	dio = kmalloc(sizeof(*dio), GFP_NOIO);
+	if (!dio)
+		return -ENOMEM;
+	dio->bio = bio;
+	dio->error = 0;
+	atomic_set(&dio->remaining, 1);
+
+	bio_for_each_segment(bvec, bio, i) {
+		unsigned int off = bvec->bv_offset;
+		unsigned int left = bvec->bv_len;
+
+		while (left) {
+			struct loop_extent *e = loop_dmap_find(m, fsec);
+			unsigned int len;
+			sector_t psec;
+
+			if (!e) {
+				dio->error = -EIO;
+				goto out;
+			}
+			len = min_t(u64, left, (u64)(e->fsec + e->nr - fsec) << 9);
+			psec = e->psec + (fsec - e->fsec);
+
+			if (!child ||
+			    child->bi_sector + (child->bi_size >> 9) != psec ||
+			    bio_add_page(child, bvec->bv_page, len, off) < len) {
+				if (child)
+					loop_dio_submit(dio, child);
+				child = bio_alloc(GFP_NOIO,
+					min_t(int, bio->bi_vcnt - i, BIO_MAX_PAGES));
+				child->bi_sector = psec;
+				child->bi_bdev = m->bdev;
+				child->bi_rw = bio->bi_rw;
+				child->bi_end_io = loop_dio_end_io;
+				child->bi_private = dio;
+				if (bio_add_page(child, bvec->bv_page, len, off) < len) {
+					bio_put(child);
+					dio->error = -EIO;
+					goto out;
+				}
+			}
+			off += len;
+			left -= len;
+			fsec += len >> 9;
+		}
+	}
+	if (child)
+		loop_dio_submit(dio, child);
+out:
+	loop_dio_put(dio);
+	return 0;
+}
+
+/* Stop remapping reads, waiting for make_request to let go of the map */
+static void loop_drop_dmap(struct loop_device *lo)
+{
+	struct loop_dmap *m;
+
+	spin_lock_irq(&lo->lo_lock);
+	m = lo->lo_dmap;
+	lo->lo_dmap = NULL;
+	lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+
+	if (!m)
+		return;
+	wait_event(lo->lo_event, !atomic_read(&lo->lo_dmap_users));
+	vfree(m);
+}
+
+static int loop_set_direct_io(struct loop_device *lo, unsigned long arg)
+{
+	struct loop_dmap *m;
+
+	if (lo->lo_state != Lo_bound)
+		return -ENXIO;
+	if (!arg) {
+		loop_drop_dmap(lo);
+		return 0;
+	}
+	if (!(lo->lo_flags & LO_FLAGS_READ_ONLY) ||
+	    lo->transfer != transfer_none)
+		return -EINVAL;
+
+	m = loop_build_dmap(lo);
+	if (IS_ERR(m))
+		return PTR_ERR(m);
+
+	loop_drop_dmap(lo);
+	spin_lock_irq(&lo->lo_lock);
+	lo->lo_dmap = m;
+	lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+	spin_unlock_irq(&lo->lo_lock);
+	return 0;
+}
+
 static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 {
 	struct loop_device *lo = q->queuedata;
@@ -537,6 +822,22 @@ static int loop_make_request(struct request_queue *q, struct bio *old_bio)
 		goto out;
 	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
 		goto out;
+	if (rw == READ && lo->lo_dmap) {
+		struct loop_dmap *m = lo->lo_dmap;
+		int err;
+
+		atomic_inc(&lo->lo_dmap_users);
+		spin_unlock_irq(&lo->lo_lock);
+		err = loop_dmap_bio(lo, m, old_bio);
+		if (atomic_dec_and_test(&lo->lo_dmap_users))
+			wake_up(&lo->lo_event);
+		if (!err)
+			return 0;
+
+		spin_lock_irq(&lo->lo_lock);
+		if (lo->lo_state != Lo_bound)
+			goto out;
+	}
 	loop_add_bio(lo, old_bio);
 	wake_up(&lo->lo_event);
 	spin_unlock_irq(&lo->lo_lock);
@@ -686,6 +987,7 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 	struct file	*file, *old_file;
 	struct inode	*inode;
 	int		error;
+	bool		direct;
 
 	error = -ENXIO;
 	if (lo->lo_state != Lo_bound)
@@ -714,7 +1016,11 @@ static int loop_change_fd(struct loop_device *lo, struct block_device *bdev,
 		goto out_putf;
 
 	/* and ... switch */
+	direct = lo->lo_dmap != NULL;
+	loop_drop_dmap(lo);
 	error = loop_switch(lo, file);
+	if (direct)
+		loop_set_direct_io(lo, 1);
 	if (error)
 		goto out_putf;
 
@@ -848,6 +1154,8 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	}
 	lo->lo_state = Lo_bound;
 	wake_up_process(lo->lo_thread);
+	if (direct_io && (lo_flags & LO_FLAGS_READ_ONLY))
+		loop_set_direct_io(lo, 1);
 	if (max_part > 0)
 		ioctl_by_bdev(bdev, BLKRRPART, 0);
 	return 0;
@@ -927,6 +1235,7 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 	spin_unlock_irq(&lo->lo_lock);
 
 	kthread_stop(lo->lo_thread);
+	loop_drop_dmap(lo);
 
 	lo->lo_queue->unplug_fn = NULL;
 	lo->lo_backing_file = NULL;
@@ -975,6 +1284,7 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	int err;
 	struct loop_func_table *xfer;
 	uid_t uid = current_uid();
+	bool direct;
 
 	if (lo->lo_encrypt_key_size &&
 	    lo->lo_key_owner != uid &&
@@ -985,6 +1295,10 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
 
+	/* Offset and transfer may change: remapped below if still possible */
+	direct = lo->lo_dmap != NULL;
+	loop_drop_dmap(lo);
+
 	err = loop_release_xfer(lo);
 	if (err)
 		return err;
@@ -1035,6 +1349,8 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		lo->lo_key_owner = uid;
 	}	
 
+	if (direct)
+		loop_set_direct_io(lo, 1);
 	return 0;
 }
 
@@ -1189,6 +1505,9 @@ static int loop_set_capacity(struct loop_device *lo, struct block_device *bdev)
 	err = figure_loop_size(lo);
 	if (unlikely(err))
 		goto out;
+	/* the map has to cover the new size */
+	if (lo->lo_dmap)
+		loop_set_direct_io(lo, 1);
 	sec = get_capacity(lo->lo_disk);
 	/* the width of sector_t may be narrow for bit-shift */
 	sz = sec;
@@ -1240,6 +1559,11 @@ static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
 			err = loop_set_capacity(lo, bdev);
 		break;
+	case LOOP_SET_DIRECT_IO:
+		err = -EPERM;
+		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
+			err = loop_set_direct_io(lo, arg);
+		break;
 	default:
 		err = lo->ioctl ? lo->ioctl(lo, cmd, arg) : -EINVAL;
 	}
@@ -1394,6 +1718,7 @@ static int lo_compat_ioctl(struct block_device *bdev, fmode_t mode,
 		arg = (unsigned long) compat_ptr(arg);
 	case LOOP_SET_FD:
 	case LOOP_CHANGE_FD:
+	case LOOP_SET_DIRECT_IO:
 		err = lo_ioctl(bdev, mode, cmd, arg);
 		break;
 	default:
@@ -1465,6 +1790,8 @@ module_param(max_loop, int, 0);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, 0);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+module_param(direct_io, bool, 0644);
+MODULE_PARM_DESC(direct_io, "Map read-only backing files directly when bound");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
@@ -1526,6 +1853,7 @@ static struct loop_device *loop_alloc(int i)
 	lo->lo_thread		= NULL;
 	init_waitqueue_head(&lo->lo_event);
 	spin_lock_init(&lo->lo_lock);
+	atomic_set(&lo->lo_dmap_users, 0);
 	disk->major		= LOOP_MAJOR;
 	disk->first_minor	= i << part_shift;
 	disk->fops		= &lo_fops;
@@ -41,6 +41,8 @@
 #include <linux/init.h>
 #include <linux/miscdevice.h>
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
 #include <asm/uaccess.h>
 
 
@@ -56,6 +58,24 @@ static int data_avail;
 static u8 rng_buffer[SMP_CACHE_BYTES < 32 ? 32 : SMP_CACHE_BYTES]
 	__cacheline_aligned;
 
+/*
+ * Feeding the kernel entropy pool: a thread reads the current RNG at up
+ * to feed_rate bytes per second whenever the input pool runs low and
+ * credits feed_quality bits of entropy per 1024 bits read. feed_rate 0
+ * stops feeding.
+ */
+static struct task_struct *hwrng_fill;
+static u8 rng_fillbuf[32] __cacheline_aligned;
+
+static unsigned int feed_rate = 512;
+module_param(feed_rate, uint, 0644);
+MODULE_PARM_DESC(feed_rate, "bytes per second fed to the entropy pool");
+
+static unsigned int feed_quality = 512;
+module_param(feed_quality, uint, 0644);
+MODULE_PARM_DESC(feed_quality,
+		 "entropy credited per 1024 bits fed to the pool");
+
 static inline int hwrng_init(struct hwrng *rng)
 {
 	if (!rng->init)
@@ -166,6 +186,46 @@ out_unlock:
 }
 
 
+static int hwrng_fillfn(void *unused)
+{
+	unsigned int rate, quality;
+	int rc;
+
+	while (!kthread_should_stop()) {
+		rate = feed_rate;
+		if (!rate) {
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+
+		if (mutex_lock_interruptible(&rng_mutex))
+			continue;
+		rc = current_rng ? rng_get_data(current_rng, rng_fillbuf,
+						sizeof(rng_fillbuf), 1) : 0;
+		mutex_unlock(&rng_mutex);
+		if (rc <= 0) {
+			schedule_timeout_interruptible(HZ);
+			continue;
+		}
+
+		quality = min(feed_quality, 1024U);
+		add_hwgenerator_randomness((void *)rng_fillbuf, rc,
+					   rc * 8 * quality / 1024);
+		schedule_timeout_interruptible(DIV_ROUND_UP(rc * HZ, rate));
+	}
+	memset(rng_fillbuf, 0, sizeof(rng_fillbuf));
+	return 0;
+}
+
+static void start_khwrngd(void)
+{
+	hwrng_fill = kthread_run(hwrng_fillfn, NULL, "hwrng");
+	if (IS_ERR(hwrng_fill)) {
+		printk(KERN_ERR PFX "hwrng_fill thread creation failed\n");
+		hwrng_fill = NULL;
+	}
+}
+
 static const struct file_operations rng_chrdev_ops = {
 	.owner		= THIS_MODULE,
 	.open		= rng_dev_open,
@@ -335,6 +395,9 @@ int hwrng_register(struct hwrng *rng)
 	}
 	INIT_LIST_HEAD(&rng->list);
 	list_add_tail(&rng->list, &rng_list);
+
+	if (!hwrng_fill)
+		start_khwrngd();
 out_unlock:
 	mutex_unlock(&rng_mutex);
 out:
@@ -344,6 +407,7 @@ EXPORT_SYMBOL_GPL(hwrng_register);
 
 void hwrng_unregister(struct hwrng *rng)
 {
+	struct task_struct *fill = NULL;
 	int err;
 
 	mutex_lock(&rng_mutex);
@@ -360,10 +424,17 @@ void hwrng_unregister(struct hwrng *rng)
 				current_rng = NULL;
 		}
 	}
-	if (list_empty(&rng_list))
+	if (list_empty(&rng_list)) {
 		unregister_miscdev();
+		fill = hwrng_fill;
+		hwrng_fill = NULL;
+	}
 
 	mutex_unlock(&rng_mutex);
+
+	/* Outside rng_mutex, the thread may be waiting for it */
+	if (fill)
+		kthread_stop(fill);
 }
 EXPORT_SYMBOL_GPL(hwrng_unregister);
 
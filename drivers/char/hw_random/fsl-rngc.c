@@ -42,6 +42,7 @@
 #include <linux/interrupt.h>
 #include <linux/hw_random.h>
 #include <linux/io.h>
+#include <linux/delay.h>
 
 #define RNGC_VERSION_MAJOR3 3
 
@@ -123,31 +124,47 @@ static struct platform_device *rng_dev;
 
 int irq_rng;
 
-static int fsl_rngc_data_present(struct hwrng *rng)
-{
-	int level;
-	u32 rngc_base = (u32) rng->priv;
+/* Polls of an empty FIFO, 10us apart, before a waiting read gives up */
+#define RNGC_READ_POLLS				100
 
-	/* how many random numbers are in FIFO? [0-16] */
-	level = (__raw_readl(rngc_base + RNGC_STATUS) &
-	    RNGC_STATUS_FIFO_LEVEL_MASK) >> RNGC_STATUS_FIFO_LEVEL_SHIFT;
-
-	return level > 0 ? 1 : 0;
-}
-
-static int fsl_rngc_data_read(struct hwrng *rng, u32 * data)
+/*
+ * Drain as much of the FIFO as fits into @data in one go instead of one
+ * word per call, and when asked to wait, poll briefly for the generator
+ * to refill it.
+ */
+static int fsl_rngc_read(struct hwrng *rng, void *data, size_t max, bool wait)
 {
-	int err;
 	u32 rngc_base = (u32) rng->priv;
+	int polls = wait ? RNGC_READ_POLLS : 0;
+	u32 *buf = data;
+	int level, n = 0;
+
+	while (max >= sizeof(u32)) {
+		/* how many random numbers are in FIFO? [0-16] */
+		level = (__raw_readl(rngc_base + RNGC_STATUS) &
+		    RNGC_STATUS_FIFO_LEVEL_MASK) >> RNGC_STATUS_FIFO_LEVEL_SHIFT;
+		if (!level) {
+			if (n || !polls--)
+				break;
+			udelay(10);
+			continue;
+		}
 
-	/* retrieve a random number from FIFO */
-	*data = __raw_readl(rngc_base + RNGC_FIFO);
+		for (; level && max >= sizeof(u32); level--) {
+			*buf++ = __raw_readl(rngc_base + RNGC_FIFO);
+			max -= sizeof(u32);
+			n += sizeof(u32);
+		}
+	}
 
-	/* is there some error while reading this random number? */
-	err = __raw_readl(rngc_base + RNGC_STATUS) & RNGC_STATUS_ERROR;
+	/* is there some error while reading these random numbers? */
+	if (__raw_readl(rngc_base + RNGC_STATUS) & RNGC_STATUS_ERROR) {
+		__raw_writel(RNGC_CMD_CLR_ERR, rngc_base + RNGC_COMMAND);
+		/* if error happened doesn't return random numbers */
+		return 0;
+	}
 
-	/* if error happened doesn't return random number */
-	return err ? 0 : 4;
+	return n;
 }
 
 static irqreturn_t rngc_irq(int irq, void *dev)
@@ -277,8 +294,7 @@ static int fsl_rngc_init(struct hwrng *rng)
 static struct hwrng fsl_rngc = {
 	.name = "fsl-rngc",
 	.init = fsl_rngc_init,
-	.data_present = fsl_rngc_data_present,
-	.data_read = fsl_rngc_data_read
+	.read = fsl_rngc_read,
 };
 
 static int __init fsl_rngc_probe(struct platform_device *pdev)
@@ -241,6 +241,7 @@
 #include <linux/percpu.h>
 #include <linux/cryptohash.h>
 #include <linux/fips.h>
+#include <linux/kthread.h>
 
 #ifdef CONFIG_GENERIC_HARDIRQS
 # include <linux/irq.h>
@@ -717,6 +718,22 @@ void add_disk_randomness(struct gendisk *disk)
 }
 #endif
 
+/*
+ * Used by the hw_random core to feed a hardware generator into the input
+ * pool, crediting @entropy bits for @count bytes. Sleeps while the pool
+ * holds more than random_write_wakeup_thresh bits, like a writer poll()ing
+ * /dev/random would, so the generator is only drained when needed.
+ */
+void add_hwgenerator_randomness(const char *buffer, size_t count,
+				size_t entropy)
+{
+	wait_event_interruptible(random_write_wait, kthread_should_stop() ||
+			input_pool.entropy_count <= random_write_wakeup_thresh);
+	mix_pool_bytes(&input_pool, buffer, count);
+	credit_entropy_bits(&input_pool, entropy);
+}
+EXPORT_SYMBOL_GPL(add_hwgenerator_randomness);
+
 /*********************************************************************
  *
  * Entropy extraction routines
@@ -0,0 +1,404 @@
+/*
+ *  drivers/cpufreq/cpufreq_inputboost.c
+ *
+ *  'inputboost' - go to the maximum frequency as soon as the user touches
+ *  the screen, presses a key or the display gets an update request, hold
+ *  it for a short window and drop back to the minimum right after unless
+ *  the CPU is still busy.
+ *
+ *  Built for e-readers, where nearly all work follows a tap or a page turn
+ *  and the rest of the time the CPU should sit at its lowest operating
+ *  point. Outside a boost the governor samples the load every
+ *  sampling_rate_ms and only runs at the maximum while the load stays
+ *  above up_threshold.
+ *
+ *  Only one policy is handled, which is all the single core i.MX50 has.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+#define DEF_BOOST_MS		(300)
+#define DEF_SAMPLING_RATE_MS	(100)
+#define DEF_UP_THRESHOLD	(80)
+
+static int cpufreq_governor_inputboost(struct cpufreq_policy *policy,
+				       unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_INPUTBOOST
+static
+#endif
+struct cpufreq_governor cpufreq_gov_inputboost = {
+	.name			= "inputboost",
+	.governor		= cpufreq_governor_inputboost,
+	.owner			= THIS_MODULE,
+};
+
+static struct ib_tuners {
+	unsigned int boost_ms;		/* how long a kick holds the boost */
+	unsigned int sampling_rate_ms;	/* load sampling outside a boost */
+	unsigned int up_threshold;	/* % load that keeps/brings max */
+} ib_tuners_ins = {
+	.boost_ms = DEF_BOOST_MS,
+	.sampling_rate_ms = DEF_SAMPLING_RATE_MS,
+	.up_threshold = DEF_UP_THRESHOLD,
+};
+
+static struct ib_info {
+	struct cpufreq_policy *policy;	/* NULL while the governor is off */
+	struct work_struct boost_work;	/* kick: go to max now */
+	struct delayed_work sample_work; /* end of boost / load sample */
+	struct mutex mutex;		/* policy, frequency changes */
+	spinlock_t lock;		/* policy, for the kick */
+	bool input_registered;		/* ib_input_handler is registered */
+	u64 prev_idle;
+	u64 prev_wall;
+	unsigned long boost_until;	/* jiffies */
+	unsigned int kicks;
+	unsigned int boosts;		/* kicks that raised the frequency */
+} ib_info;
+
+static struct workqueue_struct *kinputboost_wq;
+
+/* % of the time since the last call the CPU was busy */
+static unsigned int ib_load(unsigned int cpu)
+{
+	u64 wall, idle, dw, di;
+
+	idle = get_cpu_idle_time_us(cpu, &wall);
+	dw = wall - ib_info.prev_wall;
+	di = idle - ib_info.prev_idle;
+	ib_info.prev_wall = wall;
+	ib_info.prev_idle = idle;
+
+	if (!dw || di > dw)
+		return 0;
+	return div64_u64(100 * (dw - di), dw);
+}
+
+static void ib_schedule_sample(unsigned long delay)
+{
+	queue_delayed_work(kinputboost_wq, &ib_info.sample_work,
+			   max(delay, 1UL));
+}
+
+static void ib_boost_work(struct work_struct *work)
+{
+	struct cpufreq_policy *policy;
+
+	mutex_lock(&ib_info.mutex);
+	policy = ib_info.policy;
+	if (!policy)
+		goto out;
+
+	ib_info.boost_until = jiffies +
+		msecs_to_jiffies(ib_tuners_ins.boost_ms);
+	if (policy->cur < policy->max) {
+		ib_info.boosts++;
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	}
+	/* restart the load window with the boost */
+	ib_load(policy->cpu);
+	cancel_delayed_work(&ib_info.sample_work);
+	ib_schedule_sample(msecs_to_jiffies(ib_tuners_ins.boost_ms));
+out:
+	mutex_unlock(&ib_info.mutex);
+}
+
+static void ib_sample_work(struct work_struct *work)
+{
+	struct cpufreq_policy *policy;
+	unsigned int load;
+
+	mutex_lock(&ib_info.mutex);
+	policy = ib_info.policy;
+	if (!policy)
+		goto out;
+
+	/* kicked again since this was queued */
+	if (time_before(jiffies, ib_info.boost_until)) {
+		ib_schedule_sample(ib_info.boost_until - jiffies);
+		goto out;
+	}
+
+	load = ib_load(policy->cpu);
+	if (load >= ib_tuners_ins.up_threshold) {
+		if (policy->cur < policy->max)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+	} else if (policy->cur > policy->min) {
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+	}
+	ib_schedule_sample(msecs_to_jiffies(ib_tuners_ins.sampling_rate_ms));
+out:
+	mutex_unlock(&ib_info.mutex);
+}
+
+/**
+ * cpufreq_inputboost_kick - boost to the maximum frequency for boost_ms
+ *
+ * Safe from any context. Does nothing unless 'inputboost' is the active
+ * governor.
+ */
+void cpufreq_inputboost_kick(void)
+{
+	struct cpufreq_policy *policy;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ib_info.lock, flags);
+	policy = ib_info.policy;
+	if (!policy)
+		goto out;
+	ib_info.kicks++;
+	/* already at max for long enough: nothing to do */
+	if (policy->cur == policy->max &&
+	    time_before(jiffies + msecs_to_jiffies(ib_tuners_ins.boost_ms) / 2,
+			ib_info.boost_until))
+		goto out;
+	queue_work(kinputboost_wq, &ib_info.boost_work);
+out:
+	spin_unlock_irqrestore(&ib_info.lock, flags);
+}
+EXPORT_SYMBOL_GPL(cpufreq_inputboost_kick);
+
+/* Input handler: any key or touch event kicks the boost */
+static void ib_input_event(struct input_handle *handle, unsigned int type,
+			   unsigned int code, int value)
+{
+	if (type == EV_KEY || type == EV_ABS)
+		cpufreq_inputboost_kick();
+}
+
+static int ib_input_connect(struct input_handler *handler,
+			    struct input_dev *dev,
+			    const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "inputboost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void ib_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id ib_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},	/* touchscreens: zForce, MSP430, ... */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},	/* page turn and other keys */
+	{ },
+};
+
+static struct input_handler ib_input_handler = {
+	.event		= ib_input_event,
+	.connect	= ib_input_connect,
+	.disconnect	= ib_input_disconnect,
+	.name		= "cpufreq_inputboost",
+	.id_table	= ib_input_ids,
+};
+
+/* sysfs: /sys/devices/system/cpu/cpufreq/inputboost/ */
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", object);				\
+}
+show_one(boost_ms, ib_tuners_ins.boost_ms);
+show_one(sampling_rate_ms, ib_tuners_ins.sampling_rate_ms);
+show_one(up_threshold, ib_tuners_ins.up_threshold);
+show_one(kicks, ib_info.kicks);
+show_one(boosts, ib_info.boosts);
+
+#define store_one(file_name, object, min, max)				\
+static ssize_t store_##file_name					\
+(struct kobject *a, struct attribute *b, const char *buf, size_t count)\
+{									\
+	unsigned int input;						\
+									\
+	if (sscanf(buf, "%u", &input) != 1 ||				\
+	    input < (min) || input > (max))				\
+		return -EINVAL;						\
+	mutex_lock(&ib_info.mutex);					\
+	object = input;							\
+	mutex_unlock(&ib_info.mutex);					\
+	return count;							\
+}
+store_one(boost_ms, ib_tuners_ins.boost_ms, 10, 10000);
+store_one(sampling_rate_ms, ib_tuners_ins.sampling_rate_ms, 10, 10000);
+store_one(up_threshold, ib_tuners_ins.up_threshold, 1, 100);
+
+define_one_global_rw(boost_ms);
+define_one_global_rw(sampling_rate_ms);
+define_one_global_rw(up_threshold);
+define_one_global_ro(kicks);
+define_one_global_ro(boosts);
+
+static struct attribute *ib_attributes[] = {
+	&boost_ms.attr,
+	&sampling_rate_ms.attr,
+	&up_threshold.attr,
+	&kicks.attr,
+	&boosts.attr,
+	NULL
+};
+
+static struct attribute_group ib_attr_group = {
+	.attrs = ib_attributes,
+	.name = "inputboost",
+};
+
+static int cpufreq_governor_inputboost(struct cpufreq_policy *policy,
+				       unsigned int event)
+{
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu) || !policy->cur)
+			return -EINVAL;
+		if (ib_info.policy)
+			return -EBUSY;
+
+		rc = sysfs_create_group(cpufreq_global_kobject,
+					&ib_attr_group);
+		if (rc)
+			return rc;
+
+		mutex_lock(&ib_info.mutex);
+		spin_lock_irq(&ib_info.lock);
+		ib_info.policy = policy;
+		spin_unlock_irq(&ib_info.lock);
+		ib_info.boost_until = jiffies;
+		ib_load(policy->cpu);
+		ib_schedule_sample(
+			msecs_to_jiffies(ib_tuners_ins.sampling_rate_ms));
+		mutex_unlock(&ib_info.mutex);
+
+		rc = input_register_handler(&ib_input_handler);
+		if (rc)
+			printk(KERN_WARNING "cpufreq_inputboost: no input "
+			       "handler (%d), only explicit kicks\n", rc);
+		ib_info.input_registered = !rc;
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		if (ib_info.input_registered) {
+			input_unregister_handler(&ib_input_handler);
+			ib_info.input_registered = false;
+		}
+
+		mutex_lock(&ib_info.mutex);
+		spin_lock_irq(&ib_info.lock);
+		ib_info.policy = NULL;
+		spin_unlock_irq(&ib_info.lock);
+		mutex_unlock(&ib_info.mutex);
+		cancel_work_sync(&ib_info.boost_work);
+		cancel_delayed_work_sync(&ib_info.sample_work);
+
+		sysfs_remove_group(cpufreq_global_kobject, &ib_attr_group);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&ib_info.mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+						CPUFREQ_RELATION_L);
+		mutex_unlock(&ib_info.mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_gov_inputboost_init(void)
+{
+	int err;
+
+	mutex_init(&ib_info.mutex);
+	spin_lock_init(&ib_info.lock);
+	INIT_WORK(&ib_info.boost_work, ib_boost_work);
+	INIT_DELAYED_WORK_DEFERRABLE(&ib_info.sample_work, ib_sample_work);
+
+	/* realtime, so a kick is not queued behind the work it speeds up */
+	kinputboost_wq = create_rt_workqueue("kinputboost");
+	if (!kinputboost_wq) {
+		printk(KERN_ERR "Creation of kinputboost failed\n");
+		return -EFAULT;
+	}
+	err = cpufreq_register_governor(&cpufreq_gov_inputboost);
+	if (err)
+		destroy_workqueue(kinputboost_wq);
+
+	return err;
+}
+
+static void __exit cpufreq_gov_inputboost_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_inputboost);
+	destroy_workqueue(kinputboost_wq);
+}
+
+MODULE_DESCRIPTION("'cpufreq_inputboost' - boost on user input, "
+	"then drop back to the minimum frequency");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INPUTBOOST
+fs_initcall(cpufreq_gov_inputboost_init);
+#else
+module_init(cpufreq_gov_inputboost_init);
+#endif
+module_exit(cpufreq_gov_inputboost_exit);
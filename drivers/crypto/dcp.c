@@ -33,10 +33,12 @@
 #include <crypto/sha.h>
 #include <crypto/hash.h>
 #include <crypto/internal/hash.h>
+#include <crypto/scatterwalk.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
 #include <linux/clk.h>
 #include <linux/io.h>
 #include <linux/delay.h>
@@ -52,6 +54,26 @@ struct dcpboot_dma_area {
 	uint16_t block[16];
 };
 
+/* Hardware packets and per request key + IV of one ecb/cbc(aes) batch */
+#define DCP_AES_MAX_PKTS	64
+#define DCP_AES_MAX_BATCH	16
+
+struct dcp_aes_batch {
+	struct dcp_hw_packet pkt[DCP_AES_MAX_PKTS];
+	u8 payload[DCP_AES_MAX_BATCH][2 * AES_KEYSIZE_128]
+		__attribute__ ((__aligned__(32)));
+};
+
+/* Hardware packets and per request digests of one sha1/sha256 batch */
+#define DCP_SHA_MAX_PKTS	64
+#define DCP_SHA_MAX_BATCH	16
+
+struct dcp_sha_batch {
+	struct dcp_hw_packet pkt[DCP_SHA_MAX_PKTS];
+	u8 digest[DCP_SHA_MAX_BATCH][SHA256_DIGEST_SIZE]
+		__attribute__ ((__aligned__(32)));
+};
+
 struct dcp {
 	struct device *dev;
 	spinlock_t lock;
@@ -76,6 +98,20 @@ struct dcp {
 	/* Following data only used by DCP bootstream interface */
 	struct dcpboot_dma_area *dcpboot_dma_area;
 	dma_addr_t dcpboot_dma_area_phys;
+
+	/* ecb/cbc(aes) requests, queue protected by lock */
+	struct crypto_queue aes_queue;
+	struct workqueue_struct *aes_wq;
+	struct work_struct aes_work;
+	struct dcp_aes_batch *aes_batch;
+	dma_addr_t aes_batch_phys;
+
+	/* sha1/sha256 ahash requests, queue protected by lock */
+	struct crypto_queue sha_queue;
+	struct workqueue_struct *sha_wq;
+	struct work_struct sha_work;
+	struct dcp_sha_batch *sha_batch;
+	dma_addr_t sha_batch_phys;
 };
 
 /* cipher flags */
@@ -523,445 +559,477 @@ static struct crypto_alg dcp_aes_alg = {
 	}
 };
 
-static int dcp_aes_setkey_blk(struct crypto_tfm *tfm, const u8 *key,
+/*
+ * Asynchronous ecb(aes) and cbc(aes)
+ *
+ * Requests are queued and handed to the cipher channel in batches: every
+ * segment of every request in a batch becomes one hardware packet, the
+ * packets are chained, and the whole batch is started with a single
+ * semaphore increment and completes with a single interrupt.  The first
+ * packet of each request loads its own key and IV from its payload, the
+ * following ones carry the CBC state on from the previous packet.
+ *
+ * Keys the DCP cannot take (192 and 256 bits) and requests the DMA cannot
+ * do directly (segments that are not a multiple of the block size or not
+ * word aligned) go through a software fallback.
+ */
+struct dcp_aes_ctx {
+	u8 key[AES_KEYSIZE_128];
+	unsigned int keylen;
+	struct crypto_blkcipher *fallback;
+};
+
+struct dcp_aes_reqctx {
+	unsigned int flags;
+	unsigned int first_pkt;
+	unsigned int nr_pkts;
+	u8 iv_out[AES_BLOCK_SIZE];	/* last ciphertext block, for decrypt */
+};
+
+static int dcp_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 		unsigned int len)
 {
-	struct dcp_op *op = crypto_tfm_ctx(tfm);
-	unsigned int ret;
-
-	op->cipher.keylen = len;
+	struct dcp_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	int ret;
 
+	ctx->keylen = len;
 	if (len == AES_KEYSIZE_128) {
-		memcpy(op->cipher.key, key, len);
+		memcpy(ctx->key, key, len);
 		return 0;
 	}
 
 	if (len != AES_KEYSIZE_192 && len != AES_KEYSIZE_256) {
-		/* not supported at all */
-		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		crypto_ablkcipher_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
 		return -EINVAL;
 	}
 
 	/*
 	 * The requested key size is not supported by HW, do a fallback
 	 */
-	op->fallback.blk->base.crt_flags &= ~CRYPTO_TFM_REQ_MASK;
-	op->fallback.blk->base.crt_flags |= (tfm->crt_flags &
-						CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(ctx->fallback,
+			crypto_ablkcipher_get_flags(tfm) & CRYPTO_TFM_REQ_MASK);
 
-	ret = crypto_blkcipher_setkey(op->fallback.blk, key, len);
+	ret = crypto_blkcipher_setkey(ctx->fallback, key, len);
 	if (ret) {
-		tfm->crt_flags &= ~CRYPTO_TFM_RES_MASK;
-		tfm->crt_flags |= (op->fallback.blk->base.crt_flags &
-					CRYPTO_TFM_RES_MASK);
+		crypto_ablkcipher_clear_flags(tfm, CRYPTO_TFM_RES_MASK);
+		crypto_ablkcipher_set_flags(tfm,
+			crypto_blkcipher_get_flags(ctx->fallback) &
+			CRYPTO_TFM_RES_MASK);
 	}
 	return ret;
 }
 
-static int fallback_blk_dec(struct blkcipher_desc *desc,
-		struct scatterlist *dst, struct scatterlist *src,
-		unsigned int nbytes)
+static int dcp_aes_fallback(struct ablkcipher_request *req,
+		unsigned int flags)
 {
-	unsigned int ret;
-	struct crypto_blkcipher *tfm;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-
-	tfm = desc->tfm;
-	desc->tfm = op->fallback.blk;
+	struct dcp_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct blkcipher_desc desc;
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags;
+
+	if (flags & DCP_ENC)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+				req->nbytes);
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+			req->nbytes);
+}
 
-	ret = crypto_blkcipher_decrypt_iv(desc, dst, src, nbytes);
+static int dcp_sg_count(struct scatterlist *sg, unsigned int nbytes)
+{
+	int n = 0;
 
-	desc->tfm = tfm;
-	return ret;
+	while (nbytes && sg) {
+		nbytes -= min(nbytes, sg->length);
+		sg = scatterwalk_sg_next(sg);
+		n++;
+	}
+	return n;
 }
 
-static int fallback_blk_enc(struct blkcipher_desc *desc,
-		struct scatterlist *dst, struct scatterlist *src,
-		unsigned int nbytes)
+/*
+ * Turn the segments of @req into packets starting at packet @first.
+ * Returns the number of packets, 0 if the request cannot be done by the
+ * DCP directly or -ENOSPC if it does not fit into what is left of the
+ * batch.
+ */
+static int dcp_aes_map_req(struct dcp *sdcp, struct ablkcipher_request *req,
+		unsigned int first, unsigned int slot)
 {
-	unsigned int ret;
-	struct crypto_blkcipher *tfm;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-
-	tfm = desc->tfm;
-	desc->tfm = op->fallback.blk;
+	struct dcp_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct dcp_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct dcp_aes_batch *b = sdcp->aes_batch;
+	struct scatterlist *src = req->src, *dst = req->dst;
+	unsigned int remain = req->nbytes, soff = 0, doff = 0;
+	unsigned int n = 0;
+	dma_addr_t payload;
+	u32 pkt1, pkt2;
 
-	ret = crypto_blkcipher_encrypt_iv(desc, dst, src, nbytes);
+	/* Check the layout before mapping anything */
+	while (remain) {
+		unsigned int len;
+
+		if (!src || !dst)
+			return 0;
+		len = min_t(unsigned int,
+			    min(src->length - soff, dst->length - doff), remain);
+		if ((len % AES_BLOCK_SIZE) || ((src->offset + soff) & 3) ||
+		    ((dst->offset + doff) & 3))
+			return 0;
+		n++;
+		remain -= len;
+		soff += len;
+		doff += len;
+		if (soff == src->length) {
+			src = scatterwalk_sg_next(src);
+			soff = 0;
+		}
+		if (doff == dst->length) {
+			dst = scatterwalk_sg_next(dst);
+			doff = 0;
+		}
+	}
 
-	desc->tfm = tfm;
-	return ret;
-}
+	if (n > DCP_AES_MAX_PKTS)
+		return 0;
+	if (first + n > DCP_AES_MAX_PKTS)
+		return -ENOSPC;
 
-static int fallback_init_blk(struct crypto_tfm *tfm)
-{
-	const char *name = tfm->__crt_alg->cra_name;
-	struct dcp_op *op = crypto_tfm_ctx(tfm);
+	if (!(rctx->flags & DCP_ENC) && (rctx->flags & DCP_CBC))
+		scatterwalk_map_and_copy(rctx->iv_out, req->src,
+				req->nbytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0);
 
-	op->fallback.blk = crypto_alloc_blkcipher(name, 0,
-			CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (req->src == req->dst) {
+		dma_map_sg(sdcp->dev, req->src,
+			dcp_sg_count(req->src, req->nbytes), DMA_BIDIRECTIONAL);
+	} else {
+		dma_map_sg(sdcp->dev, req->src,
+			dcp_sg_count(req->src, req->nbytes), DMA_TO_DEVICE);
+		dma_map_sg(sdcp->dev, req->dst,
+			dcp_sg_count(req->dst, req->nbytes), DMA_FROM_DEVICE);
+	}
+
+	memcpy(b->payload[slot], ctx->key, AES_KEYSIZE_128);
+	if (rctx->flags & DCP_CBC)
+		memcpy(b->payload[slot] + AES_KEYSIZE_128, req->info,
+			AES_BLOCK_SIZE);
+	payload = sdcp->aes_batch_phys +
+		offsetof(struct dcp_aes_batch, payload[slot]);
+
+	pkt1 = BM_DCP_PACKET1_ENABLE_CIPHER | BM_DCP_PACKET1_PAYLOAD_KEY;
+	if (rctx->flags & DCP_ENC)
+		pkt1 |= BM_DCP_PACKET1_CIPHER_ENCRYPT;
+	pkt2 = BF(BV_DCP_PACKET2_CIPHER_SELECT__AES128,
+		DCP_PACKET2_CIPHER_SELECT);
+	if (rctx->flags & DCP_CBC)
+		pkt2 |= BF(BV_DCP_PACKET2_CIPHER_MODE__CBC,
+			DCP_PACKET2_CIPHER_MODE);
+	else
+		pkt2 |= BF(BV_DCP_PACKET2_CIPHER_MODE__ECB,
+			DCP_PACKET2_CIPHER_MODE);
+
+	src = req->src;
+	dst = req->dst;
+	soff = doff = 0;
+	remain = req->nbytes;
+	for (n = first; remain; n++) {
+		struct dcp_hw_packet *pkt = &b->pkt[n];
+		unsigned int len = min_t(unsigned int,
+			min(sg_dma_len(src) - soff, sg_dma_len(dst) - doff),
+			remain);
+
+		pkt->pNext = sdcp->aes_batch_phys +
+			offsetof(struct dcp_aes_batch, pkt[n + 1]);
+		pkt->pkt1 = pkt1 | BM_DCP_PACKET1_CHAIN;
+		if (n == first && (rctx->flags & DCP_CBC))
+			pkt->pkt1 |= BM_DCP_PACKET1_CIPHER_INIT;
+		pkt->pkt2 = pkt2;
+		pkt->pSrc = sg_dma_address(src) + soff;
+		pkt->pDst = sg_dma_address(dst) + doff;
+		pkt->size = len;
+		pkt->pPayload = payload;
+		pkt->stat = 0;
 
-	if (IS_ERR(op->fallback.blk)) {
-		printk(KERN_ERR "Error allocating fallback algo %s\n", name);
-		return PTR_ERR(op->fallback.blk);
+		remain -= len;
+		soff += len;
+		doff += len;
+		if (soff == sg_dma_len(src)) {
+			src = scatterwalk_sg_next(src);
+			soff = 0;
+		}
+		if (doff == sg_dma_len(dst)) {
+			dst = scatterwalk_sg_next(dst);
+			doff = 0;
+		}
 	}
 
-	return 0;
+	rctx->first_pkt = first;
+	rctx->nr_pkts = n - first;
+	return rctx->nr_pkts;
 }
 
-static void fallback_exit_blk(struct crypto_tfm *tfm)
+static void dcp_aes_unmap_req(struct dcp *sdcp, struct ablkcipher_request *req)
 {
-	struct dcp_op *op = crypto_tfm_ctx(tfm);
-
-	crypto_free_blkcipher(op->fallback.blk);
-	op->fallback.blk = NULL;
+	if (req->src == req->dst) {
+		dma_unmap_sg(sdcp->dev, req->src,
+			dcp_sg_count(req->src, req->nbytes), DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(sdcp->dev, req->src,
+			dcp_sg_count(req->src, req->nbytes), DMA_TO_DEVICE);
+		dma_unmap_sg(sdcp->dev, req->dst,
+			dcp_sg_count(req->dst, req->nbytes), DMA_FROM_DEVICE);
+	}
 }
 
-static int
-dcp_aes_ecb_decrypt(struct blkcipher_desc *desc,
-		  struct scatterlist *dst, struct scatterlist *src,
-		  unsigned int nbytes)
+static void dcp_aes_complete(struct ablkcipher_request *req, int err)
 {
-	struct dcp *sdcp = global_sdcp;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-	struct blkcipher_walk walk;
-	int err;
+	struct dcp_aes_reqctx *rctx = ablkcipher_request_ctx(req);
 
-	if (unlikely(op->cipher.keylen != AES_KEYSIZE_128))
-		return fallback_blk_dec(desc, dst, src, nbytes);
+	/* Leave the IV for the next request of the chain, as cbc() does */
+	if (!err && (rctx->flags & DCP_CBC)) {
+		if (rctx->flags & DCP_ENC)
+			scatterwalk_map_and_copy(req->info, req->dst,
+				req->nbytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0);
+		else
+			memcpy(req->info, rctx->iv_out, AES_BLOCK_SIZE);
+	}
 
-	blkcipher_walk_init(&walk, dst, src, nbytes);
+	local_bh_disable();
+	req->base.complete(&req->base, err);
+	local_bh_enable();
+}
 
-	/* key needs to be mapped only once */
-	op->cipher.key_phys = dma_map_single(sdcp->dev, op->cipher.key,
-				AES_KEYSIZE_128, DMA_TO_DEVICE);
-	if (dma_mapping_error(sdcp->dev, op->cipher.key_phys)) {
-		dev_err(sdcp->dev, "Unable to map key\n");
-		return -ENOMEM;
-	}
-
-	err = blkcipher_walk_virt(desc, &walk);
-	while (err == 0 && (nbytes = walk.nbytes) > 0) {
-		op->src = walk.src.virt.addr,
-		op->dst = walk.dst.virt.addr;
-		op->flags = DCP_AES | DCP_DEC |
-				DCP_ECB;
-		op->len = nbytes - (nbytes % AES_KEYSIZE_128);
-
-		/* map the data */
-		op->src_phys = dma_map_single(sdcp->dev, op->src, op->len,
-						DMA_TO_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->src_phys)) {
-			dev_err(sdcp->dev, "Unable to map source\n");
-			err = -ENOMEM;
-			break;
-		}
+/* Run the chain built in the batch area, @nr_pkts packets long */
+static int dcp_aes_run_batch(struct dcp *sdcp, unsigned int nr_pkts)
+{
+	struct dcp_hw_packet *last = &sdcp->aes_batch->pkt[nr_pkts - 1];
+	const int chan = CIPHER_CHAN;
+	int err = 0;
+	u32 stat;
 
-		op->dst_phys = dma_map_single(sdcp->dev, op->dst, op->len,
-						DMA_FROM_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->dst_phys)) {
-			dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-						DMA_TO_DEVICE);
-			dev_err(sdcp->dev, "Unable to map dest\n");
-			err = -ENOMEM;
-			break;
-		}
+	last->pNext = 0;
+	last->pkt1 &= ~BM_DCP_PACKET1_CHAIN;
+	last->pkt1 |= BM_DCP_PACKET1_DECR_SEMAPHORE | BM_DCP_PACKET1_INTERRUPT;
+	wmb();
 
-		/* perform! */
-		dcp_perform_op(op);
+	mutex_lock(&sdcp->op_mutex[chan]);
+	dcp_clock(sdcp, CLOCK_ON, false);
+	sdcp->chan_in_use[chan] = true;
 
-		dma_unmap_single(sdcp->dev, op->dst_phys, op->len,
-					DMA_FROM_DEVICE);
-		dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-					DMA_TO_DEVICE);
+	__raw_writel(-1, sdcp->dcp_regs_base + HW_DCP_CHnSTAT_CLR(chan));
+	__raw_writel((u32)sdcp->aes_batch_phys, sdcp->dcp_regs_base +
+		HW_DCP_CHnCMDPTR(chan));
 
-		nbytes -= op->len;
-		err = blkcipher_walk_done(desc, &walk, nbytes);
-	}
+	INIT_COMPLETION(sdcp->op_wait[chan]);
+	sdcp->wait[chan] = 0;
+	__raw_writel(BF(1, DCP_CHnSEMA_INCREMENT), sdcp->dcp_regs_base
+		+ HW_DCP_CHnSEMA(chan));
 
-	dma_unmap_single(sdcp->dev, op->cipher.key_phys, AES_KEYSIZE_128,
-				DMA_TO_DEVICE);
+	if (!wait_for_completion_timeout(&sdcp->op_wait[chan],
+			msecs_to_jiffies(1000))) {
+		dev_err(sdcp->dev, "Timeout while waiting STAT 0x%08x\n",
+				__raw_readl(sdcp->dcp_regs_base + HW_DCP_STAT));
+		err = -ETIMEDOUT;
+		goto out;
+	}
 
+	stat = __raw_readl(sdcp->dcp_regs_base + HW_DCP_CHnSTAT(chan));
+	if ((stat & 0xff) != 0) {
+		dev_err(sdcp->dev, "Channel stat error 0x%02x\n", stat & 0xff);
+		err = -EIO;
+	}
+out:
+	sdcp->chan_in_use[chan] = false;
+	dcp_clock(sdcp, CLOCK_OFF, false);
+	mutex_unlock(&sdcp->op_mutex[chan]);
 	return err;
 }
 
-static int
-dcp_aes_ecb_encrypt(struct blkcipher_desc *desc,
-		  struct scatterlist *dst, struct scatterlist *src,
-		  unsigned int nbytes)
+static struct crypto_async_request *dcp_aes_dequeue(struct dcp *sdcp)
 {
-	struct dcp *sdcp = global_sdcp;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-	struct blkcipher_walk walk;
-	int err, ret;
+	struct crypto_async_request *async_req, *backlog;
 
-	if (unlikely(op->cipher.keylen != AES_KEYSIZE_128))
-		return fallback_blk_enc(desc, dst, src, nbytes);
+	spin_lock_irq(&sdcp->lock);
+	backlog = crypto_get_backlog(&sdcp->aes_queue);
+	async_req = crypto_dequeue_request(&sdcp->aes_queue);
+	spin_unlock_irq(&sdcp->lock);
 
-	blkcipher_walk_init(&walk, dst, src, nbytes);
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+	return async_req;
+}
 
-	/* key needs to be mapped only once */
-	op->cipher.key_phys = dma_map_single(sdcp->dev, op->cipher.key,
-				AES_KEYSIZE_128, DMA_TO_DEVICE);
-	if (dma_mapping_error(sdcp->dev, op->cipher.key_phys)) {
-		dev_err(sdcp->dev, "Unable to map key\n");
-		return -ENOMEM;
-	}
+static void dcp_aes_work(struct work_struct *work)
+{
+	struct dcp *sdcp = container_of(work, struct dcp, aes_work);
+	struct ablkcipher_request *batch[DCP_AES_MAX_BATCH];
+	struct ablkcipher_request *req = NULL;
+	struct crypto_async_request *async_req;
+	unsigned int nr, nr_pkts, i;
+	int ret;
+
+	do {
+		nr = nr_pkts = 0;
+		while (nr < DCP_AES_MAX_BATCH) {
+			if (!req) {
+				async_req = dcp_aes_dequeue(sdcp);
+				if (!async_req)
+					break;
+				req = ablkcipher_request_cast(async_req);
+			}
 
-	err = blkcipher_walk_virt(desc, &walk);
+			ret = dcp_aes_map_req(sdcp, req, nr_pkts, nr);
+			if (ret == -ENOSPC)
+				break;	/* carried over to the next batch */
+			if (ret == 0) {
+				struct dcp_aes_reqctx *rctx =
+					ablkcipher_request_ctx(req);
+
+				ret = dcp_aes_fallback(req, rctx->flags);
+				local_bh_disable();
+				req->base.complete(&req->base, ret);
+				local_bh_enable();
+			} else {
+				batch[nr++] = req;
+				nr_pkts += ret;
+			}
+			req = NULL;
+		}
 
-	err = 0;
-	while (err == 0 && (nbytes = walk.nbytes) > 0) {
-		op->src = walk.src.virt.addr,
-		op->dst = walk.dst.virt.addr;
-		op->flags = DCP_AES | DCP_ENC |
-			    DCP_ECB;
-		op->len = nbytes - (nbytes % AES_KEYSIZE_128);
+		if (!nr)
+			continue;
 
-		/* map the data */
-		op->src_phys = dma_map_single(sdcp->dev, op->src, op->len,
-				DMA_TO_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->src_phys)) {
-			dev_err(sdcp->dev, "Unable to map source\n");
-			err = -ENOMEM;
-			break;
+		ret = dcp_aes_run_batch(sdcp, nr_pkts);
+		for (i = 0; i < nr; i++) {
+			dcp_aes_unmap_req(sdcp, batch[i]);
+			dcp_aes_complete(batch[i], ret);
 		}
+	} while (nr || req);
+}
 
-		op->dst_phys = dma_map_single(sdcp->dev, op->dst, op->len,
-				DMA_FROM_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->dst_phys)) {
-			dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-					DMA_TO_DEVICE);
-			dev_err(sdcp->dev, "Unable to map dest\n");
-			err = -ENOMEM;
-			break;
-		}
+static int dcp_aes_queue(struct ablkcipher_request *req, unsigned int flags)
+{
+	struct dcp *sdcp = global_sdcp;
+	struct dcp_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct dcp_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	unsigned long irqflags;
+	int ret;
+
+	if (unlikely(ctx->keylen != AES_KEYSIZE_128))
+		return dcp_aes_fallback(req, flags);
+	if (req->nbytes % AES_BLOCK_SIZE)
+		return -EINVAL;
+	if (!req->nbytes)
+		return 0;
 
-		/* perform! */
-		dcp_perform_op(op);
+	rctx->flags = flags;
 
-		dma_unmap_single(sdcp->dev, op->dst_phys, op->len,
-				DMA_FROM_DEVICE);
-		dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-				DMA_TO_DEVICE);
+	spin_lock_irqsave(&sdcp->lock, irqflags);
+	ret = ablkcipher_enqueue_request(&sdcp->aes_queue, req);
+	spin_unlock_irqrestore(&sdcp->lock, irqflags);
 
-		nbytes -= op->len;
-		ret =  blkcipher_walk_done(desc, &walk, nbytes);
-	}
+	queue_work(sdcp->aes_wq, &sdcp->aes_work);
+	return ret;
+}
 
-	dma_unmap_single(sdcp->dev, op->cipher.key_phys, AES_KEYSIZE_128,
-			DMA_TO_DEVICE);
+static int dcp_aes_ecb_encrypt(struct ablkcipher_request *req)
+{
+	return dcp_aes_queue(req, DCP_AES | DCP_ENC | DCP_ECB);
+}
 
-	return err;
+static int dcp_aes_ecb_decrypt(struct ablkcipher_request *req)
+{
+	return dcp_aes_queue(req, DCP_AES | DCP_DEC | DCP_ECB);
 }
 
+static int dcp_aes_cbc_encrypt(struct ablkcipher_request *req)
+{
+	return dcp_aes_queue(req, DCP_AES | DCP_ENC | DCP_CBC);
+}
+
+static int dcp_aes_cbc_decrypt(struct ablkcipher_request *req)
+{
+	return dcp_aes_queue(req, DCP_AES | DCP_DEC | DCP_CBC);
+}
+
+static int dcp_aes_cra_init(struct crypto_tfm *tfm)
+{
+	const char *name = tfm->__crt_alg->cra_name;
+	struct dcp_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+			CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		printk(KERN_ERR "Error allocating fallback algo %s\n", name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	tfm->crt_ablkcipher.reqsize = sizeof(struct dcp_aes_reqctx);
+	return 0;
+}
+
+static void dcp_aes_cra_exit(struct crypto_tfm *tfm)
+{
+	struct dcp_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_blkcipher(ctx->fallback);
+	ctx->fallback = NULL;
+}
 
 static struct crypto_alg dcp_aes_ecb_alg = {
 	.cra_name		= "ecb(aes)",
 	.cra_driver_name	= "dcp-ecb-aes",
 	.cra_priority		= 400,
-	.cra_alignmask		= 15,
-	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER |
+	.cra_alignmask		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
+				  CRYPTO_ALG_ASYNC |
 				  CRYPTO_ALG_NEED_FALLBACK,
-	.cra_init		= fallback_init_blk,
-	.cra_exit		= fallback_exit_blk,
-	.cra_blocksize		= AES_KEYSIZE_128,
-	.cra_ctxsize		= sizeof(struct dcp_op),
-	.cra_type		= &crypto_blkcipher_type,
+	.cra_init		= dcp_aes_cra_init,
+	.cra_exit		= dcp_aes_cra_exit,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct dcp_aes_ctx),
+	.cra_type		= &crypto_ablkcipher_type,
 	.cra_module		= THIS_MODULE,
 	.cra_list		= LIST_HEAD_INIT(dcp_aes_ecb_alg.cra_list),
 	.cra_u			= {
-		.blkcipher 	= {
+		.ablkcipher	= {
 			.min_keysize	= AES_MIN_KEY_SIZE,
 			.max_keysize	= AES_MAX_KEY_SIZE,
-			.setkey		= dcp_aes_setkey_blk,
+			.setkey		= dcp_aes_setkey,
 			.encrypt	= dcp_aes_ecb_encrypt,
 			.decrypt	= dcp_aes_ecb_decrypt
 		}
 	}
 };
 
-static int
-dcp_aes_cbc_decrypt(struct blkcipher_desc *desc,
-		  struct scatterlist *dst, struct scatterlist *src,
-		  unsigned int nbytes)
-{
-	struct dcp *sdcp = global_sdcp;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-	struct blkcipher_walk walk;
-	int err, blockno;
-
-	if (unlikely(op->cipher.keylen != AES_KEYSIZE_128))
-		return fallback_blk_dec(desc, dst, src, nbytes);
-
-	blkcipher_walk_init(&walk, dst, src, nbytes);
-
-	blockno = 0;
-	err = blkcipher_walk_virt(desc, &walk);
-	while (err == 0 && (nbytes = walk.nbytes) > 0) {
-		op->src = walk.src.virt.addr,
-		op->dst = walk.dst.virt.addr;
-		op->flags = DCP_AES | DCP_DEC |
-			    DCP_CBC;
-		if (blockno == 0) {
-			op->flags |= DCP_CBC_INIT;
-			memcpy(op->cipher.key + AES_KEYSIZE_128, walk.iv,
-				AES_KEYSIZE_128);
-		}
-		op->len = nbytes - (nbytes % AES_KEYSIZE_128);
-
-		/* key (+iv) needs to be mapped only once */
-		op->cipher.key_phys = dma_map_single(sdcp->dev, op->cipher.key,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-		if (dma_mapping_error(sdcp->dev, op->cipher.key_phys)) {
-			dev_err(sdcp->dev, "Unable to map key\n");
-			err = -ENOMEM;
-			break;
-		}
-
-		/* map the data */
-		op->src_phys = dma_map_single(sdcp->dev, op->src, op->len,
-					DMA_TO_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->src_phys)) {
-			dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-			dev_err(sdcp->dev, "Unable to map source\n");
-			err = -ENOMEM;
-			break;
-		}
-
-		op->dst_phys = dma_map_single(sdcp->dev, op->dst, op->len,
-						DMA_FROM_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->dst_phys)) {
-			dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-			dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-					DMA_TO_DEVICE);
-			dev_err(sdcp->dev, "Unable to map dest\n");
-			err = -ENOMEM;
-			break;
-		}
-
-		/* perform! */
-		dcp_perform_op(op);
-
-		dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-		dma_unmap_single(sdcp->dev, op->dst_phys, op->len,
-					DMA_FROM_DEVICE);
-		dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-					DMA_TO_DEVICE);
-
-		nbytes -= op->len;
-		err = blkcipher_walk_done(desc, &walk, nbytes);
-
-		blockno++;
-	}
-
-	return err;
-}
-
-static int
-dcp_aes_cbc_encrypt(struct blkcipher_desc *desc,
-		  struct scatterlist *dst, struct scatterlist *src,
-		  unsigned int nbytes)
-{
-	struct dcp *sdcp = global_sdcp;
-	struct dcp_op *op = crypto_blkcipher_ctx(desc->tfm);
-	struct blkcipher_walk walk;
-	int err, ret, blockno;
-
-	if (unlikely(op->cipher.keylen != AES_KEYSIZE_128))
-		return fallback_blk_enc(desc, dst, src, nbytes);
-
-	blkcipher_walk_init(&walk, dst, src, nbytes);
-
-	blockno = 0;
-
-	err = blkcipher_walk_virt(desc, &walk);
-	while (err == 0 && (nbytes = walk.nbytes) > 0) {
-		op->src = walk.src.virt.addr,
-		op->dst = walk.dst.virt.addr;
-		op->flags = DCP_AES | DCP_ENC |
-			    DCP_CBC;
-		if (blockno == 0) {
-			op->flags |= DCP_CBC_INIT;
-			memcpy(op->cipher.key + AES_KEYSIZE_128, walk.iv,
-				AES_KEYSIZE_128);
-		}
-		op->len = nbytes - (nbytes % AES_KEYSIZE_128);
-
-		/* key needs to be mapped only once */
-		op->cipher.key_phys = dma_map_single(sdcp->dev, op->cipher.key,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-		if (dma_mapping_error(sdcp->dev, op->cipher.key_phys)) {
-			dev_err(sdcp->dev, "Unable to map key\n");
-			return -ENOMEM;
-		}
-
-		/* map the data */
-		op->src_phys = dma_map_single(sdcp->dev, op->src, op->len,
-				DMA_TO_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->src_phys)) {
-			dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-				AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-			dev_err(sdcp->dev, "Unable to map source\n");
-			err = -ENOMEM;
-			break;
-		}
-
-		op->dst_phys = dma_map_single(sdcp->dev, op->dst, op->len,
-				DMA_FROM_DEVICE);
-		if (dma_mapping_error(sdcp->dev, op->dst_phys)) {
-			dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-					AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-			dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-					DMA_TO_DEVICE);
-			dev_err(sdcp->dev, "Unable to map dest\n");
-			err = -ENOMEM;
-			break;
-		}
-
-		/* perform! */
-		dcp_perform_op(op);
-
-		dma_unmap_single(sdcp->dev, op->cipher.key_phys,
-				AES_KEYSIZE_128 * 2, DMA_BIDIRECTIONAL);
-		dma_unmap_single(sdcp->dev, op->dst_phys, op->len,
-				DMA_FROM_DEVICE);
-		dma_unmap_single(sdcp->dev, op->src_phys, op->len,
-				DMA_TO_DEVICE);
-
-		nbytes -= op->len;
-		ret =  blkcipher_walk_done(desc, &walk, nbytes);
-
-		blockno++;
-	}
-
-	return err;
-}
-
 static struct crypto_alg dcp_aes_cbc_alg = {
 	.cra_name		= "cbc(aes)",
 	.cra_driver_name	= "dcp-cbc-aes",
 	.cra_priority		= 400,
-	.cra_alignmask		= 15,
-	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER |
+	.cra_alignmask		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
+				  CRYPTO_ALG_ASYNC |
 				  CRYPTO_ALG_NEED_FALLBACK,
-	.cra_init		= fallback_init_blk,
-	.cra_exit		= fallback_exit_blk,
-	.cra_blocksize		= AES_KEYSIZE_128,
-	.cra_ctxsize		= sizeof(struct dcp_op),
-	.cra_type		= &crypto_blkcipher_type,
+	.cra_init		= dcp_aes_cra_init,
+	.cra_exit		= dcp_aes_cra_exit,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct dcp_aes_ctx),
+	.cra_type		= &crypto_ablkcipher_type,
 	.cra_module		= THIS_MODULE,
 	.cra_list		= LIST_HEAD_INIT(dcp_aes_cbc_alg.cra_list),
 	.cra_u			= {
-		.blkcipher 	= {
+		.ablkcipher	= {
 			.min_keysize	= AES_MIN_KEY_SIZE,
 			.max_keysize	= AES_MAX_KEY_SIZE,
-			.setkey		= dcp_aes_setkey_blk,
+			.setkey		= dcp_aes_setkey,
 			.encrypt	= dcp_aes_cbc_encrypt,
 			.decrypt	= dcp_aes_cbc_decrypt,
-			.ivsize		= AES_KEYSIZE_128,
+			.ivsize		= AES_BLOCK_SIZE,
 		}
 	}
 };
@@ -1248,6 +1316,10 @@ static int dcp_sha_final(struct shash_desc *desc, u8 *out)
 	return ret;
 }
 
+/*
+ * These keep the hash channel from init to final; NEED_FALLBACK keeps
+ * them from being picked as the software fallback of the ahashes below.
+ */
 static struct shash_alg dcp_sha1_alg = {
 	.init			=	dcp_sha_init,
 	.update			=	dcp_sha_update,
@@ -1258,6 +1330,7 @@ static struct shash_alg dcp_sha1_alg = {
 		.cra_name		=	"sha1",
 		.cra_driver_name	=	"sha1-dcp",
 		.cra_priority		=	300,
+		.cra_flags		=	CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize		=	SHA1_BLOCK_SIZE,
 		.cra_ctxsize		=
 			sizeof(struct dcp_hash_op),
@@ -1275,6 +1348,7 @@ static struct shash_alg dcp_sha256_alg = {
 		.cra_name		=	"sha256",
 		.cra_driver_name	=	"sha256-dcp",
 		.cra_priority		=	300,
+		.cra_flags		=	CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize		=	SHA256_BLOCK_SIZE,
 		.cra_ctxsize		=
 			sizeof(struct dcp_hash_op),
@@ -1282,6 +1356,392 @@ static struct shash_alg dcp_sha256_alg = {
 	}
 };
 
+/*
+ * Asynchronous sha1 and sha256
+ *
+ * The hash channel only keeps the intermediate state of a hash while it
+ * runs one uninterrupted chain, so only requests that hash all of their
+ * data in one go (digest, or finup straight after init) can go to the
+ * hardware.  Those are queued and run in batches like the AES requests:
+ * every segment becomes one packet, the first packet of each request
+ * restarts the hash and the last one terminates it into that request's
+ * digest slot, and the whole batch completes with one interrupt.
+ *
+ * Incremental init/update/final, empty messages and scatterlists whose
+ * segments (but the last) are not a multiple of the 64 byte hash block
+ * use a software shash.
+ */
+struct dcp_sha_ctx {
+	u32 hash_sel;
+	struct crypto_shash *fallback;
+};
+
+struct dcp_sha_reqctx {
+	unsigned int slot;
+	bool sw;			/* data already went to the fallback */
+	struct shash_desc fallback;	/* must be last */
+};
+
+static void dcp_sha_fallback_init(struct ahash_request *req)
+{
+	struct dcp_sha_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->fallback.tfm = ctx->fallback;
+	rctx->fallback.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+}
+
+static int dcp_ahash_init(struct ahash_request *req)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->sw = false;
+	dcp_sha_fallback_init(req);
+	return crypto_shash_init(&rctx->fallback);
+}
+
+static int dcp_ahash_update(struct ahash_request *req)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	if (!req->nbytes)
+		return 0;
+
+	rctx->sw = true;
+	return shash_ahash_update(req, &rctx->fallback);
+}
+
+static int dcp_ahash_final(struct ahash_request *req)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	return crypto_shash_final(&rctx->fallback, req->result);
+}
+
+static int dcp_ahash_export(struct ahash_request *req, void *out)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	return crypto_shash_export(&rctx->fallback, out);
+}
+
+static int dcp_ahash_import(struct ahash_request *req, const void *in)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->sw = true;
+	dcp_sha_fallback_init(req);
+	return crypto_shash_import(&rctx->fallback, in);
+}
+
+/*
+ * Turn the segments of @req into packets starting at packet @first, with
+ * the digest going to @slot.  Returns the number of packets, 0 if the
+ * request cannot be done by the DCP directly or -ENOSPC if it does not
+ * fit into what is left of the batch.
+ */
+static int dcp_sha_map_req(struct dcp *sdcp, struct ahash_request *req,
+		unsigned int first, unsigned int slot)
+{
+	struct dcp_sha_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+	struct dcp_sha_batch *b = sdcp->sha_batch;
+	struct scatterlist *sg = req->src;
+	unsigned int remain = req->nbytes;
+	unsigned int n = 0, len;
+
+	/* Check the layout before mapping anything */
+	while (remain) {
+		if (!sg)
+			return 0;
+		len = min(sg->length, remain);
+		remain -= len;
+		if (remain && (len % SHA1_BLOCK_SIZE))
+			return 0;
+		n++;
+		sg = scatterwalk_sg_next(sg);
+	}
+
+	if (n > DCP_SHA_MAX_PKTS)
+		return 0;
+	if (first + n > DCP_SHA_MAX_PKTS)
+		return -ENOSPC;
+
+	dma_map_sg(sdcp->dev, req->src, n, DMA_TO_DEVICE);
+
+	sg = req->src;
+	remain = req->nbytes;
+	for (n = first; remain; n++) {
+		struct dcp_hw_packet *pkt = &b->pkt[n];
+
+		len = min(sg_dma_len(sg), remain);
+
+		pkt->pNext = sdcp->sha_batch_phys +
+			offsetof(struct dcp_sha_batch, pkt[n + 1]);
+		pkt->pkt1 = BM_DCP_PACKET1_ENABLE_HASH | BM_DCP_PACKET1_CHAIN;
+		if (n == first)
+			pkt->pkt1 |= BM_DCP_PACKET1_HASH_INIT;
+		pkt->pkt2 = BF(ctx->hash_sel, DCP_PACKET2_HASH_SELECT);
+		pkt->pSrc = sg_dma_address(sg);
+		pkt->pDst = 0;
+		pkt->size = len;
+		pkt->pPayload = 0;
+		pkt->stat = 0;
+
+		remain -= len;
+		sg = scatterwalk_sg_next(sg);
+	}
+
+	/* Last packet of the request delivers its digest */
+	b->pkt[n - 1].pkt1 |= BM_DCP_PACKET1_HASH_TERM;
+	b->pkt[n - 1].pPayload = sdcp->sha_batch_phys +
+		offsetof(struct dcp_sha_batch, digest[slot]);
+
+	rctx->slot = slot;
+	return n - first;
+}
+
+static void dcp_sha_complete(struct dcp *sdcp, struct ahash_request *req,
+		int err)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+	unsigned int i, len = crypto_ahash_digestsize(crypto_ahash_reqtfm(req));
+	const u8 *digest = sdcp->sha_batch->digest[rctx->slot] + len;
+
+	dma_unmap_sg(sdcp->dev, req->src,
+		dcp_sg_count(req->src, req->nbytes), DMA_TO_DEVICE);
+
+	/* hardware reverses the digest */
+	if (!err)
+		for (i = 0; i < len; i++)
+			req->result[i] = *--digest;
+
+	local_bh_disable();
+	req->base.complete(&req->base, err);
+	local_bh_enable();
+}
+
+/* Run the chain built in the batch area, @nr_pkts packets long */
+static int dcp_sha_run_batch(struct dcp *sdcp, unsigned int nr_pkts)
+{
+	struct dcp_hw_packet *last = &sdcp->sha_batch->pkt[nr_pkts - 1];
+	const int chan = HASH_CHAN;
+	int err = 0;
+	u32 stat;
+
+	last->pNext = 0;
+	last->pkt1 &= ~BM_DCP_PACKET1_CHAIN;
+	last->pkt1 |= BM_DCP_PACKET1_DECR_SEMAPHORE | BM_DCP_PACKET1_INTERRUPT;
+	wmb();
+
+	mutex_lock(&sdcp->op_mutex[chan]);
+	dcp_clock(sdcp, CLOCK_ON, false);
+	sdcp->chan_in_use[chan] = true;
+
+	__raw_writel(-1, sdcp->dcp_regs_base + HW_DCP_CHnSTAT_CLR(chan));
+	__raw_writel((u32)sdcp->sha_batch_phys, sdcp->dcp_regs_base +
+		HW_DCP_CHnCMDPTR(chan));
+
+	INIT_COMPLETION(sdcp->op_wait[chan]);
+	sdcp->wait[chan] = 0;
+	__raw_writel(BF(1, DCP_CHnSEMA_INCREMENT), sdcp->dcp_regs_base
+		+ HW_DCP_CHnSEMA(chan));
+
+	if (!wait_for_completion_timeout(&sdcp->op_wait[chan],
+			msecs_to_jiffies(1000))) {
+		dev_err(sdcp->dev, "Timeout while waiting STAT 0x%08x\n",
+				__raw_readl(sdcp->dcp_regs_base + HW_DCP_STAT));
+		err = -ETIMEDOUT;
+		goto out;
+	}
+
+	stat = __raw_readl(sdcp->dcp_regs_base + HW_DCP_CHnSTAT(chan));
+	if ((stat & 0xff) != 0) {
+		dev_err(sdcp->dev, "Channel stat error 0x%02x\n", stat & 0xff);
+		err = -EIO;
+	}
+out:
+	sdcp->chan_in_use[chan] = false;
+	dcp_clock(sdcp, CLOCK_OFF, false);
+	mutex_unlock(&sdcp->op_mutex[chan]);
+	return err;
+}
+
+static struct crypto_async_request *dcp_sha_dequeue(struct dcp *sdcp)
+{
+	struct crypto_async_request *async_req, *backlog;
+
+	spin_lock_irq(&sdcp->lock);
+	backlog = crypto_get_backlog(&sdcp->sha_queue);
+	async_req = crypto_dequeue_request(&sdcp->sha_queue);
+	spin_unlock_irq(&sdcp->lock);
+
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+	return async_req;
+}
+
+static void dcp_sha_work(struct work_struct *work)
+{
+	struct dcp *sdcp = container_of(work, struct dcp, sha_work);
+	struct ahash_request *batch[DCP_SHA_MAX_BATCH];
+	struct ahash_request *req = NULL;
+	struct crypto_async_request *async_req;
+	unsigned int nr, nr_pkts, i;
+	int ret;
+
+	do {
+		nr = nr_pkts = 0;
+		while (nr < DCP_SHA_MAX_BATCH) {
+			if (!req) {
+				async_req = dcp_sha_dequeue(sdcp);
+				if (!async_req)
+					break;
+				req = ahash_request_cast(async_req);
+			}
+
+			ret = dcp_sha_map_req(sdcp, req, nr_pkts, nr);
+			if (ret == -ENOSPC)
+				break;	/* carried over to the next batch */
+			if (ret == 0) {
+				struct dcp_sha_reqctx *rctx =
+					ahash_request_ctx(req);
+
+				dcp_sha_fallback_init(req);
+				ret = shash_ahash_digest(req, &rctx->fallback);
+				local_bh_disable();
+				req->base.complete(&req->base, ret);
+				local_bh_enable();
+			} else {
+				batch[nr++] = req;
+				nr_pkts += ret;
+			}
+			req = NULL;
+		}
+
+		if (!nr)
+			continue;
+
+		ret = dcp_sha_run_batch(sdcp, nr_pkts);
+		for (i = 0; i < nr; i++)
+			dcp_sha_complete(sdcp, batch[i], ret);
+	} while (nr || req);
+}
+
+static int dcp_ahash_digest(struct ahash_request *req)
+{
+	struct dcp *sdcp = global_sdcp;
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+	unsigned long irqflags;
+	int ret;
+
+	if (!req->nbytes) {
+		dcp_sha_fallback_init(req);
+		return shash_ahash_digest(req, &rctx->fallback);
+	}
+
+	spin_lock_irqsave(&sdcp->lock, irqflags);
+	ret = ahash_enqueue_request(&sdcp->sha_queue, req);
+	spin_unlock_irqrestore(&sdcp->lock, irqflags);
+
+	queue_work(sdcp->sha_wq, &sdcp->sha_work);
+	return ret;
+}
+
+static int dcp_ahash_finup(struct ahash_request *req)
+{
+	struct dcp_sha_reqctx *rctx = ahash_request_ctx(req);
+
+	if (!rctx->sw)
+		return dcp_ahash_digest(req);
+	return shash_ahash_finup(req, &rctx->fallback);
+}
+
+static int dcp_ahash_cra_init(struct crypto_tfm *tfm)
+{
+	const char *name = tfm->__crt_alg->cra_name;
+	struct dcp_sha_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	/* Not the sha*-dcp shashes, they hold the channel from init to final */
+	ctx->fallback = crypto_alloc_shash(name, 0, CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		printk(KERN_ERR "Error allocating fallback algo %s\n", name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	if (strcmp(name, "sha1") == 0)
+		ctx->hash_sel = BV_DCP_PACKET2_HASH_SELECT__SHA1;
+	else
+		ctx->hash_sel = BV_DCP_PACKET2_HASH_SELECT__SHA256;
+
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+		sizeof(struct dcp_sha_reqctx) +
+		crypto_shash_descsize(ctx->fallback));
+	return 0;
+}
+
+static void dcp_ahash_cra_exit(struct crypto_tfm *tfm)
+{
+	struct dcp_sha_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(ctx->fallback);
+	ctx->fallback = NULL;
+}
+
+static struct ahash_alg dcp_sha1_ahash_alg = {
+	.init			=	dcp_ahash_init,
+	.update			=	dcp_ahash_update,
+	.final			=	dcp_ahash_final,
+	.finup			=	dcp_ahash_finup,
+	.digest			=	dcp_ahash_digest,
+	.export			=	dcp_ahash_export,
+	.import			=	dcp_ahash_import,
+	.halg			=	{
+		.digestsize		=	SHA1_DIGEST_SIZE,
+		.statesize		=	sizeof(struct sha1_state),
+		.base			=	{
+			.cra_name		=	"sha1",
+			.cra_driver_name	=	"sha1-dcp-async",
+			.cra_priority		=	400,
+			.cra_flags		=	CRYPTO_ALG_TYPE_AHASH |
+							CRYPTO_ALG_ASYNC |
+							CRYPTO_ALG_NEED_FALLBACK,
+			.cra_blocksize		=	SHA1_BLOCK_SIZE,
+			.cra_ctxsize		=	sizeof(struct dcp_sha_ctx),
+			.cra_init		=	dcp_ahash_cra_init,
+			.cra_exit		=	dcp_ahash_cra_exit,
+			.cra_module		=	THIS_MODULE,
+		}
+	}
+};
+
+static struct ahash_alg dcp_sha256_ahash_alg = {
+	.init			=	dcp_ahash_init,
+	.update			=	dcp_ahash_update,
+	.final			=	dcp_ahash_final,
+	.finup			=	dcp_ahash_finup,
+	.digest			=	dcp_ahash_digest,
+	.export			=	dcp_ahash_export,
+	.import			=	dcp_ahash_import,
+	.halg			=	{
+		.digestsize		=	SHA256_DIGEST_SIZE,
+		.statesize		=	sizeof(struct sha256_state),
+		.base			=	{
+			.cra_name		=	"sha256",
+			.cra_driver_name	=	"sha256-dcp-async",
+			.cra_priority		=	400,
+			.cra_flags		=	CRYPTO_ALG_TYPE_AHASH |
+							CRYPTO_ALG_ASYNC |
+							CRYPTO_ALG_NEED_FALLBACK,
+			.cra_blocksize		=	SHA256_BLOCK_SIZE,
+			.cra_ctxsize		=	sizeof(struct dcp_sha_ctx),
+			.cra_init		=	dcp_ahash_cra_init,
+			.cra_exit		=	dcp_ahash_cra_exit,
+			.cra_module		=	THIS_MODULE,
+		}
+	}
+};
+
 static irqreturn_t dcp_common_irq(int irq, void *context)
 {
 	struct dcp *sdcp = context;
@@ -1295,14 +1755,22 @@ static irqreturn_t dcp_common_irq(int irq, void *context)
 
 	/* clear this channel */
 	__raw_writel(msk, sdcp->dcp_regs_base + HW_DCP_STAT_CLR);
-	if (msk & BF(0x01, DCP_STAT_IRQ))
+	if (msk & BF(0x01, DCP_STAT_IRQ)) {
 		sdcp->wait[0]++;
-	if (msk & BF(0x02, DCP_STAT_IRQ))
+		complete(&sdcp->op_wait[0]);
+	}
+	if (msk & BF(0x02, DCP_STAT_IRQ)) {
 		sdcp->wait[1]++;
-	if (msk & BF(0x04, DCP_STAT_IRQ))
+		complete(&sdcp->op_wait[1]);
+	}
+	if (msk & BF(0x04, DCP_STAT_IRQ)) {
 		sdcp->wait[2]++;
-	if (msk & BF(0x08, DCP_STAT_IRQ))
+		complete(&sdcp->op_wait[2]);
+	}
+	if (msk & BF(0x08, DCP_STAT_IRQ)) {
 		sdcp->wait[3]++;
+		complete(&sdcp->op_wait[3]);
+	}
 	return IRQ_HANDLED;
 }
 
@@ -1518,12 +1986,42 @@ static int dcp_probe(struct platform_device *pdev)
 		goto err_free_irq0;
 	}
 
+	crypto_init_queue(&sdcp->aes_queue, 50);
+	INIT_WORK(&sdcp->aes_work, dcp_aes_work);
+	sdcp->aes_wq = create_singlethread_workqueue("dcp_aes");
+	if (!sdcp->aes_wq) {
+		ret = -ENOMEM;
+		goto err_free_irq1;
+	}
+	sdcp->aes_batch = dma_alloc_coherent(sdcp->dev,
+		sizeof(*sdcp->aes_batch), &sdcp->aes_batch_phys, GFP_KERNEL);
+	if (!sdcp->aes_batch) {
+		dev_err(&pdev->dev, "Unable to allocate aes packets\n");
+		ret = -ENOMEM;
+		goto err_destroy_wq;
+	}
+
+	crypto_init_queue(&sdcp->sha_queue, 50);
+	INIT_WORK(&sdcp->sha_work, dcp_sha_work);
+	sdcp->sha_wq = create_singlethread_workqueue("dcp_sha");
+	if (!sdcp->sha_wq) {
+		ret = -ENOMEM;
+		goto err_free_aes_batch;
+	}
+	sdcp->sha_batch = dma_alloc_coherent(sdcp->dev,
+		sizeof(*sdcp->sha_batch), &sdcp->sha_batch_phys, GFP_KERNEL);
+	if (!sdcp->sha_batch) {
+		dev_err(&pdev->dev, "Unable to allocate sha packets\n");
+		ret = -ENOMEM;
+		goto err_destroy_sha_wq;
+	}
+
 	global_sdcp = sdcp;
 
 	ret = crypto_register_alg(&dcp_aes_alg);
 	if (ret != 0)  {
 		dev_err(&pdev->dev, "Failed to register aes crypto\n");
-		goto err_free_irq1;
+		goto err_free_batch;
 	}
 
 	ret = crypto_register_alg(&dcp_aes_ecb_alg);
@@ -1616,12 +2114,29 @@ static int dcp_probe(struct platform_device *pdev)
 		}
 	}
 
+	ret = crypto_register_ahash(&dcp_sha1_ahash_alg);
+	if (ret != 0)  {
+		dev_err(&pdev->dev, "Failed to register sha1 ahash\n");
+		goto err_unregister_sha1;
+	}
+
+	if (__raw_readl(sdcp->dcp_regs_base + HW_DCP_CAPABILITY1) &
+		BF_DCP_CAPABILITY1_HASH_ALGORITHMS(
+		BV_DCP_CAPABILITY1_HASH_ALGORITHMS__SHA256)) {
+
+		ret = crypto_register_ahash(&dcp_sha256_ahash_alg);
+		if (ret != 0)  {
+			dev_err(&pdev->dev, "Failed to register sha256 ahash\n");
+			goto err_unregister_sha1_ahash;
+		}
+	}
+
 	/* register dcpboot interface to allow apps (such as kobs-ng) to
 	 * verify files (such as the bootstream) using the OTP key for crypto */
 	ret = misc_register(&dcp_bootstream_misc);
 	if (ret != 0) {
 		dev_err(&pdev->dev, "Unable to register misc device\n");
-		goto err_unregister_sha1;
+		goto err_unregister_ahash;
 	}
 
 	sdcp->dcpboot_dma_area = dma_alloc_coherent(&pdev->dev,
@@ -1640,6 +2155,13 @@ static int dcp_probe(struct platform_device *pdev)
 
 err_dereg:
 	misc_deregister(&dcp_bootstream_misc);
+err_unregister_ahash:
+	if (__raw_readl(sdcp->dcp_regs_base + HW_DCP_CAPABILITY1) &
+		BF_DCP_CAPABILITY1_HASH_ALGORITHMS(
+		BV_DCP_CAPABILITY1_HASH_ALGORITHMS__SHA256))
+		crypto_unregister_ahash(&dcp_sha256_ahash_alg);
+err_unregister_sha1_ahash:
+	crypto_unregister_ahash(&dcp_sha1_ahash_alg);
 err_unregister_sha1:
 	crypto_unregister_shash(&dcp_sha1_alg);
 err_unregister_aes_cbc:
@@ -1648,6 +2170,17 @@ err_unregister_aes_ecb:
 	crypto_unregister_alg(&dcp_aes_ecb_alg);
 err_unregister_aes:
 	crypto_unregister_alg(&dcp_aes_alg);
+err_free_batch:
+	global_sdcp = NULL;
+	dma_free_coherent(sdcp->dev, sizeof(*sdcp->sha_batch),
+		sdcp->sha_batch, sdcp->sha_batch_phys);
+err_destroy_sha_wq:
+	destroy_workqueue(sdcp->sha_wq);
+err_free_aes_batch:
+	dma_free_coherent(sdcp->dev, sizeof(*sdcp->aes_batch),
+		sdcp->aes_batch, sdcp->aes_batch_phys);
+err_destroy_wq:
+	destroy_workqueue(sdcp->aes_wq);
 err_free_irq1:
 	free_irq(sdcp->dcp_irq, sdcp);
 err_free_irq0:
@@ -1698,17 +2231,27 @@ static int dcp_remove(struct platform_device *pdev)
 	}
 
 
+	crypto_unregister_ahash(&dcp_sha1_ahash_alg);
 	crypto_unregister_shash(&dcp_sha1_alg);
 
 	if (__raw_readl(sdcp->dcp_regs_base + HW_DCP_CAPABILITY1) &
 		BF_DCP_CAPABILITY1_HASH_ALGORITHMS(
-		BV_DCP_CAPABILITY1_HASH_ALGORITHMS__SHA256))
+		BV_DCP_CAPABILITY1_HASH_ALGORITHMS__SHA256)) {
+		crypto_unregister_ahash(&dcp_sha256_ahash_alg);
 		crypto_unregister_shash(&dcp_sha256_alg);
+	}
 
 	crypto_unregister_alg(&dcp_aes_cbc_alg);
 	crypto_unregister_alg(&dcp_aes_ecb_alg);
 	crypto_unregister_alg(&dcp_aes_alg);
 
+	destroy_workqueue(sdcp->aes_wq);
+	dma_free_coherent(sdcp->dev, sizeof(*sdcp->aes_batch),
+		sdcp->aes_batch, sdcp->aes_batch_phys);
+	destroy_workqueue(sdcp->sha_wq);
+	dma_free_coherent(sdcp->dev, sizeof(*sdcp->sha_batch),
+		sdcp->sha_batch, sdcp->sha_batch_phys);
+
 	dcp_clock(sdcp, CLOCK_OFF, true);
 	iounmap((void *) sdcp->dcp_regs_base);
 	kfree(sdcp);
@@ -0,0 +1,367 @@
+/*
+ * i.MX SDMA memory to memory copy channel for the dmaengine
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The SDMA controller is driven through the mxc_dma_*() API for the
+ * peripheral transfers; this exposes one of its channels, set up with the
+ * emi_2_emi script, as a DMA_MEMCPY capable dmaengine channel so that
+ * drivers can move large buffers without spending the CPU on it.
+ *
+ * Descriptors are executed one at a time in submission order. A single
+ * SDMA buffer descriptor moves less than 64KiB, so a copy is issued as
+ * runs of up to SDMA_MEMCPY_BDS buffer descriptors, the next run being
+ * started from the completion callback of the previous one.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/dmaengine.h>
+#include <linux/platform_device.h>
+
+#include <mach/dma.h>
+
+#define SDMA_MEMCPY_BD_BYTES	(60 * 1024)	/* Per buffer descriptor */
+#define SDMA_MEMCPY_BDS		16		/* Per hardware run */
+
+struct sdma_memcpy_desc {
+	struct dma_async_tx_descriptor txd;
+	struct list_head node;
+	dma_addr_t dst;
+	dma_addr_t src;
+	size_t len;
+	size_t done;		/* Bytes of completed runs */
+	size_t run;		/* Bytes of the run in flight */
+};
+
+struct sdma_memcpy_chan {
+	struct dma_chan chan;
+	int channel;		/* mxc_dma channel number, or -1 */
+	spinlock_t lock;
+	struct list_head queue;	/* Submitted, in order; head is active */
+	bool busy;		/* A run of the queue head is in flight */
+	dma_cookie_t completed_cookie;
+	dma_cookie_t error_cookie;
+	mxc_dma_requestbuf_t bufs[SDMA_MEMCPY_BDS];
+};
+
+struct sdma_memcpy_device {
+	struct dma_device dma;
+	struct sdma_memcpy_chan chan;
+	struct platform_device *pdev;
+};
+
+static struct sdma_memcpy_device *sdma_memcpy;
+
+static inline struct sdma_memcpy_chan *to_sdma_chan(struct dma_chan *chan)
+{
+	return container_of(chan, struct sdma_memcpy_chan, chan);
+}
+
+static inline struct sdma_memcpy_desc *
+to_sdma_desc(struct dma_async_tx_descriptor *txd)
+{
+	return container_of(txd, struct sdma_memcpy_desc, txd);
+}
+
+/* Programs the next run of the queue head. Called with sc->lock held. */
+static int sdma_memcpy_start(struct sdma_memcpy_chan *sc)
+{
+	struct sdma_memcpy_desc *desc;
+	size_t offs, chunk;
+	int n, ret;
+
+	if (sc->busy || list_empty(&sc->queue))
+		return 0;
+
+	desc = list_first_entry(&sc->queue, struct sdma_memcpy_desc, node);
+	offs = desc->done;
+	for (n = 0; n < SDMA_MEMCPY_BDS && offs < desc->len; n++) {
+		chunk = min_t(size_t, desc->len - offs, SDMA_MEMCPY_BD_BYTES);
+		sc->bufs[n].src_addr = desc->src + offs;
+		sc->bufs[n].dst_addr = desc->dst + offs;
+		sc->bufs[n].num_of_bytes = chunk;
+		offs += chunk;
+	}
+	desc->run = offs - desc->done;
+
+	ret = mxc_dma_config(sc->channel, sc->bufs, n, MXC_DMA_MODE_READ);
+	if (ret)
+		return ret;
+	sc->busy = true;
+	mxc_dma_enable(sc->channel);
+	return 0;
+}
+
+/*
+ * Moves the queue head to "done" and starts the next descriptor; any that
+ * cannot even be programmed is failed onto "done" as well. Called with
+ * sc->lock held.
+ */
+static void sdma_memcpy_retire(struct sdma_memcpy_chan *sc, bool error,
+			       struct list_head *done)
+{
+	struct sdma_memcpy_desc *desc;
+
+	do {
+		desc = list_first_entry(&sc->queue, struct sdma_memcpy_desc,
+					node);
+		list_move_tail(&desc->node, done);
+		sc->busy = false;
+		sc->completed_cookie = desc->txd.cookie;
+		if (error) {
+			sc->error_cookie = desc->txd.cookie;
+			dev_err(sc->chan.device->dev, "copy %d failed\n",
+				desc->txd.cookie);
+		}
+		error = true;
+	} while (!list_empty(&sc->queue) && sdma_memcpy_start(sc));
+}
+
+/* Runs the callbacks of, and frees, the retired descriptors */
+static void sdma_memcpy_complete(struct list_head *done)
+{
+	struct sdma_memcpy_desc *desc, *tmp;
+	dma_async_tx_callback callback;
+	void *param;
+
+	list_for_each_entry_safe(desc, tmp, done, node) {
+		callback = desc->txd.callback;
+		param = desc->txd.callback_param;
+		kfree(desc);
+		if (callback)
+			callback(param);
+	}
+}
+
+/* mxc_dma completion callback, runs from the SDMA channel tasklet */
+static void sdma_memcpy_callback(void *arg, int error, unsigned int count)
+{
+	struct sdma_memcpy_chan *sc = arg;
+	struct sdma_memcpy_desc *desc;
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	spin_lock_irqsave(&sc->lock, flags);
+	if (!sc->busy || list_empty(&sc->queue)) {
+		spin_unlock_irqrestore(&sc->lock, flags);
+		return;
+	}
+
+	desc = list_first_entry(&sc->queue, struct sdma_memcpy_desc, node);
+	desc->done += desc->run;
+	sc->busy = false;
+	if (error != MXC_DMA_DONE || desc->done >= desc->len ||
+	    sdma_memcpy_start(sc))
+		sdma_memcpy_retire(sc, error != MXC_DMA_DONE ||
+				   desc->done < desc->len, &done);
+	spin_unlock_irqrestore(&sc->lock, flags);
+
+	sdma_memcpy_complete(&done);
+}
+
+static dma_cookie_t sdma_memcpy_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+	struct sdma_memcpy_desc *desc = to_sdma_desc(txd);
+	struct sdma_memcpy_chan *sc = to_sdma_chan(txd->chan);
+	dma_cookie_t cookie;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sc->lock, flags);
+	cookie = sc->chan.cookie + 1;
+	if (cookie < 0)
+		cookie = 1;
+	sc->chan.cookie = cookie;
+	txd->cookie = cookie;
+	list_add_tail(&desc->node, &sc->queue);
+	spin_unlock_irqrestore(&sc->lock, flags);
+
+	return cookie;
+}
+
+static struct dma_async_tx_descriptor *
+sdma_memcpy_prep(struct dma_chan *chan, dma_addr_t dst, dma_addr_t src,
+		 size_t len, unsigned long flags)
+{
+	struct sdma_memcpy_desc *desc;
+
+	if (!len || !is_dma_copy_aligned(chan->device, src, dst, len))
+		return NULL;
+
+	desc = kzalloc(sizeof(*desc), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->txd, chan);
+	desc->txd.tx_submit = sdma_memcpy_tx_submit;
+	desc->txd.flags = flags;
+	desc->dst = dst;
+	desc->src = src;
+	desc->len = len;
+	INIT_LIST_HEAD(&desc->node);
+
+	return &desc->txd;
+}
+
+static void sdma_memcpy_issue_pending(struct dma_chan *chan)
+{
+	struct sdma_memcpy_chan *sc = to_sdma_chan(chan);
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	spin_lock_irqsave(&sc->lock, flags);
+	if (!sc->busy && !list_empty(&sc->queue) && sdma_memcpy_start(sc))
+		sdma_memcpy_retire(sc, true, &done);
+	spin_unlock_irqrestore(&sc->lock, flags);
+
+	sdma_memcpy_complete(&done);
+}
+
+static enum dma_status sdma_memcpy_tx_status(struct dma_chan *chan,
+					     dma_cookie_t cookie,
+					     struct dma_tx_state *txstate)
+{
+	struct sdma_memcpy_chan *sc = to_sdma_chan(chan);
+	dma_cookie_t last_used, last_complete;
+
+	last_used = chan->cookie;
+	last_complete = sc->completed_cookie;
+	dma_set_tx_state(txstate, last_complete, last_used, 0);
+
+	if (cookie == sc->error_cookie)
+		return DMA_ERROR;
+	return dma_async_is_complete(cookie, last_complete, last_used);
+}
+
+static int sdma_memcpy_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+			       unsigned long arg)
+{
+	struct sdma_memcpy_chan *sc = to_sdma_chan(chan);
+	struct sdma_memcpy_desc *desc, *tmp;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	if (cmd != DMA_TERMINATE_ALL)
+		return -ENXIO;
+
+	spin_lock_irqsave(&sc->lock, flags);
+	if (sc->busy)
+		mxc_dma_disable(sc->channel);
+	sc->busy = false;
+	list_splice_init(&sc->queue, &list);
+	sc->completed_cookie = chan->cookie;
+	spin_unlock_irqrestore(&sc->lock, flags);
+
+	list_for_each_entry_safe(desc, tmp, &list, node)
+		kfree(desc);
+
+	return 0;
+}
+
+static int sdma_memcpy_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct sdma_memcpy_chan *sc = to_sdma_chan(chan);
+	int channel, ret;
+
+	channel = mxc_dma_request(MXC_DMA_MEMORY, "sdma_memcpy");
+	if (channel < 0)
+		return channel;
+
+	ret = mxc_dma_callback_set(channel, sdma_memcpy_callback, sc);
+	if (ret) {
+		mxc_dma_free(channel);
+		return ret;
+	}
+
+	sc->channel = channel;
+	sc->completed_cookie = chan->cookie = 1;
+	sc->error_cookie = 0;
+	return 1;
+}
+
+static void sdma_memcpy_free_chan_resources(struct dma_chan *chan)
+{
+	struct sdma_memcpy_chan *sc = to_sdma_chan(chan);
+
+	sdma_memcpy_control(chan, DMA_TERMINATE_ALL, 0);
+	mxc_dma_free(sc->channel);
+	sc->channel = -1;
+}
+
+static int __init sdma_memcpy_init(void)
+{
+	struct sdma_memcpy_device *sd;
+	struct dma_device *dma;
+	int ret;
+
+	sd = kzalloc(sizeof(*sd), GFP_KERNEL);
+	if (!sd)
+		return -ENOMEM;
+
+	sd->pdev = platform_device_register_simple("mxc_sdma_memcpy", -1,
+						   NULL, 0);
+	if (IS_ERR(sd->pdev)) {
+		ret = PTR_ERR(sd->pdev);
+		goto err_free;
+	}
+
+	dma = &sd->dma;
+	INIT_LIST_HEAD(&dma->channels);
+	dma_cap_set(DMA_MEMCPY, dma->cap_mask);
+	dma_cap_set(DMA_PRIVATE, dma->cap_mask);
+	dma->dev = &sd->pdev->dev;
+	dma->copy_align = 2;	/* The emi_2_emi script moves 32-bit words */
+	dma->device_alloc_chan_resources = sdma_memcpy_alloc_chan_resources;
+	dma->device_free_chan_resources = sdma_memcpy_free_chan_resources;
+	dma->device_prep_dma_memcpy = sdma_memcpy_prep;
+	dma->device_control = sdma_memcpy_control;
+	dma->device_tx_status = sdma_memcpy_tx_status;
+	dma->device_issue_pending = sdma_memcpy_issue_pending;
+
+	sd->chan.channel = -1;
+	spin_lock_init(&sd->chan.lock);
+	INIT_LIST_HEAD(&sd->chan.queue);
+	sd->chan.chan.device = dma;
+	list_add_tail(&sd->chan.chan.device_node, &dma->channels);
+
+	ret = dma_async_device_register(dma);
+	if (ret)
+		goto err_unregister;
+
+	sdma_memcpy = sd;
+	dev_info(dma->dev, "SDMA memcpy channel registered\n");
+	return 0;
+
+err_unregister:
+	platform_device_unregister(sd->pdev);
+err_free:
+	kfree(sd);
+	return ret;
+}
+
+static void __exit sdma_memcpy_exit(void)
+{
+	dma_async_device_unregister(&sdma_memcpy->dma);
+	platform_device_unregister(sdma_memcpy->pdev);
+	kfree(sdma_memcpy);
+}
+
+/* After the mxc_dma layer (arch_initcall), before the framebuffers */
+subsys_initcall(sdma_memcpy_init);
+module_exit(sdma_memcpy_exit);
+
+MODULE_DESCRIPTION("i.MX SDMA memcpy dmaengine channel");
+MODULE_LICENSE("GPL");
@@ -46,6 +46,13 @@
 
 static LIST_HEAD(head);
 static int timeout_in_ms = 600;
+/*
+ * Queued mode: issue_pending() only queues the channel and the IRQ
+ * handler starts the next queued task as soon as the current one is
+ * done, instead of each submitter waiting for the PxP to go idle and
+ * programming it itself.
+ */
+static int queued_mode = 1;
 
 static volatile int giDMA_started=0;
 
@@ -67,6 +74,11 @@ struct pxps {
 	int pxp_ongoing;
 	int lut_state;
 
+	/* queued mode statistics, protected by lock */
+	unsigned long direct_starts;	/* started from issue_pending() */
+	unsigned long chained_starts;	/* started from the IRQ handler */
+	unsigned long max_depth;	/* most channels waiting at once */
+
 	struct device *dev;
 	struct pxp_dma pxp_dma;
 	struct pxp_channel channel[NR_PXP_VIRT_CHANNEL];
@@ -720,6 +732,7 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 	/* so far we presume only one transaction on active_list */
 	/* S0 */
 	desc = pxpdma_first_active(pxp_chan);
+	pxp->pxp_conf_state.layer_nr = desc->len;
 	memcpy(&pxp->pxp_conf_state.s0_param,
 	       &desc->layer_param.s0_param, sizeof(struct pxp_layer_param));
 	memcpy(&pxp->pxp_conf_state.proc_data,
@@ -795,6 +808,38 @@ static void pxpdma_dostart_work(struct pxps *pxp)
 	GALLEN_DBGLOCAL_END();//mdelay(10);
 }
 
+/*
+ * Queued mode: program the PxP with the first channel on the run list.
+ * Called with pxp->lock held and the clock on; the PxP must be idle.
+ */
+static void pxpdma_start_next(struct pxps *pxp)
+{
+	struct pxp_channel *pxp_chan;
+	int spins = 1000;
+
+	if (list_empty(&head)) {
+		pxp->pxp_ongoing = 0;
+		return;
+	}
+
+	/* the ENABLE bit should already be clear once the IRQ is raised */
+	while ((__raw_readl(pxp->base + HW_PXP_CTRL) & BM_PXP_CTRL_ENABLE) &&
+	       --spins)
+		cpu_relax();
+	WARN_ON_ONCE(!spins);
+
+	pxp_chan = list_entry(head.next, struct pxp_channel, list);
+
+	spin_lock(&pxp_chan->lock);
+	__pxpdma_dostart(pxp_chan);
+	spin_unlock(&pxp_chan->lock);
+
+	pxp_config(pxp, pxp_chan);
+	pxp_start(pxp);
+	pxp->pxp_ongoing = 1;
+	giDMA_started = 1;
+}
+
 static void pxpdma_dequeue(struct pxp_channel *pxp_chan, struct list_head *list)
 {
 	struct pxp_tx_desc *desc = NULL;
@@ -973,20 +1018,47 @@ static irqreturn_t pxp_irq(int irq, void *dev_id)
 	/* Send histogram status back to caller */
 	desc->hist_status = hist_status;
 
+	pxp->pxp_ongoing = 0;
+	giDMA_started = 0;
+	if (queued_mode) {
+		/*
+		 * Get the next task going before running the callback, so
+		 * the PxP is not idle while the client handles completion.
+		 */
+		pxpdma_start_next(pxp);
+		if (pxp->pxp_ongoing)
+			pxp->chained_starts++;
+	}
+
 	if ((desc->txd.flags & DMA_PREP_INTERRUPT) && callback) {
 		GALLEN_DBGLOCAL_RUNLOG(1);
 		callback(callback_param);
 	}
 
+	spin_lock(&pxp_chan->lock);
 	pxp_chan->status = PXP_CHANNEL_INITIALIZED;
 
 	list_splice_init(&desc->tx_list, &pxp_chan->free_list);
 	list_move(&desc->list, &pxp_chan->free_list);
 
+	/* issued again while it was running: back on the run list */
+	if (queued_mode && !list_empty(&pxp_chan->queue)) {
+		pxpdma_dequeue(pxp_chan, &pxp_chan->active_list);
+		pxp_chan->status = PXP_CHANNEL_READY;
+		list_add_tail(&pxp_chan->list, &head);
+	}
+	spin_unlock(&pxp_chan->lock);
+
+	if (queued_mode && !pxp->pxp_ongoing) {
+		pxpdma_start_next(pxp);
+		if (pxp->pxp_ongoing)
+			pxp->chained_starts++;
+	}
+
 	wake_up(&pxp->done);
-	pxp->pxp_ongoing = 0;
-	giDMA_started = 0;
-	mod_timer(&pxp->clk_timer, jiffies + msecs_to_jiffies(timeout_in_ms));
+	if (!pxp->pxp_ongoing)
+		mod_timer(&pxp->clk_timer,
+			  jiffies + msecs_to_jiffies(timeout_in_ms));
 
 	spin_unlock_irqrestore(&pxp->lock, flags);
 
@@ -1094,12 +1166,63 @@ static struct dma_async_tx_descriptor *pxp_prep_slave_sg(struct dma_chan *chan,
 	return &first->txd;
 }
 
+static void pxp_issue_pending_queued(struct pxps *pxp,
+				     struct pxp_channel *pxp_chan)
+{
+	struct list_head *pos;
+	unsigned long flags;
+	unsigned long depth = 0;
+
+	/*
+	 * Hold clk_mutex until the channel is on the run list, so the
+	 * clock-off work cannot switch the clock off under us.
+	 */
+	mutex_lock(&pxp->clk_mutex);
+	if (pxp->clk_stat == CLK_STAT_OFF) {
+		clk_enable(pxp->clk);
+		pxp->clk_stat = CLK_STAT_ON;
+	}
+
+	spin_lock_irqsave(&pxp->lock, flags);
+	spin_lock(&pxp_chan->lock);
+
+	/*
+	 * A channel that is still on the run list keeps its new
+	 * descriptors queued; the IRQ handler moves them over once the
+	 * running task is done.
+	 */
+	if (!list_empty(&pxp_chan->queue) && list_empty(&pxp_chan->list)) {
+		pxpdma_dequeue(pxp_chan, &pxp_chan->active_list);
+		pxp_chan->status = PXP_CHANNEL_READY;
+		list_add_tail(&pxp_chan->list, &head);
+	}
+	spin_unlock(&pxp_chan->lock);
+
+	list_for_each(pos, &head)
+		depth++;
+	if (depth > pxp->max_depth)
+		pxp->max_depth = depth;
+
+	if (!pxp->pxp_ongoing && !list_empty(&head)) {
+		pxpdma_start_next(pxp);
+		pxp->direct_starts++;
+	}
+
+	spin_unlock_irqrestore(&pxp->lock, flags);
+	mutex_unlock(&pxp->clk_mutex);
+}
+
 static void pxp_issue_pending(struct dma_chan *chan)
 {
 	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
 	struct pxp_dma *pxp_dma = to_pxp_dma(chan->device);
 	struct pxps *pxp = to_pxp(pxp_dma);
 	unsigned long flags0, flags;
+
+	if (queued_mode) {
+		pxp_issue_pending_queued(pxp, pxp_chan);
+		return;
+	}
 	
 	GALLEN_DBGLOCAL_BEGIN();
 
@@ -1372,6 +1495,7 @@ static int pxp_dma_init(struct pxps *pxp)
 
 		spin_lock_init(&pxp_chan->lock);
 		mutex_init(&pxp_chan->chan_mutex);
+		INIT_LIST_HEAD(&pxp_chan->list);
 
 		/* Only one EOF IRQ for PxP, shared by all channels */
 		pxp_chan->eof_irq = pxp->irq;
@@ -1410,6 +1534,41 @@ static ssize_t clk_off_timeout_store(struct device *dev,
 static DEVICE_ATTR(clk_off_timeout, 0644, clk_off_timeout_show,
 		   clk_off_timeout_store);
 
+static ssize_t queued_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	struct pxps *pxp = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\ndirect: %lu\nchained: %lu\nmax_depth: %lu\n",
+		       queued_mode, pxp->direct_starts, pxp->chained_starts,
+		       pxp->max_depth);
+}
+
+static ssize_t queued_store(struct device *dev,
+			    struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct pxps *pxp = dev_get_drvdata(dev);
+	unsigned long flags;
+	int val;
+
+	if (sscanf(buf, "%d", &val) <= 0)
+		return -EINVAL;
+
+	/* only switch while nothing is queued or running */
+	spin_lock_irqsave(&pxp->lock, flags);
+	if (pxp->pxp_ongoing || !list_empty(&head)) {
+		spin_unlock_irqrestore(&pxp->lock, flags);
+		return -EBUSY;
+	}
+	queued_mode = !!val;
+	spin_unlock_irqrestore(&pxp->lock, flags);
+
+	return count;
+}
+
+static DEVICE_ATTR(queued, 0644, queued_show, queued_store);
+
 static int pxp_probe(struct platform_device *pdev)
 {
 	struct pxps *pxp;
@@ -1473,12 +1632,16 @@ static int pxp_probe(struct platform_device *pdev)
 			"Unable to create file from clk_off_timeout\n");
 		goto err_dma_init;
 	}
+	if (device_create_file(&pdev->dev, &dev_attr_queued))
+		dev_err(&pdev->dev, "Unable to create file from queued\n");
 
 	INIT_WORK(&pxp->work, clkoff_callback);
 	init_waitqueue_head(&pxp->done);
 	init_timer(&pxp->clk_timer);
 	pxp->clk_timer.function = pxp_clkoff_timer;
 	pxp->clk_timer.data = (unsigned long)pxp;
+	/* Turning the clock off a little later costs nothing, let it coalesce */
+	set_timer_slack(&pxp->clk_timer, HZ / 4);
 exit:
 	return err;
 err_dma_init:
@@ -1502,6 +1665,7 @@ static int __devexit pxp_remove(struct platform_device *pdev)
 	clk_put(pxp->clk);
 	iounmap(pxp->base);
 	device_remove_file(&pdev->dev, &dev_attr_clk_off_timeout);
+	device_remove_file(&pdev->dev, &dev_attr_queued);
 
 	kfree(pxp);
 
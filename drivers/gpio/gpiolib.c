@@ -10,6 +10,10 @@
 #include <linux/gpio.h>
 #include <linux/idr.h>
 #include <linux/slab.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/gpiodev.h>
 
 
 /* Optional implementation infrastructure for GPIO interfaces.
@@ -987,6 +991,319 @@ static void gpiochip_unexport(struct gpio_chip *chip)
 				chip->label, status);
 }
 
+#ifdef CONFIG_GPIO_DEV
+
+/*
+ * /dev/gpio, see <linux/gpiodev.h>.  A batch is applied under sysfs_lock,
+ * and with interrupts off when none of its GPIOs can sleep, so neither
+ * sysfs nor another batch can land in the middle of it.
+ */
+
+#define GPIODEV_EVENTS	64	/* per open file, power of two */
+
+struct gpiodev_file;
+
+struct gpiodev_watcher {
+	struct list_head	list;
+	struct gpiodev_file	*file;
+	unsigned		gpio;
+	int			irq;
+};
+
+struct gpiodev_file {
+	struct list_head	watchers;	/* protected by sysfs_lock */
+	spinlock_t		lock;		/* protects head, tail, events */
+	unsigned		head;
+	unsigned		tail;
+	wait_queue_head_t	wait;
+	struct gpiodev_event	events[GPIODEV_EVENTS];
+};
+
+/* Same rules as the sysfs value attribute; called with sysfs_lock held */
+static int gpiodev_check(unsigned gpio, bool write, bool *can_sleep)
+{
+	const struct gpio_desc	*desc;
+
+	if (!gpio_is_valid(gpio))
+		return -EINVAL;
+	desc = &gpio_desc[gpio];
+	if (!test_bit(FLAG_EXPORT, &desc->flags))
+		return -EIO;
+	if (write && !test_bit(FLAG_IS_OUT, &desc->flags))
+		return -EPERM;
+	if (desc->chip->can_sleep)
+		*can_sleep = true;
+	return 0;
+}
+
+static long gpiodev_values(struct gpiodev_batch __user *ubatch, bool write)
+{
+	struct gpiodev_value		v[GPIODEV_MAX_BATCH];
+	struct gpiodev_value __user	*uvalues;
+	struct gpiodev_batch		batch;
+	bool				can_sleep = false;
+	unsigned long			flags = 0;
+	unsigned			i;
+	int				status = 0;
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+	if (batch.count > GPIODEV_MAX_BATCH)
+		return -EINVAL;
+	uvalues = (struct gpiodev_value __user *)(unsigned long)batch.values;
+	if (copy_from_user(v, uvalues, batch.count * sizeof(v[0])))
+		return -EFAULT;
+
+	mutex_lock(&sysfs_lock);
+
+	for (i = 0; i < batch.count && !status; i++)
+		status = gpiodev_check(v[i].gpio, write, &can_sleep);
+	if (status)
+		goto out;
+
+	if (!can_sleep)
+		local_irq_save(flags);
+	for (i = 0; i < batch.count; i++) {
+		unsigned	gpio = v[i].gpio;
+		int		active_low;
+
+		active_low = test_bit(FLAG_ACTIVE_LOW, &gpio_desc[gpio].flags);
+		if (write) {
+			int value = !!v[i].value ^ active_low;
+
+			if (can_sleep)
+				gpio_set_value_cansleep(gpio, value);
+			else
+				__gpio_set_value(gpio, value);
+		} else {
+			int value = can_sleep ? gpio_get_value_cansleep(gpio)
+					      : __gpio_get_value(gpio);
+
+			v[i].value = !!value ^ active_low;
+		}
+	}
+	if (!can_sleep)
+		local_irq_restore(flags);
+
+out:
+	mutex_unlock(&sysfs_lock);
+
+	if (!status && !write &&
+	    copy_to_user(uvalues, v, batch.count * sizeof(v[0])))
+		status = -EFAULT;
+	return status;
+}
+
+static irqreturn_t gpiodev_irq(int irq, void *priv)
+{
+	struct gpiodev_watcher	*w = priv;
+	struct gpiodev_file	*f = w->file;
+	struct gpiodev_event	*ev;
+	int			active_low;
+
+	active_low = test_bit(FLAG_ACTIVE_LOW, &gpio_desc[w->gpio].flags);
+
+	spin_lock(&f->lock);
+	ev = &f->events[f->head++ & (GPIODEV_EVENTS - 1)];
+	/* a full ring drops its oldest event */
+	if (f->head - f->tail > GPIODEV_EVENTS)
+		f->tail = f->head - GPIODEV_EVENTS;
+	ev->timestamp = ktime_to_ns(ktime_get());
+	ev->gpio = w->gpio;
+	ev->value = !!__gpio_get_value(w->gpio) ^ active_low;
+	spin_unlock(&f->lock);
+
+	wake_up_interruptible(&f->wait);
+	return IRQ_HANDLED;
+}
+
+static void gpiodev_unwatch(struct gpiodev_watcher *w)
+{
+	free_irq(w->irq, w);
+	list_del(&w->list);
+	kfree(w);
+}
+
+static long gpiodev_watch(struct gpiodev_file *f,
+		struct gpiodev_watch __user *uwatch)
+{
+	struct gpiodev_watcher	*w;
+	struct gpiodev_watch	watch;
+	unsigned long		irq_flags = 0;
+	bool			can_sleep = false;
+	int			active_low;
+	int			status;
+
+	if (copy_from_user(&watch, uwatch, sizeof(watch)))
+		return -EFAULT;
+	if (watch.edges & ~(GPIODEV_EDGE_RISING | GPIODEV_EDGE_FALLING))
+		return -EINVAL;
+
+	mutex_lock(&sysfs_lock);
+
+	list_for_each_entry(w, &f->watchers, list) {
+		if (w->gpio == watch.gpio) {
+			gpiodev_unwatch(w);
+			break;
+		}
+	}
+
+	status = 0;
+	if (!watch.edges)
+		goto out;
+
+	status = gpiodev_check(watch.gpio, false, &can_sleep);
+	if (!status && can_sleep)
+		status = -EINVAL;	/* the irq handler reads the value */
+	if (status)
+		goto out;
+
+	active_low = test_bit(FLAG_ACTIVE_LOW, &gpio_desc[watch.gpio].flags);
+	if (watch.edges & GPIODEV_EDGE_RISING)
+		irq_flags |= active_low ? IRQF_TRIGGER_FALLING
+					: IRQF_TRIGGER_RISING;
+	if (watch.edges & GPIODEV_EDGE_FALLING)
+		irq_flags |= active_low ? IRQF_TRIGGER_RISING
+					: IRQF_TRIGGER_FALLING;
+
+	w = kzalloc(sizeof(*w), GFP_KERNEL);
+	if (!w) {
+		status = -ENOMEM;
+		goto out;
+	}
+	w->file = f;
+	w->gpio = watch.gpio;
+	w->irq = gpio_to_irq(watch.gpio);
+	if (w->irq < 0) {
+		status = w->irq;
+		kfree(w);
+		goto out;
+	}
+
+	status = request_irq(w->irq, gpiodev_irq, irq_flags, "gpiodev", w);
+	if (status < 0) {
+		kfree(w);
+		goto out;
+	}
+	list_add(&w->list, &f->watchers);
+
+out:
+	mutex_unlock(&sysfs_lock);
+	return status;
+}
+
+static long gpiodev_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	void __user	*argp = (void __user *)arg;
+
+	switch (cmd) {
+	case GPIODEV_GET_VALUES:
+		return gpiodev_values(argp, false);
+	case GPIODEV_SET_VALUES:
+		return gpiodev_values(argp, true);
+	case GPIODEV_WATCH:
+		return gpiodev_watch(file->private_data, argp);
+	}
+	return -ENOTTY;
+}
+
+static ssize_t gpiodev_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct gpiodev_file	*f = file->private_data;
+	struct gpiodev_event	ev;
+	size_t			done = 0;
+	int			status;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	while (!done) {
+		if (f->head == f->tail && (file->f_flags & O_NONBLOCK))
+			return -EAGAIN;
+		status = wait_event_interruptible(f->wait, f->head != f->tail);
+		if (status)
+			return status;
+
+		while (done + sizeof(ev) <= count) {
+			spin_lock_irq(&f->lock);
+			if (f->head == f->tail) {
+				spin_unlock_irq(&f->lock);
+				break;
+			}
+			ev = f->events[f->tail++ & (GPIODEV_EVENTS - 1)];
+			spin_unlock_irq(&f->lock);
+
+			if (copy_to_user(buf + done, &ev, sizeof(ev)))
+				return -EFAULT;
+			done += sizeof(ev);
+		}
+	}
+	return done;
+}
+
+static unsigned int gpiodev_poll(struct file *file, poll_table *wait)
+{
+	struct gpiodev_file	*f = file->private_data;
+
+	poll_wait(file, &f->wait, wait);
+	return f->head != f->tail ? POLLIN | POLLRDNORM : 0;
+}
+
+static int gpiodev_open(struct inode *inode, struct file *file)
+{
+	struct gpiodev_file	*f;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&f->watchers);
+	spin_lock_init(&f->lock);
+	init_waitqueue_head(&f->wait);
+
+	file->private_data = f;
+	return nonseekable_open(inode, file);
+}
+
+static int gpiodev_release(struct inode *inode, struct file *file)
+{
+	struct gpiodev_file	*f = file->private_data;
+	struct gpiodev_watcher	*w, *next;
+
+	mutex_lock(&sysfs_lock);
+	list_for_each_entry_safe(w, next, &f->watchers, list)
+		gpiodev_unwatch(w);
+	mutex_unlock(&sysfs_lock);
+
+	kfree(f);
+	return 0;
+}
+
+static const struct file_operations gpiodev_fops = {
+	.owner		= THIS_MODULE,
+	.open		= gpiodev_open,
+	.release	= gpiodev_release,
+	.read		= gpiodev_read,
+	.poll		= gpiodev_poll,
+	.unlocked_ioctl	= gpiodev_ioctl,
+	.llseek		= no_llseek,
+};
+
+static struct miscdevice gpiodev_misc = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "gpio",
+	.fops		= &gpiodev_fops,
+};
+
+static int __init gpiodev_init(void)
+{
+	return misc_register(&gpiodev_misc);
+}
+device_initcall(gpiodev_init);
+
+#endif /* CONFIG_GPIO_DEV */
+
 static int __init gpiolib_sysfs_init(void)
 {
 	int		status;
@@ -48,6 +48,13 @@
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/moduleparam.h>
 
 #include <mach/irqs.h>
 #include <mach/hardware.h>
@@ -112,6 +119,41 @@ static u16 __initdata i2c_clk_div[50][2] = {
 	{ 3072,	0x1E }, { 3840,	0x1F }
 };
 
+/*
+ * The controller and its clock stay enabled for this long after a
+ * transfer, so that back to back transfers skip the enable and the 50us
+ * settling delay.  0 turns the controller off after every transfer.
+ */
+static unsigned int idle_ms = 20;
+module_param(idle_ms, uint, 0644);
+MODULE_PARM_DESC(idle_ms, "Keep the controller clocked this long after a transfer");
+
+/* State of the message being moved by the interrupt handler */
+enum {
+	IMX_I2C_IDLE,
+	IMX_I2C_ADDR,		/* slave address sent */
+	IMX_I2C_WRITE,		/* data byte sent */
+	IMX_I2C_READ,		/* data byte being received */
+	IMX_I2C_DONE,
+};
+
+/*
+ * Per-slave transfer latency, from the start condition to the stop, as
+ * seen by i2c_imx_xfer().  Bucket i counts latencies below 32us << i,
+ * the last one everything longer.  Slaves beyond the table share the
+ * last entry.
+ */
+#define IMX_I2C_LAT_CLIENTS	16
+#define IMX_I2C_LAT_BUCKETS	12
+
+struct imx_i2c_latency {
+	unsigned int	addr;
+	u32		errors;
+	u32		count[IMX_I2C_LAT_BUCKETS];
+	u64		total_us;
+	u32		max_us;
+};
+
 struct imx_i2c_struct {
 	struct i2c_adapter	adapter;
 	struct resource		*res;
@@ -119,10 +161,33 @@ struct imx_i2c_struct {
 	void __iomem		*base;
 	int			irq;
 	wait_queue_head_t	queue;
-	unsigned long		i2csr;
 	unsigned int 		disable_delay;
 	int			stopped;
 	unsigned int		ifdr; /* IMX_I2C_IFDR */
+	unsigned int		ifdr_safe;	/* for pdata->bitrate */
+	int			bitrate;	/* what ifdr runs the bus at */
+	int			safe_bitrate;
+	int			fast_errors;	/* consecutive, at fast_bitrate */
+
+	/* Message state shared with the interrupt handler */
+	spinlock_t		lock;
+	struct i2c_msg		*msg;
+	unsigned int		msg_idx;
+	int			msg_state;
+	int			msg_err;
+	int			stop_pending;	/* isr issued the STOP */
+	int			addr_nak;	/* no slave at that address */
+
+	/* Controller kept enabled between transfers, see idle_ms */
+	int			enabled;
+	int			suspended;
+	unsigned long		last_xfer;	/* jiffies */
+	struct delayed_work	idle_work;
+	unsigned long		wakeups;
+
+	/* Protected by the adapter lock */
+	struct imx_i2c_latency	lat[IMX_I2C_LAT_CLIENTS + 1];
+	struct dentry		*debugfs;
 };
 
 /** Functions for IMX I2C adapter driver ***************************************
@@ -157,34 +222,48 @@ static int i2c_imx_bus_busy(struct imx_i2c_struct *i2c_imx, int for_busy)
 	return 0;
 }
 
-static int i2c_imx_trx_complete(struct imx_i2c_struct *i2c_imx)
+static void i2c_imx_enable(struct imx_i2c_struct *i2c_imx)
 {
-	int result;
+	if (i2c_imx->enabled)
+		return;
 
-	result = wait_event_interruptible_timeout(i2c_imx->queue,
-		i2c_imx->i2csr & I2SR_IIF, HZ / 10);
+	clk_enable(i2c_imx->clk);
+	writeb(i2c_imx->ifdr, i2c_imx->base + IMX_I2C_IFDR);
+	/* Enable I2C controller */
+	writeb(0, i2c_imx->base + IMX_I2C_I2SR);
+	writeb(I2CR_IEN, i2c_imx->base + IMX_I2C_I2CR);
 
-	if (unlikely(result < 0)) {
-		dev_dbg(&i2c_imx->adapter.dev, "<%s> result < 0\n", __func__);
-		return result;
-	} else if (unlikely(!(i2c_imx->i2csr & I2SR_IIF))) {
-		dev_dbg(&i2c_imx->adapter.dev, "<%s> Timeout\n", __func__);
-		return -ETIMEDOUT;
-	}
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> TRX complete\n", __func__);
-	i2c_imx->i2csr = 0;
-	return 0;
+	/* Wait controller to be stable */
+	udelay(50);
+	i2c_imx->enabled = 1;
+	i2c_imx->wakeups++;
 }
 
-static int i2c_imx_acked(struct imx_i2c_struct *i2c_imx)
+static void i2c_imx_disable(struct imx_i2c_struct *i2c_imx)
 {
-	if (readb(i2c_imx->base + IMX_I2C_I2SR) & I2SR_RXAK) {
-		dev_dbg(&i2c_imx->adapter.dev, "<%s> No ACK\n", __func__);
-		return -EIO;  /* No ACK */
-	}
+	if (!i2c_imx->enabled)
+		return;
 
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> ACK received\n", __func__);
-	return 0;
+	/* Disable I2C controller */
+	writeb(0, i2c_imx->base + IMX_I2C_I2CR);
+	clk_disable(i2c_imx->clk);
+	i2c_imx->enabled = 0;
+}
+
+/* Turns the controller off once it has been idle for idle_ms */
+static void i2c_imx_idle_work(struct work_struct *work)
+{
+	struct imx_i2c_struct *i2c_imx =
+		container_of(work, struct imx_i2c_struct, idle_work.work);
+	unsigned long expires;
+
+	i2c_lock_adapter(&i2c_imx->adapter);
+	expires = i2c_imx->last_xfer + msecs_to_jiffies(idle_ms);
+	if (i2c_imx->enabled && time_before(jiffies, expires))
+		schedule_delayed_work(&i2c_imx->idle_work, expires - jiffies);
+	else
+		i2c_imx_disable(i2c_imx);
+	i2c_unlock_adapter(&i2c_imx->adapter);
 }
 
 static int i2c_imx_start(struct imx_i2c_struct *i2c_imx)
@@ -194,14 +273,7 @@ static int i2c_imx_start(struct imx_i2c_struct *i2c_imx)
 
 	dev_dbg(&i2c_imx->adapter.dev, "<%s>\n", __func__);
 
-	clk_enable(i2c_imx->clk);
-	writeb(i2c_imx->ifdr, i2c_imx->base + IMX_I2C_IFDR);
-	/* Enable I2C controller */
-	writeb(0, i2c_imx->base + IMX_I2C_I2SR);
-	writeb(I2CR_IEN, i2c_imx->base + IMX_I2C_I2CR);
-
-	/* Wait controller to be stable */
-	udelay(50);
+	i2c_imx_enable(i2c_imx);
 
 	/* Start I2C transaction */
 	temp = readb(i2c_imx->base + IMX_I2C_I2CR);
@@ -241,9 +313,17 @@ static void i2c_imx_stop(struct imx_i2c_struct *i2c_imx)
 		i2c_imx->stopped = 1;
 	}
 
-	/* Disable I2C controller */
-	writeb(0, i2c_imx->base + IMX_I2C_I2CR);
-	clk_disable(i2c_imx->clk);
+	if (!idle_ms || i2c_imx->suspended) {
+		i2c_imx_disable(i2c_imx);
+		return;
+	}
+
+	/* Stay enabled, interrupts off, until the bus has been idle a while */
+	writeb(I2CR_IEN, i2c_imx->base + IMX_I2C_I2CR);
+	i2c_imx->last_xfer = jiffies;
+	if (!delayed_work_pending(&i2c_imx->idle_work))
+		schedule_delayed_work(&i2c_imx->idle_work,
+				      msecs_to_jiffies(idle_ms));
 }
 
 static void __init i2c_imx_set_clk(struct imx_i2c_struct *i2c_imx,
@@ -284,6 +364,84 @@ static void __init i2c_imx_set_clk(struct imx_i2c_struct *i2c_imx,
 #endif
 }
 
+/*
+ * Move the current message on by one byte.  Called from the interrupt
+ * handler with i2c_imx->lock held, once per byte transferred, so that the
+ * waiting thread is only woken when the whole message is done.
+ */
+static void i2c_imx_msg_irq(struct imx_i2c_struct *i2c_imx, unsigned int sr)
+{
+	struct i2c_msg *msg = i2c_imx->msg;
+	unsigned int temp;
+	int err = 0;
+
+	if (sr & I2SR_IAL) {
+		err = -EAGAIN;
+		goto done;
+	}
+
+	switch (i2c_imx->msg_state) {
+	case IMX_I2C_ADDR:
+	case IMX_I2C_WRITE:
+		/* The address and every byte written must be acked */
+		if (sr & I2SR_RXAK) {
+			if (i2c_imx->msg_state == IMX_I2C_ADDR)
+				i2c_imx->addr_nak = 1;
+			err = -EIO;
+			goto done;
+		}
+		if (i2c_imx->msg_state == IMX_I2C_ADDR &&
+		    (msg->flags & I2C_M_RD)) {
+			/* setup bus to read data */
+			temp = readb(i2c_imx->base + IMX_I2C_I2CR);
+			temp &= ~I2CR_MTX;
+			if (msg->len - 1)
+				temp &= ~I2CR_TXAK;
+			writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
+			readb(i2c_imx->base + IMX_I2C_I2DR); /* dummy read */
+			if (!msg->len)
+				goto done;
+			i2c_imx->msg_state = IMX_I2C_READ;
+			return;
+		}
+		if (i2c_imx->msg_idx < msg->len) {
+			writeb(msg->buf[i2c_imx->msg_idx++],
+			       i2c_imx->base + IMX_I2C_I2DR);
+			i2c_imx->msg_state = IMX_I2C_WRITE;
+			return;
+		}
+		goto done;
+
+	case IMX_I2C_READ:
+		if (i2c_imx->msg_idx == msg->len - 1) {
+			/* It must generate STOP before read I2DR to prevent
+			   controller from generating another clock cycle */
+			temp = readb(i2c_imx->base + IMX_I2C_I2CR);
+			temp &= ~(I2CR_MSTA | I2CR_MTX);
+			writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
+			i2c_imx->stop_pending = 1;
+		} else if (i2c_imx->msg_idx == msg->len - 2) {
+			temp = readb(i2c_imx->base + IMX_I2C_I2CR);
+			temp |= I2CR_TXAK;
+			writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
+		}
+		msg->buf[i2c_imx->msg_idx++] =
+			readb(i2c_imx->base + IMX_I2C_I2DR);
+		if (i2c_imx->msg_idx < msg->len)
+			return;
+		goto done;
+
+	default:
+		/* Nothing in flight, e.g. the thread already timed out */
+		return;
+	}
+
+done:
+	i2c_imx->msg_err = err;
+	i2c_imx->msg_state = IMX_I2C_DONE;
+	wake_up_interruptible(&i2c_imx->queue);
+}
+
 static irqreturn_t i2c_imx_isr(int irq, void *dev_id)
 {
 	struct imx_i2c_struct *i2c_imx = dev_id;
@@ -291,108 +449,126 @@ static irqreturn_t i2c_imx_isr(int irq, void *dev_id)
 
 	temp = readb(i2c_imx->base + IMX_I2C_I2SR);
 	if (temp & I2SR_IIF) {
-		/* save status register */
-		i2c_imx->i2csr = temp;
-		temp &= ~I2SR_IIF;
-		writeb(temp, i2c_imx->base + IMX_I2C_I2SR);
-		wake_up_interruptible(&i2c_imx->queue);
+		writeb(temp & ~(I2SR_IIF | I2SR_IAL),
+		       i2c_imx->base + IMX_I2C_I2SR);
+		spin_lock(&i2c_imx->lock);
+		i2c_imx_msg_irq(i2c_imx, temp);
+		spin_unlock(&i2c_imx->lock);
 		return IRQ_HANDLED;
 	}
 
 	return IRQ_NONE;
 }
 
-static int i2c_imx_write(struct imx_i2c_struct *i2c_imx, struct i2c_msg *msgs)
+/*
+ * Send the slave address of @msg and let the interrupt handler move the
+ * data.  Returns once the whole message is through or has failed.
+ */
+static int i2c_imx_xfer_msg(struct imx_i2c_struct *i2c_imx,
+			    struct i2c_msg *msg)
 {
-	int i, result;
+	unsigned int addr = msg->addr << 1;
+	long timeout;
+	int result;
 
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> write slave address: addr=0x%x\n",
-		__func__, msgs->addr << 1);
+	if (msg->flags & I2C_M_RD)
+		addr |= 0x01;
 
-	/* write slave address */
-	writeb(msgs->addr << 1, i2c_imx->base + IMX_I2C_I2DR);
-	result = i2c_imx_trx_complete(i2c_imx);
-	if (result)
-		return result;
-	result = i2c_imx_acked(i2c_imx);
-	if (result)
-		return result;
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> write data\n", __func__);
+	dev_dbg(&i2c_imx->adapter.dev, "<%s> write slave address: addr=0x%x\n",
+		__func__, addr);
+
+	spin_lock_irq(&i2c_imx->lock);
+	i2c_imx->msg = msg;
+	i2c_imx->msg_idx = 0;
+	i2c_imx->msg_err = 0;
+	i2c_imx->msg_state = IMX_I2C_ADDR;
+	i2c_imx->stop_pending = 0;
+	i2c_imx->addr_nak = 0;
+	spin_unlock_irq(&i2c_imx->lock);
+
+	writeb(addr, i2c_imx->base + IMX_I2C_I2DR);
+
+	/* A byte takes ~90us at 100kHz; allow 1ms each on top of the base */
+	timeout = HZ / 10 + msecs_to_jiffies(msg->len);
+	timeout = wait_event_interruptible_timeout(i2c_imx->queue,
+		i2c_imx->msg_state == IMX_I2C_DONE, timeout);
+
+	spin_lock_irq(&i2c_imx->lock);
+	if (i2c_imx->msg_state == IMX_I2C_DONE)
+		result = i2c_imx->msg_err;
+	else
+		result = timeout < 0 ? timeout : -ETIMEDOUT;
+	i2c_imx->msg_state = IMX_I2C_IDLE;
+	spin_unlock_irq(&i2c_imx->lock);
 
-	/* write data */
-	for (i = 0; i < msgs->len; i++) {
-		dev_dbg(&i2c_imx->adapter.dev,
-			"<%s> write byte: B%d=0x%X\n",
-			__func__, i, msgs->buf[i]);
-		writeb(msgs->buf[i], i2c_imx->base + IMX_I2C_I2DR);
-		result = i2c_imx_trx_complete(i2c_imx);
-		if (result)
-			return result;
-		result = i2c_imx_acked(i2c_imx);
-		if (result)
-			return result;
+	if (i2c_imx->stop_pending) {
+		i2c_imx_bus_busy(i2c_imx, 0);
+		i2c_imx->stopped = 1;
 	}
-	return 0;
-}
 
-static int i2c_imx_read(struct imx_i2c_struct *i2c_imx, struct i2c_msg *msgs)
-{
-	int i, result;
-	unsigned int temp;
+	dev_dbg(&i2c_imx->adapter.dev, "<%s> %u of %u bytes: %d\n", __func__,
+		i2c_imx->msg_idx, msg->len, result);
+	return result;
+}
 
-	dev_dbg(&i2c_imx->adapter.dev,
-		"<%s> write slave address: addr=0x%x\n",
-		__func__, (msgs->addr << 1) | 0x01);
+/*
+ * Number of failed transfers in a row at fast_bitrate before the bus is
+ * considered unable to run at that speed.
+ */
+#define IMX_I2C_FAST_ERRORS	3
 
-	/* write slave address */
-	writeb((msgs->addr << 1) | 0x01, i2c_imx->base + IMX_I2C_I2DR);
-	result = i2c_imx_trx_complete(i2c_imx);
-	if (result)
-		return result;
-	result = i2c_imx_acked(i2c_imx);
-	if (result)
-		return result;
+/*
+ * Called after every transfer while running at the board's fast_bitrate.
+ * A slave not answering its address is normal (probing, devices that are
+ * not fitted); timeouts, lost arbitration and data bytes not acked are
+ * what a bus too slow for the clock looks like.
+ */
+static void i2c_imx_check_speed(struct imx_i2c_struct *i2c_imx, int result)
+{
+	if (result != -ETIMEDOUT && result != -EAGAIN &&
+	    (result != -EIO || i2c_imx->addr_nak)) {
+		i2c_imx->fast_errors = 0;
+		return;
+	}
 
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> setup bus\n", __func__);
+	if (++i2c_imx->fast_errors < IMX_I2C_FAST_ERRORS)
+		return;
 
-	/* setup bus to read data */
-	temp = readb(i2c_imx->base + IMX_I2C_I2CR);
-	temp &= ~I2CR_MTX;
-	if (msgs->len - 1)
-		temp &= ~I2CR_TXAK;
-	writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
-	readb(i2c_imx->base + IMX_I2C_I2DR); /* dummy read */
+	dev_warn(&i2c_imx->adapter.dev, "unreliable at %d Hz, using %d Hz\n",
+		 i2c_imx->bitrate, i2c_imx->safe_bitrate);
+	i2c_imx->ifdr = i2c_imx->ifdr_safe;
+	i2c_imx->bitrate = i2c_imx->safe_bitrate;
+	/* The new divider is programmed when the controller is enabled */
+	i2c_imx_disable(i2c_imx);
+}
 
-	dev_dbg(&i2c_imx->adapter.dev, "<%s> read data\n", __func__);
+static void i2c_imx_latency_record(struct imx_i2c_struct *i2c_imx,
+				   unsigned int addr, s64 usecs, int result)
+{
+	struct imx_i2c_latency *lat = NULL;
+	unsigned int i, bucket;
 
-	/* read data */
-	for (i = 0; i < msgs->len; i++) {
-		result = i2c_imx_trx_complete(i2c_imx);
-		if (result)
-			return result;
-		if (i == (msgs->len - 1)) {
-			/* It must generate STOP before read I2DR to prevent
-			   controller from generating another clock cycle */
-			dev_dbg(&i2c_imx->adapter.dev,
-				"<%s> clear MSTA\n", __func__);
-			temp = readb(i2c_imx->base + IMX_I2C_I2CR);
-			temp &= ~(I2CR_MSTA | I2CR_MTX);
-			writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
-			i2c_imx_bus_busy(i2c_imx, 0);
-			i2c_imx->stopped = 1;
-		} else if (i == (msgs->len - 2)) {
-			dev_dbg(&i2c_imx->adapter.dev,
-				"<%s> set TXAK\n", __func__);
-			temp = readb(i2c_imx->base + IMX_I2C_I2CR);
-			temp |= I2CR_TXAK;
-			writeb(temp, i2c_imx->base + IMX_I2C_I2CR);
-		}
-		msgs->buf[i] = readb(i2c_imx->base + IMX_I2C_I2DR);
-		dev_dbg(&i2c_imx->adapter.dev,
-			"<%s> read byte: B%d=0x%X\n",
-			__func__, i, msgs->buf[i]);
+	for (i = 0; i < IMX_I2C_LAT_CLIENTS; i++) {
+		lat = &i2c_imx->lat[i];
+		if (lat->addr == addr || !lat->total_us)
+			break;
 	}
-	return 0;
+	/* Table full: account it as "other" */
+	if (i == IMX_I2C_LAT_CLIENTS)
+		lat = &i2c_imx->lat[IMX_I2C_LAT_CLIENTS];
+
+	usecs = clamp_t(s64, usecs, 1, (u32)~0);
+	bucket = usecs < 32 ? 0 : ilog2(usecs) - 4;
+	if (bucket >= IMX_I2C_LAT_BUCKETS)
+		bucket = IMX_I2C_LAT_BUCKETS - 1;
+
+	lat->addr = addr;
+	lat->count[bucket]++;
+	lat->total_us += usecs;
+	if (usecs > lat->max_us)
+		lat->max_us = usecs;
+	if (result < 0)
+		lat->errors++;
 }
 
 static int i2c_imx_xfer(struct i2c_adapter *adapter,
@@ -401,6 +577,7 @@ static int i2c_imx_xfer(struct i2c_adapter *adapter,
 	unsigned int i, temp;
 	int result;
 	struct imx_i2c_struct *i2c_imx = i2c_get_adapdata(adapter);
+	ktime_t start = ktime_get();
 
 	dev_dbg(&i2c_imx->adapter.dev, "<%s>\n", __func__);
 
@@ -440,10 +617,7 @@ static int i2c_imx_xfer(struct i2c_adapter *adapter,
 			(temp & I2SR_SRW ? 1 : 0), (temp & I2SR_IIF ? 1 : 0),
 			(temp & I2SR_RXAK ? 1 : 0));
 #endif
-		if (msgs[i].flags & I2C_M_RD)
-			result = i2c_imx_read(i2c_imx, &msgs[i]);
-		else
-			result = i2c_imx_write(i2c_imx, &msgs[i]);
+		result = i2c_imx_xfer_msg(i2c_imx, &msgs[i]);
 		if (result)
 			goto fail0;
 	}
@@ -452,6 +626,14 @@ fail0:
 	/* Stop I2C transfer */
 	i2c_imx_stop(i2c_imx);
 
+	if (i2c_imx->ifdr != i2c_imx->ifdr_safe)
+		i2c_imx_check_speed(i2c_imx, result);
+
+	if (num > 0)
+		i2c_imx_latency_record(i2c_imx, msgs[0].addr,
+				       ktime_us_delta(ktime_get(), start),
+				       result);
+
 	dev_dbg(&i2c_imx->adapter.dev, "<%s> exit with: %s: %d\n", __func__,
 		(result < 0) ? "error" : "success msg",
 			(result < 0) ? result : num);
@@ -468,6 +650,118 @@ static struct i2c_algorithm i2c_imx_algo = {
 	.functionality	= i2c_imx_func,
 };
 
+#ifdef CONFIG_DEBUG_FS
+struct i2c_imx_name_lookup {
+	unsigned int	addr;
+	const char	*name;
+};
+
+static int i2c_imx_find_client(struct device *dev, void *data)
+{
+	struct i2c_imx_name_lookup *lookup = data;
+	struct i2c_client *client = i2c_verify_client(dev);
+
+	if (client && client->addr == lookup->addr) {
+		lookup->name = client->name;
+		return 1;
+	}
+	return 0;
+}
+
+static int i2c_imx_latency_show(struct seq_file *s, void *data)
+{
+	struct imx_i2c_struct *i2c_imx = s->private;
+	struct imx_i2c_latency *lat;
+	unsigned int i, b, n;
+
+	seq_printf(s, "bitrate: %d Hz, controller wakeups: %lu, idle_ms: %u\n",
+		   i2c_imx->bitrate, i2c_imx->wakeups, idle_ms);
+	seq_printf(s, "%-4s %-16s %8s %6s %8s %8s", "addr", "client", "count",
+		   "errors", "avg_us", "max_us");
+	for (b = 0; b < IMX_I2C_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " %6u", 32u << b);
+	seq_printf(s, " %6s\n", "more");
+
+	i2c_lock_adapter(&i2c_imx->adapter);
+	for (i = 0; i <= IMX_I2C_LAT_CLIENTS; i++) {
+		struct i2c_imx_name_lookup lookup;
+
+		lat = &i2c_imx->lat[i];
+		if (!lat->total_us)
+			continue;
+
+		lookup.addr = lat->addr;
+		lookup.name = "?";
+		if (i == IMX_I2C_LAT_CLIENTS)
+			lookup.name = "other";
+		else
+			device_for_each_child(&i2c_imx->adapter.dev, &lookup,
+					      i2c_imx_find_client);
+
+		n = 0;
+		for (b = 0; b < IMX_I2C_LAT_BUCKETS; b++)
+			n += lat->count[b];
+		seq_printf(s, "0x%02x %-16s %8u %6u %8llu %8u", lat->addr,
+			   lookup.name, n, lat->errors,
+			   (unsigned long long)div_u64(lat->total_us, n),
+			   lat->max_us);
+		for (b = 0; b < IMX_I2C_LAT_BUCKETS; b++)
+			seq_printf(s, " %6u", lat->count[b]);
+		seq_printf(s, "\n");
+	}
+	i2c_unlock_adapter(&i2c_imx->adapter);
+	return 0;
+}
+
+static int i2c_imx_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, i2c_imx_latency_show, inode->i_private);
+}
+
+/* Any write clears the histogram */
+static ssize_t i2c_imx_latency_write(struct file *file,
+				     const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct imx_i2c_struct *i2c_imx =
+		((struct seq_file *)file->private_data)->private;
+
+	i2c_lock_adapter(&i2c_imx->adapter);
+	memset(i2c_imx->lat, 0, sizeof(i2c_imx->lat));
+	i2c_imx->wakeups = 0;
+	i2c_unlock_adapter(&i2c_imx->adapter);
+	return count;
+}
+
+static const struct file_operations i2c_imx_latency_fops = {
+	.open		= i2c_imx_latency_open,
+	.read		= seq_read,
+	.write		= i2c_imx_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void i2c_imx_debugfs_init(struct imx_i2c_struct *i2c_imx)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir(dev_name(&i2c_imx->adapter.dev), NULL);
+	if (IS_ERR_OR_NULL(root))
+		return;
+	debugfs_create_file("latency", S_IRUSR | S_IWUSR, root, i2c_imx,
+			    &i2c_imx_latency_fops);
+	i2c_imx->debugfs = root;
+}
+
+static void i2c_imx_debugfs_exit(struct imx_i2c_struct *i2c_imx)
+{
+	debugfs_remove_recursive(i2c_imx->debugfs);
+}
+#else
+static inline void i2c_imx_debugfs_init(struct imx_i2c_struct *i2c_imx) {}
+static inline void i2c_imx_debugfs_exit(struct imx_i2c_struct *i2c_imx) {}
+#endif
+
 static int __init i2c_imx_probe(struct platform_device *pdev)
 {
 	struct imx_i2c_struct *i2c_imx;
@@ -547,15 +841,28 @@ static int __init i2c_imx_probe(struct platform_device *pdev)
 
 	/* Init queue */
 	init_waitqueue_head(&i2c_imx->queue);
+	spin_lock_init(&i2c_imx->lock);
+	INIT_DELAYED_WORK(&i2c_imx->idle_work, i2c_imx_idle_work);
 
 	/* Set up adapter data */
 	i2c_set_adapdata(&i2c_imx->adapter, i2c_imx);
 
 	/* Set up clock divider */
 	if (pdata && pdata->bitrate)
-		i2c_imx_set_clk(i2c_imx, pdata->bitrate);
+		i2c_imx->safe_bitrate = pdata->bitrate;
 	else
-		i2c_imx_set_clk(i2c_imx, IMX_I2C_BIT_RATE);
+		i2c_imx->safe_bitrate = IMX_I2C_BIT_RATE;
+	i2c_imx_set_clk(i2c_imx, i2c_imx->safe_bitrate);
+	i2c_imx->ifdr_safe = i2c_imx->ifdr;
+	i2c_imx->bitrate = i2c_imx->safe_bitrate;
+
+	/* Start out fast if the board allows it, see i2c_imx_check_speed() */
+	if (pdata && pdata->fast_bitrate > i2c_imx->safe_bitrate) {
+		i2c_imx_set_clk(i2c_imx, pdata->fast_bitrate);
+		i2c_imx->bitrate = pdata->fast_bitrate;
+		dev_info(&pdev->dev, "running at %d Hz, %d Hz fallback\n",
+			 i2c_imx->bitrate, i2c_imx->safe_bitrate);
+	}
 
 	/* Set up chip registers to defaults */
 	writeb(0, i2c_imx->base + IMX_I2C_I2CR);
@@ -570,6 +877,7 @@ static int __init i2c_imx_probe(struct platform_device *pdev)
 
 	/* Set up platform driver data */
 	platform_set_drvdata(pdev, i2c_imx);
+	i2c_imx_debugfs_init(i2c_imx);
 
 	dev_dbg(&i2c_imx->adapter.dev, "claimed irq %d\n", i2c_imx->irq);
 	dev_dbg(&i2c_imx->adapter.dev, "device resources from 0x%x to 0x%x\n",
@@ -605,9 +913,13 @@ static int __exit i2c_imx_remove(struct platform_device *pdev)
 
 	/* remove adapter */
 	dev_dbg(&i2c_imx->adapter.dev, "adapter removed\n");
+	i2c_imx_debugfs_exit(i2c_imx);
 	i2c_del_adapter(&i2c_imx->adapter);
 	platform_set_drvdata(pdev, NULL);
 
+	cancel_delayed_work_sync(&i2c_imx->idle_work);
+	i2c_imx_disable(i2c_imx);
+
 	/* free interrupt */
 	free_irq(i2c_imx->irq, i2c_imx);
 
@@ -629,11 +941,43 @@ static int __exit i2c_imx_remove(struct platform_device *pdev)
 	return 0;
 }
 
+/*
+ * Don't carry a clocked controller into suspend; transfers made while
+ * suspended turn it off again straight away.
+ */
+static int i2c_imx_suspend(struct device *dev)
+{
+	struct imx_i2c_struct *i2c_imx = dev_get_drvdata(dev);
+
+	cancel_delayed_work_sync(&i2c_imx->idle_work);
+	i2c_lock_adapter(&i2c_imx->adapter);
+	i2c_imx->suspended = 1;
+	i2c_imx_disable(i2c_imx);
+	i2c_unlock_adapter(&i2c_imx->adapter);
+	return 0;
+}
+
+static int i2c_imx_resume(struct device *dev)
+{
+	struct imx_i2c_struct *i2c_imx = dev_get_drvdata(dev);
+
+	i2c_lock_adapter(&i2c_imx->adapter);
+	i2c_imx->suspended = 0;
+	i2c_unlock_adapter(&i2c_imx->adapter);
+	return 0;
+}
+
+static const struct dev_pm_ops i2c_imx_pm_ops = {
+	.suspend	= i2c_imx_suspend,
+	.resume		= i2c_imx_resume,
+};
+
 static struct platform_driver i2c_imx_driver = {
 	.remove		= __exit_p(i2c_imx_remove),
 	.driver	= {
 		.name	= DRIVER_NAME,
 		.owner	= THIS_MODULE,
+		.pm	= &i2c_imx_pm_ops,
 	}
 };
 
@@ -305,6 +305,9 @@ static void input_handle_event(struct input_dev *dev,
 
 	if (disposition & INPUT_PASS_TO_HANDLERS)
 		input_pass_event(dev, type, code, value);
+
+	if (type == EV_SYN && code == SYN_REPORT)
+		dev->timestamp = ktime_set(0, 0);
 }
 
 /**
@@ -1577,6 +1580,25 @@ void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int
 }
 EXPORT_SYMBOL(input_set_capability);
 
+/**
+ * input_set_timestamp - set the time the current packet was sampled
+ * @dev: input device the packet is reported on
+ * @timestamp: CLOCK_MONOTONIC time of the sample, usually taken in
+ *	the hard interrupt handler
+ *
+ * Drivers that read their hardware from a work item or an irq thread
+ * can call this before reporting a packet, so that the events up to
+ * the next input_sync() carry the time of the interrupt instead of
+ * the time they reach the handlers.
+ */
+void input_set_timestamp(struct input_dev *dev, ktime_t timestamp)
+{
+	/* event timestamps are wall clock; move @timestamp over */
+	dev->timestamp = ktime_sub(ktime_get_real(),
+				   ktime_sub(ktime_get(), timestamp));
+}
+EXPORT_SYMBOL(input_set_timestamp);
+
 #define INPUT_CLEANSE_BITMASK(dev, type, bits)				\
 	do {								\
 		if (!test_bit(EV_##type, dev->evbit))			\
@@ -1596,6 +1618,43 @@ static void input_cleanse_bitmasks(struct input_dev *dev)
 	INPUT_CLEANSE_BITMASK(dev, SW, sw);
 }
 
+static unsigned int input_estimate_events_per_packet(struct input_dev *dev)
+{
+	int mt_slots;
+	int i;
+	unsigned int events;
+
+	if (test_bit(ABS_MT_TRACKING_ID, dev->absbit)) {
+		mt_slots = dev->absmax[ABS_MT_TRACKING_ID] -
+			   dev->absmin[ABS_MT_TRACKING_ID] + 1;
+		mt_slots = clamp(mt_slots, 2, 32);
+	} else if (test_bit(ABS_MT_POSITION_X, dev->absbit)) {
+		mt_slots = 2;
+	} else {
+		mt_slots = 0;
+	}
+
+	events = mt_slots + 1; /* count SYN_MT_REPORT and SYN_REPORT */
+
+	for (i = 0; i < ABS_CNT; i++) {
+		if (test_bit(i, dev->absbit)) {
+			if (i >= ABS_MT_TOUCH_MAJOR && i <= ABS_MT_PRESSURE)
+				events += mt_slots;
+			else
+				events++;
+		}
+	}
+
+	for (i = 0; i < REL_CNT; i++)
+		if (test_bit(i, dev->relbit))
+			events++;
+
+	/* Make room for KEY and MSC events */
+	events += 7;
+
+	return events;
+}
+
 /**
  * input_register_device - register device with input core
  * @dev: device to be registered
@@ -1624,6 +1683,10 @@ int input_register_device(struct input_dev *dev)
 	/* Make sure that bitmasks not mentioned in dev->evbit are clean. */
 	input_cleanse_bitmasks(dev);
 
+	if (!dev->hint_events_per_packet)
+		dev->hint_events_per_packet =
+				input_estimate_events_per_packet(dev);
+
 	/*
 	 * If delay and period are pre-set by the driver, then autorepeating
 	 * is handled by the driver itself and we don't do it in input.c.
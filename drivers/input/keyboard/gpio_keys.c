@@ -25,11 +25,21 @@
 #include <linux/gpio_keys.h>
 #include <linux/workqueue.h>
 #include <linux/gpio.h>
+#include <linux/hrtimer.h>
+
+/*
+ * Buttons with a debounce_interval report their first edge right away
+ * and are read once more when no edge has been seen for the interval.
+ * A non-zero debounce_ms overrides the board's interval for them.
+ */
+static unsigned int debounce_ms;
+module_param(debounce_ms, uint, 0644);
+MODULE_PARM_DESC(debounce_ms, "debounce window in ms (0 = board default)");
 
 struct gpio_button_data {
 	struct gpio_keys_button *button;
 	struct input_dev *input;
-	struct timer_list timer;
+	struct hrtimer timer;
 	struct work_struct work;
 	bool disabled;
 };
@@ -110,7 +120,7 @@ static void gpio_keys_disable_button(struct gpio_button_data *bdata)
 		 */
 		disable_irq(gpio_to_irq(bdata->button->gpio));
 		if (bdata->button->debounce_interval)
-			del_timer_sync(&bdata->timer);
+			hrtimer_cancel(&bdata->timer);
 
 		bdata->disabled = true;
 	}
@@ -322,8 +332,7 @@ static void gpio_keys_report_event(struct gpio_button_data *bdata)
 	int state = (gpio_get_value(button->gpio) ? 1 : 0) ^ button->active_low;
 
 	input_event(input, type, button->code, !!state);
-	printk ("[%s-%d] (!!state=%d, button->code=%d)\n", __func__, __LINE__, !!state,  button->code);
-//	input_sync(input);
+	input_sync(input);
 }
 
 static void gpio_keys_work_func(struct work_struct *work)
@@ -334,24 +343,34 @@ static void gpio_keys_work_func(struct work_struct *work)
 	gpio_keys_report_event(bdata);
 }
 
-static void gpio_keys_timer(unsigned long _data)
+static enum hrtimer_restart gpio_keys_timer(struct hrtimer *timer)
 {
-	struct gpio_button_data *data = (struct gpio_button_data *)_data;
+	struct gpio_button_data *data =
+		container_of(timer, struct gpio_button_data, timer);
 
+	/* the contacts settled: confirm the state reported on the edge */
 	schedule_work(&data->work);
+	return HRTIMER_NORESTART;
 }
 
 static irqreturn_t gpio_keys_isr(int irq, void *dev_id)
 {
 	struct gpio_button_data *bdata = dev_id;
 	struct gpio_keys_button *button = bdata->button;
+	unsigned int ms;
 
 	BUG_ON(irq != gpio_to_irq(button->gpio));
 
-	if (button->debounce_interval)
-		mod_timer(&bdata->timer,
-			jiffies + msecs_to_jiffies(button->debounce_interval));
-	else
+	if (button->debounce_interval) {
+		ms = debounce_ms ?: button->debounce_interval;
+		/* edges inside the window only push the confirmation out */
+		if (!hrtimer_active(&bdata->timer))
+			schedule_work(&bdata->work);
+		hrtimer_start(&bdata->timer,
+			      ktime_set(ms / MSEC_PER_SEC,
+					(ms % MSEC_PER_SEC) * NSEC_PER_MSEC),
+			      HRTIMER_MODE_REL);
+	} else
 		schedule_work(&bdata->work);
 
 	return IRQ_HANDLED;
@@ -366,7 +385,8 @@ static int __devinit gpio_keys_setup_key(struct platform_device *pdev,
 	unsigned long irqflags;
 	int irq, error;
 
-	setup_timer(&bdata->timer, gpio_keys_timer, (unsigned long)bdata);
+	hrtimer_init(&bdata->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	bdata->timer.function = gpio_keys_timer;
 	INIT_WORK(&bdata->work, gpio_keys_work_func);
 
 	error = gpio_request(button->gpio, desc);
@@ -507,7 +527,7 @@ static int __devinit gpio_keys_probe(struct platform_device *pdev)
 	while (--i >= 0) {
 		free_irq(gpio_to_irq(pdata->buttons[i].gpio), &ddata->data[i]);
 		if (pdata->buttons[i].debounce_interval)
-			del_timer_sync(&ddata->data[i].timer);
+			hrtimer_cancel(&ddata->data[i].timer);
 		cancel_work_sync(&ddata->data[i].work);
 		gpio_free(pdata->buttons[i].gpio);
 	}
@@ -535,7 +555,7 @@ static int __devexit gpio_keys_remove(struct platform_device *pdev)
 		int irq = gpio_to_irq(pdata->buttons[i].gpio);
 		free_irq(irq, &ddata->data[i]);
 		if (pdata->buttons[i].debounce_interval)
-			del_timer_sync(&ddata->data[i].timer);
+			hrtimer_cancel(&ddata->data[i].timer);
 		cancel_work_sync(&ddata->data[i].work);
 		gpio_free(pdata->buttons[i].gpio);
 	}
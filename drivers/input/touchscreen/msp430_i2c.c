@@ -16,6 +16,9 @@
 #include <linux/delay.h>
 #include <linux/hrtimer.h>
 #include <linux/gpio.h>
+#include <linux/async.h>
+#include <linux/mxcfb.h>
+#include <linux/mxcfb_epdc_kernel.h>
 
 #define GDEBUG 0
 #include <linux/gallen_dbg.h>
@@ -41,6 +44,7 @@ static struct MSP430_data {
 	struct i2c_client *client;
 	struct input_dev *input;
 	wait_queue_head_t wait;
+	ktime_t irq_time;	/* start of the touch being reported */
 } MSP430_touch_data;
 
 /*--------------------------------------------------------------*/
@@ -105,6 +109,9 @@ static void MSP430_touch_report_data(void)
 {
 	static unsigned char last_pos[2][2];
 	unsigned char buf[10];
+	int reported = 0;
+	/* a poll while touched samples now, otherwise the irq did */
+	ktime_t sampled = touch_flag ? ktime_get() : MSP430_touch_data.irq_time;
 	
 	MSP430_touch_recv_data (MSP430_touch_data.client, 0x40, buf);
 	
@@ -118,6 +125,7 @@ static void MSP430_touch_report_data(void)
 			buf[0] = 8-buf[0];
 			buf[1] = 8-buf[1];
 			if ((buf[0] != last_pos[0][0]) || (buf[1] != last_pos[0][1])) {
+				input_set_timestamp(MSP430_touch_data.input, sampled);
 				input_report_abs(MSP430_touch_data.input, ABS_X, buf[0]);
 				input_report_abs(MSP430_touch_data.input, ABS_Y, buf[1]);
 				input_report_abs(MSP430_touch_data.input, ABS_PRESSURE, 1);
@@ -128,11 +136,13 @@ static void MSP430_touch_report_data(void)
 				last_pos[0][1] = buf[1];
 				input_report_key(MSP430_touch_data.input, KEY_LEFT, 1);
 				input_sync(MSP430_touch_data.input);
+				reported = 1;
 				DBG_MSG("[%s-%d] Area A %d, %d down.\n",__func__,__LINE__,last_pos[0][0],last_pos[0][1]);
 			}
 		}
 		else if (last_pos[0][0] || last_pos[0][1]) {
 			DBG_MSG ("[%s-%d] Area A %d, %d up.\n",__func__,__LINE__,last_pos[0][0],last_pos[0][1]);
+			input_set_timestamp(MSP430_touch_data.input, sampled);
 			input_report_abs(MSP430_touch_data.input, ABS_X, last_pos[0][0]);
 			input_report_abs(MSP430_touch_data.input, ABS_Y, last_pos[0][1]);
 			input_report_abs(MSP430_touch_data.input, ABS_PRESSURE, 0);
@@ -143,6 +153,7 @@ static void MSP430_touch_report_data(void)
 			last_pos[0][1] = 0;
 			input_report_key(MSP430_touch_data.input, KEY_LEFT, 0);
 			input_sync(MSP430_touch_data.input);
+			reported = 1;
 			touch_flag &= 0x02;
 		} 
 		if (buf[2] || buf[3]) {
@@ -150,6 +161,7 @@ static void MSP430_touch_report_data(void)
 			buf[2] = 8-buf[2];
 			buf[3] = 8-buf[3];
 			if ((buf[2] != last_pos[1][0]) || (buf[3] != last_pos[1][1])) {
+				input_set_timestamp(MSP430_touch_data.input, sampled);
 				input_report_abs(MSP430_touch_data.input, ABS_X, buf[2]);
 				input_report_abs(MSP430_touch_data.input, ABS_Y, buf[3]);
 				input_report_abs(MSP430_touch_data.input, ABS_PRESSURE, 1);
@@ -160,11 +172,13 @@ static void MSP430_touch_report_data(void)
 				last_pos[1][1] = buf[3];
 				input_report_key(MSP430_touch_data.input, KEY_RIGHT, 1);
 				input_sync(MSP430_touch_data.input);
+				reported = 1;
 				DBG_MSG("[%s-%d] Area B %d, %d down.\n",__func__,__LINE__,last_pos[1][0],last_pos[1][1]);
 			}
 		}
 		else if (last_pos[1][0] || last_pos[1][1]) {
 			DBG_MSG ("[%s-%d] Area B %d, %d up.\n",__func__,__LINE__,last_pos[1][0],last_pos[1][1]);
+			input_set_timestamp(MSP430_touch_data.input, sampled);
 			input_report_abs(MSP430_touch_data.input, ABS_X, last_pos[1][0]);
 			input_report_abs(MSP430_touch_data.input, ABS_Y, last_pos[1][1]);
 			input_report_abs(MSP430_touch_data.input, ABS_PRESSURE, 0);	
@@ -175,6 +189,7 @@ static void MSP430_touch_report_data(void)
 			last_pos[1][1] = 0;
 			input_report_key(MSP430_touch_data.input, KEY_RIGHT, 0);
 			input_sync(MSP430_touch_data.input);
+			reported = 1;
 			touch_flag &= 0x01;
 		}
 	} 
@@ -187,6 +202,7 @@ static void MSP430_touch_report_data(void)
 		}
 	//	printk ("[%s-%d] key buffer %02x,%02x,%02x,%02x\n",__func__,__LINE__,buf[0],buf[1],buf[2],buf[3]);
 			
+		input_set_timestamp(MSP430_touch_data.input, sampled);
 		if ((buf[1] & 0x01) || (buf[3] & 0x01))
 			input_report_key(MSP430_touch_data.input, KEY_UP, 1);
 		if ((buf[1] & 0x02) || (buf[3] & 0x02))
@@ -198,7 +214,9 @@ static void MSP430_touch_report_data(void)
 		if ((buf[1] & 0x10) || (buf[3] & 0x10))
 			input_report_key(MSP430_touch_data.input, KEY_ENTER, 1);
 		input_sync(MSP430_touch_data.input);
+		reported = 1;
 		
+		input_set_timestamp(MSP430_touch_data.input, sampled);
 		if ((buf[1] & 0x01) || (buf[3] & 0x01))
 			input_report_key(MSP430_touch_data.input, KEY_UP, 0);
 		if ((buf[1] & 0x02) || (buf[3] & 0x02))
@@ -210,8 +228,12 @@ static void MSP430_touch_report_data(void)
 		if ((buf[1] & 0x10) || (buf[3] & 0x10))
 			input_report_key(MSP430_touch_data.input, KEY_ENTER, 0);
 		input_sync(MSP430_touch_data.input);
+		reported = 1;
 	}
 
+	if (reported)
+		mxc_epdc_fb_note_input(MSP430_touch_data.irq_time);
+
 	schedule();
 	if (touch_flag)
 		schedule_delayed_work(&MSP430_touch_data.work, 2);
@@ -233,6 +255,7 @@ static irqreturn_t MSP430_touch_ts_interrupt(int irq, void *dev_id)
 		printk ("[%s-%d] firmware upgrading %d\n",__func__,__LINE__,g_FW_upgrade_process);
 	}
 	else if (!touch_flag) {
+		MSP430_touch_data.irq_time = ktime_get();
 		if (g_is_report_abs)
 			schedule_delayed_work(&MSP430_touch_data.work, 1);
 		else
@@ -701,13 +724,31 @@ static struct i2c_driver MSP430_touch_driver = {
 	},
 };
 
+/*
+ * Independent of the other boot devices, probe it in parallel.  Wait for
+ * the earlier async probes (the front zForce panel) first so the input
+ * event numbering userspace relies on does not change from boot to boot.
+ */
+static void __init MSP430_touch_init_async(void *data, async_cookie_t cookie)
+{
+	int err;
+
+	async_synchronize_cookie(cookie);
+	err = i2c_add_driver(&MSP430_touch_driver);
+
+	if (err)
+		printk(KERN_ERR "%s: i2c_add_driver failed (%d)\n", __func__, err);
+}
+
 static int __init MSP430_touch_init(void)
 {
-	return i2c_add_driver(&MSP430_touch_driver);
+	async_schedule(MSP430_touch_init_async, NULL);
+	return 0;
 }
 
 static void __exit MSP430_touch_exit(void)
 {
+	async_synchronize_full();
 	i2c_del_driver(&MSP430_touch_driver);
 }
 
@@ -15,7 +15,12 @@
 #include <linux/i2c.h>
 #include <linux/delay.h>
 #include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/async.h>
 #include <linux/gpio.h>
+#include <linux/earlysuspend.h>
+#include <linux/mxcfb.h>
+#include <linux/mxcfb_epdc_kernel.h>
 #include "../../../arch/arm/mach-mx5/ntx_hwconfig.h"
 extern volatile NTX_HWCONFIG *gptHWCFG;
 
@@ -26,8 +31,9 @@ static const char ZFORCE_TS_NAME[]	= "zForce-ir-touch";
 
 #define DEFAULT_PANEL_W		600
 #define DEFAULT_PANEL_H		800
-#define IDX_QUEUE_SIZE		20
 #define IDX_PACKET_SIZE		129
+/* packets read per interrupt before handing back to the work item */
+#define MAX_PACKETS_PER_IRQ	8
 
 static struct workqueue_struct *zForce_wq;
 static uint16_t g_touch_pressed, g_touch_triggered;
@@ -45,8 +51,29 @@ static struct zForce_data {
 	struct i2c_client *client;
 	struct input_dev *input;
 	wait_queue_head_t wait;
+	struct mutex lock;		/* serializes irq thread and work */
+	ktime_t irq_time;		/* hard irq time of pending data */
+	s64 latency_last, latency_max;	/* hard irq to input_sync, us */
+	struct delayed_work	freq_work;
 } zForce_ir_touch_data;
 
+/*
+ * Scan frequency policy: the "fast" rates are set on the first touch
+ * of a burst, the "slow" ones once no touch has been seen for
+ * freq_timeout ms.  Tuned through neocmd, see neo_ctl().
+ */
+static struct zForce_freq {
+	unsigned fast_idle, fast_active;
+	unsigned slow_idle, slow_active;
+	unsigned timeout;		/* ms */
+	unsigned cur_idle, cur_active;	/* last sent, 0 if unknown */
+	unsigned long last_touch;	/* jiffies */
+} zForce_freq = {
+	.fast_idle = 50, .fast_active = 100,
+	.slow_idle = 10, .slow_active = 100,
+	.timeout = 5000,
+};
+
 static uint8_t cmd_Resolution_v2[] = {0xEE, 0x05, 0x02, (DEFAULT_PANEL_W&0xFF), (DEFAULT_PANEL_W>>8), (DEFAULT_PANEL_H&0xFF), (DEFAULT_PANEL_H>>8)};
 static const uint8_t cmd_TouchData_v2[] = {0xEE, 0x01, 0x04};
 //static const uint8_t cmd_Frequency_v2[] = {0xEE, 0x07, 0x08, 10, 00, 100, 00, 100, 00};	//artis: orig
@@ -187,6 +214,8 @@ static int zForce_ir_touch_recv_data(struct i2c_client *client, uint8_t *buf)
 			break;
 		case 8:
 			printk ("[%s-%d] command Frequency (%d) ...\n",__func__,__LINE__,buf[1]);
+			if (4 == g_zforce_initial_step)
+				break;	// runtime rate change, not part of the init chain
 			if(8==gptHWCFG->m_val.bTouchCtrl) {  //neonode v2
 				i2c_master_send(client, cmd_Dual_touch_v2, sizeof(cmd_Dual_touch_v2));
 			}else{
@@ -303,44 +332,111 @@ static void zForce_ir_touch_report_data(struct i2c_client *client, uint8_t *buf)
 		packet += (8==gptHWCFG->m_val.bTouchCtrl)?9:7;
 	}
 	input_sync(zForce_ir_touch_data.input);
-	schedule();	// Joseph 20101023
+	late_resume_input_event();
 }
 
-static uint8_t gzForceBuffer[IDX_QUEUE_SIZE+2][IDX_PACKET_SIZE];
-static int gQueueRear, gQueueFront;
+static void zForce_send_frequency(struct i2c_client *client, unsigned idle, unsigned active)
+{
+	if (idle == zForce_freq.cur_idle && active == zForce_freq.cur_active)
+		return;
+	// only once the init chain is done, its Frequency step owns the answer
+	if (4 != g_zforce_initial_step)
+		return;
+
+	if(8==gptHWCFG->m_val.bTouchCtrl) {    //neonode v2
+		uint8_t cmd[] = {0xEE, 0x07, 0x08, idle & 0xFF, idle >> 8,
+			active & 0xFF, active >> 8, active & 0xFF, active >> 8};
+		i2c_master_send(client, cmd, sizeof(cmd));
+	}else{
+		uint8_t cmd[] = {0x08, min(idle, 255U), min(active, 255U)};
+		i2c_master_send(client, cmd, sizeof(cmd));
+	}
+	zForce_freq.cur_idle = idle;
+	zForce_freq.cur_active = active;
+}
 
-void zForce_ir_touch_enqueue (void)
+/* called with every touch report, from the irq thread */
+static void zForce_freq_touch(void)
 {
-	int packets = zForce_ir_touch_recv_data(zForce_ir_touch_data.client, gzForceBuffer[gQueueRear]);
-	if(0 < packets) {
-		if ((gQueueRear+packets) >= IDX_QUEUE_SIZE) {
-//			printk ("[%s-%d] touch queue overflowed. (R %d, p %d, move %d)  \n",__func__,__LINE__,gQueueRear,packets,((gQueueRear+packets)-(IDX_QUEUE_SIZE-1)));
-			memmove (gzForceBuffer, &gzForceBuffer[IDX_QUEUE_SIZE], ((gQueueRear+packets)-(IDX_QUEUE_SIZE-1))*IDX_PACKET_SIZE);
-		}
-		if (((gQueueRear+packets)%IDX_QUEUE_SIZE) == gQueueFront)
-			printk ("[%s-%d] touch queue full\n",__func__,__LINE__);
-		else
-			gQueueRear = (gQueueRear+packets)%IDX_QUEUE_SIZE;
+	zForce_freq.last_touch = jiffies;
+	if (zForce_freq.cur_idle != zForce_freq.fast_idle ||
+	    zForce_freq.cur_active != zForce_freq.fast_active) {
+		zForce_send_frequency(zForce_ir_touch_data.client,
+			zForce_freq.fast_idle, zForce_freq.fast_active);
+		schedule_delayed_work(&zForce_ir_touch_data.freq_work,
+			msecs_to_jiffies(zForce_freq.timeout));
 	}
 }
 
-static void zForce_ir_touch_work_func(struct work_struct *work)
+static void zForce_freq_work_func(struct work_struct *work)
 {
-	zForce_ir_touch_enqueue ();	
-	while (gQueueRear != gQueueFront){
-		zForce_ir_touch_report_data(zForce_ir_touch_data.client, gzForceBuffer[gQueueFront]);
-		gQueueFront = (gQueueFront+1)%IDX_QUEUE_SIZE;
+	unsigned long expires = zForce_freq.last_touch + msecs_to_jiffies(zForce_freq.timeout);
+
+	mutex_lock(&zForce_ir_touch_data.lock);
+	if (time_before(jiffies, expires))
+		schedule_delayed_work(&zForce_ir_touch_data.freq_work, expires - jiffies);
+	else
+		zForce_send_frequency(zForce_ir_touch_data.client,
+			zForce_freq.slow_idle, zForce_freq.slow_active);
+	mutex_unlock(&zForce_ir_touch_data.lock);
+}
+
+/*
+ * Read and report everything the controller has pending (INT low), in
+ * the context of the caller.  The first report is stamped with the hard
+ * irq time, the ones behind it were sampled later and are stamped when
+ * they are delivered.  The time from the hard irq to input_sync() is
+ * tracked as latency.
+ */
+static uint8_t gzForceBuffer[IDX_PACKET_SIZE];
+
+static void zForce_ir_touch_process(void)
+{
+	int i;
+	s64 latency;
+
+	mutex_lock(&zForce_ir_touch_data.lock);
+	for (i = 0; i < MAX_PACKETS_PER_IRQ; i++) {
+		if (zForce_ir_touch_detect_int_level ())
+			break;
+		if (0 < zForce_ir_touch_recv_data(zForce_ir_touch_data.client, gzForceBuffer)) {
+			if (0 == i)
+				input_set_timestamp(zForce_ir_touch_data.input,
+						    zForce_ir_touch_data.irq_time);
+			zForce_ir_touch_report_data(zForce_ir_touch_data.client, gzForceBuffer);
+			zForce_freq_touch();
+			mxc_epdc_fb_note_input(zForce_ir_touch_data.irq_time);
+			latency = ktime_us_delta(ktime_get(), zForce_ir_touch_data.irq_time);
+			zForce_ir_touch_data.latency_last = latency;
+			if (latency > zForce_ir_touch_data.latency_max)
+				zForce_ir_touch_data.latency_max = latency;
+		}
 	}
+	mutex_unlock(&zForce_ir_touch_data.lock);
+
+	/* still asserted: poll again shortly instead of spinning here */
 	if (!zForce_ir_touch_detect_int_level ())
 		schedule_delayed_work(&zForce_ir_touch_data.work, 1);
 	else
 		g_touch_triggered = 0;
 }
 
+static void zForce_ir_touch_work_func(struct work_struct *work)
+{
+	zForce_ir_touch_data.irq_time = ktime_get();
+	zForce_ir_touch_process();
+}
+
 static irqreturn_t zForce_ir_touch_ts_interrupt(int irq, void *dev_id)
 {
+	zForce_ir_touch_data.irq_time = ktime_get();
 	g_touch_triggered = 1;
-	schedule_delayed_work(&zForce_ir_touch_data.work, 0);
+	return IRQ_WAKE_THREAD;
+}
+
+static irqreturn_t zForce_ir_touch_ts_thread(int irq, void *dev_id)
+{
+	zForce_ir_touch_process();
 	return IRQ_HANDLED;
 }
 
@@ -358,7 +454,12 @@ void zForce_ir_touch_ts_triggered(void)
 static ssize_t neo_info(struct device *dev, struct device_attribute *attr,
 			char *buf)
 {
-	return 0;
+	return sprintf(buf, "rate %u %u\nfast %u %u\nslow %u %u\ntimeout %u\nlatency %lld %lld\n",
+		zForce_freq.cur_idle, zForce_freq.cur_active,
+		zForce_freq.fast_idle, zForce_freq.fast_active,
+		zForce_freq.slow_idle, zForce_freq.slow_active,
+		zForce_freq.timeout,
+		zForce_ir_touch_data.latency_last, zForce_ir_touch_data.latency_max);
 }
 
 static ssize_t neo_ctl(struct device *dev, struct device_attribute *attr,
@@ -390,6 +491,25 @@ static ssize_t neo_ctl(struct device *dev, struct device_attribute *attr,
 				i2c_master_send(zForce_ir_touch_data.client, cmd_Resolution, sizeof(cmd_Resolution));
 			}	
 			break;
+		case 'f':
+			// f <fast idle> <fast active> <slow idle> <slow active> <timeout ms>
+			{
+				unsigned v[5];
+
+				if (5 != sscanf(buf+1, "%u %u %u %u %u", &v[0], &v[1], &v[2], &v[3], &v[4]) ||
+				    !v[0] || !v[1] || !v[2] || !v[3] || !v[4] ||
+				    v[0] > 0xFFFF || v[1] > 0xFFFF || v[2] > 0xFFFF || v[3] > 0xFFFF)
+					return -EINVAL;
+				mutex_lock(&zForce_ir_touch_data.lock);
+				zForce_freq.fast_idle = v[0];
+				zForce_freq.fast_active = v[1];
+				zForce_freq.slow_idle = v[2];
+				zForce_freq.slow_active = v[3];
+				zForce_freq.timeout = v[4];
+				mutex_unlock(&zForce_ir_touch_data.lock);
+				schedule_delayed_work(&zForce_ir_touch_data.freq_work, 0);
+			}
+			break;
 		case 'l':
 			printk("Get LedSignalLevel \n");
 //			i2c_master_send(zForce_ir_touch_data.client, cmd_LedLevel, sizeof(cmd_LedLevel));
@@ -398,6 +518,21 @@ static ssize_t neo_ctl(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 static DEVICE_ATTR(neocmd, 0644, neo_info, neo_ctl);
+
+static ssize_t neo_latency_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	return sprintf(buf, "%lld %lld\n", zForce_ir_touch_data.latency_last,
+			zForce_ir_touch_data.latency_max);
+}
+
+static ssize_t neo_latency_reset(struct device *dev, struct device_attribute *attr,
+		       const char *buf, size_t count)
+{
+	zForce_ir_touch_data.latency_max = 0;
+	return count;
+}
+static DEVICE_ATTR(latency, 0644, neo_latency_show, neo_latency_reset);
 extern int gSleep_Mode_Suspend;
 
 static int zForce_ir_touch_suspend(struct platform_device *pdev, pm_message_t state)
@@ -414,7 +549,6 @@ static int zForce_ir_touch_suspend(struct platform_device *pdev, pm_message_t st
 		return -EBUSY;
 	}
 	if (gSleep_Mode_Suspend) {
-		gQueueRear = gQueueFront;	// clean queue.
 		if(8==gptHWCFG->m_val.bTouchCtrl) {
 			i2c_master_send(zForce_ir_touch_data.client, cmd_Deactive_v2, sizeof(cmd_Deactive_v2));
 		}else{
@@ -435,6 +569,8 @@ static int zForce_ir_touch_resume(struct platform_device *pdev)
 			i2c_master_send(zForce_ir_touch_data.client, cmd_Active, sizeof(cmd_Active));
 		}	
 		enable_irq_wake(zForce_ir_touch_data.client->irq);
+		// resend the rates with the next touch
+		zForce_freq.cur_idle = zForce_freq.cur_active = 0;
 	}
 	if (!zForce_ir_touch_detect_int_level ()) {
 		zForce_ir_touch_ts_triggered ();
@@ -454,6 +590,8 @@ static int zforce_i2c_open(struct input_dev *dev)
 		i2c_master_send(client, cmd_Active, sizeof(cmd_Active));
 	}
 	g_zforce_initial_step = 1;	
+	// the init chain sends cmd_Frequency, the policy takes over on the first touch
+	zForce_freq.cur_idle = zForce_freq.cur_active = 0;
 //	i2c_master_send(client, cmd_Resolution, sizeof(cmd_Resolution));
 	
 	return 0;
@@ -497,6 +635,8 @@ static int zForce_ir_touch_probe(
 	strlcpy(client->name, ZFORCE_TS_NAME, I2C_NAME_SIZE);
 
 	INIT_DELAYED_WORK(&zForce_ir_touch_data.work, zForce_ir_touch_work_func);
+	INIT_DELAYED_WORK(&zForce_ir_touch_data.freq_work, zForce_freq_work_func);
+	mutex_init(&zForce_ir_touch_data.lock);
 	
 	zForce_ir_touch_data.intr_gpio = (client->dev).platform_data;
 	
@@ -506,7 +646,8 @@ static int zForce_ir_touch_probe(
 		goto fail;
 	}
 
-	err = request_irq(zForce_ir_touch_data.client->irq, zForce_ir_touch_ts_interrupt, 0, ZFORCE_TS_NAME, ZFORCE_TS_NAME);
+	err = request_threaded_irq(zForce_ir_touch_data.client->irq, zForce_ir_touch_ts_interrupt,
+			zForce_ir_touch_ts_thread, IRQF_ONESHOT, ZFORCE_TS_NAME, ZFORCE_TS_NAME);
 	if (err < 0) {
 		printk("%s(%s): Can't allocate irq %d\n", __FILE__, __func__, zForce_ir_touch_data.client->irq);
 	    goto fail;
@@ -591,7 +732,9 @@ static int zForce_ir_touch_probe(
 	input_set_abs_params(zForce_ir_touch_data.input, ABS_MT_WIDTH_MAJOR, 0, 15, 0, 0);
 	input_set_abs_params(zForce_ir_touch_data.input, ABS_MT_TRACKING_ID, 1, 2, 0, 0);
 	input_set_abs_params(zForce_ir_touch_data.input, ABS_PRESSURE, 0, 2048, 0, 0);
-
+	/* up to MAX_PACKETS_PER_IRQ reports of two contacts back to back */
+	input_set_events_per_packet(zForce_ir_touch_data.input,
+				    MAX_PACKETS_PER_IRQ * (2 * 6 + 1));
 
 	err = input_register_device(zForce_ir_touch_data.input);
 	if (err < 0) {
@@ -604,11 +747,19 @@ static int zForce_ir_touch_probe(
 		pr_debug("Can't create device file!\n");
 		return -ENODEV;
 	}
+	err = device_create_file(&client->dev, &dev_attr_latency);
+	if (err)
+		pr_debug("Can't create latency file!\n");
 	
 	if (!zForce_ir_touch_detect_int_level()) {
 		g_touch_triggered = 1;
 		schedule_delayed_work(&zForce_ir_touch_data.work, 0);
 	}
+
+	/* Only talks to its parent adapter, safe to resume in parallel */
+	device_enable_async_resume(&client->dev);
+	/* Stay active across micro suspends so that a touch wakes us up */
+	device_set_retains_state(&client->dev, true);
 	return 0;
 
 fail:
@@ -620,14 +771,17 @@ fail:
 
 static int zForce_ir_touch_remove(struct i2c_client *client)
 {
+	device_remove_file(&client->dev, &dev_attr_latency);
 	device_remove_file(&client->dev, &dev_attr_neocmd);
 
+	free_irq(client->irq, ZFORCE_TS_NAME);
+	cancel_delayed_work_sync(&zForce_ir_touch_data.work);
+	cancel_delayed_work_sync(&zForce_ir_touch_data.freq_work);
+
 	if (zForce_wq)
 		destroy_workqueue(zForce_wq);
 
 	input_unregister_device(zForce_ir_touch_data.input);
-
-	free_irq(client->irq, ZFORCE_TS_NAME);
 	return 0;
 }
 
@@ -649,13 +803,29 @@ static struct i2c_driver zForce_ir_touch_driver = {
 	},
 };
 
+/*
+ * The controller handshake talks to the panel over I2C and nothing else
+ * depends on it, so let it probe alongside the rest of the boot.  The
+ * regulators it relies on are registered at subsys_initcall time, well
+ * before this runs; boot waits for us before freeing init memory.
+ */
+static void __init zForce_ir_touch_init_async(void *data, async_cookie_t cookie)
+{
+	int err = i2c_add_driver(&zForce_ir_touch_driver);
+
+	if (err)
+		printk(KERN_ERR "%s: i2c_add_driver failed (%d)\n", __func__, err);
+}
+
 static int __init zForce_ir_touch_init(void)
 {
-	return i2c_add_driver(&zForce_ir_touch_driver);
+	async_schedule(zForce_ir_touch_init_async, NULL);
+	return 0;
 }
 
 static void __exit zForce_ir_touch_exit(void)
 {
+	async_synchronize_full();
 	i2c_del_driver(&zForce_ir_touch_driver);
 }
 
@@ -27,14 +27,46 @@
 #include <linux/platform_device.h>
 #include <linux/sysfs.h>
 #include <linux/io.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <mach/hardware.h>
 #include <asm/irq.h>
 #include <linux/fsl_devices.h>
 #include <mach/system.h>
+#ifdef CONFIG_ARCH_MX5
+#include <mach/mxc_dvfs.h>
+#endif
 #include "regs-perfmon.h"
 
 #define MONITOR		 "Monitor"
 
+/*
+ * Bandwidth monitor: the block counts one direction for the set of
+ * masters in MASTER_EN, so it is time-multiplexed over (master,
+ * direction) slots, one slot per sample period. Each master's rate is
+ * the one seen in its last slot; their sum is the DDR demand estimate
+ * handed to bus_freq.
+ */
+#define PERFMON_BW_SAMPLE_MS	20
+#define PERFMON_BW_HIST		8	/* < 8, 16, ... 512, >= 512 MB/s */
+
+static const char *perfmon_bw_default_masters[] = {
+	"CORE", "EPDC", "PXP", "SDMA", "USB",
+};
+
+struct mxs_perfmon_bw {
+	u64 bytes[2];			/* [0] read, [1] write */
+	u64 xfers[2];
+	u64 latency[2];			/* cycles, summed over transfers */
+	u64 ns[2];			/* time sampled */
+	u32 mbps[2];			/* last sample */
+	u32 max_latency;
+	u32 hist[2][PERFMON_BW_HIST];
+};
+
 struct mxs_perfmon_cmd_config {
 	int field;
 	int val;
@@ -104,6 +136,16 @@ struct mxs_perfmon_data {
 	struct attribute_group attr_group;
 	unsigned int base;
 	unsigned int initial;
+	/* bandwidth monitor */
+	struct mutex bw_mutex;		/* enable, masters */
+	spinlock_t bw_lock;		/* bw[] */
+	struct delayed_work bw_work;
+	struct mxs_perfmon_bw *bw;	/* one per bit_config_tab entry */
+	u32 bw_masters;			/* bit_config_tab indexes sampled */
+	unsigned int bw_sample_ms;
+	int bw_enabled;
+	int bw_slot;			/* index * 2 + direction */
+	ktime_t bw_start;
 	/* attribute ** follow */
 	/* device_attribute follow */
 };
@@ -212,6 +254,10 @@ perfmon_store(struct device *dev, struct device_attribute *attr,
 	if (!buf)
 		return -EINVAL;
 
+	/* the bandwidth monitor owns the block while it runs */
+	if (pd->bw_enabled)
+		return -EBUSY;
+
 	if (idx < pd->pdata->bit_config_cnt) {
 		pb = &pd->pdata->bit_config_tab[idx];
 		pb->reg = HW_PERFMON_MASTER_EN;
@@ -266,6 +312,283 @@ perfmon_store(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+static void perfmon_bw_start_slot(struct mxs_perfmon_data *pd)
+{
+	u32 ctrl = BM_PERFMON_CTRL_LATENCY_ENABLE | BM_PERFMON_CTRL_RUN;
+
+	if (!(pd->bw_slot & 1))
+		ctrl |= BM_PERFMON_CTRL_READ_EN;
+
+	perfmon_reg_write(pd, 0, HW_PERFMON_CTRL);
+	perfmon_reg_write(pd, pd->pdata->bit_config_tab[pd->bw_slot / 2].field,
+			  HW_PERFMON_MASTER_EN);
+	perfmon_reg_write(pd, BM_PERFMON_CTRL_CLR, HW_PERFMON_CTRL_SET);
+	perfmon_reg_write(pd, BM_PERFMON_CTRL_CLR, HW_PERFMON_CTRL_CLR);
+	perfmon_reg_write(pd, ctrl, HW_PERFMON_CTRL);
+	pd->bw_start = ktime_get();
+}
+
+static void perfmon_bw_next_slot(struct mxs_perfmon_data *pd)
+{
+	int n = pd->pdata->bit_config_cnt * 2;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		pd->bw_slot = (pd->bw_slot + 1) % n;
+		if (pd->bw_masters & (1 << (pd->bw_slot / 2)))
+			return;
+	}
+}
+
+static void perfmon_bw_collect(struct mxs_perfmon_data *pd)
+{
+	struct mxs_perfmon_bw *bw = &pd->bw[pd->bw_slot / 2];
+	int dir = pd->bw_slot & 1;
+	u32 bytes, xfers, lat, max_lat, mbps;
+	s64 ns;
+	int b;
+
+	perfmon_reg_write(pd, BM_PERFMON_CTRL_SNAP, HW_PERFMON_CTRL_SET);
+	bytes = perfmon_reg_read(pd, HW_PERFMON_DATA_COUNT);
+	xfers = perfmon_reg_read(pd, HW_PERFMON_TRANSFER_COUNT);
+	lat = perfmon_reg_read(pd, HW_PERFMON_TOTAL_LATENCY);
+	max_lat = perfmon_reg_read(pd, HW_PERFMON_MAX_LATENCY) &
+		BM_PERFMON_MAX_LATENCY_COUNT;
+	perfmon_reg_write(pd, BM_PERFMON_CTRL_SNAP, HW_PERFMON_CTRL_CLR);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), pd->bw_start));
+	if (ns <= 0)
+		return;
+	/* bytes per ns * 1000 = MB/s */
+	mbps = div64_u64((u64)bytes * 1000, ns);
+	for (b = 0; b < PERFMON_BW_HIST - 1 && mbps >= (8U << b); b++)
+		;
+
+	spin_lock(&pd->bw_lock);
+	bw->bytes[dir] += bytes;
+	bw->xfers[dir] += xfers;
+	bw->latency[dir] += lat;
+	bw->ns[dir] += ns;
+	bw->mbps[dir] = mbps;
+	if (max_lat > bw->max_latency)
+		bw->max_latency = max_lat;
+	bw->hist[dir][b]++;
+	spin_unlock(&pd->bw_lock);
+}
+
+/* sum of the last read and write rate of every sampled master */
+static unsigned int perfmon_bw_total(struct mxs_perfmon_data *pd)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < pd->pdata->bit_config_cnt; i++)
+		if (pd->bw_masters & (1 << i))
+			total += pd->bw[i].mbps[0] + pd->bw[i].mbps[1];
+	return total;
+}
+
+static void perfmon_bw_work(struct work_struct *work)
+{
+	struct mxs_perfmon_data *pd =
+		container_of(work, struct mxs_perfmon_data, bw_work.work);
+
+	perfmon_bw_collect(pd);
+	perfmon_bw_next_slot(pd);
+	perfmon_bw_start_slot(pd);
+#ifdef CONFIG_ARCH_MX5
+	bus_freq_update_bandwidth(perfmon_bw_total(pd));
+#endif
+	schedule_delayed_work(&pd->bw_work,
+			      msecs_to_jiffies(pd->bw_sample_ms));
+}
+
+static void perfmon_bw_stop(struct mxs_perfmon_data *pd)
+{
+	cancel_delayed_work_sync(&pd->bw_work);
+	perfmon_reg_write(pd, 0, HW_PERFMON_CTRL);
+#ifdef CONFIG_ARCH_MX5
+	bus_freq_update_bandwidth(0);
+#endif
+}
+
+static void perfmon_bw_run(struct mxs_perfmon_data *pd)
+{
+	if (!pd->initial) {
+		mxs_reset_block((void *)pd->base, true);
+		pd->initial = true;
+	}
+	/* start on the first sampled master */
+	pd->bw_slot = pd->pdata->bit_config_cnt * 2 - 1;
+	perfmon_bw_next_slot(pd);
+	perfmon_bw_start_slot(pd);
+	schedule_delayed_work(&pd->bw_work,
+			      msecs_to_jiffies(pd->bw_sample_ms));
+}
+
+#define to_perfmon_data(dev) \
+	((struct mxs_perfmon_data *)platform_get_drvdata(to_platform_device(dev)))
+
+static ssize_t
+bw_enable_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", to_perfmon_data(dev)->bw_enabled);
+}
+
+static ssize_t
+bw_enable_store(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct mxs_perfmon_data *pd = to_perfmon_data(dev);
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+
+	mutex_lock(&pd->bw_mutex);
+	if (val && !pd->bw_enabled) {
+		pd->bw_enabled = 1;
+		perfmon_bw_run(pd);
+	} else if (!val && pd->bw_enabled) {
+		perfmon_bw_stop(pd);
+		pd->bw_enabled = 0;
+	}
+	mutex_unlock(&pd->bw_mutex);
+	return count;
+}
+
+static ssize_t
+bw_sample_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", to_perfmon_data(dev)->bw_sample_ms);
+}
+
+static ssize_t
+bw_sample_ms_store(struct device *dev, struct device_attribute *attr,
+		   const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val < 1 || val > 10000)
+		return -EINVAL;
+	to_perfmon_data(dev)->bw_sample_ms = val;
+	return count;
+}
+
+static ssize_t
+bw_masters_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "0x%x\n", to_perfmon_data(dev)->bw_masters);
+}
+
+static ssize_t
+bw_masters_store(struct device *dev, struct device_attribute *attr,
+		 const char *buf, size_t count)
+{
+	struct mxs_perfmon_data *pd = to_perfmon_data(dev);
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+	val &= (1 << pd->pdata->bit_config_cnt) - 1;
+	if (!val)
+		return -EINVAL;
+
+	mutex_lock(&pd->bw_mutex);
+	if (pd->bw_enabled)
+		cancel_delayed_work_sync(&pd->bw_work);
+	pd->bw_masters = val;
+	if (pd->bw_enabled)
+		perfmon_bw_run(pd);
+	mutex_unlock(&pd->bw_mutex);
+	return count;
+}
+
+static ssize_t
+bw_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct mxs_perfmon_data *pd = to_perfmon_data(dev);
+	ssize_t len = 0;
+	int i, dir, b;
+
+	len += snprintf(buf + len, PAGE_SIZE - len, "total_MBps: %u\n",
+			perfmon_bw_total(pd));
+	len += snprintf(buf + len, PAGE_SIZE - len,
+			"%-12s dir  MBps    MB  avg_lat max_lat  "
+			"hist <8 <16 <32 <64 <128 <256 <512 >=512\n", "master");
+
+	spin_lock(&pd->bw_lock);
+	for (i = 0; i < pd->pdata->bit_config_cnt; i++) {
+		struct mxs_perfmon_bw *bw = &pd->bw[i];
+
+		if (!(pd->bw_masters & (1 << i)))
+			continue;
+		for (dir = 0; dir < 2; dir++) {
+			u32 avg = bw->xfers[dir] ?
+				div64_u64(bw->latency[dir], bw->xfers[dir]) : 0;
+
+			len += snprintf(buf + len, PAGE_SIZE - len,
+					"%-12s %s %5u %5llu %8u %7u ",
+					pd->pdata->bit_config_tab[i].name,
+					dir ? "wr" : "rd", bw->mbps[dir],
+					(unsigned long long)(bw->bytes[dir] >> 20),
+					avg, bw->max_latency);
+			for (b = 0; b < PERFMON_BW_HIST; b++)
+				len += snprintf(buf + len, PAGE_SIZE - len,
+						" %u", bw->hist[dir][b]);
+			len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+		}
+	}
+	spin_unlock(&pd->bw_lock);
+	return len;
+}
+
+/* any write clears the counters */
+static ssize_t
+bw_stats_store(struct device *dev, struct device_attribute *attr,
+	       const char *buf, size_t count)
+{
+	struct mxs_perfmon_data *pd = to_perfmon_data(dev);
+
+	spin_lock(&pd->bw_lock);
+	memset(pd->bw, 0, pd->pdata->bit_config_cnt * sizeof(*pd->bw));
+	spin_unlock(&pd->bw_lock);
+	return count;
+}
+
+static DEVICE_ATTR(enable, S_IWUSR | S_IRUGO, bw_enable_show,
+		   bw_enable_store);
+static DEVICE_ATTR(sample_ms, S_IWUSR | S_IRUGO, bw_sample_ms_show,
+		   bw_sample_ms_store);
+static DEVICE_ATTR(masters, S_IWUSR | S_IRUGO, bw_masters_show,
+		   bw_masters_store);
+static DEVICE_ATTR(stats, S_IWUSR | S_IRUGO, bw_stats_show, bw_stats_store);
+
+static struct attribute *perfmon_bw_attrs[] = {
+	&dev_attr_enable.attr,
+	&dev_attr_sample_ms.attr,
+	&dev_attr_masters.attr,
+	&dev_attr_stats.attr,
+	NULL,
+};
+
+static struct attribute_group perfmon_bw_attr_group = {
+	.name = "bandwidth",
+	.attrs = perfmon_bw_attrs,
+};
+
+static u32 perfmon_bw_default_mask(struct mxs_platform_perfmon_data *pdata)
+{
+	u32 mask = 0;
+	int i, j;
+
+	for (i = 0; i < pdata->bit_config_cnt; i++)
+		for (j = 0; j < ARRAY_SIZE(perfmon_bw_default_masters); j++)
+			if (strstr(pdata->bit_config_tab[i].name,
+				   perfmon_bw_default_masters[j]))
+				mask |= 1 << i;
+	return mask ? mask : (1 << pdata->bit_config_cnt) - 1;
+}
 
 static int __devinit mxs_perfmon_probe(struct platform_device *pdev)
 {
@@ -302,6 +625,17 @@ static int __devinit mxs_perfmon_probe(struct platform_device *pdev)
 	pd->base =  (unsigned int)ioremap(res->start, res->end - res->start);
 	pd->initial = false;
 
+	pd->bw = kcalloc(pdata->bit_config_cnt, sizeof(*pd->bw), GFP_KERNEL);
+	if (pd->bw == NULL) {
+		kfree(pd);
+		return -ENOMEM;
+	}
+	mutex_init(&pd->bw_mutex);
+	spin_lock_init(&pd->bw_lock);
+	INIT_DELAYED_WORK_DEFERRABLE(&pd->bw_work, perfmon_bw_work);
+	pd->bw_masters = perfmon_bw_default_mask(pdata);
+	pd->bw_sample_ms = PERFMON_BW_SAMPLE_MS;
+
 	platform_set_drvdata(pdev, pd);
 	pd->count = cnt;
 	attr = pd_attribute_ptr(pd);
@@ -329,13 +663,22 @@ static int __devinit mxs_perfmon_probe(struct platform_device *pdev)
 	}
 
 	err = sysfs_create_group(&pdev->dev.kobj, &pd->attr_group);
+	if (err != 0)
+		goto err_free;
+
+	err = sysfs_create_group(&pdev->dev.kobj, &perfmon_bw_attr_group);
 	if (err != 0) {
-		platform_set_drvdata(pdev, NULL);
-		kfree(pd);
-		return err;
+		sysfs_remove_group(&pdev->dev.kobj, &pd->attr_group);
+		goto err_free;
 	}
 
 	return 0;
+
+err_free:
+	platform_set_drvdata(pdev, NULL);
+	kfree(pd->bw);
+	kfree(pd);
+	return err;
 }
 
 static int __devexit mxs_perfmon_remove(struct platform_device *pdev)
@@ -343,8 +686,12 @@ static int __devexit mxs_perfmon_remove(struct platform_device *pdev)
 	struct mxs_perfmon_data *pd;
 
 	pd = platform_get_drvdata(pdev);
+	sysfs_remove_group(&pdev->dev.kobj, &perfmon_bw_attr_group);
+	if (pd->bw_enabled)
+		perfmon_bw_stop(pd);
 	sysfs_remove_group(&pdev->dev.kobj, &pd->attr_group);
 	platform_set_drvdata(pdev, NULL);
+	kfree(pd->bw);
 	kfree(pd);
 
 	return 0;
@@ -354,11 +701,26 @@ static int __devexit mxs_perfmon_remove(struct platform_device *pdev)
 static int
 mxs_perfmon_suspend(struct platform_device *pdev, pm_message_t state)
 {
+	struct mxs_perfmon_data *pd = platform_get_drvdata(pdev);
+
+	mutex_lock(&pd->bw_mutex);
+	if (pd->bw_enabled)
+		perfmon_bw_stop(pd);
+	mutex_unlock(&pd->bw_mutex);
 	return 0;
 }
 
 static int mxs_perfmon_resume(struct platform_device *pdev)
 {
+	struct mxs_perfmon_data *pd = platform_get_drvdata(pdev);
+
+	mutex_lock(&pd->bw_mutex);
+	if (pd->bw_enabled) {
+		/* the block may have lost its state */
+		pd->initial = false;
+		perfmon_bw_run(pd);
+	}
+	mutex_unlock(&pd->bw_mutex);
 	return 0;
 }
 #else
@@ -30,6 +30,8 @@
 
 #define PMEM_MAX_DEVICES 10
 #define PMEM_MAX_ORDER 128
+/* number of free lists, an index is an int so no block is larger */
+#define PMEM_NR_ORDERS BITS_PER_LONG
 #define PMEM_MIN_ALLOC PAGE_SIZE
 
 #define PMEM_DEBUG 1
@@ -117,6 +119,14 @@ struct pmem_info {
 	/* the bitmap for the region indicating which entries are allocated
 	 * and which are free */
 	struct pmem_bits *bitmap;
+	/* free blocks of each order, linked through free_link[] at the
+	 * index of the block's first entry */
+	struct list_head free_list[PMEM_NR_ORDERS];
+	struct list_head *free_link;
+	/* allocator counters, protected by bitmap_sem */
+	unsigned long nr_alloc;
+	unsigned long nr_free;
+	unsigned long nr_fail;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
 	/* indicates maps of this region should be cached, if a mix of
@@ -157,6 +167,7 @@ static int id_count;
 #define PMEM_ORDER(id, index) pmem[id].bitmap[index].order
 #define PMEM_BUDDY_INDEX(id, index) (index ^ (1 << PMEM_ORDER(id, index)))
 #define PMEM_NEXT_INDEX(id, index) (index + (1 << PMEM_ORDER(id, index)))
+#define PMEM_LINK_INDEX(id, link) ((int)((link) - pmem[id].free_link))
 #define PMEM_OFFSET(index) (index * PMEM_MIN_ALLOC)
 #define PMEM_START_ADDR(id, index) (PMEM_OFFSET(index) + pmem[id].base)
 #define PMEM_LEN(id, index) ((1 << PMEM_ORDER(id, index)) * PMEM_MIN_ALLOC)
@@ -233,6 +244,17 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+static void pmem_free_list_add(int id, int index)
+{
+	list_add(&pmem[id].free_link[index],
+		 &pmem[id].free_list[PMEM_ORDER(id, index)]);
+}
+
+static void pmem_free_list_del(int id, int index)
+{
+	list_del_init(&pmem[id].free_link[index]);
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
@@ -243,23 +265,28 @@ static int pmem_free(int id, int index)
 		pmem[id].allocated = 0;
 		return 0;
 	}
+	pmem[id].nr_free++;
 	/* clean up the bitmap, merging any buddies */
 	pmem[id].bitmap[curr].allocated = 0;
 	/* find a slots buddy Buddy# = Slot# ^ (1 << order)
 	 * if the buddy is also free merge them
-	 * repeat until the buddy is not free or end of the bitmap is reached
+	 * repeat until the buddy is not free or falls off the end of the
+	 * region (the tail of a region that isn't a power of two has no
+	 * buddy).  Blocks tile the region, so an index at the buddy
+	 * position is always the head of a block.
 	 */
-	do {
+	for (;;) {
 		buddy = PMEM_BUDDY_INDEX(id, curr);
-		if (PMEM_IS_FREE(id, buddy) &&
-				PMEM_ORDER(id, buddy) == PMEM_ORDER(id, curr)) {
-			PMEM_ORDER(id, buddy)++;
-			PMEM_ORDER(id, curr)++;
-			curr = min(buddy, curr);
-		} else {
+		if (buddy + (1 << PMEM_ORDER(id, curr)) > pmem[id].num_entries)
 			break;
-		}
-	} while (curr < pmem[id].num_entries);
+		if (!PMEM_IS_FREE(id, buddy) ||
+				PMEM_ORDER(id, buddy) != PMEM_ORDER(id, curr))
+			break;
+		pmem_free_list_del(id, buddy);
+		curr = min(buddy, curr);
+		PMEM_ORDER(id, curr)++;
+	}
+	pmem_free_list_add(id, curr);
 
 	return 0;
 }
@@ -383,10 +410,9 @@ static int pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
-	int curr = 0;
-	int end = pmem[id].num_entries;
 	int best_fit = -1;
 	unsigned long order = pmem_order(len);
+	unsigned long curr;
 
 	if (pmem[id].no_allocator) {
 		DLOG("no allocator");
@@ -396,36 +422,27 @@ static int pmem_allocate(int id, unsigned long len)
 		return len;
 	}
 
-	if (order > PMEM_MAX_ORDER)
-		return -1;
+	if (order > PMEM_MAX_ORDER || order >= PMEM_NR_ORDERS)
+		goto no_space;
 	DLOG("order %lx\n", order);
 
-	/* look through the bitmap:
-	 * if you find a free slot of the correct order use it
-	 * otherwise, use the best fit (smallest with size > order) slot
+	/* take a free slot of the correct order if there is one,
+	 * otherwise the best fit (smallest with size > order) slot
 	 */
-	while (curr < end) {
-		if (PMEM_IS_FREE(id, curr)) {
-			if (PMEM_ORDER(id, curr) == (unsigned char)order) {
-				/* set the not free bit and clear others */
-				best_fit = curr;
-				break;
-			}
-			if (PMEM_ORDER(id, curr) > (unsigned char)order &&
-			    (best_fit < 0 ||
-			     PMEM_ORDER(id, curr) < PMEM_ORDER(id, best_fit)))
-				best_fit = curr;
+	for (curr = order; curr < PMEM_NR_ORDERS; curr++) {
+		if (!list_empty(&pmem[id].free_list[curr])) {
+			best_fit = PMEM_LINK_INDEX(id,
+					pmem[id].free_list[curr].next);
+			break;
 		}
-		curr = PMEM_NEXT_INDEX(id, curr);
 	}
 
 	/* if best_fit < 0, there are no suitable slots,
 	 * return an error
 	 */
-	if (best_fit < 0) {
-		printk("pmem: no space left to allocate!\n");
-		return -1;
-	}
+	if (best_fit < 0)
+		goto no_space;
+	pmem_free_list_del(id, best_fit);
 
 	/* now partition the best fit:
 	 * split the slot into 2 buddies of order - 1
@@ -436,9 +453,17 @@ static int pmem_allocate(int id, unsigned long len)
 		PMEM_ORDER(id, best_fit) -= 1;
 		buddy = PMEM_BUDDY_INDEX(id, best_fit);
 		PMEM_ORDER(id, buddy) = PMEM_ORDER(id, best_fit);
+		pmem[id].bitmap[buddy].allocated = 0;
+		pmem_free_list_add(id, buddy);
 	}
 	pmem[id].bitmap[best_fit].allocated = 1;
+	pmem[id].nr_alloc++;
 	return best_fit;
+
+no_space:
+	pmem[id].nr_fail++;
+	printk("pmem: no space left to allocate!\n");
+	return -1;
 }
 
 static pgprot_t phys_mem_access_prot(struct file *file, pgprot_t vma_prot)
@@ -1222,6 +1247,47 @@ static struct file_operations debug_fops = {
 	.read = debug_read,
 	.open = debug_open,
 };
+
+static ssize_t debug_free_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	int id = (int)file->private_data;
+	const int debug_bufmax = 2048;
+	static char buffer[2048];
+	unsigned long blocks, free = 0, largest = 0;
+	struct list_head *elt;
+	int n = 0, order;
+
+	n = scnprintf(buffer, debug_bufmax, "order blocks\n");
+
+	down_read(&pmem[id].bitmap_sem);
+	for (order = 0; order < PMEM_NR_ORDERS; order++) {
+		blocks = 0;
+		list_for_each(elt, &pmem[id].free_list[order])
+			blocks++;
+		if (!blocks)
+			continue;
+		free += blocks << order;
+		largest = 1UL << order;
+		n += scnprintf(buffer + n, debug_bufmax - n, "%5d %lu\n",
+			       order, blocks);
+	}
+	n += scnprintf(buffer + n, debug_bufmax - n,
+		       "free %lu of %lu pages, largest block %lu pages\n"
+		       "fragmentation %lu%%\n"
+		       "allocs %lu frees %lu failed %lu\n",
+		       free, pmem[id].num_entries, largest,
+		       free ? 100 - largest * 100 / free : 0,
+		       pmem[id].nr_alloc, pmem[id].nr_free, pmem[id].nr_fail);
+	up_read(&pmem[id].bitmap_sem);
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, n);
+}
+
+static struct file_operations debug_free_fops = {
+	.read = debug_free_read,
+	.open = debug_open,
+};
 #endif
 
 int pmem_setup(struct android_pmem_platform_data *pdata,
@@ -1263,9 +1329,18 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	memset(pmem[id].bitmap, 0, sizeof(struct pmem_bits) *
 					  pmem[id].num_entries);
 
+	pmem[id].free_link = kmalloc(pmem[id].num_entries *
+				     sizeof(struct list_head), GFP_KERNEL);
+	if (!pmem[id].free_link)
+		goto err_no_mem_for_free_link;
+
+	for (i = 0; i < PMEM_NR_ORDERS; i++)
+		INIT_LIST_HEAD(&pmem[id].free_list[i]);
+
 	for (i = sizeof(pmem[id].num_entries) * 8 - 1; i >= 0; i--) {
 		if ((pmem[id].num_entries) &  1<<i) {
 			PMEM_ORDER(id, index) = i;
+			pmem_free_list_add(id, index);
 			index = PMEM_NEXT_INDEX(id, index);
 		}
 	}
@@ -1291,9 +1366,18 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 #if PMEM_DEBUG
 	debugfs_create_file(pdata->name, S_IFREG | S_IRUGO, NULL, (void *)id,
 			    &debug_fops);
+	if (!pmem[id].no_allocator) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "%s_free", pdata->name);
+		debugfs_create_file(name, S_IFREG | S_IRUGO, NULL, (void *)id,
+				    &debug_free_fops);
+	}
 #endif
 	return 0;
 error_cant_remap:
+	kfree(pmem[id].free_link);
+err_no_mem_for_free_link:
 	kfree(pmem[id].bitmap);
 err_no_mem_for_metadata:
 	misc_deregister(&pmem[id].dev);
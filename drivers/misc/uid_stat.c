@@ -16,38 +16,47 @@
 #include <asm/atomic.h>
 
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 
+#define UID_HASH_BITS	6
+
+/*
+ * Entries are never freed, so lookups walk the hash chains without taking
+ * uid_lock; it only serializes adding new uids.
+ */
 static DEFINE_SPINLOCK(uid_lock);
-static LIST_HEAD(uid_list);
+static struct hlist_head uid_hash[1 << UID_HASH_BITS];
 static struct proc_dir_entry *parent;
 
 struct uid_stat {
-	struct list_head link;
+	struct hlist_node link;
 	uid_t uid;
 	atomic_t tcp_rcv;
 	atomic_t tcp_snd;
 };
 
 static struct uid_stat *find_uid_stat(uid_t uid) {
-	unsigned long flags;
+	struct hlist_head *head = &uid_hash[hash_long(uid, UID_HASH_BITS)];
+	struct hlist_node *node;
 	struct uid_stat *entry;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(entry, &uid_list, link) {
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(entry, node, head, link) {
 		if (entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
+			rcu_read_unlock();
 			return entry;
 		}
 	}
-	spin_unlock_irqrestore(&uid_lock, flags);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -89,12 +98,11 @@ static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 
 /* Create a new entry for tracking the specified uid. */
 static struct uid_stat *create_stat(uid_t uid) {
-	unsigned long flags;
 	char uid_s[32];
-	struct uid_stat *new_uid;
+	struct uid_stat *new_uid, *old_uid;
 	struct proc_dir_entry *entry;
 
-	/* Create the uid stat struct and append it to the list. */
+	/* Create the uid stat struct and add it to the hash. */
 	if ((new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL)) == NULL)
 		return NULL;
 
@@ -103,9 +111,16 @@ static struct uid_stat *create_stat(uid_t uid) {
 	atomic_set(&new_uid->tcp_rcv, INT_MIN);
 	atomic_set(&new_uid->tcp_snd, INT_MIN);
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
-	spin_unlock_irqrestore(&uid_lock, flags);
+	spin_lock(&uid_lock);
+	/* another task of the same uid may have beaten us to it */
+	if ((old_uid = find_uid_stat(uid)) != NULL) {
+		spin_unlock(&uid_lock);
+		kfree(new_uid);
+		return old_uid;
+	}
+	hlist_add_head_rcu(&new_uid->link,
+			   &uid_hash[hash_long(uid, UID_HASH_BITS)]);
+	spin_unlock(&uid_lock);
 
 	sprintf(uid_s, "%d", uid);
 	entry = proc_mkdir(uid_s, parent);
@@ -147,6 +147,7 @@ static const struct block_device_operations mmc_bdops = {
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
+	struct mmc_command	sbc;
 	struct mmc_command	cmd;
 	struct mmc_command	stop;
 	struct mmc_data		data;
@@ -244,10 +245,114 @@ static u32 get_card_status(struct mmc_card *card, struct request *req)
 
 static int mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card);
 
+/*
+ * MMC cards take the block count up front with SET_BLOCK_COUNT, which
+ * saves the STOP_TRANSMISSION and its busy wait after every transfer.
+ */
+static inline int mmc_blk_use_cmd23(struct mmc_card *card)
+{
+	return mmc_card_mmc(card) && (card->host->caps & MMC_CAP_CMD23);
+}
+
+static inline int mmc_blk_rel_wr(struct mmc_card *card)
+{
+	return mmc_blk_use_cmd23(card) && card->ext_csd.rel_sectors;
+}
+
+/*
+ * Forced unit access writes go out as reliable writes.  Older cards only
+ * guarantee them for single blocks or whole, aligned granules of
+ * rel_sectors.
+ */
+static int mmc_blk_want_rel_wr(struct mmc_card *card, struct request *req,
+			       unsigned int blocks)
+{
+	unsigned int granule = card->ext_csd.rel_sectors;
+
+	if (rq_data_dir(req) != WRITE || !blk_fua_rq(req) ||
+	    !mmc_blk_rel_wr(card))
+		return 0;
+	if (card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN)
+		return 1;
+	return blocks == 1 ||
+		(blocks == granule && !(blk_rq_pos(req) % granule));
+}
+
+/*
+ * Called while the current request is on the bus: fetch the next one and
+ * do the CPU side of its setup (sg mapping, bounce copy, host DMA mapping
+ * and cache maintenance), so it can be started as soon as this one ends.
+ */
+static void mmc_blk_prep_next(void *arg)
+{
+	struct mmc_queue *mq = arg;
+	struct mmc_queue_req *mqrq = mq->mqrq_next;
+	struct mmc_host *host = mq->card->host;
+	struct request_queue *q = mq->queue;
+	struct request *req = NULL;
+
+	if (mqrq->req)
+		return;
+
+	spin_lock_irq(q->queue_lock);
+	if (!blk_queue_plugged(q))
+		req = blk_fetch_request(q);
+	mqrq->req = req;
+	spin_unlock_irq(q->queue_lock);
+
+	/*
+	 * Oversized requests are split up by mmc_blk_issue_rq(), discards
+	 * carry no data to set up.
+	 */
+	if (!req || !blk_fs_request(req) || blk_discard_rq(req) ||
+	    blk_rq_sectors(req) > host->max_blk_count)
+		return;
+
+	memset(&mqrq->mrq, 0, sizeof(struct mmc_request));
+	memset(&mqrq->data, 0, sizeof(struct mmc_data));
+	mqrq->mrq.data = &mqrq->data;
+	mqrq->data.blksz = 512;
+	mqrq->data.blocks = blk_rq_sectors(req);
+	mqrq->data.flags = rq_data_dir(req) == READ ?
+		MMC_DATA_READ : MMC_DATA_WRITE;
+	mqrq->data.sg = mqrq->sg;
+	mqrq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mmc_queue_bounce_pre(mqrq);
+	mmc_pre_req(host, &mqrq->mrq);
+	mqrq->prepared = 1;
+}
+
+/*
+ * Discards become TRIMs on cards that have them.  Otherwise only the
+ * whole erase groups in the range are erased; the queue's discard
+ * granularity tells the filesystem about them.
+ */
+static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned int arg;
+	int err;
+
+	arg = mmc_can_trim(card) ? MMC_TRIM_ARG : MMC_ERASE_ARG;
+
+	mmc_claim_host(card->host);
+	err = mmc_erase(card, blk_rq_pos(req), blk_rq_sectors(req), arg);
+	mmc_release_host(card->host);
+
+	spin_lock_irq(&md->lock);
+	__blk_end_request(req, err, blk_rq_bytes(req));
+	spin_unlock_irq(&md->lock);
+
+	return err ? 0 : 1;
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
 	struct mmc_blk_request brq;
 	int ret = 1, disable_multi = 0;
 
@@ -256,11 +361,15 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		mmc_blk_set_blksize(md, card);
 #endif
 
+	if (blk_discard_rq(req))
+		return mmc_blk_issue_discard_rq(mq, req);
+
 	mmc_claim_host(card->host);
 
 	do {
 		struct mmc_command cmd;
 		u32 readcmd, writecmd, status = 0;
+		int rel_wr;
 
 		memset(&brq, 0, sizeof(struct mmc_blk_request));
 		brq.mrq.cmd = &brq.cmd;
@@ -292,7 +401,9 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		if (disable_multi && brq.data.blocks > 1)
 			brq.data.blocks = 1;
 
-		if (brq.data.blocks > 1) {
+		rel_wr = mmc_blk_want_rel_wr(card, req, brq.data.blocks);
+
+		if (brq.data.blocks > 1 || rel_wr) {
 			/* SPI multiblock writes terminate using a special
 			 * token, not a STOP_TRANSMISSION request.
 			 */
@@ -315,10 +426,32 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			brq.data.flags |= MMC_DATA_WRITE;
 		}
 
+		/*
+		 * The host still sends the stop command if the transfer
+		 * fails, so leave brq.mrq.stop set.
+		 */
+		if (brq.mrq.stop && mmc_blk_use_cmd23(card)) {
+			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
+			brq.sbc.arg = brq.data.blocks;
+			if (rel_wr)
+				brq.sbc.arg |= MMC_CMD23_ARG_REL_WR;
+			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			brq.mrq.sbc = &brq.sbc;
+		}
+
 		mmc_set_data_timeout(&brq.data, card);
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+		brq.data.sg = mqrq->sg;
+		if (mqrq->prepared) {
+			mqrq->prepared = 0;
+			if (brq.data.blocks == mqrq->data.blocks) {
+				brq.data.sg_len = mqrq->data.sg_len;
+				brq.data.host_cookie = mqrq->data.host_cookie;
+				goto prepared;
+			}
+			mmc_post_req(card->host, &mqrq->mrq, -EINVAL);
+		}
+		brq.data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
 		/*
 		 * Adjust the sg list so it is the same size as the
@@ -339,18 +472,22 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			brq.data.sg_len = i;
 		}
 
-		mmc_queue_bounce_pre(mq);
-
-		mmc_wait_for_req(card->host, &brq.mrq);
+		mmc_queue_bounce_pre(mqrq);
+		mmc_pre_req(card->host, &brq.mrq);
+ prepared:
+		mmc_wait_for_req_prep(card->host, &brq.mrq, disable_multi ?
+				      NULL : mmc_blk_prep_next, mq);
+		mmc_post_req(card->host, &brq.mrq, brq.data.error);
 
-		mmc_queue_bounce_post(mq);
+		mmc_queue_bounce_post(mqrq);
 
 		/*
 		 * Check for errors here, but don't jump to cmd_err
 		 * until later as we need to wait for the card to leave
 		 * programming mode even when things go wrong.
 		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
+		if (brq.sbc.error || brq.cmd.error || brq.data.error ||
+		    brq.stop.error) {
 			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
 				/* Redo read one sector at a time */
 				printk(KERN_WARNING "%s: retrying using single "
@@ -361,6 +498,13 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			status = get_card_status(card, req);
 		}
 
+		if (brq.sbc.error) {
+			printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
+			       "command, response %#x, card status %#x\n",
+			       req->rq_disk->disk_name, brq.sbc.error,
+			       brq.sbc.resp[0], status);
+		}
+
 		if (brq.cmd.error) {
 			printk(KERN_ERR "%s: error %d sending read/write "
 			       "command, response %#x, card status %#x\n",
@@ -416,7 +560,8 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 #endif
 		}
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
+		if (brq.sbc.error || brq.cmd.error || brq.stop.error ||
+		    brq.data.error) {
 			if (rq_data_dir(req) == READ) {
 				/*
 				 * After an error, we redo I/O one sector at a
@@ -523,6 +668,18 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
 
+	/* Reliable writes let barriers skip the drain after the write */
+	if (mmc_blk_rel_wr(card))
+		blk_queue_ordered(md->queue.queue, QUEUE_ORDERED_DRAIN_FUA,
+				  NULL);
+
+	/*
+	 * Advertise the erase unit as the optimal I/O size so filesystems
+	 * can align allocations to it (ext4 "flash" mount option).
+	 */
+	if (card->erase_size)
+		blk_queue_io_opt(md->queue.queue, card->erase_size << 9);
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx << MMC_SHIFT;
 	md->disk->fops = &mmc_bdops;
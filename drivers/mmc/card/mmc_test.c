@@ -16,6 +16,10 @@
 #include <linux/slab.h>
 
 #include <linux/scatterlist.h>
+#include <linux/random.h>
+#include <linux/time.h>
+
+#include <asm/div64.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -25,6 +29,24 @@
 #define BUFFER_ORDER		2
 #define BUFFER_SIZE		(PAGE_SIZE << BUFFER_ORDER)
 
+struct mmc_test_pages {
+	struct page	*page;
+	unsigned int	order;
+};
+
+/*
+ * Memory and card sectors used by the performance tests
+ */
+struct mmc_test_area {
+	unsigned long		max_sz;		/* largest transfer, in bytes */
+	unsigned int		dev_addr;	/* first sector used */
+	unsigned int		max_segs;
+	unsigned int		cnt;		/* chunks in arr */
+	struct mmc_test_pages	*arr;
+	struct scatterlist	*sg;
+	u8			*bounce;
+};
+
 struct mmc_test_card {
 	struct mmc_card	*card;
 
@@ -33,6 +55,7 @@ struct mmc_test_card {
 #ifdef CONFIG_HIGHMEM
 	struct page	*highmem;
 #endif
+	struct mmc_test_area	area;
 };
 
 /*******************************************************************/
@@ -895,6 +918,435 @@ static int mmc_test_multi_read_high(struct mmc_test_card *test)
 
 #endif /* CONFIG_HIGHMEM */
 
+/*******************************************************************/
+/*  Performance tests                                              */
+/*******************************************************************/
+
+/*
+ * The performance tests run on an area of the card starting a quarter
+ * of the way in, so they leave the start of the card (and the sectors
+ * used by the tests above) alone.  Each measurement prints one line of
+ * "key=value" pairs so results from different cards and hosts can be
+ * collected from the kernel log and compared.
+ */
+#define MMC_TEST_AREA_MAX	(512 * 1024)
+#define MMC_TEST_SEQ_SZ		(4 * 1024 * 1024)
+#define MMC_TEST_RND_RANGE	(128 * 1024 * 1024)
+#define MMC_TEST_RND_COUNT	256
+#define MMC_TEST_BOUNCE_SZ	65536
+#define MMC_TEST_MAX_ORDER	4
+
+static unsigned int mmc_test_capacity(struct mmc_card *card)
+{
+	if (!mmc_card_sd(card) && mmc_card_blockaddr(card))
+		return card->ext_csd.sectors;
+	else
+		return card->csd.capacity << (card->csd.read_blkbits - 9);
+}
+
+static void mmc_test_area_free(struct mmc_test_area *t)
+{
+	while (t->cnt--)
+		__free_pages(t->arr[t->cnt].page, t->arr[t->cnt].order);
+	kfree(t->arr);
+	kfree(t->sg);
+	kfree(t->bounce);
+	memset(t, 0, sizeof(*t));
+}
+
+/*
+ * Map @sz bytes of the area into its scatterlist.  Segments are at most
+ * @seg_sz bytes and never cross a chunk; the first one starts @offset
+ * bytes into the area, which lets a test build lists whose segments are
+ * not page aligned.
+ */
+static int mmc_test_area_map(struct mmc_test_card *test, unsigned long sz,
+	unsigned int seg_sz, unsigned int offset, unsigned int *sg_len)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	struct scatterlist *sg = NULL;
+	unsigned long chunk, len;
+	unsigned int i = 0, pos = offset, n = 0;
+
+	seg_sz = min(seg_sz, host->max_seg_size);
+
+	sg_init_table(t->sg, t->max_segs);
+	while (sz) {
+		if (i >= t->cnt)
+			return -ENOMEM;
+		chunk = PAGE_SIZE << t->arr[i].order;
+		if (pos >= chunk) {
+			pos -= chunk;
+			i++;
+			continue;
+		}
+		if (n >= t->max_segs)
+			return -E2BIG;
+
+		len = min(sz, (unsigned long)seg_sz);
+		len = min(len, chunk - pos);
+
+		sg = sg ? sg_next(sg) : t->sg;
+		sg_set_page(sg, t->arr[i].page, len, pos);
+		n++;
+
+		pos += len;
+		sz -= len;
+	}
+	sg_mark_end(sg);
+
+	*sg_len = n;
+	return 0;
+}
+
+static int mmc_test_area_init(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	unsigned long total = 0, max_sz;
+	unsigned int order, sg_len, capacity;
+	int ret;
+
+	max_sz = min_t(unsigned long, host->max_req_size, MMC_TEST_AREA_MAX);
+	max_sz = min_t(unsigned long, max_sz, host->max_blk_count * 512);
+	max_sz = min_t(unsigned long, max_sz,
+		(unsigned long)host->max_hw_segs * host->max_seg_size);
+	max_sz &= ~511UL;
+	if (max_sz < 512)
+		return RESULT_UNSUP_HOST;
+
+	capacity = mmc_test_capacity(test->card);
+	if (capacity / 4 < MMC_TEST_SEQ_SZ >> 9)
+		return RESULT_UNSUP_CARD;
+
+	t->max_segs = min(host->max_hw_segs, host->max_phys_segs);
+	t->sg = kmalloc(t->max_segs * sizeof(*t->sg), GFP_KERNEL);
+	/* room for max_sz plus the offset used by the layout tests */
+	t->arr = kzalloc((max_sz / PAGE_SIZE + 2) * sizeof(*t->arr),
+		GFP_KERNEL);
+	t->bounce = kmalloc(min_t(unsigned long, max_sz, MMC_TEST_BOUNCE_SZ),
+		GFP_KERNEL);
+	if (!t->sg || !t->arr || !t->bounce)
+		goto out_nomem;
+
+	order = min(get_order(max_sz), get_order(host->max_seg_size));
+	order = min(order, (unsigned int)MMC_TEST_MAX_ORDER);
+	while (total < max_sz + PAGE_SIZE) {
+		struct page *page;
+
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+			order);
+		if (!page) {
+			if (!order)
+				goto out_nomem;
+			order--;
+			continue;
+		}
+		t->arr[t->cnt].page = page;
+		t->arr[t->cnt].order = order;
+		t->cnt++;
+		total += PAGE_SIZE << order;
+	}
+
+	/* Shrink to what the host takes in one request from these chunks */
+	while (mmc_test_area_map(test, max_sz, host->max_seg_size, 0,
+			&sg_len)) {
+		max_sz = (max_sz / 2) & ~511UL;
+		if (max_sz < 512) {
+			mmc_test_area_free(t);
+			return RESULT_UNSUP_HOST;
+		}
+	}
+	t->max_sz = max_sz;
+
+	t->dev_addr = capacity / 4;
+	t->dev_addr -= t->dev_addr % (max_sz >> 9);
+
+	ret = mmc_test_set_blksize(test, 512);
+	if (ret) {
+		mmc_test_area_free(t);
+		return ret;
+	}
+
+	printk(KERN_INFO "%s: perf area dev_addr=%u max_sz=%lu "
+		"max_seg_sz=%u max_segs=%u chunks=%u\n",
+		mmc_hostname(host), t->dev_addr, t->max_sz,
+		host->max_seg_size, t->max_segs, t->cnt);
+
+	return 0;
+
+out_nomem:
+	mmc_test_area_free(t);
+	return -ENOMEM;
+}
+
+static int mmc_test_area_cleanup(struct mmc_test_card *test)
+{
+	mmc_test_area_free(&test->area);
+
+	return 0;
+}
+
+/*
+ * Bytes (or anything else) per second over the time in @ts
+ */
+static unsigned int mmc_test_rate(u64 bytes, struct timespec *ts)
+{
+	u64 ns;
+
+	ns = ts->tv_sec;
+	ns *= NSEC_PER_SEC;
+	ns += ts->tv_nsec;
+
+	bytes *= NSEC_PER_SEC;
+
+	while (ns > UINT_MAX) {
+		bytes >>= 1;
+		ns >>= 1;
+	}
+
+	if (!ns)
+		return 0;
+
+	do_div(bytes, (u32)ns);
+
+	return bytes;
+}
+
+static void mmc_test_print_rate(struct mmc_test_card *test, const char *tag,
+	unsigned long sz, unsigned int sg_len, unsigned int count,
+	struct timespec *ts1, struct timespec *ts2)
+{
+	struct timespec ts = timespec_sub(*ts2, *ts1);
+	unsigned int rate, iops;
+
+	rate = mmc_test_rate((u64)sz * count, &ts);
+	iops = mmc_test_rate((u64)count * 100, &ts);
+
+	printk(KERN_INFO "%s: perf %s sz=%lu segs=%u count=%u "
+		"time=%lu.%09lu kibps=%u iops=%u.%02u\n",
+		mmc_hostname(test->card->host), tag, sz, sg_len, count,
+		(unsigned long)ts.tv_sec, (unsigned long)ts.tv_nsec,
+		rate / 1024, iops / 100, iops % 100);
+}
+
+/*
+ * Transfer @sz bytes of the area @count times, either through
+ * consecutive sectors from the start of the area or through random
+ * @sz aligned ones in the MMC_TEST_RND_RANGE above it.
+ */
+static int mmc_test_area_run(struct mmc_test_card *test, const char *tag,
+	unsigned long sz, unsigned int seg_sz, unsigned int offset,
+	unsigned int count, int random, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	struct timespec ts1, ts2;
+	unsigned int i, sg_len, dev_addr, range;
+	int ret;
+
+	ret = mmc_test_area_map(test, sz, seg_sz, offset, &sg_len);
+	if (ret)
+		return RESULT_UNSUP_HOST;
+
+	range = min(mmc_test_capacity(test->card) / 2,
+		(unsigned int)(MMC_TEST_RND_RANGE >> 9)) / (sz >> 9);
+
+	getnstimeofday(&ts1);
+	for (i = 0; i < count; i++) {
+		if (random)
+			dev_addr = t->dev_addr + (random32() % range) * (sz >> 9);
+		else
+			dev_addr = t->dev_addr + i * (sz >> 9);
+		ret = mmc_test_simple_transfer(test, t->sg, sg_len, dev_addr,
+			sz >> 9, 512, write);
+		if (ret)
+			return ret;
+	}
+	getnstimeofday(&ts2);
+
+	mmc_test_print_rate(test, tag, sz, sg_len, count, &ts1, &ts2);
+
+	return 0;
+}
+
+/*
+ * Sequential transfers of MMC_TEST_SEQ_SZ worth of sectors, at every
+ * power of two transfer size up to the largest request the host takes.
+ */
+static int mmc_test_seq_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	const char *tag = write ? "seqwr" : "seqrd";
+	unsigned long sz;
+	int ret;
+
+	for (sz = 512; sz < t->max_sz; sz <<= 1) {
+		ret = mmc_test_area_run(test, tag, sz,
+			test->card->host->max_seg_size, 0,
+			MMC_TEST_SEQ_SZ / sz, 0, write);
+		if (ret)
+			return ret;
+	}
+
+	return mmc_test_area_run(test, tag, t->max_sz,
+		test->card->host->max_seg_size, 0,
+		MMC_TEST_SEQ_SZ / t->max_sz, 0, write);
+}
+
+static int mmc_test_seq_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_perf(test, 0);
+}
+
+static int mmc_test_seq_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_seq_perf(test, 1);
+}
+
+/*
+ * The same transfer size described by one segment, by a list of page
+ * sized segments, and by a list of page sized segments that are not
+ * page aligned.  On mx_sdhci these take the single DMA, the ADMA and
+ * the PIO paths respectively.
+ */
+static int mmc_test_sg_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	struct mmc_host *host = test->card->host;
+	const char *tag = write ? "sgwr" : "sgrd";
+	unsigned long sz;
+	unsigned int count;
+	int ret;
+
+	sz = min_t(unsigned long, t->max_sz, host->max_seg_size);
+	sz = min_t(unsigned long, sz, (t->max_segs - 1) * PAGE_SIZE);
+	sz &= PAGE_MASK;
+	if (!sz)
+		return RESULT_UNSUP_HOST;
+	count = MMC_TEST_SEQ_SZ / sz;
+
+	ret = mmc_test_area_run(test, tag, sz, sz, 0, count, 0, write);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_area_run(test, tag, sz, PAGE_SIZE, 0, count, 0, write);
+	if (ret)
+		return ret;
+
+	ret = mmc_test_area_run(test, tag, sz, PAGE_SIZE, 512, count, 0, write);
+	if (ret)
+		return ret;
+
+	/* and the largest request, in as few segments as the host allows */
+	return mmc_test_area_run(test, tag, t->max_sz, host->max_seg_size, 0,
+		MMC_TEST_SEQ_SZ / t->max_sz, 0, write);
+}
+
+static int mmc_test_sg_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_sg_perf(test, 0);
+}
+
+static int mmc_test_sg_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_sg_perf(test, 1);
+}
+
+/*
+ * Random transfers of the sizes a filesystem issues most, for IOPS
+ */
+static int mmc_test_rnd_perf(struct mmc_test_card *test, int write)
+{
+	static const unsigned int sizes[] = { 512, 4096, 16384, 65536 };
+	const char *tag = write ? "rndwr" : "rndrd";
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		if (sizes[i] > test->area.max_sz)
+			break;
+		ret = mmc_test_area_run(test, tag, sizes[i],
+			test->card->host->max_seg_size, 0,
+			MMC_TEST_RND_COUNT, 1, write);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int mmc_test_rnd_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_perf(test, 0);
+}
+
+static int mmc_test_rnd_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_perf(test, 1);
+}
+
+/*
+ * Sequential transfers copied through one linear buffer the way the
+ * block driver bounces requests it can't map for the host
+ * (MMC_BLOCK_BOUNCE).  Compare with the "seqrd"/"seqwr" lines of the
+ * same size for the cost of the copy and of the single segment.
+ */
+static int mmc_test_bounce_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_test_area *t = &test->area;
+	const char *tag = write ? "bncwr" : "bncrd";
+	struct timespec ts1, ts2;
+	struct scatterlist sg;
+	unsigned long sz, max_sz, flags;
+	unsigned int i, count, sg_len, dev_addr;
+	int ret;
+
+	max_sz = min_t(unsigned long, t->max_sz, MMC_TEST_BOUNCE_SZ);
+
+	for (sz = 512; sz <= max_sz; sz <<= 1) {
+		ret = mmc_test_area_map(test, sz, PAGE_SIZE, 0, &sg_len);
+		if (ret)
+			return RESULT_UNSUP_HOST;
+		sg_init_one(&sg, t->bounce, sz);
+		count = MMC_TEST_SEQ_SZ / sz;
+
+		getnstimeofday(&ts1);
+		for (i = 0; i < count; i++) {
+			dev_addr = t->dev_addr + i * (sz >> 9);
+			if (write) {
+				local_irq_save(flags);
+				sg_copy_to_buffer(t->sg, sg_len, t->bounce, sz);
+				local_irq_restore(flags);
+			}
+			ret = mmc_test_simple_transfer(test, &sg, 1, dev_addr,
+				sz >> 9, 512, write);
+			if (ret)
+				return ret;
+			if (!write) {
+				local_irq_save(flags);
+				sg_copy_from_buffer(t->sg, sg_len, t->bounce,
+					sz);
+				local_irq_restore(flags);
+			}
+		}
+		getnstimeofday(&ts2);
+
+		mmc_test_print_rate(test, tag, sz, sg_len, count, &ts1, &ts2);
+	}
+
+	return 0;
+}
+
+static int mmc_test_bounce_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_bounce_perf(test, 0);
+}
+
+static int mmc_test_bounce_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_bounce_perf(test, 1);
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -1042,6 +1494,62 @@ static const struct mmc_test_case mmc_test_cases[] = {
 
 #endif /* CONFIG_HIGHMEM */
 
+	{
+		.name = "Sequential read performance by transfer size",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_seq_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential write performance by transfer size",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_seq_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Read performance by scatterlist layout",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_sg_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Write performance by scatterlist layout",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_sg_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_rnd_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_rnd_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Bounced read performance",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_bounce_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Bounced write performance",
+		.prepare = mmc_test_area_init,
+		.run = mmc_test_bounce_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -29,6 +29,9 @@
 #include <linux/mmc/mmc.h>
 #include <linux/mmc/sd.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/mmc.h>
+
 #include "core.h"
 #include "bus.h"
 #include "host.h"
@@ -38,6 +41,13 @@
 #include "sd_ops.h"
 #include "sdio_ops.h"
 
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_cmd_issue);
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_cmd_done);
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_data_start);
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_data_done);
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_dma_done);
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_finish_work);
+
 static struct workqueue_struct *workqueue;
 static struct wake_lock mmc_delayed_work_wake_lock;
 
@@ -109,6 +119,12 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 		cmd->error = 0;
 		host->ops->request(host, mrq);
 	} else {
+		s64 usecs = ktime_us_delta(ktime_get(), mrq->start);
+
+		usecs = clamp_t(s64, usecs, 0, (u32)~0);
+		trace_mmc_request_done(host, mrq, usecs);
+		mmc_latency_record(host, mrq, usecs);
+
 		led_trigger_event(host->led, LED_OFF);
 
 		pr_debug("%s: req done (CMD%u): %d: %08x %08x %08x %08x\n",
@@ -145,6 +161,12 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	struct scatterlist *sg;
 #endif
 
+	if (mrq->sbc) {
+		pr_debug("<%s: starting CMD%u arg %08x flags %08x>\n",
+			 mmc_hostname(host), mrq->sbc->opcode,
+			 mrq->sbc->arg, mrq->sbc->flags);
+	}
+
 	pr_debug("%s: starting CMD%u arg %08x flags %08x\n",
 		 mmc_hostname(host), mrq->cmd->opcode,
 		 mrq->cmd->arg, mrq->cmd->flags);
@@ -168,8 +190,16 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 
 	led_trigger_event(host->led, LED_FULL);
 
+	mrq->start = ktime_get();
+	trace_mmc_request_start(host, mrq);
+
 	mrq->cmd->error = 0;
 	mrq->cmd->mrq = mrq;
+	if (mrq->sbc) {
+		WARN_ON(!(host->caps & MMC_CAP_CMD23));
+		mrq->sbc->error = 0;
+		mrq->sbc->mrq = mrq;
+	}
 	if (mrq->data) {
 		BUG_ON(mrq->data->blksz > host->max_blk_size);
 		BUG_ON(mrq->data->blocks > host->max_blk_count);
@@ -223,6 +253,64 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 
 EXPORT_SYMBOL(mmc_wait_for_req);
 
+/**
+ *	mmc_wait_for_req_prep - start a request, do other work, then wait
+ *	@host: MMC host to start command
+ *	@mrq: MMC request to start
+ *	@prep: called while @mrq is being carried out
+ *	@arg: argument for @prep
+ *
+ *	Like mmc_wait_for_req(), but lets the caller get its next request
+ *	ready while the host is busy with this one.
+ */
+void mmc_wait_for_req_prep(struct mmc_host *host, struct mmc_request *mrq,
+			   void (*prep)(void *), void *arg)
+{
+	DECLARE_COMPLETION_ONSTACK(complete);
+
+	mrq->done_data = &complete;
+	mrq->done = mmc_wait_done;
+
+	mmc_start_request(host, mrq);
+
+	if (prep)
+		prep(arg);
+
+	wait_for_completion(&complete);
+}
+
+EXPORT_SYMBOL(mmc_wait_for_req_prep);
+
+/**
+ *	mmc_pre_req - let the host map a request ahead of time
+ *	@host: MMC host the request will be started on
+ *	@mrq: MMC request, with its data set up
+ *
+ *	Hosts that support it set mrq->data->host_cookie, and
+ *	mmc_post_req() must then be called for @mrq in every case.
+ */
+void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq);
+}
+
+EXPORT_SYMBOL(mmc_pre_req);
+
+/**
+ *	mmc_post_req - undo mmc_pre_req
+ *	@host: MMC host the request was prepared for
+ *	@mrq: MMC request
+ *	@err: error of the request, or -EINVAL if it was never started
+ */
+void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq, int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+EXPORT_SYMBOL(mmc_post_req);
+
 /**
  *	mmc_wait_for_cmd - start a command and wait for completion
  *	@host: MMC host to start command
@@ -362,6 +450,191 @@ unsigned int mmc_align_data_size(struct mmc_card *card, unsigned int sz)
 }
 EXPORT_SYMBOL(mmc_align_data_size);
 
+/*
+ * Time the card may take for an erase or trim of @qty erase groups.
+ * Cards without ERASE_GROUP_DEF don't give one; 300ms per group (250ms
+ * for SD) is what the specifications allow for a legacy erase group or
+ * allocation unit.
+ */
+static unsigned int mmc_erase_timeout(struct mmc_card *card,
+				      unsigned int arg, unsigned int qty)
+{
+	unsigned int ms;
+
+	if (mmc_card_sd(card))
+		ms = 250;
+	else if (arg == MMC_TRIM_ARG && card->ext_csd.trim_timeout)
+		ms = card->ext_csd.trim_timeout;
+	else if (card->ext_csd.erase_group_def &&
+		 card->ext_csd.hc_erase_timeout)
+		ms = card->ext_csd.hc_erase_timeout;
+	else
+		ms = 300;
+
+	return max(ms * qty, 1000u);
+}
+
+static void mmc_erase_account(struct mmc_card *card, unsigned int sectors,
+			      ktime_t start, int err)
+{
+	struct mmc_erase_stats *st = &card->erase_stats;
+	u32 us = min_t(s64, ktime_us_delta(ktime_get(), start), UINT_MAX);
+
+	spin_lock(&st->lock);
+	if (err) {
+		st->errors++;
+	} else {
+		st->count++;
+		st->sectors += sectors;
+		st->total_us += us;
+		if (us > st->max_us)
+			st->max_us = us;
+	}
+	spin_unlock(&st->lock);
+}
+
+static int mmc_do_erase(struct mmc_card *card, unsigned int from,
+			unsigned int to, unsigned int arg, unsigned int qty)
+{
+	struct mmc_command cmd;
+	unsigned long timeout;
+	int err, polls = 0;
+
+	if (!mmc_card_blockaddr(card)) {
+		from <<= 9;
+		to <<= 9;
+	}
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = mmc_card_sd(card) ? SD_ERASE_WR_BLK_START :
+					 MMC_ERASE_GROUP_START;
+	cmd.arg = from;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		goto out;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = mmc_card_sd(card) ? SD_ERASE_WR_BLK_END :
+					 MMC_ERASE_GROUP_END;
+	cmd.arg = to;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		goto out;
+
+	/*
+	 * The busy period can last far longer than hosts wait for an R1b
+	 * response, so take it as R1 and poll the card status instead.
+	 */
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_ERASE;
+	cmd.arg = arg;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		goto out;
+
+	if (mmc_host_is_spi(card->host))
+		goto out;
+
+	timeout = jiffies +
+		msecs_to_jiffies(mmc_erase_timeout(card, arg, qty));
+	do {
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		err = mmc_wait_for_cmd(card->host, &cmd, 0);
+		if (err || (cmd.resp[0] & 0xFDF92000)) {
+			printk(KERN_ERR "%s: error %d requesting status %#x\n",
+			       mmc_hostname(card->host), err, cmd.resp[0]);
+			err = -EIO;
+			goto out;
+		}
+		if ((cmd.resp[0] & R1_READY_FOR_DATA) &&
+		    R1_CURRENT_STATE(cmd.resp[0]) != 7)
+			break;
+		if (time_after(jiffies, timeout)) {
+			printk(KERN_ERR "%s: erase of %u groups timed out\n",
+			       mmc_hostname(card->host), qty);
+			err = -ETIMEDOUT;
+			goto out;
+		}
+		/* short trims are usually done within a few polls */
+		if (++polls > 20)
+			msleep(1);
+	} while (1);
+
+out:
+	if (err)
+		printk(KERN_ERR "%s: erase of sectors %u-%u failed: %d\n",
+		       mmc_hostname(card->host), from, to, err);
+	return err;
+}
+
+/**
+ *	mmc_erase - erase or trim a range of sectors
+ *	@card: card to erase
+ *	@from: first sector
+ *	@nr: number of sectors
+ *	@arg: MMC_ERASE_ARG or MMC_TRIM_ARG
+ *
+ *	Erases only the whole erase groups within the range; MMC_TRIM_ARG,
+ *	when mmc_can_trim(), works on single sectors.  The caller must
+ *	have claimed the host.
+ */
+int mmc_erase(struct mmc_card *card, unsigned int from, unsigned int nr,
+	      unsigned int arg)
+{
+	unsigned int rem, to, qty;
+	ktime_t start = ktime_get();
+	int err;
+
+	if (!mmc_can_erase(card) || (arg == MMC_TRIM_ARG && !mmc_can_trim(card)))
+		return -EOPNOTSUPP;
+	if (!nr)
+		return 0;
+	if (from + nr < from)
+		return -EINVAL;
+
+	if (arg == MMC_ERASE_ARG) {
+		rem = from % card->erase_size;
+		if (rem) {
+			rem = card->erase_size - rem;
+			if (nr <= rem)
+				return 0;
+			from += rem;
+			nr -= rem;
+		}
+		nr -= nr % card->erase_size;
+		if (!nr)
+			return 0;
+	}
+
+	to = from + nr - 1;
+	qty = to / card->erase_size - from / card->erase_size + 1;
+
+	err = mmc_do_erase(card, from, to, arg, qty);
+	mmc_erase_account(card, nr, start, err);
+	return err;
+}
+EXPORT_SYMBOL(mmc_erase);
+
+int mmc_can_erase(struct mmc_card *card)
+{
+	return card->erase_size && (card->csd.cmdclass & CCC_ERASE) &&
+		(mmc_card_mmc(card) || mmc_card_sd(card));
+}
+EXPORT_SYMBOL(mmc_can_erase);
+
+int mmc_can_trim(struct mmc_card *card)
+{
+	return mmc_card_mmc(card) &&
+		(card->ext_csd.sec_feature_support & EXT_CSD_SEC_GB_CL_EN);
+}
+EXPORT_SYMBOL(mmc_can_trim);
+
 /**
  *	mmc_host_enable - enable a host.
  *	@host: mmc host to enable
@@ -65,5 +65,15 @@ void mmc_remove_host_debugfs(struct mmc_host *host);
 void mmc_add_card_debugfs(struct mmc_card *card);
 void mmc_remove_card_debugfs(struct mmc_card *card);
 
+#ifdef CONFIG_DEBUG_FS
+void mmc_latency_record(struct mmc_host *host, struct mmc_request *mrq,
+			u32 usecs);
+#else
+static inline void mmc_latency_record(struct mmc_host *host,
+				      struct mmc_request *mrq, u32 usecs)
+{
+}
+#endif
+
 #endif
 
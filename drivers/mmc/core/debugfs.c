@@ -9,9 +9,11 @@
  */
 #include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/log2.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
+#include <linux/uaccess.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -134,10 +136,127 @@ static const struct file_operations mmc_ios_fops = {
 	.release	= single_release,
 };
 
+/**
+ *	mmc_latency_record - account a completed request
+ *	@host: host the request ran on
+ *	@mrq: the request
+ *	@usecs: time since it was started
+ *
+ *	Called from mmc_request_done(), so possibly in interrupt context.
+ */
+void mmc_latency_record(struct mmc_host *host, struct mmc_request *mrq,
+			u32 usecs)
+{
+	struct mmc_latency_hist *lat = &host->latency;
+	unsigned int dir = 0, size = 0, bucket, bytes;
+	unsigned long flags;
+
+	if (mrq->data) {
+		dir = mrq->data->flags & MMC_DATA_WRITE ? 2 : 1;
+		bytes = mrq->data->blocks * mrq->data->blksz;
+		if (bytes > 128 * 1024)
+			size = 3;
+		else if (bytes > 32 * 1024)
+			size = 2;
+		else if (bytes > 4 * 1024)
+			size = 1;
+	}
+
+	bucket = usecs < 32 ? 0 : ilog2(usecs) - 4;
+	if (bucket >= MMC_LAT_BUCKETS)
+		bucket = MMC_LAT_BUCKETS - 1;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->count[dir][size][bucket]++;
+	lat->total_us[dir][size] += usecs;
+	if (usecs > lat->max_us[dir][size])
+		lat->max_us[dir][size] = usecs;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+static int mmc_latency_show(struct seq_file *s, void *data)
+{
+	static const char *dir_str[MMC_LAT_DIRS] = { "cmd", "read", "write" };
+	static const char *size_str[MMC_LAT_SIZES] = {
+		"<=4K", "<=32K", "<=128K", ">128K"
+	};
+	struct mmc_host *host = s->private;
+	struct mmc_latency_hist *lat;
+	unsigned int d, z, b;
+	u32 n;
+
+	lat = kmalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+
+	spin_lock_irq(&host->latency.lock);
+	memcpy(lat, &host->latency, sizeof(*lat));
+	spin_unlock_irq(&host->latency.lock);
+
+	seq_printf(s, "%-6s %-7s %8s %8s %8s", "dir", "size", "count",
+		   "avg_us", "max_us");
+	for (b = 0; b < MMC_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " %7u", 32u << b);
+	seq_printf(s, " %7s\n", "more");
+
+	for (d = 0; d < MMC_LAT_DIRS; d++) {
+		for (z = 0; z < MMC_LAT_SIZES; z++) {
+			/* Commands without data have no size */
+			if (d == 0 && z)
+				break;
+			n = 0;
+			for (b = 0; b < MMC_LAT_BUCKETS; b++)
+				n += lat->count[d][z][b];
+			seq_printf(s, "%-6s %-7s %8u %8llu %8u", dir_str[d],
+				   d ? size_str[z] : "-", n,
+				   n ? (unsigned long long)
+				   div_u64(lat->total_us[d][z], n) : 0ULL,
+				   lat->max_us[d][z]);
+			for (b = 0; b < MMC_LAT_BUCKETS; b++)
+				seq_printf(s, " %7u", lat->count[d][z][b]);
+			seq_printf(s, "\n");
+		}
+	}
+
+	kfree(lat);
+	return 0;
+}
+
+static int mmc_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_latency_show, inode->i_private);
+}
+
+/* Any write clears the histogram */
+static ssize_t mmc_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct mmc_host *host =
+		((struct seq_file *)file->private_data)->private;
+	struct mmc_latency_hist *lat = &host->latency;
+
+	spin_lock_irq(&lat->lock);
+	memset(lat->count, 0, sizeof(lat->count));
+	memset(lat->total_us, 0, sizeof(lat->total_us));
+	memset(lat->max_us, 0, sizeof(lat->max_us));
+	spin_unlock_irq(&lat->lock);
+	return count;
+}
+
+static const struct file_operations mmc_latency_fops = {
+	.open		= mmc_latency_open,
+	.read		= seq_read,
+	.write		= mmc_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
 
+	spin_lock_init(&host->latency.lock);
+
 	root = debugfs_create_dir(mmc_hostname(host), NULL);
 	if (IS_ERR(root))
 		/* Don't complain -- debugfs just isn't enabled */
@@ -152,6 +271,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 	if (!debugfs_create_file("ios", S_IRUSR, root, host, &mmc_ios_fops))
 		goto err_ios;
 
+	if (!debugfs_create_file("latency", S_IRUSR | S_IWUSR, root, host,
+				 &mmc_latency_fops))
+		goto err_ios;
+
 	return;
 
 err_ios:
@@ -247,6 +370,56 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.release	= mmc_ext_csd_release,
 };
 
+static int mmc_erase_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_erase_stats st;
+
+	spin_lock(&card->erase_stats.lock);
+	st = card->erase_stats;
+	spin_unlock(&card->erase_stats.lock);
+
+	seq_printf(s, "mode %s\n", mmc_can_trim(card) ? "trim" :
+		   mmc_can_erase(card) ? "erase" : "none");
+	seq_printf(s, "erase_size %u\n", card->erase_size);
+	seq_printf(s, "count %u\n", st.count);
+	seq_printf(s, "errors %u\n", st.errors);
+	seq_printf(s, "sectors %llu\n", st.sectors);
+	seq_printf(s, "total_us %llu\n", st.total_us);
+	seq_printf(s, "avg_us %llu\n",
+		   st.count ? div_u64(st.total_us, st.count) : 0ULL);
+	seq_printf(s, "max_us %u\n", st.max_us);
+	return 0;
+}
+
+static int mmc_erase_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_erase_stats_show, inode->i_private);
+}
+
+/* Any write clears the statistics */
+static ssize_t mmc_erase_stats_write(struct file *file, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct mmc_card *card =
+		((struct seq_file *)file->private_data)->private;
+	struct mmc_erase_stats *st = &card->erase_stats;
+
+	spin_lock(&st->lock);
+	st->count = st->errors = st->max_us = 0;
+	st->sectors = st->total_us = 0;
+	spin_unlock(&st->lock);
+	return count;
+}
+
+static const struct file_operations mmc_dbg_erase_stats_fops = {
+	.open		= mmc_erase_stats_open,
+	.read		= seq_read,
+	.write		= mmc_erase_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -279,6 +452,11 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) || mmc_card_sd(card))
+		if (!debugfs_create_file("erase_stats", S_IRUSR | S_IWUSR,
+					root, card, &mmc_dbg_erase_stats_fops))
+			goto err;
+
 	return;
 
 err:
@@ -151,6 +151,15 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	/* Erase group, in write blocks */
+	if (csd->write_blkbits >= 9) {
+		unsigned int a, b;
+
+		a = UNSTUFF_BITS(resp, 42, 5);
+		b = UNSTUFF_BITS(resp, 37, 5);
+		csd->erase_size = (a + 1) * (b + 1) << (csd->write_blkbits - 9);
+	}
+
 	return 0;
 }
 
@@ -258,8 +267,27 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 		if (sa_shift > 0 && sa_shift <= 0x17)
 			card->ext_csd.sa_timeout =
 					1 << ext_csd[EXT_CSD_S_A_TIMEOUT];
+
+		card->ext_csd.rel_sectors = ext_csd[EXT_CSD_REL_WR_SEC_C];
+
+		/* High capacity erase unit size, 512KB units */
+		card->ext_csd.hc_erase_size =
+			ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+		/* Erase and trim timeouts, 300ms units */
+		card->ext_csd.hc_erase_timeout = 300 *
+			ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT];
+		card->ext_csd.erase_group_def = ext_csd[EXT_CSD_ERASE_GROUP_DEF];
 	}
 
+	if (card->ext_csd.rev >= 4) {
+		card->ext_csd.sec_feature_support =
+			ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT];
+		card->ext_csd.trim_timeout = 300 * ext_csd[EXT_CSD_TRIM_MULT];
+	}
+
+	if (card->ext_csd.rev >= 5)
+		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
+
 out:
 	kfree(ext_csd);
 
@@ -804,6 +832,31 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		err = mmc_read_ext_csd(card);
 		if (err)
 			goto free_card;
+
+		/*
+		 * Block addressed cards erase in high capacity groups; the
+		 * legacy CSD erase group is only meaningful below 2GB.
+		 * ERASE_GROUP_DEF makes the card use them for erase commands
+		 * too; it does not survive a power cycle, so it is set on
+		 * every initialization below.
+		 */
+		if (mmc_card_blockaddr(card) && card->ext_csd.hc_erase_size)
+			card->erase_size = card->ext_csd.hc_erase_size;
+		else
+			card->erase_size = card->csd.erase_size;
+	}
+
+	if (card->erase_size && card->erase_size == card->ext_csd.hc_erase_size) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_ERASE_GROUP_DEF, 1);
+		if (err) {
+			printk(KERN_WARNING "%s: failed to select high "
+			       "capacity erase groups\n", mmc_hostname(host));
+			card->erase_size = card->csd.erase_size;
+			err = 0;
+		} else {
+			card->ext_csd.erase_group_def = 1;
+		}
 	}
 
 	/*
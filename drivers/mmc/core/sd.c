@@ -119,6 +119,10 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = UNSTUFF_BITS(resp, 26, 3);
 		csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 		csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
+
+		if (csd->write_blkbits >= 9)
+			csd->erase_size = (UNSTUFF_BITS(resp, 39, 7) + 1) <<
+					  (csd->write_blkbits - 9);
 		break;
 	case 1:
 		/*
@@ -147,6 +151,7 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = 4; /* Unused */
 		csd->write_blkbits = 9;
 		csd->write_partial = 0;
+		csd->erase_size = 128;	/* SECTOR_SIZE is fixed at 64KB */
 		break;
 	default:
 		printk(KERN_ERR "%s: unrecognised CSD structure version %d\n",
@@ -416,6 +421,7 @@ static int mmc_sd_init_card(struct mmc_host *host, u32 ocr,
 		err = mmc_decode_csd(card);
 		if (err)
 			goto free_card;
+		card->erase_size = card->csd.erase_size;
 
 		mmc_decode_cid(card);
 	}
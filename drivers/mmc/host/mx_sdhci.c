@@ -50,6 +50,8 @@
 
 #include "mx_sdhci.h"
 
+#include <trace/events/mmc.h>
+
 
 #define GDEBUG 0
 #include <linux/gallen_dbg.h>
@@ -110,7 +112,6 @@ static unsigned int debug_quirks = SDHCI_QUIRK_ONLY_PIO;
 static unsigned int debug_quirks;
 #endif
 static unsigned int mxc_wml_value = 512;
-static unsigned int *adma_des_table;
 
 #ifndef MXC_SDHCI_NUM
 #define MXC_SDHCI_NUM	4
@@ -129,6 +130,74 @@ extern void gpio_sdhc_active(int module);
 extern void gpio_sdhc_inactive(int module);
 static void sdhci_dma_irq(void *devid, int error, unsigned int cnt);
 
+/* Default idle time before the clocks are gated */
+#define SDHCI_CLK_GATE_MS	20
+
+static inline void sdhci_schedule_clk_gate(struct sdhci_host *host)
+{
+	schedule_delayed_work(&host->clk_gate_work,
+			      msecs_to_jiffies(host->clk_gate_ms));
+}
+
+/*
+ * Undo sdhci_clk_gate_worker() before touching the controller.  Callers
+ * hold the host claimed, which keeps the gate work out.
+ */
+static void sdhci_ungate(struct sdhci_host *host)
+{
+	ktime_t start = ktime_get();
+	int timeout = 100;
+	u32 usecs;
+
+	if (!host->plat_data->clk_flg) {
+		clk_enable(host->clk);
+		host->plat_data->clk_flg = 1;
+	}
+
+	if (host->sd_clk_gated) {
+		writel(readl(host->ioaddr + SDHCI_CLOCK_CONTROL)
+		       | SDHCI_CLOCK_SD_EN, host->ioaddr + SDHCI_CLOCK_CONTROL);
+		while (!(readl(host->ioaddr + SDHCI_PRESENT_STATE) &
+			 SDHCI_SD_CLK_STABLE) && timeout--)
+			udelay(1);
+		host->sd_clk_gated = 0;
+	}
+
+	if (!host->gated)
+		return;
+
+	host->gated = 0;
+	host->gated_us += ktime_us_delta(start, host->gated_at);
+	usecs = ktime_us_delta(ktime_get(), start);
+	host->ungate_last_us = usecs;
+	host->ungate_total_us += usecs;
+	if (usecs > host->ungate_max_us)
+		host->ungate_max_us = usecs;
+}
+
+static int sdhci_req_failed(struct sdhci_host *host, struct mmc_request *mrq)
+{
+	return mrq->cmd->error || (mrq->sbc && mrq->sbc->error) ||
+	    (mrq->data && (mrq->data->error ||
+			   (mrq->data->stop && mrq->data->stop->error))) ||
+	    (host->chip->quirks & SDHCI_QUIRK_RESET_AFTER_REQUEST);
+}
+
+/*
+ * Hand the current request over for completion.  Requests that went
+ * through fine are completed from the finish tasklet, right after the
+ * interrupt; only the ones that need a controller reset make the trip
+ * through sdhci_finish_worker().
+ */
+static void sdhci_queue_finish(struct sdhci_host *host)
+{
+	host->finish_queued = ktime_get();
+	if (host->mrq && !sdhci_req_failed(host, host->mrq))
+		tasklet_schedule(&host->finish_tasklet);
+	else
+		queue_work(host->workqueue, &host->finish_wq);
+}
+
 extern int check_hardware_name(void);
 
 
@@ -440,6 +509,78 @@ static void sdhci_transfer_pio(struct sdhci_host *host)
 	DBG("PIO transfer complete.\n");
 }
 
+static inline enum dma_data_direction sdhci_data_dir(struct mmc_data *data)
+{
+	return (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+}
+
+/* Whether sdhci_prepare_data() will run @data through the internal DMA */
+static bool sdhci_data_use_dma(struct sdhci_host *host, struct mmc_data *data)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (!(host->flags & SDHCI_USE_DMA))
+		return false;
+
+	if ((host->chip->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE) &&
+	    ((data->blksz * data->blocks) & 0x3)) {
+		DBG("Reverting to PIO because of transfer size (%d)\n",
+		    data->blksz * data->blocks);
+		return false;
+	}
+
+	/*
+	 * The assumption here being that alignment is the same after
+	 * translation to device address space.
+	 */
+	if ((host->chip->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+	    (data->sg->offset & 0x3)) {
+		DBG("Reverting to PIO because of bad alignment\n");
+		return false;
+	}
+
+	if (cpu_is_mx25() && (data->blksz * data->blocks < 0x10)) {
+		DBG("Reverting to PIO in small data transfer.\n");
+		return false;
+	}
+
+	/*
+	 * A single segment goes through the single DMA mode, which takes
+	 * any address.  Lists go through ADMA, which needs every segment
+	 * to be 4K aligned.
+	 */
+	if (data->sg_len > 1) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if (sg->offset & (SDHCI_ADMA_ALIGN - 1)) {
+				DBG("Reverting to PIO, segment %d isn't "
+				    "4K aligned.\n", i);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* The DMA hosts run with the PIO interrupts masked, see sdhci_init() */
+static void sdhci_set_pio_irqs(struct sdhci_host *host, int enable)
+{
+	u32 mask = SDHCI_INT_DATA_AVAIL | SDHCI_INT_SPACE_AVAIL;
+	u32 ier = readl(host->ioaddr + SDHCI_INT_ENABLE);
+	u32 ser = readl(host->ioaddr + SDHCI_SIGNAL_ENABLE);
+
+	if (enable) {
+		ier |= mask;
+		ser |= mask;
+	} else {
+		ier &= ~mask;
+		ser &= ~mask;
+	}
+	writel(ier, host->ioaddr + SDHCI_INT_ENABLE);
+	writel(ser, host->ioaddr + SDHCI_SIGNAL_ENABLE);
+}
+
 static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 {
 	u32 count;
@@ -502,50 +643,19 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 			     0xFFF0FFFF);
 	writel(count, host->ioaddr + SDHCI_CLOCK_CONTROL);
 
-	if (host->flags & SDHCI_USE_DMA)
+	if (sdhci_data_use_dma(host, data))
 		host->flags |= SDHCI_REQ_USE_DMA;
-
-	if (unlikely((host->flags & SDHCI_REQ_USE_DMA) &&
-		     (host->chip->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE) &&
-		     ((data->blksz * data->blocks) & 0x3))) {
-		DBG("Reverting to PIO because of transfer size (%d)\n",
-		    data->blksz * data->blocks);
+	else
 		host->flags &= ~SDHCI_REQ_USE_DMA;
-	}
 
-	/*
-	 * The assumption here being that alignment is the same after
-	 * translation to device address space.
-	 */
-	if (unlikely((host->flags & SDHCI_REQ_USE_DMA) &&
-		     (host->chip->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-		     (data->sg->offset & 0x3))) {
-		DBG("Reverting to PIO because of bad alignment\n");
-		host->flags &= ~SDHCI_REQ_USE_DMA;
-	}
+	if (host->flags & SDHCI_USE_DMA)
+		sdhci_set_pio_irqs(host, !(host->flags & SDHCI_REQ_USE_DMA));
 
-	if (cpu_is_mx25() && (data->blksz * data->blocks < 0x10)) {
-		host->flags &= ~SDHCI_REQ_USE_DMA;
-		DBG("Reverting to PIO in small data transfer.\n");
-		writel(readl(host->ioaddr + SDHCI_INT_ENABLE)
-				| SDHCI_INT_DATA_AVAIL
-				| SDHCI_INT_SPACE_AVAIL,
-				host->ioaddr + SDHCI_INT_ENABLE);
-		writel(readl(host->ioaddr + SDHCI_SIGNAL_ENABLE)
-				| SDHCI_INT_DATA_AVAIL
-				| SDHCI_INT_SPACE_AVAIL,
-				host->ioaddr + SDHCI_SIGNAL_ENABLE);
-	} else if (cpu_is_mx25() && (host->flags & SDHCI_USE_DMA)) {
-		host->flags |= SDHCI_REQ_USE_DMA;
-		DBG("Reverting to DMA in large data transfer.\n");
-		writel(readl(host->ioaddr + SDHCI_INT_ENABLE)
-				& ~(SDHCI_INT_DATA_AVAIL
-				| SDHCI_INT_SPACE_AVAIL),
-				host->ioaddr + SDHCI_INT_ENABLE);
-		writel(readl(host->ioaddr + SDHCI_SIGNAL_ENABLE)
-				& ~(SDHCI_INT_DATA_AVAIL
-				| SDHCI_INT_SPACE_AVAIL),
-				host->ioaddr + SDHCI_SIGNAL_ENABLE);
+	/* Mapped by sdhci_pre_req() under different rules, redo it */
+	if (data->host_cookie && !(host->flags & SDHCI_REQ_USE_DMA)) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     sdhci_data_dir(data));
+		data->host_cookie = 0;
 	}
 
 	if (host->flags & SDHCI_REQ_USE_DMA) {
@@ -553,54 +663,49 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		struct scatterlist *tsg;
 
 		host->dma_size = data->blocks * data->blksz;
-		count =
-		    dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-			       (data->
-				flags & MMC_DATA_READ) ? DMA_FROM_DEVICE :
-			       DMA_TO_DEVICE);
+		if (data->host_cookie)
+			count = data->sg_len;
+		else
+			count = dma_map_sg(mmc_dev(host->mmc), data->sg,
+					   data->sg_len, sdhci_data_dir(data));
 		BUG_ON(count != data->sg_len);
 		DBG("Configure the sg DMA, %s, len is 0x%x, count is %d\n",
 		    (data->flags & MMC_DATA_READ)
 		    ? "DMA_FROM_DEIVCE" : "DMA_TO_DEVICE", host->dma_size,
 		    count);
 
-		/* Make sure the ADMA mode is selected. */
-		i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
-		i |= SDHCI_CTRL_ADMA;
-		writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
-
-		tsg = data->sg;
-		/* ADMA mode is used, create the descriptor table */
-		for (i = 0; i < count; i++) {
-			if (tsg->dma_address & 0xFFF) {
-				DBG(KERN_ERR "ADMA addr isn't 4K aligned.\n");
-				DBG(KERN_ERR "0x%x\n", tsg->dma_address);
-				DBG(KERN_ERR "Changed to Single DMA mode.\n");
-				goto Single_DMA;
+		if (count == 1) {
+			/* Single DMA mode is used */
+			i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
+			i &= ~SDHCI_CTRL_ADMA;
+			writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
+			writel(sg_dma_address(data->sg),
+			       host->ioaddr + SDHCI_DMA_ADDRESS);
+		} else {
+			unsigned int *des = host->adma_des_table;
+
+			/*
+			 * ADMA mode is used, one set/tran descriptor pair
+			 * per segment.  sdhci_data_use_dma() has checked
+			 * the alignment of every segment.
+			 */
+			for_each_sg(data->sg, tsg, count, i) {
+				des[2 * i] = sg_dma_len(tsg) << 12;
+				des[2 * i] |= FSL_ADMA_DES_ATTR_SET;
+				des[2 * i] |= FSL_ADMA_DES_ATTR_VALID;
+				des[2 * i + 1] = sg_dma_address(tsg);
+				des[2 * i + 1] |= FSL_ADMA_DES_ATTR_TRAN;
+				des[2 * i + 1] |= FSL_ADMA_DES_ATTR_VALID;
 			}
-			adma_des_table[2 * i] = tsg->length << 12;
-			adma_des_table[2 * i] |= FSL_ADMA_DES_ATTR_SET;
-			adma_des_table[2 * i] |= FSL_ADMA_DES_ATTR_VALID;
-			adma_des_table[2 * i + 1] = tsg->dma_address;
-			adma_des_table[2 * i + 1] |= FSL_ADMA_DES_ATTR_TRAN;
-			adma_des_table[2 * i + 1] |= FSL_ADMA_DES_ATTR_VALID;
-			if (count == (i + 1))
-				adma_des_table[2 * i + 1] |=
-				    FSL_ADMA_DES_ATTR_END;
-			tsg++;
+			des[2 * count - 1] |= FSL_ADMA_DES_ATTR_END;
+			wmb();
+
+			writel(host->adma_des_dma,
+			       host->ioaddr + SDHCI_ADMA_ADDRESS);
+			i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
+			i |= SDHCI_CTRL_ADMA;
+			writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
 		}
-
-		/* Write the physical address to ADMA address reg */
-		writel(virt_to_phys(adma_des_table),
-		       host->ioaddr + SDHCI_ADMA_ADDRESS);
-	      Single_DMA:
-		/* Rollback to the Single DMA mode */
-		i = readl(host->ioaddr + SDHCI_HOST_CONTROL);
-		i &= ~SDHCI_CTRL_ADMA;
-		writel(i, host->ioaddr + SDHCI_HOST_CONTROL);
-		/* Single DMA mode is used */
-		writel(sg_dma_address(data->sg),
-		       host->ioaddr + SDHCI_DMA_ADDRESS);
 	} else if ((host->flags & SDHCI_USE_EXTERNAL_DMA) &&
 		   (data->blocks * data->blksz >= mxc_wml_value)) {
 		host->dma_size = data->blocks * data->blksz;
@@ -639,6 +744,12 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 	/* We do not handle DMA boundaries, so set it to max (512 KiB) */
 	writel((data->blocks << 16) | SDHCI_MAKE_BLKSZ(0, data->blksz),
 	       host->ioaddr + SDHCI_BLOCK_SIZE);
+
+	trace_mmc_data_start(host->mmc, data,
+		(host->flags & SDHCI_REQ_USE_DMA) ?
+			(data->sg_len > 1 ? "adma" : "sdma") :
+		(host->flags & SDHCI_USE_EXTERNAL_DMA) &&
+		(data->blocks * data->blksz >= mxc_wml_value) ? "ext" : "pio");
 }
 
 static void sdhci_finish_data(struct sdhci_host *host)
@@ -651,10 +762,10 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	data = host->data;
 	host->data = NULL;
 
-	if (host->flags & SDHCI_REQ_USE_DMA) {
+	/* Requests mapped by sdhci_pre_req() are unmapped in post_req */
+	if ((host->flags & SDHCI_REQ_USE_DMA) && !data->host_cookie) {
 		dma_unmap_sg(&(host->chip->pdev)->dev, data->sg, data->sg_len,
-			     (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE :
-			     DMA_TO_DEVICE);
+			     sdhci_data_dir(data));
 	}
 	if ((host->flags & SDHCI_USE_EXTERNAL_DMA) &&
 	    (host->dma_size >= mxc_wml_value) && (data != NULL)) {
@@ -679,8 +790,11 @@ static void sdhci_finish_data(struct sdhci_host *host)
 		}
 	}
 	data->bytes_xfered = data->blksz * data->blocks;
+	trace_mmc_data_done(host->mmc, data);
 
-	if ((data->stop) && !((mx50_revision() == IMX_CHIP_REVISION_1_0) ||
+	/* With SET_BLOCK_COUNT the card stops by itself unless we failed */
+	if ((data->stop) && (data->error || !host->mrq->sbc) &&
+	    !((mx50_revision() == IMX_CHIP_REVISION_1_0) ||
 				(mx53_revision() == IMX_CHIP_REVISION_1_0))) {
 		/*
 		 * The controller needs a reset of internal state machines
@@ -693,7 +807,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 
 		sdhci_send_command(host, data->stop);
 	} else
-		queue_work(host->workqueue, &host->finish_wq);
+		sdhci_queue_finish(host);
 }
 
 static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
@@ -723,7 +837,7 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 			       "inhibit bit(s).\n", mmc_hostname(host->mmc));
 			sdhci_dumpregs(host);
 			cmd->error = -EIO;
-			queue_work(host->workqueue, &host->finish_wq);
+			sdhci_queue_finish(host);
 			return;
 		}
 		timeout--;
@@ -792,7 +906,7 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 		printk(KERN_ERR "%s: Unsupported response type!\n",
 		       mmc_hostname(host->mmc));
 		cmd->error = -EINVAL;
-		queue_work(host->workqueue, &host->finish_wq);
+		sdhci_queue_finish(host);
 		return;
 	}
 
@@ -828,6 +942,7 @@ static void sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	if (cmd->opcode == 0xd)
 		mdelay(5);
 	DBG("Complete sending cmd, transfer mode would be 0x%x.\n", mode);
+	trace_mmc_cmd_issue(host->mmc, cmd);
 	writel(mode, host->ioaddr + SDHCI_TRANSFER_MODE);
 }
 
@@ -858,12 +973,20 @@ static void sdhci_finish_command(struct sdhci_host *host)
 	}
 
 	host->cmd->error = 0;
+	trace_mmc_cmd_done(host->mmc, host->cmd);
+
+	/* SET_BLOCK_COUNT is done, now send the transfer itself */
+	if (host->cmd == host->mrq->sbc) {
+		host->cmd = NULL;
+		sdhci_send_command(host, host->mrq->cmd);
+		return;
+	}
 
 	if (host->data && host->data_early)
 		sdhci_finish_data(host);
 
 	if (!host->cmd->data)
-		queue_work(host->workqueue, &host->finish_wq);
+		sdhci_queue_finish(host);
 
 	host->cmd = NULL;
 }
@@ -998,10 +1121,7 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	host = mmc_priv(mmc);
 
 	/* Enable the clock */
-	if (!host->plat_data->clk_flg) {
-		clk_enable(host->clk);
-		host->plat_data->clk_flg = 1;
-	}
+	sdhci_ungate(host);
 
 	spin_lock_irqsave(&host->lock, flags);
 
@@ -1027,8 +1147,10 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	host->mrq = mrq;
 	if (!(host->flags & SDHCI_CD_PRESENT)) {
 		host->mrq->cmd->error = -ENOMEDIUM;
-		queue_work(host->workqueue, &host->finish_wq);
-	} else
+		sdhci_queue_finish(host);
+	} else if (mrq->sbc)
+		sdhci_send_command(host, mrq->sbc);
+	else
 		sdhci_send_command(host, mrq->cmd);
 
 	if (!(host->flags & SDHCI_USE_EXTERNAL_DMA))
@@ -1049,10 +1171,8 @@ static void sdhci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 
 	host = mmc_priv(mmc);
 
-	if (ios->clock && !host->plat_data->clk_flg) {
-		clk_enable(host->clk);
-		host->plat_data->clk_flg = 1;
-	}
+	if (ios->clock)
+		sdhci_ungate(host);
 
 	/* Configure the External DMA mode */
 	if (host->flags & SDHCI_USE_EXTERNAL_DMA) {
@@ -1167,10 +1287,7 @@ static void sdhci_enable_sdio_irq(struct mmc_host *mmc, int enable)
 	host = mmc_priv(mmc);
 
 	/* Enable the clock */
-	if (!host->plat_data->clk_flg) {
-		clk_enable(host->clk);
-		host->plat_data->clk_flg = 1;
-	}
+	sdhci_ungate(host);
 
 	spin_lock_irqsave(&host->lock, flags);
 
@@ -1219,8 +1336,41 @@ static void sdhci_enable_sdio_irq(struct mmc_host *mmc, int enable)
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Map the next request while the current one is still transferring, so
+ * the cache maintenance is off the critical path between the two.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	data->host_cookie = 0;
+	if (!sdhci_data_use_dma(host, data))
+		return;
+
+	if (dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		       sdhci_data_dir(data)) != data->sg_len)
+		return;
+	data->host_cookie = 1;
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			   int err)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data->host_cookie)
+		return;
+	dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		     sdhci_data_dir(data));
+	data->host_cookie = 0;
+}
+
 static const struct mmc_host_ops sdhci_ops = {
 	.request = sdhci_request,
+	.pre_req = sdhci_pre_req,
+	.post_req = sdhci_post_req,
 	.set_ios = sdhci_set_ios,
 	.get_ro = sdhci_get_ro,
 	.enable_sdio_irq = sdhci_enable_sdio_irq,
@@ -1261,7 +1411,7 @@ static void sdhci_tasklet_card(unsigned long param)
 			sdhci_reset(host, SDHCI_RESET_DATA);
 
 			host->mrq->cmd->error = -ENOMEDIUM;
-			queue_work(host->workqueue, &host->finish_wq);
+			sdhci_queue_finish(host);
 		}
 	}
 
@@ -1270,16 +1420,126 @@ static void sdhci_tasklet_card(unsigned long param)
 	mmc_detect_change(host->mmc, msecs_to_jiffies(200));
 }
 
+/*
+ * Gate the clocks once the host has stayed idle for clk_gate_ms: first
+ * the card clock, which the card is idle without, then the module clock
+ * unless the board wants it always on.  clk_disable() may sleep, hence
+ * the work, and it is called only after host->lock has been dropped; the
+ * card clock bit is plain MMIO and is cleared under the lock.  SDIO cards
+ * need the clock to signal interrupts and are left alone.
+ */
+static void sdhci_clk_gate_worker(struct work_struct *work)
+{
+	struct sdhci_host *host = container_of(to_delayed_work(work),
+			struct sdhci_host, clk_gate_work);
+	unsigned long flags;
+	u32 present;
+	int gated = 0, disable = 0;
+
+	if (host->mmc->card && mmc_card_sdio(host->mmc->card))
+		return;
+
+	/* Busy again; the end of that request reschedules us */
+	if (!mmc_try_claim_host(host->mmc))
+		return;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (host->mrq || !host->plat_data->clk_flg)
+		goto out;
+
+	present = readl(host->ioaddr + SDHCI_PRESENT_STATE);
+	if (present & (SDHCI_DATA_ACTIVE | SDHCI_DOING_WRITE |
+		       SDHCI_DOING_READ))
+		goto out;
+
+	/* Don't stop the card clock while the card signals busy */
+	if (host->plat_data->vendor_ver >= ESDHC_VENDOR_V22 &&
+	    !host->sd_clk_gated && (present & SDHCI_DAT0_IDLE) &&
+	    host->clock) {
+		writel(readl(host->ioaddr + SDHCI_CLOCK_CONTROL)
+		       & ~SDHCI_CLOCK_SD_EN,
+		       host->ioaddr + SDHCI_CLOCK_CONTROL);
+		host->sd_clk_gated = 1;
+		gated = 1;
+	}
+
+	if (!host->plat_data->clk_always_on) {
+		host->plat_data->clk_flg = 0;
+		disable = 1;
+		gated = 1;
+	}
+
+	if (gated && !host->gated) {
+		host->gated = 1;
+		host->gated_at = ktime_get();
+		host->gate_count++;
+	}
+ out:
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	/*
+	 * The last user of an esdhc clock going away changes the bus
+	 * frequency, which sleeps.  The claim keeps sdhci_ungate() out
+	 * until this is done.
+	 */
+	if (disable)
+		clk_disable(host->clk);
+
+	mmc_release_host(host->mmc);
+}
+
+static void sdhci_tasklet_finish(unsigned long param)
+{
+	struct sdhci_host *host = (struct sdhci_host *)param;
+	unsigned long flags;
+	struct mmc_request *mrq;
+
+	trace_mmc_finish_work(host->mmc,
+		ktime_us_delta(ktime_get(), host->finish_queued));
+
+	spin_lock_irqsave(&host->lock, flags);
+
+	/* Completed by the timeout timer or an error in the meantime */
+	if (!host->mrq) {
+		spin_unlock_irqrestore(&host->lock, flags);
+		return;
+	}
+
+	del_timer(&host->timer);
+
+	mrq = host->mrq;
+	host->mrq = NULL;
+	host->cmd = NULL;
+	host->data = NULL;
+
+	sdhci_deactivate_led(host);
+
+	mmiowb();
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	sdhci_schedule_clk_gate(host);
+
+	mmc_request_done(host->mmc, mrq);
+}
+
 static void sdhci_finish_worker(struct work_struct *work)
 {
 	struct sdhci_host *host = container_of(work, struct sdhci_host,
 			finish_wq);
 	unsigned long flags;
-	int req_done;
 	struct mmc_request *mrq;
 
+	trace_mmc_finish_work(host->mmc,
+		ktime_us_delta(ktime_get(), host->finish_queued));
+
 	spin_lock_irqsave(&host->lock, flags);
 
+	/* The finish tasklet got to it first */
+	if (!host->mrq) {
+		spin_unlock_irqrestore(&host->lock, flags);
+		return;
+	}
+
 	del_timer(&host->timer);
 
 	mrq = host->mrq;
@@ -1288,10 +1548,7 @@ static void sdhci_finish_worker(struct work_struct *work)
 	 * The controller needs a reset of internal state machines
 	 * upon error conditions.
 	 */
-	if (mrq->cmd->error ||
-	    (mrq->data && (mrq->data->error ||
-			   (mrq->data->stop && mrq->data->stop->error))) ||
-	    (host->chip->quirks & SDHCI_QUIRK_RESET_AFTER_REQUEST)) {
+	if (sdhci_req_failed(host, mrq)) {
 
 		/* Some controllers need this kick or reset won't work here */
 		if (host->chip->quirks & SDHCI_QUIRK_CLOCK_BEFORE_RESET) {
@@ -1318,15 +1575,7 @@ static void sdhci_finish_worker(struct work_struct *work)
 	mmiowb();
 	spin_unlock_irqrestore(&host->lock, flags);
 
-	/* Stop the clock when the req is done */
-	req_done = !(readl(host->ioaddr + SDHCI_PRESENT_STATE) &
-		(SDHCI_DATA_ACTIVE | SDHCI_DOING_WRITE | SDHCI_DOING_READ));
-	if (req_done && host->plat_data->clk_flg &&
-		!(host->plat_data->clk_always_on) &&
-		!(host->mmc->card && mmc_card_sdio(host->mmc->card))) {
-		clk_disable(host->clk);
-		host->plat_data->clk_flg = 0;
-	}
+	sdhci_schedule_clk_gate(host);
 
 	mmc_request_done(host->mmc, mrq);
 }
@@ -1354,7 +1603,7 @@ static void sdhci_timeout_timer(unsigned long data)
 			else
 				host->mrq->cmd->error = -ETIMEDOUT;
 
-			queue_work(host->workqueue, &host->finish_wq);
+			sdhci_queue_finish(host);
 		}
 
 		if (!readl(host->ioaddr + SDHCI_SIGNAL_ENABLE)) {
@@ -1420,9 +1669,10 @@ static void sdhci_cmd_irq(struct sdhci_host *host, u32 intmask)
 		}
 	}
 
-	if (host->cmd->error)
-		queue_work(host->workqueue, &host->finish_wq);
-	else if (intmask & SDHCI_INT_RESPONSE)
+	if (host->cmd->error) {
+		trace_mmc_cmd_done(host->mmc, host->cmd);
+		sdhci_queue_finish(host);
+	} else if (intmask & SDHCI_INT_RESPONSE)
 		sdhci_finish_command(host);
 }
 
@@ -1534,6 +1784,7 @@ static void sdhci_dma_irq(void *devid, int error, unsigned int cnt)
 	int ret;
 	struct sdhci_host *host = devid;
 
+	trace_mmc_dma_done(host->mmc, error, cnt);
 	DBG("%s: error: %d Transferred bytes:%d\n", DRIVER_NAME, error, cnt);
 	if (host->flags & SDHCI_USE_EXTERNAL_DMA) {
 		/*
@@ -1640,7 +1891,7 @@ static void esdhc_cd_callback(struct work_struct *work)
 			sdhci_reset(host, SDHCI_RESET_DATA);
 
 			host->mrq->cmd->error = -ENOMEDIUM;
-			queue_work(host->workqueue, &host->finish_wq);
+			sdhci_queue_finish(host);
 		}
 
 		if (host->init_flag > 0) {
@@ -1845,6 +2096,8 @@ static int sdhci_suspend(struct platform_device *pdev, pm_message_t state)
 		if (!chip->hosts[i])
 			continue;
 		free_irq(chip->hosts[i]->irq, chip->hosts[i]);
+		/* Don't leave the clock running until the gate work fires */
+		flush_delayed_work(&chip->hosts[i]->clk_gate_work);
 	}
 
 	return 0;
@@ -1901,6 +2154,7 @@ static int sdhci_resume(struct platform_device *pdev)
 				  chip->hosts[i]);
 		if (ret)
 			return ret;
+		sdhci_ungate(chip->hosts[i]);
 		sdhci_init(chip->hosts[i]);
 		chip->hosts[i]->init_flag = 2;
 		mmiowb();
@@ -2120,6 +2374,14 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	mmc->caps = MMC_CAP_SDIO_IRQ;
 	mmc->caps |= mmc_plat->caps;
 
+	/*
+	 * The first mx50/mx53 revisions always append an auto CMD12 to
+	 * multiblock transfers, which SET_BLOCK_COUNT must not be mixed with.
+	 */
+	if (!((mx50_revision() == IMX_CHIP_REVISION_1_0) ||
+	      (mx53_revision() == IMX_CHIP_REVISION_1_0)))
+		mmc->caps |= MMC_CAP_CMD23;
+
 	if (caps & SDHCI_CAN_DO_HISPD) {
 		GALLEN_DBGLOCAL_RUNLOG(21);
 		mmc->caps |= MMC_CAP_SD_HIGHSPEED | MMC_CAP_MMC_HIGHSPEED;
@@ -2150,18 +2412,17 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	spin_lock_init(&host->lock);
 
 	/*
-	 * Maximum number of segments. Hardware cannot do scatter lists.
+	 * Maximum number of segments. The internal DMA takes lists through
+	 * the ADMA descriptor table, so the block layer needn't bounce.
 	 */
 	if (host->flags & SDHCI_USE_DMA) {
 		GALLEN_DBGLOCAL_RUNLOG(26);
-
-		mmc->max_hw_segs = 1;
 	}
 	else {
 		GALLEN_DBGLOCAL_RUNLOG(27);
-		mmc->max_hw_segs = 16;
 	}
-	mmc->max_phys_segs = 16;
+	mmc->max_hw_segs = SDHCI_ADMA_SEGS;
+	mmc->max_phys_segs = SDHCI_ADMA_SEGS;
 
 	/*
 	 * Maximum number of sectors in one transfer. Limited by DMA boundary
@@ -2179,9 +2440,12 @@ static int __devinit sdhci_probe_slot(struct platform_device
 
 	/*
 	 * Maximum segment size. Could be one segment with the maximum number
-	 * of bytes.
+	 * of bytes, except that an ADMA descriptor can't describe 64K.
 	 */
 	mmc->max_seg_size = mmc->max_req_size;
+	if ((host->flags & SDHCI_USE_DMA) &&
+	    mmc->max_seg_size > SDHCI_ADMA_MAX_SEG)
+		mmc->max_seg_size = SDHCI_ADMA_MAX_SEG;
 
 	/*
 	 * Maximum block size. This varies from controller to controller and
@@ -2212,9 +2476,10 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	if (host->flags & SDHCI_USE_DMA) {
 
 		GALLEN_DBGLOCAL_RUNLOG(32);
-		adma_des_table = kcalloc((2 * (mmc->max_phys_segs) + 1),
-					 sizeof(unsigned int), GFP_DMA);
-		if (adma_des_table == NULL) {
+		host->adma_des_table = dma_alloc_coherent(mmc_dev(mmc),
+				2 * SDHCI_ADMA_SEGS * sizeof(unsigned int),
+				&host->adma_des_dma, GFP_KERNEL);
+		if (host->adma_des_table == NULL) {
 			GALLEN_DBGLOCAL_RUNLOG(33);
 			printk(KERN_ERR "Cannot allocate ADMA memory\n");
 			ret = -ENOMEM;
@@ -2227,6 +2492,10 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	 */
 	tasklet_init(&host->card_tasklet,
 		     sdhci_tasklet_card, (unsigned long)host);
+	tasklet_init(&host->finish_tasklet,
+		     sdhci_tasklet_finish, (unsigned long)host);
+	INIT_DELAYED_WORK(&host->clk_gate_work, sdhci_clk_gate_worker);
+	host->clk_gate_ms = SDHCI_CLK_GATE_MS;
 
 	/* initialize the work queue */
 	host->workqueue = create_workqueue("esdhc_wq");
@@ -2235,6 +2504,8 @@ static int __devinit sdhci_probe_slot(struct platform_device
 
 	setup_timer(&host->timer, sdhci_timeout_timer, (unsigned long)host);
 	setup_timer(&host->cd_timer, sdhci_cd_timer, (unsigned long)host);
+	/* Card detect debounce, a few ticks either way don't matter */
+	set_timer_slack(&host->cd_timer, HZ / 8);
 
 	if (host->detect_irq) {
 		GALLEN_DBGLOCAL_RUNLOG(34);
@@ -2307,10 +2578,14 @@ static int __devinit sdhci_probe_slot(struct platform_device
 	del_timer_sync(&host->timer);
 	del_timer_sync(&host->cd_timer);
 	tasklet_kill(&host->card_tasklet);
+	tasklet_kill(&host->finish_tasklet);
+	cancel_delayed_work_sync(&host->clk_gate_work);
 	destroy_workqueue(host->workqueue);
       out3:
-	if (host->flags & SDHCI_USE_DMA)
-		kfree(adma_des_table);
+	if (host->adma_des_table)
+		dma_free_coherent(mmc_dev(mmc),
+				  2 * SDHCI_ADMA_SEGS * sizeof(unsigned int),
+				  host->adma_des_table, host->adma_des_dma);
 	release_mem_region(host->res->start,
 			   host->res->end - host->res->start + 1);
       out2:
@@ -2357,11 +2632,15 @@ static void sdhci_remove_slot(struct platform_device *pdev, int slot)
 	del_timer_sync(&host->timer);
 
 	tasklet_kill(&host->card_tasklet);
+	tasklet_kill(&host->finish_tasklet);
 	flush_workqueue(host->workqueue);
 	destroy_workqueue(host->workqueue);
+	cancel_delayed_work_sync(&host->clk_gate_work);
 
-	if (host->flags & SDHCI_USE_DMA)
-		kfree(adma_des_table);
+	if (host->adma_des_table)
+		dma_free_coherent(mmc_dev(mmc),
+				  2 * SDHCI_ADMA_SEGS * sizeof(unsigned int),
+				  host->adma_des_table, host->adma_des_dma);
 	release_mem_region(host->res->start,
 			   host->res->end - host->res->start + 1);
 	clk_disable(host->clk);
@@ -2371,6 +2650,71 @@ static void sdhci_remove_slot(struct platform_device *pdev, int slot)
 	gpio_sdhc_inactive(pdev->id);
 }
 
+static ssize_t clk_gate_ms_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct sdhci_chip *chip = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", chip->hosts[0]->clk_gate_ms);
+}
+
+static ssize_t clk_gate_ms_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct sdhci_chip *chip = dev_get_drvdata(dev);
+	unsigned long val;
+	int i;
+
+	if (strict_strtoul(buf, 10, &val) || val > 10000)
+		return -EINVAL;
+
+	for (i = 0; i < chip->num_slots; i++)
+		if (chip->hosts[i])
+			chip->hosts[i]->clk_gate_ms = val;
+	return count;
+}
+
+static DEVICE_ATTR(clk_gate_ms, S_IRUGO | S_IWUSR, clk_gate_ms_show,
+		   clk_gate_ms_store);
+
+static ssize_t clk_gate_stats_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct sdhci_chip *chip = dev_get_drvdata(dev);
+	ssize_t n = 0;
+	int i;
+
+	for (i = 0; i < chip->num_slots; i++) {
+		struct sdhci_host *host = chip->hosts[i];
+		u64 gated_us;
+		u32 ungates;
+
+		if (!host)
+			continue;
+
+		gated_us = host->gated_us;
+		if (host->gated)
+			gated_us += ktime_us_delta(ktime_get(), host->gated_at);
+		/* Every gate but a still pending one has been undone */
+		ungates = host->gate_count - host->gated;
+
+		n += sprintf(buf + n, "%s: %s gates %u gated_ms %llu "
+			     "ungate_us last %u avg %llu max %u\n",
+			     mmc_hostname(host->mmc),
+			     host->gated ? "gated" : "running",
+			     host->gate_count,
+			     (unsigned long long)div_u64(gated_us, 1000),
+			     host->ungate_last_us,
+			     ungates ? (unsigned long long)
+			     div_u64(host->ungate_total_us, ungates) : 0ULL,
+			     host->ungate_max_us);
+	}
+	return n;
+}
+
+static DEVICE_ATTR(clk_gate_stats, S_IRUGO, clk_gate_stats_show, NULL);
+
 static int sdhci_probe(struct platform_device *pdev)
 {
 	int ret = 0, i;
@@ -2412,6 +2756,16 @@ static int sdhci_probe(struct platform_device *pdev)
 		}
 	}
 
+	/*
+	 * Re-initialising an SDIO card on resume takes long; let the rest of
+	 * the system resume alongside it.  Cards are our children, so they
+	 * still wait for us.
+	 */
+	device_enable_async_resume(&pdev->dev);
+
+	if (device_create_file(&pdev->dev, &dev_attr_clk_gate_ms) ||
+	    device_create_file(&pdev->dev, &dev_attr_clk_gate_stats))
+		dev_warn(&pdev->dev, "failed to create clock gating attrs\n");
 	return 0;
 
       free:
@@ -2430,6 +2784,9 @@ static int sdhci_remove(struct platform_device *pdev)
 	chip = dev_get_drvdata(&pdev->dev);
 
 	if (chip) {
+		device_remove_file(&pdev->dev, &dev_attr_clk_gate_stats);
+		device_remove_file(&pdev->dev, &dev_attr_clk_gate_ms);
+
 		for (i = 0; i < chip->num_slots; i++)
 			sdhci_remove_slot(pdev, i);
 
@@ -2475,9 +2832,12 @@ module_init(sdhci_drv_init);
 module_exit(sdhci_drv_exit);
 
 module_param(debug_quirks, uint, 0444);
+module_param(mxc_wml_value, uint, 0444);
 
 MODULE_AUTHOR("Freescale Semiconductor, Inc.");
 MODULE_DESCRIPTION("MXC Secure Digital Host Controller Interface driver");
 MODULE_LICENSE("GPL");
 
 MODULE_PARM_DESC(debug_quirks, "Force certain quirks.");
+MODULE_PARM_DESC(mxc_wml_value,
+		 "Smallest transfer, in bytes, sent through the external DMA.");
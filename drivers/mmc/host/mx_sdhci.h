@@ -55,6 +55,7 @@
 #define  SDHCI_CMD_INHIBIT	0x00000001
 #define  SDHCI_DATA_INHIBIT	0x00000002
 #define  SDHCI_DATA_ACTIVE 	0x00000004
+#define  SDHCI_SD_CLK_STABLE	0x00000008
 #define  SDHCI_DOING_WRITE	0x00000100
 #define  SDHCI_DOING_READ	0x00000200
 #define  SDHCI_SPACE_AVAILABLE	0x00000400
@@ -214,6 +215,15 @@ enum {
 	FSL_ADMA_DES_ATTR_LINK = 0x30,
 };
 
+/*
+ * ADMA1 descriptors carry the address in bits 31:12 and the length in a
+ * 16 bit field, so every segment must start on a 4K boundary and stay
+ * below 64K.
+ */
+#define SDHCI_ADMA_SEGS		16
+#define SDHCI_ADMA_ALIGN	4096
+#define SDHCI_ADMA_MAX_SEG	(64 * 1024 - SDHCI_ADMA_ALIGN)
+
 #define SDHCI_VENDOR_SPEC	0xC0
 
 #define SDHCI_HOST_VERSION	0xFC
@@ -282,6 +292,19 @@ struct sdhci_host {
 	void __iomem *ioaddr;	/* Mapped address */
 
 	struct tasklet_struct card_tasklet;	/* Tasklet structures */
+	struct tasklet_struct finish_tasklet;	/* Requests without errors */
+	struct delayed_work clk_gate_work;	/* Clock off once idle */
+
+	/* Clock gating, see sdhci_clk_gate_worker() */
+	unsigned int clk_gate_ms;	/* Idle time before gating */
+	int sd_clk_gated;		/* Card clock stopped */
+	int gated;			/* Either clock gated */
+	ktime_t gated_at;
+	u32 gate_count;
+	u64 gated_us;			/* Total time spent gated */
+	u32 ungate_last_us;
+	u32 ungate_max_us;
+	u64 ungate_total_us;
 	struct workqueue_struct	*workqueue;
 	struct work_struct finish_wq;
 	struct work_struct cd_wq;	/* card detection work queue */
@@ -290,6 +313,11 @@ struct sdhci_host {
 
 	struct timer_list timer;	/* Timer for timeouts */
 	struct timer_list cd_timer;	/* Timer for cd */
+
+	ktime_t finish_queued;		/* finish_wq queued at */
+
+	unsigned int *adma_des_table;	/* ADMA descriptors */
+	dma_addr_t adma_des_dma;	/* and their bus address */
 };
 
 struct sdhci_chip {
@@ -37,6 +37,9 @@
 #include <linux/rtc.h>
 #include <linux/delay.h>
 #include <linux/uaccess.h>
+#include <linux/kallsyms.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
 #include <mach/hardware.h>
 
 #include "pmic.h"
@@ -436,7 +439,126 @@ static void add_crc16(unsigned char *data, int len) {
 
 }
 
-static int msp430_cmd(int cmd, int arg, u8 *indata, int nwrite, u8 *outdata, int nread, int crc) {
+/*
+ * MSP430 transaction layer.  Battery, RTC, watchdog and front light code
+ * all talk to the MSP430 through msp430_read/write/cmd; here their
+ * transactions are serialized, register reads and query commands
+ * issued within msp430_cache_ms of each other share one I2C transfer,
+ * and the traffic is accounted per calling function.  Any write or
+ * non-query command drops the whole cache, as it may change other
+ * registers too.
+ */
+static DEFINE_MUTEX(msp430_lock);
+
+static unsigned int msp430_cache_ms = 20;
+module_param(msp430_cache_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(msp430_cache_ms, "Window in which MSP430 reads are merged, 0 to disable");
+
+#define MSP430_CMD_CACHE_LEN	8
+
+static unsigned int msp430_cache_gen = 1;	/* 0 never matches */
+static struct {
+	unsigned int gen;
+	unsigned long stamp;	/* jiffies */
+	int value;
+} msp430_reg_cache[256];
+static struct {
+	unsigned int gen;
+	unsigned long stamp;
+	int len;
+	u8 data[MSP430_CMD_CACHE_LEN];
+} msp430_cmd_cache[256];
+
+#define MSP430_STAT_CLIENTS	16
+struct msp430_stat {
+	unsigned long func;	/* calling function, 0 for "other" */
+	u32 xfers;
+	u32 cached;
+	u32 errors;
+	u64 us;
+};
+static struct msp430_stat msp430_stats[MSP430_STAT_CLIENTS + 1];
+
+static bool msp430_cache_valid(unsigned int gen, unsigned long stamp)
+{
+	return msp430_cache_ms && gen == msp430_cache_gen &&
+		time_before(jiffies, stamp + msecs_to_jiffies(msp430_cache_ms) + 1);
+}
+
+static void msp430_cache_drop(void)
+{
+	if (++msp430_cache_gen == 0)
+		msp430_cache_gen = 1;
+}
+
+/* Called with msp430_lock held */
+static struct msp430_stat *msp430_stat_get(unsigned long caller)
+{
+	unsigned long size, offset;
+	int i;
+
+	if (kallsyms_lookup_size_offset(caller, &size, &offset))
+		caller -= offset;
+
+	for (i = 0; i < MSP430_STAT_CLIENTS; i++) {
+		if (msp430_stats[i].func == caller)
+			return &msp430_stats[i];
+		if (!msp430_stats[i].func) {
+			msp430_stats[i].func = caller;
+			return &msp430_stats[i];
+		}
+	}
+	return &msp430_stats[MSP430_STAT_CLIENTS];
+}
+
+static void msp430_stat_xfer(struct msp430_stat *st, ktime_t start, int err)
+{
+	st->xfers++;
+	if (err)
+		st->errors++;
+	st->us += ktime_us_delta(ktime_get(), start);
+}
+
+static ssize_t msp430_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	ssize_t n = 0;
+	int i;
+
+	n += sprintf(buf, "%-32s %8s %8s %6s %10s\n",
+		     "client", "xfers", "cached", "errors", "us");
+	mutex_lock(&msp430_lock);
+	for (i = 0; i <= MSP430_STAT_CLIENTS; i++) {
+		struct msp430_stat *st = &msp430_stats[i];
+		char name[KSYM_SYMBOL_LEN];
+
+		if (!st->xfers && !st->cached)
+			continue;
+		if (i == MSP430_STAT_CLIENTS)
+			strcpy(name, "other");
+		else
+			sprint_symbol(name, st->func);
+		n += snprintf(buf + n, PAGE_SIZE - n,
+			      "%-32s %8u %8u %6u %10llu\n", name, st->xfers,
+			      st->cached, st->errors, st->us);
+	}
+	mutex_unlock(&msp430_lock);
+	return n;
+}
+
+/* Any write clears the statistics */
+static ssize_t msp430_stats_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	mutex_lock(&msp430_lock);
+	memset(msp430_stats, 0, sizeof(msp430_stats));
+	mutex_unlock(&msp430_lock);
+	return count;
+}
+static DEVICE_ATTR(stats, 0644, msp430_stats_show, msp430_stats_store);
+
+static int __msp430_cmd(int cmd, int arg, u8 *indata, int nwrite, u8 *outdata, int nread, int crc) {
 
 	struct i2c_client *client = msp430_client;
 	int i, i2c_ret;
@@ -482,8 +604,42 @@ static int msp430_cmd(int cmd, int arg, u8 *indata, int nwrite, u8 *outdata, int
 
 }
 
+static int msp430_cmd(int cmd, int arg, u8 *indata, int nwrite, u8 *outdata, int nread, int crc)
+{
+	struct msp430_stat *st;
+	bool query = (arg == -1 && nwrite == 0 && nread > 0 &&
+		      nread <= MSP430_CMD_CACHE_LEN);
+	u8 c = cmd & 0xff;
+	ktime_t start;
+	int ret;
+
+	mutex_lock(&msp430_lock);
+	st = msp430_stat_get((unsigned long)__builtin_return_address(0));
+	if (query && msp430_cmd_cache[c].len >= nread &&
+	    msp430_cache_valid(msp430_cmd_cache[c].gen, msp430_cmd_cache[c].stamp)) {
+		memcpy(outdata, msp430_cmd_cache[c].data, nread);
+		st->cached++;
+		mutex_unlock(&msp430_lock);
+		return 0;
+	}
 
-unsigned int msp430_read(unsigned int reg)
+	start = ktime_get();
+	ret = __msp430_cmd(cmd, arg, indata, nwrite, outdata, nread, crc);
+	msp430_stat_xfer(st, start, ret);
+
+	if (!query)
+		msp430_cache_drop();
+	else if (!ret) {
+		memcpy(msp430_cmd_cache[c].data, outdata, nread);
+		msp430_cmd_cache[c].len = nread;
+		msp430_cmd_cache[c].gen = msp430_cache_gen;
+		msp430_cmd_cache[c].stamp = jiffies;
+	}
+	mutex_unlock(&msp430_lock);
+	return ret;
+}
+
+static unsigned int __msp430_read(unsigned int reg)
 {
 	struct i2c_client *client = msp430_client;
 	int i2c_ret;
@@ -525,7 +681,35 @@ unsigned int msp430_read(unsigned int reg)
 	return value;
 }
 
-int msp430_write(unsigned int reg, unsigned int value)
+unsigned int msp430_read(unsigned int reg)
+{
+	struct msp430_stat *st;
+	u8 r = reg & 0xff;
+	ktime_t start;
+	int value;
+
+	mutex_lock(&msp430_lock);
+	st = msp430_stat_get((unsigned long)__builtin_return_address(0));
+	if (msp430_cache_valid(msp430_reg_cache[r].gen, msp430_reg_cache[r].stamp)) {
+		value = msp430_reg_cache[r].value;
+		st->cached++;
+		mutex_unlock(&msp430_lock);
+		return value;
+	}
+
+	start = ktime_get();
+	value = __msp430_read(reg);
+	msp430_stat_xfer(st, start, value < 0);
+	if (value >= 0) {
+		msp430_reg_cache[r].value = value;
+		msp430_reg_cache[r].gen = msp430_cache_gen;
+		msp430_reg_cache[r].stamp = jiffies;
+	}
+	mutex_unlock(&msp430_lock);
+	return value;
+}
+
+static int __msp430_write(unsigned int reg, unsigned int value)
 {
 	struct i2c_client *client = msp430_client;
 	u16 addr;
@@ -559,6 +743,22 @@ int msp430_write(unsigned int reg, unsigned int value)
 	return i2c_ret;
 }
 
+int msp430_write(unsigned int reg, unsigned int value)
+{
+	struct msp430_stat *st;
+	ktime_t start;
+	int ret;
+
+	mutex_lock(&msp430_lock);
+	st = msp430_stat_get((unsigned long)__builtin_return_address(0));
+	start = ktime_get();
+	ret = __msp430_write(reg, value);
+	msp430_stat_xfer(st, start, ret < 0);
+	msp430_cache_drop();
+	mutex_unlock(&msp430_lock);
+	return ret;
+}
+
 static int __devinit msp430_probe(struct i2c_client *client,
 				const struct i2c_device_id *id)
 {
@@ -584,6 +784,8 @@ static int __devinit msp430_probe(struct i2c_client *client,
 	msp430_client = client;
 
 	msp_id = msp430_read(0);
+	if (device_create_file(&client->dev, &dev_attr_stats))
+		dev_warn(&client->dev, "can't create stats attribute\n");
 
 	printk("[%s-%d] MSP430 firmware version %04X\n",__FUNCTION__,__LINE__, msp_id);
 	if (NEWMSP) {
@@ -841,6 +841,14 @@ void ntx_charger_online_event_callback(void)
 }
 EXPORT_SYMBOL(ntx_charger_online_event_callback);
 
+/* The cached MSP430 battery level changed */
+void ntx_battery_changed_event_callback(void)
+{
+	if (g_ntx_bat_di)
+		power_supply_changed(&g_ntx_bat_di->bat);
+}
+EXPORT_SYMBOL(ntx_battery_changed_event_callback);
+
 
 static int mc13892_battery_get_property(struct power_supply *psy,
 				       enum power_supply_property psp,
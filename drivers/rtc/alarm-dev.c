@@ -57,6 +57,15 @@ static uint32_t wait_pending;
 
 static struct alarm alarms[ANDROID_ALARM_TYPE_COUNT];
 
+/*
+ * How late, per alarm type, an alarm set from userspace may go off so
+ * that it can share a wakeup with another one.  Zero keeps the type
+ * exact.
+ */
+static unsigned int coalesce_ms[ANDROID_ALARM_TYPE_COUNT];
+module_param_array_named(coalesce_ms, coalesce_ms, uint, NULL,
+			 S_IRUGO | S_IWUSR);
+
 static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	int rv = 0;
@@ -123,7 +132,10 @@ from_old_alarm_set:
 		alarm_enabled |= alarm_type_mask;
 		alarm_start_range(&alarms[alarm_type],
 			timespec_to_ktime(new_alarm_time),
-			timespec_to_ktime(new_alarm_time));
+			ktime_add(timespec_to_ktime(new_alarm_time),
+				ktime_set(coalesce_ms[alarm_type] / MSEC_PER_SEC,
+					(coalesce_ms[alarm_type] % MSEC_PER_SEC) *
+					NSEC_PER_MSEC)));
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		if (ANDROID_ALARM_BASE_CMD(cmd) != ANDROID_ALARM_SET_AND_WAIT(0)
 		    && cmd != ANDROID_ALARM_SET_AND_WAIT_OLD)
@@ -68,6 +68,105 @@ static struct platform_device *alarm_platform_dev;
 struct alarm_queue alarms[ANDROID_ALARM_TYPE_COUNT];
 static bool suspended;
 
+/*
+ * The RTC alarm as last written, in RTC seconds (0 when disarmed), so
+ * suspend only goes out to the RTC when the earliest wakeup moves.
+ */
+#define ALARM_RTC_UNKNOWN	ULONG_MAX
+static unsigned long alarm_rtc_armed = ALARM_RTC_UNKNOWN;
+static struct timespec alarm_rtc_delta;	/* wall time less RTC time */
+
+static uint32_t alarm_rtc_writes;
+static uint32_t alarm_rtc_writes_skipped;
+static uint32_t alarm_wakeups;
+
+/* alarm wakeups in each of the last hours of elapsed realtime */
+#define ALARM_WAKEUP_HOURS	24
+static uint32_t alarm_wakeups_hour[ALARM_WAKEUP_HOURS];
+static long alarm_wakeups_last_hour;
+
+module_param_named(rtc_writes, alarm_rtc_writes, uint, S_IRUGO);
+module_param_named(rtc_writes_skipped, alarm_rtc_writes_skipped, uint,
+		   S_IRUGO);
+module_param_named(wakeups, alarm_wakeups, uint, S_IRUGO);
+
+static long alarm_elapsed_hour_locked(void)
+{
+	ktime_t now = ktime_sub(ktime_get_real(),
+				alarms[ANDROID_ALARM_ELAPSED_REALTIME].delta);
+
+	return ktime_to_timespec(now).tv_sec / 3600;
+}
+
+/* Move the hourly window up to @hour, clearing the hours skipped */
+static void alarm_wakeups_advance_locked(long hour)
+{
+	long h;
+
+	if (hour - alarm_wakeups_last_hour >= ALARM_WAKEUP_HOURS)
+		memset(alarm_wakeups_hour, 0, sizeof(alarm_wakeups_hour));
+	else
+		for (h = alarm_wakeups_last_hour + 1; h <= hour; h++)
+			alarm_wakeups_hour[h % ALARM_WAKEUP_HOURS] = 0;
+	if (hour > alarm_wakeups_last_hour)
+		alarm_wakeups_last_hour = hour;
+}
+
+/* Newest hour first */
+static int alarm_get_wakeups_per_hour(char *buffer, struct kernel_param *kp)
+{
+	unsigned long flags;
+	long hour;
+	int i, len = 0;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+	alarm_wakeups_advance_locked(alarm_elapsed_hour_locked());
+	hour = alarm_wakeups_last_hour;
+	for (i = 0; i < ALARM_WAKEUP_HOURS; i++)
+		len += sprintf(buffer + len, "%s%u", i ? " " : "",
+			alarm_wakeups_hour[(hour + ALARM_WAKEUP_HOURS - i) %
+					   ALARM_WAKEUP_HOURS]);
+	spin_unlock_irqrestore(&alarm_slock, flags);
+	return len;
+}
+
+/* Any write clears the hourly counts */
+static int alarm_set_wakeups_per_hour(const char *val, struct kernel_param *kp)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+	memset(alarm_wakeups_hour, 0, sizeof(alarm_wakeups_hour));
+	spin_unlock_irqrestore(&alarm_slock, flags);
+	return 0;
+}
+module_param_call(wakeups_per_hour, alarm_set_wakeups_per_hour,
+		  alarm_get_wakeups_per_hour, NULL, S_IRUGO | S_IWUSR);
+
+/*
+ * Write @time (0 to disarm) to the RTC alarm unless it already holds
+ * it.  Returns whether it went out to the RTC.
+ */
+static bool alarm_rtc_program(unsigned long time)
+{
+	struct rtc_wkalrm rtc_alarm;
+
+	if (time == alarm_rtc_armed) {
+		alarm_rtc_writes_skipped++;
+		return false;
+	}
+
+	memset(&rtc_alarm, 0, sizeof(rtc_alarm));
+	rtc_time_to_tm(time, &rtc_alarm.time);
+	rtc_alarm.enabled = !!time;
+	if (rtc_set_alarm(alarm_rtc_dev, &rtc_alarm) < 0)
+		alarm_rtc_armed = ALARM_RTC_UNKNOWN;
+	else
+		alarm_rtc_armed = time;
+	alarm_rtc_writes++;
+	return true;
+}
+
 static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 {
 	struct alarm *alarm;
@@ -102,6 +201,29 @@ static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 	hrtimer_start_expires(&base->timer, HRTIMER_MODE_ABS);
 }
 
+/*
+ * Run the first alarm of @base now if its window has opened, so that
+ * an alarm allowed to be late goes off in the wakeup we're already in
+ * instead of waking the device again at its deadline.
+ */
+static void alarm_fire_due_locked(struct alarm_queue *base)
+{
+	struct alarm *alarm;
+	ktime_t soft;
+
+	if (base->stopped || !base->first)
+		return;
+
+	alarm = container_of(base->first, struct alarm, node);
+	soft = ktime_add(base->delta, alarm->softexpires);
+	if (soft.tv64 > ktime_get_real().tv64)
+		return;
+
+	hrtimer_try_to_cancel(&base->timer);
+	hrtimer_set_expires(&base->timer, soft);
+	hrtimer_start_expires(&base->timer, HRTIMER_MODE_ABS);
+}
+
 static void alarm_enqueue_locked(struct alarm *alarm)
 {
 	struct alarm_queue *base = &alarms[alarm->type];
@@ -287,6 +409,7 @@ int alarm_set_rtc(struct timespec new_time)
 		goto err;
 	}
 	ret = rtc_set_time(alarm_rtc_dev, &rtc_new_rtc_time);
+	alarm_rtc_armed = ALARM_RTC_UNKNOWN;
 	if (ret < 0)
 		pr_alarm(ERROR, "alarm_set_rtc: "
 			"Failed to set RTC, time will be lost on reboot\n");
@@ -369,7 +492,6 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 {
 	int                 err = 0;
 	unsigned long       flags;
-	struct rtc_wkalrm   rtc_alarm;
 	struct rtc_time     rtc_current_rtc_time;
 	unsigned long       rtc_current_time;
 	unsigned long       rtc_alarm_time;
@@ -403,25 +525,25 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 		set_normalized_timespec(&rtc_delta,
 					wall_time.tv_sec - rtc_current_time,
 					wall_time.tv_nsec);
+		alarm_rtc_delta = rtc_delta;
 
 		rtc_alarm_time = timespec_sub(ktime_to_timespec(
 			hrtimer_get_expires(&wakeup_queue->timer)),
 			rtc_delta).tv_sec;
 
-		rtc_time_to_tm(rtc_alarm_time, &rtc_alarm.time);
-		rtc_alarm.enabled = 1;
-		rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
-		rtc_read_time(alarm_rtc_dev, &rtc_current_rtc_time);
-		rtc_tm_to_time(&rtc_current_rtc_time, &rtc_current_time);
+		if (alarm_rtc_program(rtc_alarm_time)) {
+			/* see where the RTC got to while we wrote it */
+			rtc_read_time(alarm_rtc_dev, &rtc_current_rtc_time);
+			rtc_tm_to_time(&rtc_current_rtc_time,
+				       &rtc_current_time);
+		}
 		pr_alarm(SUSPEND,
 			"rtc alarm set at %ld, now %ld, rtc delta %ld.%09ld\n",
 			rtc_alarm_time, rtc_current_time,
 			rtc_delta.tv_sec, rtc_delta.tv_nsec);
 		if (rtc_current_time + 1 >= rtc_alarm_time) {
 			pr_alarm(SUSPEND, "alarm about to go off\n");
-			memset(&rtc_alarm, 0, sizeof(rtc_alarm));
-			rtc_alarm.enabled = 0;
-			rtc_set_alarm(alarm_rtc_dev, &rtc_alarm);
+			alarm_rtc_program(0);
 
 			spin_lock_irqsave(&alarm_slock, flags);
 			suspended = false;
@@ -433,26 +555,44 @@ static int alarm_suspend(struct platform_device *pdev, pm_message_t state)
 			err = -EBUSY;
 			spin_unlock_irqrestore(&alarm_slock, flags);
 		}
+	} else if (alarm_rtc_dev) {
+		/* a deadline cancelled since the last suspend */
+		alarm_rtc_program(0);
 	}
 	return err;
 }
 
 static int alarm_resume(struct platform_device *pdev)
 {
-	struct rtc_wkalrm alarm;
 	unsigned long       flags;
+	struct timespec     wall_time;
+	bool                woken;
 
 	pr_alarm(SUSPEND, "alarm_resume(%p)\n", pdev);
 
-	memset(&alarm, 0, sizeof(alarm));
-	alarm.enabled = 0;
-	rtc_set_alarm(alarm_rtc_dev, &alarm);
+	/*
+	 * Leave the RTC alarm alone: once passed it won't fire again, and
+	 * if it is still ahead the next suspend most likely wants it.
+	 */
+	getnstimeofday(&wall_time);
+	woken = alarm_rtc_armed && alarm_rtc_armed != ALARM_RTC_UNKNOWN &&
+		wall_time.tv_sec - alarm_rtc_delta.tv_sec >= alarm_rtc_armed;
+	if (woken)
+		alarm_rtc_armed = 0;
 
 	spin_lock_irqsave(&alarm_slock, flags);
 	suspended = false;
+	if (woken) {
+		alarm_wakeups++;
+		alarm_wakeups_advance_locked(alarm_elapsed_hour_locked());
+		alarm_wakeups_hour[alarm_wakeups_last_hour %
+				   ALARM_WAKEUP_HOURS]++;
+	}
 	update_timer_locked(&alarms[ANDROID_ALARM_RTC_WAKEUP], false);
 	update_timer_locked(&alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP],
 									false);
+	alarm_fire_due_locked(&alarms[ANDROID_ALARM_RTC_WAKEUP]);
+	alarm_fire_due_locked(&alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP]);
 	spin_unlock_irqrestore(&alarm_slock, flags);
 
 	return 0;
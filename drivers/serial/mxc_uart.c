@@ -37,6 +37,8 @@
 #include <linux/clk.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <asm/irq.h>
 #include <asm/dma.h>
 #include <asm/div64.h>
@@ -338,6 +340,8 @@ static void mxcuart_rx_chars(uart_mxc_port *umxc)
 {
 	volatile unsigned int ch, sr2;
 	unsigned int status, flag, max_count = 256;
+	unsigned long rx = umxc->port.icount.rx;
+	struct tty_buffer *tb;
 
 	sr2 = readl(umxc->port.membase + MXC_UARTUSR2);
 	while (((sr2 & MXC_UARTUSR2_RDR) == 1) && (max_count-- > 0)) {
@@ -390,11 +394,20 @@ static void mxcuart_rx_chars(uart_mxc_port *umxc)
 			goto ignore_char;
 		}
 
+		/* A full flip buffer drops the character silently */
+		tb = umxc->port.state->port.tty->buf.tail;
+		if ((!tb || tb->used >= tb->size) &&
+		    !tty_buffer_request_room(umxc->port.state->port.tty, 1))
+			umxc->port.icount.buf_overrun++;
 		uart_insert_char(&umxc->port, status, MXC_UARTURXD_OVRRUN, ch,
 				 flag);
 	      ignore_char:
 		sr2 = readl(umxc->port.membase + MXC_UARTUSR2);
 	}
+	if (umxc->port.icount.rx != rx) {
+		umxc->rx_events++;
+		umxc->rx_bytes += umxc->port.icount.rx - rx;
+	}
 	tty_flip_buffer_push(umxc->port.state->port.tty);
 }
 
@@ -508,6 +521,8 @@ static irqreturn_t mxcuart_int(int irq, void *dev_id)
 	unsigned int term_cond = 0;
 	int handled = 0;
 
+	umxc->irq_count++;
+
 	sr1 = readl(umxc->port.membase + MXC_UARTUSR1);
 	sr2 = readl(umxc->port.membase + MXC_UARTUSR2);
 	cr1 = readl(umxc->port.membase + MXC_UARTUCR1);
@@ -597,6 +612,8 @@ static irqreturn_t mxcuart_tx_int(int irq, void *dev_id)
 	int handled = 0;
 	volatile unsigned int sr2, cr;
 
+	umxc->irq_count++;
+
 	/* Echo cancellation for IRDA Transmit chars */
 	if (umxc->ir_mode == IRDA && echo_cancel) {
 		/* Disable the receiver */
@@ -647,6 +664,8 @@ static irqreturn_t mxcuart_rx_int(int irq, void *dev_id)
 	uart_mxc_port *umxc = dev_id;
 	int handled = 0;
 
+	umxc->irq_count++;
+
 	/* Clear the aging timer bit */
 	writel(MXC_UARTUSR1_AGTIM, umxc->port.membase + MXC_UARTUSR1);
 	mxcuart_rx_chars(umxc);
@@ -673,6 +692,8 @@ static irqreturn_t mxcuart_mint_int(int irq, void *dev_id)
 	int handled = 0;
 	volatile unsigned int sr1, sr2;
 
+	umxc->irq_count++;
+
 	sr1 = readl(umxc->port.membase + MXC_UARTUSR1);
 	sr2 = readl(umxc->port.membase + MXC_UARTUSR2);
 	/* Clear the modem status interrupt bits */
@@ -892,12 +913,15 @@ static void mxcuart_dmaread_callback(void *arg, int error, unsigned int cnt)
 	}
 
 	flip_cnt = tty_buffer_request_room(tty, cnt);
+	umxc->rx_events++;
+	umxc->port.icount.buf_overrun += cnt - max(flip_cnt, 0);
 
 	/* Check for space availability in the TTY Flip buffer */
 	if (flip_cnt <= 0) {
 		goto drop_data;
 	}
 	umxc->port.icount.rx += flip_cnt;
+	umxc->rx_bytes += flip_cnt;
 
 	tty_insert_flip_string(tty, rx_buf_elem->rx_buf, flip_cnt);
 
@@ -1841,6 +1865,83 @@ static int mxcuart_resume(struct platform_device *pdev)
  *
  * @return  The function returns 0 if successful; -1 otherwise.
  */
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *mxcuart_debugfs_root;
+
+static int mxcuart_stats_show(struct seq_file *s, void *data)
+{
+	uart_mxc_port *umxc = s->private;
+	unsigned long secs = (jiffies - umxc->stats_since) / HZ;
+
+	if (!secs)
+		secs = 1;
+	seq_printf(s, "rx mode:     %s\n", umxc->dma_enabled ? "dma" : "pio");
+	seq_printf(s, "irqs:        %lu (%lu/s)\n", umxc->irq_count,
+		   umxc->irq_count / secs);
+	seq_printf(s, "rx events:   %lu (%lu/s)\n", umxc->rx_events,
+		   umxc->rx_events / secs);
+	seq_printf(s, "rx bytes:    %lu (%lu per event)\n", umxc->rx_bytes,
+		   umxc->rx_events ? umxc->rx_bytes / umxc->rx_events : 0);
+	seq_printf(s, "overrun:     %u\n", umxc->port.icount.overrun);
+	seq_printf(s, "buf_overrun: %u\n", umxc->port.icount.buf_overrun);
+	return 0;
+}
+
+static int mxcuart_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mxcuart_stats_show, inode->i_private);
+}
+
+/* Any write restarts the rate counters */
+static ssize_t mxcuart_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	uart_mxc_port *umxc = ((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&umxc->port.lock, flags);
+	umxc->irq_count = 0;
+	umxc->rx_events = 0;
+	umxc->rx_bytes = 0;
+	umxc->stats_since = jiffies;
+	spin_unlock_irqrestore(&umxc->port.lock, flags);
+	return count;
+}
+
+static const struct file_operations mxcuart_stats_fops = {
+	.open		= mxcuart_stats_open,
+	.read		= seq_read,
+	.write		= mxcuart_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mxcuart_debugfs_add(uart_mxc_port *umxc)
+{
+	char name[16];
+
+	if (!mxcuart_debugfs_root)
+		mxcuart_debugfs_root = debugfs_create_dir("mxc_uart", NULL);
+	if (IS_ERR_OR_NULL(mxcuart_debugfs_root))
+		return;
+
+	snprintf(name, sizeof(name), "%s%d", mxc_reg.dev_name,
+		 umxc->port.line);
+	umxc->debugfs = debugfs_create_file(name, S_IRUSR | S_IWUSR,
+					    mxcuart_debugfs_root, umxc,
+					    &mxcuart_stats_fops);
+}
+
+static void mxcuart_debugfs_remove(uart_mxc_port *umxc)
+{
+	debugfs_remove(umxc->debugfs);
+	umxc->debugfs = NULL;
+}
+#else
+static inline void mxcuart_debugfs_add(uart_mxc_port *umxc) {}
+static inline void mxcuart_debugfs_remove(uart_mxc_port *umxc) {}
+#endif
+
 static int mxcuart_probe(struct platform_device *pdev)
 {
 	int id = pdev->id;
@@ -1878,6 +1979,8 @@ static int mxcuart_probe(struct platform_device *pdev)
 
 		uart_add_one_port(&mxc_reg, &mxc_ports[id]->port);
 		platform_set_drvdata(pdev, mxc_ports[id]);
+		mxc_ports[id]->stats_since = jiffies;
+		mxcuart_debugfs_add(mxc_ports[id]);
 	}
 	return 0;
 }
@@ -1898,6 +2001,7 @@ static int mxcuart_remove(struct platform_device *pdev)
 	platform_set_drvdata(pdev, NULL);
 
 	if (umxc) {
+		mxcuart_debugfs_remove(umxc);
 		uart_remove_one_port(&mxc_reg, &umxc->port);
 		iounmap(umxc->port.membase);
 	}
@@ -1947,6 +2051,9 @@ static void __exit mxcuart_exit(void)
 {
 	platform_driver_unregister(&mxcuart_driver);
 	uart_unregister_driver(&mxc_reg);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(mxcuart_debugfs_root);
+#endif
 }
 
 module_init(mxcuart_init);
@@ -1757,6 +1757,9 @@ static void uart_line_info(struct seq_file *m, struct uart_driver *drv, int i)
 		if (uport->icount.overrun)
 			seq_printf(m, " oe:%d",
 				uport->icount.overrun);
+		if (uport->icount.buf_overrun)
+			seq_printf(m, " bo:%d",
+				uport->icount.buf_overrun);
 
 #define INFOBIT(bit, str) \
 	if (uport->mctrl & (bit)) \
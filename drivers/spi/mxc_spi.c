@@ -846,6 +846,52 @@ int mxc_spi_poll_transfer(struct spi_device *spi, struct spi_transfer *t)
 	return 0;
 }
 
+/*!
+ * Exchanges that fit in the FIFO and take no longer than this on the wire
+ * are polled: an Rx interrupt plus the wakeup of the bitbang thread costs
+ * more than the transfer itself for e.g. a single 32-bit PMIC frame.
+ */
+#define MXC_SPI_POLL_MAX_US	20
+
+/*!
+ * Polls a transfer of at most one FIFO worth of words to completion.
+ *
+ * @param        master_drv_data  the spi master, clock and chipselect set up
+ * @param        count            number of words, no more than the FIFO size
+ * @param        wire_us          expected duration of the exchange
+ *
+ * @return       Returns the number of words not received.
+ */
+static int mxc_spi_poll_fifo(struct mxc_spi *master_drv_data,
+			     unsigned int count, unsigned int wire_us)
+{
+	struct mxc_spi_unique_def *def = master_drv_data->spi_ver_def;
+	unsigned int timeout = 10 * wire_us + 10;
+	unsigned int i;
+	u32 rx_tmp;
+
+	spi_put_tx_data(master_drv_data->base, count, master_drv_data);
+
+	while (((__raw_readl(master_drv_data->test_addr) & def->rx_cnt_mask)
+		>> def->rx_cnt_off) < count) {
+		if (!timeout--)
+			break;
+		udelay(1);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!(__raw_readl(master_drv_data->stat_addr) &
+		      (1 << (MXC_CSPISTAT_RR + def->int_status_dif))))
+			break;
+		rx_tmp = __raw_readl(master_drv_data->base + MXC_CSPIRXDATA);
+		if (master_drv_data->transfer.rx_buf)
+			master_drv_data->transfer.rx_get(master_drv_data,
+							 rx_tmp);
+		master_drv_data->transfer.count--;
+	}
+	return master_drv_data->transfer.count;
+}
+
 /*!
  * This function is called when the data has to transfer from/to the
  * current SPI device. It enables the Rx interrupt, initiates the transfer.
@@ -863,6 +909,7 @@ int mxc_spi_transfer(struct spi_device *spi, struct spi_transfer *t)
 	int count;
 	int chipselect_status;
 	u32 fifo_size;
+	unsigned int wire_us = UINT_MAX;
 
 	/* Get the master controller driver data from spi device's master */
 
@@ -884,6 +931,15 @@ int mxc_spi_transfer(struct spi_device *spi, struct spi_transfer *t)
 	master_drv_data->transfer.rx_buf = t->rx_buf;
 	master_drv_data->transfer.count = t->len;
 	fifo_size = master_drv_data->spi_ver_def->fifo_size;
+
+	if (t->len <= fifo_size && spi->max_speed_hz >= 1000)
+		wire_us = DIV_ROUND_UP(t->len * spi->bits_per_word * 1000,
+				       spi->max_speed_hz / 1000);
+	if (wire_us <= MXC_SPI_POLL_MAX_US) {
+		mxc_spi_poll_fifo(master_drv_data, t->len, wire_us);
+		goto out;
+	}
+
 	INIT_COMPLETION(master_drv_data->xfer_done);
 
 	/* Enable the Rx Interrupts */
@@ -907,6 +963,7 @@ int mxc_spi_transfer(struct spi_device *spi, struct spi_transfer *t)
 				    master_drv_data->spi_ver_def->
 				    rx_inten_dif));
 
+out:
 	clk_disable(master_drv_data->clk);
 	if (master_drv_data->chipselect_inactive)
 		master_drv_data->chipselect_inactive(spi->master->bus_num,
@@ -19,6 +19,7 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
@@ -36,7 +37,10 @@
 
 #include "binder.h"
 
-static DEFINE_MUTEX(binder_lock);
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+
+static DEFINE_MUTEX(binder_main_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 
 static HLIST_HEAD(binder_procs);
@@ -105,6 +109,14 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/*
+ * Pages freed from a proc's buffer stay mapped, up to this many per proc,
+ * so the next parcels reuse them without another map/unmap round trip.
+ */
+static int binder_cached_pages_max = 16;
+module_param_named(cached_pages_max, binder_cached_pages_max,
+		   int, S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -150,6 +162,8 @@ struct binder_stats {
 	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
+	int proc_wakeups;	/* wakeups for process work */
+	int spurious_wakeups;	/* looper woke and found nothing to do */
 };
 
 static struct binder_stats binder_stats;
@@ -164,6 +178,103 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	binder_stats.obj_created[type]++;
 }
 
+/*
+ * binder_main_lock still serializes nearly all of binder. Record, per
+ * call site, how often it is taken, how often a caller had to wait and
+ * for how long, and how long it was held afterwards, so that the parts
+ * worth splitting out from under it can be found.
+ */
+enum binder_lock_site {
+	BINDER_LOCK_IOCTL,
+	BINDER_LOCK_READ,	/* retaken after waiting for work */
+	BINDER_LOCK_POLL,
+	BINDER_LOCK_OPEN,
+	BINDER_LOCK_DEFERRED,
+	BINDER_LOCK_DEBUGFS,
+	BINDER_LOCK_SITE_COUNT
+};
+
+static const char * const binder_lock_site_strings[] = {
+	"ioctl",
+	"read",
+	"poll",
+	"open",
+	"deferred",
+	"debugfs"
+};
+
+struct binder_lock_stats {
+	u32 acquired;
+	u32 contended;
+	u64 wait_ns;
+	u64 max_wait_ns;
+	u64 hold_ns;
+	u64 max_hold_ns;
+};
+
+static struct binder_lock_stats binder_lock_stats[BINDER_LOCK_SITE_COUNT];
+static enum binder_lock_site binder_lock_holder;
+static unsigned long long binder_lock_taken_ns;
+
+static inline void binder_lock(enum binder_lock_site site)
+{
+	struct binder_lock_stats *stats = &binder_lock_stats[site];
+	unsigned long long start, wait;
+
+	if (!mutex_trylock(&binder_main_lock)) {
+		start = sched_clock();
+		mutex_lock(&binder_main_lock);
+		wait = sched_clock() - start;
+		stats->contended++;
+		stats->wait_ns += wait;
+		if (wait > stats->max_wait_ns)
+			stats->max_wait_ns = wait;
+	}
+	stats->acquired++;
+	binder_lock_holder = site;
+	binder_lock_taken_ns = sched_clock();
+}
+
+static inline void binder_unlock(void)
+{
+	struct binder_lock_stats *stats = &binder_lock_stats[binder_lock_holder];
+	unsigned long long hold = sched_clock() - binder_lock_taken_ns;
+
+	stats->hold_ns += hold;
+	if (hold > stats->max_hold_ns)
+		stats->max_hold_ns = hold;
+	mutex_unlock(&binder_main_lock);
+}
+
+/*
+ * Transaction latency by (calling proc, target node, code): how long
+ * calls wait until a target thread reads them, and how long two-way
+ * calls take until the caller reads the reply. Power-of-two
+ * microsecond buckets, protected by binder_main_lock.
+ */
+#define BINDER_LAT_ENTRIES	64
+#define BINDER_LAT_BUCKETS	16
+
+struct binder_lat_hist {
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t total_us;
+	uint32_t bucket[BINDER_LAT_BUCKETS];
+};
+
+struct binder_lat_entry {
+	int in_use;
+	int proc;
+	int node;
+	int to_proc;
+	unsigned int code;
+	struct binder_lat_hist deliver;
+	struct binder_lat_hist reply;
+};
+
+static struct binder_lat_entry binder_lat_table[BINDER_LAT_ENTRIES];
+static uint32_t binder_lat_dropped;	/* no free entry for the key */
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int call_type;
@@ -175,6 +286,7 @@ struct binder_transaction_log_entry {
 	int to_node;
 	int data_size;
 	int offsets_size;
+	struct timespec timestamp;	/* CLOCK_MONOTONIC */
 };
 struct binder_transaction_log {
 	int next;
@@ -279,6 +391,15 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+struct binder_alloc_stats {
+	uint32_t allocs;
+	uint64_t alloc_ns;
+	uint64_t max_alloc_ns;
+	uint32_t pages_mapped;
+	uint32_t pages_unmapped;
+	uint32_t pages_reused;	/* found still mapped from a freed buffer */
+};
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
@@ -302,6 +423,8 @@ struct binder_proc {
 	struct page **pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
+	int cached_pages;	/* free, but left mapped */
+	struct binder_alloc_stats alloc_stats;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
@@ -355,11 +478,75 @@ struct binder_transaction {
 	long	priority;
 	long	saved_priority;
 	uid_t	sender_euid;
+
+	/* latency profiling, see binder_lat_record() */
+	u64	queued_ns;	/* when it was put on the target's todo */
+	u64	call_ns;	/* replies: when the call was queued */
+	int	lat_proc;	/* caller, target node and code of the call */
+	int	lat_node;
+	int	lat_to_proc;
+	unsigned int lat_code;
 };
 
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 
+/*
+ * Looper threads wait on proc->wait exclusively, so this wakes exactly
+ * one idle looper instead of the whole pool; any poll() waiters are
+ * woken as well.
+ */
+static void binder_wakeup_proc(struct binder_proc *proc)
+{
+	binder_stats.proc_wakeups++;
+	proc->stats.proc_wakeups++;
+	wake_up_interruptible_nr(&proc->wait, 1);
+}
+
+static void binder_lat_add(struct binder_lat_hist *hist, u64 ns)
+{
+	u64 us = div_u64(ns, 1000);
+
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = min_t(u64, us, UINT_MAX);
+	hist->bucket[min_t(int, fls64(us), BINDER_LAT_BUCKETS - 1)]++;
+}
+
+/* Called as t is returned to userspace as BR_TRANSACTION or BR_REPLY */
+static void binder_lat_record(struct binder_transaction *t, int reply,
+			      u64 now)
+{
+	struct binder_lat_entry *e;
+	u32 hash = jhash_3words(t->lat_proc, t->lat_node, t->lat_code, 0);
+	int i;
+
+	for (i = 0; i < BINDER_LAT_ENTRIES; i++) {
+		e = &binder_lat_table[(hash + i) % BINDER_LAT_ENTRIES];
+		if (!e->in_use) {
+			e->in_use = 1;
+			e->proc = t->lat_proc;
+			e->node = t->lat_node;
+			e->to_proc = t->lat_to_proc;
+			e->code = t->lat_code;
+			break;
+		}
+		if (e->proc == t->lat_proc && e->node == t->lat_node &&
+		    e->code == t->lat_code)
+			break;
+	}
+	if (i == BINDER_LAT_ENTRIES) {
+		binder_lat_dropped++;
+		return;
+	}
+
+	if (reply)
+		binder_lat_add(&e->reply, now - t->call_ns);
+	else
+		binder_lat_add(&e->deliver, now - t->queued_ns);
+}
+
 /*
  * copied from get_unused_fd_flags
  */
@@ -611,11 +798,15 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
 {
-	void *page_addr;
+	void *page_addr, *stop;
 	unsigned long user_page_addr;
 	struct vm_struct tmp_area;
 	struct page **page;
+	struct page **page_array_ptr;
 	struct mm_struct *mm;
+	int mapped = 0;
+	int i, n;
+	int ret;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: %s pages %p-%p\n", proc->pid,
@@ -624,6 +815,24 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	if (end <= start)
 		return 0;
 
+	/*
+	 * Pages kept mapped need neither the mm nor mmap_sem: if the whole
+	 * range is already mapped, or fits in the cache, we are done.
+	 */
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+		if (proc->pages[(page_addr - proc->buffer) / PAGE_SIZE])
+			mapped++;
+	n = (end - start) / PAGE_SIZE;
+	if (allocate && mapped == n) {
+		proc->cached_pages -= n;
+		proc->alloc_stats.pages_reused += n;
+		return 0;
+	}
+	if (!allocate && proc->cached_pages + mapped <= binder_cached_pages_max) {
+		proc->cached_pages += mapped;
+		return 0;
+	}
+
 	if (vma)
 		mm = NULL;
 	else
@@ -643,38 +852,53 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		goto err_no_vma;
 	}
 
-	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		int ret;
-		struct page **page_array_ptr;
+	for (page_addr = start; page_addr < end; page_addr += n * PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
-		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
-		if (*page == NULL) {
-			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
-			       "for page at %p\n", proc->pid, page_addr);
-			goto err_alloc_page_failed;
+		if (*page) {
+			/* Left mapped when its last buffer was freed */
+			proc->cached_pages--;
+			proc->alloc_stats.pages_reused++;
+			n = 1;
+			continue;
+		}
+
+		/* Map each run of missing pages into the kernel in one go */
+		for (n = 0; page_addr + n * PAGE_SIZE < end && !page[n]; n++) {
+			page[n] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+			if (page[n] == NULL) {
+				printk(KERN_ERR "binder: %d: binder_alloc_buf "
+				       "failed for page at %p\n", proc->pid,
+				       page_addr + n * PAGE_SIZE);
+				i = 0;
+				goto err_alloc_page_failed;
+			}
 		}
 		tmp_area.addr = page_addr;
-		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
+		tmp_area.size = n * PAGE_SIZE + PAGE_SIZE /* guard page? */;
 		page_array_ptr = page;
 		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
 		if (ret) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
 			       "to map page at %p in kernel\n",
 			       proc->pid, page_addr);
+			i = 0;
 			goto err_map_kernel_failed;
 		}
-		user_page_addr =
-			(uintptr_t)page_addr + proc->user_buffer_offset;
-		ret = vm_insert_page(vma, user_page_addr, page[0]);
-		if (ret) {
-			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
-			       "to map page at %lx in userspace\n",
-			       proc->pid, user_page_addr);
-			goto err_vm_insert_page_failed;
+		for (i = 0; i < n; i++) {
+			user_page_addr = (uintptr_t)page_addr + i * PAGE_SIZE +
+				proc->user_buffer_offset;
+			ret = vm_insert_page(vma, user_page_addr, page[i]);
+			if (ret) {
+				printk(KERN_ERR "binder: %d: binder_alloc_buf "
+				       "failed to map page at %lx in "
+				       "userspace\n", proc->pid,
+				       user_page_addr);
+				goto err_map_kernel_failed;
+			}
+			/* vm_insert_page does not seem to increment the refcount */
 		}
-		/* vm_insert_page does not seem to increment the refcount */
+		proc->alloc_stats.pages_mapped += n;
 	}
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -686,17 +910,45 @@ free_range:
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		if (*page == NULL)
+			continue;
+		if (proc->cached_pages < binder_cached_pages_max) {
+			proc->cached_pages++;
+			continue;
+		}
 		if (vma)
 			zap_page_range(vma, (uintptr_t)page_addr +
 				proc->user_buffer_offset, PAGE_SIZE, NULL);
-err_vm_insert_page_failed:
 		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-err_map_kernel_failed:
 		__free_page(*page);
 		*page = NULL;
+		proc->alloc_stats.pages_unmapped++;
+	}
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+	return 0;
+
+err_map_kernel_failed:
+	/* Pages i..n-1 of this run are not mapped into userspace */
+	unmap_kernel_range((unsigned long)page_addr + i * PAGE_SIZE,
+			   (n - i) * PAGE_SIZE);
+	proc->alloc_stats.pages_mapped += i;
 err_alloc_page_failed:
-		;
+	stop = page_addr + i * PAGE_SIZE;
+	for (; i < n; i++) {
+		if (page[i])
+			__free_page(page[i]);
+		page[i] = NULL;
 	}
+	/*
+	 * What did get mapped is not used by any buffer now: keep it as
+	 * cached pages, which is also what the pages reused above were.
+	 */
+	for (page_addr = start; page_addr < stop; page_addr += PAGE_SIZE)
+		if (proc->pages[(page_addr - proc->buffer) / PAGE_SIZE])
+			proc->cached_pages++;
 err_no_vma:
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -705,7 +957,7 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
 					      size_t data_size,
 					      size_t offsets_size, int is_async)
 {
@@ -811,6 +1063,26 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_alloc_stats *stats = &proc->alloc_stats;
+	struct binder_buffer *buffer;
+	unsigned long long start = sched_clock();
+	unsigned long long t;
+
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size, is_async);
+
+	t = sched_clock() - start;
+	stats->allocs++;
+	stats->alloc_ns += t;
+	if (t > stats->max_alloc_ns)
+		stats->max_alloc_ns = t;
+
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -1035,7 +1307,7 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 	if (node->proc && (node->has_strong_ref || node->has_weak_ref)) {
 		if (list_empty(&node->work.entry)) {
 			list_add_tail(&node->work.entry, &node->proc->todo);
-			wake_up_interruptible(&node->proc->wait);
+			binder_wakeup_proc(node->proc);
 		}
 	} else {
 		if (hlist_empty(&node->refs) && !node->local_strong_refs &&
@@ -1398,6 +1670,7 @@ static void binder_transaction(struct binder_proc *proc,
 	e->target_handle = tr->target.handle;
 	e->data_size = tr->data_size;
 	e->offsets_size = tr->offsets_size;
+	ktime_get_ts(&e->timestamp);
 
 	if (reply) {
 		in_reply_to = thread->transaction_stack;
@@ -1543,6 +1816,18 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	if (reply) {
+		t->call_ns = in_reply_to->queued_ns;
+		t->lat_proc = in_reply_to->lat_proc;
+		t->lat_node = in_reply_to->lat_node;
+		t->lat_to_proc = in_reply_to->lat_to_proc;
+		t->lat_code = in_reply_to->lat_code;
+	} else {
+		t->lat_proc = proc->pid;
+		t->lat_node = target_node->debug_id;
+		t->lat_to_proc = target_proc->pid;
+		t->lat_code = tr->code;
+	}
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
@@ -1733,11 +2018,17 @@ static void binder_transaction(struct binder_proc *proc,
 			target_node->has_async_transaction = 1;
 	}
 	t->work.type = BINDER_WORK_TRANSACTION;
+	t->queued_ns = sched_clock();
 	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
-	if (target_wait)
+	trace_binder_transaction(t->debug_id, reply, proc->pid, thread->pid,
+		target_proc->pid, target_thread ? target_thread->pid : 0,
+		target_node ? target_node->debug_id : 0, t->code, t->flags);
+	if (target_thread)
 		wake_up_interruptible(target_wait);
+	else if (target_wait)
+		binder_wakeup_proc(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1952,6 +2243,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				     proc->pid, thread->pid, data_ptr, buffer->debug_id,
 				     buffer->transaction ? "active" : "finished");
 
+			trace_binder_transaction_buffer_free(buffer->debug_id,
+				proc->pid,
+				buffer->data_size + buffer->offsets_size);
+
 			if (buffer->transaction) {
 				buffer->transaction->buffer = NULL;
 				buffer->transaction = NULL;
@@ -2083,7 +2378,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 						list_add_tail(&ref->death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&ref->death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						binder_wakeup_proc(proc);
 					}
 				}
 			} else {
@@ -2113,7 +2408,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 						list_add_tail(&death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						binder_wakeup_proc(proc);
 					}
 				} else {
 					BUG_ON(death->work.type != BINDER_WORK_DEAD_BINDER);
@@ -2153,7 +2448,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					list_add_tail(&death->work.entry, &thread->todo);
 				} else {
 					list_add_tail(&death->work.entry, &proc->todo);
-					wake_up_interruptible(&proc->wait);
+					binder_wakeup_proc(proc);
 				}
 			}
 		} break;
@@ -2201,6 +2496,7 @@ static int binder_thread_read(struct binder_proc *proc,
 
 	int ret = 0;
 	int wait_for_proc_work;
+	int waited = 0;
 
 	if (*consumed == 0) {
 		if (put_user(BR_NOOP, (uint32_t __user *)ptr))
@@ -2230,9 +2526,10 @@ retry:
 
 
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
+	waited = !non_block;
 	if (wait_for_proc_work)
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2256,7 +2553,9 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
+	binder_lock(BINDER_LOCK_READ);
+	if (!ret)
+		trace_binder_wakeup(proc->pid, thread->pid, wait_for_proc_work);
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
@@ -2275,8 +2574,13 @@ retry:
 		else if (!list_empty(&proc->todo) && wait_for_proc_work)
 			w = list_first_entry(&proc->todo, struct binder_work, entry);
 		else {
-			if (ptr - buffer == 4 && !(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN)) /* no data added */
+			if (ptr - buffer == 4 && !(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN)) { /* no data added */
+				if (waited && wait_for_proc_work) {
+					binder_stats.spurious_wakeups++;
+					proc->stats.spurious_wakeups++;
+				}
 				goto retry;
+			}
 			break;
 		}
 
@@ -2446,6 +2750,14 @@ retry:
 			return -EFAULT;
 		ptr += sizeof(tr);
 
+		{
+			u64 now = sched_clock();
+
+			trace_binder_transaction_received(t->debug_id,
+				proc->pid, thread->pid, now - t->queued_ns);
+			binder_lat_record(t, cmd == BR_REPLY, now);
+		}
+
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "binder: %d:%d %s %d %d:%d, cmd %d"
@@ -2598,12 +2910,12 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
+	binder_lock(BINDER_LOCK_POLL);
 	thread = binder_get_thread(proc);
 
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2635,7 +2947,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
+	binder_lock(BINDER_LOCK_IOCTL);
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
@@ -2744,7 +3056,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2885,13 +3197,13 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
 	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	binder_lock(BINDER_LOCK_OPEN);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -3071,7 +3383,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		binder_lock(BINDER_LOCK_DEFERRED);
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3098,7 +3410,7 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_RELEASE)
 			binder_deferred_release(proc); /* frees proc */
 
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3343,6 +3655,28 @@ static const char *binder_objstat_strings[] = {
 	"transaction_complete"
 };
 
+static void print_binder_lock_stats(struct seq_file *m)
+{
+	struct binder_lock_stats *stats;
+	int i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(binder_lock_stats) !=
+		     ARRAY_SIZE(binder_lock_site_strings));
+	seq_puts(m, "lock:\n");
+	for (i = 0; i < ARRAY_SIZE(binder_lock_stats); i++) {
+		stats = &binder_lock_stats[i];
+		if (!stats->acquired)
+			continue;
+		seq_printf(m, "  %s: acquired %u contended %u wait_us %llu max %llu "
+			   "hold_us %llu max %llu\n", binder_lock_site_strings[i],
+			   stats->acquired, stats->contended,
+			   div_u64(stats->wait_ns, 1000),
+			   div_u64(stats->max_wait_ns, 1000),
+			   div_u64(stats->hold_ns, 1000),
+			   div_u64(stats->max_hold_ns, 1000));
+	}
+}
+
 static void print_binder_stats(struct seq_file *m, const char *prefix,
 			       struct binder_stats *stats)
 {
@@ -3375,6 +3709,10 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 				stats->obj_created[i] - stats->obj_deleted[i],
 				stats->obj_created[i]);
 	}
+
+	if (stats->proc_wakeups || stats->spurious_wakeups)
+		seq_printf(m, "%swakeups: proc %d spurious %d\n", prefix,
+			   stats->proc_wakeups, stats->spurious_wakeups);
 }
 
 static void print_binder_proc_stats(struct seq_file *m,
@@ -3394,6 +3732,16 @@ static void print_binder_proc_stats(struct seq_file *m,
 			"  free async space %zd\n", proc->requested_threads,
 			proc->requested_threads_started, proc->max_threads,
 			proc->ready_threads, proc->free_async_space);
+	seq_printf(m, "  allocs: %u avg_us %llu max_us %llu\n"
+			"  pages mapped %u unmapped %u reused %u cached %d\n",
+			proc->alloc_stats.allocs,
+			proc->alloc_stats.allocs ?
+			div_u64(div_u64(proc->alloc_stats.alloc_ns,
+				proc->alloc_stats.allocs), 1000) : 0,
+			div_u64(proc->alloc_stats.max_alloc_ns, 1000),
+			proc->alloc_stats.pages_mapped,
+			proc->alloc_stats.pages_unmapped,
+			proc->alloc_stats.pages_reused, proc->cached_pages);
 	count = 0;
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n))
 		count++;
@@ -3439,7 +3787,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(BINDER_LOCK_DEBUGFS);
 
 	seq_puts(m, "binder state:\n");
 
@@ -3451,7 +3799,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3462,16 +3810,17 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(BINDER_LOCK_DEBUGFS);
 
 	seq_puts(m, "binder stats:\n");
 
 	print_binder_stats(m, "", &binder_stats);
+	print_binder_lock_stats(m);
 
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3482,13 +3831,13 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(BINDER_LOCK_DEBUGFS);
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3498,11 +3847,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock(BINDER_LOCK_DEBUGFS);
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3510,11 +3859,13 @@ static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
 {
 	seq_printf(m,
-		   "%d: %s from %d:%d to %d:%d node %d handle %d size %d:%d\n",
+		   "%d: %s from %d:%d to %d:%d node %d handle %d size %d:%d "
+		   "at %ld.%06ld\n",
 		   e->debug_id, (e->call_type == 2) ? "reply" :
 		   ((e->call_type == 1) ? "async" : "call "), e->from_proc,
 		   e->from_thread, e->to_proc, e->to_thread, e->to_node,
-		   e->target_handle, e->data_size, e->offsets_size);
+		   e->target_handle, e->data_size, e->offsets_size,
+		   (long)e->timestamp.tv_sec, e->timestamp.tv_nsec / 1000);
 }
 
 static int binder_transaction_log_show(struct seq_file *m, void *unused)
@@ -3531,6 +3882,72 @@ static int binder_transaction_log_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_lat_hist(struct seq_file *m, const char *name,
+				  struct binder_lat_hist *hist)
+{
+	int i;
+
+	if (!hist->count)
+		return;
+	seq_printf(m, "  %s: count %u avg_us %llu max_us %u buckets", name,
+		   hist->count, div_u64(hist->total_us, hist->count),
+		   hist->max_us);
+	for (i = 0; i < BINDER_LAT_BUCKETS; i++)
+		seq_printf(m, " %u", hist->bucket[i]);
+	seq_puts(m, "\n");
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_lat_entry *e;
+	int do_lock = !binder_debug_no_lock;
+	int i;
+
+	if (do_lock)
+		binder_lock(BINDER_LOCK_DEBUGFS);
+	seq_printf(m, "binder latency (bucket n: < 2^n us), dropped %u:\n",
+		   binder_lat_dropped);
+	for (i = 0; i < BINDER_LAT_ENTRIES; i++) {
+		e = &binder_lat_table[i];
+		if (!e->in_use)
+			continue;
+		seq_printf(m, "proc %d -> node %d (proc %d) code 0x%x\n",
+			   e->proc, e->node, e->to_proc, e->code);
+		print_binder_lat_hist(m, "deliver", &e->deliver);
+		print_binder_lat_hist(m, "reply", &e->reply);
+	}
+	if (do_lock)
+		binder_unlock();
+	return 0;
+}
+
+static int binder_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, binder_latency_show, inode->i_private);
+}
+
+/* Any write clears the table */
+static ssize_t binder_latency_write(struct file *file,
+				    const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	binder_lock(BINDER_LOCK_DEBUGFS);
+	memset(binder_lat_table, 0, sizeof(binder_lat_table));
+	binder_lat_dropped = 0;
+	binder_unlock();
+
+	return count;
+}
+
+static const struct file_operations binder_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_latency_open,
+	.read = seq_read,
+	.write = binder_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -3591,6 +4008,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO | S_IWUSR,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 	return ret;
 }
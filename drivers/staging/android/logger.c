@@ -25,6 +25,9 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/timer.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
@@ -34,14 +37,17 @@
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * spinlock 'lock'. Nothing that can sleep or fault is done under it: writers
+ * copy their payload in from user space before taking it and readers copy
+ * the entry out to user space after dropping it, so a writer never waits for
+ * more than the memcpy of another entry.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
+	spinlock_t		lock;	/* lock protecting buffer */
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
@@ -51,17 +57,63 @@ struct logger_log {
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. The structure is protected by log->lock, except for
+ * the bounce buffer: read_mutex keeps it from being refilled by another
+ * read() on the same file before it has been copied out.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
 	size_t			r_off;	/* current read head offset */
+	char			*entry;	/* bounce buffer, LOGGER_ENTRY_MAX_LEN */
+	struct mutex		read_mutex; /* serializes users of 'entry' */
+	__u32			lapped;	/* times fix_up_readers() moved r_off */
+	struct logger_batch	batch;	/* batched wakeup thresholds */
+	int			batch_ready; /* threshold met, not caught up */
+	struct timer_list	batch_timer; /* fires batch.ms after data */
 };
 
+/*
+ * Payloads up to this size are staged on the writer's stack, larger ones
+ * in a kmalloc()ed buffer.
+ */
+#define LOGGER_STACK_PAYLOAD	256
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
+/*
+ * logger_reader_ready - whether poll() and read() should report data to
+ * 'reader', given its batching thresholds.
+ *
+ * Caller must hold log->lock.
+ */
+static int logger_reader_ready(struct logger_log *log,
+			       struct logger_reader *reader)
+{
+	if (log->w_off == reader->r_off)
+		return 0;
+	if (!reader->batch.bytes && !reader->batch.ms)
+		return 1;
+	return reader->batch_ready;
+}
+
+/* reader has everything; batch up the next wakeup again */
+static void logger_reader_caught_up(struct logger_log *log,
+				    struct logger_reader *reader)
+{
+	if (log->w_off == reader->r_off)
+		reader->batch_ready = 0;
+}
+
+static void logger_batch_timeout(unsigned long data)
+{
+	struct logger_reader *reader = (struct logger_reader *) data;
+
+	reader->batch_ready = 1;
+	wake_up_interruptible(&reader->log->wq);
+}
+
 /*
  * file_get_log - Given a file structure, return the associated log
  *
@@ -89,7 +141,7 @@ static inline struct logger_log *file_get_log(struct file *file)
  * get_entry_len - Grabs the length of the payload of the next entry starting
  * from 'off'.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_len(struct logger_log *log, size_t off)
 {
@@ -108,15 +160,13 @@ static __u32 get_entry_len(struct logger_log *log, size_t off)
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - reads exactly 'count' bytes from 'log' into the reader's
+ * bounce buffer and advances its read head.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static void do_read_log(struct logger_log *log, struct logger_reader *reader,
+			size_t count)
 {
 	size_t len;
 
@@ -126,20 +176,16 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * the log, whichever comes first.
 	 */
 	len = min(count, log->size - reader->r_off);
-	if (copy_to_user(buf, log->buffer + reader->r_off, len))
-		return -EFAULT;
+	memcpy(reader->entry, log->buffer + reader->r_off, len);
 
 	/*
 	 * Second, we read any remaining bytes, starting back at the head of
 	 * the log.
 	 */
 	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+		memcpy(reader->entry + len, log->buffer, count - len);
 
 	reader->r_off = logger_offset(reader->r_off + count);
-
-	return count;
 }
 
 /*
@@ -166,9 +212,9 @@ start:
 	while (1) {
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		mutex_lock(&log->mutex);
-		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_lock(&log->lock);
+		ret = !logger_reader_ready(log, reader);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -189,27 +235,44 @@ start:
 	if (ret)
 		return ret;
 
-	mutex_lock(&log->mutex);
+	if (mutex_lock_interruptible(&reader->read_mutex))
+		return -EINTR;
+
+	spin_lock(&log->lock);
 
 	/* is there still something to read or did we race? */
 	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
+		mutex_unlock(&reader->read_mutex);
 		goto start;
 	}
 
 	/* get the size of the next entry */
 	ret = get_entry_len(log, reader->r_off);
+	if (unlikely(ret > LOGGER_ENTRY_MAX_LEN)) {
+		/* r_off is not at an entry; nothing after it can be trusted */
+		reader->r_off = log->w_off;
+		logger_reader_caught_up(log, reader);
+		spin_unlock(&log->lock);
+		ret = -EIO;
+		goto out;
+	}
 	if (count < ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
 	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	do_read_log(log, reader, ret);
+	logger_reader_caught_up(log, reader);
 
-out:
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
+	if (copy_to_user(buf, reader->entry, ret))
+		ret = -EFAULT;
+out:
+	mutex_unlock(&reader->read_mutex);
 	return ret;
 }
 
@@ -217,7 +280,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -255,26 +318,54 @@ static inline int clock_interval(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * Also works out which readers the write should wake: all non-batching
+ * ones, and batching ones whose byte threshold it crosses. Batching readers
+ * that had nothing pending get their timer armed instead.
+ *
+ * Returns nonzero if the readers' wait queue needs a wakeup.
+ *
+ * The caller needs to hold log->lock.
  */
-static void fix_up_readers(struct logger_log *log, size_t len)
+static int fix_up_readers(struct logger_log *log, size_t len)
 {
 	size_t old = log->w_off;
 	size_t new = logger_offset(old + len);
 	struct logger_reader *reader;
+	int wake = 0;
 
 	if (clock_interval(old, new, log->head))
 		log->head = get_next_entry(log, log->head, len);
 
-	list_for_each_entry(reader, &log->readers, list)
-		if (clock_interval(old, new, reader->r_off))
+	list_for_each_entry(reader, &log->readers, list) {
+		int was_empty = reader->r_off == old;
+
+		if (clock_interval(old, new, reader->r_off)) {
 			reader->r_off = get_next_entry(log, reader->r_off, len);
+			reader->lapped++;
+		}
+
+		if (!reader->batch.bytes && !reader->batch.ms) {
+			wake = 1;
+		} else if (!reader->batch_ready) {
+			if (reader->batch.bytes &&
+			    logger_offset(new - reader->r_off) >=
+			    reader->batch.bytes) {
+				reader->batch_ready = 1;
+				wake = 1;
+			} else if (reader->batch.ms && was_empty) {
+				mod_timer(&reader->batch_timer, jiffies +
+					  msecs_to_jiffies(reader->batch.ms));
+			}
+		}
+	}
+
+	return wake;
 }
 
 /*
  * do_write_log - writes 'len' bytes from 'buf' to 'log'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 {
@@ -290,45 +381,24 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 
 }
 
-/*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
- */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
-{
-	size_t len;
-
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
-
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			return -EFAULT;
-
-	log->w_off = logger_offset(log->w_off + count);
-
-	return count;
-}
-
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The payload is gathered from user space first, where we may fault, and
+ * then the entry is claimed and copied in with log->lock held.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	char stack_payload[LOGGER_STACK_PAYLOAD];
+	char *payload = stack_payload;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
+	int wake;
 
 	now = current_kernel_time();
 
@@ -342,41 +412,48 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	if (header.len > sizeof(stack_payload)) {
+		payload = kmalloc(header.len, GFP_KERNEL);
+		if (!payload)
+			return -ENOMEM;
+	}
 
-	while (nr_segs-- > 0) {
+	while (nr_segs-- > 0 && ret < header.len) {
 		size_t len;
-		ssize_t nr;
 
 		/* figure out how much of this vector we can keep */
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+		if (len && copy_from_user(payload + ret, iov->iov_base, len)) {
+			ret = -EFAULT;
+			goto out;
 		}
 
 		iov++;
-		ret += nr;
+		ret += len;
 	}
+	header.len = ret;
 
-	mutex_unlock(&log->mutex);
+	spin_lock(&log->lock);
+
+	/*
+	 * Fix up any readers, pulling them forward to the first readable
+	 * entry after (what will be) the new write offset.
+	 */
+	wake = fix_up_readers(log, sizeof(struct logger_entry) + header.len);
+
+	do_write_log(log, &header, sizeof(struct logger_entry));
+	do_write_log(log, payload, header.len);
+
+	spin_unlock(&log->lock);
 
 	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	if (wake)
+		wake_up_interruptible(&log->wq);
+
+out:
+	if (payload != stack_payload)
+		kfree(payload);
 
 	return ret;
 }
@@ -408,13 +485,26 @@ static int logger_open(struct inode *inode, struct file *file)
 		if (!reader)
 			return -ENOMEM;
 
+		reader->entry = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->entry) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
+		mutex_init(&reader->read_mutex);
 		INIT_LIST_HEAD(&reader->list);
-
-		mutex_lock(&log->mutex);
+		reader->lapped = 0;
+		reader->batch.bytes = 0;
+		reader->batch.ms = 0;
+		reader->batch_ready = 0;
+		setup_timer(&reader->batch_timer, logger_batch_timeout,
+			    (unsigned long) reader);
+
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -432,7 +522,13 @@ static int logger_release(struct inode *ignored, struct file *file)
 {
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader = file->private_data;
+		struct logger_log *log = reader->log;
+
+		spin_lock(&log->lock);
 		list_del(&reader->list);
+		spin_unlock(&log->lock);
+		del_timer_sync(&reader->batch_timer);
+		kfree(reader->entry);
 		kfree(reader);
 	}
 
@@ -462,21 +558,108 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
-	if (log->w_off != reader->r_off)
+	spin_lock(&log->lock);
+	if (logger_reader_ready(log, reader))
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
 
+/*
+ * is_entry_offset - whether 'off' is where an entry starts, or w_off,
+ * walking from 'reader''s read head, which always is.
+ *
+ * Caller must hold log->lock.
+ */
+static int is_entry_offset(struct logger_log *log,
+			   struct logger_reader *reader, size_t off)
+{
+	size_t pos = reader->r_off;
+
+	while (pos != off && pos != log->w_off)
+		pos = logger_offset(pos + get_entry_len(log, pos));
+
+	return pos == off;
+}
+
+/*
+ * logger_mmap - map the log ring read-only, for zero-copy readers
+ *
+ * See struct logger_read_state for how to consume entries this way. The
+ * ring is mapped a page at a time, so it does not have to be physically
+ * contiguous (a modular logger's buffers are in module space).
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_log *log = file_get_log(file);
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long off, pfn;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+	if (vma->vm_pgoff || size > log->size)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_RESERVED;
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		void *addr = log->buffer + off;
+
+		if (is_vmalloc_or_module_addr(addr))
+			pfn = vmalloc_to_pfn(addr);
+		else
+			pfn = virt_to_phys(addr) >> PAGE_SHIFT;
+
+		ret = remap_pfn_range(vma, vma->vm_start + off, pfn,
+				      PAGE_SIZE, vma->vm_page_prot);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	struct logger_read_state state;
+	struct logger_batch batch;
 	long ret = -ENOTTY;
 
-	mutex_lock(&log->mutex);
+	switch (cmd) {
+	case LOGGER_GET_READ_STATE:
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		reader = file->private_data;
+		spin_lock(&log->lock);
+		state.w_off = log->w_off;
+		state.r_off = reader->r_off;
+		state.lapped = reader->lapped;
+		spin_unlock(&log->lock);
+		if (copy_to_user((void __user *) arg, &state, sizeof(state)))
+			return -EFAULT;
+		return 0;
+	case LOGGER_SET_BATCH:
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		if (copy_from_user(&batch, (void __user *) arg, sizeof(batch)))
+			return -EFAULT;
+		reader = file->private_data;
+		spin_lock(&log->lock);
+		reader->batch = batch;
+		reader->batch_ready = 0;
+		spin_unlock(&log->lock);
+		/* don't leave a reader waiting on a threshold it just lowered */
+		wake_up_interruptible(&log->wq);
+		return 0;
+	}
+
+	spin_lock(&log->lock);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -509,14 +692,34 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EBADF;
 			break;
 		}
-		list_for_each_entry(reader, &log->readers, list)
+		list_for_each_entry(reader, &log->readers, list) {
 			reader->r_off = log->w_off;
+			reader->batch_ready = 0;
+		}
 		log->head = log->w_off;
 		ret = 0;
 		break;
+	case LOGGER_SET_READ_OFF:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		/* only forward, to an entry within what has been written */
+		if (arg >= log->size ||
+		    logger_offset(arg - reader->r_off) >
+		    logger_offset(log->w_off - reader->r_off) ||
+		    !is_entry_offset(log, reader, arg)) {
+			ret = -EINVAL;
+			break;
+		}
+		reader->r_off = arg;
+		logger_reader_caught_up(log, reader);
+		ret = 0;
+		break;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -528,6 +731,7 @@ static const struct file_operations logger_fops = {
 	.poll = logger_poll,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
+	.mmap = logger_mmap,
 	.open = logger_open,
 	.release = logger_release,
 };
@@ -535,10 +739,11 @@ static const struct file_operations logger_fops = {
 /*
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
  * must be a power of two, greater than LOGGER_ENTRY_MAX_LEN, and less than
- * LONG_MAX minus LOGGER_ENTRY_MAX_LEN.
+ * LONG_MAX minus LOGGER_ENTRY_MAX_LEN. The buffer is page aligned so it can
+ * be mmap()ed.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(PAGE_SIZE); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -549,7 +754,7 @@ static struct logger_log VAR = { \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
@@ -46,4 +46,31 @@ struct logger_entry {
 #define LOGGER_GET_NEXT_ENTRY_LEN	_IO(__LOGGERIO, 3) /* next entry len */
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 
+/*
+ * Zero-copy reading: a reader may mmap() the log ring read-only (offset 0,
+ * LOGGER_GET_LOG_BUF_SIZE bytes), copy out the entries in [r_off, w_off),
+ * check that 'lapped' did not change meanwhile (a writer overwrote what it
+ * was reading) and then move its read head with LOGGER_SET_READ_OFF, to the
+ * start of an entry or to w_off; other offsets fail with EINVAL.
+ */
+struct logger_read_state {
+	__u32		w_off;	/* write head offset into the ring */
+	__u32		r_off;	/* this reader's read head offset */
+	__u32		lapped;	/* times the writer pulled r_off forward */
+};
+
+/*
+ * Batched wakeups: poll() and blocking read() only report data once at
+ * least 'bytes' are pending or the oldest pending data is 'ms' old, and
+ * then until the reader has caught up. Zero for both wakes on every write.
+ */
+struct logger_batch {
+	__u32		bytes;
+	__u32		ms;
+};
+
+#define LOGGER_GET_READ_STATE	_IOR(__LOGGERIO, 5, struct logger_read_state)
+#define LOGGER_SET_READ_OFF	_IO(__LOGGERIO, 6) /* arg: new r_off */
+#define LOGGER_SET_BATCH	_IOW(__LOGGERIO, 7, struct logger_batch)
+
 #endif /* _LINUX_LOGGER_H */
@@ -16,6 +16,17 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Setting /sys/module/lowmemorykiller/parameters/pressure to 1 also kills
+ * processes with an oom_adj of pressure_adj or higher while reclaim is
+ * inefficient (fewer than pressure_efficiency percent of the scanned pages
+ * reclaimed) and the system takes at least pressure_majfaults major faults
+ * per second, i.e. the page cache is thrashing before any minfree level is
+ * reached.
+ *
+ * While at least swap_headroom percent of swap is free (e.g. on a ramzswap
+ * device), only the first minfree level is used: background processes can
+ * still be swapped out, which is much cheaper than relaunching them.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  * Copyright (C) 2011 Freescale Semiconductor, Inc.
  *
@@ -37,7 +48,13 @@
 #include <linux/sched.h>
 #include <linux/notifier.h>
 #include <linux/nodemask.h>
+#include <linux/swap.h>
 #include <linux/vmstat.h>
+#include <linux/ktime.h>
+#include <linux/freezer.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/lowmemorykiller.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -56,6 +73,28 @@ static size_t lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static struct task_struct *lowmem_deathpending;
+static ktime_t lowmem_deathpending_start;
+
+/* kill to task_struct freed latency */
+static uint32_t lowmem_kill_count;
+static uint32_t lowmem_kill_latency_max_us;
+static uint32_t lowmem_kill_latency_last_us;
+
+static uint32_t lowmem_pressure;
+static int lowmem_pressure_adj = 12;
+static uint32_t lowmem_pressure_efficiency = 25;	/* percent */
+static uint32_t lowmem_pressure_majfaults = 100;	/* per second */
+static uint32_t lowmem_pressure_kills;
+
+/* percent of swap that must be free to hold off all but the first level */
+static uint32_t lowmem_swap_headroom = 25;
+
+/*
+ * Tasks parked in a frozen cgroup cost no CPU and their pages can go
+ * to swap, so kill any other candidate first.
+ */
+static uint32_t lowmem_spare_frozen = 1;
+static uint32_t lowmem_frozen_kills;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -75,12 +114,168 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 {
 	struct task_struct *task = data;
 	if (task == lowmem_deathpending) {
+		s64 us = ktime_us_delta(ktime_get(), lowmem_deathpending_start);
+
+		lowmem_kill_count++;
+		lowmem_kill_latency_last_us = us;
+		if (us > lowmem_kill_latency_max_us)
+			lowmem_kill_latency_max_us = us;
+		trace_lowmem_kill_done(task->pid, us);
 		lowmem_deathpending = NULL;
 		task_free_unregister(&task_nb);
 	}
 	return NOTIFY_OK;
 }
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+/*
+ * Thread group leaders in one list per oom_adj value, so lowmem_shrink()
+ * only walks the buckets it may kill from. The hooks in fork, exit, exec
+ * and the oom_adj write all run under tasklist_lock, read or write, and
+ * take lowmem_index_lock inside it.
+ */
+#define LOWMEM_ADJ_BUCKETS	(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+
+static struct hlist_head lowmem_adj_index[LOWMEM_ADJ_BUCKETS];
+static DEFINE_SPINLOCK(lowmem_index_lock);
+
+static struct hlist_head *lowmem_adj_bucket(int oom_adj)
+{
+	return &lowmem_adj_index[clamp(oom_adj, OOM_DISABLE, OOM_ADJUST_MAX) -
+				 OOM_DISABLE];
+}
+
+/* tasklist_lock held for writing */
+void lowmem_index_add(struct task_struct *task)
+{
+	spin_lock(&lowmem_index_lock);
+	hlist_add_head(&task->lmk_adj_node,
+		       lowmem_adj_bucket(task->signal->oom_adj));
+	spin_unlock(&lowmem_index_lock);
+}
+
+/* tasklist_lock held for writing */
+void lowmem_index_del(struct task_struct *task)
+{
+	spin_lock(&lowmem_index_lock);
+	if (!hlist_unhashed(&task->lmk_adj_node))
+		hlist_del_init(&task->lmk_adj_node);
+	spin_unlock(&lowmem_index_lock);
+}
+
+/* de_thread() made new the group leader, tasklist_lock held for writing */
+void lowmem_index_replace(struct task_struct *old, struct task_struct *new)
+{
+	spin_lock(&lowmem_index_lock);
+	if (!hlist_unhashed(&old->lmk_adj_node)) {
+		hlist_del_init(&old->lmk_adj_node);
+		hlist_add_head(&new->lmk_adj_node,
+			       lowmem_adj_bucket(new->signal->oom_adj));
+	}
+	spin_unlock(&lowmem_index_lock);
+}
+
+/* oom_adj of task's thread group changed */
+void lowmem_index_update(struct task_struct *task)
+{
+	struct task_struct *leader;
+
+	read_lock(&tasklist_lock);
+	leader = task->group_leader;
+	spin_lock(&lowmem_index_lock);
+	if (!hlist_unhashed(&leader->lmk_adj_node)) {
+		hlist_del(&leader->lmk_adj_node);
+		hlist_add_head(&leader->lmk_adj_node,
+			       lowmem_adj_bucket(leader->signal->oom_adj));
+	}
+	spin_unlock(&lowmem_index_lock);
+	read_unlock(&tasklist_lock);
+}
+#endif
+
+#ifdef CONFIG_VM_EVENT_COUNTERS
+/*
+ * Reclaim feedback from the vm event counters: the share of pages
+ * scanned by shrink_zone() that were reclaimed, and the major fault
+ * rate, over the last window of at least a second.
+ */
+static struct {
+	unsigned long stamp;
+	unsigned long scanned;
+	unsigned long reclaimed;
+	unsigned long majfaults;
+	int thrashing;
+} lowmem_vm;
+
+static int lowmem_thrashing(void)
+{
+	unsigned long events[NR_VM_EVENT_ITEMS];
+	unsigned long scanned, reclaimed, majfaults, elapsed;
+	int i;
+
+	elapsed = jiffies - lowmem_vm.stamp;
+	if (elapsed < HZ)
+		return lowmem_vm.thrashing;
+
+	all_vm_events(events);
+	scanned = reclaimed = 0;
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		scanned += events[PGSCAN_KSWAPD_NORMAL - ZONE_NORMAL + i] +
+			events[PGSCAN_DIRECT_NORMAL - ZONE_NORMAL + i];
+		reclaimed += events[PGSTEAL_NORMAL - ZONE_NORMAL + i];
+	}
+	majfaults = events[PGMAJFAULT];
+
+	if (lowmem_vm.stamp) {
+		unsigned long ds = scanned - lowmem_vm.scanned;
+		unsigned long dr = reclaimed - lowmem_vm.reclaimed;
+		unsigned long df = majfaults - lowmem_vm.majfaults;
+
+		/* ignore windows with too little reclaim to judge */
+		lowmem_vm.thrashing = ds >= SWAP_CLUSTER_MAX &&
+			dr * 100 < ds * lowmem_pressure_efficiency &&
+			df * HZ >= lowmem_pressure_majfaults * elapsed;
+		lowmem_print(4, "lowmem pressure: scanned %lu reclaimed %lu "
+			     "majfaults %lu in %u ms\n", ds, dr, df,
+			     jiffies_to_msecs(elapsed));
+	}
+	lowmem_vm.stamp = jiffies;
+	lowmem_vm.scanned = scanned;
+	lowmem_vm.reclaimed = reclaimed;
+	lowmem_vm.majfaults = majfaults;
+	return lowmem_vm.thrashing;
+}
+#else
+static int lowmem_thrashing(void)
+{
+	return 0;
+}
+#endif
+
+/* Size of p if it may be killed at min_adj, else 0. tasklist_lock held. */
+static int lowmem_task_size(struct task_struct *p, int min_adj, int *oom_adj)
+{
+	struct mm_struct *mm;
+	struct signal_struct *sig;
+	int tasksize;
+
+	task_lock(p);
+	mm = p->mm;
+	sig = p->signal;
+	if (!mm || !sig) {
+		task_unlock(p);
+		return 0;
+	}
+	*oom_adj = sig->oom_adj;
+	if (*oom_adj < min_adj) {
+		task_unlock(p);
+		return 0;
+	}
+	tasksize = get_mm_rss(mm);
+	task_unlock(p);
+	return tasksize;
+}
+
 static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 {
 	struct task_struct *p;
@@ -89,20 +284,18 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	int tasksize;
 	int i;
 	int min_adj = OOM_ADJUST_MAX + 1;
+	int pressure = 0;
 	int selected_tasksize = 0;
 	int selected_oom_adj;
+	int selected_frozen = 0;
 	int array_size = ARRAY_SIZE(lowmem_adj);
-	int other_free = global_page_state(NR_FREE_PAGES);
-	int other_file = global_page_state(NR_FILE_PAGES);
+	int other_free;
+	int other_file;
 	int node;
-
-	for_each_node_state(node, N_HIGH_MEMORY) {
-		struct zone *z =
-			&NODE_DATA(node)->node_zones[ZONE_DMA];
-
-		other_free -= zone_page_state(z, NR_FREE_PAGES);
-		other_file -= zone_page_state(z, NR_FILE_PAGES);
-	}
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	struct hlist_node *pos;
+	int adj;
+#endif
 
 	/*
 	 * If we already have a death outstanding, then
@@ -114,10 +307,29 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	if (lowmem_deathpending)
 		return 0;
 
+	other_free = global_page_state(NR_FREE_PAGES);
+	other_file = global_page_state(NR_FILE_PAGES);
+	for_each_node_state(node, N_HIGH_MEMORY) {
+		struct zone *z =
+			&NODE_DATA(node)->node_zones[ZONE_DMA];
+
+		other_free -= zone_page_state(z, NR_FREE_PAGES);
+		other_file -= zone_page_state(z, NR_FILE_PAGES);
+	}
+
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
 	if (lowmem_minfree_size < array_size)
 		array_size = lowmem_minfree_size;
+	/*
+	 * While swap (ramzswap) has room, reclaim can still move background
+	 * apps out to it, which is far cheaper than relaunching them, so
+	 * only the most critical minfree level kills.
+	 */
+	if (lowmem_swap_headroom && total_swap_pages &&
+	    nr_swap_pages * 100 >= total_swap_pages * lowmem_swap_headroom &&
+	    array_size > 1)
+		array_size = 1;
 	for (i = 0; i < array_size; i++) {
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
@@ -125,6 +337,11 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 			break;
 		}
 	}
+	if (lowmem_pressure && nr_to_scan > 0 &&
+	    lowmem_pressure_adj < min_adj && lowmem_thrashing()) {
+		min_adj = lowmem_pressure_adj;
+		pressure = 1;
+	}
 	if (nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %d, %x, ofree %d %d, ma %d\n",
 			     nr_to_scan, gfp_mask, other_free, other_file,
@@ -141,47 +358,72 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	selected_oom_adj = min_adj;
 
 	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
-
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	/*
+	 * Highest oom_adj first; the first bucket that yields a victim wins,
+	 * same as the full scan would pick.
+	 */
+	spin_lock(&lowmem_index_lock);
+	for (adj = OOM_ADJUST_MAX;
+	     adj >= min_adj && (!selected || selected_frozen); adj--) {
+		hlist_for_each_entry(p, pos, lowmem_adj_bucket(adj),
+				     lmk_adj_node) {
+#else
+	{
+		for_each_process(p) {
+#endif
+			int oom_adj, frozen;
+
+			tasksize = lowmem_task_size(p, min_adj, &oom_adj);
+			if (tasksize <= 0)
 				continue;
+			frozen = cgroup_freezing_or_frozen(p);
+			if (selected) {
+				if (lowmem_spare_frozen &&
+				    frozen != selected_frozen) {
+					if (frozen)
+						continue;
+				} else {
+					if (oom_adj < selected_oom_adj)
+						continue;
+					if (oom_adj == selected_oom_adj &&
+					    tasksize <= selected_tasksize)
+						continue;
+				}
+			}
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_adj = oom_adj;
+			selected_frozen = frozen;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n",
+				     p->pid, p->comm, oom_adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
 	}
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	spin_unlock(&lowmem_index_lock);
+#endif
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_adj, selected_tasksize);
 		lowmem_deathpending = selected;
+		lowmem_deathpending_start = ktime_get();
+		if (pressure)
+			lowmem_pressure_kills++;
+		trace_lowmem_kill(selected, selected_oom_adj,
+				  selected_tasksize, pressure);
 		task_free_register(&task_nb);
 		force_sig(SIGKILL, selected);
+		if (selected_frozen) {
+			struct task_struct *t = selected;
+
+			/* a frozen task can't act on SIGKILL until thawed */
+			lowmem_frozen_kills++;
+			do {
+				thaw_process(t);
+			} while_each_thread(selected, t);
+		}
 		rem -= selected_tasksize;
 	}
 	lowmem_print(4, "lowmem_shrink %d, %x, return %d\n",
@@ -212,6 +454,22 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(pressure, lowmem_pressure, uint, S_IRUGO | S_IWUSR);
+module_param_named(pressure_adj, lowmem_pressure_adj, int, S_IRUGO | S_IWUSR);
+module_param_named(pressure_efficiency, lowmem_pressure_efficiency, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_majfaults, lowmem_pressure_majfaults, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(swap_headroom, lowmem_swap_headroom, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_kills, lowmem_pressure_kills, uint, S_IRUGO);
+module_param_named(spare_frozen, lowmem_spare_frozen, uint, S_IRUGO | S_IWUSR);
+module_param_named(frozen_kills, lowmem_frozen_kills, uint, S_IRUGO);
+module_param_named(kill_count, lowmem_kill_count, uint, S_IRUGO);
+module_param_named(kill_latency_max_us, lowmem_kill_latency_max_us, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(kill_latency_last_us, lowmem_kill_latency_last_us, uint,
+		   S_IRUGO);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -93,12 +93,18 @@ struct hif_device {
 BUS_REQUEST *hifAllocateBusRequest(HIF_DEVICE *device);
 void hifFreeBusRequest(HIF_DEVICE *device, BUS_REQUEST *busrequest);
 void AddToAsyncList(HIF_DEVICE *device, BUS_REQUEST *busrequest);
+A_BOOL HifBeginDirect(HIF_DEVICE *device);
+void HifEndDirect(HIF_DEVICE *device);
 
 #ifdef HIF_LINUX_MMC_SCATTER_SUPPORT
 
 #define MAX_SCATTER_REQUESTS             4
 #define MAX_SCATTER_ENTRIES_PER_REQ      16
 #define MAX_SCATTER_REQ_TRANSFER_SIZE    32*1024
+    /* the i.MX eSDHC ADMA engine can only chain segments starting on a 4K
+     * boundary, any other list is copied into the request's bounce buffer and
+     * sent as one segment, which it can DMA from any address */
+#define HIF_SCATTER_SEG_ALIGN            4096
 
 typedef struct _HIF_SCATTER_REQ_PRIV {
     HIF_SCATTER_REQ     *pHifScatterReq;  /* HIF scatter request with allocated entries */   
@@ -106,6 +112,7 @@ typedef struct _HIF_SCATTER_REQ_PRIV {
     BUS_REQUEST         *busrequest;      /* request associated with request */
         /* scatter list for linux */    
     struct scatterlist  sgentries[MAX_SCATTER_ENTRIES_PER_REQ];   
+    A_UINT8             *pBounceBuffer;   /* for lists the host can't chain */
 } HIF_SCATTER_REQ_PRIV;
 
 #define ATH_DEBUG_SCATTER  ATH_DEBUG_MAKE_MODULE_MASK(0)
@@ -67,6 +67,10 @@ static int Func0_CMD52ReadByte(struct mmc_card *card, unsigned int address, unsi
 int reset_sdio_on_unload = 0;
 module_param(reset_sdio_on_unload, int, 0644);
 
+/* issue synchronous requests from the caller instead of the async thread */
+int hif_direct_sync = 1;
+module_param(hif_direct_sync, int, 0644);
+
 extern A_UINT32 nohifscattersupport;
 
 
@@ -304,17 +308,22 @@ __HIFReadWrite(HIF_DEVICE *device,
     return status;
 }
 
+    /* queue a request for the async thread, waking it only if the queue was empty:
+     * otherwise it is already due to drain the queue, and all requests queued
+     * meanwhile go in that one pass */
 void AddToAsyncList(HIF_DEVICE *device, BUS_REQUEST *busrequest)
 {
     unsigned long flags;
     BUS_REQUEST *async;
     BUS_REQUEST *active;
+    A_BOOL wake = FALSE;
     
     spin_lock_irqsave(&device->asynclock, flags);
     active = device->asyncreq;
     if (active == NULL) {
         device->asyncreq = busrequest;
         device->asyncreq->inusenext = NULL;
+        wake = TRUE;
     } else {
         for (async = device->asyncreq;
              async != NULL;
@@ -325,6 +334,39 @@ void AddToAsyncList(HIF_DEVICE *device, BUS_REQUEST *busrequest)
         busrequest->inusenext = NULL;
     }
     spin_unlock_irqrestore(&device->asynclock, flags);
+
+    if (wake) {
+        up(&device->sem_async);
+    }
+}
+
+    /* claim the host to run a synchronous request in the caller's context, which
+     * is only done if no request is queued ahead of it; the async thread holds the
+     * host while it drains the queue.  Returns TRUE with the host claimed */
+A_BOOL HifBeginDirect(HIF_DEVICE *device)
+{
+    unsigned long flags;
+    A_BOOL idle;
+
+    if (!hif_direct_sync) {
+        return FALSE;
+    }
+
+    sdio_claim_host(device->func);
+    spin_lock_irqsave(&device->asynclock, flags);
+    idle = (device->asyncreq == NULL);
+    spin_unlock_irqrestore(&device->asynclock, flags);
+
+    if (!idle) {
+        sdio_release_host(device->func);
+    }
+
+    return idle;
+}
+
+void HifEndDirect(HIF_DEVICE *device)
+{
+    sdio_release_host(device->func);
 }
 
 
@@ -351,6 +393,13 @@ HIFReadWrite(HIF_DEVICE *device,
             /* serialize all requests through the async thread */
             AR_DEBUG_PRINTF(ATH_DEBUG_TRACE, ("AR6000: Execution mode: %s\n", 
                         (request & HIF_ASYNCHRONOUS)?"Async":"Synch"));
+            if ((request & HIF_SYNCHRONOUS) && HifBeginDirect(device)) {
+                    /* nothing queued ahead of it, no need for the thread */
+                status = __HIFReadWrite(device, address, buffer, length,
+                                        request & ~HIF_SYNCHRONOUS, NULL);
+                HifEndDirect(device);
+                return status;
+            }
             busrequest = hifAllocateBusRequest(device);
             if (busrequest == NULL) {
                 AR_DEBUG_PRINTF(ATH_DEBUG_ERROR, 
@@ -370,7 +419,6 @@ HIFReadWrite(HIF_DEVICE *device,
                 AR_DEBUG_PRINTF(ATH_DEBUG_TRACE, ("AR6000: queued sync req: 0x%lX\n", (unsigned long)busrequest));
 
                 /* wait for completion */
-                up(&device->sem_async);
                 if (down_interruptible(&busrequest->sem_req) != 0) {
                     /* interrupted, exit */
                     return A_ERROR;
@@ -384,7 +432,6 @@ HIFReadWrite(HIF_DEVICE *device,
                 }
             } else {
                 AR_DEBUG_PRINTF(ATH_DEBUG_TRACE, ("AR6000: queued async req: 0x%lX\n", (unsigned long)busrequest));
-                up(&device->sem_async);
                 return A_PENDING;
             }
         } else {
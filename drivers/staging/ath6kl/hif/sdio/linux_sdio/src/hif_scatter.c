@@ -79,6 +79,41 @@ static HIF_SCATTER_REQ *AllocScatterReq(HIF_DEVICE *device)
     return NULL;   
 }
 
+    /* check if the host controller can chain the buffers of this request */
+static A_BOOL HifScatterNeedsBounce(HIF_SCATTER_REQ *pReq)
+{
+    int i;
+
+    if (pReq->ValidScatterEntries <= 1) {
+        return FALSE;
+    }
+
+    for (i = 0; i < pReq->ValidScatterEntries; i++) {
+        if ((unsigned long)pReq->ScatterList[i].pBuffer & (HIF_SCATTER_SEG_ALIGN - 1)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+    /* copy the scatter list to or from the request's bounce buffer */
+static void HifScatterCopyBounce(HIF_SCATTER_REQ_PRIV *pReqPriv, A_BOOL ToBounce)
+{
+    HIF_SCATTER_REQ *pReq = pReqPriv->pHifScatterReq;
+    A_UINT8         *pBounce = pReqPriv->pBounceBuffer;
+    int              i;
+
+    for (i = 0; i < pReq->ValidScatterEntries; i++) {
+        if (ToBounce) {
+            A_MEMCPY(pBounce, pReq->ScatterList[i].pBuffer, pReq->ScatterList[i].Length);
+        } else {
+            A_MEMCPY(pReq->ScatterList[i].pBuffer, pBounce, pReq->ScatterList[i].Length);
+        }
+        pBounce += pReq->ScatterList[i].Length;
+    }
+}
+
     /* called by async task to perform the operation synchronously using direct MMC APIs  */
 A_STATUS DoHifReadWriteScatter(HIF_DEVICE *device, BUS_REQUEST *busrequest)
 {
@@ -92,6 +127,7 @@ A_STATUS DoHifReadWriteScatter(HIF_DEVICE *device, BUS_REQUEST *busrequest)
     HIF_SCATTER_REQ        *pReq;       
     A_STATUS                status = A_OK;
     struct                  scatterlist *pSg;
+    A_BOOL                  bounce;
     
     pReqPriv = busrequest->pScatterReq;
     
@@ -148,6 +184,17 @@ A_STATUS DoHifReadWriteScatter(HIF_DEVICE *device, BUS_REQUEST *busrequest)
         /* set scatter-gather table for request */
     data.sg = pReqPriv->sgentries;
     data.sg_len = pReq->ValidScatterEntries;
+
+    bounce = HifScatterNeedsBounce(pReq);
+    if (bounce) {
+            /* the host can't chain these, send one segment out of the bounce buffer */
+        if (pReq->Request & HIF_WRITE) {
+            HifScatterCopyBounce(pReqPriv, TRUE);
+        }
+        sg_init_one(pReqPriv->sgentries, pReqPriv->pBounceBuffer,
+                    data.blocks * data.blksz);
+        data.sg_len = 1;
+    }
         /* set command argument */    
     SDIO_SET_CMD53_ARG(cmd.arg, 
                        rw, 
@@ -180,6 +227,8 @@ A_STATUS DoHifReadWriteScatter(HIF_DEVICE *device, BUS_REQUEST *busrequest)
     if (A_FAILED(status)) {
         AR_DEBUG_PRINTF(ATH_DEBUG_ERROR, ("HIF-SCATTER: FAILED!!! (%s) Address: 0x%X, Block mode (BlockLen: %d, BlockCount: %d)\n",
               (pReq->Request & HIF_WRITE) ? "WRITE":"READ",pReq->Address, data.blksz, data.blocks));        
+    } else if (bounce && !(pReq->Request & HIF_WRITE)) {
+        HifScatterCopyBounce(pReqPriv, FALSE);
     }
     
         /* set completion status, fail or success */
@@ -242,13 +291,18 @@ static A_STATUS HifReadWriteScatter(HIF_DEVICE *device, HIF_SCATTER_REQ *pReq)
             break;    
         }
         
-            /* add bus request to the async list for the async I/O thread to process */
-        AddToAsyncList(device, pReqPriv->busrequest);
+        if ((request & HIF_SYNCHRONOUS) && HifBeginDirect(device)) {
+                /* nothing queued ahead of it, run it here; this ups sem_req */
+            DoHifReadWriteScatter(device, pReqPriv->busrequest);
+            HifEndDirect(device);
+        } else {
+                /* add bus request to the async list for the async I/O thread to process */
+            AddToAsyncList(device, pReqPriv->busrequest);
+        }
 
         if (request & HIF_SYNCHRONOUS) {
             AR_DEBUG_PRINTF(ATH_DEBUG_SCATTER, ("HIF-SCATTER: queued sync req: 0x%lX\n", (unsigned long)pReqPriv->busrequest));
-            /* signal thread and wait */
-            up(&device->sem_async);
+            /* wait for the thread, or collect the result of the direct request */
             if (down_interruptible(&pReqPriv->busrequest->sem_req) != 0) {
                 AR_DEBUG_PRINTF(ATH_DEBUG_ERROR,("HIF-SCATTER: interrupted! \n"));
                 /* interrupted, exit */
@@ -259,8 +313,7 @@ static A_STATUS HifReadWriteScatter(HIF_DEVICE *device, HIF_SCATTER_REQ *pReq)
             }
         } else {
             AR_DEBUG_PRINTF(ATH_DEBUG_SCATTER, ("HIF-SCATTER: queued async req: 0x%lX\n", (unsigned long)pReqPriv->busrequest));
-                /* wake thread, it will process and then take care of the async callback */
-            up(&device->sem_async);
+                /* the thread will process it and then take care of the async callback */
             status = A_OK;
         }           
        
@@ -313,6 +366,13 @@ A_STATUS SetupHIFScatterSupport(HIF_DEVICE *device, HIF_DEVICE_SCATTER_SUPPORT_I
                 A_FREE(pReqPriv);
                 break;      
             }           
+                /* allocate the bounce buffer, it must be DMA-able */
+            pReqPriv->pBounceBuffer = (A_UINT8 *)A_MALLOC(MAX_SCATTER_REQ_TRANSFER_SIZE);
+            if (NULL == pReqPriv->pBounceBuffer) {
+                A_FREE(pReqPriv->pHifScatterReq);
+                A_FREE(pReqPriv);
+                break;
+            }
                 /* just zero the main part of the scatter request */
             A_MEMZERO(pReqPriv->pHifScatterReq, sizeof(HIF_SCATTER_REQ));
                 /* back pointer to the private struct */
@@ -320,6 +380,7 @@ A_STATUS SetupHIFScatterSupport(HIF_DEVICE *device, HIF_DEVICE_SCATTER_SUPPORT_I
                 /* allocate a bus request for this scatter request */
             busrequest = hifAllocateBusRequest(device);
             if (NULL == busrequest) {
+                A_FREE(pReqPriv->pBounceBuffer);
                 A_FREE(pReqPriv->pHifScatterReq);
                 A_FREE(pReqPriv);
                 break;    
@@ -386,6 +447,11 @@ void CleanupHIFScatterResources(HIF_DEVICE *device)
             A_FREE(pReqPriv->pHifScatterReq);   
             pReqPriv->pHifScatterReq = NULL; 
         }
+
+        if (pReqPriv->pBounceBuffer != NULL) {
+            A_FREE(pReqPriv->pBounceBuffer);
+            pReqPriv->pBounceBuffer = NULL;
+        }
                 
         A_FREE(pReqPriv);       
     }
@@ -211,6 +211,7 @@ static INLINE void GetHTCSendPackets(HTC_TARGET        *target,
             pEndpoint->CreditDist.TxCreditsSeek = 0;
 
             if (pEndpoint->CreditDist.TxCredits < creditsRequired) {
+                pEndpoint->CreditDist.TxCreditStalls++;
                     /* still not enough credits to send, leave packet in the queue */
                 AR_DEBUG_PRINTF(ATH_DEBUG_SEND,
                     (" Not enough credits for ep %d leaving packet in queue..\n",
@@ -894,6 +895,7 @@ void DumpCreditDist(HTC_ENDPOINT_CREDIT_DIST *pEPDist)
     AR_DEBUG_PRINTF(ATH_DEBUG_ANY, (" TxCreditSize       : %d \n", pEPDist->TxCreditSize));
     AR_DEBUG_PRINTF(ATH_DEBUG_ANY, (" TxCreditsPerMaxMsg : %d \n", pEPDist->TxCreditsPerMaxMsg));
     AR_DEBUG_PRINTF(ATH_DEBUG_ANY, (" TxCreditsToDist    : %d \n", pEPDist->TxCreditsToDist));
+    AR_DEBUG_PRINTF(ATH_DEBUG_ANY, (" TxCreditStalls     : %u \n", pEPDist->TxCreditStalls));
     AR_DEBUG_PRINTF(ATH_DEBUG_ANY, (" TxQueueDepth       : %d \n", 
                     HTC_PACKET_QUEUE_DEPTH(&((HTC_ENDPOINT *)pEPDist->pHTCReserved)->TxQueue)));                                      
     AR_DEBUG_PRINTF(ATH_DEBUG_ANY, ("----------------------------------------------------\n"));
@@ -184,6 +184,9 @@ extern "C" {
 #define A_WMI_BSSINFO_EVENT_RX(ar, datp, len)   \
     ar6000_bssInfo_event_rx((ar), (datap), (len))
 
+#define A_WMI_BSS_UPDATE_EVENT(ar, bss, changed)   \
+    ar6000_bss_update_event((ar), (bss), (changed))
+
 #define A_WMI_DBGLOG_EVENT(ar, dropped, buffer, length) \
     ar6000_dbglog_event((ar), (dropped), (buffer), (length));
 
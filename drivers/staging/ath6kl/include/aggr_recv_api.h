@@ -30,6 +30,8 @@ extern "C" {
 
 typedef void (* RX_CALLBACK)(void * dev, void *osbuf);
 
+typedef void (* RX_BATCH_CALLBACK)(void * dev, A_NETBUF_QUEUE_T *q);
+
 typedef void (* ALLOC_NETBUFS)(A_NETBUF_QUEUE_T *q, A_UINT16 num);
 
 /*
@@ -55,6 +57,17 @@ aggr_init(ALLOC_NETBUFS netbuf_allocator);
 void
 aggr_register_rx_dispatcher(void *cntxt, void * dev,  RX_CALLBACK fn);
 
+/*
+ * aggr_register_rx_batch_dispatcher:
+ * Optional. Registers an OS call back that takes a whole run
+ * of in-order frames at once, so the OS can hand them to the
+ * stack in one go rather than one softirq round per frame.
+ * The call back must empty the queue. When registered it is
+ * used instead of the per frame dispatcher.
+ */
+void
+aggr_register_rx_batch_dispatcher(void *cntxt, RX_BATCH_CALLBACK fn);
+
 
 /*
  * aggr_process_bar:
@@ -26,6 +26,15 @@
 #include "htc_packet.h"
 #include "htc_api.h"
 
+/* per endpoint state of the adaptive part of the default credit distribution */
+typedef struct _COMMON_CREDIT_EP_STATE {
+    A_UINT32 LastStalls;            /* TxCreditStalls when last looked at */
+    A_BOOL   Starved;               /* stalled since its queue was last empty */
+    A_UINT32 Seeks;                 /* credit seeks */
+    A_UINT32 ShortSeeks;            /* seeks that got less than they asked for */
+    int      NormMax;               /* ceiling for TxCreditsNorm */
+} COMMON_CREDIT_EP_STATE;
+
 /* structure that is the state information for the default credit distribution callback
  * drivers should instantiate (zero-init as well) this structure in their driver instance
  * and pass it as a context to the HTC credit distribution functions */
@@ -34,6 +43,7 @@ typedef struct _COMMON_CREDIT_STATE_INFO {
     int CurrentFreeCredits;         /* credits available in the pool that have not been
                                        given out to endpoints */
     HTC_ENDPOINT_CREDIT_DIST *pLowestPriEpDist;  /* pointer to the lowest priority endpoint dist struct */
+    COMMON_CREDIT_EP_STATE EpState[ENDPOINT_MAX];
 } COMMON_CREDIT_STATE_INFO;
 
 typedef struct {
@@ -195,6 +195,8 @@ typedef struct _HTC_ENDPOINT_CREDIT_DIST {
                                                or HTC_CREDIT_DIST_SEND_COMPLETE is indicated on an endpoint
                                                that has non-zero credits to recover
                                               */
+    A_UINT32            TxCreditStalls;     /* running count of packets left queued because the
+                                               endpoint had too few credits even after seeking (set by HTC) */
 } HTC_ENDPOINT_CREDIT_DIST;
 
 #define HTC_EP_ACTIVE                            ((A_UINT32) (1u << 31))
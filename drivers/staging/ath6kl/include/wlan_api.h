@@ -66,6 +66,9 @@ typedef struct bss {
     struct bss                   *ni_list_prev;
     struct bss                   *ni_hash_next;
     struct bss                   *ni_hash_prev;
+    struct bss                   *ni_ssid_next;
+    struct bss                   *ni_ssid_prev;
+    A_UINT8                      ni_ssid_hash;
     struct ieee80211_common_ie   ni_cie;
     A_UINT8                     *ni_buf;
     A_UINT16                     ni_framelen;
@@ -75,6 +78,7 @@ typedef struct bss {
 
     A_UINT32                     ni_tstamp;
     A_UINT32                     ni_actcnt;
+    A_UINT32                     ni_informed;   /* last reported to the OS */
 #ifdef OS_ROAM_MANAGEMENT
     A_UINT32                     ni_si_gen;
 #endif
@@ -87,6 +91,8 @@ void wlan_node_free(bss_t *ni);
 void wlan_setup_node(struct ieee80211_node_table *nt, bss_t *ni,
                 const A_UINT8 *macaddr);
 bss_t *wlan_find_node(struct ieee80211_node_table *nt, const A_UINT8 *macaddr);
+A_BOOL wlan_node_refresh(struct ieee80211_node_table *nt, bss_t *ni,
+                         const A_UINT8 *buf, int framelen);
 void wlan_node_reclaim(struct ieee80211_node_table *nt, bss_t *ni);
 void wlan_free_allnodes(struct ieee80211_node_table *nt);
 void wlan_iterate_nodes(struct ieee80211_node_table *nt, wlan_node_iter_func *f,
@@ -34,6 +34,7 @@
 
 #define NO_VO_SERVICE 1 /* currently WMI only uses 3 data streams, so we leave VO service inactive */
 #define CONFIG_GIVE_LOW_PRIORITY_STREAMS_MIN_CREDITS 1
+#define CONFIG_ADAPTIVE_CREDIT_DIST 1 /* size bulk endpoints to their backlog, protect latency bound ones */
 
 #ifdef NO_VO_SERVICE
 #define DATA_SVCS_USED 3
@@ -76,6 +77,94 @@ static INLINE void ReduceCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
     (pCredInfo)->CurrentFreeCredits -= (credits);   \
 }
 
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+
+#define EP_STATE(pCredInfo,pEpDist) (&(pCredInfo)->EpState[(pEpDist)->Endpoint])
+
+/* control and voice/video traffic is latency bound, best effort and background are bulk */
+#define IS_LATENCY_SVC(id) \
+    ((id) == WMI_CONTROL_SVC || (id) == WMI_DATA_VO_SVC || (id) == WMI_DATA_VI_SVC)
+
+/* note packets that had to wait for credits since we last looked */
+static INLINE A_BOOL UpdateStarved(COMMON_CREDIT_STATE_INFO *pCredInfo,
+                                   HTC_ENDPOINT_CREDIT_DIST *pEpDist)
+{
+    COMMON_CREDIT_EP_STATE *pState = EP_STATE(pCredInfo, pEpDist);
+
+    if (pEpDist->TxCreditStalls == pState->LastStalls) {
+        return FALSE;
+    }
+    pState->LastStalls = pEpDist->TxCreditStalls;
+    pState->Starved = TRUE;
+    return TRUE;
+}
+
+/* free credits an endpoint has to leave for starved higher priority endpoints,
+ * one max message each, so a bulk transfer cannot drain the pool under them */
+static int ReservedCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
+                           HTC_ENDPOINT_CREDIT_DIST *pEpDist)
+{
+    HTC_ENDPOINT_CREDIT_DIST *pCurEpDist;
+    int                      reserve = 0;
+
+    if (IS_LATENCY_SVC(pEpDist->ServiceID)) {
+        return 0;
+    }
+
+    for (pCurEpDist = pEpDist->pPrev; pCurEpDist != NULL; pCurEpDist = pCurEpDist->pPrev) {
+        if (EP_STATE(pCredInfo, pCurEpDist)->Starved) {
+            reserve += pCurEpDist->TxCreditsPerMaxMsg;
+        }
+    }
+
+    return reserve;
+}
+
+/* called as credits come back to an endpoint.  A bulk endpoint that keeps
+ * stalling with a backlog grows its normal share by one max message, one
+ * whose queue has drained shrinks back towards its minimum so the credits
+ * go back to the pool instead of idling on it */
+static void AdaptCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
+                         HTC_ENDPOINT_CREDIT_DIST *pEpDist)
+{
+    COMMON_CREDIT_EP_STATE *pState = EP_STATE(pCredInfo, pEpDist);
+    A_BOOL                 stalled;
+
+    stalled = UpdateStarved(pCredInfo, pEpDist);
+    if (pEpDist->TxQueueDepth == 0) {
+        pState->Starved = FALSE;
+    }
+
+    if (IS_LATENCY_SVC(pEpDist->ServiceID)) {
+        return;
+    }
+
+    if (stalled && pEpDist->TxQueueDepth > 0) {
+        pEpDist->TxCreditsNorm = min(pEpDist->TxCreditsNorm + pEpDist->TxCreditsPerMaxMsg,
+                                     pState->NormMax);
+    } else if (pEpDist->TxQueueDepth == 0) {
+        pEpDist->TxCreditsNorm = max(pEpDist->TxCreditsNorm - pEpDist->TxCreditsPerMaxMsg,
+                                     pEpDist->TxCreditsMin);
+    }
+}
+
+static void DumpAdaptiveState(COMMON_CREDIT_STATE_INFO *pCredInfo)
+{
+    HTC_ENDPOINT_CREDIT_DIST *pCurEpDist;
+    COMMON_CREDIT_EP_STATE   *pState;
+
+    for (pCurEpDist = pCredInfo->pLowestPriEpDist; pCurEpDist != NULL; pCurEpDist = pCurEpDist->pPrev) {
+        pState = EP_STATE(pCredInfo, pCurEpDist);
+        AR_DEBUG_PRINTF(ATH_DEBUG_ERR, ("  ep %d svc 0x%X: norm %d/%d, stalls %u, seeks %u, short %u%s\n",
+                        pCurEpDist->Endpoint, pCurEpDist->ServiceID,
+                        pCurEpDist->TxCreditsNorm, pState->NormMax,
+                        pCurEpDist->TxCreditStalls, pState->Seeks, pState->ShortSeeks,
+                        pState->Starved ? ", starved" : ""));
+    }
+}
+
+#endif /* CONFIG_ADAPTIVE_CREDIT_DIST */
+
 
 /* default credit init callback.
  * This function is called in the context of HTCStart() to setup initial (application-specific)
@@ -161,6 +250,9 @@ static void ar6000_credit_init(void                     *Context,
             pCurEpDist->TxCreditsNorm = count;
 
         }
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+        EP_STATE(pCredInfo, pCurEpDist)->NormMax = pCurEpDist->TxCreditsNorm;
+#endif
         pCurEpDist = pCurEpDist->pNext;
     }
 
@@ -195,6 +287,10 @@ static void ar6000_credit_distribute(void                     *Context,
                         /* always zero out when we are done */
                     pCurEpDist->TxCreditsToDist = 0;
 
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+                    AdaptCredits(pCredInfo, pCurEpDist);
+#endif
+
                     if (pCurEpDist->TxCredits > pCurEpDist->TxCreditsAssigned) {
                             /* reduce to the assigned limit, previous credit reductions
                              * could have caused the limit to change */
@@ -230,6 +326,9 @@ static void ar6000_credit_distribute(void                     *Context,
         case HTC_DUMP_CREDIT_STATE :
             AR_DEBUG_PRINTF(ATH_DEBUG_ERR, ("Credit Distribution, total : %d, free : %d\n",
             								pCredInfo->TotalAvailableCredits, pCredInfo->CurrentFreeCredits));
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+            DumpAdaptiveState(pCredInfo);
+#endif
             break;
         default:
             break;
@@ -289,6 +388,13 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
     HTC_ENDPOINT_CREDIT_DIST *pCurEpDist;
     int                      credits = 0;
     int                      need;
+    int                      reserve = 0;
+
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+    UpdateStarved(pCredInfo, pEPDist);
+    EP_STATE(pCredInfo, pEPDist)->Seeks++;
+    reserve = ReservedCredits(pCredInfo, pEPDist);
+#endif
 
     do {
 
@@ -296,6 +402,11 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
                 /* we never oversubscribe on the control service, this is not
                  * a high performance path and the target never holds onto control
                  * credits for too long */
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+                /* ... unless commands are already waiting behind bulk data, the
+                 * extra credits are reduced back to normal when they return */
+            if (!EP_STATE(pCredInfo, pEPDist)->Starved)
+#endif
             break;
         }
 
@@ -338,7 +449,7 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
          * 2. checking lower priority endpoints for credits to take */
 
             /* give what we can */
-        credits = min(pCredInfo->CurrentFreeCredits,pEPDist->TxCreditsSeek);
+        credits = min(pCredInfo->CurrentFreeCredits - reserve,pEPDist->TxCreditsSeek);
 
         if (credits >= pEPDist->TxCreditsSeek) {
                 /* we found some to fullfill the seek request */
@@ -360,7 +471,7 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
             /* work backwards until we hit the endpoint again */
         while (pCurEpDist != pEPDist) {
                 /* calculate how many we need so far */
-            need = pEPDist->TxCreditsSeek - pCredInfo->CurrentFreeCredits;
+            need = pEPDist->TxCreditsSeek + reserve - pCredInfo->CurrentFreeCredits;
 
             if ((pCurEpDist->TxCreditsAssigned - need) >= pCurEpDist->TxCreditsMin) {
                     /* the current one has been allocated more than it's minimum and it
@@ -370,7 +481,7 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
                               pCurEpDist,
                               pCurEpDist->TxCreditsAssigned - need);
 
-                if (pCredInfo->CurrentFreeCredits >= pEPDist->TxCreditsSeek) {
+                if (pCredInfo->CurrentFreeCredits - reserve >= pEPDist->TxCreditsSeek) {
                         /* we have enough */
                     break;
                 }
@@ -380,12 +491,18 @@ static void SeekCredits(COMMON_CREDIT_STATE_INFO *pCredInfo,
         }
 
             /* return what we can get */
-        credits = min(pCredInfo->CurrentFreeCredits,pEPDist->TxCreditsSeek);
+        credits = min(pCredInfo->CurrentFreeCredits - reserve,pEPDist->TxCreditsSeek);
 
     } while (FALSE);
 
+#ifdef CONFIG_ADAPTIVE_CREDIT_DIST
+    if (credits < pEPDist->TxCreditsSeek) {
+        EP_STATE(pCredInfo, pEPDist)->ShortSeeks++;
+    }
+#endif
+
         /* did we find some credits? */
-    if (credits) {
+    if (credits > 0) {
             /* give what we can */
         GiveCredits(pCredInfo, pEPDist, credits);
     }
@@ -135,6 +135,7 @@ unsigned int enableuartprint = ENABLEUARTPRINT_DEFAULT;
 unsigned int logWmiRawMsgs = 0;
 unsigned int enabletimerwar = 0;
 unsigned int fwmode = 1;
+unsigned int fwretain = 0;
 unsigned int mbox_yield_limit = 99;
 unsigned int enablerssicompensation = 0;
 int reduce_credit_dribble = 1 + HTC_CONNECT_FLAGS_THRESHOLD_LEVEL_ONE_HALF;
@@ -161,6 +162,7 @@ unsigned int csumOffload=0;
 unsigned int csumOffloadTest=0;
 #endif
 unsigned int eppingtest=0;
+unsigned int bgscan_period = 60;
 
 module_param_string(ifname, ifname, sizeof(ifname), 0644);
 module_param(wlaninitmode, int, 0644);
@@ -177,11 +179,13 @@ module_param(logWmiRawMsgs, uint, 0644);
 module_param(enableuartprint, uint, 0644);
 module_param(enabletimerwar, uint, 0644);
 module_param(fwmode, uint, 0644);
+module_param(fwretain, uint, 0644);
 module_param(mbox_yield_limit, uint, 0644);
 module_param(reduce_credit_dribble, int, 0644);
 module_param(allow_trace_signal, int, 0644);
 module_param(enablerssicompensation, uint, 0644);
 module_param(processDot11Hdr, uint, 0644);
+module_param(bgscan_period, uint, 0644);
 #ifdef CONFIG_CHECKSUM_OFFLOAD
 module_param(csumOffload, uint, 0644);
 #endif
@@ -325,6 +329,10 @@ static HTC_SEND_FULL_ACTION ar6000_tx_queue_full(void *Context, HTC_PACKET *pPac
 static void ar6000_alloc_netbufs(A_NETBUF_QUEUE_T *q, A_UINT16 num);
 #endif
 static void ar6000_deliver_frames_to_nw_stack(void * dev, void *osbuf);
+static int ar6000_napi_poll(struct napi_struct *napi, int budget);
+#ifdef ATH_AR6K_11N_SUPPORT
+static void ar6000_deliver_frame_batch_to_nw_stack(void *dev, A_NETBUF_QUEUE_T *q);
+#endif
 //static void ar6000_deliver_frames_to_bt_stack(void * dev, void *osbuf);
 
 static HTC_PACKET *ar6000_alloc_amsdu_rxbuf(void *Context, HTC_ENDPOINT_ID Endpoint, int Length);
@@ -333,6 +341,8 @@ static void ar6000_refill_amsdu_rxbufs(AR_SOFTC_T *ar, int Count);
 
 static void ar6000_cleanup_amsdu_rxbufs(AR_SOFTC_T *ar);
 
+static void ar6000_cleanup_rx_pool(AR_SOFTC_T *ar);
+
 static ssize_t
 ar6000_sysfs_bmi_read(struct file *fp, struct kobject *kobj,
                       struct bin_attribute *bin_attr,
@@ -1714,6 +1724,11 @@ ar6000_avail_ev(void *context, void *hif_handle)
     ar->bIsDestroyProgress = FALSE;
 
     INIT_HTC_PACKET_QUEUE(&ar->amsdu_rx_buffer_queue);
+    A_NETBUF_QUEUE_INIT(&ar->rx_buffer_pool);
+    ar6000_ps_policy_init(ar);
+    skb_queue_head_init(&ar->arNapiRxQ);
+    init_waitqueue_head(&ar->arNapiRxWait);
+    netif_napi_add(dev, &ar->arNapi, ar6000_napi_poll, AR6000_NAPI_WEIGHT);
 
 #ifdef ADAPTIVE_POWER_THROUGHPUT_CONTROL
     A_INIT_TIMER(&aptcTimer, aptcTimerHandler, ar);
@@ -1786,6 +1801,7 @@ ar6000_avail_ev(void *context, void *hif_handle)
     }
 
     aggr_register_rx_dispatcher(ar->aggr_cntxt, (void *)dev, ar6000_deliver_frames_to_nw_stack);
+    aggr_register_rx_batch_dispatcher(ar->aggr_cntxt, ar6000_deliver_frame_batch_to_nw_stack);
 #endif
 
     HIFClaimDevice(ar->arHifDevice, ar);
@@ -1836,6 +1852,7 @@ ar6000_avail_ev(void *context, void *hif_handle)
     }
 
 	is_netdev_registered = 1;
+    ar6000_ps_policy_register(ar);
 
 #ifdef CONFIG_AP_VIRTUAL_ADAPTER_SUPPORT
     arApNetDev = NULL;
@@ -1943,6 +1960,8 @@ ar6000_stop_endpoint(struct net_device *dev, A_BOOL keepprofile, A_BOOL getdbglo
     /* Stop the transmit queues */
     netif_stop_queue(dev);
 
+    ar6000_ps_policy_stop(ar, TRUE);
+
     /* Disable the target and the interrupts associated with it */
     if (ar->arWmiReady == TRUE)
     {
@@ -2124,6 +2143,9 @@ ar6000_destroy(struct net_device *dev, unsigned int unregister)
         /* cleanup any allocated AMSDU buffers */
     ar6000_cleanup_amsdu_rxbufs(ar);
 
+        /* and the recycled RX buffers */
+    ar6000_cleanup_rx_pool(ar);
+
     if (bmienable) {
         ar6000_sysfs_bmi_deinit(ar);
     }
@@ -2144,6 +2166,7 @@ ar6000_destroy(struct net_device *dev, unsigned int unregister)
 #endif 
     /* Free up the device data structure */
     if (unregister && is_netdev_registered) {		
+        ar6000_ps_policy_unregister(ar);
         unregister_netdev(dev);
         is_netdev_registered = 0;
     }
@@ -2302,6 +2325,24 @@ ar6000_open(struct net_device *dev)
     unsigned long  flags;
     AR_SOFTC_T    *ar = (AR_SOFTC_T *)ar6k_priv(dev);
 
+    napi_enable(&ar->arNapi);
+
+    /*
+     * With fwretain the target was put into deep sleep, firmware resident,
+     * when the interface went down: wake it up, which also restores the
+     * scan parameters and reconnects, instead of needing a new download.
+     */
+    if (fwretain && ar->arWmiReady == TRUE) {
+        ar6000_set_wlan_state(ar, WLAN_ENABLED);
+    }
+
+#ifdef ATH6K_CONFIG_CFG80211
+    /* ar6000_close() stops scanning, restore it with our bg scan period */
+    if (ar->arWmiReady == TRUE) {
+        ar6k_cfg80211_scanparams(ar);
+    }
+#endif /* ATH6K_CONFIG_CFG80211 */
+
     spin_lock_irqsave(&ar->arLock, flags);
 
 #ifdef ATH6K_CONFIG_CFG80211
@@ -2325,11 +2366,14 @@ ar6000_open(struct net_device *dev)
 static int
 ar6000_close(struct net_device *dev)
 {
-#ifdef ATH6K_CONFIG_CFG80211
     AR_SOFTC_T    *ar = (AR_SOFTC_T *)ar6k_priv(dev);
-#endif /* ATH6K_CONFIG_CFG80211 */
+
     netif_stop_queue(dev);
 
+    napi_disable(&ar->arNapi);
+    skb_queue_purge(&ar->arNapiRxQ);
+    wake_up(&ar->arNapiRxWait);
+
 #ifdef ATH6K_CONFIG_CFG80211
     AR6000_SPIN_LOCK(&ar->arLock, 0);
     if (ar->arConnected == TRUE || ar->arConnectPending == TRUE) {
@@ -2348,6 +2392,11 @@ ar6000_close(struct net_device *dev)
     }
 #endif /* ATH6K_CONFIG_CFG80211 */
 
+    /* keep the firmware, but let the target sleep while we are down */
+    if (fwretain && ar->arWmiReady == TRUE) {
+        ar6000_set_wlan_state(ar, WLAN_DISABLED);
+    }
+
     return 0;
 }
 
@@ -2669,6 +2718,10 @@ int ar6000_init(struct net_device *dev)
     /* allocate some buffers that handle larger AMSDU frames */
     ar6000_refill_amsdu_rxbufs(ar,AR6000_MAX_AMSDU_RX_BUFFERS);
 
+    /* and a window's worth of spare RX buffers: refills take from this pool
+     * before allocating, and buffers we free ourselves go back to it */
+    A_NETBUF_POOL_FILL(&ar->rx_buffer_pool, AR6000_RX_POOL_DEPTH, AR6000_BUFFER_SIZE);
+
         /* setup credit distribution */
     ar6000_setup_credit_dist(ar->arHtcTarget, &ar->arCreditStateInfo);
 
@@ -3516,9 +3569,10 @@ ar6000_tx_complete(void *Context, HTC_PACKET_QUEUE *pPacketQueue)
 
         /* free all skbs in our local list */
     while (!skb_queue_empty(&skb_queue)) {
-            /* use non-lock version */
+            /* use non-lock version, keep what can take an RX frame */
         pktSkb = __skb_dequeue(&skb_queue);
-        A_NETBUF_FREE(pktSkb);
+        A_NETBUF_RECYCLE(&ar->rx_buffer_pool, AR6000_RX_POOL_DEPTH, pktSkb,
+                         AR6000_BUFFER_SIZE);
     }
 
     if ((ar->arConnected == TRUE) || (bypasswmi)) {
@@ -3627,7 +3681,8 @@ ar6000_rx(void *Context, HTC_PACKET *pPacket)
     skb->dev = ar->arNetDev;
     if (status != A_OK) {
         AR6000_STAT_INC(ar, rx_errors);
-        A_NETBUF_FREE(skb);
+        A_NETBUF_RECYCLE(&ar->rx_buffer_pool, AR6000_RX_POOL_DEPTH, skb,
+                         AR6000_BUFFER_SIZE);
     } else if (ar->arWmiEnabled == TRUE) {
         if (ept == ar->arControlEp) {
            /*
@@ -3868,39 +3923,108 @@ rx_done:
     return;
 }
 
+/* Returns FALSE, having freed the frame, if the interface is down */
+static A_BOOL
+ar6000_prepare_frame_for_nw_stack(struct net_device *dev, struct sk_buff *skb)
+{
+    skb->dev = dev;
+    if ((dev->flags & IFF_UP) != IFF_UP) {
+        A_NETBUF_FREE(skb);
+        return FALSE;
+    }
+#ifdef CONFIG_PM 
+    ar6000_check_wow_status((AR_SOFTC_T *)ar6k_priv(dev), skb, FALSE);   
+#endif /* CONFIG_PM */
+    skb->protocol = eth_type_trans(skb, dev);
+    return TRUE;
+}
+
+/*
+ * Received frames are not handed to the stack here but queued for the NAPI
+ * poll, which feeds them to netif_receive_skb() AR6000_NAPI_WEIGHT at a time
+ * from a single softirq run.  If the stack falls behind, the caller (the SDIO
+ * interrupt thread, when we are in process context) is held off until the
+ * poll has caught up, so no further interrupts are serviced meanwhile.
+ */
+static void
+ar6000_napi_throttle(AR_SOFTC_T *ar)
+{
+    if (in_interrupt() || skb_queue_len(&ar->arNapiRxQ) < AR6000_NAPI_RX_HIWAT) {
+        return;
+    }
+
+    wait_event_timeout(ar->arNapiRxWait,
+                       skb_queue_len(&ar->arNapiRxQ) < AR6000_NAPI_RX_LOWAT ||
+                       !netif_running(ar->arNetDev),
+                       msecs_to_jiffies(AR6000_NAPI_THROTTLE_MS));
+}
+
 static void
 ar6000_deliver_frames_to_nw_stack(void *dev, void *osbuf)
 {
     struct sk_buff *skb = (struct sk_buff *)osbuf;
+    AR_SOFTC_T *ar = (AR_SOFTC_T *)ar6k_priv((struct net_device *)dev);
 
     if(skb) {
-        skb->dev = dev;
-        if ((skb->dev->flags & IFF_UP) == IFF_UP) {
-#ifdef CONFIG_PM 
-            ar6000_check_wow_status((AR_SOFTC_T *)ar6k_priv(dev), skb, FALSE);   
-#endif /* CONFIG_PM */
-            skb->protocol = eth_type_trans(skb, skb->dev);
-        /*
-         * If this routine is called on a ISR (Hard IRQ) or DSR (Soft IRQ)
-         * or tasklet use the netif_rx to deliver the packet to the stack
-         * netif_rx will queue the packet onto the receive queue and mark
-         * the softirq thread has a pending action to complete. Kernel will 
-         * schedule the softIrq kernel thread after processing the DSR.
-         *
-         * If this routine is called on a process context, use netif_rx_ni
-         * which will schedle the softIrq kernel thread after queuing the packet.
-         */
-            if (in_interrupt()) {
-                netif_rx(skb);
-            } else {
-                netif_rx_ni(skb);
-            }
-        } else {
+        if (!netif_running((struct net_device *)dev)) {
             A_NETBUF_FREE(skb);
+            return;
         }
+        skb_queue_tail(&ar->arNapiRxQ, skb);
+        napi_schedule(&ar->arNapi);
+        ar6000_napi_throttle(ar);
     }
 }
 
+#ifdef ATH_AR6K_11N_SUPPORT
+/* A run of frames released by the reorder code: queue them in one go */
+static void
+ar6000_deliver_frame_batch_to_nw_stack(void *dev, A_NETBUF_QUEUE_T *q)
+{
+    AR_SOFTC_T *ar = (AR_SOFTC_T *)ar6k_priv((struct net_device *)dev);
+    unsigned long flags;
+
+    if (!netif_running((struct net_device *)dev)) {
+        skb_queue_purge(q);
+        return;
+    }
+    spin_lock_irqsave(&ar->arNapiRxQ.lock, flags);
+    skb_queue_splice_tail_init(q, &ar->arNapiRxQ);
+    spin_unlock_irqrestore(&ar->arNapiRxQ.lock, flags);
+    napi_schedule(&ar->arNapi);
+    ar6000_napi_throttle(ar);
+}
+#endif
+
+static int
+ar6000_napi_poll(struct napi_struct *napi, int budget)
+{
+    AR_SOFTC_T *ar = container_of(napi, AR_SOFTC_T, arNapi);
+    struct sk_buff *skb;
+    int done = 0;
+
+    while (done < budget && (skb = skb_dequeue(&ar->arNapiRxQ))) {
+        if (ar6000_prepare_frame_for_nw_stack(ar->arNetDev, skb)) {
+            netif_receive_skb(skb);
+        }
+        done++;
+    }
+
+    if (skb_queue_len(&ar->arNapiRxQ) < AR6000_NAPI_RX_LOWAT) {
+        wake_up(&ar->arNapiRxWait);
+    }
+
+    if (done < budget) {
+        napi_complete(napi);
+            /* a frame may have been queued after the dequeue above came up empty */
+        if (!skb_queue_empty(&ar->arNapiRxQ)) {
+            napi_schedule(napi);
+        }
+    }
+
+    return done;
+}
+
 #if 0
 static void
 ar6000_deliver_frames_to_bt_stack(void *dev, void *osbuf)
@@ -3943,7 +4067,7 @@ ar6000_rx_refill(void *Context, HTC_ENDPOINT_ID Endpoint)
                     buffersToRefill, Endpoint));
 
     for (RxBuffers = 0; RxBuffers < buffersToRefill; RxBuffers++) {
-        osBuf = A_NETBUF_ALLOC(AR6000_BUFFER_SIZE);
+        osBuf = A_NETBUF_ALLOC_POOLED(&ar->rx_buffer_pool, AR6000_BUFFER_SIZE);
         if (NULL == osBuf) {
             break;
         }
@@ -3961,6 +4085,16 @@ ar6000_rx_refill(void *Context, HTC_ENDPOINT_ID Endpoint)
         HTCAddReceivePktMultiple(ar->arHtcTarget, &queue);
     }
 
+}
+
+    /* free the recycled RX buffers */
+static void ar6000_cleanup_rx_pool(AR_SOFTC_T *ar)
+{
+    void        *osBuf;
+
+    while ((osBuf = A_NETBUF_DEQUEUE(&ar->rx_buffer_pool)) != NULL) {
+        A_NETBUF_FREE(osBuf);
+    }
 }
 
   /* clean up our amsdu buffer list */
@@ -4496,6 +4630,10 @@ skip_key:
     ar->arConnectPending = FALSE;
     netif_carrier_on(ar->arNetDev);
     spin_unlock_irqrestore(&ar->arLock, flags);
+
+    if (ar->arNetworkType == INFRA_NETWORK) {
+        ar6000_ps_policy_start(ar);
+    }
     /* reset the rx aggr state */
     aggr_reset_state(ar->aggr_cntxt);
     reconnect_flag = 0;
@@ -4510,7 +4648,7 @@ skip_key:
         ar->arNexEpId = ENDPOINT_2;
     }
    if (!ar->arUserBssFilter) {
-        wmi_bssfilter_cmd(ar->arWmi, NONE_BSS_FILTER, 0);
+        wmi_bssfilter_cmd(ar->arWmi, ar6000_idle_bss_filter(ar), 0);
    }
 
 }
@@ -4705,6 +4843,8 @@ ar6000_disconnect_event(AR_SOFTC_T *ar, A_UINT8 reason, A_UINT8 *bssid,
     netif_carrier_off(ar->arNetDev);
     spin_unlock_irqrestore(&ar->arLock, flags);
 
+    ar6000_ps_policy_stop(ar, FALSE);
+
     if( (reason != CSERV_DISCONNECT) || (reconnect_flag != 1) ) {
         reconnect_flag = 0;
     }
@@ -4900,7 +5040,7 @@ ar6000_scanComplete_event(AR_SOFTC_T *ar, A_STATUS status)
 #endif /* ATH6K_CONFIG_CFG80211 */
 
     if (!ar->arUserBssFilter) {
-        wmi_bssfilter_cmd(ar->arWmi, NONE_BSS_FILTER, 0);
+        wmi_bssfilter_cmd(ar->arWmi, ar6000_idle_bss_filter(ar), 0);
     }
     if (ar->scan_triggered) {
         if (status==A_OK) {
@@ -5239,6 +5379,31 @@ ar6000_roam_data_event(AR_SOFTC_T *ar, WMI_TARGET_ROAM_DATA *p)
     }
 }
 
+/*
+ * BSS filter for the target once the host is done scanning.  While
+ * connected the firmware scans in the background every bgscan_period
+ * seconds; forwarding what it finds keeps the scan cache fresh without
+ * the host having to start scans of its own.  When not connected only
+ * host requested scans are forwarded.
+ */
+A_UINT8
+ar6000_idle_bss_filter(AR_SOFTC_T *ar)
+{
+    if (bgscan_period && ar->arConnected && ar->arNetworkType == INFRA_NETWORK) {
+        return ALL_BUT_BSS_FILTER;
+    }
+    return NONE_BSS_FILTER;
+}
+
+/* a scan table entry was added, or seen again, by wmi */
+void
+ar6000_bss_update_event(AR_SOFTC_T *ar, bss_t *bss, A_BOOL changed)
+{
+#ifdef ATH6K_CONFIG_CFG80211
+    ar6k_cfg80211_bss_event(ar, bss, changed);
+#endif /* ATH6K_CONFIG_CFG80211 */
+}
+
 void
 ar6000_bssInfo_event_rx(AR_SOFTC_T *ar, A_UINT8 *datap, int len)
 {
@@ -95,6 +95,9 @@ static void ar6000_wow_resume(AR_SOFTC_T *ar)
         if (wmi_set_host_sleep_mode_cmd(ar->arWmi, &hostSleepMode)!=A_OK) {
             AR_DEBUG_PRINTF(ATH_DEBUG_ERR,("Fail to setup restore host awake\n"));
         }
+        if (!ar->arUserBssFilter) {
+            wmi_bssfilter_cmd(ar->arWmi, ar6000_idle_bss_filter(ar), 0);
+        }
 #if WOW_SET_SCAN_PARAMS
         wmi_scanparams_cmd(ar->arWmi, fg_start_period,
                                    ar->scParams.fg_end_period,
@@ -158,6 +161,10 @@ static void ar6000_wow_suspend(AR_SOFTC_T *ar)
 #if WOW_SET_SCAN_PARAMS
         status = wmi_scanparams_cmd(ar->arWmi, 0xFFFF, 0, 0xFFFF, 0, 0, 0, 0, 0, 0, 0);
 #endif
+        /* background scan results must not wake us, only the patterns below */
+        if (!ar->arUserBssFilter) {
+            wmi_bssfilter_cmd(ar->arWmi, NONE_BSS_FILTER, 0);
+        }
         /* clear up our WoW pattern first */
         delWowCmd.filter_list_id = WOW_LIST_ID;
         delWowCmd.filter_id = 0;
@@ -230,6 +237,8 @@ A_STATUS ar6000_suspend_ev(void *context)
     A_STATUS status = A_OK;
     AR_SOFTC_T *ar = (AR_SOFTC_T *)context;
     A_INT16 pmmode = ar->arSuspendConfig;
+
+    ar6000_ps_policy_stop(ar, TRUE);
 wow_not_connected:
     switch (pmmode) {
     case WLAN_SUSPEND_WOW:
@@ -274,6 +283,9 @@ A_STATUS ar6000_resume_ev(void *context)
     switch (powerState) {
     case WLAN_POWER_STATE_WOW:
         ar6000_wow_resume(ar);
+        if (ar->arConnected && ar->arNetworkType == INFRA_NETWORK) {
+            ar6000_ps_policy_start(ar);
+        }
         break;
     case WLAN_POWER_STATE_CUT_PWR:
         /* fall through */
@@ -700,6 +712,175 @@ ar6000_set_wlan_state(struct ar6_softc *ar, AR6000_WLAN_STATE state)
     return status;
 }
 
+/*
+ * Traffic driven power save.
+ *
+ * While connected to an AP the rx + tx rate is sampled every second.  At
+ * pspolicy_up_kbps or more the target is put into MAX_PERF_POWER straight
+ * away; once the rate has stayed below pspolicy_down_kbps for
+ * pspolicy_down_secs samples it goes back to REC_POWER (PS-Poll) with a
+ * listen interval of at least pspolicy_idle_listen TUs.  The time spent and
+ * the traffic moved in each mode are in the netdev's ps_policy attribute.
+ *
+ * If somebody else changes the power mode the policy stands down until the
+ * next connection.
+ */
+#define PS_POLICY_SAMPLE_MS    1000
+
+unsigned int pspolicy = 1;
+unsigned int pspolicy_up_kbps = 1000;
+unsigned int pspolicy_down_kbps = 100;
+unsigned int pspolicy_down_secs = 5;
+unsigned int pspolicy_idle_listen = 500;
+module_param(pspolicy, uint, 0644);
+module_param(pspolicy_up_kbps, uint, 0644);
+module_param(pspolicy_down_kbps, uint, 0644);
+module_param(pspolicy_down_secs, uint, 0644);
+module_param(pspolicy_idle_listen, uint, 0644);
+
+static void ar6000_ps_policy_set(AR_SOFTC_T *ar, A_BOOL maxPerf)
+{
+    AR6000_PS_POLICY *ps = &ar->psPolicy;
+
+    if (maxPerf) {
+        wmi_powermode_cmd(ar->arWmi, MAX_PERF_POWER);
+        wmi_listeninterval_cmd(ar->arWmi, ar->arListenIntervalT, ar->arListenIntervalB);
+    } else {
+        wmi_powermode_cmd(ar->arWmi, REC_POWER);
+        wmi_listeninterval_cmd(ar->arWmi,
+                               max(ar->arListenIntervalT, (A_UINT16)pspolicy_idle_listen), 0);
+    }
+
+    AR_DEBUG_PRINTF(ATH_DEBUG_PM, ("ps policy: %s\n", maxPerf ? "max perf" : "power save"));
+    ps->maxPerf = maxPerf;
+    ps->quietSamples = 0;
+    ps->switches++;
+}
+
+static void ar6000_ps_policy_work(struct work_struct *work)
+{
+    AR6000_PS_POLICY *ps = container_of(work, AR6000_PS_POLICY, work.work);
+    AR_SOFTC_T *ar = container_of(ps, AR_SOFTC_T, psPolicy);
+    unsigned long now = jiffies;
+    unsigned long bytes = ar->arNetStats.rx_bytes + ar->arNetStats.tx_bytes;
+    unsigned long delta = bytes - ps->lastBytes;
+    unsigned int ms = jiffies_to_msecs(now - ps->lastSample);
+    unsigned int kbps = ms ? (delta * 8) / ms : 0;
+
+    if (!ps->active) {
+        return;
+    }
+
+    ps->lastBytes = bytes;
+    ps->lastSample = now;
+    ps->timeMs[ps->maxPerf] += ms;
+    ps->bytes[ps->maxPerf] += delta;
+    if (kbps > ps->peakKbps[ps->maxPerf]) {
+        ps->peakKbps[ps->maxPerf] = kbps;
+    }
+
+    if (wmi_get_power_mode_cmd(ar->arWmi) != (ps->maxPerf ? MAX_PERF_POWER : REC_POWER)) {
+        AR_DEBUG_PRINTF(ATH_DEBUG_PM, ("ps policy: power mode set elsewhere, standing down\n"));
+        ps->active = FALSE;
+        return;
+    }
+
+    if (pspolicy) {
+        if (!ps->maxPerf) {
+            if (kbps >= pspolicy_up_kbps) {
+                ar6000_ps_policy_set(ar, TRUE);
+            }
+        } else if (kbps < pspolicy_down_kbps) {
+            if (++ps->quietSamples >= pspolicy_down_secs) {
+                ar6000_ps_policy_set(ar, FALSE);
+            }
+        } else {
+            ps->quietSamples = 0;
+        }
+    } else if (ps->maxPerf) {
+            /* switched off while busy, leave the target in power save */
+        ar6000_ps_policy_set(ar, FALSE);
+    }
+
+    schedule_delayed_work(&ps->work, msecs_to_jiffies(PS_POLICY_SAMPLE_MS));
+}
+
+/* Called on connection: begin in MAX_PERF_POWER for the DHCP and whatever else follows */
+void ar6000_ps_policy_start(AR_SOFTC_T *ar)
+{
+    AR6000_PS_POLICY *ps = &ar->psPolicy;
+
+    if (!pspolicy || ps->active || wmi_get_power_mode_cmd(ar->arWmi) != REC_POWER) {
+        return;
+    }
+
+    ps->lastBytes = ar->arNetStats.rx_bytes + ar->arNetStats.tx_bytes;
+    ps->lastSample = jiffies;
+    ar6000_ps_policy_set(ar, TRUE);
+    ps->active = TRUE;
+    schedule_delayed_work(&ps->work, msecs_to_jiffies(PS_POLICY_SAMPLE_MS));
+}
+
+/* Called on disconnection, suspend and shutdown; the target is left as it is */
+void ar6000_ps_policy_stop(AR_SOFTC_T *ar, A_BOOL sync)
+{
+    AR6000_PS_POLICY *ps = &ar->psPolicy;
+
+    ps->active = FALSE;
+    if (sync) {
+        cancel_delayed_work_sync(&ps->work);
+    } else {
+        cancel_delayed_work(&ps->work);
+    }
+}
+
+static ssize_t ar6000_ps_policy_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    AR_SOFTC_T *ar = (AR_SOFTC_T *)ar6k_priv(to_net_dev(dev));
+    AR6000_PS_POLICY *ps = &ar->psPolicy;
+    static const char *names[2] = { "power_save", "max_perf" };
+    ssize_t len;
+    int i;
+
+    len = sprintf(buf, "mode %s%s\nswitches %u\n", names[ps->maxPerf],
+                  ps->active ? "" : " (inactive)", ps->switches);
+    for (i = 0; i < 2; i++) {
+        unsigned long long kbits = ps->bytes[i] * 8;
+
+        if (ps->timeMs[i]) {
+            do_div(kbits, ps->timeMs[i]);
+        } else {
+            kbits = 0;
+        }
+        len += sprintf(buf + len, "%s time_ms %lu bytes %llu avg_kbps %llu peak_kbps %u\n",
+                       names[i], ps->timeMs[i], ps->bytes[i], kbits, ps->peakKbps[i]);
+    }
+
+    return len;
+}
+
+static DEVICE_ATTR(ps_policy, S_IRUGO, ar6000_ps_policy_show, NULL);
+
+void ar6000_ps_policy_init(AR_SOFTC_T *ar)
+{
+    A_MEMZERO(&ar->psPolicy, sizeof(ar->psPolicy));
+    INIT_DELAYED_WORK(&ar->psPolicy.work, ar6000_ps_policy_work);
+}
+
+void ar6000_ps_policy_register(AR_SOFTC_T *ar)
+{
+    if (device_create_file(&ar->arNetDev->dev, &dev_attr_ps_policy)) {
+        AR_DEBUG_PRINTF(ATH_DEBUG_ERR, ("ar6000: failed to create ps_policy attribute\n"));
+    }
+}
+
+void ar6000_ps_policy_unregister(AR_SOFTC_T *ar)
+{
+    ar6000_ps_policy_stop(ar, TRUE);
+    device_remove_file(&ar->arNetDev->dev, &dev_attr_ps_policy);
+}
+
 void ar6000_pm_init()
 {
     A_REGISTER_MODULE_DEBUG_INFO(pm);
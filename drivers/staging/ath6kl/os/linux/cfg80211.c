@@ -33,6 +33,11 @@
 extern A_WAITQUEUE_HEAD arEvent;
 extern unsigned int wmitimeout;
 extern int reconnect_flag;
+extern unsigned int bgscan_period;
+
+/* refresh cfg80211's copy of a BSS that keeps beaconing unchanged well
+ * before its scan result expiry (15s) drops it */
+#define AR6K_BSS_REFRESH_MS     5000
 
 
 #define RATETAB_ENT(_rate, _rateid, _flags) {   \
@@ -664,10 +669,9 @@ ar6k_cfg80211_disconnect_event(AR_SOFTC_T *ar, A_UINT8 reason,
     }
 }
 
-void
-ar6k_cfg80211_scan_node(void *arg, bss_t *ni)
+static void
+ar6k_cfg80211_inform_bss(struct wiphy *wiphy, bss_t *ni, gfp_t gfp)
 {
-    struct wiphy *wiphy = (struct wiphy *)arg;
     A_UINT16 size;
     unsigned char *ieeemgmtbuf = NULL;
     struct ieee80211_mgmt *mgmt;
@@ -723,11 +727,59 @@ ar6k_cfg80211_scan_node(void *arg, bss_t *ni)
                    channel->hw_value, freq, size));
     cfg80211_inform_bss_frame(wiphy, channel, mgmt,
                               le16_to_cpu(size),
-                              signal, GFP_KERNEL);
+                              signal, gfp);
 
     A_FREE (ieeemgmtbuf);
 }
 
+/*
+ * Called for every beacon/probe response wmi keeps in its scan table, from
+ * host requested and firmware background scans alike.  cfg80211 holds the
+ * BSS list user space reads, nl80211 and WEXT, so scan results no longer
+ * have to be rebuilt from the node table when a scan completes.
+ */
+void
+ar6k_cfg80211_bss_event(AR_SOFTC_T *ar, bss_t *ni, A_BOOL changed)
+{
+    if (!ar->wdev) {
+        return;
+    }
+
+    if (!changed && A_MS_SINCE(ni->ni_informed) < AR6K_BSS_REFRESH_MS) {
+        return;
+    }
+
+    ni->ni_informed = A_GET_MS(0);
+    ar6k_cfg80211_inform_bss(ar->wdev->wiphy, ni, GFP_ATOMIC);
+}
+
+/*
+ * Program the user's scan parameters, or the defaults, with the firmware
+ * background scan period set by bgscan_period when the user did not pick
+ * one: the target then finds roaming candidates and refreshes the scan
+ * cache while connected without host requested scans.
+ */
+A_STATUS
+ar6k_cfg80211_scanparams(AR_SOFTC_T *ar)
+{
+    A_UINT16 bg_period = ar->scParams.bg_period;
+
+    if (!bg_period) {
+        bg_period = bgscan_period ? min(bgscan_period, 0xFFFEU) : 0xFFFF;
+    }
+
+    return wmi_scanparams_cmd(ar->arWmi, ar->scParams.fg_start_period,
+                              ar->scParams.fg_end_period,
+                              bg_period,
+                              ar->scParams.minact_chdwell_time,
+                              ar->scParams.maxact_chdwell_time,
+                              ar->scParams.pas_chdwell_time,
+                              ar->scParams.shortScanRatio,
+                              ar->scParams.scanCtrlFlags,
+                              ar->scParams.max_dfsch_act_time,
+                              ar->scParams.maxact_scan_per_ssid);
+}
+
 static int
 ar6k_cfg80211_scan(struct wiphy *wiphy, struct net_device *ndev,
                    struct cfg80211_scan_request *request)
@@ -795,9 +847,7 @@ ar6k_cfg80211_scanComplete_event(AR_SOFTC_T *ar, A_STATUS status)
 
     if(ar->scan_request)
     {
-        /* Translate data to cfg80211 mgmt format */
-        wmi_iterate_nodes(ar->arWmi, ar6k_cfg80211_scan_node, ar->wdev->wiphy);
-
+        /* results went to cfg80211 as they came in, see ar6k_cfg80211_bss_event() */
         cfg80211_scan_done(ar->scan_request,
                           (status & A_ECANCELED) ? true : false);
 
@@ -1099,6 +1149,12 @@ ar6k_cfg80211_set_bitrate_mask(struct wiphy *wiphy, struct net_device *dev,
 }
 
 /* The type nl80211_tx_power_setting replaces the following data type from 2.6.36 onwards */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,36)
+#define nl80211_tx_power_setting    tx_power_setting
+#define NL80211_TX_POWER_AUTOMATIC  TX_POWER_AUTOMATIC
+#define NL80211_TX_POWER_LIMITED    TX_POWER_LIMITED
+#endif
+
 static int
 ar6k_cfg80211_set_txpower(struct wiphy *wiphy, enum nl80211_tx_power_setting type, int dbm)
 {
@@ -1465,6 +1521,7 @@ ar6k_cfg80211_deinit(AR_SOFTC_T *ar)
     if(!wdev)
         return;
 
+    ar->wdev = NULL;
     wiphy_unregister(wdev->wiphy);
     wiphy_free(wdev->wiphy);
     kfree(wdev);
@@ -139,6 +139,11 @@ extern "C" {
 #define MAX_AR6000                        1
 #define AR6000_MAX_RX_BUFFERS             16
 #define AR6000_BUFFER_SIZE                1664
+#define AR6000_RX_POOL_DEPTH              AR6000_MAX_RX_BUFFERS /* recycled RX buffers */
+#define AR6000_NAPI_WEIGHT                32
+#define AR6000_NAPI_RX_HIWAT              (4 * AR6000_MAX_RX_BUFFERS) /* hold off the SDIO irq above this */
+#define AR6000_NAPI_RX_LOWAT              AR6000_MAX_RX_BUFFERS
+#define AR6000_NAPI_THROTTLE_MS           20
 #define AR6000_MAX_AMSDU_RX_BUFFERS       4
 #define AR6000_AMSDU_REFILL_THRESHOLD     3
 #define AR6000_AMSDU_BUFFER_SIZE          (WMI_MAX_AMSDU_RX_DATA_FRAME_LENGTH + 128)
@@ -468,6 +473,21 @@ typedef struct ar6_raw_htc {
     A_BOOL                  read_buffer_available[HTC_RAW_STREAM_NUM_MAX];
 } AR_RAW_HTC_T;
 
+/* traffic driven power save policy, see ar6000_pm.c */
+typedef struct {
+    struct delayed_work work;
+    A_BOOL              active;         /* sampling, while connected to an AP */
+    A_BOOL              maxPerf;        /* in MAX_PERF_POWER rather than REC_POWER */
+    unsigned long       lastBytes;      /* rx + tx bytes at the last sample */
+    unsigned long       lastSample;     /* jiffies */
+    unsigned int        quietSamples;   /* consecutive samples below the low mark */
+    unsigned int        switches;
+        /* per mode, indexed by maxPerf */
+    unsigned long       timeMs[2];
+    unsigned long long  bytes[2];
+    unsigned int        peakKbps[2];
+} AR6000_PS_POLICY;
+
 typedef struct ar6_softc {
     struct net_device       *arNetDev;    /* net_device pointer */
     void                    *arWmi;
@@ -589,6 +609,11 @@ typedef struct ar6_softc {
     A_UINT16                arRTS;
     A_UINT16                arACS; /* AP mode - Auto Channel Selection */
     HTC_PACKET_QUEUE        amsdu_rx_buffer_queue;
+    A_NETBUF_QUEUE_T        rx_buffer_pool;     /* recycled RX buffers */
+    AR6000_PS_POLICY        psPolicy;
+    struct napi_struct      arNapi;
+    struct sk_buff_head     arNapiRxQ;          /* frames waiting for the poll */
+    wait_queue_head_t       arNapiRxWait;       /* RX throttled until arNapiRxQ drains */
     A_BOOL                  bIsDestroyProgress; /* flag to indicate ar6k destroy is in progress */
     A_TIMER                 disconnect_timer;
     A_UINT8		    rxMetaVersion;
@@ -107,6 +107,8 @@ A_STATUS ar6000_get_driver_cfg(struct net_device *dev,
                                 A_UINT16 cfgParam,
                                 void *result);
 void ar6000_bssInfo_event_rx(struct ar6_softc *ar, A_UINT8 *data, int len);
+void ar6000_bss_update_event(struct ar6_softc *ar, bss_t *bss, A_BOOL changed);
+A_UINT8 ar6000_idle_bss_filter(struct ar6_softc *ar);
 
 void ar6000_dbglog_event(struct ar6_softc *ar, A_UINT32 dropped,
                          A_INT8 *buffer, A_UINT32 length);
@@ -185,6 +187,12 @@ void ar6000_check_wow_status(struct ar6_softc *ar, struct sk_buff *skb, A_BOOL i
 void ar6000_pm_init(void);
 void ar6000_pm_exit(void);
 
+void ar6000_ps_policy_init(struct ar6_softc *ar);
+void ar6000_ps_policy_register(struct ar6_softc *ar);
+void ar6000_ps_policy_unregister(struct ar6_softc *ar);
+void ar6000_ps_policy_start(struct ar6_softc *ar);
+void ar6000_ps_policy_stop(struct ar6_softc *ar, A_BOOL sync);
+
 #ifdef CONFIG_AP_VIRTUAL_ADAPTER_SUPPORT
 A_STATUS ar6000_add_ap_interface(struct ar6_softc *ar, char *ifname);
 A_STATUS ar6000_remove_ap_interface(struct ar6_softc *ar);
@@ -36,6 +36,7 @@
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/timer.h>
 #include <linux/delay.h>
 #include <linux/wait.h>
@@ -122,6 +123,10 @@ typedef spinlock_t                      A_MUTEX_T;
 /* Get current time in ms adding a constant offset (in ms) */
 #define A_GET_MS(offset)    \
 	(jiffies + ((offset) / 1000) * HZ)
+/* Milliseconds elapsed since a timestamp taken with A_GET_MS(0) */
+#define A_MS_SINCE(stamp)   jiffies_to_msecs(jiffies - (stamp))
+/* Microsecond clock for timing short stretches of work, wraps */
+#define A_GET_US()          ((A_UINT32)ktime_to_us(ktime_get()))
 
 /*
  * Timer Functions
@@ -258,6 +263,12 @@ typedef struct sk_buff_head A_NETBUF_QUEUE_T;
     a_netbuf_alloc_raw(size)
 #define A_NETBUF_FREE(bufPtr) \
     a_netbuf_free(bufPtr)
+#define A_NETBUF_ALLOC_POOLED(pool, size) \
+    a_netbuf_alloc_pooled((pool), (size))
+#define A_NETBUF_RECYCLE(pool, depth, bufPtr, size) \
+    a_netbuf_recycle((pool), (depth), (bufPtr), (size))
+#define A_NETBUF_POOL_FILL(pool, depth, size) \
+    a_netbuf_pool_fill((pool), (depth), (size))
 #define A_NETBUF_DATA(bufPtr) \
     a_netbuf_to_data(bufPtr)
 #define A_NETBUF_LEN(bufPtr) \
@@ -305,6 +316,9 @@ typedef struct sk_buff_head A_NETBUF_QUEUE_T;
 void *a_netbuf_alloc(int size);
 void *a_netbuf_alloc_raw(int size);
 void a_netbuf_free(void *bufPtr);
+void *a_netbuf_alloc_pooled(A_NETBUF_QUEUE_T *pool, int size);
+void a_netbuf_recycle(A_NETBUF_QUEUE_T *pool, int depth, void *bufPtr, int size);
+void a_netbuf_pool_fill(A_NETBUF_QUEUE_T *pool, int depth, int size);
 void *a_netbuf_to_data(void *bufPtr);
 A_UINT32 a_netbuf_to_len(void *bufPtr);
 A_STATUS a_netbuf_push(void *bufPtr, A_INT32 len);
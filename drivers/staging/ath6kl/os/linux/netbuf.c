@@ -70,6 +70,64 @@ a_netbuf_alloc(int size)
     return ((void *)skb);
 }
 
+/*
+ * Take a buffer from a recycling pool, laid out as a_netbuf_alloc() lays it
+ * out, or allocate one if the pool is empty.  A pool holds buffers of at
+ * least this size only.
+ */
+void *
+a_netbuf_alloc_pooled(A_NETBUF_QUEUE_T *pool, int size)
+{
+    struct sk_buff *skb;
+
+    skb = skb_dequeue((struct sk_buff_head *) pool);
+    if (skb == NULL) {
+        return a_netbuf_alloc(size);
+    }
+    skb_reserve(skb, AR6000_DATA_OFFSET + sizeof(HTC_PACKET) + A_GET_CACHE_LINE_BYTES());
+    return ((void *)skb);
+}
+
+/*
+ * Put a buffer we are done with into a recycling pool of up to depth
+ * buffers instead of freeing it.  That only works if it is big enough to
+ * be handed out as a_netbuf_alloc(size) again and nothing else refers to
+ * its data; anything else is freed.
+ */
+void
+a_netbuf_recycle(A_NETBUF_QUEUE_T *pool, int depth, void *bufPtr, int size)
+{
+    struct sk_buff *skb = (struct sk_buff *)bufPtr;
+
+    size += 2 * (A_GET_CACHE_LINE_BYTES());
+    if (skb_queue_len((struct sk_buff_head *) pool) < depth &&
+        skb_recycle_check(skb, AR6000_DATA_OFFSET + sizeof(HTC_PACKET) + size)) {
+        skb_queue_tail((struct sk_buff_head *) pool, skb);
+        return;
+    }
+
+    dev_kfree_skb(skb);
+}
+
+/*
+ * Preallocate buffers of the given size into a recycling pool, up to depth.
+ */
+void
+a_netbuf_pool_fill(A_NETBUF_QUEUE_T *pool, int depth, int size)
+{
+    struct sk_buff *skb;
+
+    size += 2 * (A_GET_CACHE_LINE_BYTES());
+    while (skb_queue_len((struct sk_buff_head *) pool) < depth) {
+            /* pooled buffers are kept unreserved, as skb_recycle_check() leaves them */
+        skb = dev_alloc_skb(AR6000_DATA_OFFSET + sizeof(HTC_PACKET) + size);
+        if (skb == NULL) {
+            break;
+        }
+        skb_queue_tail((struct sk_buff_head *) pool, skb);
+    }
+}
+
 /*
  * Allocate an SKB w.o. any encapsulation requirement.
  */
@@ -2680,8 +2680,14 @@ static const iw_handler ath_handlers[] = {
     (iw_handler) NULL,                          /* -- hole -- */
 #endif  /* WIRELESS_EXT >= 18 */
     (iw_handler) ar6000_ioctl_iwaplist,         /* SIOCGIWAPLIST */
+#if defined(ATH6K_CONFIG_CFG80211) && defined(CONFIG_CFG80211_WEXT)
+    /* scan through cfg80211 and read results from its BSS list */
+    (iw_handler) cfg80211_wext_siwscan,         /* SIOCSIWSCAN */
+    (iw_handler) cfg80211_wext_giwscan,         /* SIOCGIWSCAN */
+#else
     (iw_handler) ar6000_ioctl_siwscan,          /* SIOCSIWSCAN */
     (iw_handler) ar6000_ioctl_giwscan,          /* SIOCGIWSCAN */
+#endif
     (iw_handler) W_PROTO(ar6000_ioctl_siwessid),/* SIOCSIWESSID */
     (iw_handler) ar6000_ioctl_giwessid,         /* SIOCGIWESSID */
     (iw_handler) NULL,                          /* SIOCSIWNICKN */
@@ -63,6 +63,7 @@ typedef struct {
     void        *osbuf;
     A_BOOL      is_amsdu;
     A_UINT16    seq_no;
+    A_UINT32    hold_ts;            /* A_GET_MS(0) when put in the hold q */
 }OSBUF_HOLD_Q;
 
 
@@ -98,6 +99,11 @@ typedef struct {
     A_UINT32    num_timeouts;       /* num of timeouts, during which frames delivered */
     A_UINT32    num_hole;           /* frame not present, when window moved over */
     A_UINT32    num_bar;            /* num of resets of seq_num, via BAR */
+    A_UINT32    num_timeout_frms;   /* frames delivered by timeouts */
+    A_UINT32    num_batches;        /* runs of frames handed up together */
+    A_UINT32    num_held;           /* frames that went through the hold q */
+    A_UINT32    hold_ms_total;      /* time they spent there */
+    A_UINT32    hold_ms_max;
 }RXTID_STATS;
 
 typedef struct {
@@ -106,6 +112,7 @@ typedef struct {
     A_TIMER             timer;              /* timer for returning held up pkts in re-order que */    
     void                *dev;               /* dev handle */
     RX_CALLBACK         rx_fn;              /* callback function to return frames; to upper layer */
+    RX_BATCH_CALLBACK   rx_batch_fn;        /* same, a queue of frames at a time */
     RXTID               RxTid[NUM_OF_TIDS]; /* Per tid window */
     ALLOC_NETBUFS       netbuf_allocator;   /* OS netbuf alloc fn */
     A_NETBUF_QUEUE_T    freeQ;              /* pre-allocated buffers - for A_MSDU slicing */
@@ -46,7 +46,7 @@ static void
 aggr_deque_frms(AGGR_INFO *p_aggr, A_UINT8 tid, A_UINT16 seq_no, A_UINT8 order);
 
 static void
-aggr_dispatch_frames(AGGR_INFO *p_aggr, A_NETBUF_QUEUE_T *q);
+aggr_dispatch_frames(AGGR_INFO *p_aggr, RXTID_STATS *stats, A_NETBUF_QUEUE_T *q);
 
 static void *
 aggr_get_osbuf(AGGR_INFO *p_aggr);
@@ -185,6 +185,16 @@ aggr_register_rx_dispatcher(void *cntxt, void * dev, RX_CALLBACK fn)
     p_aggr->dev = dev;
 }
 
+void
+aggr_register_rx_batch_dispatcher(void *cntxt, RX_BATCH_CALLBACK fn)
+{
+    AGGR_INFO *p_aggr = (AGGR_INFO *)cntxt;
+
+    A_ASSERT(p_aggr);
+
+    p_aggr->rx_batch_fn = fn;
+}
+
 
 void
 aggr_process_bar(void *cntxt, A_UINT8 tid, A_UINT16 seq_no)
@@ -312,6 +322,14 @@ aggr_deque_frms(AGGR_INFO *p_aggr, A_UINT8 tid, A_UINT16 seq_no, A_UINT8 order)
          *  2. we need to deque frames, irrespective of holes
          */
         if(node->osbuf) {
+            A_UINT32 held = A_MS_SINCE(node->hold_ts);
+
+            stats->num_held++;
+            stats->hold_ms_total += held;
+            if(held > stats->hold_ms_max) {
+                stats->hold_ms_max = held;
+            }
+
             if(node->is_amsdu) {
                 aggr_slice_amsdu(p_aggr, rxtid, &node->osbuf);
             } else {
@@ -330,7 +348,7 @@ aggr_deque_frms(AGGR_INFO *p_aggr, A_UINT8 tid, A_UINT16 seq_no, A_UINT8 order)
     A_MUTEX_UNLOCK(&rxtid->lock);
 
     stats->num_delivered += A_NETBUF_QUEUE_SIZE(&rxtid->q);
-    aggr_dispatch_frames(p_aggr, &rxtid->q);
+    aggr_dispatch_frames(p_aggr, stats, &rxtid->q);
 }
 
 static void *
@@ -448,7 +466,7 @@ aggr_process_recv_frm(void *cntxt, A_UINT8 tid, A_UINT16 seq_no, A_BOOL is_amsdu
         if(is_amsdu) {
             aggr_slice_amsdu(p_aggr, rxtid, osbuf);
             stats->num_amsdu++;
-            aggr_dispatch_frames(p_aggr, &rxtid->q);
+            aggr_dispatch_frames(p_aggr, stats, &rxtid->q);
         }
         return;
     }
@@ -525,6 +543,7 @@ aggr_process_recv_frm(void *cntxt, A_UINT8 tid, A_UINT16 seq_no, A_BOOL is_amsdu
     node->osbuf = *osbuf;
     node->is_amsdu = is_amsdu;
     node->seq_no = seq_no;
+    node->hold_ts = A_GET_MS(0);
     if(node->is_amsdu) {
         stats->num_amsdu++;
     } else {
@@ -579,6 +598,7 @@ aggr_timeout(A_ATH_TIMER arg)
     AGGR_INFO *p_aggr = (AGGR_INFO *)arg;
     RXTID   *rxtid;
     RXTID_STATS *stats;
+    A_UINT32 delivered;
     /*
      * If the q for which the timer was originally started has
      * not progressed then it is necessary to dequeue all the
@@ -596,7 +616,9 @@ aggr_timeout(A_ATH_TIMER arg)
         // dequeue all frames in for this tid
         stats->num_timeouts++;
         A_PRINTF("TO: st %d end %d\n", rxtid->seq_next, ((rxtid->seq_next + rxtid->hold_q_sz-1) & IEEE80211_MAX_SEQ_NO));
+        delivered = stats->num_delivered;
         aggr_deque_frms(p_aggr, i, 0, ALL_SEQNO);
+        stats->num_timeout_frms += stats->num_delivered - delivered;
     }
 
     p_aggr->timerScheduled = FALSE;
@@ -630,10 +652,18 @@ aggr_timeout(A_ATH_TIMER arg)
 }
 
 static void
-aggr_dispatch_frames(AGGR_INFO *p_aggr, A_NETBUF_QUEUE_T *q)
+aggr_dispatch_frames(AGGR_INFO *p_aggr, RXTID_STATS *stats, A_NETBUF_QUEUE_T *q)
 {
     void *osbuf;
 
+    if(p_aggr->rx_batch_fn) {
+        if(A_NETBUF_QUEUE_SIZE(q)) {
+            stats->num_batches++;
+            p_aggr->rx_batch_fn(p_aggr->dev, q);
+        }
+        return;
+    }
+
     while((osbuf = A_NETBUF_DEQUEUE(q))) {
         p_aggr->rx_fn(p_aggr->dev, osbuf);
     }
@@ -659,6 +689,14 @@ aggr_dump_stats(void *cntxt, PACKET_LOG **log_buf)
                     stats->num_hole, stats->num_bar,
                     rxtid->seq_next);
     }
+    A_PRINTF("tid: timeout frames, batches, held, avg hold ms, max hold ms\n");
+    for(i = 0; i < NUM_OF_TIDS; i++) {
+        stats = AGGR_GET_RXTID_STATS(p_aggr, i);
+        A_PRINTF("%d: %d %d %d %d %d\n", i, stats->num_timeout_frms,
+                    stats->num_batches, stats->num_held,
+                    stats->num_held ? stats->hold_ms_total / stats->num_held : 0,
+                    stats->hold_ms_max);
+    }
     A_PRINTF("================================================\n\n");
 
 }
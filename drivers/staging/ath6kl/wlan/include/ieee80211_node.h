@@ -52,11 +52,35 @@
 #define ieee80211_node_dectestref(_ni)  (((_ni)->ni_refcnt--) == 1)
 #define ieee80211_node_refcnt(_ni)      ((_ni)->ni_refcnt)
 
-#define IEEE80211_NODE_HASHSIZE 32
-/* simple hash is enough for variation of macaddr */
-#define IEEE80211_NODE_HASH(addr)   \
-    (((const A_UINT8 *)(addr))[IEEE80211_ADDR_LEN - 1] % \
-        IEEE80211_NODE_HASHSIZE)
+#define IEEE80211_NODE_HASHSIZE 64     /* power of 2 */
+#define IEEE80211_NODE_HASH(addr)   ieee80211_node_hash((const A_UINT8 *)(addr))
+#define IEEE80211_SSID_HASH(ssid, len) \
+    ieee80211_ssid_hash((const A_UINT8 *)(ssid), (len))
+
+/*
+ * Multi-BSSID APs and sequentially allocated addresses differ in the
+ * first or in the last bytes only, so every byte takes part.
+ */
+static INLINE int ieee80211_node_hash(const A_UINT8 *addr)
+{
+    A_UINT32 h = 0;
+    int i;
+
+    for (i = 0; i < IEEE80211_ADDR_LEN; i++) {
+        h = h * 31 + addr[i];
+    }
+    return (h ^ (h >> 6) ^ (h >> 12)) & (IEEE80211_NODE_HASHSIZE - 1);
+}
+
+static INLINE int ieee80211_ssid_hash(const A_UINT8 *ssid, A_UINT32 len)
+{
+    A_UINT32 h = len;
+
+    while (len--) {
+        h = h * 31 + *ssid++;
+    }
+    return (h ^ (h >> 6) ^ (h >> 12)) & (IEEE80211_NODE_HASHSIZE - 1);
+}
 
 /*
  * Table of ieee80211_node instances.  Each ieee80211com
@@ -70,6 +94,7 @@ struct ieee80211_node_table {
     struct bss              *nt_node_first; /* information of all nodes */
     struct bss              *nt_node_last;  /* information of all nodes */
     struct bss              *nt_hash[IEEE80211_NODE_HASHSIZE];
+    struct bss              *nt_ssid_hash[IEEE80211_NODE_HASHSIZE];
     const char              *nt_name;   /* for debugging */
     A_UINT32                nt_scangen; /* gen# for timeout scan */
 #ifdef THREAD_X
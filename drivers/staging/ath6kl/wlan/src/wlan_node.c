@@ -59,6 +59,7 @@ static void wlan_node_timeout(A_ATH_TIMER arg);
 
 static bss_t * _ieee80211_find_node (struct ieee80211_node_table *nt,
                                      const A_UINT8 *macaddr);
+void wlan_node_remove_core (struct ieee80211_node_table *nt, bss_t *ni);
 
 bss_t *
 wlan_node_alloc(struct ieee80211_node_table *nt, int wh_size)
@@ -86,6 +87,13 @@ wlan_node_alloc(struct ieee80211_node_table *nt, int wh_size)
     ni->ni_list_prev = NULL;
     ni->ni_hash_next = NULL;
     ni->ni_hash_prev = NULL;
+    ni->ni_ssid_next = NULL;
+    ni->ni_ssid_prev = NULL;
+
+    /* Nodes from opt frames are never parsed, don't leave junk behind */
+    A_MEMZERO(&ni->ni_cie, sizeof(ni->ni_cie));
+    ni->ni_framelen = 0;
+    ni->ni_informed = 0;
 
     //
     // ni_scangen never initialized before and during suspend/resume of winmobile,
@@ -115,6 +123,7 @@ wlan_setup_node(struct ieee80211_node_table *nt, bss_t *ni,
 {
     int hash;
     A_UINT32 timeoutValue = 0;
+    A_UINT8 *pIESsid;
 
     A_MEMCPY(ni->ni_macaddr, macaddr, IEEE80211_ADDR_LEN);
     hash = IEEE80211_NODE_HASH (macaddr);
@@ -148,6 +157,20 @@ wlan_setup_node(struct ieee80211_node_table *nt, bss_t *ni,
     ni->ni_hash_prev = NULL;
     nt->nt_hash[hash] = ni;
 
+    /* And into its SSID bucket, for the lookups done when connecting */
+    pIESsid = ni->ni_cie.ie_ssid;
+    if (pIESsid != NULL && pIESsid[1] <= IEEE80211_NWID_LEN) {
+        ni->ni_ssid_hash = IEEE80211_SSID_HASH(&pIESsid[2], pIESsid[1]);
+    } else {
+        ni->ni_ssid_hash = IEEE80211_SSID_HASH(NULL, 0);
+    }
+    if((ni->ni_ssid_next = nt->nt_ssid_hash[ni->ni_ssid_hash]) != NULL)
+    {
+        nt->nt_ssid_hash[ni->ni_ssid_hash]->ni_ssid_prev = ni;
+    }
+    ni->ni_ssid_prev = NULL;
+    nt->nt_ssid_hash[ni->ni_ssid_hash] = ni;
+
 #ifdef THREAD_X
     if (!nt->isTimerArmed) {
         A_TIMEOUT_MS(&nt->nt_inact_timer, timeoutValue, 0);
@@ -188,6 +211,34 @@ wlan_find_node(struct ieee80211_node_table *nt, const A_UINT8 *macaddr)
     return ni;
 }
 
+/*
+ * Beacons from an AP that hasn't changed anything differ from the copy
+ * already held only in their timestamp.  For those, take the timestamp
+ * and refresh the node's age in place instead of reallocating it and
+ * parsing its IEs again.  Returns FALSE if the frame must be reparsed.
+ */
+A_BOOL
+wlan_node_refresh(struct ieee80211_node_table *nt, bss_t *ni,
+                  const A_UINT8 *buf, int framelen)
+{
+    const int tstamp_len = 8;
+
+    if (framelen <= tstamp_len || framelen != ni->ni_framelen ||
+        A_MEMCMP(ni->ni_buf + tstamp_len, buf + tstamp_len,
+                 framelen - tstamp_len) != 0)
+    {
+        return FALSE;
+    }
+
+    IEEE80211_NODE_LOCK(nt);
+    A_MEMCPY(ni->ni_buf, buf, tstamp_len);
+    ni->ni_tstamp = A_GET_MS(nt->nt_nodeAge);
+    ni->ni_actcnt = WLAN_NODE_INACT_CNT;
+    IEEE80211_NODE_UNLOCK(nt);
+
+    return TRUE;
+}
+
 /*
  * Reclaim a node.  If this is the last reference count then
  * do the normal free work.  Otherwise remove it from the node
@@ -198,42 +249,7 @@ wlan_node_reclaim(struct ieee80211_node_table *nt, bss_t *ni)
 {
     IEEE80211_NODE_LOCK(nt);
 
-    if(ni->ni_list_prev == NULL)
-    {
-        /* First in list so fix the list head */
-        nt->nt_node_first = ni->ni_list_next;
-    }
-    else
-    {
-        ni->ni_list_prev->ni_list_next = ni->ni_list_next;
-    }
-
-    if(ni->ni_list_next == NULL)
-    {
-        /* Last in list so fix list tail */
-        nt->nt_node_last = ni->ni_list_prev;
-    }
-    else
-    {
-        ni->ni_list_next->ni_list_prev = ni->ni_list_prev;
-    }
-
-    if(ni->ni_hash_prev == NULL)
-    {
-        /* First in list so fix the list head */
-        int hash;
-        hash = IEEE80211_NODE_HASH(ni->ni_macaddr);
-        nt->nt_hash[hash] = ni->ni_hash_next;
-    }
-    else
-    {
-        ni->ni_hash_prev->ni_hash_next = ni->ni_hash_next;
-    }
-
-    if(ni->ni_hash_next != NULL)
-    {
-        ni->ni_hash_next->ni_hash_prev = ni->ni_hash_prev;
-    }
+    wlan_node_remove_core(nt, ni);
     wlan_node_free(ni);
 
     IEEE80211_NODE_UNLOCK(nt);
@@ -295,6 +311,7 @@ wlan_node_table_init(void *wmip, struct ieee80211_node_table *nt)
     for(i = 0; i < IEEE80211_NODE_HASHSIZE; i++)
     {
         nt->nt_hash[i] = NULL;
+        nt->nt_ssid_hash[i] = NULL;
     }
 
 #ifdef THREAD_X
@@ -430,43 +447,49 @@ wlan_node_table_cleanup(struct ieee80211_node_table *nt)
     IEEE80211_NODE_LOCK_DESTROY(nt);
 }
 
+static A_BOOL
+wlan_node_ssid_eq(bss_t *ni, const A_UCHAR *pSsid, A_UINT32 ssidLength)
+{
+    A_UCHAR *pIESsid = ni->ni_cie.ie_ssid;
+
+    return pIESsid != NULL && pIESsid[1] == ssidLength &&
+           memcmp(pSsid, &pIESsid[2], ssidLength) == 0;
+}
+
 bss_t *
 wlan_find_Ssidnode (struct ieee80211_node_table *nt, A_UCHAR *pSsid,
                     A_UINT32 ssidLength, A_BOOL bIsWPA2, A_BOOL bMatchSSID)
 {
     bss_t   *ni = NULL;
-    A_UCHAR *pIESsid = NULL;
+    int     hash;
 
     IEEE80211_NODE_LOCK (nt);
 
-    for (ni = nt->nt_node_first; ni; ni = ni->ni_list_next) {
-        pIESsid = ni->ni_cie.ie_ssid;
-        if (pIESsid[1] <= 32) {
-
-            // Step 1 : Check SSID
-            if (0x00 == memcmp (pSsid, &pIESsid[2], ssidLength)) {
-
-                //
-                // Step 2.1 : Check MatchSSID is TRUE, if so, return Matched SSID
-                // Profile, otherwise check whether WPA2 or WPA
-                //
-                if (TRUE == bMatchSSID) {
-                    ieee80211_node_incref (ni);  /* mark referenced */
-                    IEEE80211_NODE_UNLOCK (nt);
-                    return ni;
-                }
+    hash = IEEE80211_SSID_HASH(pSsid, ssidLength);
+    for (ni = nt->nt_ssid_hash[hash]; ni; ni = ni->ni_ssid_next) {
+        // Step 1 : Check SSID
+        if (wlan_node_ssid_eq(ni, pSsid, ssidLength)) {
+
+            //
+            // Step 2.1 : Check MatchSSID is TRUE, if so, return Matched SSID
+            // Profile, otherwise check whether WPA2 or WPA
+            //
+            if (TRUE == bMatchSSID) {
+                ieee80211_node_incref (ni);  /* mark referenced */
+                IEEE80211_NODE_UNLOCK (nt);
+                return ni;
+            }
 
-                // Step 2 : if SSID matches, check WPA or WPA2
-                if (TRUE == bIsWPA2 && NULL != ni->ni_cie.ie_rsn) {
-                    ieee80211_node_incref (ni);  /* mark referenced */
-                    IEEE80211_NODE_UNLOCK (nt);
-                    return ni;
-                }
-                if (FALSE == bIsWPA2 && NULL != ni->ni_cie.ie_wpa) {
-                    ieee80211_node_incref(ni);  /* mark referenced */
-                    IEEE80211_NODE_UNLOCK (nt);
-                    return ni;
-                }
+            // Step 2 : if SSID matches, check WPA or WPA2
+            if (TRUE == bIsWPA2 && NULL != ni->ni_cie.ie_rsn) {
+                ieee80211_node_incref (ni);  /* mark referenced */
+                IEEE80211_NODE_UNLOCK (nt);
+                return ni;
+            }
+            if (FALSE == bIsWPA2 && NULL != ni->ni_cie.ie_wpa) {
+                ieee80211_node_incref(ni);  /* mark referenced */
+                IEEE80211_NODE_UNLOCK (nt);
+                return ni;
             }
         }
     }
@@ -523,33 +546,40 @@ wlan_node_remove_core (struct ieee80211_node_table *nt, bss_t *ni)
     {
         ni->ni_hash_next->ni_hash_prev = ni->ni_hash_prev;
     }
+
+    if(ni->ni_ssid_prev == NULL)
+    {
+        nt->nt_ssid_hash[ni->ni_ssid_hash] = ni->ni_ssid_next;
+    }
+    else
+    {
+        ni->ni_ssid_prev->ni_ssid_next = ni->ni_ssid_next;
+    }
+
+    if(ni->ni_ssid_next != NULL)
+    {
+        ni->ni_ssid_next->ni_ssid_prev = ni->ni_ssid_prev;
+    }
 }
 
 bss_t *
 wlan_node_remove(struct ieee80211_node_table *nt, A_UINT8 *bssid)
 {
-    bss_t *bss, *nextBss;
+    bss_t *bss;
+    int hash;
 
     IEEE80211_NODE_LOCK(nt);
 
-    bss = nt->nt_node_first;
-
-    while (bss != NULL)
-    {
-        nextBss = bss->ni_list_next;
-
-        if (A_MEMCMP(bssid, bss->ni_macaddr, 6) == 0)
-        {
+    hash = IEEE80211_NODE_HASH(bssid);
+    for (bss = nt->nt_hash[hash]; bss; bss = bss->ni_hash_next) {
+        if (IEEE80211_ADDR_EQ(bss->ni_macaddr, bssid)) {
             wlan_node_remove_core (nt, bss);
-            IEEE80211_NODE_UNLOCK(nt);
-            return bss;
+            break;
         }
-
-        bss = nextBss;
     }
 
     IEEE80211_NODE_UNLOCK(nt);
-    return NULL;
+    return bss;
 }
 
 bss_t *
@@ -559,70 +589,67 @@ wlan_find_matching_Ssidnode (struct ieee80211_node_table *nt, A_UCHAR *pSsid,
 {
     bss_t   *ni = NULL;
     bss_t   *best_ni = NULL;
-    A_UCHAR *pIESsid = NULL;
+    int     hash;
 
     IEEE80211_NODE_LOCK (nt);
 
-    for (ni = nt->nt_node_first; ni; ni = ni->ni_list_next) {
-        pIESsid = ni->ni_cie.ie_ssid;
-        if (pIESsid[1] <= 32) {
+    hash = IEEE80211_SSID_HASH(pSsid, ssidLength);
+    for (ni = nt->nt_ssid_hash[hash]; ni; ni = ni->ni_ssid_next) {
+        // Step 1 : Check SSID
+        if (wlan_node_ssid_eq(ni, pSsid, ssidLength)) {
 
-            // Step 1 : Check SSID
-            if (0x00 == memcmp (pSsid, &pIESsid[2], ssidLength)) {
+            if (ni->ni_cie.ie_capInfo & 0x10)
+            {
 
-                if (ni->ni_cie.ie_capInfo & 0x10)
+                if ((NULL != ni->ni_cie.ie_rsn) && (WPA2_PSK_AUTH == authMode))
                 {
-
-                    if ((NULL != ni->ni_cie.ie_rsn) && (WPA2_PSK_AUTH == authMode))
+                    /* WPA2 */
+                    if (NULL == best_ni)
+                    {
+                        best_ni = ni;
+                    }
+                    else if (ni->ni_rssi > best_ni->ni_rssi)
                     {
-                        /* WPA2 */
-                        if (NULL == best_ni)
-                        {
-                            best_ni = ni;
-                        }
-                        else if (ni->ni_rssi > best_ni->ni_rssi)
-                        {
-                            best_ni = ni;
-                        }
+                        best_ni = ni;
                     }
-                    else if ((NULL != ni->ni_cie.ie_wpa) && (WPA_PSK_AUTH == authMode))
+                }
+                else if ((NULL != ni->ni_cie.ie_wpa) && (WPA_PSK_AUTH == authMode))
+                {
+                    /* WPA */
+                    if (NULL == best_ni)
                     {
-                        /* WPA */
-                        if (NULL == best_ni)
-                        {
-                            best_ni = ni;
-                        }
-                        else if (ni->ni_rssi > best_ni->ni_rssi)
-                        {
-                            best_ni = ni;
-                        }
+                        best_ni = ni;
                     }
-                    else if (WEP_CRYPT == pairwiseCryptoType)
+                    else if (ni->ni_rssi > best_ni->ni_rssi)
                     {
-                        /* WEP */
-                        if (NULL == best_ni)
-                        {
-                            best_ni = ni;
-                        }
-                        else if (ni->ni_rssi > best_ni->ni_rssi)
-                        {
-                            best_ni = ni;
-                        }
+                        best_ni = ni;
                     }
                 }
-                else
+                else if (WEP_CRYPT == pairwiseCryptoType)
                 {
-                    /* open AP */
-                    if ((OPEN_AUTH == authMode) && (NONE_CRYPT == pairwiseCryptoType))
+                    /* WEP */
+                    if (NULL == best_ni)
+                    {
+                        best_ni = ni;
+                    }
+                    else if (ni->ni_rssi > best_ni->ni_rssi)
+                    {
+                        best_ni = ni;
+                    }
+                }
+            }
+            else
+            {
+                /* open AP */
+                if ((OPEN_AUTH == authMode) && (NONE_CRYPT == pairwiseCryptoType))
+                {
+                    if (NULL == best_ni)
+                    {
+                        best_ni = ni;
+                    }
+                    else if (ni->ni_rssi > best_ni->ni_rssi)
                     {
-                        if (NULL == best_ni)
-                        {
-                            best_ni = ni;
-                        }
-                        else if (ni->ni_rssi > best_ni->ni_rssi)
-                        {
-                            best_ni = ni;
-                        }
+                        best_ni = ni;
                     }
                 }
             }
@@ -1415,7 +1415,7 @@ wmi_tkip_micerr_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
 }
 
 static A_STATUS
-wmi_bssInfo_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
+wmi_bssInfo_update(struct wmi_t *wmip, A_UINT8 *datap, int len)
 {
     bss_t *bss = NULL;
     WMI_BSS_INFO_HDR *bih;
@@ -1468,6 +1468,23 @@ wmi_bssInfo_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
     }
 
     if (bss != NULL) {
+        /*
+         * Most beacons repeat the last one but for the timestamp, and
+         * don't need a new node or their IEs parsed again.
+         */
+        if (wlan_node_refresh(&wmip->wmi_scan_table, bss, buf, len)) {
+            /* the associated AP keeps its average rssi, see below */
+            if (!IEEE80211_ADDR_EQ(wmip->wmi_bssid, bih->bssid)) {
+                bss->ni_snr  = bih->snr;
+                bss->ni_rssi = bih->rssi;
+            }
+            bss->ni_cie.ie_chan = bih->channel;
+            wmip->wmi_scan_stats.bss_refreshed++;
+            A_WMI_BSS_UPDATE_EVENT(wmip->wmi_devt, bss, FALSE);
+            wmi_node_return(wmip, bss);
+            return A_OK;
+        }
+
         /*
          * Free up the node.  Not the most efficient process given
          * we are about to allocate a new node but it is simple and should be
@@ -1576,10 +1593,26 @@ wmi_bssInfo_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
      */
     bss->ni_cie.ie_chan = bih->channel;
     wlan_setup_node(&wmip->wmi_scan_table, bss, bih->bssid);
+    wmip->wmi_scan_stats.bss_parsed++;
+    A_WMI_BSS_UPDATE_EVENT(wmip->wmi_devt, bss, TRUE);
 
     return A_OK;
 }
 
+static A_STATUS
+wmi_bssInfo_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
+{
+    A_UINT32 start = A_GET_US();
+    A_STATUS status;
+
+    status = wmi_bssInfo_update(wmip, datap, len);
+
+    wmip->wmi_scan_stats.bss_events++;
+    wmip->wmi_scan_stats.bss_usecs += A_GET_US() - start;
+
+    return status;
+}
+
 static A_STATUS
 wmi_opt_frame_event_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
 {
@@ -1821,6 +1854,14 @@ wmi_scanComplete_rx(struct wmi_t *wmip, A_UINT8 *datap, int len)
     if ((A_STATUS)ev->status == A_OK) {
         wlan_refresh_inactive_nodes(&wmip->wmi_scan_table);
     }
+
+    A_DPRINTF(DBG_WMI, (DBGFMT "scan done: %u bss events, %u unchanged, "
+              "%u parsed, %u us\n", DBGARG,
+              wmip->wmi_scan_stats.bss_events,
+              wmip->wmi_scan_stats.bss_refreshed,
+              wmip->wmi_scan_stats.bss_parsed,
+              wmip->wmi_scan_stats.bss_usecs));
+    A_MEMZERO(&wmip->wmi_scan_stats, sizeof(wmip->wmi_scan_stats));
     A_WMI_SCANCOMPLETE_EVENT(wmip->wmi_devt, (A_STATUS) ev->status);
     is_probe_ssid = FALSE;
 
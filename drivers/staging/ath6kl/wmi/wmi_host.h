@@ -59,6 +59,14 @@ typedef struct sq_threshold_params_s {
 #define A_BAND_5GHZ            1
 #define A_NUM_BANDS            2
 
+/* Beacon and probe response handling since the last scan completed */
+struct wmi_scan_stats {
+    A_UINT32    bss_events;     /* bss info events received */
+    A_UINT32    bss_refreshed;  /* unchanged, node refreshed in place */
+    A_UINT32    bss_parsed;     /* new or changed, IEs parsed */
+    A_UINT32    bss_usecs;      /* time spent on all of them */
+};
+
 struct wmi_t {
     A_BOOL                          wmi_ready;
     A_BOOL                          wmi_numQoSStream;
@@ -67,6 +75,7 @@ struct wmi_t {
     void                           *wmi_devt;
     struct wmi_stats                wmi_stats;
     struct ieee80211_node_table     wmi_scan_table;
+    struct wmi_scan_stats           wmi_scan_stats;
     A_UINT8                         wmi_bssid[ATH_MAC_LEN];
     A_UINT8                         wmi_powerMode;
     A_UINT8                         wmi_phyMode;
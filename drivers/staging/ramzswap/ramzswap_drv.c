@@ -57,6 +57,24 @@ static void rzs_clear_flag(struct ramzswap *rzs, u32 index,
 	rzs->table[index].flags &= ~BIT(flag);
 }
 
+#if defined(CONFIG_RAMZSWAP_STATS)
+static unsigned int rzs_ratio_bucket(size_t clen)
+{
+	return min_t(size_t, (clen - 1) * RZS_RATIO_BUCKETS / PAGE_SIZE,
+		     RZS_RATIO_BUCKETS - 1);
+}
+#endif
+
+static size_t rzs_mem_used(struct ramzswap *rzs)
+{
+#if defined(CONFIG_RAMZSWAP_STATS)
+	return xv_get_total_size_bytes(rzs->mem_pool) +
+		((size_t)rzs->stats.pages_expand << PAGE_SHIFT);
+#else
+	return rzs->stats.compr_size;
+#endif
+}
+
 static int page_zero_filled(void *ptr)
 {
 	unsigned int pos;
@@ -126,8 +144,7 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 	size_t succ_writes, mem_used;
 	unsigned int good_compress_perc = 0, no_compress_perc = 0;
 
-	mem_used = xv_get_total_size_bytes(rzs->mem_pool)
-			+ (rs->pages_expand << PAGE_SHIFT);
+	mem_used = rzs_mem_used(rzs);
 	succ_writes = rzs_stat64_read(rzs, &rs->num_writes) -
 			rzs_stat64_read(rzs, &rs->failed_writes);
 
@@ -195,6 +212,9 @@ static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
 		rzs_stat_dec(&rzs->stats.good_compress);
 
 out:
+#if defined(CONFIG_RAMZSWAP_STATS)
+	rzs_stat_dec(&rzs->stats.ratio_hist[rzs_ratio_bucket(clen)]);
+#endif
 	rzs->stats.compr_size -= clen;
 	rzs_stat_dec(&rzs->stats.pages_stored);
 
@@ -361,6 +381,20 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 		goto out;
 	}
 
+	/*
+	 * Over the cap: fail the write.  The page stays dirty in the swap
+	 * cache and is written to this slot again later, swap does not
+	 * pick another area for it, so the cap only bounds memory use and
+	 * disksize is what should keep it from being reached.
+	 */
+	if (rzs->mem_limit && rzs_mem_used(rzs) +
+	    min_t(size_t, clen, PAGE_SIZE) > rzs->mem_limit) {
+		mutex_unlock(&rzs->lock);
+		rzs_stat64_inc(rzs, &rzs->stats.limit_writes);
+		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
+		goto out;
+	}
+
 	/*
 	 * Page is incompressible. Store it as-is (uncompressed)
 	 * since we do not want to return too many swap write
@@ -421,6 +455,9 @@ memstore:
 	rzs_stat_inc(&rzs->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		rzs_stat_inc(&rzs->stats.good_compress);
+#if defined(CONFIG_RAMZSWAP_STATS)
+	rzs_stat_inc(&rzs->stats.ratio_hist[rzs_ratio_bucket(clen)]);
+#endif
 
 	mutex_unlock(&rzs->lock);
 
@@ -693,6 +730,91 @@ void ramzswap_slot_free_notify(struct block_device *bdev, unsigned long index)
 	return;
 }
 
+/*
+ * sysfs, under /sys/block/ramzswapN/:
+ *   mem_limit_kb	cap on memory used for stored pages (0: none); writes
+ *			past it fail and are retried by reclaim, see
+ *			ramzswap.txt
+ *   mem_used_kb	memory used for stored pages
+ *   compr_ratio	stored pages by compressed size, in eighths of a page
+ */
+static struct ramzswap *dev_to_rzs(struct device *dev)
+{
+	return dev_to_disk(dev)->private_data;
+}
+
+static ssize_t mem_limit_kb_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%zu\n", dev_to_rzs(dev)->mem_limit >> 10);
+}
+
+static ssize_t mem_limit_kb_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct ramzswap *rzs = dev_to_rzs(dev);
+	unsigned long limit_kb;
+
+	if (strict_strtoul(buf, 10, &limit_kb))
+		return -EINVAL;
+
+	mutex_lock(&rzs->lock);
+	rzs->mem_limit = (size_t)limit_kb << 10;
+	mutex_unlock(&rzs->lock);
+
+	return len;
+}
+
+static ssize_t mem_used_kb_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ramzswap *rzs = dev_to_rzs(dev);
+	size_t used = 0;
+
+	mutex_lock(&rzs->lock);
+	if (rzs->init_done)
+		used = rzs_mem_used(rzs);
+	mutex_unlock(&rzs->lock);
+
+	return sprintf(buf, "%zu\n", used >> 10);
+}
+
+static ssize_t compr_ratio_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	ssize_t count = 0;
+#if defined(CONFIG_RAMZSWAP_STATS)
+	struct ramzswap *rzs = dev_to_rzs(dev);
+	int i;
+
+	mutex_lock(&rzs->lock);
+	count += sprintf(buf + count, "zero: %u\n", rzs->stats.pages_zero);
+	for (i = 0; i < RZS_RATIO_BUCKETS; i++)
+		count += sprintf(buf + count, "<=%u/%u: %u\n", i + 1,
+				 RZS_RATIO_BUCKETS, rzs->stats.ratio_hist[i]);
+	count += sprintf(buf + count, "limit_writes: %llu\n",
+			 rzs_stat64_read(rzs, &rzs->stats.limit_writes));
+	mutex_unlock(&rzs->lock);
+#endif
+	return count;
+}
+
+static DEVICE_ATTR(mem_limit_kb, S_IRUGO | S_IWUSR,
+		mem_limit_kb_show, mem_limit_kb_store);
+static DEVICE_ATTR(mem_used_kb, S_IRUGO, mem_used_kb_show, NULL);
+static DEVICE_ATTR(compr_ratio, S_IRUGO, compr_ratio_show, NULL);
+
+static struct attribute *ramzswap_disk_attrs[] = {
+	&dev_attr_mem_limit_kb.attr,
+	&dev_attr_mem_used_kb.attr,
+	&dev_attr_compr_ratio.attr,
+	NULL,
+};
+
+static struct attribute_group ramzswap_disk_attr_group = {
+	.attrs = ramzswap_disk_attrs,
+};
+
 static struct block_device_operations ramzswap_devops = {
 	.ioctl = ramzswap_ioctl,
 	.swap_slot_free_notify = ramzswap_slot_free_notify,
@@ -742,6 +864,13 @@ static int create_device(struct ramzswap *rzs, int device_id)
 
 	add_disk(rzs->disk);
 
+	ret = sysfs_create_group(&disk_to_dev(rzs->disk)->kobj,
+				 &ramzswap_disk_attr_group);
+	if (ret < 0)
+		pr_warning("Error creating sysfs group for device %d\n",
+			device_id);
+	ret = 0;
+
 	rzs->init_done = 0;
 
 out:
@@ -751,6 +880,8 @@ out:
 static void destroy_device(struct ramzswap *rzs)
 {
 	if (rzs->disk) {
+		sysfs_remove_group(&disk_to_dev(rzs->disk)->kobj,
+				   &ramzswap_disk_attr_group);
 		del_gendisk(rzs->disk);
 		put_disk(rzs->disk);
 	}
@@ -58,6 +58,12 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /*-- End of configurable params */
 
+/*
+ * Compressed size histogram: bucket i counts stored pages whose
+ * compressed size is at most (i + 1) / RZS_RATIO_BUCKETS of a page.
+ */
+#define RZS_RATIO_BUCKETS	8
+
 #define SECTOR_SHIFT		9
 #define SECTOR_SIZE		(1 << SECTOR_SHIFT)
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
@@ -103,6 +109,8 @@ struct ramzswap_stats {
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 ratio_hist[RZS_RATIO_BUCKETS];	/* pages currently stored */
+	u64 limit_writes;	/* writes refused by mem_limit */
 #endif
 };
 
@@ -123,6 +131,12 @@ struct ramzswap {
 	 */
 	size_t disksize;	/* bytes */
 
+	/*
+	 * Cap on memory used for stored pages, 0 for none. Writes past
+	 * it fail, and the swap code moves on to the next swap area.
+	 */
+	size_t mem_limit;	/* bytes */
+
 	struct ramzswap_stats stats;
 };
 
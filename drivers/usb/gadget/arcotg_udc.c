@@ -85,9 +85,6 @@ volatile static struct usb_sys_interface *usb_sys_regs;
 /* it is initialized in probe()  */
 static struct fsl_udc *udc_controller;
 
-#ifdef POSTPONE_FREE_LAST_DTD
-static struct ep_td_struct *last_free_td;
-#endif
 static const struct usb_endpoint_descriptor
 fsl_ep0_desc = {
 	.bLength =		USB_DT_ENDPOINT_SIZE,
@@ -191,6 +188,72 @@ static void reset_phy(void)
 #else
 static void reset_phy(void){; }
 #endif
+/*-----------------------------------------------------------------
+ * dTD cache: enabled endpoints keep the dTDs of retired requests so
+ * that queueing does not go to the dma_pool for every transfer.
+ * Called with the udc lock held.
+ *--------------------------------------------------------------*/
+static struct ep_td_struct *fsl_get_dtd(struct fsl_ep *ep, dma_addr_t *dma)
+{
+	struct ep_td_struct *dtd = ep->free_td;
+
+	if (likely(dtd)) {
+		ep->free_td = dtd->next_td_virt;
+		ep->free_td_count--;
+		*dma = dtd->td_dma;
+		return dtd;
+	}
+
+	return dma_pool_alloc(ep->udc->td_pool, GFP_ATOMIC, dma);
+}
+
+static void fsl_put_dtd(struct fsl_ep *ep, struct ep_td_struct *dtd)
+{
+	if (ep->free_td_count < ep->free_td_max) {
+		dtd->next_td_virt = ep->free_td;
+		ep->free_td = dtd;
+		ep->free_td_count++;
+	} else
+		dma_pool_free(ep->udc->td_pool, dtd, dtd->td_dma);
+}
+
+/* Give every cached dTD back to the pool */
+static void fsl_ep_free_dtds(struct fsl_ep *ep)
+{
+	struct ep_td_struct *dtd;
+
+	ep->free_td_max = 0;
+	while ((dtd = ep->free_td) != NULL) {
+		ep->free_td = dtd->next_td_virt;
+		dma_pool_free(ep->udc->td_pool, dtd, dtd->td_dma);
+	}
+	ep->free_td_count = 0;
+#ifdef POSTPONE_FREE_LAST_DTD
+	if (ep->last_free_td != NULL) {
+		dma_pool_free(ep->udc->td_pool, ep->last_free_td,
+				ep->last_free_td->td_dma);
+		ep->last_free_td = NULL;
+	}
+#endif
+}
+
+/* Fill the cache of a newly enabled endpoint; best effort, as gadget
+ * drivers may enable endpoints from their setup() callback */
+static void fsl_ep_alloc_dtds(struct fsl_ep *ep, unsigned int max)
+{
+	struct ep_td_struct *dtd;
+	dma_addr_t dma;
+
+	ep->free_td_max = max;
+	while (ep->free_td_count < max) {
+		dtd = dma_pool_alloc(ep->udc->td_pool, GFP_ATOMIC, &dma);
+		if (!dtd)
+			break;
+		dtd->td_dma = dma;
+		fsl_put_dtd(ep, dtd);
+	}
+}
+
 /*-----------------------------------------------------------------
  * done() - retire a request; caller blocked irqs
  * @status : request status to be set, only works when
@@ -220,17 +283,18 @@ static void done(struct fsl_ep *ep, struct fsl_req *req, int status)
 		if (j != req->dtd_count - 1) {
 			next_td = curr_td->next_td_virt;
 #ifdef POSTPONE_FREE_LAST_DTD
-			dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
+			fsl_put_dtd(ep, curr_td);
 		} else {
-			if (last_free_td != NULL)
-				dma_pool_free(udc->td_pool, last_free_td,
-						last_free_td->td_dma);
-			last_free_td = curr_td;
+			/* the dQH may still point at it, reuse it only
+			 * once the next request on this ep is retired */
+			if (ep->last_free_td != NULL)
+				fsl_put_dtd(ep, ep->last_free_td);
+			ep->last_free_td = curr_td;
 		}
 #else
 		}
 
-		dma_pool_free(udc->td_pool, curr_td, curr_td->td_dma);
+		fsl_put_dtd(ep, curr_td);
 #endif
 	}
 
@@ -768,6 +832,10 @@ static int fsl_ep_enable(struct usb_ep *_ep,
 	ep->desc = desc;
 	ep->stopped = 0;
 
+	fsl_ep_alloc_dtds(ep, (desc->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK)
+			== USB_ENDPOINT_XFER_BULK
+			? EP_BULK_DTD_RESERVE : EP_DTD_RESERVE);
+
 	/* Controller related setup */
 	/* Init EPx Queue Head (Ep Capabilites field in QH
 	 * according to max, zlt, mult) */
@@ -827,6 +895,7 @@ static int fsl_ep_disable(struct usb_ep *_ep)
 	spin_lock_irqsave(&udc->lock, flags);
 	/* nuke all pending requests (does flush) */
 	nuke(ep, -ESHUTDOWN);
+	fsl_ep_free_dtds(ep);
 
 	ep->desc = 0;
 	ep->stopped = 1;
@@ -962,7 +1031,7 @@ static struct ep_td_struct *fsl_build_dtd(struct fsl_req *req, unsigned *length,
 			(unsigned)EP_MAX_LENGTH_TRANSFER);
 	if (NEED_IRAM(req->ep))
 		*length = min(*length, g_iram_size);
-	dtd = dma_pool_alloc(udc_controller->td_pool, GFP_KERNEL, dma);
+	dtd = fsl_get_dtd(req->ep, dma);
 	if (dtd == NULL)
 		return dtd;
 
@@ -1046,8 +1115,15 @@ static int fsl_req_to_dtd(struct fsl_req *req)
 
 	do {
 		dtd = fsl_build_dtd(req, &count, &dma, &is_last);
-		if (dtd == NULL)
+		if (dtd == NULL) {
+			/* hand back what was built so far */
+			for (dtd = req->head; req->dtd_count--; dtd = last_dtd) {
+				last_dtd = dtd->next_td_virt;
+				fsl_put_dtd(req->ep, dtd);
+			}
+			req->dtd_count = 0;
 			return -ENOMEM;
+		}
 
 		if (is_first) {
 			is_first = 0;
@@ -3002,9 +3078,6 @@ static int __devinit fsl_udc_probe(struct platform_device *pdev)
 	INIT_WORK(&udc_controller->gadget_work, fsl_gadget_event);
 	INIT_DELAYED_WORK(&udc_controller->gadget_delay_work,
 						fsl_gadget_delay_event);
-#ifdef POSTPONE_FREE_LAST_DTD
-	last_free_td = NULL;
-#endif
 
 	/* disable all INTR */
 #ifndef CONFIG_USB_OTG
@@ -3061,6 +3134,7 @@ err1a:
 static int __exit fsl_udc_remove(struct platform_device *pdev)
 {
 	struct fsl_usb2_platform_data *pdata = pdev->dev.platform_data;
+	int i;
 
 	DECLARE_COMPLETION(done);
 
@@ -3081,12 +3155,9 @@ static int __exit fsl_udc_remove(struct platform_device *pdev)
 	kfree(udc_controller->status_req);
 	kfree(udc_controller->data_req->req.buf);
 	kfree(udc_controller->data_req);
+	for (i = 0; i < udc_controller->max_ep; i++)
+		fsl_ep_free_dtds(&udc_controller->eps[i]);
 	kfree(udc_controller->eps);
-#ifdef POSTPONE_FREE_LAST_DTD
-	if (last_free_td != NULL)
-		dma_pool_free(udc_controller->td_pool, last_free_td,
-				last_free_td->td_dma);
-#endif
 	dma_pool_destroy(udc_controller->td_pool);
 	free_irq(udc_controller->irq, udc_controller);
 	iounmap((u8 __iomem *)dr_regs);
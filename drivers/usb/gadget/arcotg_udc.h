@@ -571,8 +571,21 @@ struct fsl_ep {
 
 	char name[14];
 	unsigned stopped:1;
+
+	/* dTDs kept for reuse, linked through next_td_virt */
+	struct ep_td_struct *free_td;
+	unsigned int free_td_count;
+	unsigned int free_td_max;
+#ifdef POSTPONE_FREE_LAST_DTD
+	struct ep_td_struct *last_free_td;
+#endif
 };
 
+/* dTDs an enabled endpoint keeps around: a bulk endpoint needs one per
+ * 16 KiB queued, so this covers e.g. eight 64 KiB mass storage buffers */
+#define EP_BULK_DTD_RESERVE	32
+#define EP_DTD_RESERVE		4
+
 #define EP_DIR_IN	1
 #define EP_DIR_OUT	0
 
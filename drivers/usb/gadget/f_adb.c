@@ -32,13 +32,33 @@
 
 #include <linux/usb/android_composite.h>
 
-#define BULK_BUFFER_SIZE           4096
+#define BULK_BUFFER_SIZE           16384
 
 /* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+#define TX_REQ_MAX 8
 
 static const char shortname[] = "android_adb";
 
+static unsigned int adb_buflen = BULK_BUFFER_SIZE;
+module_param_named(buflen, adb_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(buflen, "Size of each bulk request buffer");
+
+static unsigned int adb_tx_reqs = TX_REQ_MAX;
+module_param_named(tx_reqs, adb_tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_reqs, "Number of IN requests writes may keep queued");
+
+/*
+ * With more than one rx request, all of them stay queued and reads are
+ * served from whatever the host sent, as a byte stream.  A request only
+ * completes when it is full or ends in a short packet, so this needs a
+ * host that terminates every transfer with a short packet or ZLP;
+ * otherwise an exact multiple of maxpacket waits for the next transfer.
+ * With one rx request each read queues exactly the length asked for.
+ */
+static unsigned int adb_rx_reqs = 1;
+module_param_named(rx_reqs, adb_rx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_reqs, "Number of OUT requests kept queued (read-ahead)");
+
 struct adb_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -60,6 +80,12 @@ struct adb_dev {
 	wait_queue_head_t write_wq;
 	struct usb_request *rx_req;
 	int rx_done;
+
+	/* read-ahead: requests owned by us, and those the host filled */
+	struct list_head rx_idle;
+	struct list_head rx_full;
+	/* bytes already read from the first request on rx_full */
+	unsigned rx_offset;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -211,10 +237,14 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
 	if (req->status != 0)
 		dev->error = 1;
 
+	if (adb_rx_reqs > 1)
+		req_put(dev, &dev->rx_full, req);
+	else
+		dev->rx_done = 1;
+
 	wake_up(&dev->read_wq);
 }
 
@@ -248,14 +278,24 @@ static int create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	if (adb_rx_reqs > 1) {
+		for (i = 0; i < adb_rx_reqs; i++) {
+			req = adb_request_new(dev->ep_out, adb_buflen);
+			if (!req)
+				goto fail;
+			req->complete = adb_complete_out;
+			req_put(dev, &dev->rx_idle, req);
+		}
+	} else {
+		req = adb_request_new(dev->ep_out, adb_buflen);
+		if (!req)
+			goto fail;
+		req->complete = adb_complete_out;
+		dev->rx_req = req;
+	}
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < adb_tx_reqs; i++) {
+		req = adb_request_new(dev->ep_in, adb_buflen);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
@@ -269,6 +309,57 @@ fail:
 	return -1;
 }
 
+/* Read-ahead flavour of adb_read(): returns once count bytes are read */
+static ssize_t adb_read_stream(struct adb_dev *dev, char __user *buf,
+				size_t count)
+{
+	struct usb_request *req;
+	size_t done = 0;
+	int xfer;
+	int ret;
+
+	while (done < count) {
+		/* keep every request we own queued to the host */
+		while ((req = req_get(dev, &dev->rx_idle))) {
+			req->length = adb_buflen;
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
+			if (ret < 0) {
+				DBG(dev->cdev, "adb_read: failed to queue req"
+					" %p (%d)\n", req, ret);
+				req_put(dev, &dev->rx_idle, req);
+				dev->error = 1;
+				return -EIO;
+			}
+		}
+
+		ret = wait_event_interruptible(dev->read_wq,
+				!list_empty(&dev->rx_full) || dev->error);
+		if (ret < 0)
+			return done ? done : ret;
+		if (dev->error)
+			return -EIO;
+
+		/* we are the only reader, completions only add at the tail */
+		spin_lock_irq(&dev->lock);
+		req = list_first_entry(&dev->rx_full, struct usb_request, list);
+		spin_unlock_irq(&dev->lock);
+
+		xfer = min_t(size_t, count - done, req->actual - dev->rx_offset);
+		if (copy_to_user(buf + done, req->buf + dev->rx_offset, xfer))
+			return -EFAULT;
+		done += xfer;
+		dev->rx_offset += xfer;
+
+		if (dev->rx_offset == req->actual) {
+			req = req_get(dev, &dev->rx_full);
+			dev->rx_offset = 0;
+			req_put(dev, &dev->rx_idle, req);
+		}
+	}
+
+	return done;
+}
+
 static ssize_t adb_read(struct file *fp, char __user *buf,
 				size_t count, loff_t *pos)
 {
@@ -280,7 +371,7 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "adb_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
+	if (count > adb_buflen && adb_rx_reqs <= 1)
 		return -EINVAL;
 
 	if (_lock(&dev->read_excl))
@@ -301,6 +392,11 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		goto done;
 	}
 
+	if (adb_rx_reqs > 1) {
+		r = adb_read_stream(dev, buf, count);
+		goto done;
+	}
+
 requeue_req:
 	/* queue a request */
 	req = dev->rx_req;
@@ -373,8 +469,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
+			if (count > adb_buflen)
+				xfer = adb_buflen;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -520,6 +616,10 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	spin_lock_irq(&dev->lock);
 
 	adb_request_free(dev->rx_req, dev->ep_out);
+	while ((req = req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
+	while ((req = req_get(dev, &dev->rx_full)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 
@@ -538,6 +638,7 @@ static int adb_function_set_alt(struct usb_function *f,
 {
 	struct adb_dev	*dev = func_to_dev(f);
 	struct usb_composite_dev *cdev = f->config->cdev;
+	unsigned long flags;
 	int ret;
 
 	DBG(cdev, "adb_function_set_alt intf: %d alt: %d\n", intf, alt);
@@ -555,6 +656,13 @@ static int adb_function_set_alt(struct usb_function *f,
 		usb_ep_disable(dev->ep_in);
 		return ret;
 	}
+
+	/* whatever was buffered belongs to the previous connection */
+	spin_lock_irqsave(&dev->lock, flags);
+	list_splice_init(&dev->rx_full, &dev->rx_idle);
+	dev->rx_offset = 0;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
 	dev->online = 1;
 
 	/* readers may be blocked waiting for us to go online */
@@ -598,6 +706,13 @@ static int adb_bind_config(struct usb_configuration *c)
 	atomic_set(&dev->write_excl, 0);
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_full);
+
+	/* buffers serve whole packets; keep the counts sane */
+	adb_buflen = clamp(adb_buflen, 512u, 131072u) & ~511u;
+	adb_tx_reqs = clamp(adb_tx_reqs, 1u, 32u);
+	adb_rx_reqs = clamp(adb_rx_reqs, 1u, 32u);
 
 	dev->cdev = c->cdev;
 	dev->function.name = "adb";
@@ -142,9 +142,16 @@
  *
  *
  * Requirements are modest; only a bulk-in and a bulk-out endpoint are
- * needed.  The memory requirement amounts to two 16K buffers, size
- * configurable by a parameter.  Support is included for both
- * full-speed and high-speed operation.
+ * needed.  The memory requirement amounts to num_buffers buffers of
+ * buflen bytes each (by default CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+ * and CONFIG_USB_GADGET_STORAGE_BUFLEN), both settable as module
+ * parameters.  Support is included for both full-speed and high-speed
+ * operation.
+ *
+ * When a LUN is backed by a block device and the direct_io module
+ * parameter is set (the default), data written by the host bypasses
+ * the page cache and goes straight to the device in one bio per
+ * buffer.  Reads still use the page cache for the sake of readahead.
  *
  * Note that the driver is slightly non-portable in that it assumes a
  * single memory/DMA buffer will be useable for bulk-in, bulk-out, and
@@ -216,9 +223,9 @@
  *
  * To provide maximum throughput, the driver uses a circular pipeline of
  * buffer heads (struct fsg_buffhd).  In principle the pipeline can be
- * arbitrarily long; in practice the benefits don't justify having more
- * than 2 stages (i.e., double buffering).  But it helps to think of the
- * pipeline as being a long one.  Each buffer head contains a bulk-in and
+ * arbitrarily long; its length is the num_buffers parameter.  For
+ * writes a deep pipeline keeps bulk-out requests queued to receive
+ * from the host while the thread writes out earlier buffers.  Each buffer head contains a bulk-in and
  * a bulk-out request pointer (since the buffer can be used for both
  * output and input -- directions always are given from the host's
  * point of view) as well as a pointer to the buffer and various state
@@ -319,6 +326,19 @@ static const char fsg_string_interface[] = "Mass Storage";
 #include "storage_common.c"
 
 
+static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
+module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
+
+static unsigned int fsg_buflen = CONFIG_USB_GADGET_STORAGE_BUFLEN;
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer in bytes");
+
+static int fsg_direct_io = 1;
+module_param_named(direct_io, fsg_direct_io, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(direct_io, "Write block device LUNs around the page cache");
+
+
 /*-------------------------------------------------------------------------*/
 
 struct fsg_dev;
@@ -343,7 +363,7 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -770,7 +790,7 @@ static int do_read(struct fsg_common *common)
 		 *	the next page.
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, fsg_buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
@@ -851,6 +871,110 @@ static int do_read(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+struct fsg_dio {
+	atomic_t		pending;
+	int			error;
+	struct completion	done;
+};
+
+static void fsg_dio_end_io(struct bio *bio, int err)
+{
+	struct fsg_dio *dio = bio->bi_private;
+
+	if (err)
+		dio->error = err;
+	if (atomic_dec_and_test(&dio->pending))
+		complete(&dio->done);
+	bio_put(bio);
+}
+
+/* Write a buffer straight to a block device LUN, bypassing the page
+ * cache.  The buffer is kmalloc()ed so it maps onto lowmem pages. */
+static ssize_t fsg_lun_write_direct(struct fsg_lun *curlun, void *buf,
+				    unsigned int amount, loff_t offset)
+{
+	struct address_space	*mapping = curlun->filp->f_mapping;
+	struct block_device	*bdev = I_BDEV(mapping->host);
+	struct bio		*bio = NULL;
+	struct fsg_dio		dio;
+	unsigned int		done = 0;
+	int			rc;
+
+	/* Anything the page cache holds for this range must not be
+	 * written back over our data later, nor be read back stale */
+	rc = filemap_write_and_wait_range(mapping, offset,
+					  offset + amount - 1);
+	if (rc)
+		return rc;
+
+	atomic_set(&dio.pending, 1);
+	dio.error = 0;
+	init_completion(&dio.done);
+
+	while (done < amount) {
+		void		*p = buf + done;
+		unsigned int	len = min_t(unsigned int, amount - done,
+					    PAGE_SIZE - offset_in_page(p));
+
+		if (!bio) {
+			bio = bio_alloc(GFP_NOIO, min_t(unsigned int,
+					BIO_MAX_PAGES,
+					DIV_ROUND_UP(amount - done, PAGE_SIZE) + 1));
+			bio->bi_bdev = bdev;
+			bio->bi_sector = (offset + done) >> 9;
+			bio->bi_end_io = fsg_dio_end_io;
+			bio->bi_private = &dio;
+		}
+		if (bio_add_page(bio, virt_to_page(p), len,
+				 offset_in_page(p)) == len) {
+			done += len;
+			continue;
+		}
+
+		/* The queue wants a new bio from here on */
+		if (!bio->bi_size) {
+			bio_put(bio);
+			bio = NULL;
+			dio.error = -EIO;
+			break;
+		}
+		atomic_inc(&dio.pending);
+		submit_bio(WRITE, bio);
+		bio = NULL;
+	}
+	if (bio) {
+		atomic_inc(&dio.pending);
+		submit_bio(WRITE, bio);
+	}
+	if (!atomic_dec_and_test(&dio.pending))
+		wait_for_completion(&dio.done);
+
+	if (mapping->nrpages)
+		invalidate_inode_pages2_range(mapping,
+				offset >> PAGE_CACHE_SHIFT,
+				(offset + amount - 1) >> PAGE_CACHE_SHIFT);
+
+	return dio.error ? dio.error : amount;
+}
+
+static ssize_t fsg_lun_write(struct fsg_lun *curlun, void *buf,
+			     unsigned int amount, loff_t *pos)
+{
+	struct inode	*inode = curlun->filp->f_mapping->host;
+	ssize_t		nwritten;
+
+	if (fsg_direct_io && S_ISBLK(inode->i_mode) && amount &&
+	    !((*pos | amount) &
+	      (bdev_logical_block_size(I_BDEV(inode)) - 1))) {
+		nwritten = fsg_lun_write_direct(curlun, buf, amount, *pos);
+		if (nwritten > 0)
+			*pos += nwritten;
+		return nwritten;
+	}
+
+	return vfs_write(curlun->filp, (char __user *) buf, amount, pos);
+}
+
 static int do_write(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -921,7 +1045,7 @@ static int do_write(struct fsg_common *common)
 			 * If this means getting 0, then we were asked
 			 *	to write past the end of file.
 			 * Finally, round down to a block boundary. */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, fsg_buflen);
 			amount = min((loff_t) amount, curlun->file_length -
 					usb_offset);
 			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
@@ -995,9 +1119,8 @@ static int do_write(struct fsg_common *common)
 
 			/* Perform the write */
 			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					(char __user *) bh->buf,
-					amount, &file_offset_tmp);
+			nwritten = fsg_lun_write(curlun, bh->buf, amount,
+					&file_offset_tmp);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 					(unsigned long long) file_offset,
 					(int) nwritten);
@@ -1124,7 +1247,7 @@ static int do_verify(struct fsg_common *common)
 		 * And don't try to read past the end of the file.
 		 * If this means reading 0 then we were asked to read
 		 * past the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, fsg_buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1571,7 +1694,7 @@ static int pad_with_zeros(struct fsg_dev *fsg)
 				return rc;
 		}
 
-		nsend = min(fsg->common->usb_amount_left, FSG_BUFLEN);
+		nsend = min(fsg->common->usb_amount_left, fsg_buflen);
 		memset(bh->buf + nkeep, 0, nsend - nkeep);
 		bh->inreq->length = nsend;
 		bh->inreq->zero = 0;
@@ -1614,7 +1737,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, fsg_buflen);
 
 			/* amount is always divisible by 512, hence by
 			 * the bulk-out maxpacket size */
@@ -2334,7 +2457,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < fsg_num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2386,7 +2509,7 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg_num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2460,7 +2583,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < fsg_num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2472,7 +2595,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < fsg_num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2493,7 +2616,7 @@ static void handle_exception(struct fsg_common *common)
 	 * state, and the exception.  Then invoke the handler. */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < fsg_num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -2698,6 +2821,11 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		return ERR_PTR(-EINVAL);
 	}
 
+	/* The parameters are only consulted here, before any buffer
+	 * exists, so sanitising them in place is safe */
+	fsg_num_buffers = clamp(fsg_num_buffers, 2u, 32u);
+	fsg_buflen = clamp(fsg_buflen, 16384u, 131072u) & ~511u;
+
 	/* Allocate? */
 	if (!common) {
 		common = kzalloc(sizeof *common, GFP_KERNEL);
@@ -2715,6 +2843,14 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	common->ep0 = gadget->ep0;
 	common->ep0req = cdev->req;
 
+	common->buffhds = kcalloc(fsg_num_buffers, sizeof *common->buffhds,
+				  GFP_KERNEL);
+	if (unlikely(!common->buffhds)) {
+		if (common->free_storage_on_release)
+			kfree(common);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	/* Maybe allocate device-global string IDs, and patch descriptors */
 	if (fsg_strings[FSG_STRING_INTERFACE].id == 0) {
 		rc = usb_string_id(cdev);
@@ -2784,13 +2920,13 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 
 	/* Data buffers cyclic list */
 	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
+	i = fsg_num_buffers;
 	goto buffhds_first_it;
 	do {
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
+		bh->buf = kmalloc(fsg_buflen, GFP_KERNEL);
 		if (unlikely(!bh->buf)) {
 			rc = -ENOMEM;
 			goto error_release;
@@ -2923,10 +3059,11 @@ static void fsg_common_release(struct kref *ref)
 
 	{
 		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
+		unsigned i = fsg_num_buffers;
 		do {
 			kfree(bh->buf);
 		} while (++bh, --i);
+		kfree(common->buffhds);
 	}
 
 	if (common->free_storage_on_release)
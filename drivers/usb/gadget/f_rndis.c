@@ -32,6 +32,7 @@
 #include <linux/usb/android_composite.h>
 
 #include <asm/atomic.h>
+#include <asm/unaligned.h>
 
 #include "u_ether.h"
 #include "rndis.h"
@@ -317,6 +318,12 @@ static struct usb_gadget_strings *rndis_strings[] = {
 static struct usb_ether_platform_data *rndis_pdata;
 #endif
 
+/* frames per IN transfer, once the host allows batching; 1 turns it off */
+static unsigned int rndis_dl_max_pkts_per_xfer = 5;
+module_param(rndis_dl_max_pkts_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkts_per_xfer,
+		"max frames batched in one RNDIS IN transfer");
+
 /*-------------------------------------------------------------------------*/
 
 static struct sk_buff *rndis_add_header(struct gether *port,
@@ -410,6 +417,25 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	if (status == 0 && get_unaligned_le32(req->buf)
+			== REMOTE_NDIS_INITIALIZE_MSG) {
+		u32	host_max = rndis_get_dl_max_xfer_size(rndis->config);
+
+		/* batch IN frames if the host takes more than one */
+		if (rndis_dl_max_pkts_per_xfer > 1 && host_max
+				>= 2 * (ETH_FRAME_LEN + rndis->port.header_len)) {
+			rndis->port.dl_max_xfer_size = min_t(u32, host_max,
+					RNDIS_DL_MAX_XFER_SIZE);
+			rndis->port.dl_max_pkts_per_xfer =
+					rndis_dl_max_pkts_per_xfer;
+		} else {
+			rndis->port.dl_max_pkts_per_xfer = 1;
+		}
+		DBG(cdev, "RNDIS IN transfers: up to %u frames, %u bytes\n",
+			rndis->port.dl_max_pkts_per_xfer,
+			rndis->port.dl_max_xfer_size);
+	}
 }
 
 static int
@@ -526,6 +552,12 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		/* Avoid ZLPs; they can be troublesome. */
 		rndis->port.is_zlp_ok = false;
 
+		/* one frame per IN transfer until the host has said how
+		 * much it takes (REMOTE_NDIS_INITIALIZE_MSG) */
+		rndis->port.dl_max_pkts_per_xfer = 0;
+		rndis->port.dl_max_xfer_size = RNDIS_DL_MAX_XFER_SIZE;
+		rndis->port.ul_max_xfer_size = RNDIS_UL_MAX_XFER_SIZE;
+
 		/* RNDIS should be in the "RNDIS uninitialized" state,
 		 * either never activated or after rndis_uninit().
 		 *
@@ -1121,6 +1121,39 @@ static int fsl_pullup(struct usb_gadget *gadget, int is_on)
 	return 0;
 }
 
+/*
+ * Classify the cable from the line state, without touching the gadget
+ * stack.  With the D+ pullup on, a host's 15k pulldowns keep D- low,
+ * while a dedicated charger shorts D+ to D- and both lines read high
+ * (SE1).  Only meaningful once VBUS has been up for a while.
+ */
+enum fsl_usb2_cable fsl_udc_detect_cable(void)
+{
+	struct fsl_udc *udc = udc_controller;
+	enum fsl_usb2_cable cable = FSL_USB2_CABLE_UNKNOWN;
+	unsigned long flags;
+	u32 portsc;
+
+	if (!udc)
+		return cable;
+
+	spin_lock_irqsave(&udc->lock, flags);
+	/* registers are only safe, and the pullup only on, while running */
+	if (udc->driver && !udc->stopped &&
+	    (fsl_readl(&dr_regs->usbcmd) & USB_CMD_RUN_STOP)) {
+		portsc = fsl_readl(&dr_regs->portsc1);
+		if ((portsc & PORTSCX_LINE_STATUS_BITS) ==
+		    PORTSCX_LINE_STATUS_UNDEF)
+			cable = FSL_USB2_CABLE_CHARGER;
+		else
+			cable = FSL_USB2_CABLE_HOST;
+	}
+	spin_unlock_irqrestore(&udc->lock, flags);
+
+	return cable;
+}
+EXPORT_SYMBOL(fsl_udc_detect_cable);
+
 /* defined in gadget.h */
 static struct usb_gadget_ops fsl_gadget_ops = {
 	.get_frame = fsl_get_frame,
@@ -572,6 +572,8 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 		return -ENOMEM;
 	resp = (rndis_init_cmplt_type *) r->buf;
 
+	params->dl_max_xfer_size = le32_to_cpu (buf->MaxTransferSize);
+
 	resp->MessageType = cpu_to_le32 (
 			REMOTE_NDIS_INITIALIZE_CMPLT);
 	resp->MessageLength = cpu_to_le32 (52);
@@ -581,13 +583,15 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
-	resp->MaxTransferSize = cpu_to_le32 (
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (RNDIS_UL_MAX_PKTS_PER_XFER);
+	resp->MaxTransferSize = cpu_to_le32 (max_t(u32,
 		  params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
-	resp->PacketAlignmentFactor = cpu_to_le32 (0);
+		+ 22, RNDIS_UL_MAX_XFER_SIZE));
+	/* batched messages start 4 byte aligned, so after the 2 byte
+	 * NET_IP_ALIGN offset of the buffer every IP header is aligned */
+	resp->PacketAlignmentFactor = cpu_to_le32 (2);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
@@ -955,6 +959,12 @@ int rndis_set_param_medium (u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+/* Largest IN transfer the host said it can take, 0 before it said */
+u32 rndis_get_dl_max_xfer_size (u8 configNr)
+{
+	return rndis_per_dev_params [configNr].dl_max_xfer_size;
+}
+
 void rndis_add_hdr (struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type	*header;
@@ -1023,30 +1033,65 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
+/*
+ * The host may batch up to RNDIS_UL_MAX_PKTS_PER_XFER packet messages
+ * in one transfer, each MessageLength bytes long.  All but the last get
+ * a clone of the skb, so nothing is copied.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	int		queued = 0;
+	int		status = 0;
+
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32		*tmp = (void *) skb->data;
+		struct sk_buff	*skb2;
+		u32		msg_len, data_offset, data_len;
+
+		/* MessageType, MessageLength */
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			status = -EINVAL;
+			break;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (msg_len > skb->len || data_offset > skb->len
+				|| msg_len < sizeof(struct rndis_packet_msg_type)) {
+			status = -EOVERFLOW;
+			break;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* the last one, maybe followed by a pad byte */
+		if (skb->len - msg_len < sizeof(struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			status = -ENOMEM;
+			break;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+		queued++;
+
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	/* the rest is lost; fail the transfer only if none of it was good */
+	dev_kfree_skb_any(skb);
+	return queued ? 0 : (status ? status : -EINVAL);
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
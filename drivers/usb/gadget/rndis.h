@@ -220,6 +220,16 @@ typedef struct rndis_resp_t
 	int			send;
 } rndis_resp_t;
 
+/*
+ * Multi-packet transfers.  Host to device, we accept up to
+ * RNDIS_UL_MAX_PKTS_PER_XFER messages in one OUT transfer (which
+ * u_ether's buffers must be able to hold); device to host, the host
+ * says in REMOTE_NDIS_INITIALIZE_MSG how big an IN transfer it takes.
+ */
+#define RNDIS_UL_MAX_PKTS_PER_XFER	4
+#define RNDIS_UL_MAX_XFER_SIZE		7680	/* 15 * 512, skb fits 8K */
+#define RNDIS_DL_MAX_XFER_SIZE		8000
+
 typedef struct rndis_params
 {
 	u8			confignr;
@@ -239,6 +249,8 @@ typedef struct rndis_params
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	u32			dl_max_xfer_size;	/* from the host */
 } rndis_params;
 
 /* RNDIS Message parser and other useless functions */
@@ -250,6 +262,7 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+u32  rndis_get_dl_max_xfer_size (u8 configNr);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
@@ -24,10 +24,12 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -82,6 +84,12 @@ struct eth_dev {
 	unsigned long		todo;
 #define	WORK_RX_MEMORY		0
 
+	/* multi-packet IN transfers, see struct gether */
+	unsigned		tx_buf_size;	/* 0: one skb per request */
+	struct usb_request	*tx_agg_req;	/* being filled, guarded by req_lock */
+	unsigned		tx_agg_pkts;
+	struct hrtimer		tx_agg_timer;
+
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
 };
@@ -92,6 +100,10 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* Longest a batched IN transfer waits for more frames, when the ones in
+ * flight don't complete first. */
+#define TX_AGG_TIMEOUT_NS	(500 * NSEC_PER_USEC)
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -237,6 +249,7 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	size = max_t(size_t, size, dev->port_usb->ul_max_xfer_size);
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -422,6 +435,39 @@ done:
 	return status;
 }
 
+static void free_tx_buffers(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	dev->tx_buf_size = 0;
+}
+
+/* Buffers for multi-packet IN transfers; without them, one skb each */
+static void alloc_tx_buffers(struct eth_dev *dev, unsigned size)
+{
+	struct usb_request	*req;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list)
+		req->buf = NULL;
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* room for the byte that avoids a zlp */
+		req->buf = kmalloc(size + 1, GFP_ATOMIC);
+		if (!req->buf) {
+			DBG(dev, "no tx buffers, one frame per transfer\n");
+			free_tx_buffers(dev);
+			goto done;
+		}
+	}
+	dev->tx_buf_size = size;
+done:
+	spin_unlock(&dev->req_lock);
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -491,6 +537,200 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * Multi-packet IN transfers.  A frame that arrives while the link is idle
+ * goes out at once; while transfers are in flight, frames are copied into
+ * one request until it is full, a transfer completes, or the timer fires.
+ */
+
+static void tx_agg_complete(struct usb_ep *ep, struct usb_request *req);
+
+/* Called with req_lock held: take the request being filled, if any */
+static struct usb_request *tx_agg_detach(struct eth_dev *dev)
+{
+	struct usb_request	*req = dev->tx_agg_req;
+
+	if (req) {
+		dev->tx_agg_req = NULL;
+		req->context = (void *)(unsigned long)dev->tx_agg_pkts;
+		hrtimer_try_to_cancel(&dev->tx_agg_timer);
+	}
+	return req;
+}
+
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	unsigned long	flags;
+	int		retval;
+
+	req->complete = tx_agg_complete;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+	req->no_interrupt = 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval == 0) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped += (unsigned long)req->context;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs) && !dev->tx_agg_req)
+		netif_wake_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+/* Send whatever is being filled */
+static void tx_agg_flush(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	struct usb_ep		*in = NULL;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (!in)
+		return;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = tx_agg_detach(dev);
+	/* the queue may be stopped waiting for this one */
+	if (req && list_empty(&dev->tx_reqs))
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req)
+		tx_agg_queue(dev, in, req);
+}
+
+static enum hrtimer_restart tx_agg_timeout(struct hrtimer *timer)
+{
+	tx_agg_flush(container_of(timer, struct eth_dev, tx_agg_timer));
+	return HRTIMER_NORESTART;
+}
+
+static void tx_agg_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct eth_dev	*dev = ep->driver_data;
+	unsigned long	pkts = (unsigned long)req->context;
+
+	switch (req->status) {
+	default:
+		dev->net->stats.tx_errors += pkts;
+		VDBG(dev, "tx err %d\n", req->status);
+		/* FALLTHROUGH */
+	case -ECONNRESET:		/* unlink */
+	case -ESHUTDOWN:		/* disconnect etc */
+		break;
+	case 0:
+		dev->net->stats.tx_bytes += req->actual;
+	}
+	dev->net->stats.tx_packets += pkts;
+
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock(&dev->req_lock);
+
+	atomic_dec(&dev->tx_qlen);
+
+	/* the link is free again: don't sit on a batch */
+	if (req->status == 0)
+		tx_agg_flush(dev);
+
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
+static netdev_tx_t tx_agg_xmit(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in)
+{
+	struct usb_request	*req, *send = NULL;
+	struct gether		*port;
+	unsigned		max_pkts = 1, max_size = 0, room;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	port = dev->port_usb;
+	if (port) {
+		max_pkts = port->dl_max_pkts_per_xfer;
+		max_size = min(port->dl_max_xfer_size, dev->tx_buf_size);
+		if (dev->wrap)
+			skb = dev->wrap(port, skb);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (!port) {
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+	if (!skb || skb->len > dev->tx_buf_size)
+		goto drop;
+	if (max_pkts < 1)
+		max_pkts = 1;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	if (req && req->length + skb->len > max_size) {
+		send = tx_agg_detach(dev);
+		req = NULL;
+	}
+	if (!req) {
+		/* only when racing with the timer; see below */
+		if (list_empty(&dev->tx_reqs)) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			if (send)
+				tx_agg_queue(dev, in, send);
+			goto drop;
+		}
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		dev->tx_agg_req = req;
+		dev->tx_agg_pkts = 0;
+	}
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_agg_pkts++;
+
+	/* Full (no room for another frame of any size), or nothing in
+	 * flight to wait for?  Then it goes now.  A request that has
+	 * just replaced a full one always waits, as that one is sent. */
+	room = req->length < max_size ? max_size - req->length : 0;
+	if (!send && (dev->tx_agg_pkts >= max_pkts
+			|| atomic_read(&dev->tx_qlen) == 0
+			|| room < dev->net->mtu + ETH_HLEN + dev->header_len))
+		send = tx_agg_detach(dev);
+	else if (dev->tx_agg_pkts == 1)
+		hrtimer_start(&dev->tx_agg_timer, ns_to_ktime(TX_AGG_TIMEOUT_NS),
+				HRTIMER_MODE_REL);
+
+	/* Keep the queue stopped unless the next frame has somewhere to
+	 * go: a free request, or the one being filled, which has room. */
+	if (list_empty(&dev->tx_reqs) && !dev->tx_agg_req)
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (send)
+		tx_agg_queue(dev, in, send);
+	return NETDEV_TX_OK;
+
+drop:
+	if (skb)
+		dev_kfree_skb_any(skb);
+	dev->net->stats.tx_dropped++;
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -539,6 +779,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_buf_size)
+		return tx_agg_xmit(dev, skb, in);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -781,6 +1024,8 @@ int gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	spin_lock_init(&dev->lock);
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
+	hrtimer_init(&dev->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_agg_timer.function = tx_agg_timeout;
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
@@ -893,6 +1138,9 @@ struct net_device *gether_connect(struct gether *link)
 	if (result == 0)
 		result = alloc_requests(dev, link, qlen(dev->gadget));
 
+	if (result == 0 && link->dl_max_xfer_size)
+		alloc_tx_buffers(dev, link->dl_max_xfer_size);
+
 	if (result == 0) {
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
@@ -961,7 +1209,13 @@ void gether_disconnect(struct gether *link)
 	 * and forget about the endpoints.
 	 */
 	usb_ep_disable(link->in_ep);
+	hrtimer_cancel(&dev->tx_agg_timer);
 	spin_lock(&dev->req_lock);
+	req = tx_agg_detach(dev);
+	if (req)
+		list_add(&req->list, &dev->tx_reqs);
+	if (dev->tx_buf_size)
+		free_tx_buffers(dev);
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
@@ -68,6 +68,18 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* Batching several frames per transfer, for framings that can
+	 * delimit them (RNDIS).  With dl_max_xfer_size set, IN requests
+	 * get buffers that big and wrapped frames are copied into them,
+	 * up to dl_max_pkts_per_xfer each; this may be raised once the
+	 * host has agreed and dl_max_xfer_size lowered, both under the
+	 * link's lock.  ul_max_xfer_size sizes OUT buffers when the host
+	 * may batch too.
+	 */
+	unsigned			dl_max_pkts_per_xfer;
+	unsigned			dl_max_xfer_size;
+	unsigned			ul_max_xfer_size;
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -31,6 +31,34 @@
 
 extern int usb_host_wakeup_irq(struct device *wkup_dev);
 extern void usb_host_set_wakeup(struct device *wkup_dev, bool para);
+
+/*
+ * Interrupt threshold (USBCMD ITC) state, one per controller.  With
+ * adaptive coalescing the threshold only applies while at least
+ * "depth" qTDs are queued on the async schedule, so a lone transfer
+ * still completes with minimum latency.
+ */
+struct ehci_fsl_itc {
+	unsigned		log2_thresh;	/* 0..6: 1..64 microframes */
+	unsigned		adaptive:1;
+	unsigned		depth;
+	unsigned		cur;		/* programmed, ~0 if unknown */
+	unsigned long		irqs;
+	u64			bytes;		/* bulk bytes queued */
+};
+
+struct ehci_fsl_hcd {
+	struct ehci_hcd		ehci;		/* must be first */
+	struct ehci_fsl_itc	itc;
+};
+
+static inline struct ehci_fsl_itc *ehci_to_itc(struct ehci_hcd *ehci)
+{
+	return &container_of(ehci, struct ehci_fsl_hcd, ehci)->itc;
+}
+
+static void ehci_fsl_itc_attrs_init(struct usb_hcd *hcd);
+static void ehci_fsl_itc_attrs_exit(struct usb_hcd *hcd);
 static void fsl_usb_lowpower_mode(struct fsl_usb2_platform_data *pdata, bool enable)
 {
 	if (enable) {
@@ -257,6 +285,7 @@ int usb_hcd_fsl_probe(const struct hc_driver *driver,
 
 	fsl_platform_set_ahb_burst(hcd);
 	ehci_testmode_init(hcd_to_ehci(hcd));
+	ehci_fsl_itc_attrs_init(hcd);
 	return retval;
 err5:
 	usb_remove_hcd(hcd);
@@ -305,6 +334,8 @@ static void usb_hcd_fsl_remove(struct usb_hcd *hcd,
 		}
 	}
 
+	ehci_fsl_itc_attrs_exit(hcd);
+
 	/* DDD shouldn't we turn off the power here? */
 	fsl_platform_set_vbus_power(pdata, 0);
 
@@ -470,21 +501,227 @@ static int ehci_fsl_setup(struct usb_hcd *hcd)
 
 	ehci->sbrn = 0x20;
 
+	/* ehci_init() has validated the module-wide default */
+	ehci_to_itc(ehci)->log2_thresh = log2_irq_thresh;
+	ehci_to_itc(ehci)->cur = log2_irq_thresh;
+	ehci_to_itc(ehci)->depth = 4;
+
 	ehci_reset(ehci);
 
 	retval = ehci_fsl_reinit(ehci);
 	return retval;
 }
 
+/*
+ * Count qTDs queued on the async schedule, stopping at "limit".  The
+ * EHCI core sets IOC only on the last qTD of each URB, so a deep queue
+ * means several URBs will complete close together.
+ */
+static unsigned ehci_fsl_async_depth(struct ehci_hcd *ehci, unsigned limit)
+{
+	struct ehci_qh *qh;
+	struct list_head *entry;
+	unsigned depth = 0;
+
+	for (qh = ehci->async->qh_next.qh; qh; qh = qh->qh_next.qh) {
+		list_for_each(entry, &qh->qtd_list) {
+			if (++depth >= limit)
+				return depth;
+		}
+	}
+	return depth;
+}
+
+/*
+ * Reprogram ITC if the wanted threshold changed.  EHCI 1.0 leaves ITC
+ * writes on a running controller undefined, which is why adaptive
+ * coalescing is off unless asked for.  Caller holds ehci->lock and
+ * the controller is accessible.
+ */
+static void ehci_fsl_itc_update(struct ehci_hcd *ehci)
+{
+	struct ehci_fsl_itc *itc = ehci_to_itc(ehci);
+	unsigned want = itc->log2_thresh;
+	u32 cmd;
+
+	if (itc->adaptive && want &&
+	    ehci_fsl_async_depth(ehci, itc->depth) < itc->depth)
+		want = 0;
+	if (want == itc->cur)
+		return;
+
+	itc->cur = want;
+	ehci->command &= ~(0xff << 16);
+	ehci->command |= 1 << (16 + want);
+	cmd = ehci_readl(ehci, &ehci->regs->command);
+	cmd &= ~(0xff << 16);
+	ehci_writel(ehci, cmd | (1 << (16 + want)), &ehci->regs->command);
+}
+
+static irqreturn_t ehci_fsl_irq(struct usb_hcd *hcd)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	irqreturn_t ret;
+
+	ret = ehci_irq(hcd);
+	if (ret == IRQ_HANDLED) {
+		spin_lock(&ehci->lock);
+		ehci_to_itc(ehci)->irqs++;
+		ehci_fsl_itc_update(ehci);
+		spin_unlock(&ehci->lock);
+	}
+	return ret;
+}
+
+static int ehci_fsl_urb_enqueue(struct usb_hcd *hcd, struct urb *urb,
+				gfp_t mem_flags)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	unsigned long flags;
+	int ret;
+
+	ret = ehci_urb_enqueue(hcd, urb, mem_flags);
+	if (ret == 0 && usb_pipebulk(urb->pipe)) {
+		spin_lock_irqsave(&ehci->lock, flags);
+		ehci_to_itc(ehci)->bytes += urb->transfer_buffer_length;
+		if (HC_IS_RUNNING(hcd->state))
+			ehci_fsl_itc_update(ehci);
+		spin_unlock_irqrestore(&ehci->lock, flags);
+	}
+	return ret;
+}
+
+/* sysfs knobs, on the platform device of each controller */
+static ssize_t show_irq_thresh(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+
+	return sprintf(buf, "%u\n", ehci_to_itc(ehci)->log2_thresh);
+}
+
+static ssize_t store_irq_thresh(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct usb_hcd *hcd = dev_get_drvdata(dev);
+	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	unsigned long flags;
+	unsigned val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val > 6)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	ehci_to_itc(ehci)->log2_thresh = val;
+	if (test_bit(HCD_FLAG_HW_ACCESSIBLE, &hcd->flags))
+		ehci_fsl_itc_update(ehci);
+	else
+		ehci_to_itc(ehci)->cur = ~0;	/* reprogram later */
+	spin_unlock_irqrestore(&ehci->lock, flags);
+	return count;
+}
+static DEVICE_ATTR(irq_thresh, 0644, show_irq_thresh, store_irq_thresh);
+
+static ssize_t show_irq_adaptive(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+
+	return sprintf(buf, "%u\n", ehci_to_itc(ehci)->adaptive);
+}
+
+static ssize_t store_irq_adaptive(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	unsigned val;
+
+	if (sscanf(buf, "%u", &val) != 1)
+		return -EINVAL;
+	/* takes effect at the next enqueue or interrupt */
+	ehci_to_itc(ehci)->adaptive = !!val;
+	return count;
+}
+static DEVICE_ATTR(irq_adaptive, 0644, show_irq_adaptive, store_irq_adaptive);
+
+static ssize_t show_irq_adaptive_depth(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+
+	return sprintf(buf, "%u\n", ehci_to_itc(ehci)->depth);
+}
+
+static ssize_t store_irq_adaptive_depth(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	unsigned val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val == 0)
+		return -EINVAL;
+	ehci_to_itc(ehci)->depth = val;
+	return count;
+}
+static DEVICE_ATTR(irq_adaptive_depth, 0644, show_irq_adaptive_depth,
+		   store_irq_adaptive_depth);
+
+static ssize_t show_irq_stats(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct ehci_hcd *ehci = hcd_to_ehci(dev_get_drvdata(dev));
+	struct ehci_fsl_itc *itc = ehci_to_itc(ehci);
+	unsigned long flags, irqs, mb;
+	u64 bytes;
+
+	spin_lock_irqsave(&ehci->lock, flags);
+	irqs = itc->irqs;
+	bytes = itc->bytes;
+	spin_unlock_irqrestore(&ehci->lock, flags);
+
+	mb = bytes >> 20;
+	return sprintf(buf, "irqs %lu\nbulk_bytes %llu\nirqs_per_mb %lu\n",
+		       irqs, (unsigned long long)bytes, mb ? irqs / mb : 0);
+}
+static DEVICE_ATTR(irq_stats, 0444, show_irq_stats, NULL);
+
+static struct attribute *ehci_fsl_itc_attrs[] = {
+	&dev_attr_irq_thresh.attr,
+	&dev_attr_irq_adaptive.attr,
+	&dev_attr_irq_adaptive_depth.attr,
+	&dev_attr_irq_stats.attr,
+	NULL,
+};
+
+static const struct attribute_group ehci_fsl_itc_attr_group = {
+	.attrs = ehci_fsl_itc_attrs,
+};
+
+static void ehci_fsl_itc_attrs_init(struct usb_hcd *hcd)
+{
+	if (sysfs_create_group(&hcd->self.controller->kobj,
+			       &ehci_fsl_itc_attr_group))
+		dev_warn(hcd->self.controller, "can't create ITC attributes\n");
+}
+
+static void ehci_fsl_itc_attrs_exit(struct usb_hcd *hcd)
+{
+	sysfs_remove_group(&hcd->self.controller->kobj,
+			   &ehci_fsl_itc_attr_group);
+}
+
 static const struct hc_driver ehci_fsl_hc_driver = {
 	.description = hcd_name,
 	.product_desc = "Freescale On-Chip EHCI Host Controller",
-	.hcd_priv_size = sizeof(struct ehci_hcd),
+	.hcd_priv_size = sizeof(struct ehci_fsl_hcd),
 
 	/*
 	 * generic hardware linkage
 	 */
-	.irq = ehci_irq,
+	.irq = ehci_fsl_irq,
 	.flags = HCD_USB2,
 
 	/*
@@ -498,7 +735,7 @@ static const struct hc_driver ehci_fsl_hc_driver = {
 	/*
 	 * managing i/o requests and associated device resources
 	 */
-	.urb_enqueue = ehci_urb_enqueue,
+	.urb_enqueue = ehci_fsl_urb_enqueue,
 	.urb_dequeue = ehci_urb_dequeue,
 	.endpoint_disable = ehci_endpoint_disable,
 	.endpoint_reset = ehci_endpoint_reset,
@@ -523,11 +760,16 @@ static const struct hc_driver ehci_fsl_hc_driver = {
 
 static int ehci_fsl_drv_probe(struct platform_device *pdev)
 {
+	int retval;
+
 	if (usb_disabled())
 		return -ENODEV;
 
 	/* FIXME we only want one one probe() not two */
-	return usb_hcd_fsl_probe(&ehci_fsl_hc_driver, pdev);
+	retval = usb_hcd_fsl_probe(&ehci_fsl_hc_driver, pdev);
+	if (!retval)
+		device_enable_async_resume(&pdev->dev);
+	return retval;
 }
 
 static int ehci_fsl_drv_remove(struct platform_device *pdev)
@@ -52,3 +52,189 @@ void dither_neon_Y1(
 		}
 	}
 }
+
+/*
+ * Dithering algorithm implementation - Y8->Y4 version 2.0 for i.MX
+ * Ordered (neon). Adds the 4x4 Bayer offset to each pixel and keeps the
+ * upper nibble, which is idempotent so the 8-pixel tail may safely run
+ * into the row stride padding.
+ */
+void dither_neon_Y4(
+	unsigned char *update_region_ptr,
+	int width, int height, int stride)
+{
+	int x, y;
+
+	/* Rows of { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, ... packed little endian */
+	static const uint32_t bayer[4] = {
+		0x0a020800, 0x060e040c, 0x09010b03, 0x050d070f
+	};
+	uint8x16_t q_mask = vdupq_n_u8(0xf0);
+
+	for (y = 0; y < height; y++)
+	{
+		unsigned char *ptr = update_region_ptr + stride*y;
+		uint8x16_t q_bayer =
+			vreinterpretq_u8_u32(vdupq_n_u32(bayer[y & 3]));
+
+		for (x = 0; x + 16 <= width; x += 16)
+		{
+			uint8x16_t l = vld1q_u8(ptr);
+			l = vandq_u8(vqaddq_u8(l, q_bayer), q_mask);
+			vst1q_u8(ptr, l);
+			ptr += 16;
+		}
+		if (x < width)
+		{
+			/* stride is 8-pixel aligned, so this stays in the row */
+			uint8x8_t l = vld1_u8(ptr);
+			l = vand_u8(vqadd_u8(l, vget_low_u8(q_bayer)),
+				vget_low_u8(q_mask));
+			vst1_u8(ptr, l);
+		}
+	}
+}
+
+/*
+ * Error diffusion helpers.
+ *
+ * Atkinson hands 1/8 of the error to the next two pixels of the current
+ * line, to three pixels of the next line and to one pixel two lines down.
+ * Only the first part is a true serial dependency; it is carried in two
+ * registers by the per-pixel loop, which records each pixel's error in e[].
+ * Everything that touches the error rows is done eight lanes at a time.
+ *
+ * err_buf layout (int16, DITHER_NEON_ERR_ROW(width) entries each):
+ * three rotating error lines followed by the per-pixel error line e[].
+ * Column 0 and columns past width are padding so that col-1 and the
+ * vector tails never leave the buffer.
+ */
+
+/* l0[col] += y8[col - 1], so the serial loop reads a single value */
+static inline void dither_neon_prime_row(int16_t *l0,
+	const unsigned char *y8buf, int width)
+{
+	int col;
+
+	for (col = 1; col <= width; col += 8) {
+		int16x8_t pix = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y8buf)));
+
+		vst1q_s16(l0 + col, vaddq_s16(vld1q_s16(l0 + col), pix));
+		y8buf += 8;
+	}
+}
+
+/* l1[col] += e[col - 1] + e[col] + e[col + 1], l2[col] = e[col] */
+static inline void dither_neon_spread_row(const int16_t *e,
+	int16_t *l1, int16_t *l2, int width)
+{
+	int col;
+
+	for (col = 1; col <= width; col += 8) {
+		int16x8_t em = vld1q_s16(e + col - 1);
+		int16x8_t ec = vld1q_s16(e + col);
+		int16x8_t ep = vld1q_s16(e + col + 1);
+		int16x8_t acc = vld1q_s16(l1 + col);
+
+		acc = vaddq_s16(acc, vaddq_s16(vaddq_s16(em, ec), ep));
+		vst1q_s16(l1 + col, acc);
+		vst1q_s16(l2 + col, ec);
+	}
+}
+
+/*
+ * Dithering algorithm implementation - Y8->Y1 version 2.0 for i.MX
+ * Atkinson (neon).
+ */
+void dither_neon_atkinson_Y1(
+	unsigned char *update_region_ptr,
+	int width, int height, int stride, void *err_buf)
+{
+	int row = DITHER_NEON_ERR_ROW(width);
+	int16_t *err_dist = err_buf;
+	int16_t *e = err_dist + row * 3;
+	int16_t *err_dist_l0, *err_dist_l1, *err_dist_l2;
+	unsigned char *y8buf;
+	int y, col;
+
+	for (y = 0; y < height; y++) {
+		int carry = 0, prev = 0;
+
+		err_dist_l0 = err_dist + row * (y % 3);
+		err_dist_l1 = err_dist + row * ((y + 1) % 3);
+		err_dist_l2 = err_dist + row * ((y + 2) % 3);
+
+		y8buf = update_region_ptr + stride * y;
+		dither_neon_prime_row(err_dist_l0, y8buf, width);
+
+		for (col = 1; col <= width; col++) {
+			int bwPix = err_dist_l0[col] + carry;
+			int distrib_error;
+
+			if (bwPix >= 128) {
+				*y8buf++ = 0xff;
+				distrib_error = (bwPix - 255) >> 3;
+			} else {
+				*y8buf++ = 0;
+				distrib_error = bwPix >> 3;
+			}
+
+			e[col] = distrib_error;
+			carry = distrib_error + prev;
+			prev = distrib_error;
+		}
+		e[0] = 0;
+		e[width + 1] = 0;
+
+		dither_neon_spread_row(e, err_dist_l1, err_dist_l2, width);
+	}
+}
+
+/*
+ * Dithering algorithm implementation - Y8->Y4 version 2.0 for i.MX
+ * Atkinson (neon).
+ */
+void dither_neon_atkinson_Y4(
+	unsigned char *update_region_ptr,
+	int width, int height, int stride, void *err_buf)
+{
+	int row = DITHER_NEON_ERR_ROW(width);
+	int16_t *err_dist = err_buf;
+	int16_t *e = err_dist + row * 3;
+	int16_t *err_dist_l0, *err_dist_l1, *err_dist_l2;
+	unsigned char *y8buf;
+	int y, col;
+
+	for (y = 0; y < height; y++) {
+		int carry = 0, prev = 0;
+
+		err_dist_l0 = err_dist + row * (y % 3);
+		err_dist_l1 = err_dist + row * ((y + 1) % 3);
+		err_dist_l2 = err_dist + row * ((y + 2) % 3);
+
+		y8buf = update_region_ptr + stride * y;
+		dither_neon_prime_row(err_dist_l0, y8buf, width);
+
+		for (col = 1; col <= width; col++) {
+			int gcPix = err_dist_l0[col] + carry;
+			int distrib_error;
+
+			if (gcPix > 255)
+				gcPix = 255;
+			else if (gcPix < 0)
+				gcPix = 0;
+
+			distrib_error = (*y8buf - (gcPix & 0xf0)) >> 3;
+
+			*y8buf++ = gcPix & 0xf0;
+
+			e[col] = distrib_error;
+			carry = distrib_error + prev;
+			prev = distrib_error;
+		}
+		e[0] = 0;
+		e[width + 1] = 0;
+
+		dither_neon_spread_row(e, err_dist_l1, err_dist_l2, width);
+	}
+}
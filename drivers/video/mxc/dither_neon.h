@@ -1,2 +1,30 @@
+#ifndef __DITHER_NEON_H__
+#define __DITHER_NEON_H__
+
+/*
+ * NEON dithering kernels. These live in their own compilation unit
+ * (built with -mfpu=neon) and must only be called between
+ * kernel_neon_begin() and kernel_neon_end().
+ */
+
+/* Ordered (4x4 Bayer) dithering, Y8->Y1 and Y8->Y4 */
 void dither_neon_Y1(unsigned char *update_region_ptr,
 	int width, int height, int stride);
+void dither_neon_Y4(unsigned char *update_region_ptr,
+	int width, int height, int stride);
+
+/*
+ * Atkinson error diffusion, Y8->Y1 and Y8->Y4. Output is identical to
+ * the C versions in mxc_epdc_fb.c. err_buf must hold at least
+ * DITHER_NEON_ERR_BUF_SIZE(width) bytes and be zeroed by the caller.
+ */
+#define DITHER_NEON_ERR_ROW(width)		((width) + 16)
+#define DITHER_NEON_ERR_BUF_SIZE(width)	\
+	(DITHER_NEON_ERR_ROW(width) * 4 * sizeof(short))
+
+void dither_neon_atkinson_Y1(unsigned char *update_region_ptr,
+	int width, int height, int stride, void *err_buf);
+void dither_neon_atkinson_Y4(unsigned char *update_region_ptr,
+	int width, int height, int stride, void *err_buf);
+
+#endif /* __DITHER_NEON_H__ */
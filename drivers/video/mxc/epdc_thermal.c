@@ -0,0 +1,217 @@
+/*
+ * Thermal zone for the E-Ink panel temperature sensor.
+ *
+ * The sensor (LM75, or the TPS65185 thermistor input) is sampled in the
+ * background for the EPDC waveform temperature index, and every sample
+ * also updates this zone, so the zone adds no polling of its own.  Once
+ * the passive trip is crossed the thermal core polls every
+ * EPDC_THERMAL_PASSIVE_MS and steps the "cpufreq" cooling device, which
+ * caps the CPU one working point at a time, until it has cooled down.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/err.h>
+#include <linux/thermal.h>
+#include <linux/cpufreq.h>
+
+#include "epdc_thermal.h"
+
+#define EPDC_THERMAL_PASSIVE_MS	5000
+#define EPDC_COOL_MAX_STATES	8
+
+static unsigned int passive_temp = 45;
+module_param(passive_temp, uint, 0644);
+MODULE_PARM_DESC(passive_temp, "panel temperature (C) that starts capping cpufreq");
+
+static int (*epdc_thermal_read)(int *temp, int fresh);
+static struct thermal_zone_device *epdc_tz;
+static struct thermal_cooling_device *epdc_cdev;
+
+/* cpufreq working points, highest first; state n caps at epdc_cool_freq[n] */
+static unsigned int epdc_cool_freq[EPDC_COOL_MAX_STATES];
+static unsigned int epdc_cool_nr;
+static unsigned long epdc_cool_state;
+
+static int epdc_cool_get_max_state(struct thermal_cooling_device *cdev,
+				   unsigned long *state)
+{
+	*state = epdc_cool_nr ? epdc_cool_nr - 1 : 0;
+	return 0;
+}
+
+static int epdc_cool_get_cur_state(struct thermal_cooling_device *cdev,
+				   unsigned long *state)
+{
+	*state = epdc_cool_state;
+	return 0;
+}
+
+static int epdc_cool_set_cur_state(struct thermal_cooling_device *cdev,
+				   unsigned long state)
+{
+	if (epdc_cool_nr && state >= epdc_cool_nr)
+		return -EINVAL;
+	if (state == epdc_cool_state)
+		return 0;
+	epdc_cool_state = state;
+	cpufreq_update_policy(0);
+	return 0;
+}
+
+static struct thermal_cooling_device_ops epdc_cool_ops = {
+	.get_max_state	= epdc_cool_get_max_state,
+	.get_cur_state	= epdc_cool_get_cur_state,
+	.set_cur_state	= epdc_cool_set_cur_state,
+};
+
+static int epdc_cool_policy_notifier(struct notifier_block *nb,
+				     unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+
+	if (event == CPUFREQ_ADJUST && epdc_cool_state)
+		cpufreq_verify_within_limits(policy, 0,
+					     epdc_cool_freq[epdc_cool_state]);
+	return 0;
+}
+
+static struct notifier_block epdc_cool_nb = {
+	.notifier_call	= epdc_cool_policy_notifier,
+};
+
+static void epdc_cool_init_freqs(void)
+{
+	struct cpufreq_frequency_table *table = cpufreq_frequency_get_table(0);
+	unsigned int f, i, j;
+
+	for (i = 0; table && table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		f = table[i].frequency;
+		if (f == CPUFREQ_ENTRY_INVALID)
+			continue;
+		/* insert in descending order, dropping duplicates */
+		for (j = 0; j < epdc_cool_nr && epdc_cool_freq[j] > f; j++)
+			;
+		if (j < epdc_cool_nr && epdc_cool_freq[j] == f)
+			continue;
+		if (epdc_cool_nr == EPDC_COOL_MAX_STATES)
+			break;
+		memmove(&epdc_cool_freq[j + 1], &epdc_cool_freq[j],
+			(epdc_cool_nr - j) * sizeof(epdc_cool_freq[0]));
+		epdc_cool_freq[j] = f;
+		epdc_cool_nr++;
+	}
+}
+
+static int epdc_tz_bind(struct thermal_zone_device *tz,
+			struct thermal_cooling_device *cdev)
+{
+	if (cdev != epdc_cdev)
+		return 0;
+	return thermal_zone_bind_cooling_device(tz, 0, cdev);
+}
+
+static int epdc_tz_unbind(struct thermal_zone_device *tz,
+			  struct thermal_cooling_device *cdev)
+{
+	if (cdev != epdc_cdev)
+		return 0;
+	return thermal_zone_unbind_cooling_device(tz, 0, cdev);
+}
+
+static int epdc_tz_get_temp(struct thermal_zone_device *tz,
+			    unsigned long *temp)
+{
+	int t, ret;
+
+	/* while cooling, each passive poll wants a real sample */
+	ret = epdc_thermal_read(&t, tz->passive);
+	if (ret < 0)
+		return ret;
+	*temp = max(t, 0) * 1000;
+	return 0;
+}
+
+static int epdc_tz_get_trip_type(struct thermal_zone_device *tz, int trip,
+				 enum thermal_trip_type *type)
+{
+	if (trip != 0)
+		return -EINVAL;
+	*type = THERMAL_TRIP_PASSIVE;
+	return 0;
+}
+
+static int epdc_tz_get_trip_temp(struct thermal_zone_device *tz, int trip,
+				 unsigned long *temp)
+{
+	if (trip != 0)
+		return -EINVAL;
+	*temp = passive_temp * 1000;
+	return 0;
+}
+
+static struct thermal_zone_device_ops epdc_tz_ops = {
+	.bind		= epdc_tz_bind,
+	.unbind		= epdc_tz_unbind,
+	.get_temp	= epdc_tz_get_temp,
+	.get_trip_type	= epdc_tz_get_trip_type,
+	.get_trip_temp	= epdc_tz_get_trip_temp,
+};
+
+/**
+ * epdc_thermal_init - register the panel thermal zone
+ * @read:	returns the panel temperature in Celsius, see epdc_thermal.h
+ *
+ * Called once the first temperature sample has been taken.
+ */
+int epdc_thermal_init(int (*read)(int *temp, int fresh))
+{
+	int ret;
+
+	if (epdc_tz)
+		return 0;
+
+	epdc_thermal_read = read;
+	epdc_cool_init_freqs();
+
+	ret = cpufreq_register_notifier(&epdc_cool_nb, CPUFREQ_POLICY_NOTIFIER);
+	if (ret)
+		return ret;
+
+	epdc_cdev = thermal_cooling_device_register("cpufreq", NULL,
+						    &epdc_cool_ops);
+	if (IS_ERR(epdc_cdev)) {
+		ret = PTR_ERR(epdc_cdev);
+		goto err_cdev;
+	}
+
+	epdc_tz = thermal_zone_device_register("epdc", 1, NULL, &epdc_tz_ops,
+					       1, 1, EPDC_THERMAL_PASSIVE_MS, 0);
+	if (IS_ERR(epdc_tz)) {
+		ret = PTR_ERR(epdc_tz);
+		epdc_tz = NULL;
+		goto err_tz;
+	}
+	return 0;
+
+err_tz:
+	thermal_cooling_device_unregister(epdc_cdev);
+err_cdev:
+	epdc_cdev = NULL;
+	cpufreq_unregister_notifier(&epdc_cool_nb, CPUFREQ_POLICY_NOTIFIER);
+	printk(KERN_ERR "epdc_thermal: registration failed %d\n", ret);
+	return ret;
+}
+
+/**
+ * epdc_thermal_update - re-evaluate the trip point after a new sample
+ */
+void epdc_thermal_update(void)
+{
+	if (epdc_tz)
+		thermal_zone_device_update(epdc_tz);
+}
@@ -0,0 +1,20 @@
+#ifndef EPDC_THERMAL_H//[
+#define EPDC_THERMAL_H
+
+/*
+ * Thermal zone of the E-Ink panel temperature sensor, see epdc_thermal.c .
+ * @read returns the cached temperature in Celsius ; when @fresh is set
+ * the cache must not be older than about a second .
+ */
+#ifdef CONFIG_FB_MXC_EINK_THERMAL//[
+int epdc_thermal_init(int (*read)(int *piTemp, int fresh));
+void epdc_thermal_update(void);
+#else //][!CONFIG_FB_MXC_EINK_THERMAL
+static inline int epdc_thermal_init(int (*read)(int *piTemp, int fresh))
+{
+	return 0;
+}
+static inline void epdc_thermal_update(void) {}
+#endif //]CONFIG_FB_MXC_EINK_THERMAL
+
+#endif //]EPDC_THERMAL_H
@@ -27,6 +27,12 @@
 	#define my_malloc(sz)	kmalloc(sz,GFP_KERNEL)
 	#define my_free(p)		kfree(p)
 	#define my_memcpy(dest,src,size)	memcpy(dest,src,size)
+
+	#ifdef CONFIG_KERNEL_MODE_NEON//[
+		#include <asm/neon.h>
+		#include "epdfb_dc_neon.h"
+		#define EPDFB_DC_NEON	1
+	#endif//] CONFIG_KERNEL_MODE_NEON
 	
 #else //][!__KERNEL__
 	#include <stdio.h>
@@ -48,17 +54,46 @@
 
 
 
-static void _fb_gray_8to4(unsigned char *data, unsigned long len)
+#ifdef EPDFB_DC_NEON//[
+// the NEON converters are only used after _epdfbdc_neon_selftest() has
+// checked them against the C versions on this CPU .
+// -1 : not checked yet , 0 : C only , 1 : NEON verified .
+static int giEPDFB_NeonConv = -1;
+static int _epdfbdc_neon_selftest(void);
+
+static inline int _epdfbdc_neon_conv(void)
+{
+	if(giEPDFB_NeonConv<0) {
+		giEPDFB_NeonConv = cpu_has_neon()?_epdfbdc_neon_selftest():0;
+	}
+	return giEPDFB_NeonConv;
+}
+	#define EPDFB_NEON_CONV()	_epdfbdc_neon_conv()
+#else //][!EPDFB_DC_NEON
+	#define EPDFB_NEON_CONV()	0
+#endif //] EPDFB_DC_NEON
+
+// in place , two 8 bits pixels -> one byte (first pixel in high nibble) .
+static void _fb_gray_8to4_ex(unsigned char *data, unsigned long len,int iUseNeon)
 {
 	unsigned char *pb = (unsigned char *)data ;
-	unsigned long dwByteRdIdx,dwByteWrIdx;
+	unsigned long dwByteRdIdx=0,dwByteWrIdx=0;
 	unsigned char bTemp;
-	unsigned long dwLenNew = len;
 
 	DBG_MSG("%s(%d):data=%p,len=%d\n",\
 			__FUNCTION__,__LINE__,data,len);
 
-	for(dwByteRdIdx=0,dwByteWrIdx=0;1;)
+#ifdef EPDFB_DC_NEON//[
+	if(iUseNeon && len>=32) {
+		dwByteWrIdx = (len>>1)&~15;
+		dwByteRdIdx = dwByteWrIdx<<1;
+		kernel_neon_begin();
+		epdfb_neon_gray8to4(pb,pb,dwByteWrIdx);
+		kernel_neon_end();
+	}
+#endif //] EPDFB_DC_NEON
+
+	for(;dwByteRdIdx<len;)
 	{
 		bTemp = (pb[dwByteRdIdx]>>4)&0x0f;
 		bTemp = bTemp<<4;
@@ -66,8 +101,7 @@ static void _fb_gray_8to4(unsigned char *data, unsigned long len)
 			break;
 		}
 		bTemp |= (pb[dwByteRdIdx]>>4)&0x0f;
-		dwLenNew-=1;
-		pb[++dwByteWrIdx] = bTemp;
+		pb[dwByteWrIdx++] = bTemp;
 
 		if(++dwByteRdIdx>=len) {
 			break;
@@ -126,18 +160,29 @@ static const unsigned char gbGray4toGray8_TableA[] = {
 	0xf0,
 };
 
-static void _fb_Gray4toRGB565(
+static void _fb_Gray4toRGB565_ex(
 	unsigned char *IO_pbRGB565Buf,unsigned long I_dwRGB565BufSize,
-	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap)
+	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap,
+	int iUseNeon)
 {
-	unsigned long dwRd;
+	unsigned long dwRd=0;
 	unsigned short *pwWrBuf = (unsigned short *)IO_pbRGB565Buf;
 	unsigned char *pbRdSrc = I_pb4BitsSrc;
 	
 	int iIdxDot1,iIdxDot2;
 	
+#ifdef EPDFB_DC_NEON//[
+	if(iUseNeon && I_dw4BitsBufSize>=8) {
+		dwRd = I_dw4BitsBufSize&~7;
+		kernel_neon_begin();
+		epdfb_neon_gray4_to_rgb565(pbRdSrc,(unsigned char *)pwWrBuf,dwRd,
+			gwGray4toRGB565_TableA,iIsPixelSwap);
+		kernel_neon_end();
+		pwWrBuf += dwRd<<1;
+	}
+#endif //] EPDFB_DC_NEON
 	
-	for(dwRd=0;dwRd<I_dw4BitsBufSize;dwRd++)
+	for(;dwRd<I_dw4BitsBufSize;dwRd++)
 	{
 		
 		if(iIsPixelSwap) {
@@ -154,17 +199,32 @@ static void _fb_Gray4toRGB565(
 	}
 }
 
-static void _fb_Gray8toRGB565(
+static void _fb_Gray8toRGB565_ex(
 	unsigned char *IO_pbRGB565Buf,unsigned long I_dwRGB565BufSize,
-	unsigned char *I_pb8BitsSrc,unsigned long I_dw8BitsBufSize)
+	unsigned char *I_pb8BitsSrc,unsigned long I_dw8BitsBufSize,int iUseNeon)
 {
-	unsigned long dwRd,dwWr;
+	unsigned long dwRd=0,dwWr=0;
 	unsigned short *pwWrBuf = (unsigned short *)IO_pbRGB565Buf;
 	unsigned char *pbRdSrc = I_pb8BitsSrc;
 	
+#ifdef EPDFB_DC_NEON//[
+	// leave the last pixel to the loop below , it reports a full buffer .
+	if(iUseNeon && I_dwRGB565BufSize>16 && I_dw8BitsBufSize>=16) {
+		dwRd = I_dw8BitsBufSize;
+		if(dwRd>I_dwRGB565BufSize-1) {
+			dwRd = I_dwRGB565BufSize-1;
+		}
+		dwRd &= ~15;
+		dwWr = dwRd;
+		kernel_neon_begin();
+		epdfb_neon_gray8_to_rgb565(pbRdSrc,(unsigned char *)pwWrBuf,dwRd);
+		kernel_neon_end();
+		pbRdSrc += dwRd;
+		pwWrBuf += dwRd;
+	}
+#endif //] EPDFB_DC_NEON
 	
-	
-	for(dwRd=0;dwRd<I_dw8BitsBufSize;dwRd++)
+	for(;dwRd<I_dw8BitsBufSize;dwRd++)
 	{
 		*pwWrBuf++ = (*pbRdSrc++)<<8;
 		if(++dwWr>=I_dwRGB565BufSize) {
@@ -174,18 +234,39 @@ static void _fb_Gray8toRGB565(
 	}
 }
 
-static void _fb_RGB565toGray4(
+// in place , two RGB565 pixels -> one byte .
+static void _fb_RGB565toGray4_ex(
 	unsigned char *IO_pbGray4Buf,unsigned long I_dwGray4BufSize,
-	unsigned char *I_pbRGB565Buf,unsigned long I_dwRGB565BufSize,int iIsPixelSwap)
+	unsigned char *I_pbRGB565Buf,unsigned long I_dwRGB565BufSize,int iIsPixelSwap,
+	int iUseNeon)
 {
-	unsigned long dwRd,dwWr;
+	unsigned long dwRd=0,dwWr=0;
 	unsigned char *pbWrBuf = (unsigned char *)IO_pbGray4Buf;
 	unsigned short *pwRdSrc = (unsigned short *)I_pbRGB565Buf;
 	
 	unsigned char bDot1,bDot2;
 	
 	ASSERT(!(I_dwRGB565BufSize&1));
-	for(dwRd=0;dwRd<I_dwRGB565BufSize;dwRd+=2)
+
+#ifdef EPDFB_DC_NEON//[
+	// leave the last byte to the loop below , it reports a full buffer .
+	if(iUseNeon && I_dwGray4BufSize>8 && I_dwRGB565BufSize>=32) {
+		dwWr = I_dwRGB565BufSize>>2;
+		if(dwWr>I_dwGray4BufSize-1) {
+			dwWr = I_dwGray4BufSize-1;
+		}
+		dwWr &= ~7;
+		dwRd = dwWr<<2;
+		kernel_neon_begin();
+		epdfb_neon_rgb565_to_gray4((unsigned char *)pwRdSrc,pbWrBuf,dwWr,
+			iIsPixelSwap);
+		kernel_neon_end();
+		pwRdSrc += dwWr<<1;
+		pbWrBuf += dwWr;
+	}
+#endif //] EPDFB_DC_NEON
+
+	for(;dwRd+4<=I_dwRGB565BufSize;dwRd+=4)
 	{
 		bDot1 = (*pwRdSrc) >> 12 ;
 		pwRdSrc ++ ;
@@ -193,10 +274,10 @@ static void _fb_RGB565toGray4(
 		pwRdSrc ++ ;
 		
 		if(iIsPixelSwap) {
-			*pbWrBuf = bDot2&(bDot1<<4) ;
+			*pbWrBuf = bDot2|(bDot1<<4) ;
 		}
 		else {
-			*pbWrBuf = (bDot2<<4)&bDot1 ;
+			*pbWrBuf = (bDot2<<4)|bDot1 ;
 		}
 		pbWrBuf++;
 		if(++dwWr >=  I_dwGray4BufSize) {
@@ -207,13 +288,28 @@ static void _fb_RGB565toGray4(
 }
 
 
-static void _fb_gray_4to8(
+static void _fb_gray_4to8_ex(
 	unsigned char *IO_pb8BitsBuf,unsigned long I_dw8BitsBufSize,
-	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap)
+	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap,
+	int iUseNeon)
 {
-	unsigned long dwWr,dwRd;
+	unsigned long dwWr=0,dwRd=0;
+
+#ifdef EPDFB_DC_NEON//[
+	if(iUseNeon && I_dw4BitsBufSize>=16 && I_dw8BitsBufSize>=32) {
+		dwRd = I_dw4BitsBufSize;
+		if(dwRd>I_dw8BitsBufSize>>1) {
+			dwRd = I_dw8BitsBufSize>>1;
+		}
+		dwRd &= ~15;
+		dwWr = dwRd<<1;
+		kernel_neon_begin();
+		epdfb_neon_gray4to8(I_pb4BitsSrc,IO_pb8BitsBuf,dwRd,iIsPixelSwap);
+		kernel_neon_end();
+	}
+#endif //] EPDFB_DC_NEON
 	
-	for(dwWr=0,dwRd=0;dwRd<I_dw4BitsBufSize;dwRd++)
+	for(;dwRd<I_dw4BitsBufSize;dwRd++)
 	{
 		if(iIsPixelSwap) {
 			if(dwWr>=I_dw8BitsBufSize) {
@@ -244,6 +340,119 @@ static void _fb_gray_4to8(
 	}
 }
 
+#ifdef EPDFB_DC_NEON//[
+// odd on purpose , so every converter also runs its C tail .
+#define EPDFB_SELFTEST_LEN	47
+
+//
+// run every converter with and without NEON over the same pseudo random
+// data and compare the results bit for bit .
+// return 1 if the NEON converters can be used .
+//
+static int _epdfbdc_neon_selftest(void)
+{
+	unsigned char bSrcA[EPDFB_SELFTEST_LEN*4];
+	unsigned char bRefA[EPDFB_SELFTEST_LEN*4];
+	unsigned char bOutA[EPDFB_SELFTEST_LEN*4];
+	unsigned long dwSeed = 0x15a815a8;
+	const char *pszFailed = 0;
+	int i,iSwap;
+
+	for(i=0;i<sizeof(bSrcA);i++) {
+		dwSeed = dwSeed*1103515245+12345;
+		bSrcA[i] = (unsigned char)(dwSeed>>16);
+	}
+
+	for(iSwap=0;iSwap<2&&!pszFailed;iSwap++) {
+		memset(bRefA,0,sizeof(bRefA));memset(bOutA,0,sizeof(bOutA));
+		_fb_Gray4toRGB565_ex(bRefA,sizeof(bRefA),bSrcA,EPDFB_SELFTEST_LEN,iSwap,0);
+		_fb_Gray4toRGB565_ex(bOutA,sizeof(bOutA),bSrcA,EPDFB_SELFTEST_LEN,iSwap,1);
+		if(memcmp(bRefA,bOutA,sizeof(bOutA))) {
+			pszFailed = "Gray4toRGB565";
+			break;
+		}
+
+		memset(bRefA,0,sizeof(bRefA));memset(bOutA,0,sizeof(bOutA));
+		_fb_gray_4to8_ex(bRefA,EPDFB_SELFTEST_LEN*2,bSrcA,EPDFB_SELFTEST_LEN,iSwap,0);
+		_fb_gray_4to8_ex(bOutA,EPDFB_SELFTEST_LEN*2,bSrcA,EPDFB_SELFTEST_LEN,iSwap,1);
+		if(memcmp(bRefA,bOutA,sizeof(bOutA))) {
+			pszFailed = "gray_4to8";
+			break;
+		}
+
+		memset(bRefA,0,sizeof(bRefA));memset(bOutA,0,sizeof(bOutA));
+		_fb_RGB565toGray4_ex(bRefA,EPDFB_SELFTEST_LEN,bSrcA,sizeof(bSrcA),iSwap,0);
+		_fb_RGB565toGray4_ex(bOutA,EPDFB_SELFTEST_LEN,bSrcA,sizeof(bSrcA),iSwap,1);
+		if(memcmp(bRefA,bOutA,sizeof(bOutA))) {
+			pszFailed = "RGB565toGray4";
+			break;
+		}
+	}
+
+	if(!pszFailed) {
+		memset(bRefA,0,sizeof(bRefA));memset(bOutA,0,sizeof(bOutA));
+		_fb_Gray8toRGB565_ex(bRefA,EPDFB_SELFTEST_LEN*2,bSrcA,EPDFB_SELFTEST_LEN*2,0);
+		_fb_Gray8toRGB565_ex(bOutA,EPDFB_SELFTEST_LEN*2,bSrcA,EPDFB_SELFTEST_LEN*2,1);
+		if(memcmp(bRefA,bOutA,sizeof(bOutA))) {
+			pszFailed = "Gray8toRGB565";
+		}
+	}
+
+	if(!pszFailed) {
+		memcpy(bRefA,bSrcA,sizeof(bSrcA));memcpy(bOutA,bSrcA,sizeof(bSrcA));
+		_fb_gray_8to4_ex(bRefA,sizeof(bRefA)-1,0);
+		_fb_gray_8to4_ex(bOutA,sizeof(bOutA)-1,1);
+		if(memcmp(bRefA,bOutA,sizeof(bOutA))) {
+			pszFailed = "gray_8to4";
+		}
+	}
+
+	if(pszFailed) {
+		ERR_MSG("%s(%d):NEON %s mismatch(swap=%d) , using C converters \n",\
+			__FUNCTION__,__LINE__,pszFailed,iSwap);
+		return 0;
+	}
+	return 1;
+}
+#endif //] EPDFB_DC_NEON
+
+static void _fb_gray_8to4(unsigned char *data, unsigned long len)
+{
+	_fb_gray_8to4_ex(data,len,EPDFB_NEON_CONV());
+}
+
+static void _fb_Gray4toRGB565(
+	unsigned char *IO_pbRGB565Buf,unsigned long I_dwRGB565BufSize,
+	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap)
+{
+	_fb_Gray4toRGB565_ex(IO_pbRGB565Buf,I_dwRGB565BufSize,
+		I_pb4BitsSrc,I_dw4BitsBufSize,iIsPixelSwap,EPDFB_NEON_CONV());
+}
+
+static void _fb_Gray8toRGB565(
+	unsigned char *IO_pbRGB565Buf,unsigned long I_dwRGB565BufSize,
+	unsigned char *I_pb8BitsSrc,unsigned long I_dw8BitsBufSize)
+{
+	_fb_Gray8toRGB565_ex(IO_pbRGB565Buf,I_dwRGB565BufSize,
+		I_pb8BitsSrc,I_dw8BitsBufSize,EPDFB_NEON_CONV());
+}
+
+static void _fb_RGB565toGray4(
+	unsigned char *IO_pbGray4Buf,unsigned long I_dwGray4BufSize,
+	unsigned char *I_pbRGB565Buf,unsigned long I_dwRGB565BufSize,int iIsPixelSwap)
+{
+	_fb_RGB565toGray4_ex(IO_pbGray4Buf,I_dwGray4BufSize,
+		I_pbRGB565Buf,I_dwRGB565BufSize,iIsPixelSwap,EPDFB_NEON_CONV());
+}
+
+static void _fb_gray_4to8(
+	unsigned char *IO_pb8BitsBuf,unsigned long I_dw8BitsBufSize,
+	unsigned char *I_pb4BitsSrc,unsigned long I_dw4BitsBufSize,int iIsPixelSwap)
+{
+	_fb_gray_4to8_ex(IO_pb8BitsBuf,I_dw8BitsBufSize,
+		I_pb4BitsSrc,I_dw4BitsBufSize,iIsPixelSwap,EPDFB_NEON_CONV());
+}
+
 EPDFB_DC *epdfbdc_create_ex2(unsigned long dwFBW,unsigned long dwFBH,\
 	unsigned long dwW,unsigned long dwH,\
 	unsigned char bPixelBits,unsigned char *pbDCbuf,unsigned long dwCreateFlag)
@@ -914,6 +1123,319 @@ static inline void _epdfbdc_set_pixel(EPDFB_DC *pEPD_dc,
 }
 
 
+/*
+ * Block blitter for epdfbdc_put_dcimg().
+ *
+ * Rows are unpacked into 8 bits per pixel, rotated as 16x16 tiles for
+ * 90/270 degrees, then packed into the destination format. The row
+ * unpacker, packer and rotation are picked once per call, so the inner
+ * loops have no per-pixel format or rotation branches. Only 4 and 8
+ * bits per pixel are handled here; anything else, and puts that get
+ * clipped by the DC, use the per-pixel path.
+ */
+#define EPDFB_TILE		16
+#define EPDFB_LINE_CHUNK	64
+
+typedef void (*fnUnpackRow)(const unsigned char *pbRow,unsigned long dwX,
+	unsigned char *pbOut,unsigned long dwN);
+typedef void (*fnPackRow)(unsigned char *pbRow,unsigned long dwX,
+	const unsigned char *pbIn,unsigned long dwN);
+
+// even pixel in low nibble .
+static void _epdfbdc_unpack_row4(const unsigned char *pbRow,unsigned long dwX,
+	unsigned char *pbOut,unsigned long dwN)
+{
+	unsigned long i;
+
+	for(i=0;i<dwN;i++,dwX++) {
+		unsigned char b = pbRow[dwX>>1];
+		pbOut[i] = (dwX&1)?(b&0xf0):(unsigned char)(b<<4);
+	}
+}
+
+// even pixel in high nibble (EPDFB_DC_FLAG_REVERSEINPDATA) .
+static void _epdfbdc_unpack_row4r(const unsigned char *pbRow,unsigned long dwX,
+	unsigned char *pbOut,unsigned long dwN)
+{
+	unsigned long i;
+
+	for(i=0;i<dwN;i++,dwX++) {
+		unsigned char b = pbRow[dwX>>1];
+		pbOut[i] = (dwX&1)?(unsigned char)(b<<4):(b&0xf0);
+	}
+}
+
+static void _epdfbdc_unpack_row8(const unsigned char *pbRow,unsigned long dwX,
+	unsigned char *pbOut,unsigned long dwN)
+{
+	my_memcpy(pbOut,pbRow+dwX,dwN);
+}
+
+// even pixel in high nibble .
+static void _epdfbdc_pack_row4(unsigned char *pbRow,unsigned long dwX,
+	const unsigned char *pbIn,unsigned long dwN)
+{
+	unsigned char *pb = pbRow+(dwX>>1);
+
+	if(dwN && (dwX&1)) {
+		*pb = (*pb&0xf0)|(*pbIn++>>4);
+		pb++;dwN--;
+	}
+	for(;dwN>=2;dwN-=2,pbIn+=2) {
+		*pb++ = (pbIn[0]&0xf0)|(pbIn[1]>>4);
+	}
+	if(dwN) {
+		*pb = (*pb&0x0f)|(pbIn[0]&0xf0);
+	}
+}
+
+// even pixel in low nibble (EPDFB_DC_FLAG_REVERSEDRVDATA) .
+static void _epdfbdc_pack_row4r(unsigned char *pbRow,unsigned long dwX,
+	const unsigned char *pbIn,unsigned long dwN)
+{
+	unsigned char *pb = pbRow+(dwX>>1);
+
+	if(dwN && (dwX&1)) {
+		*pb = (*pb&0x0f)|(*pbIn++&0xf0);
+		pb++;dwN--;
+	}
+	for(;dwN>=2;dwN-=2,pbIn+=2) {
+		*pb++ = (pbIn[0]>>4)|(pbIn[1]&0xf0);
+	}
+	if(dwN) {
+		*pb = (*pb&0xf0)|(pbIn[0]>>4);
+	}
+}
+
+static void _epdfbdc_pack_row8(unsigned char *pbRow,unsigned long dwX,
+	const unsigned char *pbIn,unsigned long dwN)
+{
+	my_memcpy(pbRow+dwX,pbIn,dwN);
+}
+
+static void _epdfbdc_transpose16(const unsigned char *pbSrc,
+	unsigned char *pbDest,int iUseNeon)
+{
+	int i,j;
+
+#ifdef EPDFB_DC_NEON
+	if(iUseNeon) {
+		epdfb_neon_transpose16(pbSrc,EPDFB_TILE,pbDest,EPDFB_TILE);
+		return ;
+	}
+#endif
+	for(i=0;i<EPDFB_TILE;i++) {
+		for(j=0;j<EPDFB_TILE;j++) {
+			pbDest[j*EPDFB_TILE+i] = pbSrc[i*EPDFB_TILE+j];
+		}
+	}
+}
+
+static int _epdfbdc_put_dcimg_blocks(EPDFB_DC *pEPD_dc,
+	EPDFB_DC *pEPD_dcimg,EPDFB_ROTATE_T tRotateDegree,
+	unsigned long I_dwDCimgX,unsigned long I_dwDCimgY,
+	unsigned long I_dwDCimgW,unsigned long I_dwDCimgH,
+	unsigned long I_dwDCPutX,unsigned long I_dwDCPutY)
+{
+	fnUnpackRow pfnUnpack;
+	fnPackRow pfnPack;
+	unsigned char *pbSrc = (unsigned char *)pEPD_dcimg->pbDCbuf;
+	unsigned char *pbDest = (unsigned char *)pEPD_dc->pbDCbuf;
+	unsigned long dwSrcWB = pEPD_dcimg->dwDCWidthBytes;
+	unsigned long dwDestWB = pEPD_dc->dwDCWidthBytes;
+	long lDCW = (long)(pEPD_dc->dwWidth + pEPD_dc->dwFBWExtra);
+	long lDCH = (long)(pEPD_dc->dwHeight + pEPD_dc->dwFBHExtra);
+	long lW0,lW1,lH = (long)I_dwDCimgH;
+	long lX0,lX1,lY0,lY1; // destination bounding box .
+	long lE;
+	unsigned long h,w,n,i;
+	int iUseNeon = 0;
+
+	if(4!=pEPD_dcimg->bPixelBits && 8!=pEPD_dcimg->bPixelBits) {
+		return 0;
+	}
+	if(4!=pEPD_dc->bPixelBits && 8!=pEPD_dc->bPixelBits) {
+		return 0;
+	}
+
+	// skipped edge pixels are simply not part of the blit .
+	lW0 = (pEPD_dc->dwFlags&EPDFB_DC_FLAG_SKIPLEFTPIXEL)?1:0;
+	lW1 = (long)I_dwDCimgW;
+	if((pEPD_dc->dwFlags&EPDFB_DC_FLAG_SKIPRIGHTPIXEL) && lW1>0) {
+		lW1--;
+	}
+	if(lW1<=lW0 || lH<=0) {
+		return 0;
+	}
+
+	if(I_dwDCimgX+I_dwDCimgW > pEPD_dcimg->dwWidth+pEPD_dcimg->dwFBWExtra ||
+		(I_dwDCimgY+I_dwDCimgH)*dwSrcWB > pEPD_dcimg->dwDCSize)
+	{
+		return 0;
+	}
+
+	switch(tRotateDegree) {
+	case EPDFB_R_0:
+		lX0 = (long)I_dwDCPutX+lW0;lX1 = (long)I_dwDCPutX+lW1-1;
+		lY0 = (long)I_dwDCPutY;lY1 = (long)I_dwDCPutY+lH-1;
+		break;
+	case EPDFB_R_90:
+		lE = lDCW-1-(long)I_dwDCPutY-(long)pEPD_dc->dwFBWExtra;
+		lX0 = lE-(lH-1);lX1 = lE;
+		lY0 = (long)I_dwDCPutX+lW0;lY1 = (long)I_dwDCPutX+lW1-1;
+		break;
+	case EPDFB_R_180:
+		lE = lDCW-1-(long)I_dwDCPutX-(long)pEPD_dc->dwFBWExtra;
+		lX0 = lE-(lW1-1);lX1 = lE-lW0;
+		lE = lDCH-1-(long)I_dwDCPutY-(long)pEPD_dc->dwFBHExtra;
+		lY0 = lE-(lH-1);lY1 = lE;
+		break;
+	case EPDFB_R_270:
+		lX0 = (long)I_dwDCPutY;lX1 = (long)I_dwDCPutY+lH-1;
+		lE = lDCH-1-(long)I_dwDCPutX-(long)pEPD_dc->dwFBHExtra;
+		lY0 = lE-(lW1-1);lY1 = lE-lW0;
+		break;
+	default:
+		return 0;
+	}
+	if(lX0<0 || lY0<0 || lX1>=lDCW || lY1>=lDCH) {
+		return 0;
+	}
+
+	if(4==pEPD_dcimg->bPixelBits) {
+		pfnUnpack = (pEPD_dcimg->dwFlags&EPDFB_DC_FLAG_REVERSEINPDATA)?
+			_epdfbdc_unpack_row4r:_epdfbdc_unpack_row4;
+	}
+	else {
+		pfnUnpack = _epdfbdc_unpack_row8;
+	}
+	if(4==pEPD_dc->bPixelBits) {
+		pfnPack = (pEPD_dc->dwFlags&EPDFB_DC_FLAG_REVERSEDRVDATA)?
+			_epdfbdc_pack_row4r:_epdfbdc_pack_row4;
+	}
+	else {
+		pfnPack = _epdfbdc_pack_row8;
+	}
+
+	switch(tRotateDegree) {
+	case EPDFB_R_0:
+		pEPD_dc->dwDirtyOffsetStart = I_dwDCimgY*dwDestWB;
+		pEPD_dc->dwDirtyOffsetEnd = (I_dwDCimgY+I_dwDCimgH)*dwDestWB;
+		break;
+	case EPDFB_R_90:
+		pEPD_dc->dwDirtyOffsetStart = I_dwDCimgX*dwDestWB;
+		pEPD_dc->dwDirtyOffsetEnd = (I_dwDCimgX+I_dwDCimgW)*dwDestWB;
+		break;
+	case EPDFB_R_180:
+		pEPD_dc->dwDirtyOffsetStart = (lDCH-I_dwDCimgY-I_dwDCimgH)*dwDestWB;
+		pEPD_dc->dwDirtyOffsetEnd = (lDCH-I_dwDCimgY)*dwDestWB;
+		break;
+	case EPDFB_R_270:
+		pEPD_dc->dwDirtyOffsetStart = (lDCH-I_dwDCimgX-I_dwDCimgW)*dwDestWB;
+		pEPD_dc->dwDirtyOffsetEnd = (lDCH-I_dwDCimgX)*dwDestWB;
+		break;
+	}
+
+	if(EPDFB_R_0==tRotateDegree || EPDFB_R_180==tRotateDegree) {
+		unsigned char bLine[EPDFB_LINE_CHUNK],bTmp;
+		long lDestX,lDestY;
+
+		for(h=0;h<(unsigned long)lH;h++) {
+			const unsigned char *pbS = pbSrc+(I_dwDCimgY+h)*dwSrcWB;
+
+			if(EPDFB_R_0==tRotateDegree) {
+				lDestY = (long)I_dwDCPutY+h;
+			}
+			else {
+				lDestY = lY1-h;
+			}
+			for(w=lW0;w<(unsigned long)lW1;w+=n) {
+				n = lW1-w;
+				if(n>EPDFB_LINE_CHUNK) {
+					n = EPDFB_LINE_CHUNK;
+				}
+				pfnUnpack(pbS,I_dwDCimgX+w,bLine,n);
+				if(EPDFB_R_0==tRotateDegree) {
+					lDestX = (long)I_dwDCPutX+w;
+				}
+				else {
+					// mirrored : reverse the chunk .
+					for(i=0;i<n/2;i++) {
+						bTmp = bLine[i];
+						bLine[i] = bLine[n-1-i];
+						bLine[n-1-i] = bTmp;
+					}
+					lDestX = lX1-(long)(w-lW0)-(long)(n-1);
+				}
+				pfnPack(pbDest+lDestY*dwDestWB,lDestX,bLine,n);
+			}
+		}
+		return 1;
+	}
+
+#ifdef EPDFB_DC_NEON
+	iUseNeon = cpu_has_neon();
+	if(iUseNeon) {
+		kernel_neon_begin();
+	}
+#endif
+
+	{
+		unsigned char bTile[EPDFB_TILE*EPDFB_TILE];
+		unsigned char bRot[EPDFB_TILE*EPDFB_TILE];
+		unsigned long th,tw,j;
+
+		for(h=0;h<(unsigned long)lH;h+=EPDFB_TILE) {
+			th = lH-h;
+			if(th>EPDFB_TILE) {
+				th = EPDFB_TILE;
+			}
+			for(w=lW0;w<(unsigned long)lW1;w+=EPDFB_TILE) {
+				tw = lW1-w;
+				if(tw>EPDFB_TILE) {
+					tw = EPDFB_TILE;
+				}
+
+				/*
+				 * 90 degrees turns source rows into destination columns
+				 * with x decreasing, so load the rows bottom up and a
+				 * plain transpose gives destination order .
+				 */
+				for(i=0;i<th;i++) {
+					unsigned long dwRow = (EPDFB_R_90==tRotateDegree)?(th-1-i):i;
+					pfnUnpack(pbSrc+(I_dwDCimgY+h+dwRow)*dwSrcWB,I_dwDCimgX+w,
+						bTile+i*EPDFB_TILE,tw);
+				}
+				_epdfbdc_transpose16(bTile,bRot,iUseNeon);
+
+				// row j of bRot is source column w+j .
+				for(j=0;j<tw;j++) {
+					long lDestX,lDestY;
+
+					if(EPDFB_R_90==tRotateDegree) {
+						lDestX = lX1-(long)h-(long)(th-1);
+						lDestY = (long)I_dwDCPutX+w+j;
+					}
+					else {
+						lDestX = (long)I_dwDCPutY+h;
+						lDestY = lY1-(long)(w+j-lW0);
+					}
+					pfnPack(pbDest+lDestY*dwDestWB,lDestX,bRot+j*EPDFB_TILE,th);
+				}
+			}
+		}
+	}
+
+#ifdef EPDFB_DC_NEON
+	if(iUseNeon) {
+		kernel_neon_end();
+	}
+#endif
+
+	return 1;
+}
+
+
 //
 #define GETIMG_PIXEL_METHOD		2
 
@@ -995,6 +1517,13 @@ EPDFB_DC_RET epdfbdc_put_dcimg(EPDFB_DC *pEPD_dc,
 		dwEPD_dc_flags,pEPD_dcimg->dwWidth,pEPD_dcimg->dwHeight,I_dwDCimgW,I_dwDCimgH,pEPD_dcimg->bPixelBits,pEPD_dc->bPixelBits);
 	DBG_MSG("IMG_Wbytes=%u,DC_Wbytes=%u\n",dwImgWidthBytes,dwDCWidthBytes);
 
+	if(_epdfbdc_put_dcimg_blocks(pEPD_dc,pEPD_dcimg,tRotateDegree,
+		I_dwDCimgX,I_dwDCimgY,I_dwDCimgW,I_dwDCimgH,I_dwDCPutX,I_dwDCPutY))
+	{
+		GALLEN_DBGLOCAL_END();
+		return tRet;
+	}
+
 	switch(tRotateDegree) {
 	case EPDFB_R_0:GALLEN_DBGLOCAL_RUNLOG(2);
 		// left->right,up->down .
@@ -1273,6 +1802,100 @@ EPDFB_DC_RET epdfbdc_get_rotate_active(EPDFB_DC *I_pEPD_dc,
 }
 
 
+//
+// unpack an image into a 8 bits gray buffer (I_dwStride bytes per row) ,
+// starting at image column I_dwSkipX . input pixel order follows the
+// DC flags the same way epdfbdc_put_fbimg() does .
+// used to feed image data to the PXP , which has no 4 bits input format .
+//
+EPDFB_DC_RET epdfbdc_fbimg_to_gray8(EPDFB_DC *I_pEPD_dc,EPDFB_IMG *I_pEPD_img,
+	unsigned long I_dwSkipX,unsigned long I_dwW,
+	unsigned char *O_pbGray8,unsigned long I_dwStride)
+{
+	fnUnpackRow pfnUnpack;
+	unsigned long dwImgWB,h;
+
+	if(!CHK_EPDFB_DC(I_pEPD_dc)) {
+		ERR_MSG("%s(%d): object handle error !\n",__FUNCTION__,__LINE__);
+		return EPDFB_DC_OBJECTERR;
+	}
+
+	if(!(I_pEPD_img&&O_pbGray8) || I_dwSkipX+I_dwW>I_pEPD_img->dwW ||
+		I_dwW>I_dwStride)
+	{
+		return EPDFB_DC_PARAMERR;
+	}
+
+	if(4==I_pEPD_img->bPixelBits) {
+		pfnUnpack = (I_pEPD_dc->dwFlags&EPDFB_DC_FLAG_REVERSEINPDATA)?
+			_epdfbdc_unpack_row4r:_epdfbdc_unpack_row4;
+	}
+	else if(8==I_pEPD_img->bPixelBits) {
+		pfnUnpack = _epdfbdc_unpack_row8;
+	}
+	else {
+		return EPDFB_DC_PIXELBITSNOTSUPPORT;
+	}
+
+	// same row pitch as epdfbdc_create_ex2() gives the image dc .
+	dwImgWB = (I_pEPD_img->dwW*I_pEPD_img->bPixelBits+7)>>3;
+	for(h=0;h<I_pEPD_img->dwH;h++) {
+		pfnUnpack(I_pEPD_img->pbImgBuf+h*dwImgWB,I_dwSkipX,
+			O_pbGray8+h*I_dwStride,I_dwW);
+	}
+
+	return EPDFB_DC_SUCCESS;
+}
+
+//
+// pack an already rotated 8 bits gray block into the DC at DC
+// coordinates (I_dwX,I_dwY) , the counterpart of epdfbdc_fbimg_to_gray8() .
+//
+EPDFB_DC_RET epdfbdc_put_gray8(EPDFB_DC *I_pEPD_dc,
+	const unsigned char *I_pbGray8,unsigned long I_dwStride,
+	unsigned long I_dwX,unsigned long I_dwY,
+	unsigned long I_dwW,unsigned long I_dwH)
+{
+	fnPackRow pfnPack;
+	unsigned char *pbDest;
+	unsigned long dwDestWB,dwDCW,dwDCH,h;
+
+	if(!CHK_EPDFB_DC(I_pEPD_dc)) {
+		ERR_MSG("%s(%d): object handle error !\n",__FUNCTION__,__LINE__);
+		return EPDFB_DC_OBJECTERR;
+	}
+
+	dwDCW = I_pEPD_dc->dwWidth+I_pEPD_dc->dwFBWExtra;
+	dwDCH = I_pEPD_dc->dwHeight+I_pEPD_dc->dwFBHExtra;
+	if(!I_pbGray8 || I_dwX>=dwDCW || I_dwW>dwDCW-I_dwX ||
+		I_dwY>=dwDCH || I_dwH>dwDCH-I_dwY)
+	{
+		return EPDFB_DC_PARAMERR;
+	}
+
+	if(4==I_pEPD_dc->bPixelBits) {
+		pfnPack = (I_pEPD_dc->dwFlags&EPDFB_DC_FLAG_REVERSEDRVDATA)?
+			_epdfbdc_pack_row4r:_epdfbdc_pack_row4;
+	}
+	else if(8==I_pEPD_dc->bPixelBits) {
+		pfnPack = _epdfbdc_pack_row8;
+	}
+	else {
+		return EPDFB_DC_PIXELBITSNOTSUPPORT;
+	}
+
+	pbDest = (unsigned char *)I_pEPD_dc->pbDCbuf;
+	dwDestWB = I_pEPD_dc->dwDCWidthBytes;
+	for(h=0;h<I_dwH;h++) {
+		pfnPack(pbDest+(I_dwY+h)*dwDestWB,I_dwX,I_pbGray8+h*I_dwStride,I_dwW);
+	}
+
+	I_pEPD_dc->dwDirtyOffsetStart = I_dwY*dwDestWB;
+	I_pEPD_dc->dwDirtyOffsetEnd = (I_dwY+I_dwH)*dwDestWB;
+
+	return EPDFB_DC_SUCCESS;
+}
+
 EPDFB_DC_RET epdfbdc_set_pixel(EPDFB_DC *I_pEPD_dc,\
 	unsigned long I_dwX,unsigned long I_dwY,unsigned long I_dwPVal)
 {
@@ -165,6 +165,15 @@ EPDFB_DC_RET epdfbdc_get_rotate_active(EPDFB_DC *I_pEPD_dc,
 	unsigned long *IO_pdwX,unsigned long *IO_pdwY,
 	unsigned long *IO_pdwW,unsigned long *IO_pdwH,
 	EPDFB_ROTATE_T I_tRotate);
+
+EPDFB_DC_RET epdfbdc_fbimg_to_gray8(EPDFB_DC *I_pEPD_dc,EPDFB_IMG *I_pEPD_img,
+	unsigned long I_dwSkipX,unsigned long I_dwW,
+	unsigned char *O_pbGray8,unsigned long I_dwStride);
+
+EPDFB_DC_RET epdfbdc_put_gray8(EPDFB_DC *I_pEPD_dc,
+	const unsigned char *I_pbGray8,unsigned long I_dwStride,
+	unsigned long I_dwX,unsigned long I_dwY,
+	unsigned long I_dwW,unsigned long I_dwH);
 	
 
 #endif //]__epdfb_dc_h
@@ -0,0 +1,168 @@
+#include "epdfb_dc_neon.h"
+
+#undef __STDC_HOSTED__
+#include <arm_neon.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/*
+ * 8x8 byte transpose in three vtrn stages (bytes, halfwords, words).
+ */
+static inline void epdfb_neon_transpose8(const unsigned char *src,
+	int src_stride, unsigned char *dst, int dst_stride)
+{
+	uint8x8x2_t t01, t23, t45, t67;
+	uint16x4x2_t u02, u13, u46, u57;
+	uint32x2x2_t v04, v15, v26, v37;
+
+	t01 = vtrn_u8(vld1_u8(src), vld1_u8(src + src_stride));
+	t23 = vtrn_u8(vld1_u8(src + 2 * src_stride),
+		      vld1_u8(src + 3 * src_stride));
+	t45 = vtrn_u8(vld1_u8(src + 4 * src_stride),
+		      vld1_u8(src + 5 * src_stride));
+	t67 = vtrn_u8(vld1_u8(src + 6 * src_stride),
+		      vld1_u8(src + 7 * src_stride));
+
+	u02 = vtrn_u16(vreinterpret_u16_u8(t01.val[0]),
+		       vreinterpret_u16_u8(t23.val[0]));
+	u13 = vtrn_u16(vreinterpret_u16_u8(t01.val[1]),
+		       vreinterpret_u16_u8(t23.val[1]));
+	u46 = vtrn_u16(vreinterpret_u16_u8(t45.val[0]),
+		       vreinterpret_u16_u8(t67.val[0]));
+	u57 = vtrn_u16(vreinterpret_u16_u8(t45.val[1]),
+		       vreinterpret_u16_u8(t67.val[1]));
+
+	v04 = vtrn_u32(vreinterpret_u32_u16(u02.val[0]),
+		       vreinterpret_u32_u16(u46.val[0]));
+	v15 = vtrn_u32(vreinterpret_u32_u16(u13.val[0]),
+		       vreinterpret_u32_u16(u57.val[0]));
+	v26 = vtrn_u32(vreinterpret_u32_u16(u02.val[1]),
+		       vreinterpret_u32_u16(u46.val[1]));
+	v37 = vtrn_u32(vreinterpret_u32_u16(u13.val[1]),
+		       vreinterpret_u32_u16(u57.val[1]));
+
+	vst1_u8(dst, vreinterpret_u8_u32(v04.val[0]));
+	vst1_u8(dst + dst_stride, vreinterpret_u8_u32(v15.val[0]));
+	vst1_u8(dst + 2 * dst_stride, vreinterpret_u8_u32(v26.val[0]));
+	vst1_u8(dst + 3 * dst_stride, vreinterpret_u8_u32(v37.val[0]));
+	vst1_u8(dst + 4 * dst_stride, vreinterpret_u8_u32(v04.val[1]));
+	vst1_u8(dst + 5 * dst_stride, vreinterpret_u8_u32(v15.val[1]));
+	vst1_u8(dst + 6 * dst_stride, vreinterpret_u8_u32(v26.val[1]));
+	vst1_u8(dst + 7 * dst_stride, vreinterpret_u8_u32(v37.val[1]));
+}
+
+void epdfb_neon_transpose16(const unsigned char *src, int src_stride,
+	unsigned char *dst, int dst_stride)
+{
+	epdfb_neon_transpose8(src, src_stride, dst, dst_stride);
+	epdfb_neon_transpose8(src + 8, src_stride,
+		dst + 8 * dst_stride, dst_stride);
+	epdfb_neon_transpose8(src + 8 * src_stride, src_stride,
+		dst + 8, dst_stride);
+	epdfb_neon_transpose8(src + 8 * src_stride + 8, src_stride,
+		dst + 8 * dst_stride + 8, dst_stride);
+}
+
+/*
+ * Pixel format converters. Each one handles whole vectors only, the
+ * caller converts the remainder with the C code.
+ */
+
+/* n output bytes (multiple of 16), two 8 bit pixels per output byte */
+void epdfb_neon_gray8to4(const unsigned char *src, unsigned char *dst,
+	unsigned long n)
+{
+	const uint8x16_t hi_mask = vdupq_n_u8(0xf0);
+	uint8x16x2_t v;
+
+	for (; n; n -= 16, src += 32, dst += 16) {
+		v = vld2q_u8(src);
+		vst1q_u8(dst, vorrq_u8(vandq_u8(v.val[0], hi_mask),
+				       vshrq_n_u8(v.val[1], 4)));
+	}
+}
+
+/* n source bytes (multiple of 16), two 8 bit pixels per source byte */
+void epdfb_neon_gray4to8(const unsigned char *src, unsigned char *dst,
+	unsigned long n, int swap)
+{
+	const uint8x16_t hi_mask = vdupq_n_u8(0xf0);
+	uint8x16_t v;
+	uint8x16x2_t out;
+
+	for (; n; n -= 16, src += 16, dst += 32) {
+		v = vld1q_u8(src);
+		out.val[swap ? 1 : 0] = vandq_u8(v, hi_mask);
+		out.val[swap ? 0 : 1] = vshlq_n_u8(v, 4);
+		vst2q_u8(dst, out);
+	}
+}
+
+/* n source bytes (multiple of 8), looked up in a 16 entry RGB565 table */
+void epdfb_neon_gray4_to_rgb565(const unsigned char *src, unsigned char *dst,
+	unsigned long n, const unsigned short *table, int swap)
+{
+	const uint8x8_t lo_mask = vdup_n_u8(0x0f);
+	uint8x16x2_t t = vld2q_u8((const unsigned char *)table);
+	uint8x8x2_t tlo, thi;
+	uint8x8_t v, dot1, dot2;
+	uint8x8x4_t out;
+
+	/* little endian: val[0] holds the low bytes of the table */
+	tlo.val[0] = vget_low_u8(t.val[0]);
+	tlo.val[1] = vget_high_u8(t.val[0]);
+	thi.val[0] = vget_low_u8(t.val[1]);
+	thi.val[1] = vget_high_u8(t.val[1]);
+
+	for (; n; n -= 8, src += 8, dst += 32) {
+		v = vld1_u8(src);
+		if (swap) {
+			dot1 = vshr_n_u8(v, 4);
+			dot2 = vand_u8(v, lo_mask);
+		} else {
+			dot1 = vand_u8(v, lo_mask);
+			dot2 = vshr_n_u8(v, 4);
+		}
+		out.val[0] = vtbl2_u8(tlo, dot1);
+		out.val[1] = vtbl2_u8(thi, dot1);
+		out.val[2] = vtbl2_u8(tlo, dot2);
+		out.val[3] = vtbl2_u8(thi, dot2);
+		vst4_u8(dst, out);
+	}
+}
+
+/* n source pixels (multiple of 16), gray value goes to the high byte */
+void epdfb_neon_gray8_to_rgb565(const unsigned char *src, unsigned char *dst,
+	unsigned long n)
+{
+	uint8x16x2_t out;
+
+	out.val[0] = vdupq_n_u8(0);
+	for (; n; n -= 16, src += 16, dst += 32) {
+		out.val[1] = vld1q_u8(src);
+		vst2q_u8(dst, out);
+	}
+}
+
+/* n output bytes (multiple of 8), top nibble of two RGB565 pixels each */
+void epdfb_neon_rgb565_to_gray4(const unsigned char *src, unsigned char *dst,
+	unsigned long n, int swap)
+{
+	const uint8x8_t hi_mask = vdup_n_u8(0xf0);
+	uint16x8x2_t v;
+	uint8x8_t dot1, dot2;
+
+	for (; n; n -= 8, src += 32, dst += 8) {
+		v = vld2q_u16((const uint16_t *)src);
+		dot1 = vshrn_n_u16(v.val[0], 8);
+		dot2 = vshrn_n_u16(v.val[1], 8);
+		if (swap)
+			vst1_u8(dst, vorr_u8(vand_u8(dot1, hi_mask),
+					     vshr_n_u8(dot2, 4)));
+		else
+			vst1_u8(dst, vorr_u8(vand_u8(dot2, hi_mask),
+					     vshr_n_u8(dot1, 4)));
+	}
+}
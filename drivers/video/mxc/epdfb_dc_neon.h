@@ -0,0 +1,26 @@
+#ifndef __EPDFB_DC_NEON_H__
+#define __EPDFB_DC_NEON_H__
+
+/*
+ * NEON helpers for the epdfb_dc block blitter and pixel converters.
+ * These live in their own compilation unit (built with -mfpu=neon) and
+ * must only be called between kernel_neon_begin() and kernel_neon_end().
+ */
+
+/* Transpose a 16x16 byte tile: dst[j][i] = src[i][j] */
+void epdfb_neon_transpose16(const unsigned char *src, int src_stride,
+	unsigned char *dst, int dst_stride);
+
+/* Pixel format converters, see the _fb_* functions in epdfb_dc.c */
+void epdfb_neon_gray8to4(const unsigned char *src, unsigned char *dst,
+	unsigned long n);
+void epdfb_neon_gray4to8(const unsigned char *src, unsigned char *dst,
+	unsigned long n, int swap);
+void epdfb_neon_gray4_to_rgb565(const unsigned char *src, unsigned char *dst,
+	unsigned long n, const unsigned short *table, int swap);
+void epdfb_neon_gray8_to_rgb565(const unsigned char *src, unsigned char *dst,
+	unsigned long n);
+void epdfb_neon_rgb565_to_gray4(const unsigned char *src, unsigned char *dst,
+	unsigned long n, int swap);
+
+#endif /* __EPDFB_DC_NEON_H__ */
@@ -205,6 +205,12 @@ void lm75_resume(void)
 	}
 }
 
+/* i2c client of the sensor, for drivers that order their resume after it */
+struct device *lm75_device(void)
+{
+	return gpI2C_clientA[0] ? &gpI2C_clientA[0]->dev : NULL;
+}
+
 //EXPORT_SYMBOL(lm75_init);
 //EXPORT_SYMBOL(lm75_release);
 //EXPORT_SYMBOL(lm75_get_temperature);
@@ -26,6 +26,8 @@
 #include <linux/completion.h>
 #include <linux/wait.h>
 #include <linux/semaphore.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "ntx_hwconfig.h"
 
@@ -252,6 +254,36 @@ static const unsigned char gbTPS65185_REG_PG_addr=0x0f;
 static volatile unsigned char gbTPS65185_REG_REVID=0x45; // default is TPS65185 1p0 .
 static const unsigned char gbTPS65185_REG_REVID_addr=0x10;
 
+// registers whose shadow can stand in for the chip : no self clearing
+// command bits and no status bits (ENABLE/VCOM2/TMST1 carry commands) .
+#define TPS65185_REG_CACHEABLE	((1<<0x02)|(1<<0x03)|(1<<0x05)|(1<<0x06)|\
+		(1<<0x09)|(1<<0x0a)|(1<<0x0b)|(1<<0x0c))
+
+// bit n set : shadow of register n matches the chip .
+// the chip drops all register contents in SLEEP mode .
+static unsigned long gdwTPS65185_RegCached;
+
+#define TPS65185_REG_CACHE_HIT(_bAddr,_bVal,_bShadow)	\
+	((TPS65185_REG_CACHEABLE & gdwTPS65185_RegCached & (1<<(_bAddr))) && \
+	 (_bVal)==(_bShadow))
+
+static struct {
+	unsigned long dwXfers;		// i2c transactions issued .
+	unsigned long dwWrites;
+	unsigned long dwReads;
+	unsigned long dwSkipped;	// writes answered by the shadow .
+	unsigned long dwBatches;	// multi-register writes in one transfer .
+	unsigned long dwPwrups;		// mode requests into active/standby .
+	unsigned long dwPwrupXfers;
+	unsigned long dwLastPwrupXfers;
+	unsigned long dwMaxPwrupXfers;
+} gtTPS65185_Stats;
+
+static inline void tps65185_cache_invalidate(void)
+{
+	gdwTPS65185_RegCached = 0;
+}
+
 
 
 static int tps65185_set_reg(unsigned char bRegAddr,unsigned char bRegSetVal)
@@ -284,10 +316,16 @@ static int tps65185_set_reg(unsigned char bRegAddr,unsigned char bRegSetVal)
 	bA[0]=bRegAddr;
 	bA[1]=bRegSetVal;
 	iChk = i2c_master_send(gpI2C_clientA[0], (const char *)bA, sizeof(bA));
+	gtTPS65185_Stats.dwXfers++;
+	gtTPS65185_Stats.dwWrites++;
 	if (iChk < 0) {
 		ERR_MSG("%s(%d):%d=%s(),regAddr=0x%x,regVal=0x%x fail !\n",__FILE__,__LINE__,\
 			iChk,"i2c_master_send",bRegAddr,bRegSetVal);
 		iRet=TPS65185_RET_I2CTRANS_ERR;
+		gdwTPS65185_RegCached &= ~(1<<bRegAddr);
+	}
+	else {
+		gdwTPS65185_RegCached |= (1<<bRegAddr);
 	}
 	up(&gtTPS65185_DataA[0].i2clock);
 	//enable_irq(irq_PG);
@@ -343,6 +381,8 @@ static int tps65185_get_reg(unsigned char bRegAddr,unsigned char  *O_pbRegVal)
 		ERR_MSG("%s(%d):%s i2c_master_recv fail !\n",__FILE__,__LINE__,__FUNCTION__);
 		iRet = TPS65185_RET_I2CTRANS_ERR;
 	}
+	gtTPS65185_Stats.dwXfers+=2;
+	gtTPS65185_Stats.dwReads++;
 
 	if(!in_interrupt()) {
 		up(&gtTPS65185_DataA[0].i2clock);
@@ -352,11 +392,67 @@ static int tps65185_get_reg(unsigned char bRegAddr,unsigned char  *O_pbRegVal)
 
 	if(iRet>=0) {
 		*O_pbRegVal = bA[0];
+		gdwTPS65185_RegCached |= (1<<bRegAddr);
 	}
 
 	return iRet;
 }
 
+// write several (address,value) pairs as one i2c transfer : each pair is
+// its own message behind a repeated start, so the chip sees ordinary
+// single register writes but the bus is taken only once .
+#define TPS65185_BATCH_MAX	8
+static int tps65185_set_regs(const unsigned char (*I_pbRegAddrValA)[2],int iRegs)
+{
+	int iRet=TPS65185_RET_SUCCESS;
+	int iChk;
+	int i;
+	struct i2c_msg tMsgA[TPS65185_BATCH_MAX];
+	unsigned char bBufA[TPS65185_BATCH_MAX][2];
+
+	if(!gpI2C_adapter || !gpI2C_clientA[0]) {
+		WARNING_MSG("%s i2c client null \n",__FUNCTION__);
+		return (TPS65185_RET_PARAMERR);
+	}
+	if(iRegs<=0) {
+		return iRet;
+	}
+	ASSERT(iRegs<=TPS65185_BATCH_MAX);
+
+	for(i=0;i<iRegs;i++) {
+		bBufA[i][0] = I_pbRegAddrValA[i][0];
+		bBufA[i][1] = I_pbRegAddrValA[i][1];
+		tMsgA[i].addr = gpI2C_clientA[0]->addr;
+		tMsgA[i].flags = 0;
+		tMsgA[i].len = 2;
+		tMsgA[i].buf = bBufA[i];
+	}
+
+	down(&gtTPS65185_DataA[0].i2clock);
+	iChk = i2c_transfer(gpI2C_clientA[0]->adapter, tMsgA, iRegs);
+	gtTPS65185_Stats.dwXfers++;
+	gtTPS65185_Stats.dwWrites+=iRegs;
+	if(iRegs>1) {
+		gtTPS65185_Stats.dwBatches++;
+	}
+	if (iChk != iRegs) {
+		ERR_MSG("%s(%d):%d=%s(),%d regs fail !\n",__FILE__,__LINE__,\
+			iChk,"i2c_transfer",iRegs);
+		iRet=TPS65185_RET_I2CTRANS_ERR;
+		for(i=0;i<iRegs;i++) {
+			gdwTPS65185_RegCached &= ~(1<<bBufA[i][0]);
+		}
+	}
+	else {
+		for(i=0;i<iRegs;i++) {
+			gdwTPS65185_RegCached |= (1<<bBufA[i][0]);
+		}
+	}
+	up(&gtTPS65185_DataA[0].i2clock);
+
+	return iRet;
+}
+
 
 #define TPS65185_REG_SET(_regName,_bFieldName,_bSetVal)		\
 ({\
@@ -378,7 +474,14 @@ static int tps65185_get_reg(unsigned char bRegAddr,unsigned char  *O_pbRegVal)
 		}\
 	}\
 	\
-	_iChk = tps65185_set_reg(gbTPS65185_REG_##_regName##_##addr,_bNewReg);\
+	if(TPS65185_REG_CACHE_HIT(gbTPS65185_REG_##_regName##_##addr,\
+			_bNewReg,gbTPS65185_REG_##_regName)) {\
+		gtTPS65185_Stats.dwSkipped++;\
+		_iChk = TPS65185_RET_SUCCESS;\
+	}\
+	else {\
+		_iChk = tps65185_set_reg(gbTPS65185_REG_##_regName##_##addr,_bNewReg);\
+	}\
 	if(_iChk<0) {\
 		_iRet = _iChk;\
 	}\
@@ -390,6 +493,23 @@ static int tps65185_get_reg(unsigned char bRegAddr,unsigned char  *O_pbRegVal)
 	_iRet;\
 })
 
+// queue a whole register value for tps65185_set_regs() unless the shadow
+// already holds it .
+#define TPS65185_REG_QUEUE(_regName,_bSetVal,_pbA,_iCnt)		\
+({\
+	unsigned char _bNewReg=(unsigned char)(_bSetVal);\
+	\
+	if(TPS65185_REG_CACHE_HIT(gbTPS65185_REG_##_regName##_##addr,\
+			_bNewReg,gbTPS65185_REG_##_regName)) {\
+		gtTPS65185_Stats.dwSkipped++;\
+	}\
+	else {\
+		(_pbA)[_iCnt][0] = gbTPS65185_REG_##_regName##_##addr;\
+		(_pbA)[_iCnt][1] = _bNewReg;\
+		(_iCnt)++;\
+	}\
+})
+
 #define TPS65185_REG_GET(_regName)		\
 ({\
 	int _iChk;\
@@ -590,6 +710,7 @@ static void _tps65185_pwrdwn(void)
 
 	if( dwNewMode == TPS65185_MODE_SLEEP) {
 		gpio_direction_output(GPIO_TPS65185_WAKEUP, 0);
+		tps65185_cache_invalidate();
 	}
 
 	gtTPS65185_DataA[0].dwCurrent_mode = dwNewMode;
@@ -790,6 +911,9 @@ static int tps65185_reg_init(int I_iIsEP_3V3_ON)
 {
 	int iRet=TPS65185_RET_SUCCESS;
 	unsigned char bRegVal;
+	unsigned char bRegEnable,bRegIntEn1,bRegIntEn2,bRegDwnSeq0;
+	unsigned char bRegA[4][2];
+	int iRegs=0;
 
 	GALLEN_DBGLOCAL_BEGIN();
 
@@ -798,22 +922,25 @@ static int tps65185_reg_init(int I_iIsEP_3V3_ON)
 	if(I_iIsEP_3V3_ON) {
 		bRegVal |= TPS65185_REG_ENABLE_V3P3_EN;
 	}
-	iRet = TPS65185_REG_SET(ENABLE,ALL,bRegVal);
-	if(iRet<0) goto error;
-
-
-	//bRegVal = 0;
-	bRegVal = 0x7f;
-	iRet = TPS65185_REG_SET(INT_EN1,ALL,bRegVal);
+	bRegEnable = bRegVal;
+	//bRegIntEn1 = 0;
+	bRegIntEn1 = 0x7f;
+	bRegIntEn2 = 0xff;
+	bRegDwnSeq0 = gbTPS65185_REG_DWNSEQ0_default;
+
+	// the whole set goes out in one transfer right after WAKEUP .
+	TPS65185_REG_QUEUE(ENABLE,bRegEnable,bRegA,iRegs);
+	TPS65185_REG_QUEUE(INT_EN1,bRegIntEn1,bRegA,iRegs);
+	TPS65185_REG_QUEUE(INT_EN2,bRegIntEn2,bRegA,iRegs);
+	TPS65185_REG_QUEUE(DWNSEQ0,bRegDwnSeq0,bRegA,iRegs);
+	iRet = tps65185_set_regs((const unsigned char (*)[2])bRegA,iRegs);
 	if(iRet<0) goto error;
 
-	bRegVal = 0xff;
-	iRet = TPS65185_REG_SET(INT_EN2,ALL,bRegVal);
-	if(iRet<0) goto error;
-
-	bRegVal = gbTPS65185_REG_DWNSEQ0_default;
-	iRet = TPS65185_REG_SET(DWNSEQ0,ALL,bRegVal);
-	if(iRet<0) goto error;
+	gbTPS65185_REG_ENABLE = bRegEnable;
+	gbTPS65185_REG_INT_EN1 = bRegIntEn1;
+	gbTPS65185_REG_INT_EN2 = bRegIntEn2;
+	gbTPS65185_REG_DWNSEQ0 = bRegDwnSeq0;
+	DBG_MSG("%s() : tps65185 %d regs written\n",__FUNCTION__,iRegs);
 
 	GALLEN_DBGLOCAL_RUNLOG(0);
 error:
@@ -821,6 +948,64 @@ error:
 	return iRet;
 }
 
+#ifdef CONFIG_DEBUG_FS//[
+static struct dentry *gpTPS65185_debugfs;
+
+static int tps65185_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "xfers:     %lu\n", gtTPS65185_Stats.dwXfers);
+	seq_printf(s, "writes:    %lu\n", gtTPS65185_Stats.dwWrites);
+	seq_printf(s, "reads:     %lu\n", gtTPS65185_Stats.dwReads);
+	seq_printf(s, "skipped:   %lu\n", gtTPS65185_Stats.dwSkipped);
+	seq_printf(s, "batches:   %lu\n", gtTPS65185_Stats.dwBatches);
+	seq_printf(s, "pwrups:    %lu xfers %lu last %lu max %lu\n",
+		gtTPS65185_Stats.dwPwrups, gtTPS65185_Stats.dwPwrupXfers,
+		gtTPS65185_Stats.dwLastPwrupXfers, gtTPS65185_Stats.dwMaxPwrupXfers);
+	seq_printf(s, "cached:    0x%05lx\n",
+		gdwTPS65185_RegCached & TPS65185_REG_CACHEABLE);
+	return 0;
+}
+
+static int tps65185_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tps65185_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters. */
+static ssize_t tps65185_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	memset(&gtTPS65185_Stats, 0, sizeof(gtTPS65185_Stats));
+	return count;
+}
+
+static const struct file_operations tps65185_stats_fops = {
+	.open		= tps65185_stats_open,
+	.read		= seq_read,
+	.write		= tps65185_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tps65185_debugfs_init(void)
+{
+	if(gpTPS65185_debugfs) {
+		return ;
+	}
+	gpTPS65185_debugfs = debugfs_create_file("tps65185", S_IRUSR | S_IWUSR,
+			NULL, NULL, &tps65185_stats_fops);
+}
+
+static void tps65185_debugfs_exit(void)
+{
+	debugfs_remove(gpTPS65185_debugfs);
+	gpTPS65185_debugfs = NULL;
+}
+#else //][!CONFIG_DEBUG_FS
+static inline void tps65185_debugfs_init(void) {}
+static inline void tps65185_debugfs_exit(void) {}
+#endif //]CONFIG_DEBUG_FS
+
 // auto detect tps65185 .
 // parameters :
 // 	iPort : i2c channel in system (from 1~3) .
@@ -965,6 +1150,7 @@ int tps65185_init(int iPort,int iEPDTimingType)
 		return iChk;
 	}
 	*/
+	tps65185_debugfs_init();
 	GALLEN_DBGLOCAL_END();
 	return iRet;
 }
@@ -982,6 +1168,7 @@ int tps65185_release(void)
 	
 	GALLEN_DBGLOCAL_BEGIN();
 	//printk("%s(%d):%s()\n",__FILE__,__LINE__,__FUNCTION__);
+	tps65185_debugfs_exit();
 	for(iChipIdx=0;iChipIdx<TOTAL_CHIPS;iChipIdx++) {
 		if(gpI2C_clientA[iChipIdx]) {
 			i2c_unregister_device(gpI2C_clientA[iChipIdx]);
@@ -1280,13 +1467,36 @@ int tps65185_wait_panel_poweroff(void)
 }
 
 
-int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
+// power up rails are ramping by the chip's own sequencer (PWRUP high) ,
+// PWRGOOD , VCOM and the ACTIVE mode are still to be completed .
+static volatile int giIsTPS65185_PwrupPending=0;
+
+// wait the sequencer out : power good comes by interrupt , then VCOM .
+// chmod_lock must be held .
+static int _tps65185_pwrup_finish(void)
+{
+	int iRet;
+
+	iRet = tps65185_wait_panel_poweron();
+
+	gpio_direction_output(GPIO_TPS65185_VCOMCTRL, 1);
+	msleep(10);
+	//udelay(300);
+	//ERR_MSG(".\n");
+	gtTPS65185_DataA[0].dwCurrent_mode = TPS65185_MODE_ACTIVE;
+	giIsTPS65185_PwrupPending = 0;
+
+	return iRet;
+}
+
+static int _tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff,int iIsWaitPwrOn)
 {
 	int iRet=TPS65185_RET_SUCCESS;
 	int iChk;
 	unsigned long dwCurrent_mode;
 	unsigned long dwNewMode;
 	int iRetryCnt;
+	unsigned long dwXfers;
 	//int irq_INT,irq_PG;
 
 
@@ -1301,6 +1511,11 @@ int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
 	down(&gtTPS65185_DataA[0].chmod_lock);
 	GALLEN_DBGLOCAL_BEGIN();
 
+	// a previous power up left ramping : any new request starts from ACTIVE .
+	if(giIsTPS65185_PwrupPending) {
+		_tps65185_pwrup_finish();
+	}
+
 	dwCurrent_mode = gtTPS65185_DataA[0].dwCurrent_mode;
 	dwNewMode = *IO_pdwMode;
 
@@ -1334,6 +1549,8 @@ int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
 
 	DBG_MSG("%s begin %ld->%ld\n",__FUNCTION__,dwCurrent_mode,dwNewMode);
 
+	dwXfers = gtTPS65185_Stats.dwXfers;
+
 	switch(dwNewMode) {
 	case TPS65185_MODE_ACTIVE:GALLEN_DBGLOCAL_RUNLOG(0);
 		#if 0
@@ -1396,13 +1613,12 @@ int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
 
 		if(iRet>=0) {
 			//ERR_MSG(".");
-			tps65185_wait_panel_poweron();
-
-			gpio_direction_output(GPIO_TPS65185_VCOMCTRL, 1);
-			msleep(10);
-			//udelay(300);
-			//ERR_MSG(".\n");
-			gtTPS65185_DataA[0].dwCurrent_mode = dwNewMode;
+			if(iIsWaitPwrOn) {
+				_tps65185_pwrup_finish();
+			}
+			else {
+				giIsTPS65185_PwrupPending = 1;
+			}
 		}
 
 		break;
@@ -1433,6 +1649,7 @@ int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
 		{
 			gpio_direction_output(GPIO_TPS65185_PWRUP, 0);
 			gpio_direction_output(GPIO_TPS65185_WAKEUP, 0);
+			tps65185_cache_invalidate();
 			gtTPS65185_DataA[0].dwCurrent_mode = dwNewMode;
 		}
 
@@ -1512,6 +1729,16 @@ int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
 	//gtTPS65185_DataA[0].iCurrentPwrupState = iCurrentPwrupState;
 	//gtTPS65185_DataA[0].iCurrentWakeupState = iCurrentWakeupState;
 
+	if(TPS65185_MODE_SLEEP!=dwNewMode) {
+		dwXfers = gtTPS65185_Stats.dwXfers - dwXfers;
+		gtTPS65185_Stats.dwPwrups++;
+		gtTPS65185_Stats.dwPwrupXfers += dwXfers;
+		gtTPS65185_Stats.dwLastPwrupXfers = dwXfers;
+		if(dwXfers>gtTPS65185_Stats.dwMaxPwrupXfers) {
+			gtTPS65185_Stats.dwMaxPwrupXfers = dwXfers;
+		}
+	}
+
 	*IO_pdwMode = dwCurrent_mode;
 
 exit:
@@ -1527,6 +1754,36 @@ exit:
 	return iRet;
 }
 
+int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
+{
+	return _tps65185_chg_mode(IO_pdwMode,iIsWaitPwrOff,1);
+}
+
+// same as tps65185_chg_mode() , but a change to ACTIVE returns as soon as
+// the power up sequence is started . the caller must tps65185_wait_active()
+// before driving the panel .
+int tps65185_chg_mode_nowait(unsigned long *IO_pdwMode,int iIsWaitPwrOff)
+{
+	return _tps65185_chg_mode(IO_pdwMode,iIsWaitPwrOff,0);
+}
+
+int tps65185_wait_active(void)
+{
+	int iRet=TPS65185_RET_SUCCESS;
+
+	if(!giIsTPS65185_PwrupPending) {
+		return iRet;
+	}
+
+	down(&gtTPS65185_DataA[0].chmod_lock);
+	if(giIsTPS65185_PwrupPending) {
+		iRet = _tps65185_pwrup_finish();
+	}
+	up(&gtTPS65185_DataA[0].chmod_lock);
+
+	return iRet;
+}
+
 
 
 int tps65185_vcom_set(int I_iVCOM_mv,int iIsWriteToFlash)
@@ -1834,6 +2091,12 @@ void tps65185_resume(void)
 #endif //]TPS65185_SUSPEND
 }
 
+/* i2c client of the PMIC, for drivers that order their resume after it */
+struct device *tps65185_device(void)
+{
+	return gpI2C_clientA[0] ? &gpI2C_clientA[0]->dev : NULL;
+}
+
 //EXPORT_SYMBOL(tps65185_init);
 //EXPORT_SYMBOL(tps65185_release);
 //EXPORT_SYMBOL(tps65185_get_temperature);
@@ -38,11 +38,14 @@ int tps65185_wait_panel_poweroff(void);
 #define TPS65185_MODE_SLEEP			0x00000002
 #define TPS65185_MODE_STANDBY		0x00000004
 int tps65185_chg_mode(unsigned long *IO_pdwMode,int iIsWaitPwrOff);
+int tps65185_chg_mode_nowait(unsigned long *IO_pdwMode,int iIsWaitPwrOff);
+int tps65185_wait_active(void);
 
 int tps65185_vcom_set(int I_iVCOM_mv,int iIsWriteToFlash);
 int tps65185_vcom_get(int *O_piVCOM_mv);
 int tps65185_vcom_kickback_measurement(int *O_piVCOM_mv);
 int tps65185_suspend(void);
 void tps65185_resume(void);
+struct device *tps65185_device(void);
 
 #endif //]LK_LM75_H
@@ -5,6 +5,7 @@
 #include "fake_s1d13522.h"
 #include "lk_lm75.h"
 #include "lk_tps65185.h"
+#include "epdc_thermal.h"
 #include <linux/completion.h>
 
 
@@ -296,40 +297,105 @@ static int k_wait_update_complete(void)
 	return iRet;
 }
 
-static volatile unsigned long gdwLastUpdateJiffies = 0;
 
 
 /////////////////////////////////////////////////////////////
+// temperature cache : the panel temperature is sampled over I2C by a
+// background work item, so updates only ever look at the cached value .
+static int giLastTemprature = DEFAULT_TEMP;
+static volatile unsigned long gdwTempSampleJiffies = 0; // 0 : never sampled .
+static unsigned long gdwTempRefreshSecs = 60;
+static unsigned long gdwTempReadFails = 0;
+#define TEMP_RETRY_SECS		5
+#define TEMP_FRESH_MS		1000
+
+static int k_sample_temperature(void)
+{
+	int iChk;
+	int iTemp;
+
+	if(gptHWCFG&&6==gptHWCFG->m_val.bDisplayCtrl) {
+		// imx508 + tps16585 .
+		iChk = tps65185_get_temperature(&iTemp);
+	}
+	else {
+		iChk = lm75_get_temperature(0,&iTemp);
+	}
+
+	if(iChk>=0) {
+		giLastTemprature = iTemp;
+		gdwTempSampleJiffies = jiffies;
+		mxc_epdc_fb_set_temperature(iTemp,&g_fb_data->info);
+	}
+	else {
+		gdwTempReadFails++;
+	}
+	return iChk;
+}
+
+// the same sample drives the waveform index and the panel thermal zone .
+static int k_read_temperature(void)
+{
+	int iChk = k_sample_temperature();
+
+	if(iChk>=0) {
+		epdc_thermal_update();
+	}
+	return iChk;
+}
+
+// thermal zone read : the cache , or a new sample while it cools down .
+static int k_thermal_read(int *piTemp,int fresh)
+{
+	if(fresh && time_after(jiffies,gdwTempSampleJiffies+msecs_to_jiffies(TEMP_FRESH_MS))) {
+		k_sample_temperature();
+	}
+	*piTemp = giLastTemprature;
+	return 0;
+}
+
+static void k_temperature_work_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gtTempWork, k_temperature_work_func);
+
+static void k_temperature_work_func(struct work_struct *work)
+{
+	unsigned long dwDelaySecs = gdwTempRefreshSecs;
+
+	if(k_read_temperature()<0) {
+		// sensor busy or not up yet , try again soon .
+		dwDelaySecs = min(dwDelaySecs,(unsigned long)TEMP_RETRY_SECS);
+	}
+	schedule_delayed_work(&gtTempWork,dwDelaySecs*HZ);
+}
+
 // calling by real epdc driver .
 static int k_set_temperature(struct fb_info *info)
 {
-	int iRet;
-	int iChk;
-	
-	static int giLastTemprature = DEFAULT_TEMP;
-	
+	static int giTempWorkStarted = 0;
 
-	//printk("%s(),timeout_tick=%u,current_tick=%u\n",__FUNCTION__,
-	//		gdwLastUpdateJiffies,jiffies);
-	
-	if(0==gdwLastUpdateJiffies||time_after(jiffies,gdwLastUpdateJiffies)) {
-		
-		if(gptHWCFG&&6==gptHWCFG->m_val.bDisplayCtrl) {
-			// imx508 + tps16585 .
-			iChk = tps65185_get_temperature(&giLastTemprature);
-		}
-		else {
-			iChk = lm75_get_temperature(0,&giLastTemprature);
-		}
-		
-		if(iChk>=0) {
-			iChk = mxc_epdc_fb_set_temperature(giLastTemprature,info);
-			gdwLastUpdateJiffies = jiffies+(60*HZ);
-		}
+	if(!giTempWorkStarted) {
+		giTempWorkStarted = 1;
+		// the very first update waits for a real reading , all later
+		// ones use the cache kept fresh by gtTempWork .
+		k_read_temperature();
+		epdc_thermal_init(k_thermal_read);
+		schedule_delayed_work(&gtTempWork,gdwTempRefreshSecs*HZ);
 	}
 	return giLastTemprature;
 }
 
+static void k_temperature_stop(void)
+{
+	cancel_delayed_work_sync(&gtTempWork);
+}
+
+// the panel may have warmed up or cooled down while we slept .
+static void k_temperature_resume(void)
+{
+	cancel_delayed_work_sync(&gtTempWork);
+	schedule_delayed_work(&gtTempWork,0);
+}
+
 ////////////////////////////////////////////////////////////
 
 static int k_set_update_rect(unsigned short wX,unsigned short wY,
@@ -352,6 +418,245 @@ static int k_set_update_rect(unsigned short wX,unsigned short wY,
 	return iRet;
 }
 
+////////////////////////////////////////////////////////////
+//
+// rotated puts : the PXP rotates , the CPU only does the linear
+// 4<->8 bits unpack/pack around it . small regions are not worth the
+// PXP setup and stay on the CPU (epdfbdc_put_fbimg()) .
+//
+#define PXP_ROTATE_MIN_PIXELS_DEFAULT	(128*128)
+
+static unsigned long gdwPxpRotateMinPixels = PXP_ROTATE_MIN_PIXELS_DEFAULT;
+static unsigned long gdwPxpRotateCnt,gdwCpuRotateCnt,gdwPxpRotateFallbackCnt;
+
+static DEFINE_MUTEX(gtPxpRotLock); // protects the rotate buffers .
+static unsigned char *gpbPxpRotSrc,*gpbPxpRotDst;
+static unsigned long gdwPxpRotBufSize;
+
+static void k_pxp_rotate_free(void)
+{
+	mutex_lock(&gtPxpRotLock);
+	if(gdwPxpRotBufSize) {
+		free_pages((unsigned long)gpbPxpRotSrc,get_order(gdwPxpRotBufSize));
+		free_pages((unsigned long)gpbPxpRotDst,get_order(gdwPxpRotBufSize));
+	}
+	gpbPxpRotSrc = gpbPxpRotDst = 0;
+	gdwPxpRotBufSize = 0;
+	mutex_unlock(&gtPxpRotLock);
+}
+
+// called with gtPxpRotLock held .
+static int k_pxp_rotate_buf_get(unsigned long dwSize)
+{
+	unsigned char *pbSrc,*pbDst;
+
+	if(dwSize<=gdwPxpRotBufSize) {
+		return 0;
+	}
+
+	dwSize = PAGE_SIZE<<get_order(dwSize);
+	pbSrc = (unsigned char *)__get_free_pages(GFP_KERNEL|__GFP_NOWARN,
+		get_order(dwSize));
+	pbDst = (unsigned char *)__get_free_pages(GFP_KERNEL|__GFP_NOWARN,
+		get_order(dwSize));
+	if(!pbSrc||!pbDst) {
+		if(pbSrc) {
+			free_pages((unsigned long)pbSrc,get_order(dwSize));
+		}
+		if(pbDst) {
+			free_pages((unsigned long)pbDst,get_order(dwSize));
+		}
+		return -ENOMEM;
+	}
+
+	if(gdwPxpRotBufSize) {
+		free_pages((unsigned long)gpbPxpRotSrc,get_order(gdwPxpRotBufSize));
+		free_pages((unsigned long)gpbPxpRotDst,get_order(gdwPxpRotBufSize));
+	}
+	gpbPxpRotSrc = pbSrc;
+	gpbPxpRotDst = pbDst;
+	gdwPxpRotBufSize = dwSize;
+	return 0;
+}
+
+//
+// run one 8 bits gray rotation through the PXP channel of the EPDC
+// driver . dwW/dwH must be multiples of 8 .
+//
+static int k_pxp_rotate_gray8(struct mxc_epdc_fb_data *fb_data,
+	unsigned char *pbSrc,unsigned char *pbDst,
+	unsigned long dwW,unsigned long dwH,u32 dwDegree)
+{
+	struct mxcfb_rect tRegion;
+	dma_addr_t tSrcPhys,tDstPhys;
+	u32 dwSaveFmt,dwHist;
+	unsigned long dwSize = dwW*dwH;
+	int iRet;
+
+	tSrcPhys = dma_map_single(fb_data->dev,pbSrc,dwSize,DMA_TO_DEVICE);
+	tDstPhys = dma_map_single(fb_data->dev,pbDst,dwSize,DMA_FROM_DEVICE);
+
+	tRegion.top = 0;
+	tRegion.left = 0;
+	tRegion.width = dwW;
+	tRegion.height = dwH;
+
+	mutex_lock(&fb_data->pxp_mutex);
+
+	sg_dma_address(&fb_data->sg[0]) = tSrcPhys;
+	sg_set_page(&fb_data->sg[0],virt_to_page(pbSrc),dwSize,
+		offset_in_page(pbSrc));
+	sg_dma_address(&fb_data->sg[1]) = tDstPhys;
+	sg_set_page(&fb_data->sg[1],virt_to_page(pbDst),dwSize,
+		offset_in_page(pbDst));
+
+	dwSaveFmt = fb_data->pxp_conf.s0_param.pixel_fmt;
+	fb_data->pxp_conf.s0_param.pixel_fmt = PXP_PIX_FMT_GREY;
+	fb_data->pxp_conf.proc_data.lut_transform = PXP_LUT_NONE;
+
+	iRet = pxp_process_update(fb_data,dwW,dwH,&tRegion,dwDegree);
+	if(0==iRet) {
+		iRet = pxp_complete_update(fb_data,&dwHist);
+	}
+
+	fb_data->pxp_conf.s0_param.pixel_fmt = dwSaveFmt;
+	mutex_unlock(&fb_data->pxp_mutex);
+
+	dma_unmap_single(fb_data->dev,tDstPhys,dwSize,DMA_FROM_DEVICE);
+	dma_unmap_single(fb_data->dev,tSrcPhys,dwSize,DMA_TO_DEVICE);
+
+	return iRet;
+}
+
+//
+// return 0 if the PXP did the put , <0 to let the caller use the CPU .
+//
+static int k_pxp_put_img(EPDFB_IMG *I_ptPutImage,EPDFB_ROTATE_T I_tRotate)
+{
+	unsigned long dwSkipL,dwSkipR,dwImgW,dwImgH;
+	unsigned long dwPW,dwPH,dwOutW,dwCropX,dwCropY;
+	unsigned long dwX,dwY,dwW,dwH;
+	u32 dwDegree;
+	int iRet;
+
+	if( EPDFB_R_0==I_tRotate || 0==gdwPxpRotateMinPixels ||
+		I_ptPutImage->dwW*I_ptPutImage->dwH<gdwPxpRotateMinPixels ||
+		(4!=gptDC->bPixelBits && 8!=gptDC->bPixelBits) ||
+		(gptDC->dwFlags&EPDFB_DC_FLAG_OFB_RGB565) ||
+		(4!=I_ptPutImage->bPixelBits && 8!=I_ptPutImage->bPixelBits) )
+	{
+		return -EINVAL;
+	}
+
+	// skipped edge pixels are simply left out of the image , exactly as
+	// the epdfb_dc blitters do .
+	dwSkipL = (gptDC->dwFlags&EPDFB_DC_FLAG_SKIPLEFTPIXEL)?1:0;
+	dwSkipR = (gptDC->dwFlags&EPDFB_DC_FLAG_SKIPRIGHTPIXEL)?1:0;
+	if(I_ptPutImage->dwW<=dwSkipL+dwSkipR) {
+		return -EINVAL;
+	}
+	dwImgW = I_ptPutImage->dwW-dwSkipL-dwSkipR;
+	dwImgH = I_ptPutImage->dwH;
+
+	dwX = I_ptPutImage->dwX+dwSkipL;
+	dwY = I_ptPutImage->dwY;
+	dwW = dwImgW;
+	dwH = dwImgH;
+	epdfbdc_get_rotate_active(gptDC,&dwX,&dwY,&dwW,&dwH,I_tRotate);
+	if( (long)dwX<0 || dwX+dwW > gptDC->dwWidth+gptDC->dwFBWExtra ||
+		(long)dwY<0 || dwY+dwH > gptDC->dwHeight+gptDC->dwFBHExtra )
+	{
+		// clipped puts keep the per-pixel path .
+		return -EINVAL;
+	}
+
+	// the PXP works on 8x8 blocks : pad right/bottom and crop the
+	// rotated result (same offsets as epdc_process_update()) .
+	dwPW = ALIGN(dwImgW,8);
+	dwPH = ALIGN(dwImgH,8);
+	switch(I_tRotate) {
+	case EPDFB_R_90:
+		dwDegree = 90;
+		dwOutW = dwPH;
+		dwCropX = dwPH-dwImgH;dwCropY = 0;
+		break;
+	case EPDFB_R_180:
+		dwDegree = 180;
+		dwOutW = dwPW;
+		dwCropX = dwPW-dwImgW;dwCropY = dwPH-dwImgH;
+		break;
+	case EPDFB_R_270:
+	default:
+		dwDegree = 270;
+		dwOutW = dwPH;
+		dwCropX = 0;dwCropY = dwPW-dwImgW;
+		break;
+	}
+
+	mutex_lock(&gtPxpRotLock);
+	iRet = k_pxp_rotate_buf_get(dwPW*dwPH);
+	if(iRet) {
+		goto out;
+	}
+
+	// padding is cropped away again , no need to clear it .
+	if(EPDFB_DC_SUCCESS!=epdfbdc_fbimg_to_gray8(gptDC,I_ptPutImage,dwSkipL,
+		dwImgW,gpbPxpRotSrc,dwPW))
+	{
+		iRet = -EINVAL;
+		goto out;
+	}
+
+	iRet = k_pxp_rotate_gray8(g_fb_data,gpbPxpRotSrc,gpbPxpRotDst,
+		dwPW,dwPH,dwDegree);
+	if(iRet) {
+		goto out;
+	}
+
+	if(EPDFB_DC_SUCCESS!=epdfbdc_put_gray8(gptDC,
+		gpbPxpRotDst+dwCropY*dwOutW+dwCropX,dwOutW,dwX,dwY,dwW,dwH))
+	{
+		iRet = -EINVAL;
+	}
+
+out:
+	mutex_unlock(&gtPxpRotLock);
+	return iRet;
+}
+
+static int k_put_img(EPDFB_IMG *I_ptPutImage,EPDFB_ROTATE_T I_tRotate)
+{
+	unsigned long dwX,dwY,dwW,dwH;
+	int iRet;
+
+	iRet = k_pxp_put_img(I_ptPutImage,I_tRotate);
+	if(0==iRet) {
+		gdwPxpRotateCnt++;
+	}
+	else {
+		if(-EINVAL!=iRet) {
+			// PXP busy/timeout or no memory : the CPU path always works .
+			gdwPxpRotateFallbackCnt++;
+		}
+		if(EPDFB_R_0!=I_tRotate) {
+			gdwCpuRotateCnt++;
+		}
+		epdfbdc_put_fbimg(gptDC,I_ptPutImage,I_tRotate);
+	}
+
+	// what fake_s1d13522_display_img() does without a pfnPutImg hook ;
+	// the dirty copy it would do next is not needed , gptDC is built on
+	// the framebuffer itself .
+	dwX = I_ptPutImage->dwX;
+	dwY = I_ptPutImage->dwY;
+	dwW = I_ptPutImage->dwW;
+	dwH = I_ptPutImage->dwH;
+	epdfbdc_get_rotate_active(gptDC,&dwX,&dwY,&dwW,&dwH,I_tRotate);
+	k_set_update_rect(dwX,dwY,dwW,dwH);
+
+	return 0;
+}
+
 static int k_set_vcom(int iVCOM_set_mV)
 {
 	int iRet=0;
@@ -413,6 +718,7 @@ static int k_fake_s1d13522_init(unsigned char *pbInitDCbuf)
 		gptDC->pfnSetVCOM = k_set_vcom;
 		gptDC->pfnGetVCOM = k_get_vcom;
 		gptDC->pfnSetVCOMToFlash = k_set_vcom_to_flash;
+		gptDC->pfnPutImg = k_put_img;
 		
 		//gptDC->dwFlags |= EPDFB_DC_FLAG_OFB_RGB565;
 		gptDC->dwFlags |= EPDFB_DC_FLAG_FLASHDIRTY;
@@ -38,6 +38,7 @@
 #include <linux/clk.h>
 #include <linux/uaccess.h>
 #include <linux/cpufreq.h>
+#include <linux/ksm.h>
 #include <linux/earlysuspend.h>
 #include <linux/firmware.h>
 #include <linux/kthread.h>
@@ -59,6 +60,15 @@
 
 #include <linux/time.h>
 #include <linux/bitops.h>
+#include <linux/jhash.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+#include <linux/iram_alloc.h>
+#include <asm/unaligned.h>
 
 #include "epdc_regs.h"
 #include "lk_tps65185.h"
@@ -70,6 +80,9 @@
 
 #include "dither_neon.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/mxc_epdc.h>
+
 /*
  * Enable this define to have a default panel
  * loaded during driver initialization
@@ -78,8 +91,9 @@
 
 #define NUM_SCREENS_MIN	2
 #define EPDC_NUM_LUTS 16
-//#define EPDC_MAX_NUM_UPDATES 20
-#define EPDC_MAX_NUM_UPDATES giEPDC_MAX_NUM_UPDATES
+/* Upper bound for the update buffer pool, one per LUT */
+#define EPDC_MAX_NUM_UPDATES EPDC_NUM_LUTS
+#define EPDC_UPD_BUF_SHRINK_DELAY	(10 * HZ)
 #define INVALID_LUT -1
 
 #define DEFAULT_TEMP_INDEX	0
@@ -95,6 +109,85 @@
 #define MERGE_FAIL	1
 #define MERGE_BLOCK	2
 
+/* Why epdc_submit_merge() refused, indexes merge_rejects[] */
+enum {
+	EPDC_MERGE_REJ_FLAGS,	/* Different flags, different regions */
+	EPDC_MERGE_REJ_WAVEFORM,/* Waveform mismatch, merging not allowed */
+	EPDC_MERGE_REJ_MODE,	/* Update mode mismatch, likewise */
+	EPDC_MERGE_REJ_APART,	/* Regions neither overlap nor touch */
+	EPDC_MERGE_REJ_GROWTH,	/* Bounding box over merge_max_growth */
+	EPDC_MERGE_REJ_NUM,
+};
+
+/*
+ * Deferred io dirty rectangles: bands of dirty lines closer than
+ * EPDC_DEFIO_MERGE_GAP are merged, and no more than EPDC_DEFIO_MAX_RECTS
+ * updates are sent per deferred io pass.
+ */
+#define EPDC_DEFIO_MAX_RECTS	8
+#define EPDC_DEFIO_MERGE_GAP	16
+
+/*
+ * Update scheduler: how far into the pending list to look for an update
+ * that can go ahead of the head, and how often the head may be passed.
+ * Waveform mode 4 is A2 in the waveforms shipped on these panels.
+ */
+#define EPDC_SCHED_LOOKAHEAD	8
+#define EPDC_SCHED_MAX_SKIPS	4
+#define EPDC_WAVEFORM_MODE_A2	4
+
+/*
+ * Direct draw (MXCFB_SEND_DIRECT): the LUT kept from queued updates once
+ * the first direct update is sent, and the size of its update buffer.
+ */
+#define EPDC_DIRECT_LUT		0
+#define EPDC_DIRECT_BUF_SIZE	MXCFB_DIRECT_MAX_PIXELS
+
+/*
+ * Latency histogram: per waveform mode (the last row collects modes
+ * above it), per pipeline stage, in power-of-two millisecond buckets.
+ */
+#define EPDC_LAT_MODES		8
+#define EPDC_LAT_BUCKETS	12
+#define EPDC_LAT_QUEUE		0	/* send_update -> PxP start */
+#define EPDC_LAT_PXP		1	/* PxP start -> PxP done */
+#define EPDC_LAT_SUBMIT		2	/* PxP done -> EPDC submit */
+#define EPDC_LAT_PANEL		3	/* EPDC submit -> LUT complete */
+#define EPDC_LAT_TOTAL		4	/* send_update -> LUT complete */
+#define EPDC_LAT_TOUCH_SEND	5	/* touch -> send_update */
+#define EPDC_LAT_TOUCH		6	/* touch -> LUT complete */
+#define EPDC_LAT_STAGES		7
+
+/* Queue delay of the display pipeline work items */
+#define EPDC_WQ_SUBMIT		0	/* epdc_submit_work */
+#define EPDC_WQ_DONE		1	/* epdc_done_work, from its due time */
+#define EPDC_WQ_ITEMS		2
+
+struct epdc_wq_stat {
+	ktime_t queued;		/* When the pending run became due, 0: none */
+	u32 runs;
+	u32 slow;		/* Runs delayed by a millisecond or more */
+	u32 max_us;
+	u64 total_us;
+};
+
+/* A touch older than this when an update is sent did not cause it */
+#define EPDC_TOUCH_MAX_MS	2000
+
+/*
+ * Adaptive power-down: idle gap histogram size (power-of-two ms buckets,
+ * the last one collecting gaps of 8s and more), weight of one sample and
+ * the total at which old samples are halved.
+ */
+#define EPDC_PWR_BUCKETS		15
+#define EPDC_PWR_SAMPLE_WEIGHT		8
+#define EPDC_PWR_HIST_LIMIT		512
+#define EPDC_PWR_DEFAULT_BREAKEVEN	1000	/* ms */
+
+#define EPDC_DITHER_ATKINSON		0	/* Error diffusion, C */
+#define EPDC_DITHER_ATKINSON_NEON	1	/* Error diffusion, NEON */
+#define EPDC_DITHER_ORDERED_NEON	2	/* 4x4 ordered, NEON */
+
 // Frank.Lin 2011.05.09
 #define GPIO_PWRALL     (0*32 + 27) /* GPIO_1_27 */
 #define EPDC_VCOM	(3*32 + 21)	/*GPIO_4_21 */
@@ -121,6 +214,17 @@ struct update_marker_data {
 	struct completion update_completion;
 	int lut_num;
 	bool waiting;
+	u32 hist_class;		/* MXCFB_HIST_CLASS_* of the update */
+	u32 waveform_mode;	/* Waveform the update was submitted with */
+};
+
+/* Pipeline timestamps of an update, zero if the stage was not reached */
+struct epdc_upd_times {
+	ktime_t send;		/* Accepted by mxc_epdc_fb_send_update() */
+	ktime_t pxp_start;	/* PxP processing started */
+	ktime_t pxp_done;	/* PxP processing complete */
+	ktime_t submit;		/* Handed to the EPDC on a LUT */
+	ktime_t touch;		/* Input event the update answers */
 };
 
 struct update_desc_list {
@@ -129,6 +233,8 @@ struct update_desc_list {
 	u32 epdc_offs;		/* Added to buffer ptr to resolve alignment */
 	struct list_head upd_marker_list; /* List of markers for this update */
 	u32 update_order;	/* Numeric ordering value for update */
+	int sched_skips;	/* Times the scheduler passed over it */
+	struct epdc_upd_times times;
 };
 
 /* This structure represents a list node containing both
@@ -158,6 +264,7 @@ struct mxc_epdc_fb_data {
 	struct mxc_epdc_fb_platform_data *pdata;
 	int blank;
 	ssize_t map_size;
+	ssize_t alloc_size;	/* Allocated at phys_start, see probe */
 	dma_addr_t phys_start;
 	u32 fb_offset;
 	int default_bpp;
@@ -196,6 +303,27 @@ struct mxc_epdc_fb_data {
 	u32 *waveform_buffer_virt;
 	u32 waveform_buffer_phys;
 	u32 waveform_buffer_size;
+
+	/* Waveform cache, see epdc_wv_build() */
+	const u8 *wv_src;	/* Complete waveform data */
+	u32 wv_src_size;
+	void *wv_src_alloc;	/* vmalloc'ed copy backing wv_src, if any */
+	bool wv_cache;		/* Load temperature ranges on demand */
+	int wv_mode_cnt;
+	u32 *wv_bounds;		/* Sorted start offsets of tables and blocks */
+	int wv_nbounds;
+	spinlock_t wv_lock;	/* Protects the fields below */
+	u32 wv_resident;	/* Temperature ranges in waveform_buffer */
+	u32 wv_wanted;		/* Ranges to add on the next load */
+	u32 wv_loads;
+	u32 *wv_next_virt;	/* Built by wv_load_work, not yet in use */
+	u32 wv_next_phys;
+	u32 wv_next_size;
+	u32 wv_next_resident;
+	u32 *wv_old_virt;	/* Replaced, waiting to be freed */
+	u32 wv_old_phys;
+	u32 wv_old_size;
+	struct work_struct wv_load_work;
 	u32 *working_buffer_virt;
 	u32 working_buffer_phys;
 	u32 working_buffer_size;
@@ -207,6 +335,8 @@ struct mxc_epdc_fb_data {
 	struct delayed_work epdc_done_work;
 	struct workqueue_struct *epdc_submit_workqueue;
 	struct work_struct epdc_submit_work;
+	spinlock_t wq_stat_lock;
+	struct epdc_wq_stat wq_stat[EPDC_WQ_ITEMS];
 //#ifdef FW_IN_RAM //[
 
 	struct work_struct epdc_firmware_work;
@@ -222,8 +352,104 @@ struct mxc_epdc_fb_data {
 	bool powering_down;
 	bool updates_active;
 	int pwrdown_delay;
+
+	/* Adaptive power-down delay (FB_POWERDOWN_ADAPTIVE) */
+	u32 pwr_gap_hist[EPDC_PWR_BUCKETS]; /* Decaying idle gap histogram */
+	int pwr_adaptive_delay;	/* Learned delay in ms */
+	int pwr_breakeven_ms;	/* Rail-on time one power cycle is worth */
+	ktime_t pwr_idle_start;	/* Went idle with the rails up, queue_lock */
+	u32 pwr_cold_starts;	/* Updates that had to power the rails up */
+	u32 pwr_warm_starts;	/* Updates that found the rails still up */
+	u64 pwr_powerup_us;	/* Time spent powering up */
+	bool pwr_ramping;	/* Rails started, power good not yet seen */
+	u64 pwr_ramp_wait_us;	/* Time updates still waited on the ramp */
+	u64 pwr_idle_on_ms;	/* Time the rails were up with nothing to do */
 	unsigned long tce_prevent;
 	int merge_on_waveform_mismatch;
+	int merge_max_growth;	/* Bounding box limit in % of the union, 0 none */
+	u32 merge_attempts;
+	u32 merge_accepts;
+	u32 merge_rejects[EPDC_MERGE_REJ_NUM];
+	u64 merge_added_pixels;	/* In merged boxes but in neither update */
+	bool zero_copy;		/* Let PxP read unaligned regions in place */
+	/* WAVEFORM_MODE_AUTO choice per histogram class, -1 uses wv_modes */
+	int hist_wv_policy[MXCFB_HIST_CLASSES];
+
+	/* Update buffer copy statistics */
+	u32 copy_cnt;		/* Updates that went through copy_before_process() */
+	u32 zero_copy_cnt;	/* Unaligned updates handled without a copy */
+	u64 copy_bytes;		/* Bytes written into the copy buffers */
+	u32 copy_dma_cnt;	/* Copies done by the SDMA memcpy channel */
+
+	/* SDMA memcpy channel for large contiguous update copies */
+	struct dma_chan *memcpy_chan;
+	bool memcpy_chan_failed;	/* None is available, don't retry */
+	struct completion memcpy_cmpl;
+	u32 copy_dma_threshold;		/* Smallest copy offloaded, 0 = never */
+
+	/* Dithering */
+	int dither_mode;	/* One of EPDC_DITHER_* */
+	void *dither_err_buf;	/* Error distribution lines, shared by all */
+	int dither_max_width;	/* Widest region dither_err_buf can hold */
+	size_t dither_err_size;
+	unsigned long dither_err_iram;	/* IRAM address, 0 if kmalloc'ed */
+	u32 flush_cnt;		/* Dithered updates handed to the EPDC */
+	u32 wb_overlap_cnt;	/* ... dithered while the WB was busy */
+	u32 last_flush_bytes;	/* Bytes dithered for the most recent one */
+	u64 flush_bytes;	/* Total bytes dithered */
+
+	/* Update buffer pool */
+	int upd_buf_size;	/* Size of each PxP output buffer */
+	int upd_buf_count;	/* Buffers currently allocated */
+	int upd_buf_min;	/* Buffers kept while idle */
+	int upd_buf_max;	/* Limit for growing under load */
+	int upd_buf_peak;
+	u32 upd_buf_stalls;	/* Submit work found updates but no buffer */
+	u32 upd_buf_rejects;	/* Snapshot updates refused for no buffer */
+	u32 upd_buf_grown;
+	u32 upd_buf_shrunk;
+	u32 upd_buf_alloc_failures;
+	struct delayed_work upd_buf_shrink_work;
+	u32 upd_collisions;	/* Updates that collided with a running LUT */
+
+	/* Update scheduler */
+	bool sched_reorder;	/* Let pending updates overtake the head */
+	u32 sched_reordered;	/* Updates dispatched out of queue order */
+	struct mxcfb_rect lut_region[EPDC_NUM_LUTS]; /* Panel area per LUT */
+
+	/* Direct draw, see mxc_epdc_fb_send_direct() */
+	struct mutex direct_mutex;	/* One direct update at a time */
+	struct update_data_list direct_upd; /* cur_update while in the WB */
+	struct update_desc_list direct_desc;
+	u32 direct_reserved;	/* LUTs queued updates must not use */
+	bool waiting_for_direct;
+	struct completion direct_res_free;
+	struct work_struct direct_redo_work;
+	bool direct_redo_pending;
+	struct mxcfb_update_data direct_redo; /* Collided, to send queued */
+	u32 direct_cnt;
+	u32 direct_waits;	/* Waited for the WB or a LUT */
+	u32 direct_shared;	/* Ran on a LUT other than EPDC_DIRECT_LUT */
+	u32 direct_collisions;	/* Redrawn through the queue */
+	u32 direct_max_us;	/* Longest ioctl entry to submit */
+	u64 direct_total_us;
+
+	/* Latency instrumentation */
+	struct epdc_upd_times lut_times[EPDC_NUM_LUTS];
+	u32 lut_wv_mode[EPDC_NUM_LUTS];
+	u32 lat_hist[EPDC_LAT_MODES][EPDC_LAT_STAGES][EPDC_LAT_BUCKETS];
+	struct dentry *debugfs_dir;
+	mxc_epdc_upd_observer_t upd_observer;	/* Called under queue_lock */
+	void *upd_observer_data;
+	ktime_t touch_pending;	/* Oldest touch not yet answered */
+	u32 touch_tgid;		/* Only its updates answer touches, 0: any */
+
+	/* Deferred io dirty tracking */
+	bool defio_hash;	/* Skip pages whose content hash is unchanged */
+	u32 *defio_page_hash;	/* Last seen hash of each framebuffer page */
+	u32 defio_pages;	/* Dirty pages reported by deferred io */
+	u32 defio_pages_skipped;/* ... of which had unchanged content */
+	u32 defio_rects;	/* Updates sent for them */
 
 	/* FB elements related to PxP DMA */
 	struct completion pxp_tx_cmpl;
@@ -281,12 +507,14 @@ struct mxc_epdc_fb_data *g_fb_data;
 /* forward declaration */
 static int mxc_epdc_fb_get_temp_index(struct mxc_epdc_fb_data *fb_data,
 						int temp);
+static int epdc_wv_temp_index(struct mxc_epdc_fb_data *fb_data,
+			      int temp_index);
 static void mxc_epdc_fb_flush_updates(struct mxc_epdc_fb_data *fb_data);
 static int mxc_epdc_fb_blank(int blank, struct fb_info *info);
 static int mxc_epdc_fb_init_hw(struct fb_info *info);
 static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 			      u32 src_width, u32 src_height,
-			      struct mxcfb_rect *update_region);
+			      struct mxcfb_rect *update_region, u32 rotate);
 static int pxp_complete_update(struct mxc_epdc_fb_data *fb_data, u32 *hist_stat);
 
 static void draw_mode0(struct mxc_epdc_fb_data *fb_data);
@@ -296,11 +524,11 @@ static void mxc_epdc_fb_fw_handler(const struct firmware *fw,void *context);
 
 static void do_dithering_processing_Y1_v1_0(
 	unsigned char *update_region_ptr,
-	int width, int height, int stride);
+	int width, int height, int stride, int *err_dist);
 
 static void do_dithering_processing_Y4_v1_0(
 	unsigned char *update_region_ptr,
-	int width, int height, int stride);
+	int width, int height, int stride, int *err_dist);
 
 //#ifdef DEBUG
 #if 1
@@ -643,6 +871,11 @@ static inline bool epdc_is_lut_active(u32 lut_num)
 	return is_active;
 }
 
+static inline u32 epdc_get_active_luts(void)
+{
+	return __raw_readl(EPDC_STATUS_LUTS);
+}
+
 static inline bool epdc_any_luts_active(void)
 {
 	bool any_active = __raw_readl(EPDC_STATUS_LUTS) ? true : false;
@@ -666,14 +899,25 @@ static inline int epdc_get_next_lut(void)
 	return val;
 }
 
-static int epdc_choose_next_lut(int *next_lut)
+/* Any LUT free that is not in the @reserved mask? */
+static inline bool epdc_luts_available(u32 reserved)
+{
+	return epdc_any_luts_available() &&
+		((epdc_get_active_luts() | reserved) & 0xFFFF) != 0xFFFF;
+}
+
+static int epdc_choose_next_lut(u32 reserved, int *next_lut)
 {
 	u32 luts_status = __raw_readl(EPDC_STATUS_LUTS);
+	u32 busy = (luts_status | reserved) & 0xFFFF;
 
-	*next_lut = fls(luts_status & 0xFFFF);
+	*next_lut = fls(busy);
 
-	if (*next_lut > 15)
+	if (*next_lut > 15) {
 		*next_lut = epdc_get_next_lut();
+		if (reserved & (1 << *next_lut))
+			*next_lut = ffz(busy);
+	}
 
 	if (luts_status & 0x8000)
 		return 1;
@@ -681,6 +925,13 @@ static int epdc_choose_next_lut(int *next_lut)
 		return 0;
 }
 
+/* May a queued update be submitted on @lut? */
+static inline bool epdc_lut_usable(struct mxc_epdc_fb_data *fb_data, int lut)
+{
+	return lut < EPDC_NUM_LUTS && !epdc_is_lut_active(lut) &&
+		!(fb_data->direct_reserved & (1 << lut));
+}
+
 static inline bool epdc_is_working_buffer_busy(void)
 {
 	u32 val = __raw_readl(EPDC_STATUS);
@@ -976,12 +1227,105 @@ void epdc_init_settings(struct mxc_epdc_fb_data *fb_data)
 	__raw_writel(reg_val, EPDC_GPIO);
 }
 
+/*
+ * Adaptive power-down delay.
+ *
+ * Every idle gap (panel idle with rails up -> next update) goes into a
+ * decaying power-of-two millisecond histogram. The delay is then the
+ * bucket bound D minimising the expected cost
+ *
+ *	sum over gaps g <= D of g  +  sum over gaps g > D of (D + breakeven)
+ *
+ * i.e. rail-on time is paid for while we wait, and a power cycle is
+ * charged as pwr_breakeven_ms worth of rail-on time (its energy plus
+ * the latency the user sees on the next page turn).
+ */
+static u32 epdc_pwr_bucket_ms(int bucket)
+{
+	if (bucket == 0)
+		return 0;
+	if (bucket == 1)
+		return 1;
+	/* Midpoint of [2^(b-1), 2^b) */
+	return 3 << (bucket - 2);
+}
+
+static void epdc_pwr_learn_delay(struct mxc_epdc_fb_data *fb_data)
+{
+	u64 cost, best_cost = ~0ULL;
+	u32 d, g;
+	int j, k, best = 0;
+
+	/* Candidate j means D = 0 for j == 0, else 2^(j-1) ms */
+	for (j = 0; j < EPDC_PWR_BUCKETS; j++) {
+		d = j ? 1 << (j - 1) : 0;
+		cost = 0;
+		for (k = 0; k < EPDC_PWR_BUCKETS; k++) {
+			g = epdc_pwr_bucket_ms(k);
+			cost += (u64)fb_data->pwr_gap_hist[k] *
+				(g <= d ? g : d + fb_data->pwr_breakeven_ms);
+		}
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = j;
+		}
+	}
+
+	fb_data->pwr_adaptive_delay = best ? 1 << (best - 1) : 0;
+}
+
+/* Called with power_mutex held when an update needs the panel powered */
+static void epdc_pwr_note_wakeup(struct mxc_epdc_fb_data *fb_data)
+{
+	unsigned long flags;
+	ktime_t idle_start;
+	s64 gap_ms;
+	int k, sum = 0;
+
+	/* The IRQ handler sets it under queue_lock */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	idle_start = fb_data->pwr_idle_start;
+	fb_data->pwr_idle_start = ktime_set(0, 0);
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	if (ktime_to_ns(idle_start) == 0)
+		return;
+
+	gap_ms = ktime_to_ms(ktime_sub(ktime_get(), idle_start));
+	if (fb_data->power_state == POWER_STATE_ON)
+		fb_data->pwr_idle_on_ms += gap_ms;
+
+	k = (gap_ms >= (1 << (EPDC_PWR_BUCKETS - 2))) ?
+		EPDC_PWR_BUCKETS - 1 : fls((int)gap_ms);
+	fb_data->pwr_gap_hist[k] += EPDC_PWR_SAMPLE_WEIGHT;
+
+	/* Age old samples so the delay follows changes in reading pace */
+	for (k = 0; k < EPDC_PWR_BUCKETS; k++)
+		sum += fb_data->pwr_gap_hist[k];
+	if (sum > EPDC_PWR_HIST_LIMIT)
+		for (k = 0; k < EPDC_PWR_BUCKETS; k++)
+			fb_data->pwr_gap_hist[k] >>= 1;
+
+	epdc_pwr_learn_delay(fb_data);
+}
+
+static int epdc_pwrdown_delay_ms(struct mxc_epdc_fb_data *fb_data)
+{
+	if (fb_data->pwrdown_delay == FB_POWERDOWN_ADAPTIVE)
+		return fb_data->pwr_adaptive_delay;
+
+	return fb_data->pwrdown_delay;
+}
+
 static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 {
 	int ret = 0;
 	int iChk;
+	ktime_t start;
 	mutex_lock(&fb_data->power_mutex);
 
+	epdc_pwr_note_wakeup(fb_data);
+
 	/*
 	 * If power down request is pending, clear
 	 * powering_down to cancel the request.
@@ -990,12 +1334,16 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 		fb_data->powering_down = false;
 
 	if (fb_data->power_state == POWER_STATE_ON) {
+		fb_data->pwr_warm_starts++;
 		mutex_unlock(&fb_data->power_mutex);
 		return;
 	}
 
 	dev_dbg(fb_data->dev, "EPDC Powerup\n");
 
+	start = ktime_get();
+	fb_data->pwr_cold_starts++;
+
 	fb_data->updates_active = true;
 
 	if(6==gptHWCFG->m_val.bDisplayCtrl) {
@@ -1003,11 +1351,19 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 		// imx508 + tps16585 .
 		unsigned long dwTPS65185_mode = TPS65185_MODE_ACTIVE;
 
-		iChk = tps65185_chg_mode(&dwTPS65185_mode,1);
+		/*
+		 * Only start the PMIC's power-up sequencer here: the rails
+		 * ramp while PxP and LUT selection run, and the wait for
+		 * power good is done by epdc_powerup_wait() right before
+		 * the update is handed to the EPDC.
+		 */
+		iChk = tps65185_chg_mode_nowait(&dwTPS65185_mode,1);
 		if(iChk<0) {
 			printk(KERN_ERR "%s(%d):[warning] change to power active fail,errno=%d !\n",
 				__FILE__,__LINE__,iChk);
 		}
+		else
+			fb_data->pwr_ramping = true;
 		/*
 		iChk = tps65185_wait_panel_poweron();
 		if(iChk<0) {
@@ -1058,12 +1414,40 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 #endif
 
 	fb_data->power_state = POWER_STATE_ON;
+	fb_data->pwr_powerup_us += ktime_us_delta(ktime_get(), start);
+
+	mutex_unlock(&fb_data->power_mutex);
+}
+
+/*
+ * Wait for the rails started by epdc_powerup() to reach power good.
+ * Must be called before an update is submitted to the EPDC.
+ */
+static void epdc_powerup_wait(struct mxc_epdc_fb_data *fb_data)
+{
+	ktime_t start;
+	int iChk;
+
+	if (!fb_data->pwr_ramping)
+		return;
 
+	mutex_lock(&fb_data->power_mutex);
+	if (fb_data->pwr_ramping) {
+		start = ktime_get();
+		iChk = tps65185_wait_active();
+		if (iChk < 0)
+			dev_warn(fb_data->dev, "wait power good fail,errno=%d\n",
+				iChk);
+		fb_data->pwr_ramping = false;
+		fb_data->pwr_ramp_wait_us += ktime_us_delta(ktime_get(), start);
+	}
 	mutex_unlock(&fb_data->power_mutex);
 }
 
 static void epdc_powerdown(struct mxc_epdc_fb_data *fb_data)
 {
+	unsigned long flags;
+	ktime_t idle_start;
 	int iChk;
 
 	GALLEN_DBGLOCAL_BEGIN();
@@ -1081,6 +1465,9 @@ static void epdc_powerdown(struct mxc_epdc_fb_data *fb_data)
 
 	dev_dbg(fb_data->dev, "EPDC Powerdown\n");
 
+	/* The PMIC completes a pending power-up itself before going down */
+	fb_data->pwr_ramping = false;
+
 #ifdef USE_PMIC
 	/* Disable power to the EPD panel */
 	regulator_disable(fb_data->vcom_regulator);
@@ -1147,6 +1534,13 @@ static void epdc_powerdown(struct mxc_epdc_fb_data *fb_data)
 	fb_data->power_state = POWER_STATE_OFF;
 	fb_data->powering_down = false;
 
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	idle_start = fb_data->pwr_idle_start;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	if (ktime_to_ns(idle_start))
+		fb_data->pwr_idle_on_ms += ktime_to_ms(ktime_sub(ktime_get(),
+			idle_start));
+
 	if (fb_data->wait_for_powerdown) {
 		GALLEN_DBGLOCAL_RUNLOG(1);
 		fb_data->wait_for_powerdown = false;
@@ -1822,6 +2216,9 @@ int mxc_epdc_fb_set_temperature(int temperature, struct fb_info *info)
 	fb_data->temp_index = mxc_epdc_fb_get_temp_index(fb_data, temperature);
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
+	/* Start loading the new range before an update needs it */
+	epdc_wv_temp_index(fb_data, fb_data->temp_index);
+
 	return 0;
 }
 EXPORT_SYMBOL(mxc_epdc_fb_set_temperature);
@@ -1881,6 +2278,69 @@ int mxc_epdc_fb_set_upd_scheme(u32 upd_scheme, struct fb_info *info)
 }
 EXPORT_SYMBOL(mxc_epdc_fb_set_upd_scheme);
 
+static void epdc_dma_copy_done(void *arg)
+{
+	struct mxc_epdc_fb_data *fb_data = arg;
+
+	complete(&fb_data->memcpy_cmpl);
+}
+
+/*
+ * Copy a physically contiguous block with the SDMA memcpy channel and
+ * sleep until it has landed. Returns nonzero if the caller has to do the
+ * copy with the CPU instead.
+ */
+static int epdc_dma_copy(struct mxc_epdc_fb_data *fb_data, dma_addr_t dst,
+	dma_addr_t src, size_t len)
+{
+	struct dma_async_tx_descriptor *tx;
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+	dma_cookie_t cookie;
+
+	if (!fb_data->memcpy_chan) {
+		if (fb_data->memcpy_chan_failed)
+			return -ENODEV;
+		dma_cap_zero(mask);
+		dma_cap_set(DMA_MEMCPY, mask);
+		fb_data->memcpy_chan = dma_request_channel(mask, NULL, NULL);
+		if (!fb_data->memcpy_chan) {
+			dev_info(fb_data->dev,
+				"No memcpy DMA channel, copying updates with the CPU\n");
+			fb_data->memcpy_chan_failed = true;
+			return -ENODEV;
+		}
+		init_completion(&fb_data->memcpy_cmpl);
+	}
+	chan = fb_data->memcpy_chan;
+
+	tx = chan->device->device_prep_dma_memcpy(chan, dst, src, len,
+		DMA_PREP_INTERRUPT | DMA_COMPL_SKIP_SRC_UNMAP |
+		DMA_COMPL_SKIP_DEST_UNMAP);
+	if (!tx)
+		return -ENOMEM;
+	tx->callback = epdc_dma_copy_done;
+	tx->callback_param = fb_data;
+	INIT_COMPLETION(fb_data->memcpy_cmpl);
+
+	/* The source may still sit in the write buffer */
+	wmb();
+	cookie = tx->tx_submit(tx);
+	if (dma_submit_error(cookie))
+		return -EIO;
+	dma_async_issue_pending(chan);
+
+	if (!wait_for_completion_timeout(&fb_data->memcpy_cmpl, HZ / 10)) {
+		dev_err(fb_data->dev, "Update copy DMA timed out\n");
+		chan->device->device_control(chan, DMA_TERMINATE_ALL, 0);
+		return -ETIMEDOUT;
+	}
+	if (dma_async_is_tx_complete(chan, cookie, NULL, NULL) != DMA_SUCCESS)
+		return -EIO;
+
+	return 0;
+}
+
 static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 	struct update_data_list *upd_data_list)
 {
@@ -1896,6 +2356,8 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 	int left_offs, right_offs;
 	int x_trailing_bytes, y_trailing_bytes;
 	int alt_buf_offset;
+	dma_addr_t src_phys;
+	size_t len;
 
 	/* Set source buf pointer based on input source, panning, etc. */
 	if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
@@ -1907,6 +2369,7 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 		src_ptr = fb_data->info.screen_base + alt_buf_offset
 			+ src_upd_region->top * src_stride;
 	} else {
+		alt_buf_offset = fb_data->fb_offset;
 		src_upd_region = &upd_data->update_region;
 		src_stride = fb_data->epdc_fb_var.xres_virtual * bpp/8;
 		src_ptr = fb_data->info.screen_base + fb_data->fb_offset
@@ -1919,9 +2382,28 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 	x_trailing_bytes = (ALIGN(src_upd_region->width, 8)
 		- src_upd_region->width) * bpp/8;
 
+	/*
+	 * Full width regions are one contiguous block in both buffers; hand
+	 * large ones to the SDMA instead of copying them line by line.
+	 */
+	len = src_upd_region->height * src_stride;
+	if (!left_offs && right_offs == src_stride &&
+		temp_buf_stride == src_stride &&
+		fb_data->copy_dma_threshold &&
+		len >= fb_data->copy_dma_threshold) {
+		src_phys = fb_data->info.fix.smem_start + alt_buf_offset
+			+ src_upd_region->top * src_stride;
+		if (!epdc_dma_copy(fb_data, upd_data_list->phys_addr_copybuf,
+			src_phys, len)) {
+			temp_buf_ptr += len;
+			fb_data->copy_dma_cnt++;
+			goto trailing;
+		}
+	}
+
 	for (i = 0; i < src_upd_region->height; i++) {
 		/* Copy the full line */
-		memcpy(temp_buf_ptr, src_ptr + left_offs,
+		memcpy_neon(temp_buf_ptr, src_ptr + left_offs,
 			src_upd_region->width * bpp/8);
 
 		/* Clear any unwanted pixels at the end of each line */
@@ -1934,6 +2416,7 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 		src_ptr += src_stride;
 	}
 
+trailing:
 	/* Clear any unwanted pixels at the bottom of the end of each line */
 	if (src_upd_region->height & 0x7) {
 		y_trailing_bytes = (ALIGN(src_upd_region->height, 8)
@@ -1941,6 +2424,87 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 			ALIGN(src_upd_region->width, 8) * bpp/8;
 		memset(temp_buf_ptr, 0x0, y_trailing_bytes);
 	}
+
+	fb_data->copy_cnt++;
+	fb_data->copy_bytes += ALIGN(src_upd_region->height, 8) *
+		temp_buf_stride;
+}
+
+/*
+ * Check whether the PxP can read an unaligned update region in place.
+ *
+ * The PxP always works on the 8x8-aligned superset of the update region,
+ * so reading straight from the source buffer is only a problem for the
+ * pixels that fall outside the update region: they participate in the
+ * auto-waveform histogram.  Extra pixels can only widen the set of gray
+ * levels seen, so the selected waveform is never less capable than the
+ * one chosen from the zero-padded copy - at worst a slower one is used.
+ *
+ * The aligned superset must stay inside the source buffer allocation, and
+ * line overflow (case 3 below) still needs the copy.
+ */
+static bool epdc_can_skip_copy(struct mxc_epdc_fb_data *fb_data,
+	struct update_desc_list *upd_desc_list,
+	struct mxcfb_rect *src_upd_region, bool line_overflow)
+{
+	u32 limit_width, limit_height;
+
+	if (!fb_data->zero_copy || line_overflow)
+		return false;
+
+	if (upd_desc_list->upd_data.flags & EPDC_FLAG_USE_ALT_BUFFER) {
+		limit_width = upd_desc_list->upd_data.alt_buffer_data.width;
+		limit_height = upd_desc_list->upd_data.alt_buffer_data.height;
+	} else {
+		/* Each screen is padded out to a multiple of 128 lines */
+		limit_width = fb_data->epdc_fb_var.xres_virtual;
+		limit_height = fb_data->epdc_fb_var.yres_virtual -
+			fb_data->epdc_fb_var.yoffset;
+	}
+
+	if ((ALIGN(src_upd_region->left + src_upd_region->width, 8) >
+		(limit_width & ~0x7)) ||
+		(ALIGN(src_upd_region->top + src_upd_region->height, 8) >
+		(limit_height & ~0x7)))
+		return false;
+
+	return true;
+}
+
+/* Map the PxP histogram status onto a MXCFB_HIST_CLASS_* */
+static u32 epdc_hist_class(u32 hist_stat)
+{
+	if (hist_stat & 0x1)
+		return MXCFB_HIST_CLASS_2;
+	else if (hist_stat & 0x2)
+		return MXCFB_HIST_CLASS_4;
+	else if (hist_stat & 0x4)
+		return MXCFB_HIST_CLASS_8;
+	else if (hist_stat & 0x8)
+		return MXCFB_HIST_CLASS_16;
+	return MXCFB_HIST_CLASS_32;
+}
+
+/* Waveform used by WAVEFORM_MODE_AUTO for a histogram class */
+static u32 epdc_hist_waveform(struct mxc_epdc_fb_data *fb_data, u32 class)
+{
+	int mode = fb_data->hist_wv_policy[class - 1];
+
+	if (mode >= 0)
+		return mode;
+
+	switch (class) {
+	case MXCFB_HIST_CLASS_2:
+		return fb_data->wv_modes.mode_du;
+	case MXCFB_HIST_CLASS_4:
+		return fb_data->wv_modes.mode_gc4;
+	case MXCFB_HIST_CLASS_8:
+		return fb_data->wv_modes.mode_gc8;
+	case MXCFB_HIST_CLASS_16:
+		return fb_data->wv_modes.mode_gc16;
+	default:
+		return fb_data->wv_modes.mode_gc32;
+	}
 }
 
 static int epdc_process_update(struct update_data_list *upd_data_list,
@@ -1953,6 +2517,9 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	u32 post_rotation_xcoord, post_rotation_ycoord, width_pxp_blocks;
 	u32 pxp_input_offs, pxp_output_offs, pxp_output_shift;
 	u32 hist_stat = 0;
+	u32 hist_class;
+	struct update_marker_data *next_marker;
+	unsigned long flags;
 	int width_unaligned, height_unaligned;
 	bool input_unaligned = false;
 	bool line_overflow = false;
@@ -2033,6 +2600,18 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	}
 
 	if (((width_unaligned || height_unaligned || input_unaligned) &&
+		(upd_desc_list->upd_data.waveform_mode == WAVEFORM_MODE_AUTO))
+		&& epdc_can_skip_copy(fb_data, upd_desc_list,
+					src_upd_region, line_overflow)) {
+		dev_dbg(fb_data->dev, "Processing unaligned update in place.\n");
+
+		/* PxP source height is programmed in 8-line units */
+		src_height = ALIGN(src_upd_region->top +
+			src_upd_region->height, 8) > src_height ?
+			ALIGN(src_height, 8) : src_height;
+
+		fb_data->zero_copy_cnt++;
+	} else if (((width_unaligned || height_unaligned || input_unaligned) &&
 		(upd_desc_list->upd_data.waveform_mode == WAVEFORM_MODE_AUTO))
 		|| line_overflow) {
 		GALLEN_DBGLOCAL_RUNLOG(3);
@@ -2190,9 +2769,13 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 		fb_data->pxp_conf.proc_data.lut_transform ^= PXP_LUT_INVERT;
 	}
 
+	upd_desc_list->times.pxp_start = ktime_get();
+	trace_mxc_epdc_pxp_submit(upd_desc_list->update_order,
+		upd_desc_list->upd_data.waveform_mode);
+
 	/* This is a blocking call, so upon return PxP tx should be done */
 	ret = pxp_process_update(fb_data, src_width, src_height,
-		&pxp_upd_region);
+		&pxp_upd_region, fb_data->epdc_fb_var.rotate * 90);
 	if (ret) {
 		dev_err(fb_data->dev, "Unable to submit PxP update task.\n");
 		mutex_unlock(&fb_data->pxp_mutex);
@@ -2216,41 +2799,25 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 		return ret;
 	}
 
+	upd_desc_list->times.pxp_done = ktime_get();
+	trace_mxc_epdc_pxp_complete(upd_desc_list->update_order, hist_stat);
+
 	mutex_unlock(&fb_data->pxp_mutex);
 
+	/* Let the markers report what the histogram found */
+	hist_class = epdc_hist_class(hist_stat);
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	list_for_each_entry(next_marker, &upd_desc_list->upd_marker_list,
+		upd_list)
+		next_marker->hist_class = max(next_marker->hist_class,
+					      hist_class);
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
 	/* Update waveform mode from PxP histogram results */
 	if (upd_desc_list->upd_data.waveform_mode == WAVEFORM_MODE_AUTO) {
 		GALLEN_DBGLOCAL_RUNLOG(17);
-		if (hist_stat & 0x1)
-		{
-			GALLEN_DBGLOCAL_RUNLOG(18);
-			upd_desc_list->upd_data.waveform_mode =
-				fb_data->wv_modes.mode_du;
-		}
-		else if (hist_stat & 0x2)
-		{
-			GALLEN_DBGLOCAL_RUNLOG(19);
-			upd_desc_list->upd_data.waveform_mode =
-				fb_data->wv_modes.mode_gc4;
-		}
-		else if (hist_stat & 0x4)
-		{
-			GALLEN_DBGLOCAL_RUNLOG(20);
-			upd_desc_list->upd_data.waveform_mode =
-				fb_data->wv_modes.mode_gc8;
-		}
-		else if (hist_stat & 0x8)
-		{
-			GALLEN_DBGLOCAL_RUNLOG(21);
-			upd_desc_list->upd_data.waveform_mode =
-				fb_data->wv_modes.mode_gc16;
-		}
-		else
-		{
-			GALLEN_DBGLOCAL_RUNLOG(22);
-			upd_desc_list->upd_data.waveform_mode =
-				fb_data->wv_modes.mode_gc32;
-		}
+		upd_desc_list->upd_data.waveform_mode =
+			epdc_hist_waveform(fb_data, hist_class);
 
 		dev_dbg(fb_data->dev, "hist_stat = 0x%x, new waveform = 0x%x\n",
 			hist_stat, upd_desc_list->upd_data.waveform_mode);
@@ -2261,21 +2828,24 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 
 }
 
-static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
-				struct update_desc_list *update_to_merge,
-				int merge_on_waveform_mismatch)
+static int epdc_submit_merge(struct mxc_epdc_fb_data *fb_data,
+				struct update_desc_list *upd_desc_list,
+				struct update_desc_list *update_to_merge)
 {
 	struct mxcfb_update_data *a, *b;
 	struct mxcfb_rect *arect, *brect;
 	struct mxcfb_rect combine;
 	bool use_flags = false;
-	int waveform_mismatch;
+	u64 area_a, area_b, area_both, area_union, area_combine;
+	u32 ileft, itop, iright, ibottom;
 
 	a = &upd_desc_list->upd_data;
 	b = &update_to_merge->upd_data;
 	arect = &upd_desc_list->upd_data.update_region;
 	brect = &update_to_merge->upd_data.update_region;
 
+	fb_data->merge_attempts++;
+
 	/*
 	 * Updates with different flags must be executed sequentially.
 	 * Halt the merge process to ensure this.
@@ -2288,32 +2858,33 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 		if ((arect->left != brect->left) ||
 			(arect->top != brect->top) ||
 			(arect->width != brect->width) ||
-			(arect->height != brect->height))
+			(arect->height != brect->height)) {
+			fb_data->merge_rejects[EPDC_MERGE_REJ_FLAGS]++;
 			return MERGE_BLOCK;
+		}
 
 		use_flags = true;
 	}
 
-	if (merge_on_waveform_mismatch) {
-		if (a->update_mode != b->update_mode)
-			a->update_mode = UPDATE_MODE_FULL;
-
-		if (a->waveform_mode != b->waveform_mode)
-			a->waveform_mode = WAVEFORM_MODE_AUTO;
-
-		waveform_mismatch = 0;
-	} else {
-		waveform_mismatch = (a->waveform_mode != b->waveform_mode &&
-		                     a->waveform_mode != WAVEFORM_MODE_AUTO) ||
-		                    a->update_mode != b->update_mode;
+	if (!fb_data->merge_on_waveform_mismatch) {
+		if (a->waveform_mode != b->waveform_mode &&
+		    a->waveform_mode != WAVEFORM_MODE_AUTO) {
+			fb_data->merge_rejects[EPDC_MERGE_REJ_WAVEFORM]++;
+			return MERGE_FAIL;
+		}
+		if (a->update_mode != b->update_mode) {
+			fb_data->merge_rejects[EPDC_MERGE_REJ_MODE]++;
+			return MERGE_FAIL;
+		}
 	}
 
-	if (waveform_mismatch ||
-		arect->left > (brect->left + brect->width) ||
+	if (arect->left > (brect->left + brect->width) ||
 		brect->left > (arect->left + arect->width) ||
 		arect->top > (brect->top + brect->height) ||
-		brect->top > (arect->top + arect->height))
+		brect->top > (arect->top + arect->height)) {
+		fb_data->merge_rejects[EPDC_MERGE_REJ_APART]++;
 		return MERGE_FAIL;
+	}
 
 	combine.left = arect->left < brect->left ? arect->left : brect->left;
 	combine.top = arect->top < brect->top ? arect->top : brect->top;
@@ -2326,6 +2897,40 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 			(arect->top + arect->height - combine.top) :
 			(brect->top + brect->height - combine.top);
 
+	/* The regions touch at least, so the intersection is not negative */
+	ileft = max(arect->left, brect->left);
+	itop = max(arect->top, brect->top);
+	iright = min(arect->left + arect->width, brect->left + brect->width);
+	ibottom = min(arect->top + arect->height, brect->top + brect->height);
+
+	area_a = (u64)arect->width * arect->height;
+	area_b = (u64)brect->width * brect->height;
+	area_both = (u64)(iright - ileft) * (ibottom - itop);
+	area_union = area_a + area_b - area_both;
+	area_combine = (u64)combine.width * combine.height;
+
+	/*
+	 * Two thin updates at right angles can merge into a box much
+	 * larger than either; let them go separately instead.
+	 */
+	if (fb_data->merge_max_growth &&
+		area_combine * 100 > area_union * fb_data->merge_max_growth) {
+		fb_data->merge_rejects[EPDC_MERGE_REJ_GROWTH]++;
+		return MERGE_FAIL;
+	}
+
+	/* Only change the modes once the merge is certain */
+	if (fb_data->merge_on_waveform_mismatch) {
+		if (a->update_mode != b->update_mode)
+			a->update_mode = UPDATE_MODE_FULL;
+
+		if (a->waveform_mode != b->waveform_mode)
+			a->waveform_mode = WAVEFORM_MODE_AUTO;
+	}
+
+	fb_data->merge_accepts++;
+	fb_data->merge_added_pixels += area_combine - area_union;
+
 	*arect = combine;
 
 	/* Use flags of the later update */
@@ -2336,6 +2941,16 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 	list_splice_tail(&update_to_merge->upd_marker_list,
 		&upd_desc_list->upd_marker_list);
 
+	/* Keep timing the merged update from its earliest request */
+	if (ktime_to_ns(update_to_merge->times.send) <
+		ktime_to_ns(upd_desc_list->times.send))
+		upd_desc_list->times.send = update_to_merge->times.send;
+	if (ktime_to_ns(update_to_merge->times.touch) &&
+		(ktime_to_ns(upd_desc_list->times.touch) == 0 ||
+		 ktime_to_ns(update_to_merge->times.touch) <
+		 ktime_to_ns(upd_desc_list->times.touch)))
+		upd_desc_list->times.touch = update_to_merge->times.touch;
+
 	/* Merged update should take on the earliest order */
 	upd_desc_list->update_order =
 		(upd_desc_list->update_order > update_to_merge->update_order) ?
@@ -2351,6 +2966,22 @@ static void epdc_firmware_func(struct work_struct *work)
 	struct mxc_epdc_fb_data *fb_data =
 		container_of(work, struct mxc_epdc_fb_data, epdc_firmware_work);
 	struct firmware fw;
+	int ret;
+
+	/*
+	 * No waveform from the bootloader: fall back to the firmware
+	 * loader, which can satisfy the request from a waveform built into
+	 * the kernel image without waiting for the root filesystem.
+	 */
+	if (!gpbWF_vaddr || !gdwWF_size) {
+		ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+				fb_data->fw_str, fb_data->dev, GFP_KERNEL,
+				fb_data, mxc_epdc_fb_fw_handler);
+		if (ret)
+			dev_err(fb_data->dev,
+				"Failed request_firmware_nowait err %d\n", ret);
+		return;
+	}
 
 	fw.size = gdwWF_size;
 	fw.data = (u8*)gpbWF_vaddr;
@@ -2361,717 +2992,1161 @@ static void epdc_firmware_func(struct work_struct *work)
 
 #endif //]FW_IN_RAM
 
-static void epdc_submit_work_func(struct work_struct *work)
+/*
+ * Waveform cache.
+ *
+ * The waveform data starts with a table of 64-bit offsets, one per mode,
+ * to a table of 64-bit offsets, one per temperature range, to the
+ * waveform itself. Instead of copying the whole file into DMA memory
+ * before the first update, only the temperature ranges that have been
+ * used are kept in waveform_buffer, and the tables are rebuilt so every
+ * other range points at the nearest resident one. A missing range is
+ * built from wv_src by wv_load_work and switched in once the EPDC is
+ * idle; until then updates use the nearest resident range.
+ */
+static int epdc_wv_bound_cmp(const void *a, const void *b)
 {
-	int temp_index;
-	struct update_data_list *next_update, *temp_update;
-	struct update_desc_list *next_desc, *temp_desc;
-	struct update_marker_data *next_marker, *temp_marker;
-	unsigned long flags;
-	struct mxc_epdc_fb_data *fb_data =
-		container_of(work, struct mxc_epdc_fb_data, epdc_submit_work);
-	struct update_data_list *upd_data_list = NULL;
-	struct mxcfb_rect adj_update_region;
-	bool end_merge = false;
-	int *err_dist;
-	int ret;
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
 
-	GALLEN_DBGLOCAL_BEGIN();
-	/* Protect access to buffer queues and to update HW */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	return x < y ? -1 : x > y;
+}
 
-	/*
-	 * Are any of our collision updates able to go now?
-	 * Go through all updates in the collision list and check to see
-	 * if the collision mask has been fully cleared
-	 */
-	list_for_each_entry_safe(next_update, temp_update,
-				&fb_data->upd_buf_collision_list, list) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
+static u32 epdc_wv_offs(struct mxc_epdc_fb_data *fb_data, int mode, int temp)
+{
+	const u8 *src = fb_data->wv_src;
+	u32 tbl = get_unaligned_le64(src + mode * 8);
 
-		if (next_update->collision_mask != 0) {
-			GALLEN_DBGLOCAL_RUNLOG(1);
-			continue;
-		}
+	return get_unaligned_le64(src + tbl + temp * 8);
+}
 
-		dev_dbg(fb_data->dev, "A collision update is ready to go!\n");
+/* Index of the data block starting at offs in the sorted bounds table */
+static int epdc_wv_block(struct mxc_epdc_fb_data *fb_data, u32 offs)
+{
+	int lo = 0, hi = fb_data->wv_nbounds - 1, mid;
 
-		if (fb_data->merge_on_waveform_mismatch) {
-			/* Force waveform mode to auto for resubmitted collisions */
-			next_update->update_desc->upd_data.waveform_mode =
-				WAVEFORM_MODE_AUTO;
-		}
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (fb_data->wv_bounds[mid] < offs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-		/*
-		 * We have a collision cleared, so select it for resubmission.
-		 * If an update is already selected, attempt to merge.
-		 */
-		if (!upd_data_list) {
-			GALLEN_DBGLOCAL_RUNLOG(2);
-			upd_data_list = next_update;
-			list_del_init(&next_update->list);
-			if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) {
-				GALLEN_DBGLOCAL_RUNLOG(3);
-				/* If not merging, we have our update */
-				break;
-			}
-		} else {
-			GALLEN_DBGLOCAL_RUNLOG(4);
-			switch (epdc_submit_merge(upd_data_list->update_desc,
-						next_update->update_desc,
-						fb_data->merge_on_waveform_mismatch)) {
-							
-			case MERGE_OK:GALLEN_DBGLOCAL_RUNLOG(5);
-				dev_dbg(fb_data->dev,
-					"Update merged [collision]\n");
-				list_del_init(&next_update->update_desc->list);
-				kfree(next_update->update_desc);
-				next_update->update_desc = NULL;
-				list_del_init(&next_update->list);
-				/* Add to free buffer list */
-				list_add_tail(&next_update->list,
-					 &fb_data->upd_buf_free_list);
-				break;
-			case MERGE_FAIL:GALLEN_DBGLOCAL_RUNLOG(6);
-				dev_dbg(fb_data->dev,
-					"Update not merged [collision]\n");
-				break;
-			case MERGE_BLOCK:GALLEN_DBGLOCAL_RUNLOG(7);
-				dev_dbg(fb_data->dev,
-					"Merge blocked [collision]\n");
-				end_merge = true;
-				break;
-			}
+	return lo;
+}
 
-			if (end_merge) {
-				GALLEN_DBGLOCAL_RUNLOG(8);
-				end_merge = false;
-				break;
-			}
+/*
+ * Check the offset tables of wv_src and record where every table and
+ * waveform starts, which gives the extent of each waveform block.
+ */
+static int epdc_wv_parse(struct mxc_epdc_fb_data *fb_data)
+{
+	const u8 *src = fb_data->wv_src;
+	int modes = fb_data->wv_mode_cnt;
+	int temps = fb_data->trt_entries;
+	u32 size = fb_data->wv_src_size;
+	u64 tbl, offs;
+	int m, t, n = 0, i, j;
+
+	if (temps == 0 || temps > 32 || size < modes * 8)
+		return -EINVAL;
+
+	fb_data->wv_bounds = kmalloc((modes * (temps + 1) + 1) * sizeof(u32),
+				     GFP_KERNEL);
+	if (!fb_data->wv_bounds)
+		return -ENOMEM;
+
+	for (m = 0; m < modes; m++) {
+		tbl = get_unaligned_le64(src + m * 8);
+		if (tbl < modes * 8 || tbl + temps * 8 > size)
+			goto invalid;
+		fb_data->wv_bounds[n++] = tbl;
+		for (t = 0; t < temps; t++) {
+			offs = get_unaligned_le64(src + tbl + t * 8);
+			if (offs < modes * 8 || offs >= size)
+				goto invalid;
+			fb_data->wv_bounds[n++] = offs;
 		}
 	}
+	fb_data->wv_bounds[n++] = size;
 
-	/*
-	 * Skip pending update list only if we found a collision
-	 * update and we are not merging
-	 */
-	if (!((fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) &&
-		upd_data_list)) {
-		GALLEN_DBGLOCAL_RUNLOG(9);
-		/*
-		 * If we didn't find a collision update ready to go, we
-		 * need to get a free buffer and match it to a pending update.
-		 */
+	sort(fb_data->wv_bounds, n, sizeof(u32), epdc_wv_bound_cmp, NULL);
+	for (i = 1, j = 0; i < n; i++)
+		if (fb_data->wv_bounds[i] != fb_data->wv_bounds[j])
+			fb_data->wv_bounds[++j] = fb_data->wv_bounds[i];
+	fb_data->wv_nbounds = j + 1;
 
-		/*
-		 * Can't proceed if there are no free buffers (and we don't
-		 * already have a collision update selected)
-		*/
-		if (!upd_data_list &&
-			list_empty(&fb_data->upd_buf_free_list)) {
-			GALLEN_DBGLOCAL_RUNLOG(10);
-			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-			GALLEN_DBGLOCAL_ESC();
-			return;
-		}
+	return 0;
 
-		list_for_each_entry_safe(next_desc, temp_desc,
-				&fb_data->upd_pending_list, list) {
-			GALLEN_DBGLOCAL_RUNLOG(11);		
+invalid:
+	dev_warn(fb_data->dev, "Unexpected waveform layout, caching disabled\n");
+	kfree(fb_data->wv_bounds);
+	fb_data->wv_bounds = NULL;
+	return -EINVAL;
+}
 
-			dev_dbg(fb_data->dev, "Found a pending update!\n");
+static int epdc_wv_nearest(u32 resident, int temp_index, int temps)
+{
+	int d;
 
-			if (!upd_data_list) {
-				GALLEN_DBGLOCAL_RUNLOG(12);
-				if (list_empty(&fb_data->upd_buf_free_list)) {
-					GALLEN_DBGLOCAL_RUNLOG(13);
-					break;
-				}
-				upd_data_list =
-					list_entry(fb_data->upd_buf_free_list.next,
-						struct update_data_list, list);
-				list_del_init(&upd_data_list->list);
-				upd_data_list->update_desc = next_desc;
-				list_del_init(&next_desc->list);
-				if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) {
-					GALLEN_DBGLOCAL_RUNLOG(14);
-					/* If not merging, we have an update */
-					break;
-				}
-			} else {
-				GALLEN_DBGLOCAL_RUNLOG(15);
-				switch (epdc_submit_merge(upd_data_list->update_desc,
-						next_desc, fb_data->merge_on_waveform_mismatch)) {
-				case MERGE_OK:GALLEN_DBGLOCAL_RUNLOG(16);
-					dev_dbg(fb_data->dev,
-						"Update merged [queue]\n");
-					list_del_init(&next_desc->list);
-					kfree(next_desc);
-					break;
-				case MERGE_FAIL:GALLEN_DBGLOCAL_RUNLOG(17);
-					dev_dbg(fb_data->dev,
-						"Update not merged [queue]\n");
-					break;
-				case MERGE_BLOCK:GALLEN_DBGLOCAL_RUNLOG(18);
-					dev_dbg(fb_data->dev,
-						"Merge blocked [collision]\n");
-					end_merge = true;
-					break;
-				}
+	for (d = 0; d < temps; d++) {
+		if (temp_index - d >= 0 && (resident & (1U << (temp_index - d))))
+			return temp_index - d;
+		if (temp_index + d < temps && (resident & (1U << (temp_index + d))))
+			return temp_index + d;
+	}
 
-				if (end_merge) {
-					GALLEN_DBGLOCAL_RUNLOG(19);
-					break;
-				}
-			}
+	return temp_index;
+}
+
+/* Build a waveform buffer holding the temperature ranges in resident */
+static int epdc_wv_build(struct mxc_epdc_fb_data *fb_data, u32 resident,
+			 u32 **virt, u32 *phys, u32 *size)
+{
+	int modes = fb_data->wv_mode_cnt;
+	int temps = fb_data->trt_entries;
+	u32 *placed, offs, len, pos;
+	u64 *tbl;
+	u8 *buf;
+	int m, t, b;
+
+	placed = kzalloc(fb_data->wv_nbounds * sizeof(u32), GFP_KERNEL);
+	if (!placed)
+		return -ENOMEM;
+
+	/* Offset tables first, then each needed block, keeping alignment */
+	pos = modes * (temps + 1) * 8;
+	for (m = 0; m < modes; m++)
+		for (t = 0; t < temps; t++) {
+			if (!(resident & (1U << t)))
+				continue;
+			b = epdc_wv_block(fb_data, epdc_wv_offs(fb_data, m, t));
+			if (placed[b])
+				continue;
+			offs = fb_data->wv_bounds[b];
+			len = fb_data->wv_bounds[b + 1] - offs;
+			pos = ALIGN(pos, 8) + (offs & 7);
+			placed[b] = pos;
+			pos += len;
+		}
+	*size = pos;
+
+	buf = dma_alloc_coherent(fb_data->dev, *size, phys, GFP_KERNEL);
+	if (!buf) {
+		kfree(placed);
+		return -ENOMEM;
+	}
+
+	tbl = (u64 *)buf;
+	for (m = 0; m < modes; m++) {
+		tbl[m] = cpu_to_le64((modes + m * temps) * 8);
+		for (t = 0; t < temps; t++) {
+			offs = epdc_wv_offs(fb_data, m,
+				epdc_wv_nearest(resident, t, temps));
+			b = epdc_wv_block(fb_data, offs);
+			tbl[modes + m * temps + t] = cpu_to_le64(placed[b]);
 		}
 	}
 
-	/* Release buffer queues */
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	for (b = 0; b < fb_data->wv_nbounds - 1; b++)
+		if (placed[b])
+			memcpy(buf + placed[b],
+			       fb_data->wv_src + fb_data->wv_bounds[b],
+			       fb_data->wv_bounds[b + 1] - fb_data->wv_bounds[b]);
 
-	/* Is update list empty? */
-	if (!upd_data_list) {
-		GALLEN_DBGLOCAL_ESC();
+	kfree(placed);
+	*virt = (u32 *)buf;
+
+	return 0;
+}
+
+/*
+ * Switch to the buffer built by wv_load_work. Only called while no LUT
+ * is active; the replaced buffer is freed by wv_load_work.
+ */
+static void epdc_wv_install(struct mxc_epdc_fb_data *fb_data)
+{
+	unsigned long flags;
+	bool installed = false;
+
+	spin_lock_irqsave(&fb_data->wv_lock, flags);
+	if (fb_data->wv_next_virt && !fb_data->wv_old_virt) {
+		__raw_writel(fb_data->wv_next_phys, EPDC_WVADDR);
+		fb_data->wv_old_virt = fb_data->waveform_buffer_virt;
+		fb_data->wv_old_phys = fb_data->waveform_buffer_phys;
+		fb_data->wv_old_size = fb_data->waveform_buffer_size;
+		fb_data->waveform_buffer_virt = fb_data->wv_next_virt;
+		fb_data->waveform_buffer_phys = fb_data->wv_next_phys;
+		fb_data->waveform_buffer_size = fb_data->wv_next_size;
+		fb_data->wv_resident = fb_data->wv_next_resident;
+		fb_data->wv_next_virt = NULL;
+		fb_data->wv_loads++;
+		installed = true;
+	}
+	spin_unlock_irqrestore(&fb_data->wv_lock, flags);
+
+	if (installed)
+		schedule_work(&fb_data->wv_load_work);
+}
+
+/*
+ * Temperature index to program for an update. A range that is not
+ * resident yet is queued for loading and the nearest one is used.
+ */
+static int epdc_wv_temp_index(struct mxc_epdc_fb_data *fb_data,
+			      int temp_index)
+{
+	unsigned long flags;
+	u32 resident;
+
+	if (temp_index < 0 || temp_index >= 32)
+		return temp_index;
+
+	spin_lock_irqsave(&fb_data->wv_lock, flags);
+	resident = fb_data->wv_resident;
+	if (!(resident & (1U << temp_index))) {
+		fb_data->wv_wanted |= 1U << temp_index;
+		schedule_work(&fb_data->wv_load_work);
+	}
+	spin_unlock_irqrestore(&fb_data->wv_lock, flags);
+
+	return epdc_wv_nearest(resident, temp_index, fb_data->trt_entries);
+}
+
+static void epdc_wv_free_old(struct mxc_epdc_fb_data *fb_data)
+{
+	unsigned long flags;
+	u32 *virt;
+	u32 phys, size;
+
+	spin_lock_irqsave(&fb_data->wv_lock, flags);
+	virt = fb_data->wv_old_virt;
+	phys = fb_data->wv_old_phys;
+	size = fb_data->wv_old_size;
+	fb_data->wv_old_virt = NULL;
+	spin_unlock_irqrestore(&fb_data->wv_lock, flags);
+
+	if (virt)
+		dma_free_coherent(fb_data->dev, size, virt, phys);
+}
+
+static void epdc_wv_load_work_func(struct work_struct *work)
+{
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data, wv_load_work);
+	unsigned long flags;
+	u32 want, *virt, *stale, phys, stale_phys, size, stale_size;
+
+	epdc_wv_free_old(fb_data);
+
+	if (!fb_data->wv_bounds)
+		return;
+
+	spin_lock_irqsave(&fb_data->wv_lock, flags);
+	want = fb_data->wv_resident | fb_data->wv_wanted;
+	if (fb_data->wv_next_virt)
+		want |= fb_data->wv_next_resident;
+	if (want == (fb_data->wv_next_virt ? fb_data->wv_next_resident :
+		     fb_data->wv_resident)) {
+		spin_unlock_irqrestore(&fb_data->wv_lock, flags);
 		return;
 	}
+	spin_unlock_irqrestore(&fb_data->wv_lock, flags);
 
-	/* Perform PXP processing - EPDC power will also be enabled */
-	if (epdc_process_update(upd_data_list, fb_data)) {
-		dev_dbg(fb_data->dev, "PXP processing error.\n");
-		/* Protect access to buffer queues and to update HW */
-		spin_lock_irqsave(&fb_data->queue_lock, flags);
-		list_del_init(&upd_data_list->update_desc->list);
-		kfree(upd_data_list->update_desc);
-		upd_data_list->update_desc = NULL;
-		/* Add to free buffer list */
-		list_add_tail(&upd_data_list->list,
-			&fb_data->upd_buf_free_list);
-		/* Release buffer queues */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		GALLEN_DBGLOCAL_ESC();
+	if (epdc_wv_build(fb_data, want, &virt, &phys, &size)) {
+		dev_err(fb_data->dev, "Can't allocate mem for waveform!\n");
 		return;
 	}
 
-	/* Get rotation-adjusted coordinates */
-	adjust_coordinates(fb_data,
-		&upd_data_list->update_desc->upd_data.update_region,
-		&adj_update_region);
+	/* Replace a buffer that has not been switched in yet */
+	spin_lock_irqsave(&fb_data->wv_lock, flags);
+	stale = fb_data->wv_next_virt;
+	stale_phys = fb_data->wv_next_phys;
+	stale_size = fb_data->wv_next_size;
+	fb_data->wv_next_virt = virt;
+	fb_data->wv_next_phys = phys;
+	fb_data->wv_next_size = size;
+	fb_data->wv_next_resident = want;
+	spin_unlock_irqrestore(&fb_data->wv_lock, flags);
 
-	/* Protect access to buffer queues and to update HW */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (stale)
+		dma_free_coherent(fb_data->dev, stale_size, stale, stale_phys);
 
-	/*
-	 * Is the working buffer idle?
-	 * If the working buffer is busy, we must wait for the resource
-	 * to become free. The IST will signal this event.
-	 */
-	if (fb_data->cur_update != NULL) {
-		GALLEN_DBGLOCAL_RUNLOG(20);
-		dev_dbg(fb_data->dev, "working buf busy!\n");
+	/* With the panel powered down nothing is using the old buffer */
+	mutex_lock(&fb_data->power_mutex);
+	if (fb_data->power_state == POWER_STATE_OFF) {
+		clk_enable(fb_data->epdc_clk_axi);
+		epdc_wv_install(fb_data);
+		clk_disable(fb_data->epdc_clk_axi);
+	}
+	mutex_unlock(&fb_data->power_mutex);
+}
 
-		/* Initialize event signalling an update resource is free */
-		init_completion(&fb_data->update_res_free);
+#ifdef CONFIG_FB_MXC_EINK_WAVEFORM_GZIP
+/* Inflate a gzip compressed waveform file into a vmalloc buffer */
+static int epdc_wv_gunzip(struct mxc_epdc_fb_data *fb_data, const u8 *data,
+			  size_t size, u8 **out, size_t *out_size)
+{
+	size_t pos = 10;
+	u32 isize;
+	u8 flags;
+	int ret;
 
-		fb_data->waiting_for_wb = true;
+	if (size < 18)
+		return -EINVAL;
 
-		/* Leave spinlock while waiting for WB to complete */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		wait_for_completion(&fb_data->update_res_free);
-		spin_lock_irqsave(&fb_data->queue_lock, flags);
-	}
+	flags = data[3];
+	if (flags & 0x04)	/* FEXTRA */
+		pos += 2 + get_unaligned_le16(data + pos);
+	if (flags & 0x08)	/* FNAME */
+		while (pos < size && data[pos++])
+			;
+	if (flags & 0x10)	/* FCOMMENT */
+		while (pos < size && data[pos++])
+			;
+	if (flags & 0x02)	/* FHCRC */
+		pos += 2;
+	if (pos + 8 > size)
+		return -EINVAL;
 
-	/*
-	 * Dithering Processing
-	 */
-	if (upd_data_list->update_desc->upd_data.flags & EPDC_FLAG_USE_DITHERING_Y1) {
-		/* Dithering Y8 -> Y1 */
-		do_dithering_processing_Y1_v1_0(
-			(uint8_t *)(upd_data_list->virt_addr +
-				upd_data_list->update_desc->epdc_offs),
-			adj_update_region.width, adj_update_region.height,
-			ALIGN(adj_update_region.width, 8));
-		
-		// NEON version (faster but less readable)
-		/*kernel_neon_begin();
-		dither_neon_Y1(
-			(uint8_t *)(upd_data_list->virt_addr +
-				upd_data_list->update_desc->epdc_offs),
-			adj_update_region.width, adj_update_region.height,
-			ALIGN(adj_update_region.width, 8));
-		kernel_neon_end();*/
-	} else if (upd_data_list->update_desc->upd_data.flags & EPDC_FLAG_USE_DITHERING_Y4) {
-		/* Dithering Y8 -> Y1 */
-		do_dithering_processing_Y4_v1_0(
-			(uint8_t *)(upd_data_list->virt_addr +
-				upd_data_list->update_desc->epdc_offs),
-			adj_update_region.width, adj_update_region.height,
-			ALIGN(adj_update_region.width, 8));
+	isize = get_unaligned_le32(data + size - 4);
+	*out = vmalloc(isize);
+	if (!*out)
+		return -ENOMEM;
+
+	ret = zlib_inflate_blob(*out, isize, data + pos, size - pos - 8);
+	if (ret != isize) {
+		dev_err(fb_data->dev, "Corrupt compressed waveform\n");
+		vfree(*out);
+		return -EINVAL;
 	}
-	
-	/*
-	 * If there are no LUTs available,
-	 * then we must wait for the resource to become free.
-	 * The IST will signal this event.
-	 */
-	if (!epdc_any_luts_available()) {
-		GALLEN_DBGLOCAL_RUNLOG(21);
-		dev_dbg(fb_data->dev, "no luts available!\n");
+	*out_size = isize;
 
-		/* Initialize event signalling an update resource is free */
-		init_completion(&fb_data->update_res_free);
+	return 0;
+}
+#endif
 
-		fb_data->waiting_for_lut = true;
+/*
+ * Update (PxP output) buffer pool. upd_buf_min buffers are allocated at
+ * probe and always kept; the submit work grows the pool up to
+ * upd_buf_max when updates are pending and no buffer is free, and the
+ * extra buffers are released again once the EPDC has been idle for
+ * EPDC_UPD_BUF_SHRINK_DELAY.
+ */
+static struct update_data_list *
+epdc_alloc_upd_buffer(struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_data_list *upd_list;
 
-		/* Leave spinlock while waiting for LUT to free up */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		wait_for_completion(&fb_data->update_res_free);
-		spin_lock_irqsave(&fb_data->queue_lock, flags);
-	}
+	upd_list = kzalloc(sizeof(*upd_list), GFP_KERNEL);
+	if (upd_list == NULL)
+		return NULL;
 
-	ret = epdc_choose_next_lut(&upd_data_list->lut_num);
 	/*
-	 * If LUT15 is in use:
-	 *   - Wait for LUT15 to complete is if TCE underrun prevent is enabled
-	 *   - If we go ahead with update, sync update submission with EOF
+	 * Each update buffer is 1 byte per pixel, and can
+	 * be as big as the full-screen frame buffer
 	 */
-	if (ret && fb_data->tce_prevent) {
-		dev_dbg(fb_data->dev, "Waiting for LUT15\n");
+	upd_list->size = fb_data->upd_buf_size;
 
-		/* Initialize event signalling that lut15 is free */
-		init_completion(&fb_data->lut15_free);
+	/*
+	 * Allocate memory for PxP output buffer.  The EPDC and PxP reach
+	 * all of memory, so don't restrict this to ZONE_DMA; GFP_KERNEL
+	 * lets the allocator reclaim and compact for the contiguous range
+	 * when the pool grows after boot.
+	 */
+	upd_list->virt_addr =
+	    dma_alloc_coherent(fb_data->info.device, upd_list->size,
+			       &upd_list->phys_addr, GFP_KERNEL);
+	if (upd_list->virt_addr == NULL)
+		goto out_free;
+
+	/* Allocate memory for PxP SW workaround buffers */
+	/* These buffers are used to hold copy of the update region */
+	upd_list->virt_addr_copybuf =
+	    dma_alloc_coherent(fb_data->info.device, upd_list->size*2,
+			       &upd_list->phys_addr_copybuf, GFP_KERNEL);
+	if (upd_list->virt_addr_copybuf == NULL)
+		goto out_free_buf;
+
+	dev_dbg(fb_data->info.device, "allocated %d bytes @ 0x%08X\n",
+		upd_list->size, upd_list->phys_addr);
+
+	return upd_list;
+
+out_free_buf:
+	dma_free_coherent(fb_data->info.device, upd_list->size,
+			  upd_list->virt_addr, upd_list->phys_addr);
+out_free:
+	kfree(upd_list);
+	return NULL;
+}
 
-		fb_data->waiting_for_lut15 = true;
+static void epdc_free_upd_buffer(struct mxc_epdc_fb_data *fb_data,
+				 struct update_data_list *upd_list)
+{
+	dma_free_coherent(fb_data->info.device, upd_list->size,
+			  upd_list->virt_addr, upd_list->phys_addr);
+	dma_free_coherent(fb_data->info.device, upd_list->size*2,
+			  upd_list->virt_addr_copybuf,
+			  upd_list->phys_addr_copybuf);
+	kfree(upd_list);
+}
 
-		/* Leave spinlock while waiting for LUT to free up */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		wait_for_completion(&fb_data->lut15_free);
-		spin_lock_irqsave(&fb_data->queue_lock, flags);
+/* Add one buffer to the free list; returns false at upd_buf_max or OOM */
+static bool epdc_grow_upd_buffers(struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_data_list *upd_list;
+	unsigned long flags;
 
-		epdc_choose_next_lut(&upd_data_list->lut_num);
-	} else if (ret) {
-		/* Synchronize update submission time to reduce
-		   chances of TCE underrun */
-		init_completion(&fb_data->eof_event);
+	if (fb_data->upd_buf_count >= fb_data->upd_buf_max)
+		return false;
 
-		epdc_eof_intr(true);
+	upd_list = epdc_alloc_upd_buffer(fb_data);
 
-		/* Leave spinlock while waiting for EOF event */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (upd_list == NULL) {
+		fb_data->upd_buf_alloc_failures++;
 		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		ret = wait_for_completion_timeout(&fb_data->eof_event,
-			msecs_to_jiffies(1000));
-		if (!ret) {
-			dev_err(fb_data->dev, "Missed EOF event!\n");
-			epdc_eof_intr(false);
-		}
-		udelay(fb_data->eof_sync_period);
+		return false;
+	}
+	if (fb_data->upd_buf_count >= fb_data->upd_buf_max) {
+		/* Lost a race with another grower or a lowered max */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		epdc_free_upd_buffer(fb_data, upd_list);
+		return false;
+	}
+	list_add_tail(&upd_list->list, &fb_data->upd_buf_free_list);
+	fb_data->upd_buf_count++;
+	fb_data->upd_buf_grown++;
+	if (fb_data->upd_buf_count > fb_data->upd_buf_peak)
+		fb_data->upd_buf_peak = fb_data->upd_buf_count;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return true;
+}
+
+static void epdc_upd_buf_shrink_work_func(struct work_struct *work)
+{
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data,
+			upd_buf_shrink_work.work);
+	struct update_data_list *upd_list;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	while (!fb_data->updates_active &&
+	       fb_data->upd_buf_count > fb_data->upd_buf_min &&
+	       !list_empty(&fb_data->upd_buf_free_list)) {
+		upd_list = list_entry(fb_data->upd_buf_free_list.prev,
+				      struct update_data_list, list);
+		list_del_init(&upd_list->list);
+		fb_data->upd_buf_count--;
+		fb_data->upd_buf_shrunk++;
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+		epdc_free_upd_buffer(fb_data, upd_list);
+
 		spin_lock_irqsave(&fb_data->queue_lock, flags);
+	}
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+}
+
+static inline bool epdc_rects_overlap(struct mxcfb_rect *a,
+				      struct mxcfb_rect *b)
+{
+	return (a->left < b->left + b->width) &&
+		(b->left < a->left + a->width) &&
+		(a->top < b->top + b->height) &&
+		(b->top < a->top + a->height);
+}
+
+/* Remember the panel region a LUT is driving, for the scheduler */
+static inline void epdc_sched_track_lut(struct mxc_epdc_fb_data *fb_data,
+					u32 lut_num, struct mxcfb_rect *region)
+{
+	fb_data->lut_region[lut_num] = *region;
+}
+
+static bool epdc_sched_low_latency(struct mxc_epdc_fb_data *fb_data,
+				   struct update_desc_list *desc)
+{
+	u32 mode = desc->upd_data.waveform_mode;
+
+	return (mode == fb_data->wv_modes.mode_du) ||
+		(mode == EPDC_WAVEFORM_MODE_A2);
+}
+
+/*
+ * Choose the next pending update. Within the first EPDC_SCHED_LOOKAHEAD
+ * entries, prefer updates that do not overlap a region an active LUT
+ * is still driving (they would only collide and come back), then
+ * low-latency waveforms, then queue order. An update never overtakes
+ * an earlier pending update that it overlaps, and the head of the queue
+ * is taken unconditionally once it has been passed over
+ * EPDC_SCHED_MAX_SKIPS times.
+ */
+static struct update_desc_list *
+epdc_sched_pick(struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_desc_list *head, *desc, *prev, *best = NULL;
+	struct mxcfb_rect adj;
+	u32 active = epdc_get_active_luts();
+	int best_score = -1, score, n = 0, i;
+
+	head = list_first_entry(&fb_data->upd_pending_list,
+				struct update_desc_list, list);
+	if (head->sched_skips >= EPDC_SCHED_MAX_SKIPS)
+		return head;
+
+	list_for_each_entry(desc, &fb_data->upd_pending_list, list) {
+		if (n++ == EPDC_SCHED_LOOKAHEAD)
+			break;
+
+		/* Keep the order of overlapping updates */
+		list_for_each_entry(prev, &fb_data->upd_pending_list, list) {
+			if (prev == desc)
+				break;
+			if (epdc_rects_overlap(&prev->upd_data.update_region,
+					       &desc->upd_data.update_region))
+				break;
+		}
+		if (prev != desc)
+			continue;
 
+		score = 0;
+		adjust_coordinates(fb_data, &desc->upd_data.update_region,
+			&adj);
+		for (i = 0; i < EPDC_NUM_LUTS; i++)
+			if ((active & (1 << i)) &&
+			    epdc_rects_overlap(&fb_data->lut_region[i], &adj))
+				break;
+		if (i == EPDC_NUM_LUTS)
+			score += 2;
+		if (epdc_sched_low_latency(fb_data, desc))
+			score += 1;
+
+		if (score > best_score) {
+			best = desc;
+			best_score = score;
+			if (score == 3)
+				break;
+		}
 	}
 
-	/* LUTs are available, so we get one here */
-	fb_data->cur_update = upd_data_list;
+	if (best != head)
+		head->sched_skips++;
 
-	/* Reset mask for LUTS that have completed during WB processing */
-	fb_data->luts_complete_wb = 0;
+	return best;
+}
 
-	/* Associate LUT with update marker */
-	list_for_each_entry_safe(next_marker, temp_marker,
-		&upd_data_list->update_desc->upd_marker_list, upd_list)
-		next_marker->lut_num = fb_data->cur_update->lut_num;
+/*
+ * All display pipeline work (update submission and the deferred EPDC
+ * power down) runs on the driver's own RT workqueue, so an update never
+ * waits behind unrelated keventd work.  Note when each item became due
+ * so that the time it then spent waiting for the worker is visible.
+ */
+static void epdc_wq_stamp(struct mxc_epdc_fb_data *fb_data, int item,
+			  unsigned int delay_ms)
+{
+	struct epdc_wq_stat *st = &fb_data->wq_stat[item];
+	unsigned long flags;
 
-	/* Mark LUT with order */
-	fb_data->lut_update_order[upd_data_list->lut_num] =
-		upd_data_list->update_desc->update_order;
+	spin_lock_irqsave(&fb_data->wq_stat_lock, flags);
+	/* Already pending: the earlier stamp stands */
+	if (!ktime_to_ns(st->queued))
+		st->queued = ktime_add_ns(ktime_get(),
+					  (u64)delay_ms * NSEC_PER_MSEC);
+	spin_unlock_irqrestore(&fb_data->wq_stat_lock, flags);
+}
 
-	/* Enable Collision and WB complete IRQs */
-	epdc_working_buf_intr(true);
-	epdc_lut_complete_intr(upd_data_list->lut_num, true);
+static void epdc_wq_account(struct mxc_epdc_fb_data *fb_data, int item)
+{
+	struct epdc_wq_stat *st = &fb_data->wq_stat[item];
+	unsigned long flags;
+	s64 us;
+
+	spin_lock_irqsave(&fb_data->wq_stat_lock, flags);
+	if (ktime_to_ns(st->queued)) {
+		us = max_t(s64, ktime_us_delta(ktime_get(), st->queued), 0);
+		st->queued = ktime_set(0, 0);
+		st->runs++;
+		st->total_us += us;
+		if (us >= USEC_PER_MSEC)
+			st->slow++;
+		if (us > st->max_us)
+			st->max_us = us;
+	}
+	spin_unlock_irqrestore(&fb_data->wq_stat_lock, flags);
+}
 
-	/* Program EPDC update to process buffer */
-	if (upd_data_list->update_desc->upd_data.temp != TEMP_USE_AMBIENT) {
-		GALLEN_DBGLOCAL_RUNLOG(22);
-		temp_index = mxc_epdc_fb_get_temp_index(fb_data,
-			upd_data_list->update_desc->upd_data.temp);
-		epdc_set_temp(temp_index);
-	} else
-		epdc_set_temp(fb_data->temp_index);
-	
-	epdc_set_update_addr(upd_data_list->phys_addr
-				+ upd_data_list->update_desc->epdc_offs);
-	epdc_set_update_coord(adj_update_region.left, adj_update_region.top);
-	epdc_set_update_dimensions(adj_update_region.width,
-				   adj_update_region.height);
-	epdc_submit_update(upd_data_list->lut_num,
-			   upd_data_list->update_desc->upd_data.waveform_mode,
-			   upd_data_list->update_desc->upd_data.update_mode,
-			   false, 0);
+static void epdc_queue_submit(struct mxc_epdc_fb_data *fb_data)
+{
+	epdc_wq_stamp(fb_data, EPDC_WQ_SUBMIT, 0);
+	queue_work(fb_data->epdc_submit_workqueue, &fb_data->epdc_submit_work);
+}
 
-	/* Release buffer queues */
+static void epdc_lat_record(struct mxc_epdc_fb_data *fb_data, u32 mode,
+			    int stage, ktime_t later, ktime_t earlier)
+{
+	s64 ms = ktime_to_ms(ktime_sub(later, earlier));
+	int bucket;
+
+	if (ktime_to_ns(earlier) == 0 || ms < 0)
+		return;
+
+	bucket = (ms >= (1 << (EPDC_LAT_BUCKETS - 2))) ?
+		EPDC_LAT_BUCKETS - 1 : fls((int)ms);
+	fb_data->lat_hist[min_t(u32, mode, EPDC_LAT_MODES - 1)][stage][bucket]++;
+}
+
+/*
+ * Touch-to-photon tracking.  Input drivers stamp touches with
+ * mxc_epdc_fb_note_input(); the next update sent (by touch_tgid, if
+ * set) carries the oldest pending stamp through the pipeline.
+ */
+void mxc_epdc_fb_note_input(ktime_t stamp)
+{
+	struct mxc_epdc_fb_data *fb_data = g_fb_data;
+	unsigned long flags;
+
+	if (!fb_data)
+		return;
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (ktime_to_ns(fb_data->touch_pending) == 0)
+		fb_data->touch_pending = stamp;
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-	
-	GALLEN_DBGLOCAL_END();
 }
+EXPORT_SYMBOL(mxc_epdc_fb_note_input);
 
-int g_want_to_check_render_framebuffer_state = NO_ONE_WANT_TO_CHECK;
-int g_framebuffer_finish_render = FB_STILL_RENDERING;
+/* Called with queue_lock held, once times->send is set */
+static void epdc_claim_touch(struct mxc_epdc_fb_data *fb_data,
+			     struct epdc_upd_times *times)
+{
+	if (ktime_to_ns(fb_data->touch_pending) == 0)
+		return;
+	if (fb_data->touch_tgid && current->tgid != fb_data->touch_tgid)
+		return;
 
-int get_FB_State( void ) {
-	int ret = g_framebuffer_finish_render;
-	return ret;
+	if (ktime_to_ms(ktime_sub(times->send, fb_data->touch_pending)) <=
+	    EPDC_TOUCH_MAX_MS)
+		times->touch = fb_data->touch_pending;
+	fb_data->touch_pending = ktime_set(0, 0);
 }
-EXPORT_SYMBOL(get_FB_State);
 
-void set_want_to_check_fb_state( int want_to_check ) {
-	g_want_to_check_render_framebuffer_state = want_to_check;
-	if ( want_to_check == 0 ) {
-	    g_framebuffer_finish_render = FB_STILL_RENDERING;
-	}
+/* Called with queue_lock held whenever an update is handed to the EPDC */
+static void epdc_note_submit(struct mxc_epdc_fb_data *fb_data,
+			     struct update_data_list *upd_data_list,
+			     struct mxcfb_rect *region)
+{
+	struct update_desc_list *desc = upd_data_list->update_desc;
+	u32 lut = upd_data_list->lut_num;
+
+	desc->times.submit = ktime_get();
+	fb_data->lut_times[lut] = desc->times;
+	fb_data->lut_wv_mode[lut] = desc->upd_data.waveform_mode;
+
+	epdc_sched_track_lut(fb_data, lut, region);
+
+	trace_mxc_epdc_submit_update(lut, desc->upd_data.waveform_mode,
+		desc->upd_data.update_mode, region);
 }
-EXPORT_SYMBOL(set_want_to_check_fb_state);
 
-void fb_finish_render_timeout( void ){
-	printk("\n[%s]\n",__func__);
-	g_framebuffer_finish_render = FB_FINISH_RENDER;
+/* Called from the IRQ handler, with queue_lock held, when a LUT is done */
+static void epdc_note_lut_complete(struct mxc_epdc_fb_data *fb_data, u32 lut)
+{
+	struct epdc_upd_times *t = &fb_data->lut_times[lut];
+	u32 mode = fb_data->lut_wv_mode[lut];
+	ktime_t now = ktime_get();
+
+	if (ktime_to_ns(t->submit) == 0) {
+		trace_mxc_epdc_lut_complete(lut, -1);
+		return;
+	}
+
+	trace_mxc_epdc_lut_complete(lut, ktime_us_delta(now, t->send));
+
+	epdc_lat_record(fb_data, mode, EPDC_LAT_QUEUE, t->pxp_start, t->send);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_PXP, t->pxp_done, t->pxp_start);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_SUBMIT, t->submit, t->pxp_done);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_PANEL, now, t->submit);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_TOTAL, now, t->send);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_TOUCH_SEND, t->send, t->touch);
+	epdc_lat_record(fb_data, mode, EPDC_LAT_TOUCH, now, t->touch);
+
+	if (fb_data->upd_observer) {
+		struct mxc_epdc_upd_timing tm = {
+			.waveform_mode	= mode,
+			.send		= t->send,
+			.pxp_start	= t->pxp_start,
+			.pxp_done	= t->pxp_done,
+			.submit		= t->submit,
+			.complete	= now,
+		};
 
+		fb_data->upd_observer(fb_data->upd_observer_data, &tm);
+	}
+
+	memset(t, 0, sizeof(*t));
 }
 
-int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
-				   struct fb_info *info)
+/*
+ * Have @fn called, from the LUT completion interrupt, with the pipeline
+ * timestamps of every update the panel finishes.  Only one observer can
+ * be set at a time; passing NULL removes it, after which it is no longer
+ * called.
+ */
+int mxc_epdc_fb_set_upd_observer(struct fb_info *info,
+				 mxc_epdc_upd_observer_t fn, void *data)
 {
 	struct mxc_epdc_fb_data *fb_data = info ?
 		(struct mxc_epdc_fb_data *)info:g_fb_data;
-	struct update_data_list *upd_data_list = NULL;
 	unsigned long flags;
-	struct mxcfb_rect *screen_upd_region; /* Region on screen to update */
-	int temp_index;
-	int ret;
-	struct update_desc_list *upd_desc;
-	struct update_marker_data *marker_data, *next_marker, *temp_marker;
-
-	GALLEN_DBGLOCAL_MUTEBEGIN();
-	GALLEN_DBGLOCAL_PRINTMSG("%s:upd rect={%u,%u,%u,%u},\n\twfmode=%u,updmode=%u,updmarker=%u,flags=0x%x\n",__FUNCTION__,
-			upd_data->update_region.left,upd_data->update_region.top,
-			upd_data->update_region.width,upd_data->update_region.height,
-			upd_data->waveform_mode,upd_data->update_mode,upd_data->update_marker,
-			upd_data->flags);
+	int ret = 0;
 
-	
-	// MG: handle eink update modes
-	if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_READING)
-	{
-		upd_data->update_mode = UPDATE_MODE_FULL;
-	}
-	else if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_MONOCHROMATIC)
-	{
-		upd_data->update_mode = UPDATE_MODE_PARTIAL;
-		upd_data->waveform_mode = 1; // du = 1, a2 = 4
-		upd_data->flags |= EPDC_FLAG_FORCE_MONOCHROME;
-	}
-	else if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_MONOCHROMATIC_DITHERED)
-	{
-		upd_data->update_mode = UPDATE_MODE_PARTIAL;
-		upd_data->waveform_mode = 1; // du = 1, a2 = 4
-		upd_data->flags = EPDC_FLAG_USE_DITHERING_Y1;
-	}
-	
-	// MG: instead of copying data to temporary buffer later, fix alignment now
-	if (upd_data->update_region.left & 0x7) {
-		upd_data->update_region.width += (upd_data->update_region.left & 0x7);
-		upd_data->update_region.left &= (~0x7);
-	}
-	if (upd_data->update_region.top & 0x7) {
-		upd_data->update_region.height += (upd_data->update_region.top & 0x7);
-		upd_data->update_region.top &= (~0x7);
-	}
-	upd_data->update_region.width = ALIGN(upd_data->update_region.width, 8);
-	if (upd_data->update_region.left + upd_data->update_region.width > fb_data->epdc_fb_var.xres) {
-		upd_data->update_region.width = fb_data->epdc_fb_var.xres - upd_data->update_region.left;
-	}
-	upd_data->update_region.height = ALIGN(upd_data->update_region.height, 8);
-	if (upd_data->update_region.top + upd_data->update_region.height > fb_data->epdc_fb_var.yres) {
-		upd_data->update_region.height = fb_data->epdc_fb_var.yres - upd_data->update_region.top;
-	}
-	
-	
-	if ( (g_want_to_check_render_framebuffer_state == 1 ) && (upd_data->update_region.left + upd_data->update_region.width == fb_data->epdc_fb_var.xres)
-		     && (upd_data->update_region.top + upd_data->update_region.height == fb_data->epdc_fb_var.yres) ) {
-		g_framebuffer_finish_render = FB_STILL_RENDERING;
-		del_timer(&fb_finish_render_timer);
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (fn && fb_data->upd_observer)
+		ret = -EBUSY;
+	else {
+		fb_data->upd_observer = fn;
+		fb_data->upd_observer_data = data;
 	}
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
-	/* Has EPDC HW been initialized? */
-	if (!fb_data->hw_ready) {
-		dev_err(fb_data->dev, "Display HW not properly initialized."
-			"  Aborting update.\n");
-		GALLEN_DBGLOCAL_ESC();
-		return -EPERM;
+	return ret;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_set_upd_observer);
+
+u32 mxc_epdc_fb_get_collisions(struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	return fb_data->upd_collisions;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_get_collisions);
+
+static bool epdc_dither_neon_usable(void)
+{
+#ifdef CONFIG_KERNEL_MODE_NEON
+	return cpu_has_neon();
+#else
+	return false;
+#endif
+}
+
+/*
+ * Dither the PxP output of an update in place, using the implementation
+ * selected by fb_data->dither_mode. The update buffers come from
+ * dma_alloc_coherent(), so there is nothing to clean; only drain the
+ * write buffer before the EPDC fetches the dithered lines.
+ */
+static void epdc_dither_update(struct mxc_epdc_fb_data *fb_data,
+			       struct update_data_list *upd_data_list,
+			       struct mxcfb_rect *region)
+{
+	u32 flags = upd_data_list->update_desc->upd_data.flags;
+	u32 offs = upd_data_list->update_desc->epdc_offs;
+	u8 *ptr = (u8 *)upd_data_list->virt_addr + offs;
+	int width = region->width;
+	int height = region->height;
+	int stride = ALIGN(width, 8);
+	int mode = fb_data->dither_mode;
+	u32 len = height * stride;
+
+	if (width > fb_data->dither_max_width) {
+		dev_err(fb_data->dev, "Dither region too wide (%d)\n", width);
+		return;
 	}
 
-	/* Check validity of update params */
-	if ((upd_data->update_mode != UPDATE_MODE_PARTIAL) &&
-		(upd_data->update_mode != UPDATE_MODE_FULL)) {
-		dev_err(fb_data->dev,
-			"Update mode 0x%x is invalid.  Aborting update.\n",
-			upd_data->update_mode);
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
+	if (mode != EPDC_DITHER_ATKINSON && !epdc_dither_neon_usable())
+		mode = EPDC_DITHER_ATKINSON;
+
+	if (mode == EPDC_DITHER_ATKINSON) {
+		memset(fb_data->dither_err_buf, 0,
+			(width + 3) * 3 * sizeof(int));
+		if (flags & EPDC_FLAG_USE_DITHERING_Y1)
+			do_dithering_processing_Y1_v1_0(ptr, width, height,
+				stride, fb_data->dither_err_buf);
+		else
+			do_dithering_processing_Y4_v1_0(ptr, width, height,
+				stride, fb_data->dither_err_buf);
 	}
-	if ((upd_data->waveform_mode > 255) &&
-		(upd_data->waveform_mode != WAVEFORM_MODE_AUTO)) {
-		dev_err(fb_data->dev,
-			"Update waveform mode 0x%x is invalid."
-			"  Aborting update.\n",
-			upd_data->waveform_mode);
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
+#ifdef CONFIG_KERNEL_MODE_NEON
+	else {
+		if (mode == EPDC_DITHER_ATKINSON_NEON)
+			memset(fb_data->dither_err_buf, 0,
+				DITHER_NEON_ERR_BUF_SIZE(width));
+
+		kernel_neon_begin();
+		if (mode == EPDC_DITHER_ORDERED_NEON) {
+			if (flags & EPDC_FLAG_USE_DITHERING_Y1)
+				dither_neon_Y1(ptr, width, height, stride);
+			else
+				dither_neon_Y4(ptr, width, height, stride);
+		} else {
+			if (flags & EPDC_FLAG_USE_DITHERING_Y1)
+				dither_neon_atkinson_Y1(ptr, width, height,
+					stride, fb_data->dither_err_buf);
+			else
+				dither_neon_atkinson_Y4(ptr, width, height,
+					stride, fb_data->dither_err_buf);
+		}
+		kernel_neon_end();
 	}
-	if ((upd_data->update_region.left + upd_data->update_region.width > fb_data->epdc_fb_var.xres) ||
-		(upd_data->update_region.top + upd_data->update_region.height > fb_data->epdc_fb_var.yres)) {
-		dev_err(fb_data->dev,
-			"Update region is outside bounds of framebuffer.(left,top=(%d,%d),w=%d,h=%d,panelw=%d,panelh=%d)"
-			"Aborting update.\n",upd_data->update_region.left,upd_data->update_region.top,\
-			upd_data->update_region.width,upd_data->update_region.height,\
-			fb_data->epdc_fb_var.xres,fb_data->epdc_fb_var.yres);
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
-	}
-	
+#endif
 
-	k_set_temperature(info);
-	
-	
-	if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		if ((upd_data->update_region.width !=
-			upd_data->alt_buffer_data.alt_update_region.width) ||
-			(upd_data->update_region.height !=
-			upd_data->alt_buffer_data.alt_update_region.height)) {
-			dev_err(fb_data->dev,
-				"Alternate update region dimensions must "
-				"match screen update region dimensions.\n");
-			GALLEN_DBGLOCAL_ESC();
-			return -EINVAL;
-		}
-		/* Validate physical address parameter */
-		if ((upd_data->alt_buffer_data.phys_addr <
-			fb_data->info.fix.smem_start) ||
-			(upd_data->alt_buffer_data.phys_addr >
-			fb_data->info.fix.smem_start + fb_data->map_size)) {
-			dev_err(fb_data->dev,
-				"Invalid physical address for alternate "
-				"buffer.  Aborting update...\n");
-			GALLEN_DBGLOCAL_ESC();
-			return -EINVAL;
-		}
-	}
+	wmb();
+
+	fb_data->flush_cnt++;
+	fb_data->last_flush_bytes = len;
+	fb_data->flush_bytes += len;
+}
+
+static void epdc_submit_work_func(struct work_struct *work)
+{
+	int temp_index;
+	struct update_data_list *next_update, *temp_update;
+	struct update_desc_list *next_desc, *temp_desc;
+	struct update_marker_data *next_marker, *temp_marker;
+	unsigned long flags;
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data, epdc_submit_work);
+	struct update_data_list *upd_data_list = NULL;
+	struct mxcfb_rect adj_update_region;
+	bool end_merge = false;
+	int *err_dist;
+	int ret;
+
+	GALLEN_DBGLOCAL_BEGIN();
+	epdc_wq_account(fb_data, EPDC_WQ_SUBMIT);
 
+	/* Protect access to buffer queues and to update HW */
 	spin_lock_irqsave(&fb_data->queue_lock, flags);
 
 	/*
-	 * If we are waiting to go into suspend, or the FB is blanked,
-	 * we do not accept new updates
+	 * Are any of our collision updates able to go now?
+	 * Go through all updates in the collision list and check to see
+	 * if the collision mask has been fully cleared
 	 */
-	if ((fb_data->waiting_for_idle) ||
-		((fb_data->blank != FB_BLANK_UNBLANK) && (fb_data->blank != FB_BLANK_NORMAL))) {
-		dev_dbg(fb_data->dev, "EPDC not active."
-			"Update request abort.\n");
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		GALLEN_DBGLOCAL_ESC();
-		return -EPERM;
-	}
+	list_for_each_entry_safe(next_update, temp_update,
+				&fb_data->upd_buf_collision_list, list) {
+		GALLEN_DBGLOCAL_RUNLOG(0);
 
-	if (fb_data->upd_scheme == UPDATE_SCHEME_SNAPSHOT) {
-		GALLEN_DBGLOCAL_RUNLOG(1);
-		/*
-		 * If next update is a FULL mode update, then we must
-		 * ensure that all pending & active updates are complete
-		 * before submitting the update.  Otherwise, the FULL
-		 * mode update may cause an endless collision loop with
-		 * other updates.  Block here until updates are flushed.
-		 */
-		if (upd_data->update_mode == UPDATE_MODE_FULL) {
-			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-			mxc_epdc_fb_flush_updates(fb_data);
-			spin_lock_irqsave(&fb_data->queue_lock, flags);
+		if (next_update->collision_mask != 0) {
+			GALLEN_DBGLOCAL_RUNLOG(1);
+			continue;
 		}
 
-		/*
-		 * Get available intermediate (PxP output) buffer to hold
-		 * processed update region
-		 */
-		if (list_empty(&fb_data->upd_buf_free_list)) {
-			dev_err(fb_data->dev,
-				"No free intermediate buffers available.\n");
-			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-			GALLEN_DBGLOCAL_ESC();
-			return -ENOMEM;
+		dev_dbg(fb_data->dev, "A collision update is ready to go!\n");
+
+		if (fb_data->merge_on_waveform_mismatch) {
+			/* Force waveform mode to auto for resubmitted collisions */
+			next_update->update_desc->upd_data.waveform_mode =
+				WAVEFORM_MODE_AUTO;
 		}
 
-		/* Grab first available buffer and delete from the free list */
-		upd_data_list =
-		    list_entry(fb_data->upd_buf_free_list.next,
-			       struct update_data_list, list);
+		/*
+		 * We have a collision cleared, so select it for resubmission.
+		 * If an update is already selected, attempt to merge.
+		 */
+		if (!upd_data_list) {
+			GALLEN_DBGLOCAL_RUNLOG(2);
+			upd_data_list = next_update;
+			list_del_init(&next_update->list);
+			if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) {
+				GALLEN_DBGLOCAL_RUNLOG(3);
+				/* If not merging, we have our update */
+				break;
+			}
+		} else {
+			GALLEN_DBGLOCAL_RUNLOG(4);
+			switch (epdc_submit_merge(fb_data,
+						upd_data_list->update_desc,
+						next_update->update_desc)) {
+							
+			case MERGE_OK:GALLEN_DBGLOCAL_RUNLOG(5);
+				dev_dbg(fb_data->dev,
+					"Update merged [collision]\n");
+				list_del_init(&next_update->update_desc->list);
+				kfree(next_update->update_desc);
+				next_update->update_desc = NULL;
+				list_del_init(&next_update->list);
+				/* Add to free buffer list */
+				list_add_tail(&next_update->list,
+					 &fb_data->upd_buf_free_list);
+				break;
+			case MERGE_FAIL:GALLEN_DBGLOCAL_RUNLOG(6);
+				dev_dbg(fb_data->dev,
+					"Update not merged [collision]\n");
+				break;
+			case MERGE_BLOCK:GALLEN_DBGLOCAL_RUNLOG(7);
+				dev_dbg(fb_data->dev,
+					"Merge blocked [collision]\n");
+				end_merge = true;
+				break;
+			}
 
-		list_del_init(&upd_data_list->list);
+			if (end_merge) {
+				GALLEN_DBGLOCAL_RUNLOG(8);
+				end_merge = false;
+				break;
+			}
+		}
 	}
 
 	/*
-	 * Create new update data structure, fill it with new update
-	 * data and add it to the list of pending updates
+	 * Skip pending update list only if we found a collision
+	 * update and we are not merging
 	 */
-	upd_desc = kzalloc(sizeof(struct update_desc_list), GFP_KERNEL);
-	if (!upd_desc) {
-		GALLEN_DBGLOCAL_RUNLOG(2);
-		dev_err(fb_data->dev,
-			"Insufficient system memory for update! Aborting.\n");
-		if (fb_data->upd_scheme == UPDATE_SCHEME_SNAPSHOT) {
-			GALLEN_DBGLOCAL_RUNLOG(3);
-			list_add(&upd_data_list->list,
-				&fb_data->upd_buf_free_list);
-		}
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		GALLEN_DBGLOCAL_ESC();
-		return -EPERM;
-	}
-	
-	
-		
-	/* Initialize per-update marker list */
-	INIT_LIST_HEAD(&upd_desc->upd_marker_list);
-	upd_desc->upd_data = *upd_data;
-	upd_desc->update_order = fb_data->order_cnt++;
-	list_add_tail(&upd_desc->list, &fb_data->upd_pending_list);
+	if (!((fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) &&
+		upd_data_list)) {
+		GALLEN_DBGLOCAL_RUNLOG(9);
+		/*
+		 * If we didn't find a collision update ready to go, we
+		 * need to get a free buffer and match it to a pending update.
+		 */
 
-	// LV panel & LV waveform test
-	{ 
-		unsigned char bModeVersion = *(gpbWF_vaddr+0x10);
-		if( 0x4 == bModeVersion ) {
-			DBG_MSG("Mode Ver=4\n");
-			if(2==upd_desc->upd_data.waveform_mode && 
-				upd_desc->upd_data.update_mode == UPDATE_MODE_PARTIAL) 
-			{
-				DBG_MSG("WF Mode version=0x%02x,chg W.F Mode 2->5 @ partial\n",bModeVersion);
-				upd_desc->upd_data.waveform_mode = 5;
-			}
-		}
-		else if( 0x1==bModeVersion || 0x2==bModeVersion ) {
-			if(4==upd_desc->upd_data.waveform_mode) {
-				// there is no A2 mode in this waveform ...
-				DBG_MSG("WF Mode version=0x%02x,chg W.F Mode 4(A2)->1(DU)\n",bModeVersion);
-				upd_desc->upd_data.waveform_mode = 1;// DU mode .
-			}
-		}
-	}
-	
-	/* If marker specified, associate it with a completion */
-	if (upd_data->update_marker != 0) {
-		GALLEN_DBGLOCAL_RUNLOG(4);
-		/* Allocate new update marker and set it up */
-		marker_data = kzalloc(sizeof(struct update_marker_data),
-				GFP_KERNEL);
-		if (!marker_data) {
-			dev_err(fb_data->dev, "No memory for marker!\n");
+		/*
+		 * Can't proceed if there are no free buffers (and we don't
+		 * already have a collision update selected)
+		*/
+		if (!upd_data_list &&
+			list_empty(&fb_data->upd_buf_free_list)) {
+			GALLEN_DBGLOCAL_RUNLOG(10);
+			if (!list_empty(&fb_data->upd_pending_list))
+				fb_data->upd_buf_stalls++;
 			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+			/* Try to take on more updates in flight */
+			if (!list_empty(&fb_data->upd_pending_list) &&
+				epdc_grow_upd_buffers(fb_data))
+				epdc_queue_submit(fb_data);
 			GALLEN_DBGLOCAL_ESC();
-			return -ENOMEM;
+			return;
 		}
-		DBG_MSG("[%s] alloc update_marker_data size=%d\n",
-			__FUNCTION__,sizeof(struct update_marker_data));
-			
-		list_add_tail(&marker_data->upd_list,
-			&upd_desc->upd_marker_list);
-		marker_data->update_marker = upd_data->update_marker;
-		marker_data->lut_num = INVALID_LUT;
-		init_completion(&marker_data->update_completion);
-		/* Add marker to master marker list */
-		list_add_tail(&marker_data->full_list,
-			&fb_data->full_marker_list);
-	}
-
-	if (fb_data->upd_scheme != UPDATE_SCHEME_SNAPSHOT) {
-		/* Queued update scheme processing */
-
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
-		/* Signal workqueue to handle new update */
-		queue_work(fb_data->epdc_submit_workqueue,
-			&fb_data->epdc_submit_work);
-
-		if ( (g_want_to_check_render_framebuffer_state == 1) 
-		     && (upd_data->update_region.left + upd_data->update_region.width == fb_data->epdc_fb_var.xres)
-		     && (upd_data->update_region.top + upd_data->update_region.height == fb_data->epdc_fb_var.yres) ) {
-				 
-		    fb_finish_render_timer.expires = jiffies + HZ/2;
-            add_timer(&fb_finish_render_timer);
-			
-	    } //terry add	 
+		/*
+		 * Let the scheduler pick an update that can run now. One that
+		 * jumped the queue goes out alone, since merging queued
+		 * updates into it could pull back in the overlap it avoided.
+		 */
+		if (!upd_data_list && fb_data->sched_reorder &&
+			!list_empty(&fb_data->upd_pending_list)) {
+			next_desc = epdc_sched_pick(fb_data);
+			if (next_desc != list_first_entry(
+					&fb_data->upd_pending_list,
+					struct update_desc_list, list)) {
+				upd_data_list =
+					list_entry(fb_data->upd_buf_free_list.next,
+						struct update_data_list, list);
+				list_del_init(&upd_data_list->list);
+				upd_data_list->update_desc = next_desc;
+				list_del_init(&next_desc->list);
+				fb_data->sched_reordered++;
+				goto pending_done;
+			}
+		}
 
-		GALLEN_DBGLOCAL_ESC();
-		return 0;
-	}
+		list_for_each_entry_safe(next_desc, temp_desc,
+				&fb_data->upd_pending_list, list) {
+			GALLEN_DBGLOCAL_RUNLOG(11);		
 
-	/* Snapshot update scheme processing */
-//	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			dev_dbg(fb_data->dev, "Found a pending update!\n");
 
-	/* Set descriptor for current update, delete from pending list */
-	upd_data_list->update_desc = upd_desc;
-	list_del_init(&upd_desc->list);
+			if (!upd_data_list) {
+				GALLEN_DBGLOCAL_RUNLOG(12);
+				if (list_empty(&fb_data->upd_buf_free_list)) {
+					GALLEN_DBGLOCAL_RUNLOG(13);
+					break;
+				}
+				upd_data_list =
+					list_entry(fb_data->upd_buf_free_list.next,
+						struct update_data_list, list);
+				list_del_init(&upd_data_list->list);
+				upd_data_list->update_desc = next_desc;
+				list_del_init(&next_desc->list);
+				if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE) {
+					GALLEN_DBGLOCAL_RUNLOG(14);
+					/* If not merging, we have an update */
+					break;
+				}
+			} else {
+				GALLEN_DBGLOCAL_RUNLOG(15);
+				switch (epdc_submit_merge(fb_data,
+						upd_data_list->update_desc, next_desc)) {
+				case MERGE_OK:GALLEN_DBGLOCAL_RUNLOG(16);
+					dev_dbg(fb_data->dev,
+						"Update merged [queue]\n");
+					list_del_init(&next_desc->list);
+					kfree(next_desc);
+					break;
+				case MERGE_FAIL:GALLEN_DBGLOCAL_RUNLOG(17);
+					dev_dbg(fb_data->dev,
+						"Update not merged [queue]\n");
+					break;
+				case MERGE_BLOCK:GALLEN_DBGLOCAL_RUNLOG(18);
+					dev_dbg(fb_data->dev,
+						"Merge blocked [collision]\n");
+					end_merge = true;
+					break;
+				}
 
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+				if (end_merge) {
+					GALLEN_DBGLOCAL_RUNLOG(19);
+					break;
+				}
+			}
+		}
+	}
 
-	/*
-	 * Hold on to original screen update region, which we
-	 * will ultimately use when telling EPDC where to update on panel
-	 */
-	screen_upd_region = &upd_desc->upd_data.update_region;
+pending_done:
+	/* Release buffer queues */
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
-	ret = epdc_process_update(upd_data_list, fb_data);
-	if (ret) {
-		mutex_unlock(&fb_data->pxp_mutex);
+	/* Is update list empty? */
+	if (!upd_data_list) {
 		GALLEN_DBGLOCAL_ESC();
-		return ret;
+		return;
 	}
 
-	/* Pass selected waveform mode back to user */
-	upd_data->waveform_mode = upd_desc->upd_data.waveform_mode;
+	/* Perform PXP processing - EPDC power will also be enabled */
+	if (epdc_process_update(upd_data_list, fb_data)) {
+		dev_dbg(fb_data->dev, "PXP processing error.\n");
+		/* Protect access to buffer queues and to update HW */
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+		list_del_init(&upd_data_list->update_desc->list);
+		kfree(upd_data_list->update_desc);
+		upd_data_list->update_desc = NULL;
+		/* Add to free buffer list */
+		list_add_tail(&upd_data_list->list,
+			&fb_data->upd_buf_free_list);
+		/* Release buffer queues */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		GALLEN_DBGLOCAL_ESC();
+		return;
+	}
 
 	/* Get rotation-adjusted coordinates */
-	adjust_coordinates(fb_data, &upd_desc->upd_data.update_region,
-		NULL);
+	adjust_coordinates(fb_data,
+		&upd_data_list->update_desc->upd_data.update_region,
+		&adj_update_region);
 
-	/* Grab lock for queue manipulation and update submission */
+	/*
+	 * Dithering Processing
+	 *
+	 * Only touches this update's buffer, so do it before waiting for
+	 * the working buffer: the CPU then dithers while the EPDC is still
+	 * processing the previous update, and not with interrupts off.
+	 */
+	if (upd_data_list->update_desc->upd_data.flags &
+	    (EPDC_FLAG_USE_DITHERING_Y1 | EPDC_FLAG_USE_DITHERING_Y4)) {
+		if (fb_data->cur_update != NULL)
+			fb_data->wb_overlap_cnt++;
+		epdc_dither_update(fb_data, upd_data_list, &adj_update_region);
+	}
+
+	/* Rails must be up before the update reaches the EPDC */
+	epdc_powerup_wait(fb_data);
+
+	/* Protect access to buffer queues and to update HW */
 	spin_lock_irqsave(&fb_data->queue_lock, flags);
 
+retry:
 	/*
 	 * Is the working buffer idle?
-	 * If either the working buffer is busy, or there are no LUTs available,
-	 * then we return and let the ISR handle the update later
+	 * If the working buffer is busy, we must wait for the resource
+	 * to become free. The IST will signal this event.
 	 */
-	if ((fb_data->cur_update != NULL) || !epdc_any_luts_available()) {
-		/* Add processed Y buffer to update list */
-		list_add_tail(&upd_data_list->list, &fb_data->upd_buf_queue);
+	if (fb_data->cur_update != NULL) {
+		GALLEN_DBGLOCAL_RUNLOG(20);
+		dev_dbg(fb_data->dev, "working buf busy!\n");
 
-		/* Return and allow the update to be submitted by the ISR. */
+		/* Initialize event signalling an update resource is free */
+		init_completion(&fb_data->update_res_free);
+
+		fb_data->waiting_for_wb = true;
+
+		/* Leave spinlock while waiting for WB to complete */
 		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		GALLEN_DBGLOCAL_ESC();
-		return 0;
+		wait_for_completion(&fb_data->update_res_free);
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
 	}
 
-	/* LUTs are available, so we get one here */
-	ret = epdc_choose_next_lut(&upd_data_list->lut_num);
+	/*
+	 * If there are no LUTs available,
+	 * then we must wait for the resource to become free.
+	 * The IST will signal this event.
+	 */
+	if (!epdc_luts_available(fb_data->direct_reserved)) {
+		GALLEN_DBGLOCAL_RUNLOG(21);
+		dev_dbg(fb_data->dev, "no luts available!\n");
+
+		/* Initialize event signalling an update resource is free */
+		init_completion(&fb_data->update_res_free);
+
+		fb_data->waiting_for_lut = true;
+
+		/* Leave spinlock while waiting for LUT to free up */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		wait_for_completion(&fb_data->update_res_free);
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+	}
+
+	ret = epdc_choose_next_lut(fb_data->direct_reserved,
+				   &upd_data_list->lut_num);
+	/*
+	 * If LUT15 is in use:
+	 *   - Wait for LUT15 to complete is if TCE underrun prevent is enabled
+	 *   - If we go ahead with update, sync update submission with EOF
+	 */
 	if (ret && fb_data->tce_prevent) {
-		dev_dbg(fb_data->dev, "Must wait for LUT15\n");
-		/* Add processed Y buffer to update list */
-		list_add_tail(&upd_data_list->list, &fb_data->upd_buf_queue);
+		dev_dbg(fb_data->dev, "Waiting for LUT15\n");
 
-		/* Return and allow the update to be submitted by the ISR. */
+		/* Initialize event signalling that lut15 is free */
+		init_completion(&fb_data->lut15_free);
+
+		fb_data->waiting_for_lut15 = true;
+
+		/* Leave spinlock while waiting for LUT to free up */
 		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		return 0;
+		wait_for_completion(&fb_data->lut15_free);
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+		epdc_choose_next_lut(fb_data->direct_reserved,
+				     &upd_data_list->lut_num);
+	} else if (ret) {
+		/* Synchronize update submission time to reduce
+		   chances of TCE underrun */
+		init_completion(&fb_data->eof_event);
+
+		epdc_eof_intr(true);
+
+		/* Leave spinlock while waiting for EOF event */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		ret = wait_for_completion_timeout(&fb_data->eof_event,
+			msecs_to_jiffies(1000));
+		if (!ret) {
+			dev_err(fb_data->dev, "Missed EOF event!\n");
+			epdc_eof_intr(false);
+		}
+		udelay(fb_data->eof_sync_period);
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+
 	}
 
-	/* Save current update */
+	/*
+	 * A direct update may have taken the WB or the LUT meanwhile, and
+	 * the LUT that completed may have been the reserved one.
+	 */
+	if (fb_data->cur_update != NULL ||
+	    !epdc_lut_usable(fb_data, upd_data_list->lut_num))
+		goto retry;
+
+	/* LUTs are available, so we get one here */
 	fb_data->cur_update = upd_data_list;
+	trace_mxc_epdc_lut_assign(upd_data_list->update_desc->update_order,
+		upd_data_list->lut_num);
 
 	/* Reset mask for LUTS that have completed during WB processing */
 	fb_data->luts_complete_wb = 0;
@@ -3079,1292 +4154,3148 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 	/* Associate LUT with update marker */
 	list_for_each_entry_safe(next_marker, temp_marker,
 		&upd_data_list->update_desc->upd_marker_list, upd_list)
-		next_marker->lut_num = upd_data_list->lut_num;
+		next_marker->lut_num = fb_data->cur_update->lut_num;
 
-	/* Mark LUT as containing new update */
+	/* Mark LUT with order */
 	fb_data->lut_update_order[upd_data_list->lut_num] =
-		upd_desc->update_order;
+		upd_data_list->update_desc->update_order;
 
-	/* Clear status and Enable LUT complete and WB complete IRQs */
+	/* Enable Collision and WB complete IRQs */
 	epdc_working_buf_intr(true);
 	epdc_lut_complete_intr(upd_data_list->lut_num, true);
 
 	/* Program EPDC update to process buffer */
-	epdc_set_update_addr(upd_data_list->phys_addr + upd_desc->epdc_offs);
-	epdc_set_update_coord(screen_upd_region->left, screen_upd_region->top);
-	epdc_set_update_dimensions(screen_upd_region->width,
-		screen_upd_region->height);
-	if (upd_desc->upd_data.temp != TEMP_USE_AMBIENT) {
-		GALLEN_DBGLOCAL_RUNLOG(6);
+	if (upd_data_list->update_desc->upd_data.temp != TEMP_USE_AMBIENT) {
+		GALLEN_DBGLOCAL_RUNLOG(22);
 		temp_index = mxc_epdc_fb_get_temp_index(fb_data,
-			upd_desc->upd_data.temp);
-		epdc_set_temp(temp_index);
-	} else {
-		GALLEN_DBGLOCAL_RUNLOG(7);
-		epdc_set_temp(fb_data->temp_index);
-	}
-
+			upd_data_list->update_desc->upd_data.temp);
+		epdc_set_temp(epdc_wv_temp_index(fb_data, temp_index));
+	} else
+		epdc_set_temp(epdc_wv_temp_index(fb_data, fb_data->temp_index));
+	
+	epdc_set_update_addr(upd_data_list->phys_addr
+				+ upd_data_list->update_desc->epdc_offs);
+	epdc_set_update_coord(adj_update_region.left, adj_update_region.top);
+	epdc_set_update_dimensions(adj_update_region.width,
+				   adj_update_region.height);
 	epdc_submit_update(upd_data_list->lut_num,
-			   upd_desc->upd_data.waveform_mode,
-			   upd_desc->upd_data.update_mode, false, 0);
+			   upd_data_list->update_desc->upd_data.waveform_mode,
+			   upd_data_list->update_desc->upd_data.update_mode,
+			   false, 0);
+	epdc_note_submit(fb_data, upd_data_list, &adj_update_region);
 
+	/* Release buffer queues */
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	
 	GALLEN_DBGLOCAL_END();
-	return 0;
 }
-EXPORT_SYMBOL(mxc_epdc_fb_send_update);
 
-int mxc_epdc_fb_wait_update_complete(u32 update_marker, struct fb_info *info)
-{
-	struct mxc_epdc_fb_data *fb_data = info ?
-		(struct mxc_epdc_fb_data *)info:g_fb_data;
-	struct update_marker_data *next_marker;
-	struct update_marker_data *temp;
-	unsigned long flags;
-	bool marker_found = false;
-	int ret = 0;
-	
-	GALLEN_DBGLOCAL_BEGIN();
+int g_want_to_check_render_framebuffer_state = NO_ONE_WANT_TO_CHECK;
+int g_framebuffer_finish_render = FB_STILL_RENDERING;
 
-	/* 0 is an invalid update_marker value */
-	if (update_marker == 0) {
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
+int get_FB_State( void ) {
+	int ret = g_framebuffer_finish_render;
+	return ret;
+}
+EXPORT_SYMBOL(get_FB_State);
+
+void set_want_to_check_fb_state( int want_to_check ) {
+	g_want_to_check_render_framebuffer_state = want_to_check;
+	if ( want_to_check == 0 ) {
+	    g_framebuffer_finish_render = FB_STILL_RENDERING;
 	}
+}
+EXPORT_SYMBOL(set_want_to_check_fb_state);
 
-	/*
-	 * Find completion associated with update_marker requested.
-	 * Note: If update completed already, marker will have been
-	 * cleared, it won't be found, and function will just return.
-	 */
+void fb_finish_render_timeout( void ){
+	printk("\n[%s]\n",__func__);
+	g_framebuffer_finish_render = FB_FINISH_RENDER;
 
-	/* Grab queue lock to protect access to marker list */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
+}
 
-	list_for_each_entry_safe(next_marker, temp,
-		&fb_data->full_marker_list, full_list) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		if (next_marker->update_marker == update_marker) {
-			GALLEN_DBGLOCAL_RUNLOG(1);
-			dev_dbg(fb_data->dev, "Waiting for marker %d\n",
-				update_marker);
-			next_marker->waiting = true;
-			marker_found = true;
-			break;
-		}
-	}
+/* Adjust the waveform mode to what the loaded waveform provides */
+static void epdc_fixup_waveform_mode(struct mxcfb_update_data *upd_data)
+{
+	unsigned char bModeVersion = *(gpbWF_vaddr+0x10);
 
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	if( 0x4 == bModeVersion ) {
+		DBG_MSG("Mode Ver=4\n");
+		if(2==upd_data->waveform_mode &&
+			upd_data->update_mode == UPDATE_MODE_PARTIAL)
+		{
+			DBG_MSG("WF Mode version=0x%02x,chg W.F Mode 2->5 @ partial\n",bModeVersion);
+			upd_data->waveform_mode = 5;
+		}
+	}
+	else if( 0x1==bModeVersion || 0x2==bModeVersion ) {
+		if(4==upd_data->waveform_mode) {
+			// there is no A2 mode in this waveform ...
+			DBG_MSG("WF Mode version=0x%02x,chg W.F Mode 4(A2)->1(DU)\n",bModeVersion);
+			upd_data->waveform_mode = 1;// DU mode .
+		}
+	}
+}
 
-	/*
-	 * If marker not found, it has either been signalled already
-	 * or the update request failed.  In either case, just return.
-	 */
-	if (!marker_found) {
-		GALLEN_DBGLOCAL_ESC();
-		return ret;
+/*
+ * Apply the global update mode, align the update region and check that
+ * the request can be handled.
+ */
+static int epdc_prepare_update(struct mxc_epdc_fb_data *fb_data,
+			       struct mxcfb_update_data *upd_data)
+{
+	// MG: handle eink update modes
+	if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_READING)
+	{
+		upd_data->update_mode = UPDATE_MODE_FULL;
+	}
+	else if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_MONOCHROMATIC)
+	{
+		upd_data->update_mode = UPDATE_MODE_PARTIAL;
+		upd_data->waveform_mode = 1; // du = 1, a2 = 4
+		upd_data->flags |= EPDC_FLAG_FORCE_MONOCHROME;
+	}
+	else if (giEINK_UPDATE_MODE == EINK_UPDATE_MODE_MONOCHROMATIC_DITHERED)
+	{
+		upd_data->update_mode = UPDATE_MODE_PARTIAL;
+		upd_data->waveform_mode = 1; // du = 1, a2 = 4
+		upd_data->flags = EPDC_FLAG_USE_DITHERING_Y1;
+	}
+	
+	// MG: instead of copying data to temporary buffer later, fix alignment now
+	if (upd_data->update_region.left & 0x7) {
+		upd_data->update_region.width += (upd_data->update_region.left & 0x7);
+		upd_data->update_region.left &= (~0x7);
+	}
+	if (upd_data->update_region.top & 0x7) {
+		upd_data->update_region.height += (upd_data->update_region.top & 0x7);
+		upd_data->update_region.top &= (~0x7);
+	}
+	upd_data->update_region.width = ALIGN(upd_data->update_region.width, 8);
+	if (upd_data->update_region.left + upd_data->update_region.width > fb_data->epdc_fb_var.xres) {
+		upd_data->update_region.width = fb_data->epdc_fb_var.xres - upd_data->update_region.left;
+	}
+	upd_data->update_region.height = ALIGN(upd_data->update_region.height, 8);
+	if (upd_data->update_region.top + upd_data->update_region.height > fb_data->epdc_fb_var.yres) {
+		upd_data->update_region.height = fb_data->epdc_fb_var.yres - upd_data->update_region.top;
+	}
+	
+	
+	/* Has EPDC HW been initialized? */
+	if (!fb_data->hw_ready) {
+		dev_err(fb_data->dev, "Display HW not properly initialized."
+			"  Aborting update.\n");
+		return -EPERM;
 	}
 
-	ret = wait_for_completion_timeout(&next_marker->update_completion,
-						msecs_to_jiffies(5000));
-	if (!ret) {
-		GALLEN_DBGLOCAL_RUNLOG(2);
+	/* Check validity of update params */
+	if ((upd_data->update_mode != UPDATE_MODE_PARTIAL) &&
+		(upd_data->update_mode != UPDATE_MODE_FULL)) {
+		dev_err(fb_data->dev,
+			"Update mode 0x%x is invalid.  Aborting update.\n",
+			upd_data->update_mode);
+		return -EINVAL;
+	}
+	if ((upd_data->waveform_mode > 255) &&
+		(upd_data->waveform_mode != WAVEFORM_MODE_AUTO)) {
+		dev_err(fb_data->dev,
+			"Update waveform mode 0x%x is invalid."
+			"  Aborting update.\n",
+			upd_data->waveform_mode);
+		return -EINVAL;
+	}
+	if ((upd_data->update_region.left + upd_data->update_region.width > fb_data->epdc_fb_var.xres) ||
+		(upd_data->update_region.top + upd_data->update_region.height > fb_data->epdc_fb_var.yres)) {
 		dev_err(fb_data->dev,
-			"Timed out waiting for update completion\n");
-		list_del_init(&next_marker->full_list);
-		ret = -ETIMEDOUT;
+			"Update region is outside bounds of framebuffer.(left,top=(%d,%d),w=%d,h=%d,panelw=%d,panelh=%d)"
+			"Aborting update.\n",upd_data->update_region.left,upd_data->update_region.top,\
+			upd_data->update_region.width,upd_data->update_region.height,\
+			fb_data->epdc_fb_var.xres,fb_data->epdc_fb_var.yres);
+		return -EINVAL;
 	}
 
-	/* Free update marker object */
-	kfree(next_marker);
+	if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
+		if ((upd_data->update_region.width !=
+			upd_data->alt_buffer_data.alt_update_region.width) ||
+			(upd_data->update_region.height !=
+			upd_data->alt_buffer_data.alt_update_region.height)) {
+			dev_err(fb_data->dev,
+				"Alternate update region dimensions must "
+				"match screen update region dimensions.\n");
+			return -EINVAL;
+		}
+		/* Validate physical address parameter */
+		if ((upd_data->alt_buffer_data.phys_addr <
+			fb_data->info.fix.smem_start) ||
+			(upd_data->alt_buffer_data.phys_addr >
+			fb_data->info.fix.smem_start + fb_data->map_size)) {
+			dev_err(fb_data->dev,
+				"Invalid physical address for alternate "
+				"buffer.  Aborting update...\n");
+			return -EINVAL;
+		}
+	}
 
-	GALLEN_DBGLOCAL_END();
-	return ret;
+	return 0;
 }
-EXPORT_SYMBOL(mxc_epdc_fb_wait_update_complete);
 
-int mxc_epdc_fb_set_pwrdown_delay(u32 pwrdown_delay,
-					    struct fb_info *info)
+int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
+				   struct fb_info *info)
 {
 	struct mxc_epdc_fb_data *fb_data = info ?
 		(struct mxc_epdc_fb_data *)info:g_fb_data;
+	struct update_data_list *upd_data_list = NULL;
+	unsigned long flags;
+	struct mxcfb_rect *screen_upd_region; /* Region on screen to update */
+	int temp_index;
+	int ret;
+	struct update_desc_list *upd_desc;
+	struct update_marker_data *marker_data, *next_marker, *temp_marker;
 
-	fb_data->pwrdown_delay = pwrdown_delay;
+	GALLEN_DBGLOCAL_MUTEBEGIN();
+	GALLEN_DBGLOCAL_PRINTMSG("%s:upd rect={%u,%u,%u,%u},\n\twfmode=%u,updmode=%u,updmarker=%u,flags=0x%x\n",__FUNCTION__,
+			upd_data->update_region.left,upd_data->update_region.top,
+			upd_data->update_region.width,upd_data->update_region.height,
+			upd_data->waveform_mode,upd_data->update_mode,upd_data->update_marker,
+			upd_data->flags);
 
-	return 0;
-}
-EXPORT_SYMBOL(mxc_epdc_fb_set_pwrdown_delay);
+	
+	ret = epdc_prepare_update(fb_data, upd_data);
+	if (ret) {
+		GALLEN_DBGLOCAL_ESC();
+		return ret;
+	}
 
-int mxc_epdc_get_pwrdown_delay(struct fb_info *info)
-{
-	struct mxc_epdc_fb_data *fb_data = info ?
-		(struct mxc_epdc_fb_data *)info:g_fb_data;
+	if ( (g_want_to_check_render_framebuffer_state == 1 ) && (upd_data->update_region.left + upd_data->update_region.width == fb_data->epdc_fb_var.xres)
+		     && (upd_data->update_region.top + upd_data->update_region.height == fb_data->epdc_fb_var.yres) ) {
+		g_framebuffer_finish_render = FB_STILL_RENDERING;
+		del_timer(&fb_finish_render_timer);
+	}
 
-	return fb_data->pwrdown_delay;
-}
-EXPORT_SYMBOL(mxc_epdc_get_pwrdown_delay);
+	k_set_temperature(info);
 
-static int mxc_epdc_fb_ioctl(struct fb_info *info, unsigned int cmd,
-			     unsigned long arg)
-{
-	void __user *argp = (void __user *)arg;
-	int ret = -EINVAL;
-	GALLEN_DBGLOCAL_BEGIN();
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
 
-//	ERR_MSG("MXCFB_SEND_UPDATE = 0x%x\t\tMXCFB_GET_UPDATE_MODE = 0x%x\n", MXCFB_SEND_UPDATE, MXCFB_GET_UPDATE_MODE);
-	
-	fake_s1d13522_progress_stop();
-	
+	/*
+	 * If we are waiting to go into suspend, or the FB is blanked,
+	 * we do not accept new updates
+	 */
+	if ((fb_data->waiting_for_idle) ||
+		((fb_data->blank != FB_BLANK_UNBLANK) && (fb_data->blank != FB_BLANK_NORMAL))) {
+		dev_dbg(fb_data->dev, "EPDC not active."
+			"Update request abort.\n");
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		GALLEN_DBGLOCAL_ESC();
+		return -EPERM;
+	}
 
-	switch (cmd) {
-	case MXCFB_SET_WAVEFORM_MODES: GALLEN_DBGLOCAL_RUNLOG(0);
-		{
-			struct mxcfb_waveform_modes modes;
-			if (!copy_from_user(&modes, argp, sizeof(modes))) {
-				GALLEN_DBGLOCAL_RUNLOG(1);
-				mxc_epdc_fb_set_waveform_modes(&modes, info);
-				ret = 0;
-			}
-			break;
-		}
-	case MXCFB_SET_TEMPERATURE: GALLEN_DBGLOCAL_RUNLOG(2);
-		{
-			int temperature;
-			if (!get_user(temperature, (int32_t __user *) arg)) {
-				GALLEN_DBGLOCAL_RUNLOG(3);
-				ret = mxc_epdc_fb_set_temperature(temperature,
-					info);
-			}
-			break;
+	if (fb_data->upd_scheme == UPDATE_SCHEME_SNAPSHOT) {
+		GALLEN_DBGLOCAL_RUNLOG(1);
+		/*
+		 * If next update is a FULL mode update, then we must
+		 * ensure that all pending & active updates are complete
+		 * before submitting the update.  Otherwise, the FULL
+		 * mode update may cause an endless collision loop with
+		 * other updates.  Block here until updates are flushed.
+		 */
+		if (upd_data->update_mode == UPDATE_MODE_FULL) {
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			mxc_epdc_fb_flush_updates(fb_data);
+			spin_lock_irqsave(&fb_data->queue_lock, flags);
 		}
-	case MXCFB_SET_AUTO_UPDATE_MODE:GALLEN_DBGLOCAL_RUNLOG(4);
-		{
-			u32 auto_mode = 0;
-			if (!get_user(auto_mode, (__u32 __user *) arg)) {
-				GALLEN_DBGLOCAL_RUNLOG(5);
-				ret = mxc_epdc_fb_set_auto_update(auto_mode,
-					info);
+
+		/*
+		 * Get available intermediate (PxP output) buffer to hold
+		 * processed update region
+		 */
+		if (list_empty(&fb_data->upd_buf_free_list)) {
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			if (!epdc_grow_upd_buffers(fb_data)) {
+				dev_err(fb_data->dev,
+					"No free intermediate buffers available.\n");
+				fb_data->upd_buf_rejects++;
+				GALLEN_DBGLOCAL_ESC();
+				return -ENOMEM;
 			}
-			break;
+			spin_lock_irqsave(&fb_data->queue_lock, flags);
 		}
-	case MXCFB_SET_UPDATE_SCHEME:GALLEN_DBGLOCAL_RUNLOG(6);
-		{
-			u32 upd_scheme = 0;
-			if (!get_user(upd_scheme, (__u32 __user *) arg)) {
-				GALLEN_DBGLOCAL_RUNLOG(7);
-				ret = mxc_epdc_fb_set_upd_scheme(upd_scheme,
-					info);
-			}
-			break;
+
+		/* Grab first available buffer and delete from the free list */
+		upd_data_list =
+		    list_entry(fb_data->upd_buf_free_list.next,
+			       struct update_data_list, list);
+
+		list_del_init(&upd_data_list->list);
+	}
+
+	/*
+	 * Create new update data structure, fill it with new update
+	 * data and add it to the list of pending updates
+	 */
+	upd_desc = kzalloc(sizeof(struct update_desc_list), GFP_KERNEL);
+	if (!upd_desc) {
+		GALLEN_DBGLOCAL_RUNLOG(2);
+		dev_err(fb_data->dev,
+			"Insufficient system memory for update! Aborting.\n");
+		if (fb_data->upd_scheme == UPDATE_SCHEME_SNAPSHOT) {
+			GALLEN_DBGLOCAL_RUNLOG(3);
+			list_add(&upd_data_list->list,
+				&fb_data->upd_buf_free_list);
 		}
-	case MXCFB_SET_UPDATE_MODE:
-		{
-			int mode;
-			if (!get_user(mode, (int32_t __user *) arg))
-			{
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		GALLEN_DBGLOCAL_ESC();
+		return -EPERM;
+	}
+	
+	
+		
+	/* Initialize per-update marker list */
+	INIT_LIST_HEAD(&upd_desc->upd_marker_list);
+	upd_desc->upd_data = *upd_data;
+	upd_desc->times.send = ktime_get();
+	epdc_claim_touch(fb_data, &upd_desc->times);
+	trace_mxc_epdc_send_update(upd_data->update_marker,
+		upd_data->waveform_mode, upd_data->update_mode,
+		&upd_data->update_region);
+	upd_desc->update_order = fb_data->order_cnt++;
+	list_add_tail(&upd_desc->list, &fb_data->upd_pending_list);
+
+	// LV panel & LV waveform test
+	epdc_fixup_waveform_mode(&upd_desc->upd_data);
+
+	/* If marker specified, associate it with a completion */
+	if (upd_data->update_marker != 0) {
+		GALLEN_DBGLOCAL_RUNLOG(4);
+		/* Allocate new update marker and set it up */
+		marker_data = kzalloc(sizeof(struct update_marker_data),
+				GFP_KERNEL);
+		if (!marker_data) {
+			dev_err(fb_data->dev, "No memory for marker!\n");
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			GALLEN_DBGLOCAL_ESC();
+			return -ENOMEM;
+		}
+		DBG_MSG("[%s] alloc update_marker_data size=%d\n",
+			__FUNCTION__,sizeof(struct update_marker_data));
+			
+		list_add_tail(&marker_data->upd_list,
+			&upd_desc->upd_marker_list);
+		marker_data->update_marker = upd_data->update_marker;
+		marker_data->lut_num = INVALID_LUT;
+		init_completion(&marker_data->update_completion);
+		/* Add marker to master marker list */
+		list_add_tail(&marker_data->full_list,
+			&fb_data->full_marker_list);
+	}
+
+	if (fb_data->upd_scheme != UPDATE_SCHEME_SNAPSHOT) {
+		/* Queued update scheme processing */
+
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+		/* Signal workqueue to handle new update */
+		epdc_queue_submit(fb_data);
+
+		if ( (g_want_to_check_render_framebuffer_state == 1) 
+		     && (upd_data->update_region.left + upd_data->update_region.width == fb_data->epdc_fb_var.xres)
+		     && (upd_data->update_region.top + upd_data->update_region.height == fb_data->epdc_fb_var.yres) ) {
+				 
+		    fb_finish_render_timer.expires = jiffies + HZ/2;
+            add_timer(&fb_finish_render_timer);
+			
+	    } //terry add	 
+
+		GALLEN_DBGLOCAL_ESC();
+		return 0;
+	}
+
+	/* Snapshot update scheme processing */
+//	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	/* Set descriptor for current update, delete from pending list */
+	upd_data_list->update_desc = upd_desc;
+	list_del_init(&upd_desc->list);
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	/*
+	 * Hold on to original screen update region, which we
+	 * will ultimately use when telling EPDC where to update on panel
+	 */
+	screen_upd_region = &upd_desc->upd_data.update_region;
+
+	ret = epdc_process_update(upd_data_list, fb_data);
+	if (ret) {
+		mutex_unlock(&fb_data->pxp_mutex);
+		GALLEN_DBGLOCAL_ESC();
+		return ret;
+	}
+
+	/* Pass selected waveform mode back to user */
+	upd_data->waveform_mode = upd_desc->upd_data.waveform_mode;
+
+	/* Get rotation-adjusted coordinates */
+	adjust_coordinates(fb_data, &upd_desc->upd_data.update_region,
+		NULL);
+
+	/* Rails must be up before the update reaches the EPDC */
+	epdc_powerup_wait(fb_data);
+
+	/* Grab lock for queue manipulation and update submission */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	/*
+	 * Is the working buffer idle?
+	 * If either the working buffer is busy, or there are no LUTs available,
+	 * then we return and let the ISR handle the update later
+	 */
+	if ((fb_data->cur_update != NULL) ||
+	    !epdc_luts_available(fb_data->direct_reserved)) {
+		/* Add processed Y buffer to update list */
+		list_add_tail(&upd_data_list->list, &fb_data->upd_buf_queue);
+
+		/* Return and allow the update to be submitted by the ISR. */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		GALLEN_DBGLOCAL_ESC();
+		return 0;
+	}
+
+	/* LUTs are available, so we get one here */
+	ret = epdc_choose_next_lut(fb_data->direct_reserved,
+				   &upd_data_list->lut_num);
+	if (ret && fb_data->tce_prevent) {
+		dev_dbg(fb_data->dev, "Must wait for LUT15\n");
+		/* Add processed Y buffer to update list */
+		list_add_tail(&upd_data_list->list, &fb_data->upd_buf_queue);
+
+		/* Return and allow the update to be submitted by the ISR. */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return 0;
+	}
+
+	/* Save current update */
+	fb_data->cur_update = upd_data_list;
+
+	/* Reset mask for LUTS that have completed during WB processing */
+	fb_data->luts_complete_wb = 0;
+
+	/* Associate LUT with update marker */
+	list_for_each_entry_safe(next_marker, temp_marker,
+		&upd_data_list->update_desc->upd_marker_list, upd_list)
+		next_marker->lut_num = upd_data_list->lut_num;
+
+	/* Mark LUT as containing new update */
+	fb_data->lut_update_order[upd_data_list->lut_num] =
+		upd_desc->update_order;
+
+	/* Clear status and Enable LUT complete and WB complete IRQs */
+	epdc_working_buf_intr(true);
+	epdc_lut_complete_intr(upd_data_list->lut_num, true);
+
+	/* Program EPDC update to process buffer */
+	epdc_set_update_addr(upd_data_list->phys_addr + upd_desc->epdc_offs);
+	epdc_set_update_coord(screen_upd_region->left, screen_upd_region->top);
+	epdc_set_update_dimensions(screen_upd_region->width,
+		screen_upd_region->height);
+	if (upd_desc->upd_data.temp != TEMP_USE_AMBIENT) {
+		GALLEN_DBGLOCAL_RUNLOG(6);
+		temp_index = mxc_epdc_fb_get_temp_index(fb_data,
+			upd_desc->upd_data.temp);
+		epdc_set_temp(epdc_wv_temp_index(fb_data, temp_index));
+	} else {
+		GALLEN_DBGLOCAL_RUNLOG(7);
+		epdc_set_temp(epdc_wv_temp_index(fb_data, fb_data->temp_index));
+	}
+
+	epdc_submit_update(upd_data_list->lut_num,
+			   upd_desc->upd_data.waveform_mode,
+			   upd_desc->upd_data.update_mode, false, 0);
+	epdc_note_submit(fb_data, upd_data_list, screen_upd_region);
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	GALLEN_DBGLOCAL_END();
+	return 0;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_send_update);
+
+/*
+ * Queue several regions sharing one waveform, mode and marker. Regions
+ * that epdc_submit_merge() can combine are merged first and the rest go
+ * onto the pending list under a single queue_lock acquisition. Every
+ * resulting update carries the marker, and waiting on it returns once
+ * they have all completed.
+ */
+int mxc_epdc_fb_send_updates(struct mxcfb_update_rects *upd_rects,
+			     struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+	struct update_desc_list *descs[MXCFB_MAX_UPDATE_RECTS];
+	struct update_marker_data *markers[MXCFB_MAX_UPDATE_RECTS];
+	struct mxcfb_update_data upd_data;
+	unsigned long flags;
+	ktime_t now;
+	int i, j, n = 0, ret;
+	bool merged;
+
+	if ((upd_rects->num_rects == 0) ||
+		(upd_rects->num_rects > MXCFB_MAX_UPDATE_RECTS) ||
+		(upd_rects->flags & EPDC_FLAG_USE_ALT_BUFFER))
+		return -EINVAL;
+
+	memset(&upd_data, 0, sizeof(upd_data));
+	memset(markers, 0, sizeof(markers));
+
+	/* Snapshot updates are processed synchronously, one at a time */
+	if (fb_data->upd_scheme == UPDATE_SCHEME_SNAPSHOT) {
+		for (i = 0; i < upd_rects->num_rects; i++) {
+			upd_data.update_region = upd_rects->rects[i];
+			upd_data.waveform_mode = upd_rects->waveform_mode;
+			upd_data.update_mode = upd_rects->update_mode;
+			upd_data.update_marker = upd_rects->update_marker;
+			upd_data.temp = upd_rects->temp;
+			upd_data.flags = upd_rects->flags;
+			ret = mxc_epdc_fb_send_update(&upd_data, info);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	for (i = 0; i < upd_rects->num_rects; i++) {
+		upd_data.update_region = upd_rects->rects[i];
+		upd_data.waveform_mode = upd_rects->waveform_mode;
+		upd_data.update_mode = upd_rects->update_mode;
+		upd_data.update_marker = upd_rects->update_marker;
+		upd_data.temp = upd_rects->temp;
+		upd_data.flags = upd_rects->flags;
+		ret = epdc_prepare_update(fb_data, &upd_data);
+		if (ret)
+			goto out_free;
+
+		descs[n] = kzalloc(sizeof(struct update_desc_list), GFP_KERNEL);
+		if (!descs[n]) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+		INIT_LIST_HEAD(&descs[n]->upd_marker_list);
+		descs[n]->upd_data = upd_data;
+		epdc_fixup_waveform_mode(&descs[n]->upd_data);
+		n++;
+	}
+
+	/* Combine overlapping regions before they reach the queue */
+	do {
+		merged = false;
+		for (i = 0; i < n; i++)
+			for (j = i + 1; j < n; j++) {
+				if (epdc_submit_merge(fb_data, descs[i],
+					descs[j]) != MERGE_OK)
+					continue;
+				kfree(descs[j]);
+				descs[j--] = descs[--n];
+				merged = true;
+			}
+	} while (merged);
+
+	if (upd_rects->update_marker != 0)
+		for (i = 0; i < n; i++) {
+			markers[i] = kzalloc(sizeof(struct update_marker_data),
+					GFP_KERNEL);
+			if (!markers[i]) {
+				dev_err(fb_data->dev, "No memory for marker!\n");
+				ret = -ENOMEM;
+				goto out_free;
+			}
+			markers[i]->update_marker = upd_rects->update_marker;
+			markers[i]->lut_num = INVALID_LUT;
+			init_completion(&markers[i]->update_completion);
+		}
+
+	k_set_temperature(info);
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	if ((fb_data->waiting_for_idle) ||
+		((fb_data->blank != FB_BLANK_UNBLANK) && (fb_data->blank != FB_BLANK_NORMAL))) {
+		dev_dbg(fb_data->dev, "EPDC not active."
+			"Update request abort.\n");
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		ret = -EPERM;
+		goto out_free;
+	}
+
+	now = ktime_get();
+	for (i = 0; i < n; i++) {
+		descs[i]->times.send = now;
+		epdc_claim_touch(fb_data, &descs[i]->times);
+		trace_mxc_epdc_send_update(upd_rects->update_marker,
+			descs[i]->upd_data.waveform_mode,
+			descs[i]->upd_data.update_mode,
+			&descs[i]->upd_data.update_region);
+		descs[i]->update_order = fb_data->order_cnt++;
+		list_add_tail(&descs[i]->list, &fb_data->upd_pending_list);
+
+		if (markers[i]) {
+			list_add_tail(&markers[i]->upd_list,
+				&descs[i]->upd_marker_list);
+			list_add_tail(&markers[i]->full_list,
+				&fb_data->full_marker_list);
+		}
+	}
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	/* Signal workqueue to handle new updates */
+	epdc_queue_submit(fb_data);
+
+	return 0;
+
+out_free:
+	for (i = 0; i < n; i++) {
+		kfree(descs[i]);
+		kfree(markers[i]);
+	}
+	return ret;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_send_updates);
+
+/*
+ * Direct draw, for pen input.
+ *
+ * A stroke segment is a few lines of black or white. Instead of a
+ * descriptor, the submit workqueue and a PxP pass, the CPU thresholds the
+ * region into a buffer of its own and the update goes to the EPDC from
+ * the ioctl, on a LUT that queued updates leave alone from the first
+ * direct update on, or else a free one. It still has to wait for the
+ * (shared) working buffer. Pixels a running LUT held are not drawn, and
+ * are redone through the queue when the WB reports the collision.
+ */
+
+/*
+ * Threshold region @r of the framebuffer into the direct buffer, laid
+ * out for the panel region @adj with lines rounded up to 8 pixels.
+ */
+static void epdc_direct_copy(struct mxc_epdc_fb_data *fb_data,
+			     struct mxcfb_rect *r, struct mxcfb_rect *adj,
+			     u8 invert)
+{
+	int src_stride = fb_data->epdc_fb_var.xres_virtual;
+	u8 *src = (u8 *)fb_data->info.screen_base + fb_data->fb_offset +
+		r->top * src_stride + r->left;
+	u8 *dst = fb_data->direct_upd.virt_addr;
+	int stride = ALIGN(adj->width, 8);
+	int step_x, step_y;
+	u8 *line;
+	int x, y;
+
+	/* Source pixel steps for one panel pixel right and one line down */
+	switch (fb_data->epdc_fb_var.rotate) {
+	case FB_ROTATE_UR:
+	default:
+		step_x = 1;
+		step_y = src_stride;
+		break;
+	case FB_ROTATE_CW:
+		src += (r->height - 1) * src_stride;
+		step_x = -src_stride;
+		step_y = 1;
+		break;
+	case FB_ROTATE_UD:
+		src += (r->height - 1) * src_stride + r->width - 1;
+		step_x = -1;
+		step_y = -src_stride;
+		break;
+	case FB_ROTATE_CCW:
+		src += r->width - 1;
+		step_x = src_stride;
+		step_y = -1;
+		break;
+	}
+
+	for (y = 0; y < adj->height; y++, src += step_y, dst += stride)
+		for (x = 0, line = src; x < adj->width; x++, line += step_x)
+			dst[x] = ((*line & 0x80) ? 0xFF : 0x00) ^ invert;
+}
+
+/* Wait for a LUT or the WB to free up, queue_lock held */
+static void epdc_direct_wait(struct mxc_epdc_fb_data *fb_data,
+			     unsigned long *flags)
+{
+	init_completion(&fb_data->direct_res_free);
+	fb_data->waiting_for_direct = true;
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, *flags);
+	wait_for_completion(&fb_data->direct_res_free);
+	spin_lock_irqsave(&fb_data->queue_lock, *flags);
+}
+
+/*
+ * Pick the LUT for a direct update, queue_lock held. Returns -1 if none
+ * can be used yet. Submitting while LUT15 runs risks a TCE underrun, and
+ * the EOF synchronization the submit workqueue does then is its own, so
+ * a direct update waits instead.
+ */
+static int epdc_direct_lut(struct mxc_epdc_fb_data *fb_data)
+{
+	int lut;
+
+	if (fb_data->cur_update != NULL || (epdc_get_active_luts() & 0x8000))
+		return -1;
+
+	if (!epdc_is_lut_active(EPDC_DIRECT_LUT))
+		return EPDC_DIRECT_LUT;
+
+	if (!epdc_luts_available(0))
+		return -1;
+
+	epdc_choose_next_lut(0, &lut);
+	fb_data->direct_shared++;
+	return lut;
+}
+
+/*
+ * Called from the IRQ handler, with queue_lock held, when a direct update
+ * leaves the WB. Collided pixels were not drawn: send the region again
+ * as a queued update, which waits for the LUTs it collided with.
+ */
+static void epdc_direct_wb_done(struct mxc_epdc_fb_data *fb_data)
+{
+	struct mxcfb_update_data *upd = &fb_data->direct_desc.upd_data;
+	struct mxcfb_rect *redo = &fb_data->direct_redo.update_region;
+	struct mxcfb_rect *r = &upd->update_region;
+	u32 right, bottom;
+
+	if (!epdc_is_collision() ||
+	    !(epdc_get_colliding_luts() & ~fb_data->luts_complete_wb))
+		return;
+
+	fb_data->direct_collisions++;
+
+	if (fb_data->direct_redo_pending) {
+		right = max(redo->left + redo->width, r->left + r->width);
+		bottom = max(redo->top + redo->height, r->top + r->height);
+		redo->left = min(redo->left, r->left);
+		redo->top = min(redo->top, r->top);
+		redo->width = right - redo->left;
+		redo->height = bottom - redo->top;
+		fb_data->direct_redo.waveform_mode = upd->waveform_mode;
+		fb_data->direct_redo.flags = upd->flags;
+	} else {
+		fb_data->direct_redo = *upd;
+		fb_data->direct_redo_pending = true;
+	}
+
+	schedule_work(&fb_data->direct_redo_work);
+}
+
+static void epdc_direct_redo_work_func(struct work_struct *work)
+{
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data, direct_redo_work);
+	struct mxcfb_update_data upd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (!fb_data->direct_redo_pending) {
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return;
+	}
+	upd = fb_data->direct_redo;
+	fb_data->direct_redo_pending = false;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	upd.flags |= EPDC_FLAG_FORCE_MONOCHROME;
+	mxc_epdc_fb_send_update(&upd, &fb_data->info);
+}
+
+int mxc_epdc_fb_send_direct(struct mxcfb_direct_update *upd,
+			    struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+	struct update_data_list *upd_data_list = &fb_data->direct_upd;
+	struct update_desc_list *desc = &fb_data->direct_desc;
+	struct mxcfb_rect *r = &upd->update_region;
+	struct mxcfb_rect adj;
+	ktime_t start = ktime_get();
+	unsigned long flags;
+	bool waited = false;
+	u8 invert = 0;
+	int lut, ret = 0;
+	u32 us;
+
+	if (!fb_data->hw_ready)
+		return -EPERM;
+
+	if ((fb_data->epdc_fb_var.bits_per_pixel != 8) ||
+		(upd->waveform_mode > 255) ||
+		(upd->flags & ~EPDC_FLAG_ENABLE_INVERSION))
+		return -EINVAL;
+
+	if (!r->width || !r->height ||
+	    r->left + r->width > fb_data->epdc_fb_var.xres ||
+	    r->top + r->height > fb_data->epdc_fb_var.yres ||
+	    r->left + r->width < r->left ||
+	    r->top + r->height < r->top)
+		return -EINVAL;
+
+	adjust_coordinates(fb_data, r, &adj);
+	if (ALIGN(adj.width, 8) * adj.height > EPDC_DIRECT_BUF_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&fb_data->direct_mutex);
+
+	if (!upd_data_list->virt_addr) {
+		upd_data_list->virt_addr =
+			dma_alloc_coherent(fb_data->info.device,
+				EPDC_DIRECT_BUF_SIZE,
+				&upd_data_list->phys_addr, GFP_KERNEL);
+		if (!upd_data_list->virt_addr) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		upd_data_list->size = EPDC_DIRECT_BUF_SIZE;
+	}
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	/* Queued updates leave EPDC_DIRECT_LUT alone from now on */
+	fb_data->direct_reserved = 1 << EPDC_DIRECT_LUT;
+
+	/* The EPDC may still be reading the previous direct update */
+	while (fb_data->cur_update == upd_data_list) {
+		epdc_direct_wait(fb_data, &flags);
+		waited = true;
+	}
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	if (upd->flags & EPDC_FLAG_ENABLE_INVERSION)
+		invert = 0xFF;
+	if (fb_data->epdc_fb_var.grayscale == GRAYSCALE_8BIT_INVERTED)
+		invert ^= 0xFF;
+
+	epdc_direct_copy(fb_data, r, &adj, invert);
+	/* The buffer is uncached, but writes may still be buffered */
+	wmb();
+
+	memset(&desc->upd_data, 0, sizeof(desc->upd_data));
+	desc->upd_data.update_region = *r;
+	desc->upd_data.waveform_mode = upd->waveform_mode;
+	desc->upd_data.update_mode = UPDATE_MODE_PARTIAL;
+	desc->upd_data.temp = TEMP_USE_AMBIENT;
+	desc->upd_data.flags = upd->flags;
+	epdc_fixup_waveform_mode(&desc->upd_data);
+	desc->epdc_offs = 0;
+	upd_data_list->update_desc = desc;
+
+	for (;;) {
+		if ((fb_data->power_state == POWER_STATE_OFF) ||
+			fb_data->powering_down)
+			epdc_powerup(fb_data);
+
+		/* Rails must be up before the update reaches the EPDC */
+		epdc_powerup_wait(fb_data);
+
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+		if ((fb_data->waiting_for_idle) ||
+			((fb_data->blank != FB_BLANK_UNBLANK) &&
+			(fb_data->blank != FB_BLANK_NORMAL))) {
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			ret = -EPERM;
+			goto out;
+		}
+
+		/* Went idle and is about to power down, start again */
+		if ((fb_data->power_state == POWER_STATE_OFF) ||
+			fb_data->powering_down) {
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			continue;
+		}
+
+		lut = epdc_direct_lut(fb_data);
+		if (lut >= 0)
+			break;
+
+		epdc_direct_wait(fb_data, &flags);
+		waited = true;
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	}
+
+	memset(&desc->times, 0, sizeof(desc->times));
+	desc->times.send = start;
+	epdc_claim_touch(fb_data, &desc->times);
+	desc->update_order = fb_data->order_cnt++;
+
+	upd_data_list->lut_num = lut;
+	fb_data->cur_update = upd_data_list;
+
+	/* Reset mask for LUTS that have completed during WB processing */
+	fb_data->luts_complete_wb = 0;
+
+	/* Mark LUT as containing new update */
+	fb_data->lut_update_order[lut] = desc->update_order;
+
+	/* Enable Collision and WB complete IRQs */
+	epdc_working_buf_intr(true);
+	epdc_lut_complete_intr(lut, true);
+
+	epdc_set_temp(epdc_wv_temp_index(fb_data, fb_data->temp_index));
+	epdc_set_update_addr(upd_data_list->phys_addr);
+	epdc_set_update_coord(adj.left, adj.top);
+	epdc_set_update_dimensions(adj.width, adj.height);
+	epdc_submit_update(lut, desc->upd_data.waveform_mode,
+			   desc->upd_data.update_mode, false, 0);
+	epdc_note_submit(fb_data, upd_data_list, &adj);
+
+	us = ktime_us_delta(ktime_get(), start);
+	fb_data->direct_cnt++;
+	fb_data->direct_total_us += us;
+	if (us > fb_data->direct_max_us)
+		fb_data->direct_max_us = us;
+	if (waited)
+		fb_data->direct_waits++;
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+out:
+	mutex_unlock(&fb_data->direct_mutex);
+	return ret;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_send_direct);
+
+/*
+ * Wait for all markers with the given value. If marker_data is not
+ * NULL it receives the highest histogram class and the last waveform
+ * mode of the markers waited on.
+ */
+static int epdc_wait_update_complete(u32 update_marker,
+	struct mxc_epdc_fb_data *fb_data,
+	struct mxcfb_update_marker_data *marker_data)
+{
+	struct update_marker_data *next_marker;
+	struct update_marker_data *temp;
+	unsigned long flags;
+	bool marker_found = false;
+	int ret = 0;
+	
+	GALLEN_DBGLOCAL_BEGIN();
+
+	/* 0 is an invalid update_marker value */
+	if (update_marker == 0) {
+		GALLEN_DBGLOCAL_ESC();
+		return -EINVAL;
+	}
+
+	/*
+	 * Find completion associated with update_marker requested.
+	 * Note: If update completed already, marker will have been
+	 * cleared, it won't be found, and function will just return.
+	 * A batched update leaves one marker per queued region, so keep
+	 * waiting until none with this value is left.
+	 */
+	for (;;) {
+		marker_found = false;
+
+		/* Grab queue lock to protect access to marker list */
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+		list_for_each_entry_safe(next_marker, temp,
+			&fb_data->full_marker_list, full_list) {
+			GALLEN_DBGLOCAL_RUNLOG(0);
+			if (next_marker->update_marker == update_marker) {
+				GALLEN_DBGLOCAL_RUNLOG(1);
+				dev_dbg(fb_data->dev, "Waiting for marker %d\n",
+					update_marker);
+				next_marker->waiting = true;
+				marker_found = true;
+				break;
+			}
+		}
+
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+		/*
+		 * If marker not found, it has either been signalled already
+		 * or the update request failed.  In either case, just return.
+		 */
+		if (!marker_found)
+			break;
+
+		ret = wait_for_completion_timeout(&next_marker->update_completion,
+							msecs_to_jiffies(5000));
+		if (!ret) {
+			GALLEN_DBGLOCAL_RUNLOG(2);
+			dev_err(fb_data->dev,
+				"Timed out waiting for update completion\n");
+			list_del_init(&next_marker->full_list);
+			ret = -ETIMEDOUT;
+		}
+
+		if (marker_data && ret > 0) {
+			marker_data->hist_class = max(marker_data->hist_class,
+						      next_marker->hist_class);
+			marker_data->waveform_mode = next_marker->waveform_mode;
+		}
+
+		/* Free update marker object */
+		kfree(next_marker);
+
+		if (ret < 0)
+			break;
+	}
+
+	GALLEN_DBGLOCAL_END();
+	return ret;
+}
+
+int mxc_epdc_fb_wait_update_complete(u32 update_marker, struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	return epdc_wait_update_complete(update_marker, fb_data, NULL);
+}
+EXPORT_SYMBOL(mxc_epdc_fb_wait_update_complete);
+
+int mxc_epdc_fb_set_pwrdown_delay(u32 pwrdown_delay,
+					    struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	fb_data->pwrdown_delay = pwrdown_delay;
+
+	return 0;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_set_pwrdown_delay);
+
+int mxc_epdc_get_pwrdown_delay(struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	return fb_data->pwrdown_delay;
+}
+EXPORT_SYMBOL(mxc_epdc_get_pwrdown_delay);
+
+static int mxc_epdc_fb_ioctl(struct fb_info *info, unsigned int cmd,
+			     unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	int ret = -EINVAL;
+	GALLEN_DBGLOCAL_BEGIN();
+
+//	ERR_MSG("MXCFB_SEND_UPDATE = 0x%x\t\tMXCFB_GET_UPDATE_MODE = 0x%x\n", MXCFB_SEND_UPDATE, MXCFB_GET_UPDATE_MODE);
+	
+	fake_s1d13522_progress_stop();
+	
+
+	switch (cmd) {
+	case MXCFB_SET_WAVEFORM_MODES: GALLEN_DBGLOCAL_RUNLOG(0);
+		{
+			struct mxcfb_waveform_modes modes;
+			if (!copy_from_user(&modes, argp, sizeof(modes))) {
+				GALLEN_DBGLOCAL_RUNLOG(1);
+				mxc_epdc_fb_set_waveform_modes(&modes, info);
+				ret = 0;
+			}
+			break;
+		}
+	case MXCFB_SET_TEMPERATURE: GALLEN_DBGLOCAL_RUNLOG(2);
+		{
+			int temperature;
+			if (!get_user(temperature, (int32_t __user *) arg)) {
+				GALLEN_DBGLOCAL_RUNLOG(3);
+				ret = mxc_epdc_fb_set_temperature(temperature,
+					info);
+			}
+			break;
+		}
+	case MXCFB_SET_AUTO_UPDATE_MODE:GALLEN_DBGLOCAL_RUNLOG(4);
+		{
+			u32 auto_mode = 0;
+			if (!get_user(auto_mode, (__u32 __user *) arg)) {
+				GALLEN_DBGLOCAL_RUNLOG(5);
+				ret = mxc_epdc_fb_set_auto_update(auto_mode,
+					info);
+			}
+			break;
+		}
+	case MXCFB_SET_UPDATE_SCHEME:GALLEN_DBGLOCAL_RUNLOG(6);
+		{
+			u32 upd_scheme = 0;
+			if (!get_user(upd_scheme, (__u32 __user *) arg)) {
+				GALLEN_DBGLOCAL_RUNLOG(7);
+				ret = mxc_epdc_fb_set_upd_scheme(upd_scheme,
+					info);
+			}
+			break;
+		}
+	case MXCFB_SET_UPDATE_MODE:
+		{
+			int mode;
+			if (!get_user(mode, (int32_t __user *) arg))
+			{
 				giEINK_UPDATE_MODE = mode;
 			}
-			break;
+			break;
+		}
+	case MXCFB_GET_UPDATE_MODE:
+		{
+			if (put_user(giEINK_UPDATE_MODE,
+				(int32_t __user *)argp))
+				ret = -EFAULT;
+			ret = 0;
+			break;
+		}
+	case MXCFB_SEND_UPDATE:GALLEN_DBGLOCAL_RUNLOG(8);
+		{
+			struct mxcfb_update_data upd_data;
+			//printk("MXCFB_SEND_UPDATE:0x%x\n",MXCFB_SEND_UPDATE);
+			if (!copy_from_user(&upd_data, argp,
+				sizeof(upd_data))) {
+				GALLEN_DBGLOCAL_RUNLOG(9);	
+				/* PxP/LUT setup and the refresh follow */
+				cpufreq_inputboost_kick();
+				ksm_note_activity();
+				ret = mxc_epdc_fb_send_update(&upd_data, info);
+				if (ret == 0 && copy_to_user(argp, &upd_data,
+					sizeof(upd_data))) {
+					GALLEN_DBGLOCAL_RUNLOG(10);
+					ret = -EFAULT;
+				}
+			} else {
+				GALLEN_DBGLOCAL_RUNLOG(11);
+				ret = -EFAULT;
+			}
+
+			break;
+		}
+	case MXCFB_SEND_UPDATES:
+		{
+			struct mxcfb_update_rects *upd_rects;
+
+			upd_rects = kmalloc(sizeof(*upd_rects), GFP_KERNEL);
+			if (!upd_rects) {
+				ret = -ENOMEM;
+				break;
+			}
+			if (!copy_from_user(upd_rects, argp, sizeof(*upd_rects))) {
+				cpufreq_inputboost_kick();
+				ksm_note_activity();
+				ret = mxc_epdc_fb_send_updates(upd_rects, info);
+			} else
+				ret = -EFAULT;
+			kfree(upd_rects);
+			break;
+		}
+
+	case MXCFB_WAIT_FOR_UPDATE_COMPLETE:GALLEN_DBGLOCAL_RUNLOG(12);
+		{
+			u32 update_marker = 0;
+			if (!get_user(update_marker, (__u32 __user *) arg)) {
+				GALLEN_DBGLOCAL_RUNLOG(13);
+				ret =
+				    mxc_epdc_fb_wait_update_complete(update_marker,
+					info);
+			}
+			break;
+		}
+
+	case MXCFB_WAIT_FOR_UPDATE_COMPLETE_HIST:
+		{
+			struct mxcfb_update_marker_data marker_data;
+
+			if (copy_from_user(&marker_data, argp,
+					   sizeof(marker_data))) {
+				ret = -EFAULT;
+				break;
+			}
+			marker_data.hist_class = MXCFB_HIST_CLASS_NONE;
+			marker_data.waveform_mode = 0;
+			ret = epdc_wait_update_complete(
+				marker_data.update_marker,
+				(struct mxc_epdc_fb_data *)info, &marker_data);
+			if (ret >= 0 && copy_to_user(argp, &marker_data,
+						     sizeof(marker_data)))
+				ret = -EFAULT;
+			break;
+		}
+
+	case MXCFB_SEND_DIRECT:
+		{
+			struct mxcfb_direct_update upd;
+
+			if (copy_from_user(&upd, argp, sizeof(upd))) {
+				ret = -EFAULT;
+				break;
+			}
+			ret = mxc_epdc_fb_send_direct(&upd, info);
+			break;
+		}
+
+	case MXCFB_SET_PWRDOWN_DELAY:GALLEN_DBGLOCAL_RUNLOG(14);
+		{
+			int delay = 0;
+			if (!get_user(delay, (__u32 __user *) arg))
+			{
+				GALLEN_DBGLOCAL_RUNLOG(15);
+				ret =
+				    mxc_epdc_fb_set_pwrdown_delay(delay, info);
+			}
+			break;
+		}
+
+	case MXCFB_GET_PWRDOWN_DELAY:GALLEN_DBGLOCAL_RUNLOG(16);
+		{
+			int pwrdown_delay = mxc_epdc_get_pwrdown_delay(info);
+			if (put_user(pwrdown_delay,
+				(int __user *)argp))
+			{
+				GALLEN_DBGLOCAL_RUNLOG(17);
+					
+				ret = -EFAULT;
+			}
+			ret = 0;
+			break;
+		}
+
+	case MXCFB_SET_MERGE_ON_WAVEFORM_MISMATCH:
+		{
+			int merge = 1;
+			if (!get_user(merge, (int __user *) arg))
+				ret = mxc_epdc_fb_set_merge_on_waveform_mismatch(merge, info);
+			break;
+		}
+
+	default:GALLEN_DBGLOCAL_RUNLOG(18);
+		{
+			ret = k_fake_s1d13522_ioctl(cmd,arg);
+		}
+		break;
+	}
+	GALLEN_DBGLOCAL_END();
+	return ret;
+}
+
+static void mxc_epdc_fb_update_rect(struct mxc_epdc_fb_data *fb_data,
+				    struct mxcfb_rect *rect)
+{
+	struct mxcfb_update_data update;
+	GALLEN_DBGLOCAL_BEGIN();
+
+	/* Do partial screen update of the dirty rectangle */
+	update.update_region = *rect;
+	update.waveform_mode = WAVEFORM_MODE_AUTO;
+	update.update_mode = UPDATE_MODE_PARTIAL;
+	update.update_marker = 0;
+	update.temp = TEMP_USE_AMBIENT;
+	update.flags = 0;
+
+	mxc_epdc_fb_send_update(&update, &fb_data->info);
+	
+	GALLEN_DBGLOCAL_END();
+}
+
+/*
+ * Returns true if the framebuffer page changed since deferred io last
+ * looked at it, and remembers its new hash.
+ */
+static bool epdc_defio_page_changed(struct mxc_epdc_fb_data *fb_data,
+				    unsigned long index)
+{
+	u32 hash = jhash2((u32 *)(fb_data->info.screen_base +
+				  (index << PAGE_SHIFT)),
+			  PAGE_SIZE / sizeof(u32), 0);
+
+	if (fb_data->defio_page_hash[index] == hash)
+		return false;
+
+	fb_data->defio_page_hash[index] = hash;
+	return true;
+}
+
+/*
+ * Fold the inclusive box (x1, y1)-(x2, y2) into the rectangle list.
+ * Pages arrive sorted, so only the last rectangle can be close enough
+ * to merge with; once the list is full everything goes into the last one.
+ */
+static void epdc_defio_add_box(struct mxcfb_rect *rects, int *nrects,
+			       int x1, int y1, int x2, int y2)
+{
+	struct mxcfb_rect *last = *nrects ? &rects[*nrects - 1] : NULL;
+	int lx2, ly2;
+
+	if (last && (y1 <= last->top + last->height - 1 + EPDC_DEFIO_MERGE_GAP
+		     || *nrects == EPDC_DEFIO_MAX_RECTS)) {
+		lx2 = max_t(int, last->left + last->width - 1, x2);
+		ly2 = max_t(int, last->top + last->height - 1, y2);
+		last->left = min_t(int, last->left, x1);
+		last->top = min_t(int, last->top, y1);
+		last->width = lx2 - last->left + 1;
+		last->height = ly2 - last->top + 1;
+		return;
+	}
+
+	last = &rects[(*nrects)++];
+	last->left = x1;
+	last->top = y1;
+	last->width = x2 - x1 + 1;
+	last->height = y2 - y1 + 1;
+}
+
+/* this is called back from the deferred io workqueue */
+static void mxc_epdc_fb_deferred_io(struct fb_info *info,
+				    struct list_head *pagelist)
+{
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct mxcfb_rect rects[EPDC_DEFIO_MAX_RECTS];
+	struct page *page;
+	unsigned long beg, end;
+	u32 line_length = info->fix.line_length;
+	int bpp = fb_data->epdc_fb_var.bits_per_pixel;
+	int xres = fb_data->epdc_fb_var.xres;
+	int yres = fb_data->epdc_fb_var.yres;
+	int yoffset = fb_data->epdc_fb_var.yoffset;
+	int x1, x2, y1, y2;
+	int nrects = 0;
+	int i;
+
+	if (fb_data->auto_mode != AUTO_UPDATE_MODE_AUTOMATIC_MODE)
+		return;
+
+	list_for_each_entry(page, pagelist, lru) {
+		fb_data->defio_pages++;
+		if (fb_data->defio_hash &&
+		    !epdc_defio_page_changed(fb_data, page->index)) {
+			fb_data->defio_pages_skipped++;
+			continue;
+		}
+
+		beg = page->index << PAGE_SHIFT;
+		end = beg + PAGE_SIZE - 1;
+		y1 = beg / line_length;
+		y2 = end / line_length;
+
+		/* A page inside a single line also bounds the columns */
+		if (y1 == y2) {
+			x1 = (beg % line_length) * 8 / bpp;
+			x2 = (end % line_length) * 8 / bpp;
+			if (x1 >= xres)
+				continue;
+			if (x2 >= xres)
+				x2 = xres - 1;
+		} else {
+			x1 = 0;
+			x2 = xres - 1;
+		}
+
+		/* Page offsets are in the virtual screen, updates are not */
+		y1 -= yoffset;
+		y2 -= yoffset;
+		if (y2 < 0 || y1 >= yres)
+			continue;
+		if (y1 < 0)
+			y1 = 0;
+		if (y2 >= yres)
+			y2 = yres - 1;
+
+		epdc_defio_add_box(rects, &nrects, x1, y1, x2, y2);
+	}
+
+	fb_data->defio_rects += nrects;
+	for (i = 0; i < nrects; i++)
+		mxc_epdc_fb_update_rect(fb_data, &rects[i]);
+}
+
+void mxc_epdc_fb_flush_updates(struct mxc_epdc_fb_data *fb_data)
+{
+	unsigned long flags;
+	int ret;
+	
+	GALLEN_DBGLOCAL_BEGIN();
+	/* Grab queue lock to prevent any new updates from being submitted */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	GALLEN_DBGLOCAL_PRINTMSG("list_empty=%d\n",list_empty(&fb_data->upd_pending_list));
+	GALLEN_DBGLOCAL_PRINTMSG("is_free_list_full=%d\n",is_free_list_full(fb_data));
+	GALLEN_DBGLOCAL_PRINTMSG("power_state=%d,power_down=%d\n",fb_data->power_state,fb_data->powering_down);
+		
+	/*
+	 * 3 places to check for updates that are active or pending:
+	 *   1) Updates in the pending list
+	 *   2) Update buffers in use (e.g., PxP processing)
+	 *   3) Active updates to panel - We can key off of EPDC
+	 *      power state to know if we have active updates.
+	 */
+	#if 0
+	/* gallen modify 20110704 : if there is no update list in queue
+		,this condition will cause update timeout 5 secs .
+	*/
+	if (!list_empty(&fb_data->upd_pending_list) ||
+		!is_free_list_full(fb_data) ||
+		((fb_data->power_state == POWER_STATE_ON) &&
+		!fb_data->powering_down))
+	#else
+	if (!list_empty(&fb_data->upd_pending_list) ||
+		!is_free_list_full(fb_data) )
+	#endif
+	{
+		GALLEN_DBGLOCAL_RUNLOG(0);
+
+		/* Initialize event signalling updates are done */
+		init_completion(&fb_data->updates_done);
+		fb_data->waiting_for_idle = true;
+
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		/* Wait for any currently active updates to complete */
+		ret = wait_for_completion_timeout(&fb_data->updates_done,
+						msecs_to_jiffies(5000));
+		if (!ret)
+		{
+			GALLEN_DBGLOCAL_RUNLOG(1);
+			dev_err(fb_data->dev,
+				"Flush updates timeout! ret = 0x%x\n", ret);
+		}
+
+		spin_lock_irqsave(&fb_data->queue_lock, flags);
+		fb_data->waiting_for_idle = false;
+	}
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	GALLEN_DBGLOCAL_END();
+}
+
+static int mxc_epdc_fb_blank(int blank, struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int ret;
+
+	GALLEN_DBGLOCAL_BEGIN();
+	dev_dbg(fb_data->dev, "blank = %d\n", blank);
+
+	if (fb_data->blank == blank)
+	{
+		GALLEN_DBGLOCAL_ESC();
+		return 0;
+	}
+
+	//fb_data->blank = blank;
+
+	switch (blank) {
+	case FB_BLANK_POWERDOWN:GALLEN_DBGLOCAL_RUNLOG(0);
+		mxc_epdc_fb_flush_updates(fb_data);
+		/* Wait for powerdown */
+		mutex_lock(&fb_data->power_mutex);
+		if ((fb_data->power_state == POWER_STATE_ON) &&
+			(fb_data->pwrdown_delay == FB_POWERDOWN_DISABLE)) {
+
+			/* Powerdown disabled, so we disable EPDC manually */
+			int count = 0;
+			int sleep_ms = 10;
+
+			mutex_unlock(&fb_data->power_mutex);
+
+			/* If any active updates, wait for them to complete */
+			while (fb_data->updates_active) {
+				/* Timeout after 1 sec */
+				if ((count * sleep_ms) > 1000)
+					break;
+				msleep(sleep_ms);
+				count++;
+			}
+
+			fb_data->powering_down = true;
+			epdc_powerdown(fb_data);
+		} else if (fb_data->power_state != POWER_STATE_OFF) {
+//		if (fb_data->power_state != POWER_STATE_OFF) {
+			GALLEN_DBGLOCAL_RUNLOG(1);
+			fb_data->wait_for_powerdown = true;
+			init_completion(&fb_data->powerdown_compl);
+			mutex_unlock(&fb_data->power_mutex);
+			ret = wait_for_completion_timeout(&fb_data->powerdown_compl,
+				msecs_to_jiffies(5000));
+			if (!ret) {
+				dev_err(fb_data->dev,
+					"No powerdown received!\n");
+				GALLEN_DBGLOCAL_ESC();
+				return -ETIMEDOUT;
+			}
+		} else
+			mutex_unlock(&fb_data->power_mutex);
+		break;
+	case FB_BLANK_VSYNC_SUSPEND:GALLEN_DBGLOCAL_RUNLOG(1);
+	case FB_BLANK_HSYNC_SUSPEND:GALLEN_DBGLOCAL_RUNLOG(2);
+	case FB_BLANK_NORMAL:GALLEN_DBGLOCAL_RUNLOG(3);
+		mxc_epdc_fb_flush_updates(fb_data);
+		break;
+	}
+	
+	GALLEN_DBGLOCAL_END();
+	return 0;
+}
+
+static int mxc_epdc_fb_pan_display(struct fb_var_screeninfo *var,
+				   struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	u_int y_bottom;
+	unsigned long flags;
+	
+	GALLEN_DBGLOCAL_BEGIN();
+
+	dev_dbg(info->device, "%s: var->yoffset %d, info->var.yoffset %d\n",
+		 __func__, var->yoffset, info->var.yoffset);
+	/* check if var is valid; also, xpan is not supported */
+	if (!var || (var->xoffset != info->var.xoffset) ||
+	    (var->yoffset + var->yres > var->yres_virtual)) {
+		dev_dbg(info->device, "x panning not supported\n");
+		GALLEN_DBGLOCAL_ESC();
+		return -EINVAL;
+	}
+
+	if ((fb_data->epdc_fb_var.xoffset == var->xoffset) &&
+		(fb_data->epdc_fb_var.yoffset == var->yoffset)) {
+		GALLEN_DBGLOCAL_ESC();
+		return 0;	/* No change, do nothing */
+	}
+
+	y_bottom = var->yoffset;
+
+	if (!(var->vmode & FB_VMODE_YWRAP))
+		y_bottom += var->yres;
+
+	if (y_bottom > info->var.yres_virtual) {
+		GALLEN_DBGLOCAL_ESC();
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	fb_data->fb_offset = (var->yoffset * var->xres_virtual + var->xoffset)
+		* (var->bits_per_pixel) / 8;
+
+	fb_data->epdc_fb_var.xoffset = var->xoffset;
+	fb_data->epdc_fb_var.yoffset = var->yoffset;
+
+	if (var->vmode & FB_VMODE_YWRAP) {
+		GALLEN_DBGLOCAL_RUNLOG(0);
+		info->var.vmode |= FB_VMODE_YWRAP;
+	}
+	else {
+		GALLEN_DBGLOCAL_RUNLOG(1);
+		info->var.vmode &= ~FB_VMODE_YWRAP;
+	}
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	GALLEN_DBGLOCAL_END();
+	return 0;
+}
+
+static struct fb_ops mxc_epdc_fb_ops = {
+	.owner = THIS_MODULE,
+	.fb_check_var = mxc_epdc_fb_check_var,
+	.fb_set_par = mxc_epdc_fb_set_par,
+	.fb_setcolreg = mxc_epdc_fb_setcolreg,
+	.fb_pan_display = mxc_epdc_fb_pan_display,
+	.fb_ioctl = mxc_epdc_fb_ioctl,
+	.fb_mmap = mxc_epdc_fb_mmap,
+	.fb_blank = mxc_epdc_fb_blank,
+	.fb_fillrect = cfb_fillrect,
+	.fb_copyarea = cfb_copyarea,
+	.fb_imageblit = cfb_imageblit,
+};
+
+static struct fb_deferred_io mxc_epdc_fb_defio = {
+	.delay = HZ,
+	.deferred_io = mxc_epdc_fb_deferred_io,
+};
+
+static void epdc_done_work_func(struct work_struct *work)
+{
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data,
+			epdc_done_work.work);
+
+	epdc_wq_account(fb_data, EPDC_WQ_DONE);
+	epdc_powerdown(fb_data);
+}
+
+static bool is_free_list_full(struct mxc_epdc_fb_data *fb_data)
+{
+	int count = 0;
+	struct update_data_list *plist;
+
+	/* Count buffers in free buffer list */
+	list_for_each_entry(plist, &fb_data->upd_buf_free_list, list)
+		count++;
+
+	/* Check to see if all buffers are in this list */
+	if (count == fb_data->upd_buf_count)
+		return true;
+	else
+		return false;
+}
+
+static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
+{
+	struct mxc_epdc_fb_data *fb_data = dev_id;
+	struct update_data_list *collision_update;
+	struct mxcfb_rect *next_upd_region;
+	struct update_marker_data *next_marker;
+	struct update_marker_data *temp;
+	unsigned long flags;
+	int temp_index;
+	u32 temp_mask;
+	u32 lut;
+	bool ignore_collision = false;
+	int i;
+	bool wb_lut_done = false;
+	bool free_update = true;
+	int next_lut;
+	u32 epdc_irq_stat, epdc_luts_active, epdc_wb_busy, epdc_luts_avail;
+	u32 epdc_collision, epdc_colliding_luts, epdc_next_lut_15;
+
+	/*
+	 * If we just completed one-time panel init, bypass
+	 * queue handling, clear interrupt and return
+	 */
+	if (fb_data->in_init) {
+		if (epdc_is_working_buffer_complete()) {
+			epdc_working_buf_intr(false);
+			epdc_clear_working_buf_irq();
+			dev_dbg(fb_data->dev, "Cleared WB for init update\n");
+		}
+
+		if (epdc_is_lut_complete(0)) {
+			epdc_lut_complete_intr(0, false);
+			epdc_clear_lut_complete_irq(0);
+			fb_data->in_init = false;
+			dev_dbg(fb_data->dev, "Cleared LUT complete for init update\n");
+		}
+
+		return IRQ_HANDLED;
+	}
+
+	if (!(__raw_readl(EPDC_IRQ_MASK) & __raw_readl(EPDC_IRQ)))
+		return IRQ_HANDLED;
+
+	if (__raw_readl(EPDC_IRQ) & EPDC_IRQ_TCE_UNDERRUN_IRQ) {
+		dev_err(fb_data->dev,
+			"TCE underrun! Will continue to update panel\n");
+		/* Clear TCE underrun IRQ */
+		__raw_writel(EPDC_IRQ_TCE_UNDERRUN_IRQ, EPDC_IRQ_CLEAR);
+	}
+
+	/* Check if we are waiting on EOF to sync a new update submission */
+	if (epdc_signal_eof()) {
+		epdc_eof_intr(false);
+		epdc_clear_eof_irq();
+		complete(&fb_data->eof_event);
+	}
+
+	/* Capture EPDC status one time up front to prevent race conditions */
+	epdc_irq_stat = __raw_readl(EPDC_IRQ);
+	epdc_luts_active = epdc_any_luts_active();
+	epdc_wb_busy = epdc_is_working_buffer_busy();
+	epdc_luts_avail = epdc_luts_available(fb_data->direct_reserved);
+	epdc_collision = epdc_is_collision();
+	epdc_colliding_luts = epdc_get_colliding_luts();
+	epdc_next_lut_15 = epdc_choose_next_lut(fb_data->direct_reserved,
+						&next_lut);
+
+	/* Protect access to buffer queues and to update HW */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	/* Free any LUTs that have completed */
+	for (i = 0; i < EPDC_NUM_LUTS; i++) {
+		if (!(epdc_irq_stat & (1 << i)))
+			continue;
+
+		dev_dbg(fb_data->dev, "\nLUT %d completed\n", i);
+
+		epdc_note_lut_complete(fb_data, i);
+
+		/* Disable IRQ for completed LUT */
+		epdc_lut_complete_intr(i, false);
+
+		/*
+		 * Go through all updates in the collision list and
+		 * unmask any updates that were colliding with
+		 * the completed LUT.
+		 */
+		list_for_each_entry(collision_update,
+				    &fb_data->upd_buf_collision_list, list) {
+			collision_update->collision_mask =
+			    collision_update->collision_mask & ~(1 << i);
+		}
+
+		epdc_clear_lut_complete_irq(i);
+
+		fb_data->luts_complete_wb |= 1 << i;
+
+		fb_data->lut_update_order[i] = 0;
+
+		/* Signal completion if submit workqueue needs a LUT */
+		if (fb_data->waiting_for_lut) {
+			complete(&fb_data->update_res_free);
+			fb_data->waiting_for_lut = false;
+		}
+
+		/* Signal completion if LUT15 free and is needed */
+		if (fb_data->waiting_for_lut15 && (i == 15)) {
+			complete(&fb_data->lut15_free);
+			fb_data->waiting_for_lut15 = false;
+		}
+
+		/* Signal completion if a direct update needs a LUT */
+		if (fb_data->waiting_for_direct) {
+			complete(&fb_data->direct_res_free);
+			fb_data->waiting_for_direct = false;
+		}
+
+		/* Detect race condition where WB and its LUT complete
+		   (i.e. full update completes) in one swoop */
+		if (fb_data->cur_update &&
+			(i == fb_data->cur_update->lut_num))
+			wb_lut_done = true;
+
+		/* Signal completion if anyone waiting on this LUT */
+		if (!wb_lut_done)
+			list_for_each_entry_safe(next_marker, temp,
+				&fb_data->full_marker_list,
+				full_list) {
+				if (next_marker->lut_num != i)
+					continue;
+
+				/* Found marker to signal - remove from list */
+				list_del_init(&next_marker->full_list);
+
+				/* Signal completion of update */
+				dev_dbg(fb_data->dev, "Signaling marker %d\n",
+					next_marker->update_marker);
+				if (next_marker->waiting)
+					complete(&next_marker->update_completion);
+				else
+					kfree(next_marker);
+			}
+	}
+
+	/* Check to see if all updates have completed */
+	if (list_empty(&fb_data->upd_pending_list) &&
+		is_free_list_full(fb_data) &&
+		(fb_data->cur_update == NULL) &&
+		!epdc_luts_active) {
+
+        fb_data->updates_active = false;
+
+		/* Nothing is using the waveform, switch in a newer one */
+		epdc_wv_install(fb_data);
+
+		if (fb_data->power_state == POWER_STATE_ON)
+			fb_data->pwr_idle_start = ktime_get();
+
+		if (fb_data->pwrdown_delay != FB_POWERDOWN_DISABLE) {
+			/*
+			 * Set variable to prevent overlapping
+			 * enable/disable requests
+			 */
+			fb_data->powering_down = true;
+
+			/* Schedule task to disable EPDC HW until next update */
+			epdc_wq_stamp(fb_data, EPDC_WQ_DONE,
+				epdc_pwrdown_delay_ms(fb_data));
+			queue_delayed_work(fb_data->epdc_submit_workqueue,
+				&fb_data->epdc_done_work,
+				msecs_to_jiffies(epdc_pwrdown_delay_ms(fb_data)));
+
+			/* Reset counter to reduce chance of overflow */
+			fb_data->order_cnt = 0;
 		}
-	case MXCFB_GET_UPDATE_MODE:
-		{
-			if (put_user(giEINK_UPDATE_MODE,
-				(int32_t __user *)argp))
-				ret = -EFAULT;
-			ret = 0;
-			break;
+
+		/* Give back buffers grown under load */
+		if (fb_data->upd_buf_count > fb_data->upd_buf_min)
+			schedule_delayed_work(&fb_data->upd_buf_shrink_work,
+				EPDC_UPD_BUF_SHRINK_DELAY);
+
+		if (fb_data->waiting_for_idle)
+			complete(&fb_data->updates_done);
+	}
+
+	/* Is Working Buffer busy? */
+	if (epdc_wb_busy) {
+		/* Can't submit another update until WB is done */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return IRQ_HANDLED;
+	}
+
+	/*
+	 * Were we waiting on working buffer?
+	 * If so, update queues and check for collisions
+	 */
+	if (fb_data->cur_update != NULL) {
+		dev_dbg(fb_data->dev, "\nWorking buffer completed\n");
+
+		/* Signal completion if submit workqueue was waiting on WB */
+		if (fb_data->waiting_for_wb) {
+			complete(&fb_data->update_res_free);
+			fb_data->waiting_for_lut = false;
 		}
-	case MXCFB_SEND_UPDATE:GALLEN_DBGLOCAL_RUNLOG(8);
-		{
-			struct mxcfb_update_data upd_data;
-			//printk("MXCFB_SEND_UPDATE:0x%x\n",MXCFB_SEND_UPDATE);
-			if (!copy_from_user(&upd_data, argp,
-				sizeof(upd_data))) {
-				GALLEN_DBGLOCAL_RUNLOG(9);	
-				ret = mxc_epdc_fb_send_update(&upd_data, info);
-				if (ret == 0 && copy_to_user(argp, &upd_data,
-					sizeof(upd_data))) {
-					GALLEN_DBGLOCAL_RUNLOG(10);
-					ret = -EFAULT;
+
+		/* Or a direct update */
+		if (fb_data->waiting_for_direct) {
+			complete(&fb_data->direct_res_free);
+			fb_data->waiting_for_direct = false;
+		}
+
+		if (fb_data->cur_update == &fb_data->direct_upd) {
+			epdc_direct_wb_done(fb_data);
+			goto wb_done;
+		}
+
+		/* Was there a collision? */
+		if (epdc_is_collision()) {
+			fb_data->upd_collisions++;
+
+			/* Check list of colliding LUTs, and add to our collision mask */
+			fb_data->cur_update->collision_mask =
+			    epdc_get_colliding_luts();
+
+			/* Clear collisions that completed since WB began */
+			fb_data->cur_update->collision_mask &=
+				~fb_data->luts_complete_wb;
+
+			dev_dbg(fb_data->dev, "Collision mask = 0x%x\n",
+			       epdc_get_colliding_luts());
+
+			/*
+			 * If we collide with newer updates, then
+			 * we don't need to re-submit the update. The
+			 * idea is that the newer updates should take
+			 * precedence anyways, so we don't want to
+			 * overwrite them.
+			 */
+			for (temp_mask = fb_data->cur_update->collision_mask, lut = 0;
+				temp_mask != 0;
+				lut++, temp_mask = temp_mask >> 1) {
+				if (!(temp_mask & 0x1))
+					continue;
+
+				if (fb_data->lut_update_order[lut] >=
+					fb_data->cur_update->update_desc->update_order) {
+					dev_dbg(fb_data->dev,
+						"Ignoring collision with"
+						"newer update.\n");
+					ignore_collision = true;
+					break;
 				}
-			} else {
-				GALLEN_DBGLOCAL_RUNLOG(11);
-				ret = -EFAULT;
 			}
 
-			break;
-		}
-	case MXCFB_WAIT_FOR_UPDATE_COMPLETE:GALLEN_DBGLOCAL_RUNLOG(12);
-		{
-			u32 update_marker = 0;
-			if (!get_user(update_marker, (__u32 __user *) arg)) {
-				GALLEN_DBGLOCAL_RUNLOG(13);
-				ret =
-				    mxc_epdc_fb_wait_update_complete(update_marker,
-					info);
-			}
-			break;
-		}
+			if (!ignore_collision) {
+				free_update = false;
+				/*
+				 * If update has markers, clear the LUTs to
+				 * avoid signalling that they have completed.
+				 */
+				list_for_each_entry_safe(next_marker, temp,
+					&fb_data->cur_update->update_desc->upd_marker_list,
+					upd_list)
+					next_marker->lut_num = INVALID_LUT;
 
-	case MXCFB_SET_PWRDOWN_DELAY:GALLEN_DBGLOCAL_RUNLOG(14);
-		{
-			int delay = 0;
-			if (!get_user(delay, (__u32 __user *) arg))
-			{
-				GALLEN_DBGLOCAL_RUNLOG(15);
-				ret =
-				    mxc_epdc_fb_set_pwrdown_delay(delay, info);
-			}
-			break;
-		}
+				/* Time it from its resubmission instead */
+				memset(&fb_data->lut_times[fb_data->cur_update->lut_num],
+					0, sizeof(struct epdc_upd_times));
 
-	case MXCFB_GET_PWRDOWN_DELAY:GALLEN_DBGLOCAL_RUNLOG(16);
-		{
-			int pwrdown_delay = mxc_epdc_get_pwrdown_delay(info);
-			if (put_user(pwrdown_delay,
-				(int __user *)argp))
-			{
-				GALLEN_DBGLOCAL_RUNLOG(17);
-					
-				ret = -EFAULT;
+				/* Move to collision list */
+				list_add_tail(&fb_data->cur_update->list,
+					 &fb_data->upd_buf_collision_list);
 			}
-			ret = 0;
-			break;
 		}
 
-	case MXCFB_SET_MERGE_ON_WAVEFORM_MISMATCH:
-		{
-			int merge = 1;
-			if (!get_user(merge, (int __user *) arg))
-				ret = mxc_epdc_fb_set_merge_on_waveform_mismatch(merge, info);
-			break;
-		}
+		if (free_update) {
+			/* Handle condition where WB & LUT are both complete */
+			if (wb_lut_done)
+				list_for_each_entry_safe(next_marker, temp,
+					&fb_data->cur_update->update_desc->upd_marker_list,
+					upd_list) {
 
-	default:GALLEN_DBGLOCAL_RUNLOG(18);
-		{
-			ret = k_fake_s1d13522_ioctl(cmd,arg);
+					/* Del from per-update & full list */
+					list_del_init(&next_marker->upd_list);
+					list_del_init(&next_marker->full_list);
+
+					/* Signal completion of update */
+					dev_dbg(fb_data->dev,
+						"Signaling marker %d\n",
+						next_marker->update_marker);
+					if (next_marker->waiting)
+						complete(&next_marker->update_completion);
+					else
+						kfree(next_marker);
+				}
+
+			/* Free marker list and update descriptor */
+			kfree(fb_data->cur_update->update_desc);
+
+			/* Add to free buffer list */
+			list_add_tail(&fb_data->cur_update->list,
+				 &fb_data->upd_buf_free_list);
 		}
+
+wb_done:
+		/* Clear current update */
+		fb_data->cur_update = NULL;
+
+		/* Clear IRQ for working buffer */
+		epdc_working_buf_intr(false);
+		epdc_clear_working_buf_irq();
+	}
+
+	if (fb_data->upd_scheme != UPDATE_SCHEME_SNAPSHOT) {
+		/* Queued update scheme processing */
+
+		/* Schedule task to submit collision and pending update */
+		if (!fb_data->powering_down)
+			epdc_queue_submit(fb_data);
+
+		/* Release buffer queues */
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+		return IRQ_HANDLED;
+	}
+
+	/* Snapshot update scheme processing */
+
+	/* Check to see if any LUTs are free */
+	if (!epdc_luts_avail) {
+		dev_dbg(fb_data->dev, "No luts available.\n");
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return IRQ_HANDLED;
+	}
+
+	/* Check to see if there is a valid LUT to use */
+	if (epdc_next_lut_15 && fb_data->tce_prevent) {
+		dev_dbg(fb_data->dev, "Must wait for LUT15\n");
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return IRQ_HANDLED;
+	}
+
+	/*
+	 * Are any of our collision updates able to go now?
+	 * Go through all updates in the collision list and check to see
+	 * if the collision mask has been fully cleared
+	 */
+	list_for_each_entry(collision_update,
+			    &fb_data->upd_buf_collision_list, list) {
+
+		if (collision_update->collision_mask != 0)
+			continue;
+
+		dev_dbg(fb_data->dev, "A collision update is ready to go!\n");
+		/*
+		 * We have a collision cleared, so select it
+		 * and we will retry the update
+		 */
+		fb_data->cur_update = collision_update;
+		list_del_init(&fb_data->cur_update->list);
 		break;
 	}
-	GALLEN_DBGLOCAL_END();
-	return ret;
+
+	/*
+	 * If we didn't find a collision update ready to go,
+	 * we try to grab one from the update queue
+	 */
+	if (fb_data->cur_update == NULL) {
+		/* Is update list empty? */
+		if (list_empty(&fb_data->upd_buf_queue)) {
+			dev_dbg(fb_data->dev, "No pending updates.\n");
+
+			/* No updates pending, so we are done */
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			return IRQ_HANDLED;
+		} else {
+			dev_dbg(fb_data->dev, "Found a pending update!\n");
+
+			/* Process next item in update list */
+			fb_data->cur_update =
+			    list_entry(fb_data->upd_buf_queue.next,
+				       struct update_data_list, list);
+			list_del_init(&fb_data->cur_update->list);
+		}
+	}
+
+	/* Use LUT selected above */
+	fb_data->cur_update->lut_num = next_lut;
+
+	/* Associate LUT with update markers */
+	list_for_each_entry_safe(next_marker, temp,
+		&fb_data->cur_update->update_desc->upd_marker_list, upd_list) {
+		next_marker->lut_num = fb_data->cur_update->lut_num;
+		next_marker->waveform_mode =
+			fb_data->cur_update->update_desc->upd_data.waveform_mode;
+	}
+
+	/* Mark LUT as containing new update */
+	fb_data->lut_update_order[fb_data->cur_update->lut_num] =
+		fb_data->cur_update->update_desc->update_order;
+
+	/* Enable Collision and WB complete IRQs */
+	epdc_working_buf_intr(true);
+	epdc_lut_complete_intr(fb_data->cur_update->lut_num, true);
+
+	/* Program EPDC update to process buffer */
+	next_upd_region =
+		&fb_data->cur_update->update_desc->upd_data.update_region;
+	if (fb_data->cur_update->update_desc->upd_data.temp
+		!= TEMP_USE_AMBIENT) {
+		temp_index = mxc_epdc_fb_get_temp_index(fb_data,
+			fb_data->cur_update->update_desc->upd_data.temp);
+		epdc_set_temp(epdc_wv_temp_index(fb_data, temp_index));
+	} else
+		epdc_set_temp(epdc_wv_temp_index(fb_data, fb_data->temp_index));
+	epdc_set_update_addr(fb_data->cur_update->phys_addr +
+				fb_data->cur_update->update_desc->epdc_offs);
+	epdc_set_update_coord(next_upd_region->left, next_upd_region->top);
+	epdc_set_update_dimensions(next_upd_region->width,
+				   next_upd_region->height);
+
+	epdc_submit_update(fb_data->cur_update->lut_num,
+			   fb_data->cur_update->update_desc->upd_data.waveform_mode,
+			   fb_data->cur_update->update_desc->upd_data.update_mode,
+			   false, 0);
+	epdc_note_submit(fb_data, fb_data->cur_update, next_upd_region);
+
+	/* Release buffer queues */
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return IRQ_HANDLED;
 }
 
-static void mxc_epdc_fb_update_pages(struct mxc_epdc_fb_data *fb_data,
-				     u16 y1, u16 y2)
+static void draw_mode0(struct mxc_epdc_fb_data *fb_data)
 {
-	struct mxcfb_update_data update;
+	u32 *upd_buf_ptr;
+	int i;
+	struct fb_var_screeninfo *screeninfo = &fb_data->epdc_fb_var;
+	u32 xres, yres;
+
 	GALLEN_DBGLOCAL_BEGIN();
+	upd_buf_ptr = (u32 *)fb_data->info.screen_base;
 
-	/* Do partial screen update, Update full horizontal lines */
-	update.update_region.left = 0;
-	update.update_region.width = fb_data->epdc_fb_var.xres;
-	update.update_region.top = y1;
-	update.update_region.height = y2 - y1;
-	update.waveform_mode = WAVEFORM_MODE_AUTO;
-	update.update_mode = UPDATE_MODE_FULL;
-	update.update_marker = 0;
-	update.temp = TEMP_USE_AMBIENT;
-	update.flags = 0;
+	epdc_working_buf_intr(true);
+	epdc_lut_complete_intr(0, true);
+	fb_data->in_init = true;
 
-	mxc_epdc_fb_send_update(&update, &fb_data->info);
-	
-	GALLEN_DBGLOCAL_END();
-}
+	/* Use unrotated (native) width/height */
+	if ((screeninfo->rotate == FB_ROTATE_CW) ||
+		(screeninfo->rotate == FB_ROTATE_CCW)) {
+		GALLEN_DBGLOCAL_RUNLOG(0);
+		xres = screeninfo->yres;
+		yres = screeninfo->xres;
+	} else {
+		GALLEN_DBGLOCAL_RUNLOG(1);
+		xres = screeninfo->xres;
+		yres = screeninfo->yres;
+	}
 
-/* this is called back from the deferred io workqueue */
-static void mxc_epdc_fb_deferred_io(struct fb_info *info,
-				    struct list_head *pagelist)
-{
-	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
-	struct page *page;
-	unsigned long beg, end;
-	int y1, y2, miny, maxy;
+	/* Program EPDC update to process buffer */
+	epdc_set_update_addr(fb_data->phys_start);
+	epdc_set_update_coord(0, 0);
+	epdc_set_update_dimensions(xres, yres);
+	epdc_submit_update(0, fb_data->wv_modes.mode_init, UPDATE_MODE_FULL, true, 0xFF);
 
-	if (fb_data->auto_mode != AUTO_UPDATE_MODE_AUTOMATIC_MODE)
-		return;
+	dev_dbg(fb_data->dev, "Mode0 update - Waiting for LUT to complete...\n");
+
+	/* Will timeout after ~4-5 seconds */
 
-	miny = INT_MAX;
-	maxy = 0;
-	list_for_each_entry(page, pagelist, lru) {
-		beg = page->index << PAGE_SHIFT;
-		end = beg + PAGE_SIZE - 1;
-		y1 = beg / info->fix.line_length;
-		y2 = end / info->fix.line_length;
-		if (y2 >= fb_data->epdc_fb_var.yres)
-			y2 = fb_data->epdc_fb_var.yres - 1;
-		if (miny > y1)
-			miny = y1;
-		if (maxy < y2)
-			maxy = y2;
+	for (i = 0; i < 40; i++) {
+		if (!epdc_is_lut_active(0)) {
+			dev_dbg(fb_data->dev, "Mode0 init complete\n");
+			GALLEN_DBGLOCAL_ESC();
+			return;
+		}
+		msleep(100);
 	}
 
-	mxc_epdc_fb_update_pages(fb_data, miny, maxy);
+	dev_err(fb_data->dev, "Mode0 init failed!\n");
+	GALLEN_DBGLOCAL_END();
+	return;
 }
 
-void mxc_epdc_fb_flush_updates(struct mxc_epdc_fb_data *fb_data)
+
+static void mxc_epdc_fb_fw_handler(const struct firmware *fw,
+						     void *context)
 {
-	unsigned long flags;
+	struct mxc_epdc_fb_data *fb_data = context;
 	int ret;
-	
+	struct mxcfb_waveform_data_file *wv_file;
+	int wv_data_offs;
+	const u8 *fw_data;
+	size_t fw_size;
+	bool fw_kept = false;
+	int i;
+	struct mxcfb_update_data update;
+	struct fb_var_screeninfo *screeninfo = &fb_data->epdc_fb_var;
+	u32 xres, yres;
+
 	GALLEN_DBGLOCAL_BEGIN();
-	/* Grab queue lock to prevent any new updates from being submitted */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
 
-	GALLEN_DBGLOCAL_PRINTMSG("list_empty=%d\n",list_empty(&fb_data->upd_pending_list));
-	GALLEN_DBGLOCAL_PRINTMSG("is_free_list_full=%d\n",is_free_list_full(fb_data));
-	GALLEN_DBGLOCAL_PRINTMSG("power_state=%d,power_down=%d\n",fb_data->power_state,fb_data->powering_down);
-		
-	/*
-	 * 3 places to check for updates that are active or pending:
-	 *   1) Updates in the pending list
-	 *   2) Update buffers in use (e.g., PxP processing)
-	 *   3) Active updates to panel - We can key off of EPDC
-	 *      power state to know if we have active updates.
-	 */
-	#if 0
-	/* gallen modify 20110704 : if there is no update list in queue
-		,this condition will cause update timeout 5 secs .
-	*/
-	if (!list_empty(&fb_data->upd_pending_list) ||
-		!is_free_list_full(fb_data) ||
-		((fb_data->power_state == POWER_STATE_ON) &&
-		!fb_data->powering_down))
-	#else
-	if (!list_empty(&fb_data->upd_pending_list) ||
-		!is_free_list_full(fb_data) )
-	#endif
-	{
+	if (fw == NULL) {
 		GALLEN_DBGLOCAL_RUNLOG(0);
+		/* If default FW file load failed, we give up */
+		if (fb_data->fw_default_load) {
+			GALLEN_DBGLOCAL_ESC();
+			return;
+		}
 
-		/* Initialize event signalling updates are done */
-		init_completion(&fb_data->updates_done);
-		fb_data->waiting_for_idle = true;
-
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		/* Wait for any currently active updates to complete */
-		ret = wait_for_completion_timeout(&fb_data->updates_done,
-						msecs_to_jiffies(5000));
-		if (!ret)
+		/* Try to load default waveform */
+		dev_dbg(fb_data->dev,
+			"Can't find firmware. Trying fallback fw\n");
+		fb_data->fw_default_load = true;
+#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
 		{
+			struct firmware fw;
+			
+
+			fw.size = gdwWF_size;
+			fw.data = (u8*)gpbWF_vaddr;
+			//fw.page = 0;
+			printk("[%s]:fw p=%p,size=%u\n",__FUNCTION__,fw.data,fw.size);
+			//mxc_epdc_fb_fw_handler(&fw,fb_data);
+			ret = 0;
+		}
+#else //][ befrom modify ...
+		ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+			"imx/epdc.fw", fb_data->dev, GFP_KERNEL, fb_data,
+			mxc_epdc_fb_fw_handler);
+		if (ret) {
 			GALLEN_DBGLOCAL_RUNLOG(1);
 			dev_err(fb_data->dev,
-				"Flush updates timeout! ret = 0x%x\n", ret);
+				"Failed request_firmware_nowait err %d\n", ret);
 		}
-
-		spin_lock_irqsave(&fb_data->queue_lock, flags);
-		fb_data->waiting_for_idle = false;
+#endif //]
+		GALLEN_DBGLOCAL_ESC();
+		return;
 	}
+	
+	
+	GALLEN_DBGLOCAL_PRINTMSG("---fw data = %p,fw size = %ul ---\n",fw->data,fw->size);
 
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-	GALLEN_DBGLOCAL_END();
-}
+	fw_data = fw->data;
+	fw_size = fw->size;
+#ifdef FW_IN_RAM
+	/* Bootloader memory stays around, no need to copy it for the cache */
+	fw_kept = fw->data == (u8 *)gpbWF_vaddr;
+#endif
+#ifdef CONFIG_FB_MXC_EINK_WAVEFORM_GZIP
+	if (fw_size > 2 && fw_data[0] == 0x1f && fw_data[1] == 0x8b) {
+		u8 *inflated;
 
-static int mxc_epdc_fb_blank(int blank, struct fb_info *info)
-{
-	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
-	int ret;
+		if (epdc_wv_gunzip(fb_data, fw_data, fw_size, &inflated,
+				   &fw_size)) {
+			GALLEN_DBGLOCAL_ESC();
+			return;
+		}
+		fw_data = inflated;
+		fb_data->wv_src_alloc = inflated;
+		fw_kept = true;
+	}
+#endif
 
-	GALLEN_DBGLOCAL_BEGIN();
-	dev_dbg(fb_data->dev, "blank = %d\n", blank);
+	wv_file = (struct mxcfb_waveform_data_file *)fw_data;
 
-	if (fb_data->blank == blank)
+	if(1==gptHWCFG->m_val.bDisplayResolution) {
+		printk("%s(%d):EPD 1024x758 \n",__FILE__,__LINE__);
+		fb_data->cur_mode = &fb_data->pdata->epdc_mode[2];//
+	}
+	else if(3==gptHWCFG->m_val.bDisplayResolution) {
+		printk("%s(%d):EPD 1440x1080 \n",__FILE__,__LINE__);
+		fb_data->cur_mode = &fb_data->pdata->epdc_mode[5];//
+	}
+	else if(2==gptHWCFG->m_val.bDisplayResolution) {
+		printk("%s(%d):EPD 1024x768 \n",__FILE__,__LINE__);
+		fb_data->cur_mode = &fb_data->pdata->epdc_mode[3];//
+	}
+	else
 	{
+		unsigned char *pbWFHdr = (unsigned char *)fw_data;
+		switch (*(pbWFHdr+0x0d)) {// FPL platform detect .
+		case 0x06: // V220 .
+			if(27==gptHWCFG->m_val.bPCB) {
+				printk("%s(%d):V220 for E50610 FPL platform \n",__FILE__,__LINE__);
+				fb_data->cur_mode = &fb_data->pdata->epdc_mode[4];//v220 parameters for E50612 .
+			}
+			else {
+				printk("%s(%d):V220 FPL platform \n",__FILE__,__LINE__);
+				fb_data->cur_mode = &fb_data->pdata->epdc_mode[0];//v220 parameters
+			}
+			break;
+		case 0x03: // V110 .
+		case 0x04: // V110A .
+			printk("%s(%d):V110/V110A FPL platform \n",__FILE__,__LINE__);
+			ASSERT(fb_data->pdata->num_modes>1);
+			fb_data->cur_mode = &fb_data->pdata->epdc_mode[1];//v110 parameters
+			break;
+		default:
+			ERR_MSG("%s(%d):new FPL platform=0x%x ,please modify source to support this \n",__FILE__,__LINE__,*(pbWFHdr+0x0d));
+			break;
+		}
+	}
+
+	/* Get size and allocate temperature range table */
+	fb_data->trt_entries = wv_file->wdh.trc + 1;
+	fb_data->temp_range_bounds = kzalloc(fb_data->trt_entries, GFP_KERNEL);
+
+	for (i = 0; i < fb_data->trt_entries; i++) {
+		GALLEN_DBGLOCAL_RUNLOG(2);
+		dev_dbg(fb_data->dev, "trt entry #%d = 0x%x\n", i, *((u8 *)&wv_file->data + i));
+	}
+
+	/* Copy TRT data */
+	memcpy(fb_data->temp_range_bounds, &wv_file->data, fb_data->trt_entries);
+
+	/* Set default temperature index using TRT and room temp */
+	fb_data->temp_index = mxc_epdc_fb_get_temp_index(fb_data, DEFAULT_TEMP);
+
+	/* Get offset and size for waveform data */
+	wv_data_offs = sizeof(wv_file->wdh) + fb_data->trt_entries + 1;
+	fb_data->wv_src = fw_data + wv_data_offs;
+	fb_data->wv_src_size = fw_size - wv_data_offs;
+	fb_data->wv_mode_cnt = wv_file->wdh.mc + 1;
+
+	/* Only copy the waveforms for the current temperature range */
+	if (fb_data->wv_cache && !fw_kept) {
+		fb_data->wv_src_alloc = vmalloc(fb_data->wv_src_size);
+		if (fb_data->wv_src_alloc) {
+			memcpy(fb_data->wv_src_alloc, fb_data->wv_src,
+				fb_data->wv_src_size);
+			fb_data->wv_src = fb_data->wv_src_alloc;
+		}
+	}
+	if (fb_data->wv_cache && (fw_kept || fb_data->wv_src_alloc) &&
+		!epdc_wv_parse(fb_data) &&
+		!epdc_wv_build(fb_data, 1U << fb_data->temp_index,
+			&fb_data->waveform_buffer_virt,
+			&fb_data->waveform_buffer_phys,
+			&fb_data->waveform_buffer_size)) {
+		fb_data->wv_resident = 1U << fb_data->temp_index;
+		goto wv_loaded;
+	}
+
+	kfree(fb_data->wv_bounds);
+	fb_data->wv_bounds = NULL;
+	fb_data->waveform_buffer_size = fb_data->wv_src_size;
+
+	/* Allocate memory for waveform data */
+	fb_data->waveform_buffer_virt = dma_alloc_coherent(fb_data->dev,
+						fb_data->waveform_buffer_size,
+						&fb_data->waveform_buffer_phys,
+						GFP_KERNEL);
+	if (fb_data->waveform_buffer_virt == NULL) {
+		dev_err(fb_data->dev, "Can't allocate mem for waveform!\n");
 		GALLEN_DBGLOCAL_ESC();
-		return 0;
+		return;
 	}
 
-	//fb_data->blank = blank;
+	memcpy(fb_data->waveform_buffer_virt, fb_data->wv_src,
+		fb_data->waveform_buffer_size);
 
-	switch (blank) {
-	case FB_BLANK_POWERDOWN:GALLEN_DBGLOCAL_RUNLOG(0);
-		mxc_epdc_fb_flush_updates(fb_data);
-		/* Wait for powerdown */
-		mutex_lock(&fb_data->power_mutex);
-		if ((fb_data->power_state == POWER_STATE_ON) &&
-			(fb_data->pwrdown_delay == FB_POWERDOWN_DISABLE)) {
+	/* Everything is resident, the source is no longer needed */
+	vfree(fb_data->wv_src_alloc);
+	fb_data->wv_src_alloc = NULL;
+	fb_data->wv_src = NULL;
 
-			/* Powerdown disabled, so we disable EPDC manually */
-			int count = 0;
-			int sleep_ms = 10;
+wv_loaded:
+	DBG_MSG("[%s]waveform:vir_p=%p,phy_p=%p,sz=%d,trt_entries=%d\n",__FUNCTION__,\
+		fb_data->waveform_buffer_virt,fb_data->waveform_buffer_phys,\
+		fb_data->waveform_buffer_size,fb_data->trt_entries);
 
-			mutex_unlock(&fb_data->power_mutex);
+#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
+	if (fw->data != (u8 *)gpbWF_vaddr)
+		release_firmware(fw);
+#else//][!FW_IN_RAM
 
-			/* If any active updates, wait for them to complete */
-			while (fb_data->updates_active) {
-				/* Timeout after 1 sec */
-				if ((count * sleep_ms) > 1000)
-					break;
-				msleep(sleep_ms);
-				count++;
-			}
+	release_firmware(fw);
+#endif //]FW_IN_RAM
 
-			fb_data->powering_down = true;
-			epdc_powerdown(fb_data);
-		} else if (fb_data->power_state != POWER_STATE_OFF) {
-//		if (fb_data->power_state != POWER_STATE_OFF) {
-			GALLEN_DBGLOCAL_RUNLOG(1);
-			fb_data->wait_for_powerdown = true;
-			init_completion(&fb_data->powerdown_compl);
-			mutex_unlock(&fb_data->power_mutex);
-			ret = wait_for_completion_timeout(&fb_data->powerdown_compl,
-				msecs_to_jiffies(5000));
-			if (!ret) {
-				dev_err(fb_data->dev,
-					"No powerdown received!\n");
-				GALLEN_DBGLOCAL_ESC();
-				return -ETIMEDOUT;
-			}
-		} else
-			mutex_unlock(&fb_data->power_mutex);
-		break;
-	case FB_BLANK_VSYNC_SUSPEND:GALLEN_DBGLOCAL_RUNLOG(1);
-	case FB_BLANK_HSYNC_SUSPEND:GALLEN_DBGLOCAL_RUNLOG(2);
-	case FB_BLANK_NORMAL:GALLEN_DBGLOCAL_RUNLOG(3);
-		mxc_epdc_fb_flush_updates(fb_data);
-		break;
+	/* Enable clocks to access EPDC regs */
+	clk_enable(fb_data->epdc_clk_axi);
+
+	/* Enable pix clk for EPDC */
+	clk_enable(fb_data->epdc_clk_pix);
+	clk_set_rate(fb_data->epdc_clk_pix, fb_data->cur_mode->vmode->pixclock);
+
+	epdc_init_sequence(fb_data);
+
+	/* Disable clocks */
+	clk_disable(fb_data->epdc_clk_axi);
+	clk_disable(fb_data->epdc_clk_pix);
+
+	fb_data->hw_ready = true;
+
+	/* Use unrotated (native) width/height */
+	if ((screeninfo->rotate == FB_ROTATE_CW) ||
+		(screeninfo->rotate == FB_ROTATE_CCW)) {
+		GALLEN_DBGLOCAL_RUNLOG(3);
+		xres = screeninfo->yres;
+		yres = screeninfo->xres;
+	} else {
+		GALLEN_DBGLOCAL_RUNLOG(4);
+		xres = screeninfo->xres;
+		yres = screeninfo->yres;
 	}
-	
+
+#if 0 // gallen remove 20110704
+	update.update_region.left = 0;
+	update.update_region.width = xres;
+	update.update_region.top = 0;
+	update.update_region.height = yres;
+	update.update_mode = UPDATE_MODE_FULL;
+	update.waveform_mode = WAVEFORM_MODE_AUTO;
+	update.update_marker = INIT_UPDATE_MARKER;
+	update.temp = TEMP_USE_AMBIENT;
+	update.flags = 0;
+
+	mxc_epdc_fb_send_update(&update, &fb_data->info);
+
+	/* Block on initial update */
+	ret = mxc_epdc_fb_wait_update_complete(update.update_marker,
+		&fb_data->info);
+	if (ret < 0) {
+		GALLEN_DBGLOCAL_RUNLOG(5);
+		dev_err(fb_data->dev,
+			"Wait for update complete failed.  Error = 0x%x", ret);
+	}
+#endif
+	//k_fake_s1d13522_init((unsigned char *)gpbLOGO_vaddr); //orig
+
+	//angela 20121011 add : detect power low and select different logo image
+	printk ("%s ******** mxc_epdc_fb ntx_get_battery_vol: %d\n",__FILE__,ntx_get_battery_vol());
+	//printk ("%s ******** mxc_epdc_fb gpbLOGO_POWERLOW_vaddr: %u\n",__FILE__,gpbLOGO_POWERLOW_vaddr);
+	//printk ("%s ******** mxc_epdc_fb gpbLOGO_vaddr: %u\n",__FILE__,gpbLOGO_vaddr);
+	if (ntx_get_battery_vol() < POWER_LOW_LIMIT)
+		k_fake_s1d13522_init((unsigned char *)gpbLOGO_POWERLOW_vaddr);
+	else
+		k_fake_s1d13522_init((unsigned char *)gpbLOGO_vaddr);
+	dev_info(fb_data->dev, "boot logo submitted\n");
 	GALLEN_DBGLOCAL_END();
-	return 0;
 }
 
-static int mxc_epdc_fb_pan_display(struct fb_var_screeninfo *var,
-				   struct fb_info *info)
+static int mxc_epdc_fb_init_hw(struct fb_info *info)
 {
 	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
-	u_int y_bottom;
-	unsigned long flags;
+	int ret;
 	
 	GALLEN_DBGLOCAL_BEGIN();
 
-	dev_dbg(info->device, "%s: var->yoffset %d, info->var.yoffset %d\n",
-		 __func__, var->yoffset, info->var.yoffset);
-	/* check if var is valid; also, xpan is not supported */
-	if (!var || (var->xoffset != info->var.xoffset) ||
-	    (var->yoffset + var->yres > var->yres_virtual)) {
-		dev_dbg(info->device, "x panning not supported\n");
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
+	/*
+	 * Create fw search string based on ID string in selected videomode.
+	 * Format is "imx/epdc_[panel string].fw"
+	 */
+	if (fb_data->cur_mode) {
+		GALLEN_DBGLOCAL_RUNLOG(0);
+		strcat(fb_data->fw_str, "imx/epdc_");
+		strcat(fb_data->fw_str, fb_data->cur_mode->vmode->name);
+		strcat(fb_data->fw_str, ".fw");
 	}
 
-	if ((fb_data->epdc_fb_var.xoffset == var->xoffset) &&
-		(fb_data->epdc_fb_var.yoffset == var->yoffset)) {
-		GALLEN_DBGLOCAL_ESC();
-		return 0;	/* No change, do nothing */
-	}
+	fb_data->fw_default_load = false;
 
-	y_bottom = var->yoffset;
+#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
+	#if 1
+		queue_work(fb_data->epdc_submit_workqueue,
+			&fb_data->epdc_firmware_work);
+		ret = 0;
+	#else
+	{
 
-	if (!(var->vmode & FB_VMODE_YWRAP))
-		y_bottom += var->yres;
+		struct firmware fw;
 
-	if (y_bottom > info->var.yres_virtual) {
-		GALLEN_DBGLOCAL_ESC();
-		return -EINVAL;
+		fw.size = gdwWF_size;
+		fw.data = gpbWF_vaddr;
+		//fw.page = 0;
+		printk("[%s]:fw p=%p,size=%u\n",__FUNCTION__,fw.data,fw.size);
+		mxc_epdc_fb_fw_handler(&fw,fb_data);
+		ret = 0;
 	}
+	#endif
+#else	//][ befrom modify ...
+	ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+				fb_data->fw_str, fb_data->dev, GFP_KERNEL,
+				fb_data, mxc_epdc_fb_fw_handler);
+	if (ret)
+	{
+		GALLEN_DBGLOCAL_RUNLOG(1);
+		dev_dbg(fb_data->dev,
+			"Failed request_firmware_nowait err %d\n", ret);
+	}
+#endif //]
 
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
-
-	fb_data->fb_offset = (var->yoffset * var->xres_virtual + var->xoffset)
-		* (var->bits_per_pixel) / 8;
+	GALLEN_DBGLOCAL_END();
+	return ret;
+}
 
-	fb_data->epdc_fb_var.xoffset = var->xoffset;
-	fb_data->epdc_fb_var.yoffset = var->yoffset;
+static ssize_t store_update(struct device *device,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct mxcfb_update_data update;
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	if (var->vmode & FB_VMODE_YWRAP) {
+	GALLEN_DBGLOCAL_BEGIN();
+	if (strncmp(buf, "direct", 6) == 0) {
 		GALLEN_DBGLOCAL_RUNLOG(0);
-		info->var.vmode |= FB_VMODE_YWRAP;
+		update.waveform_mode = fb_data->wv_modes.mode_du;
 	}
-	else {
+	else if (strncmp(buf, "gc16", 4) == 0) {
 		GALLEN_DBGLOCAL_RUNLOG(1);
-		info->var.vmode &= ~FB_VMODE_YWRAP;
+		update.waveform_mode = fb_data->wv_modes.mode_gc16;
+	}
+	else if (strncmp(buf, "gc4", 3) == 0) {
+		GALLEN_DBGLOCAL_RUNLOG(2);
+		update.waveform_mode = fb_data->wv_modes.mode_gc4;
 	}
 
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	/* Now, request full screen update */
+	update.update_region.left = 0;
+	update.update_region.width = fb_data->epdc_fb_var.xres;
+	update.update_region.top = 0;
+	update.update_region.height = fb_data->epdc_fb_var.yres;
+	update.update_mode = UPDATE_MODE_FULL;
+	update.temp = TEMP_USE_AMBIENT;
+	update.update_marker = 0;
+	update.flags = 0;
+
+	mxc_epdc_fb_send_update(&update, info);
 
 	GALLEN_DBGLOCAL_END();
-	return 0;
+	return count;
 }
 
-static struct fb_ops mxc_epdc_fb_ops = {
-	.owner = THIS_MODULE,
-	.fb_check_var = mxc_epdc_fb_check_var,
-	.fb_set_par = mxc_epdc_fb_set_par,
-	.fb_setcolreg = mxc_epdc_fb_setcolreg,
-	.fb_pan_display = mxc_epdc_fb_pan_display,
-	.fb_ioctl = mxc_epdc_fb_ioctl,
-	.fb_mmap = mxc_epdc_fb_mmap,
-	.fb_blank = mxc_epdc_fb_blank,
-	.fb_fillrect = cfb_fillrect,
-	.fb_copyarea = cfb_copyarea,
-	.fb_imageblit = cfb_imageblit,
-};
-
-static struct fb_deferred_io mxc_epdc_fb_defio = {
-	.delay = HZ,
-	.deferred_io = mxc_epdc_fb_deferred_io,
-};
-
-static void epdc_done_work_func(struct work_struct *work)
+static ssize_t show_zero_copy(struct device *device,
+			       struct device_attribute *attr, char *buf)
 {
-	struct mxc_epdc_fb_data *fb_data =
-		container_of(work, struct mxc_epdc_fb_data,
-			epdc_done_work.work);
-	epdc_powerdown(fb_data);
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+
+	return sprintf(buf, "%d\n", fb_data->zero_copy ? 1 : 0);
 }
 
-static bool is_free_list_full(struct mxc_epdc_fb_data *fb_data)
+static ssize_t store_zero_copy(struct device *device,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
 {
-	int count = 0;
-	struct update_data_list *plist;
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	/* Count buffers in free buffer list */
-	list_for_each_entry(plist, &fb_data->upd_buf_free_list, list)
-		count++;
+	fb_data->zero_copy = simple_strtoul(buf, NULL, 0) ? true : false;
 
-	/* Check to see if all buffers are in this list */
-	if (count == EPDC_MAX_NUM_UPDATES)
-		return true;
-	else
-		return false;
+	return count;
 }
 
-static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
+static ssize_t show_copy_stats(struct device *device,
+			       struct device_attribute *attr, char *buf)
 {
-	struct mxc_epdc_fb_data *fb_data = dev_id;
-	struct update_data_list *collision_update;
-	struct mxcfb_rect *next_upd_region;
-	struct update_marker_data *next_marker;
-	struct update_marker_data *temp;
-	unsigned long flags;
-	int temp_index;
-	u32 temp_mask;
-	u32 lut;
-	bool ignore_collision = false;
-	int i;
-	bool wb_lut_done = false;
-	bool free_update = true;
-	int next_lut;
-	u32 epdc_irq_stat, epdc_luts_active, epdc_wb_busy, epdc_luts_avail;
-	u32 epdc_collision, epdc_colliding_luts, epdc_next_lut_15;
-
-	/*
-	 * If we just completed one-time panel init, bypass
-	 * queue handling, clear interrupt and return
-	 */
-	if (fb_data->in_init) {
-		if (epdc_is_working_buffer_complete()) {
-			epdc_working_buf_intr(false);
-			epdc_clear_working_buf_irq();
-			dev_dbg(fb_data->dev, "Cleared WB for init update\n");
-		}
-
-		if (epdc_is_lut_complete(0)) {
-			epdc_lut_complete_intr(0, false);
-			epdc_clear_lut_complete_irq(0);
-			fb_data->in_init = false;
-			dev_dbg(fb_data->dev, "Cleared LUT complete for init update\n");
-		}
-
-		return IRQ_HANDLED;
-	}
-
-	if (!(__raw_readl(EPDC_IRQ_MASK) & __raw_readl(EPDC_IRQ)))
-		return IRQ_HANDLED;
-
-	if (__raw_readl(EPDC_IRQ) & EPDC_IRQ_TCE_UNDERRUN_IRQ) {
-		dev_err(fb_data->dev,
-			"TCE underrun! Will continue to update panel\n");
-		/* Clear TCE underrun IRQ */
-		__raw_writel(EPDC_IRQ_TCE_UNDERRUN_IRQ, EPDC_IRQ_CLEAR);
-	}
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	/* Check if we are waiting on EOF to sync a new update submission */
-	if (epdc_signal_eof()) {
-		epdc_eof_intr(false);
-		epdc_clear_eof_irq();
-		complete(&fb_data->eof_event);
-	}
+	return sprintf(buf, "copied: %u\nzero_copy: %u\ncopy_bytes: %llu\n"
+		"copy_dma: %u\n",
+		fb_data->copy_cnt, fb_data->zero_copy_cnt,
+		(unsigned long long)fb_data->copy_bytes,
+		fb_data->copy_dma_cnt);
+}
 
-	/* Capture EPDC status one time up front to prevent race conditions */
-	epdc_irq_stat = __raw_readl(EPDC_IRQ);
-	epdc_luts_active = epdc_any_luts_active();
-	epdc_wb_busy = epdc_is_working_buffer_busy();
-	epdc_luts_avail = epdc_any_luts_available();
-	epdc_collision = epdc_is_collision();
-	epdc_colliding_luts = epdc_get_colliding_luts();
-	epdc_next_lut_15 = epdc_choose_next_lut(&next_lut);
+static ssize_t show_copy_dma_threshold(struct device *device,
+			       struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	/* Protect access to buffer queues and to update HW */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	return sprintf(buf, "%u\n", fb_data->copy_dma_threshold);
+}
 
-	/* Free any LUTs that have completed */
-	for (i = 0; i < EPDC_NUM_LUTS; i++) {
-		if (!(epdc_irq_stat & (1 << i)))
-			continue;
+static ssize_t store_copy_dma_threshold(struct device *device,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		dev_dbg(fb_data->dev, "\nLUT %d completed\n", i);
+	fb_data->copy_dma_threshold = simple_strtoul(buf, NULL, 0);
 
-		/* Disable IRQ for completed LUT */
-		epdc_lut_complete_intr(i, false);
+	return count;
+}
 
-		/*
-		 * Go through all updates in the collision list and
-		 * unmask any updates that were colliding with
-		 * the completed LUT.
-		 */
-		list_for_each_entry(collision_update,
-				    &fb_data->upd_buf_collision_list, list) {
-			collision_update->collision_mask =
-			    collision_update->collision_mask & ~(1 << i);
-		}
+static ssize_t show_flush_stats(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		epdc_clear_lut_complete_irq(i);
+	return sprintf(buf, "flushes: %u\nlast_bytes: %u\nbytes: %llu\n"
+		"wb_overlap: %u\n",
+		fb_data->flush_cnt, fb_data->last_flush_bytes,
+		(unsigned long long)fb_data->flush_bytes,
+		fb_data->wb_overlap_cnt);
+}
 
-		fb_data->luts_complete_wb |= 1 << i;
+static ssize_t show_defio_hash(struct device *device,
+			       struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		fb_data->lut_update_order[i] = 0;
+	return sprintf(buf, "%d\n", fb_data->defio_hash ? 1 : 0);
+}
 
-		/* Signal completion if submit workqueue needs a LUT */
-		if (fb_data->waiting_for_lut) {
-			complete(&fb_data->update_res_free);
-			fb_data->waiting_for_lut = false;
-		}
+static ssize_t store_defio_hash(struct device *device,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	bool enable = simple_strtoul(buf, NULL, 0) ? true : false;
 
-		/* Signal completion if LUT15 free and is needed */
-		if (fb_data->waiting_for_lut15 && (i == 15)) {
-			complete(&fb_data->lut15_free);
-			fb_data->waiting_for_lut15 = false;
-		}
+	/* Hashes go stale while disabled, forget them */
+	if (enable && !fb_data->defio_hash)
+		memset(fb_data->defio_page_hash, 0,
+			DIV_ROUND_UP(fb_data->map_size, PAGE_SIZE) *
+			sizeof(u32));
+	fb_data->defio_hash = enable;
 
-		/* Detect race condition where WB and its LUT complete
-		   (i.e. full update completes) in one swoop */
-		if (fb_data->cur_update &&
-			(i == fb_data->cur_update->lut_num))
-			wb_lut_done = true;
+	return count;
+}
 
-		/* Signal completion if anyone waiting on this LUT */
-		if (!wb_lut_done)
-			list_for_each_entry_safe(next_marker, temp,
-				&fb_data->full_marker_list,
-				full_list) {
-				if (next_marker->lut_num != i)
-					continue;
+static ssize_t show_defio_stats(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-				/* Found marker to signal - remove from list */
-				list_del_init(&next_marker->full_list);
+	return sprintf(buf, "pages: %u\nunchanged: %u\nupdates: %u\n",
+		fb_data->defio_pages, fb_data->defio_pages_skipped,
+		fb_data->defio_rects);
+}
 
-				/* Signal completion of update */
-				dev_dbg(fb_data->dev, "Signaling marker %d\n",
-					next_marker->update_marker);
-				if (next_marker->waiting)
-					complete(&next_marker->update_completion);
-				else
-					kfree(next_marker);
-			}
-	}
+static ssize_t show_upd_buf_min(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	/* Check to see if all updates have completed */
-	if (list_empty(&fb_data->upd_pending_list) &&
-		is_free_list_full(fb_data) &&
-		(fb_data->cur_update == NULL) &&
-		!epdc_luts_active) {
+	return sprintf(buf, "%d\n", fb_data->upd_buf_min);
+}
 
-        fb_data->updates_active = false;
+static ssize_t store_upd_buf_min(struct device *device,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int val = simple_strtoul(buf, NULL, 0);
 
-		if (fb_data->pwrdown_delay != FB_POWERDOWN_DISABLE) {
-			/*
-			 * Set variable to prevent overlapping
-			 * enable/disable requests
-			 */
-			fb_data->powering_down = true;
+	if (val < 1 || val > fb_data->upd_buf_max)
+		return -EINVAL;
 
-			/* Schedule task to disable EPDC HW until next update */
-			schedule_delayed_work(&fb_data->epdc_done_work,
-				msecs_to_jiffies(fb_data->pwrdown_delay));
+	fb_data->upd_buf_min = val;
 
-			/* Reset counter to reduce chance of overflow */
-			fb_data->order_cnt = 0;
-		}
+	/* Bring the pool up to the new minimum right away */
+	while (fb_data->upd_buf_count < fb_data->upd_buf_min)
+		if (!epdc_grow_upd_buffers(fb_data))
+			return -ENOMEM;
 
-		if (fb_data->waiting_for_idle)
-			complete(&fb_data->updates_done);
-	}
+	schedule_delayed_work(&fb_data->upd_buf_shrink_work, 0);
 
-	/* Is Working Buffer busy? */
-	if (epdc_wb_busy) {
-		/* Can't submit another update until WB is done */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		return IRQ_HANDLED;
-	}
+	return count;
+}
 
-	/*
-	 * Were we waiting on working buffer?
-	 * If so, update queues and check for collisions
-	 */
-	if (fb_data->cur_update != NULL) {
-		dev_dbg(fb_data->dev, "\nWorking buffer completed\n");
+static ssize_t show_upd_buf_max(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		/* Signal completion if submit workqueue was waiting on WB */
-		if (fb_data->waiting_for_wb) {
-			complete(&fb_data->update_res_free);
-			fb_data->waiting_for_lut = false;
-		}
+	return sprintf(buf, "%d\n", fb_data->upd_buf_max);
+}
 
-		/* Was there a collision? */
-		if (epdc_is_collision()) {
-			/* Check list of colliding LUTs, and add to our collision mask */
-			fb_data->cur_update->collision_mask =
-			    epdc_get_colliding_luts();
+static ssize_t store_upd_buf_max(struct device *device,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int val = simple_strtoul(buf, NULL, 0);
 
-			/* Clear collisions that completed since WB began */
-			fb_data->cur_update->collision_mask &=
-				~fb_data->luts_complete_wb;
+	if (val < fb_data->upd_buf_min || val > EPDC_MAX_NUM_UPDATES)
+		return -EINVAL;
 
-			dev_dbg(fb_data->dev, "Collision mask = 0x%x\n",
-			       epdc_get_colliding_luts());
+	fb_data->upd_buf_max = val;
+	schedule_delayed_work(&fb_data->upd_buf_shrink_work, 0);
 
-			/*
-			 * If we collide with newer updates, then
-			 * we don't need to re-submit the update. The
-			 * idea is that the newer updates should take
-			 * precedence anyways, so we don't want to
-			 * overwrite them.
-			 */
-			for (temp_mask = fb_data->cur_update->collision_mask, lut = 0;
-				temp_mask != 0;
-				lut++, temp_mask = temp_mask >> 1) {
-				if (!(temp_mask & 0x1))
-					continue;
+	return count;
+}
 
-				if (fb_data->lut_update_order[lut] >=
-					fb_data->cur_update->update_desc->update_order) {
-					dev_dbg(fb_data->dev,
-						"Ignoring collision with"
-						"newer update.\n");
-					ignore_collision = true;
-					break;
-				}
-			}
+static ssize_t show_upd_buf_stats(struct device *device,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-			if (!ignore_collision) {
-				free_update = false;
-				/*
-				 * If update has markers, clear the LUTs to
-				 * avoid signalling that they have completed.
-				 */
-				list_for_each_entry_safe(next_marker, temp,
-					&fb_data->cur_update->update_desc->upd_marker_list,
-					upd_list)
-					next_marker->lut_num = INVALID_LUT;
+	return sprintf(buf, "buffers: %d\npeak: %d\nstalls: %u\n"
+		"snapshot_rejects: %u\ngrown: %u\nshrunk: %u\n"
+		"alloc_failures: %u\n",
+		fb_data->upd_buf_count, fb_data->upd_buf_peak,
+		fb_data->upd_buf_stalls, fb_data->upd_buf_rejects,
+		fb_data->upd_buf_grown, fb_data->upd_buf_shrunk,
+		fb_data->upd_buf_alloc_failures);
+}
 
-				/* Move to collision list */
-				list_add_tail(&fb_data->cur_update->list,
-					 &fb_data->upd_buf_collision_list);
-			}
-		}
+static ssize_t show_sched_reorder(struct device *device,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		if (free_update) {
-			/* Handle condition where WB & LUT are both complete */
-			if (wb_lut_done)
-				list_for_each_entry_safe(next_marker, temp,
-					&fb_data->cur_update->update_desc->upd_marker_list,
-					upd_list) {
+	return sprintf(buf, "%d\nreordered: %u\n",
+		fb_data->sched_reorder ? 1 : 0, fb_data->sched_reordered);
+}
 
-					/* Del from per-update & full list */
-					list_del_init(&next_marker->upd_list);
-					list_del_init(&next_marker->full_list);
+static ssize_t store_sched_reorder(struct device *device,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-					/* Signal completion of update */
-					dev_dbg(fb_data->dev,
-						"Signaling marker %d\n",
-						next_marker->update_marker);
-					if (next_marker->waiting)
-						complete(&next_marker->update_completion);
-					else
-						kfree(next_marker);
-				}
+	fb_data->sched_reorder = simple_strtoul(buf, NULL, 0) ? true : false;
 
-			/* Free marker list and update descriptor */
-			kfree(fb_data->cur_update->update_desc);
+	return count;
+}
 
-			/* Add to free buffer list */
-			list_add_tail(&fb_data->cur_update->list,
-				 &fb_data->upd_buf_free_list);
-		}
+static ssize_t show_pwrdown_delay(struct device *device,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		/* Clear current update */
-		fb_data->cur_update = NULL;
+	return sprintf(buf, "%d\n", fb_data->pwrdown_delay);
+}
 
-		/* Clear IRQ for working buffer */
-		epdc_working_buf_intr(false);
-		epdc_clear_working_buf_irq();
-	}
+static ssize_t store_pwrdown_delay(struct device *device,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
 
-	if (fb_data->upd_scheme != UPDATE_SCHEME_SNAPSHOT) {
-		/* Queued update scheme processing */
+	mxc_epdc_fb_set_pwrdown_delay(simple_strtol(buf, NULL, 0), info);
 
-		/* Schedule task to submit collision and pending update */
-		if (!fb_data->powering_down)
-			queue_work(fb_data->epdc_submit_workqueue,
-				&fb_data->epdc_submit_work);
+	return count;
+}
 
-		/* Release buffer queues */
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+static ssize_t show_pwrdown_breakeven(struct device *device,
+				      struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		return IRQ_HANDLED;
-	}
+	return sprintf(buf, "%d\n", fb_data->pwr_breakeven_ms);
+}
 
-	/* Snapshot update scheme processing */
+static ssize_t store_pwrdown_breakeven(struct device *device,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	long val = simple_strtol(buf, NULL, 0);
 
-	/* Check to see if any LUTs are free */
-	if (!epdc_luts_avail) {
-		dev_dbg(fb_data->dev, "No luts available.\n");
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		return IRQ_HANDLED;
-	}
+	if (val < 0)
+		return -EINVAL;
 
-	/* Check to see if there is a valid LUT to use */
-	if (epdc_next_lut_15 && fb_data->tce_prevent) {
-		dev_dbg(fb_data->dev, "Must wait for LUT15\n");
-		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-		return IRQ_HANDLED;
-	}
+	mutex_lock(&fb_data->power_mutex);
+	fb_data->pwr_breakeven_ms = val;
+	epdc_pwr_learn_delay(fb_data);
+	mutex_unlock(&fb_data->power_mutex);
+
+	return count;
+}
 
-	/*
-	 * Are any of our collision updates able to go now?
-	 * Go through all updates in the collision list and check to see
-	 * if the collision mask has been fully cleared
-	 */
-	list_for_each_entry(collision_update,
-			    &fb_data->upd_buf_collision_list, list) {
+static ssize_t show_pwrdown_stats(struct device *device,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	ssize_t len;
+	int k;
+
+	len = sprintf(buf, "delay_ms: %d\ncold_starts: %u\nwarm_starts: %u\n"
+		"powerup_us: %llu\nramp_wait_us: %llu\nidle_on_ms: %llu\n"
+		"gap_hist:",
+		epdc_pwrdown_delay_ms(fb_data),
+		fb_data->pwr_cold_starts, fb_data->pwr_warm_starts,
+		(unsigned long long)fb_data->pwr_powerup_us,
+		(unsigned long long)fb_data->pwr_ramp_wait_us,
+		(unsigned long long)fb_data->pwr_idle_on_ms);
+	for (k = 0; k < EPDC_PWR_BUCKETS; k++)
+		len += sprintf(buf + len, " %u", fb_data->pwr_gap_hist[k]);
+	len += sprintf(buf + len, "\n");
+
+	return len;
+}
 
-		if (collision_update->collision_mask != 0)
-			continue;
+static ssize_t show_waveform_cache(struct device *device,
+				   struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-		dev_dbg(fb_data->dev, "A collision update is ready to go!\n");
-		/*
-		 * We have a collision cleared, so select it
-		 * and we will retry the update
-		 */
-		fb_data->cur_update = collision_update;
-		list_del_init(&fb_data->cur_update->list);
-		break;
-	}
+	return sprintf(buf, "resident: 0x%x\nloads: %u\nsize: %u\n"
+		"full_size: %u\n", fb_data->wv_resident, fb_data->wv_loads,
+		fb_data->waveform_buffer_size, fb_data->wv_src_size);
+}
 
-	/*
-	 * If we didn't find a collision update ready to go,
-	 * we try to grab one from the update queue
-	 */
-	if (fb_data->cur_update == NULL) {
-		/* Is update list empty? */
-		if (list_empty(&fb_data->upd_buf_queue)) {
-			dev_dbg(fb_data->dev, "No pending updates.\n");
+static ssize_t show_pxp_rotate_min(struct device *device,
+				   struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", gdwPxpRotateMinPixels);
+}
 
-			/* No updates pending, so we are done */
-			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-			return IRQ_HANDLED;
-		} else {
-			dev_dbg(fb_data->dev, "Found a pending update!\n");
+static ssize_t store_pxp_rotate_min(struct device *device,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	gdwPxpRotateMinPixels = simple_strtoul(buf, NULL, 0);
+	return count;
+}
 
-			/* Process next item in update list */
-			fb_data->cur_update =
-			    list_entry(fb_data->upd_buf_queue.next,
-				       struct update_data_list, list);
-			list_del_init(&fb_data->cur_update->list);
-		}
-	}
+static ssize_t show_pxp_rotate_stats(struct device *device,
+				     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "pxp: %lu\ncpu: %lu\nfallback: %lu\n"
+		"buf_size: %lu\n", gdwPxpRotateCnt, gdwCpuRotateCnt,
+		gdwPxpRotateFallbackCnt, gdwPxpRotBufSize);
+}
 
-	/* Use LUT selected above */
-	fb_data->cur_update->lut_num = next_lut;
+static ssize_t show_merge_max_growth(struct device *device,
+				     struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	/* Associate LUT with update markers */
-	list_for_each_entry_safe(next_marker, temp,
-		&fb_data->cur_update->update_desc->upd_marker_list, upd_list)
-		next_marker->lut_num = fb_data->cur_update->lut_num;
+	return sprintf(buf, "%d\n", fb_data->merge_max_growth);
+}
 
-	/* Mark LUT as containing new update */
-	fb_data->lut_update_order[fb_data->cur_update->lut_num] =
-		fb_data->cur_update->update_desc->update_order;
+/* Percent of the union the merged box may cover, 0 for no limit */
+static ssize_t store_merge_max_growth(struct device *device,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	unsigned long val = simple_strtoul(buf, NULL, 0);
 
-	/* Enable Collision and WB complete IRQs */
-	epdc_working_buf_intr(true);
-	epdc_lut_complete_intr(fb_data->cur_update->lut_num, true);
+	if (val && val < 100)
+		return -EINVAL;
 
-	/* Program EPDC update to process buffer */
-	next_upd_region =
-		&fb_data->cur_update->update_desc->upd_data.update_region;
-	if (fb_data->cur_update->update_desc->upd_data.temp
-		!= TEMP_USE_AMBIENT) {
-		temp_index = mxc_epdc_fb_get_temp_index(fb_data,
-			fb_data->cur_update->update_desc->upd_data.temp);
-		epdc_set_temp(temp_index);
-	} else
-		epdc_set_temp(fb_data->temp_index);
-	epdc_set_update_addr(fb_data->cur_update->phys_addr +
-				fb_data->cur_update->update_desc->epdc_offs);
-	epdc_set_update_coord(next_upd_region->left, next_upd_region->top);
-	epdc_set_update_dimensions(next_upd_region->width,
-				   next_upd_region->height);
+	fb_data->merge_max_growth = val;
 
-	epdc_submit_update(fb_data->cur_update->lut_num,
-			   fb_data->cur_update->update_desc->upd_data.waveform_mode,
-			   fb_data->cur_update->update_desc->upd_data.update_mode,
-			   false, 0);
+	return count;
+}
 
-	/* Release buffer queues */
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+static ssize_t show_merge_stats(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	return IRQ_HANDLED;
+	return sprintf(buf, "attempts: %u\nmerged: %u\nrej_flags: %u\n"
+		"rej_waveform: %u\nrej_mode: %u\nrej_apart: %u\n"
+		"rej_growth: %u\nadded_pixels: %llu\n",
+		fb_data->merge_attempts, fb_data->merge_accepts,
+		fb_data->merge_rejects[EPDC_MERGE_REJ_FLAGS],
+		fb_data->merge_rejects[EPDC_MERGE_REJ_WAVEFORM],
+		fb_data->merge_rejects[EPDC_MERGE_REJ_MODE],
+		fb_data->merge_rejects[EPDC_MERGE_REJ_APART],
+		fb_data->merge_rejects[EPDC_MERGE_REJ_GROWTH],
+		(unsigned long long)fb_data->merge_added_pixels);
 }
 
-static void draw_mode0(struct mxc_epdc_fb_data *fb_data)
+static ssize_t show_direct_stats(struct device *device,
+				 struct device_attribute *attr, char *buf)
 {
-	u32 *upd_buf_ptr;
-	int i;
-	struct fb_var_screeninfo *screeninfo = &fb_data->epdc_fb_var;
-	u32 xres, yres;
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	u32 cnt = fb_data->direct_cnt;
+
+	return sprintf(buf, "updates: %u\nwaited: %u\nshared_lut: %u\n"
+		"collisions: %u\navg_us: %llu\nmax_us: %u\n",
+		cnt, fb_data->direct_waits, fb_data->direct_shared,
+		fb_data->direct_collisions,
+		cnt ? (unsigned long long)div_u64(fb_data->direct_total_us, cnt)
+			: 0ULL,
+		fb_data->direct_max_us);
+}
 
-	GALLEN_DBGLOCAL_BEGIN();
-	upd_buf_ptr = (u32 *)fb_data->info.screen_base;
+static const char *hist_class_names[MXCFB_HIST_CLASSES] = {
+	"2", "4", "8", "16", "32",
+};
 
-	epdc_working_buf_intr(true);
-	epdc_lut_complete_intr(0, true);
-	fb_data->in_init = true;
+/* One "levels: mode" line per class, "-1" when following wv_modes */
+static ssize_t show_hist_waveform(struct device *device,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int i, len = 0;
 
-	/* Use unrotated (native) width/height */
-	if ((screeninfo->rotate == FB_ROTATE_CW) ||
-		(screeninfo->rotate == FB_ROTATE_CCW)) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		xres = screeninfo->yres;
-		yres = screeninfo->xres;
-	} else {
-		GALLEN_DBGLOCAL_RUNLOG(1);
-		xres = screeninfo->xres;
-		yres = screeninfo->yres;
-	}
+	for (i = 0; i < MXCFB_HIST_CLASSES; i++)
+		len += sprintf(buf + len, "%s: %d (%u)\n",
+			hist_class_names[i], fb_data->hist_wv_policy[i],
+			epdc_hist_waveform(fb_data, i + 1));
 
-	/* Program EPDC update to process buffer */
-	epdc_set_update_addr(fb_data->phys_start);
-	epdc_set_update_coord(0, 0);
-	epdc_set_update_dimensions(xres, yres);
-	epdc_submit_update(0, fb_data->wv_modes.mode_init, UPDATE_MODE_FULL, true, 0xFF);
+	return len;
+}
 
-	dev_dbg(fb_data->dev, "Mode0 update - Waiting for LUT to complete...\n");
+/* Takes up to MXCFB_HIST_CLASSES modes, lowest class first */
+static ssize_t store_hist_waveform(struct device *device,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int mode[MXCFB_HIST_CLASSES];
+	int i, n;
 
-	/* Will timeout after ~4-5 seconds */
+	n = sscanf(buf, "%d %d %d %d %d", &mode[0], &mode[1], &mode[2],
+		   &mode[3], &mode[4]);
+	if (n <= 0)
+		return -EINVAL;
 
-	for (i = 0; i < 40; i++) {
-		if (!epdc_is_lut_active(0)) {
-			dev_dbg(fb_data->dev, "Mode0 init complete\n");
-			GALLEN_DBGLOCAL_ESC();
-			return;
-		}
-		msleep(100);
-	}
+	for (i = 0; i < n; i++)
+		fb_data->hist_wv_policy[i] = mode[i] < 0 ? -1 : mode[i];
 
-	dev_err(fb_data->dev, "Mode0 init failed!\n");
-	GALLEN_DBGLOCAL_END();
-	return;
+	return count;
 }
 
-
-static void mxc_epdc_fb_fw_handler(const struct firmware *fw,
-						     void *context)
+static ssize_t show_temperature(struct device *device,
+				struct device_attribute *attr, char *buf)
 {
-	struct mxc_epdc_fb_data *fb_data = context;
-	int ret;
-	struct mxcfb_waveform_data_file *wv_file;
-	int wv_data_offs;
-	int i;
-	struct mxcfb_update_data update;
-	struct fb_var_screeninfo *screeninfo = &fb_data->epdc_fb_var;
-	u32 xres, yres;
+	unsigned long dwSample = gdwTempSampleJiffies;
 
-	GALLEN_DBGLOCAL_BEGIN();
+	if(!dwSample)
+		return sprintf(buf, "temp: %d\nage_ms: -1\nread_fails: %lu\n",
+			giLastTemprature, gdwTempReadFails);
 
-	if (fw == NULL) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		/* If default FW file load failed, we give up */
-		if (fb_data->fw_default_load) {
-			GALLEN_DBGLOCAL_ESC();
-			return;
-		}
+	return sprintf(buf, "temp: %d\nage_ms: %u\nread_fails: %lu\n",
+		giLastTemprature, jiffies_to_msecs(jiffies - dwSample),
+		gdwTempReadFails);
+}
 
-		/* Try to load default waveform */
-		dev_dbg(fb_data->dev,
-			"Can't find firmware. Trying fallback fw\n");
-		fb_data->fw_default_load = true;
-#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
-		{
-			struct firmware fw;
-			
+static ssize_t show_temp_refresh(struct device *device,
+				 struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", gdwTempRefreshSecs);
+}
 
-			fw.size = gdwWF_size;
-			fw.data = (u8*)gpbWF_vaddr;
-			//fw.page = 0;
-			printk("[%s]:fw p=%p,size=%u\n",__FUNCTION__,fw.data,fw.size);
-			//mxc_epdc_fb_fw_handler(&fw,fb_data);
-			ret = 0;
-		}
-#else //][ befrom modify ...
-		ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
-			"imx/epdc.fw", fb_data->dev, GFP_KERNEL, fb_data,
-			mxc_epdc_fb_fw_handler);
-		if (ret) {
-			GALLEN_DBGLOCAL_RUNLOG(1);
-			dev_err(fb_data->dev,
-				"Failed request_firmware_nowait err %d\n", ret);
-		}
-#endif //]
-		GALLEN_DBGLOCAL_ESC();
-		return;
-	}
-	
-	
-	GALLEN_DBGLOCAL_PRINTMSG("---fw data = %p,fw size = %ul ---\n",fw->data,fw->size);
+/* Seconds between background temperature samples */
+static ssize_t store_temp_refresh(struct device *device,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long val = simple_strtoul(buf, NULL, 0);
 
-	wv_file = (struct mxcfb_waveform_data_file *)fw->data;
+	if (!val)
+		return -EINVAL;
 
-	if(1==gptHWCFG->m_val.bDisplayResolution) {
-		printk("%s(%d):EPD 1024x758 \n",__FILE__,__LINE__);
-		fb_data->cur_mode = &fb_data->pdata->epdc_mode[2];//
-	}
-	else if(3==gptHWCFG->m_val.bDisplayResolution) {
-		printk("%s(%d):EPD 1440x1080 \n",__FILE__,__LINE__);
-		fb_data->cur_mode = &fb_data->pdata->epdc_mode[5];//
-	}
-	else if(2==gptHWCFG->m_val.bDisplayResolution) {
-		printk("%s(%d):EPD 1024x768 \n",__FILE__,__LINE__);
-		fb_data->cur_mode = &fb_data->pdata->epdc_mode[3];//
-	}
-	else
-	{
-		unsigned char *pbWFHdr = (unsigned char *)(fw->data);
-		switch (*(pbWFHdr+0x0d)) {// FPL platform detect .
-		case 0x06: // V220 .
-			if(27==gptHWCFG->m_val.bPCB) {
-				printk("%s(%d):V220 for E50610 FPL platform \n",__FILE__,__LINE__);
-				fb_data->cur_mode = &fb_data->pdata->epdc_mode[4];//v220 parameters for E50612 .
-			}
-			else {
-				printk("%s(%d):V220 FPL platform \n",__FILE__,__LINE__);
-				fb_data->cur_mode = &fb_data->pdata->epdc_mode[0];//v220 parameters
-			}
-			break;
-		case 0x03: // V110 .
-		case 0x04: // V110A .
-			printk("%s(%d):V110/V110A FPL platform \n",__FILE__,__LINE__);
-			ASSERT(fb_data->pdata->num_modes>1);
-			fb_data->cur_mode = &fb_data->pdata->epdc_mode[1];//v110 parameters
-			break;
-		default:
-			ERR_MSG("%s(%d):new FPL platform=0x%x ,please modify source to support this \n",__FILE__,__LINE__,*(pbWFHdr+0x0d));
-			break;
-		}
-	}
+	gdwTempRefreshSecs = val;
 
-	/* Get size and allocate temperature range table */
-	fb_data->trt_entries = wv_file->wdh.trc + 1;
-	fb_data->temp_range_bounds = kzalloc(fb_data->trt_entries, GFP_KERNEL);
+	return count;
+}
 
-	for (i = 0; i < fb_data->trt_entries; i++) {
-		GALLEN_DBGLOCAL_RUNLOG(2);
-		dev_dbg(fb_data->dev, "trt entry #%d = 0x%x\n", i, *((u8 *)&wv_file->data + i));
-	}
+static const char *dither_mode_names[] = {
+	[EPDC_DITHER_ATKINSON] = "atkinson",
+	[EPDC_DITHER_ATKINSON_NEON] = "atkinson_neon",
+	[EPDC_DITHER_ORDERED_NEON] = "ordered_neon",
+};
 
-	/* Copy TRT data */
-	memcpy(fb_data->temp_range_bounds, &wv_file->data, fb_data->trt_entries);
+static int epdc_parse_dither_mode(const char *buf)
+{
+	int i;
 
-	/* Set default temperature index using TRT and room temp */
-	fb_data->temp_index = mxc_epdc_fb_get_temp_index(fb_data, DEFAULT_TEMP);
+	for (i = 0; i < ARRAY_SIZE(dither_mode_names); i++)
+		if (sysfs_streq(buf, dither_mode_names[i]))
+			return i;
 
-	/* Get offset and size for waveform data */
-	wv_data_offs = sizeof(wv_file->wdh) + fb_data->trt_entries + 1;
-	fb_data->waveform_buffer_size = fw->size - wv_data_offs;
+	return -EINVAL;
+}
 
-	/* Allocate memory for waveform data */
-	fb_data->waveform_buffer_virt = dma_alloc_coherent(fb_data->dev,
-						fb_data->waveform_buffer_size,
-						&fb_data->waveform_buffer_phys,
-						GFP_DMA);
-	if (fb_data->waveform_buffer_virt == NULL) {
-		dev_err(fb_data->dev, "Can't allocate mem for waveform!\n");
-		GALLEN_DBGLOCAL_ESC();
-		return;
-	}
-	DBG_MSG("[%s]waveform:vir_p=%p,phy_p=%p,sz=%d,trt_entries=%d\n",__FUNCTION__,\
-		fb_data->waveform_buffer_virt,fb_data->waveform_buffer_phys,\
-		fb_data->waveform_buffer_size,fb_data->trt_entries);
-	
+static ssize_t show_dither_mode(struct device *device,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
 
-	memcpy(fb_data->waveform_buffer_virt, (u8 *)(fw->data) + wv_data_offs,
-		fb_data->waveform_buffer_size);
+	return sprintf(buf, "%s%s\n", dither_mode_names[fb_data->dither_mode],
+		(fb_data->dither_mode != EPDC_DITHER_ATKINSON &&
+		 !epdc_dither_neon_usable()) ? " (no neon, using atkinson)" : "");
+}
 
-#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
-#else//][!FW_IN_RAM
+static ssize_t store_dither_mode(struct device *device,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(device);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int mode = epdc_parse_dither_mode(buf);
 
-	release_firmware(fw);
-#endif //]FW_IN_RAM
+	if (mode < 0)
+		return mode;
 
-	/* Enable clocks to access EPDC regs */
-	clk_enable(fb_data->epdc_clk_axi);
+	fb_data->dither_mode = mode;
 
-	/* Enable pix clk for EPDC */
-	clk_enable(fb_data->epdc_clk_pix);
-	clk_set_rate(fb_data->epdc_clk_pix, fb_data->cur_mode->vmode->pixclock);
+	return count;
+}
 
-	epdc_init_sequence(fb_data);
+static struct device_attribute fb_attrs[] = {
+	__ATTR(update, S_IRUGO|S_IWUSR, NULL, store_update),
+	__ATTR(zero_copy, S_IRUGO|S_IWUSR, show_zero_copy, store_zero_copy),
+	__ATTR(copy_stats, S_IRUGO, show_copy_stats, NULL),
+	__ATTR(copy_dma_threshold, S_IRUGO|S_IWUSR, show_copy_dma_threshold,
+		store_copy_dma_threshold),
+	__ATTR(dither_mode, S_IRUGO|S_IWUSR, show_dither_mode,
+		store_dither_mode),
+	__ATTR(flush_stats, S_IRUGO, show_flush_stats, NULL),
+	__ATTR(defio_hash, S_IRUGO|S_IWUSR, show_defio_hash, store_defio_hash),
+	__ATTR(defio_stats, S_IRUGO, show_defio_stats, NULL),
+	__ATTR(upd_buf_min, S_IRUGO|S_IWUSR, show_upd_buf_min,
+		store_upd_buf_min),
+	__ATTR(upd_buf_max, S_IRUGO|S_IWUSR, show_upd_buf_max,
+		store_upd_buf_max),
+	__ATTR(upd_buf_stats, S_IRUGO, show_upd_buf_stats, NULL),
+	__ATTR(sched_reorder, S_IRUGO|S_IWUSR, show_sched_reorder,
+		store_sched_reorder),
+	__ATTR(pwrdown_delay, S_IRUGO|S_IWUSR, show_pwrdown_delay,
+		store_pwrdown_delay),
+	__ATTR(pwrdown_breakeven_ms, S_IRUGO|S_IWUSR, show_pwrdown_breakeven,
+		store_pwrdown_breakeven),
+	__ATTR(pwrdown_stats, S_IRUGO, show_pwrdown_stats, NULL),
+	__ATTR(waveform_cache, S_IRUGO, show_waveform_cache, NULL),
+	__ATTR(pxp_rotate_min, S_IRUGO|S_IWUSR, show_pxp_rotate_min,
+		store_pxp_rotate_min),
+	__ATTR(pxp_rotate_stats, S_IRUGO, show_pxp_rotate_stats, NULL),
+	__ATTR(hist_waveform, S_IRUGO|S_IWUSR, show_hist_waveform,
+		store_hist_waveform),
+	__ATTR(merge_max_growth, S_IRUGO|S_IWUSR, show_merge_max_growth,
+		store_merge_max_growth),
+	__ATTR(merge_stats, S_IRUGO, show_merge_stats, NULL),
+	__ATTR(direct_stats, S_IRUGO, show_direct_stats, NULL),
+	__ATTR(temperature, S_IRUGO, show_temperature, NULL),
+	__ATTR(temp_refresh, S_IRUGO|S_IWUSR, show_temp_refresh,
+		store_temp_refresh),
+};
 
-	/* Disable clocks */
-	clk_disable(fb_data->epdc_clk_axi);
-	clk_disable(fb_data->epdc_clk_pix);
+#ifdef CONFIG_DEBUG_FS
+static const char *epdc_lat_stage_names[EPDC_LAT_STAGES] = {
+	[EPDC_LAT_QUEUE] = "queue",
+	[EPDC_LAT_PXP] = "pxp",
+	[EPDC_LAT_SUBMIT] = "submit",
+	[EPDC_LAT_PANEL] = "panel",
+	[EPDC_LAT_TOTAL] = "total",
+	[EPDC_LAT_TOUCH_SEND] = "t2send",
+	[EPDC_LAT_TOUCH] = "t2photon",
+};
 
-	fb_data->hw_ready = true;
+static int epdc_latency_show(struct seq_file *s, void *unused)
+{
+	struct mxc_epdc_fb_data *fb_data = s->private;
+	int mode, stage, b;
+	u32 n;
+
+	seq_printf(s, "%-8s %-8s", "waveform", "stage");
+	seq_printf(s, " %6s", "<1ms");
+	for (b = 1; b < EPDC_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " %6d", 1 << (b - 1));
+	seq_printf(s, " %5d+\n", 1 << (EPDC_LAT_BUCKETS - 2));
+
+	for (mode = 0; mode < EPDC_LAT_MODES; mode++) {
+		for (stage = 0; stage < EPDC_LAT_STAGES; stage++) {
+			for (n = 0, b = 0; b < EPDC_LAT_BUCKETS; b++)
+				n += fb_data->lat_hist[mode][stage][b];
+			if (!n)
+				continue;
 
-	/* Use unrotated (native) width/height */
-	if ((screeninfo->rotate == FB_ROTATE_CW) ||
-		(screeninfo->rotate == FB_ROTATE_CCW)) {
-		GALLEN_DBGLOCAL_RUNLOG(3);
-		xres = screeninfo->yres;
-		yres = screeninfo->xres;
-	} else {
-		GALLEN_DBGLOCAL_RUNLOG(4);
-		xres = screeninfo->xres;
-		yres = screeninfo->yres;
+			if (mode == EPDC_LAT_MODES - 1)
+				seq_printf(s, "%-8s", "other");
+			else
+				seq_printf(s, "%-8d", mode);
+			seq_printf(s, " %-8s", epdc_lat_stage_names[stage]);
+			for (b = 0; b < EPDC_LAT_BUCKETS; b++)
+				seq_printf(s, " %6u",
+					fb_data->lat_hist[mode][stage][b]);
+			seq_printf(s, "\n");
+		}
 	}
 
-#if 0 // gallen remove 20110704
-	update.update_region.left = 0;
-	update.update_region.width = xres;
-	update.update_region.top = 0;
-	update.update_region.height = yres;
-	update.update_mode = UPDATE_MODE_FULL;
-	update.waveform_mode = WAVEFORM_MODE_AUTO;
-	update.update_marker = INIT_UPDATE_MARKER;
-	update.temp = TEMP_USE_AMBIENT;
-	update.flags = 0;
+	return 0;
+}
 
-	mxc_epdc_fb_send_update(&update, &fb_data->info);
+static int epdc_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, epdc_latency_show, inode->i_private);
+}
 
-	/* Block on initial update */
-	ret = mxc_epdc_fb_wait_update_complete(update.update_marker,
-		&fb_data->info);
-	if (ret < 0) {
-		GALLEN_DBGLOCAL_RUNLOG(5);
-		dev_err(fb_data->dev,
-			"Wait for update complete failed.  Error = 0x%x", ret);
-	}
-#endif
-	//k_fake_s1d13522_init((unsigned char *)gpbLOGO_vaddr); //orig
+/* Any write clears the histogram */
+static ssize_t epdc_latency_write(struct file *file,
+				  const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mxc_epdc_fb_data *fb_data = s->private;
+	unsigned long flags;
 
-	//angela 20121011 add : detect power low and select different logo image
-	printk ("%s ******** mxc_epdc_fb ntx_get_battery_vol: %d\n",__FILE__,ntx_get_battery_vol());
-	//printk ("%s ******** mxc_epdc_fb gpbLOGO_POWERLOW_vaddr: %u\n",__FILE__,gpbLOGO_POWERLOW_vaddr);
-	//printk ("%s ******** mxc_epdc_fb gpbLOGO_vaddr: %u\n",__FILE__,gpbLOGO_vaddr);
-	if (ntx_get_battery_vol() < POWER_LOW_LIMIT)
-		k_fake_s1d13522_init((unsigned char *)gpbLOGO_POWERLOW_vaddr);
-	else
-		k_fake_s1d13522_init((unsigned char *)gpbLOGO_vaddr);
-	GALLEN_DBGLOCAL_END();
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	memset(fb_data->lat_hist, 0, sizeof(fb_data->lat_hist));
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return count;
 }
 
-static int mxc_epdc_fb_init_hw(struct fb_info *info)
+static const struct file_operations epdc_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= epdc_latency_open,
+	.read		= seq_read,
+	.write		= epdc_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int epdc_workqueue_show(struct seq_file *s, void *unused)
 {
-	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
-	int ret;
-	
-	GALLEN_DBGLOCAL_BEGIN();
+	static const char *names[EPDC_WQ_ITEMS] = {
+		[EPDC_WQ_SUBMIT] = "submit",
+		[EPDC_WQ_DONE] = "powerdown",
+	};
+	struct mxc_epdc_fb_data *fb_data = s->private;
+	struct epdc_wq_stat st;
+	unsigned long flags;
+	int i;
 
-	/*
-	 * Create fw search string based on ID string in selected videomode.
-	 * Format is "imx/epdc_[panel string].fw"
-	 */
-	if (fb_data->cur_mode) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		strcat(fb_data->fw_str, "imx/epdc_");
-		strcat(fb_data->fw_str, fb_data->cur_mode->vmode->name);
-		strcat(fb_data->fw_str, ".fw");
+	seq_printf(s, "%-10s %8s %8s %8s %8s\n",
+		   "work", "runs", "avg_us", "max_us", ">=1ms");
+	for (i = 0; i < EPDC_WQ_ITEMS; i++) {
+		spin_lock_irqsave(&fb_data->wq_stat_lock, flags);
+		st = fb_data->wq_stat[i];
+		spin_unlock_irqrestore(&fb_data->wq_stat_lock, flags);
+
+		seq_printf(s, "%-10s %8u %8llu %8u %8u\n", names[i], st.runs,
+			   st.runs ? div_u64(st.total_us, st.runs) : 0ULL,
+			   st.max_us, st.slow);
 	}
 
-	fb_data->fw_default_load = false;
+	return 0;
+}
 
-#ifdef FW_IN_RAM//[ gallen modify 20110609 : waveform pass from bootloader in RAM .
-	#if 1
-		queue_work(fb_data->epdc_submit_workqueue,
-			&fb_data->epdc_firmware_work);
-		ret = 0;
-	#else
-	{
+static int epdc_workqueue_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, epdc_workqueue_show, inode->i_private);
+}
 
-		struct firmware fw;
+/* Any write clears the counters, pending stamps are kept */
+static ssize_t epdc_workqueue_write(struct file *file,
+				    const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mxc_epdc_fb_data *fb_data = s->private;
+	unsigned long flags;
+	int i;
 
-		fw.size = gdwWF_size;
-		fw.data = gpbWF_vaddr;
-		//fw.page = 0;
-		printk("[%s]:fw p=%p,size=%u\n",__FUNCTION__,fw.data,fw.size);
-		mxc_epdc_fb_fw_handler(&fw,fb_data);
-		ret = 0;
-	}
-	#endif
-#else	//][ befrom modify ...
-	ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
-				fb_data->fw_str, fb_data->dev, GFP_KERNEL,
-				fb_data, mxc_epdc_fb_fw_handler);
-	if (ret)
-	{
-		GALLEN_DBGLOCAL_RUNLOG(1);
-		dev_dbg(fb_data->dev,
-			"Failed request_firmware_nowait err %d\n", ret);
+	spin_lock_irqsave(&fb_data->wq_stat_lock, flags);
+	for (i = 0; i < EPDC_WQ_ITEMS; i++) {
+		fb_data->wq_stat[i].runs = 0;
+		fb_data->wq_stat[i].slow = 0;
+		fb_data->wq_stat[i].max_us = 0;
+		fb_data->wq_stat[i].total_us = 0;
 	}
-#endif //]
+	spin_unlock_irqrestore(&fb_data->wq_stat_lock, flags);
 
-	GALLEN_DBGLOCAL_END();
-	return ret;
+	return count;
 }
 
-static ssize_t store_update(struct device *device,
-			     struct device_attribute *attr,
-			     const char *buf, size_t count)
-{
-	struct mxcfb_update_data update;
-	struct fb_info *info = dev_get_drvdata(device);
-	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+static const struct file_operations epdc_workqueue_fops = {
+	.owner		= THIS_MODULE,
+	.open		= epdc_workqueue_open,
+	.read		= seq_read,
+	.write		= epdc_workqueue_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
-	GALLEN_DBGLOCAL_BEGIN();
-	if (strncmp(buf, "direct", 6) == 0) {
-		GALLEN_DBGLOCAL_RUNLOG(0);
-		update.waveform_mode = fb_data->wv_modes.mode_du;
-	}
-	else if (strncmp(buf, "gc16", 4) == 0) {
-		GALLEN_DBGLOCAL_RUNLOG(1);
-		update.waveform_mode = fb_data->wv_modes.mode_gc16;
-	}
-	else if (strncmp(buf, "gc4", 3) == 0) {
-		GALLEN_DBGLOCAL_RUNLOG(2);
-		update.waveform_mode = fb_data->wv_modes.mode_gc4;
+static void epdc_debugfs_init(struct mxc_epdc_fb_data *fb_data)
+{
+	fb_data->debugfs_dir = debugfs_create_dir("mxc_epdc", NULL);
+	if (IS_ERR_OR_NULL(fb_data->debugfs_dir)) {
+		fb_data->debugfs_dir = NULL;
+		return;
 	}
 
-	/* Now, request full screen update */
-	update.update_region.left = 0;
-	update.update_region.width = fb_data->epdc_fb_var.xres;
-	update.update_region.top = 0;
-	update.update_region.height = fb_data->epdc_fb_var.yres;
-	update.update_mode = UPDATE_MODE_FULL;
-	update.temp = TEMP_USE_AMBIENT;
-	update.update_marker = 0;
-	update.flags = 0;
+	debugfs_create_file("latency", S_IRUGO | S_IWUSR,
+			    fb_data->debugfs_dir, fb_data,
+			    &epdc_latency_fops);
+	debugfs_create_u32("touch_tgid", S_IRUGO | S_IWUSR,
+			   fb_data->debugfs_dir, &fb_data->touch_tgid);
+	debugfs_create_file("workqueue", S_IRUGO | S_IWUSR,
+			    fb_data->debugfs_dir, fb_data,
+			    &epdc_workqueue_fops);
+	debugfs_create_u32("collisions", S_IRUGO,
+			   fb_data->debugfs_dir, &fb_data->upd_collisions);
+}
 
-	mxc_epdc_fb_send_update(&update, info);
+static void epdc_debugfs_exit(struct mxc_epdc_fb_data *fb_data)
+{
+	debugfs_remove_recursive(fb_data->debugfs_dir);
+}
+#else
+static inline void epdc_debugfs_init(struct mxc_epdc_fb_data *fb_data) {}
+static inline void epdc_debugfs_exit(struct mxc_epdc_fb_data *fb_data) {}
+#endif
 
-	GALLEN_DBGLOCAL_END();
-	return count;
+/*
+ * The dithering error lines are touched for every pixel of a dithered
+ * update and only ever by the CPU, so prefer the cacheable IRAM hot pool
+ * when the board set one aside, and fall back to normal memory.
+ */
+static int epdc_dither_buf_alloc(struct mxc_epdc_fb_data *fb_data)
+{
+	fb_data->dither_err_size =
+		max((fb_data->dither_max_width + 3) * 3 * sizeof(int),
+		    DITHER_NEON_ERR_BUF_SIZE(fb_data->dither_max_width));
+
+	fb_data->dither_err_buf = iram_alloc_hot(fb_data->dither_err_size,
+						 &fb_data->dither_err_iram,
+						 "epdc dither");
+	if (fb_data->dither_err_buf) {
+		memset(fb_data->dither_err_buf, 0, fb_data->dither_err_size);
+		return 0;
+	}
+
+	fb_data->dither_err_iram = 0;
+	fb_data->dither_err_buf = kzalloc(fb_data->dither_err_size,
+					  GFP_KERNEL);
+	return fb_data->dither_err_buf ? 0 : -ENOMEM;
 }
 
-static struct device_attribute fb_attrs[] = {
-	__ATTR(update, S_IRUGO|S_IWUSR, NULL, store_update),
-};
+static void epdc_dither_buf_free(struct mxc_epdc_fb_data *fb_data)
+{
+	if (fb_data->dither_err_iram)
+		iram_free(fb_data->dither_err_iram, fb_data->dither_err_size);
+	else
+		kfree(fb_data->dither_err_buf);
+	fb_data->dither_err_buf = NULL;
+	fb_data->dither_err_iram = 0;
+}
 
 int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 {
@@ -4383,10 +7314,10 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	struct pxp_config_data *pxp_conf;
 	struct pxp_proc_data *proc_data;
 	struct scatterlist *sg;
-	struct update_data_list *upd_list;
 	struct update_data_list *plist, *temp_list;
 	int i;
 	unsigned long x_mem_size = 0;
+	int screens = 0;
 #ifdef CONFIG_FRAMEBUFFER_CONSOLE
 	struct mxcfb_update_data update;
 #endif
@@ -4435,6 +7366,9 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	}
 
 	fb_data->tce_prevent = 1;
+	fb_data->sched_reorder = true;
+	fb_data->wv_cache = true;
+	fb_data->wv_resident = ~0U;
 
 	if (options)
 	{
@@ -4456,10 +7390,32 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 				GALLEN_DBGLOCAL_RUNLOG(7);
 				x_mem_size = memparse(opt + 6, NULL);
 			}
+			else if (!strncmp(opt, "screens=", 8))
+			{
+				screens = simple_strtoul(opt + 8, NULL, 0);
+			}
 			else if (!strncmp(opt, "tce_prevent", 11))
 			{
 				fb_data->tce_prevent = 1;
 			}
+			else if (!strncmp(opt, "zero_copy", 9))
+			{
+				fb_data->zero_copy = true;
+			}
+			else if (!strncmp(opt, "defio_hash", 10))
+			{
+				fb_data->defio_hash = true;
+			}
+			else if (!strncmp(opt, "waveform_full", 13))
+			{
+				fb_data->wv_cache = false;
+			}
+			else if (!strncmp(opt, "dither=", 7))
+			{
+				if (epdc_parse_dither_mode(opt + 7) >= 0)
+					fb_data->dither_mode =
+						epdc_parse_dither_mode(opt + 7);
+			}
 			else {
 				GALLEN_DBGLOCAL_RUNLOG(8);
 				panel_str = opt;
@@ -4558,7 +7514,23 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 		fb_data->num_screens = NUM_SCREENS_MIN;
 	}
 
+	/*
+	 * screens=N sets the count directly, down to a single screen for
+	 * devices whose userspace never pans or flips.
+	 */
+	if (screens > 0)
+		fb_data->num_screens = min_t(int, screens, SZ_16M / buf_size);
+
 	fb_data->map_size = buf_size * fb_data->num_screens;
+
+	/*
+	 * The NTX UI maps a second copy of the screens after the first
+	 * (see mxc_epdc_fb_mmap()). Other userspace only ever sees the
+	 * first, so don't reserve the second copy for it.
+	 */
+	fb_data->alloc_size = fb_data->map_size;
+	if (0 == gptHWCFG->m_val.bUIStyle)
+		fb_data->alloc_size <<= 1;
 	dev_dbg(&pdev->dev, "memory to allocate: %d\n", fb_data->map_size);
 
 	DBG_MSG("[%s] memory to allocate: %d,num_screens=%d\n",__FUNCTION__, \
@@ -4579,7 +7551,7 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 
 	/* Allocate FB memory */
 	info->screen_base = dma_alloc_writecombine(&pdev->dev,
-						  fb_data->map_size<<1,
+						  fb_data->alloc_size,
 						  &fb_data->phys_start,
 						  GFP_DMA);
 
@@ -4699,51 +7671,37 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&fb_data->upd_buf_collision_list);
 
 	/* Allocate update buffers and add them to the list */
-	for (i = 0; i < EPDC_MAX_NUM_UPDATES; i++) {
-		upd_list = kzalloc(sizeof(*upd_list), GFP_KERNEL);
-		if (upd_list == NULL) {
+	fb_data->upd_buf_size = max_pix_size;
+	fb_data->upd_buf_min = giEPDC_MAX_NUM_UPDATES;
+	fb_data->upd_buf_max = min(giEPDC_MAX_NUM_UPDATES * 2,
+				   EPDC_MAX_NUM_UPDATES);
+	INIT_DELAYED_WORK(&fb_data->upd_buf_shrink_work,
+			  epdc_upd_buf_shrink_work_func);
+	while (fb_data->upd_buf_count < fb_data->upd_buf_min) {
+		if (!epdc_grow_upd_buffers(fb_data)) {
 			GALLEN_DBGLOCAL_RUNLOG(25);
 			ret = -ENOMEM;
 			goto out_upd_buffers;
 		}
+	}
 
-		/*
-		 * Each update buffer is 1 byte per pixel, and can
-		 * be as big as the full-screen frame buffer
-		 */
-		upd_list->size = max_pix_size;
-
-		/* Allocate memory for PxP output buffer */
-		upd_list->virt_addr =
-		    dma_alloc_coherent(fb_data->info.device, upd_list->size,
-				       &upd_list->phys_addr, GFP_DMA);
-		if (upd_list->virt_addr == NULL) {
-			GALLEN_DBGLOCAL_RUNLOG(26);
-			kfree(upd_list);
-			ret = -ENOMEM;
-			goto out_upd_buffers;
-		}
+	/*
+	 * Preallocate the dithering error lines. Size them for the widest
+	 * region in either orientation and for whichever of the C and NEON
+	 * layouts is bigger.
+	 */
+	fb_data->dither_max_width = max(xres_virt, xres_virt_rot);
+	if (epdc_dither_buf_alloc(fb_data)) {
+		ret = -ENOMEM;
+		goto out_upd_buffers;
+	}
 
-		/* Add newly allocated buffer to free list */
-		list_add(&upd_list->list, &fb_data->upd_buf_free_list);
-
-		dev_dbg(fb_data->info.device, "allocated %d bytes @ 0x%08X\n",
-			upd_list->size, upd_list->phys_addr);
-		DBG_MSG("[%s]Pxp out buffer allocated %d bytes @ 0x%08X\n",__FUNCTION__,
-			upd_list->size, upd_list->phys_addr);
-
-		/* Allocate memory for PxP SW workaround buffers */
-		/* These buffers are used to hold copy of the update region */
-		upd_list->virt_addr_copybuf =
-		    dma_alloc_coherent(fb_data->info.device, upd_list->size*2,
-				       &upd_list->phys_addr_copybuf, GFP_DMA);
-		if (upd_list->virt_addr_copybuf == NULL) {
-			GALLEN_DBGLOCAL_RUNLOG(27);
-			ret = -ENOMEM;
-			goto out_upd_buffers;
-		}
-		DBG_MSG("[%s]Pxp SW workarround allocated %d bytes @ 0x%08X\n",__FUNCTION__,
-			upd_list->size * 2, upd_list->phys_addr);
+	fb_data->defio_page_hash = kzalloc(
+		DIV_ROUND_UP(fb_data->map_size, PAGE_SIZE) * sizeof(u32),
+		GFP_KERNEL);
+	if (fb_data->defio_page_hash == NULL) {
+		ret = -ENOMEM;
+		goto out_upd_buffers;
 	}
 
 	fb_data->working_buffer_size = vmode->yres * vmode->xres * 2;
@@ -4796,8 +7754,11 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	fb_data->wv_modes.mode_gc8 = 2;
 	fb_data->wv_modes.mode_gc16 = 2;
 	fb_data->wv_modes.mode_gc32 = 2;
+	for (i = 0; i < MXCFB_HIST_CLASSES; i++)
+		fb_data->hist_wv_policy[i] = -1;
 
 	fb_data->merge_on_waveform_mismatch = 1;
+	fb_data->copy_dma_threshold = 64 * 1024;
 
 	/* Initialize marker list */
 	INIT_LIST_HEAD(&fb_data->full_marker_list);
@@ -4830,9 +7791,16 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	}
 
 	INIT_DELAYED_WORK(&fb_data->epdc_done_work, epdc_done_work_func);
+	spin_lock_init(&fb_data->wq_stat_lock);
 	fb_data->epdc_submit_workqueue = create_rt_workqueue("submit");
 	INIT_WORK(&fb_data->epdc_submit_work, epdc_submit_work_func);
 	INIT_WORK(&fb_data->epdc_firmware_work, epdc_firmware_func);
+	INIT_WORK(&fb_data->wv_load_work, epdc_wv_load_work_func);
+	mutex_init(&fb_data->direct_mutex);
+	INIT_LIST_HEAD(&fb_data->direct_upd.list);
+	INIT_LIST_HEAD(&fb_data->direct_desc.list);
+	INIT_LIST_HEAD(&fb_data->direct_desc.upd_marker_list);
+	INIT_WORK(&fb_data->direct_redo_work, epdc_direct_redo_work_func);
 
 	info->fbdefio = &mxc_epdc_fb_defio;
 #ifdef CONFIG_FB_MXC_EINK_AUTO_UPDATE_MODE
@@ -4867,14 +7835,17 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
     gpio_direction_output(GPIO_PWRALL, 1);
 #endif
 	
-	if (device_create_file(info->dev, &fb_attrs[0])) {
-		GALLEN_DBGLOCAL_RUNLOG(37);
-		dev_err(&pdev->dev, "Unable to create file from fb_attrs\n");
+	for (i = 0; i < ARRAY_SIZE(fb_attrs); i++) {
+		if (device_create_file(info->dev, &fb_attrs[i])) {
+			GALLEN_DBGLOCAL_RUNLOG(37);
+			dev_err(&pdev->dev, "Unable to create file from fb_attrs\n");
+		}
 	}
 
 	fb_data->cur_update = NULL;
 
 	spin_lock_init(&fb_data->queue_lock);
+	spin_lock_init(&fb_data->wv_lock);
 
 	mutex_init(&fb_data->pxp_mutex);
 
@@ -4973,6 +7944,7 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	fb_data->wait_for_powerdown = false;
 	fb_data->updates_active = false;
 	fb_data->pwrdown_delay = 0;
+	fb_data->pwr_breakeven_ms = EPDC_PWR_DEFAULT_BREAKEVEN;
 
 
 	fake_s1d13522_parse_epd_cmdline();
@@ -4988,6 +7960,13 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 
 	g_fb_data = fb_data;
 
+	epdc_debugfs_init(fb_data);
+
+	/* Don't let the display wait for WiFi/USB to come back on resume */
+	device_enable_async_resume(&pdev->dev);
+	/* The panel holds the page, no need to blank it for a micro suspend */
+	device_set_retains_state(&pdev->dev, true);
+
 #ifdef DEFAULT_PANEL_HW_INIT
 	GALLEN_DBGLOCAL_RUNLOG(48);
 	ret = mxc_epdc_fb_init_hw((struct fb_info *)fb_data);
@@ -5025,6 +8004,8 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
     fb_finish_render_timer.expires = jiffies + 10;
     fb_finish_render_timer.function = fb_finish_render_timeout;
     init_timer(&fb_finish_render_timer);
+    /* Only a timeout, it may fire late to share a wakeup */
+    set_timer_slack(&fb_finish_render_timer, HZ / 4);
 
 
 	goto out;
@@ -5041,20 +8022,16 @@ out_dma_work_buf:
 		fb_data->pdata->put_pins();
 	}
 out_upd_buffers:
+	kfree(fb_data->defio_page_hash);
+	epdc_dither_buf_free(fb_data);
 	list_for_each_entry_safe(plist, temp_list, &fb_data->upd_buf_free_list,
 			list) {
 		GALLEN_DBGLOCAL_RUNLOG(42);
 		list_del(&plist->list);
-		dma_free_writecombine(&pdev->dev, plist->size,
-				      plist->virt_addr,
-				      plist->phys_addr);
-		dma_free_writecombine(&pdev->dev, plist->size*2,
-				      plist->virt_addr_copybuf,
-				      plist->phys_addr_copybuf);
-		kfree(plist);
+		epdc_free_upd_buffer(fb_data, plist);
 	}
 out_dma_fb:
-	dma_free_writecombine(&pdev->dev, fb_data->map_size, info->screen_base,
+	dma_free_writecombine(&pdev->dev, fb_data->alloc_size, info->screen_base,
 			      fb_data->phys_start);
 
 
@@ -5078,8 +8055,14 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 
 	mxc_epdc_fb_blank(FB_BLANK_POWERDOWN, &fb_data->info);
 
+	cancel_delayed_work_sync(&fb_data->epdc_done_work);
 	flush_workqueue(fb_data->epdc_submit_workqueue);
 	destroy_workqueue(fb_data->epdc_submit_workqueue);
+	cancel_delayed_work_sync(&fb_data->upd_buf_shrink_work);
+	cancel_work_sync(&fb_data->wv_load_work);
+	cancel_work_sync(&fb_data->direct_redo_work);
+	k_pxp_rotate_free();
+	k_temperature_stop();
 
 #ifdef USE_PMIC
 	GALLEN_DBGLOCAL_RUNLOG(0);
@@ -5087,6 +8070,7 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 	regulator_put(fb_data->vcom_regulator);
 #endif
 
+	epdc_debugfs_exit(fb_data);
 	unregister_framebuffer(&fb_data->info);
 	free_irq(fb_data->epdc_irq, fb_data);
 
@@ -5100,24 +8084,31 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 				fb_data->waveform_buffer_virt,
 				fb_data->waveform_buffer_phys);
 	}
+	if (fb_data->wv_next_virt)
+		dma_free_coherent(&pdev->dev, fb_data->wv_next_size,
+				fb_data->wv_next_virt, fb_data->wv_next_phys);
+	epdc_wv_free_old(fb_data);
+	kfree(fb_data->wv_bounds);
+	vfree(fb_data->wv_src_alloc);
+	kfree(fb_data->defio_page_hash);
+	epdc_dither_buf_free(fb_data);
+	if (fb_data->direct_upd.virt_addr)
+		dma_free_coherent(fb_data->info.device,
+				  fb_data->direct_upd.size,
+				  fb_data->direct_upd.virt_addr,
+				  fb_data->direct_upd.phys_addr);
 	list_for_each_entry_safe(plist, temp_list, &fb_data->upd_buf_free_list,
 			list) {
 		GALLEN_DBGLOCAL_RUNLOG(2);		
 		list_del(&plist->list);
-		dma_free_writecombine(&pdev->dev, plist->size,
-				      plist->virt_addr,
-				      plist->phys_addr);
-		dma_free_writecombine(&pdev->dev, plist->size*2,
-				      plist->virt_addr_copybuf,
-				      plist->phys_addr_copybuf);
-		kfree(plist);
+		epdc_free_upd_buffer(fb_data, plist);
 	}
 #ifdef CONFIG_FB_MXC_EINK_AUTO_UPDATE_MODE
 	GALLEN_DBGLOCAL_RUNLOG(3);
 	fb_deferred_io_cleanup(&fb_data->info);
 #endif
 
-	dma_free_writecombine(&pdev->dev, fb_data->map_size, fb_data->info.screen_base,
+	dma_free_writecombine(&pdev->dev, fb_data->alloc_size, fb_data->info.screen_base,
 			      fb_data->phys_start);
 
 	if (fb_data->pdata->put_pins) {
@@ -5130,6 +8121,8 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 		GALLEN_DBGLOCAL_RUNLOG(5);
 		dma_release_channel(&fb_data->pxp_chan->dma_chan);
 	}
+	if (fb_data->memcpy_chan)
+		dma_release_channel(fb_data->memcpy_chan);
 
 	dmaengine_put();
 
@@ -5167,6 +8160,7 @@ static struct early_suspend mxc_epdc_earlysuspend = {
 #ifdef CONFIG_PM
 extern void lm75_suspend (void);
 extern void lm75_resume (void);
+extern struct device *lm75_device (void);
 
 static int mxc_epdc_fb_suspend(struct platform_device *pdev, pm_message_t state)
 {
@@ -5198,6 +8192,7 @@ static int mxc_epdc_fb_suspend(struct platform_device *pdev, pm_message_t state)
 		int i;
 
 		epdc_powerup(data);
+		epdc_powerup_wait(data);
 
 		epdc_set_update_addr(data->phys_start);
 		epdc_set_update_coord(0, 0);
@@ -5216,6 +8211,8 @@ static int mxc_epdc_fb_suspend(struct platform_device *pdev, pm_message_t state)
 		disable_irq(data->epdc_irq);
 		epdc_powerdown(data);
 	}
+	/* No more sensor reads until resume */
+	k_temperature_stop();
 	if(6==gptHWCFG->m_val.bDisplayCtrl) {
 		if(tps65185_suspend()>=0) {
 			ret = 0;
@@ -5227,6 +8224,8 @@ static int mxc_epdc_fb_suspend(struct platform_device *pdev, pm_message_t state)
 	else {
 		lm75_suspend ();
 	}
+	if (ret)
+		k_temperature_resume();
 out:
 	GALLEN_DBGLOCAL_END();
 	return ret;
@@ -5238,13 +8237,16 @@ static int mxc_epdc_fb_resume(struct platform_device *pdev)
 	struct mxc_epdc_fb_data *data = platform_get_drvdata(pdev);
 	GALLEN_DBGLOCAL_BEGIN();
 
+	/* Resumed asynchronously: the sensor/PMIC client is not our parent */
 	if(6==gptHWCFG->m_val.bDisplayCtrl) {
+		device_pm_wait_for_dev(&pdev->dev, tps65185_device());
 		tps65185_resume();
 	}
 	else {
+		device_pm_wait_for_dev(&pdev->dev, lm75_device());
 		lm75_resume();
 	}
-	gdwLastUpdateJiffies = 0;
+	k_temperature_resume();
 
 	if (mxc_epdc_earlysuspend_mode)
 		enable_irq(data->epdc_irq);
@@ -5319,7 +8321,7 @@ static int pxp_chan_init(struct mxc_epdc_fb_data *fb_data)
  */
 static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 			      u32 src_width, u32 src_height,
-			      struct mxcfb_rect *update_region)
+			      struct mxcfb_rect *update_region, u32 rotate)
 {
 	dma_cookie_t cookie;
 	struct scatterlist *sg = fb_data->sg;
@@ -5401,7 +8403,7 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 	proc_data->drect.height = proc_data->srect.height;
 
 	/* PXP expects rotation in terms of degrees */
-	proc_data->rotate = fb_data->epdc_fb_var.rotate * 90;
+	proc_data->rotate = rotate;
 	if (proc_data->rotate > 270)
 	{
 		GALLEN_DBGLOCAL_RUNLOG(1);
@@ -5488,8 +8490,11 @@ static int pxp_complete_update(struct mxc_epdc_fb_data *fb_data, u32 *hist_stat)
 	}
 
 	*hist_stat = to_tx_desc(fb_data->txd)->hist_status;
-	dma_release_channel(&fb_data->pxp_chan->dma_chan);
-	fb_data->pxp_chan = NULL;
+	/*
+	 * Keep the channel for the next update, so back to back updates
+	 * do not pay for a channel request and can queue behind each
+	 * other in the PxP driver. It is released on error and on remove.
+	 */
 
 	dev_dbg(fb_data->dev, "TX completed\n");
 
@@ -5509,9 +8514,9 @@ static int pxp_complete_update(struct mxc_epdc_fb_data *fb_data, u32 *hist_stat)
  */
 static void do_dithering_processing_Y1_v1_0(
 	unsigned char *update_region_ptr,
-	int width, int height, int stride)
+	int width, int height, int stride, int *err_dist)
 {
-	/* create a temp error distribution array */
+	/* err_dist: (width + 3) * 3 zeroed ints from the caller */
 	int bwPix;
 	int y;
 	int col;
@@ -5519,10 +8524,7 @@ static void do_dithering_processing_Y1_v1_0(
 	int width_3 = width + 3;
 	char *y8buf;
 	int x_offset = 0;
-	int *err_dist;
 
-	err_dist = kzalloc(width_3 * 3 * sizeof(int), GFP_KERNEL);
-	
 	/* prime a few elements the error distribution array */
 	for (y = 0; y < height; y++) {
 		/* Dithering the Y8 in sbuf to BW suitable for A2 waveform */
@@ -5554,11 +8556,6 @@ static void do_dithering_processing_Y1_v1_0(
 		}
 		x_offset += stride;
 	}
-	
-	kfree(err_dist);
-
-	flush_cache_all();
-	//outer_flush_all();
 }
 
 /*
@@ -5566,9 +8563,9 @@ static void do_dithering_processing_Y1_v1_0(
  */
 static void do_dithering_processing_Y4_v1_0(
 	unsigned char *update_region_ptr,
-	int width, int height, int stride)
+	int width, int height, int stride, int *err_dist)
 {
-	/* create a temp error distribution array */
+	/* err_dist: (width + 3) * 3 zeroed ints from the caller */
 	int gcPix;
 	int y;
 	int col;
@@ -5576,10 +8573,7 @@ static void do_dithering_processing_Y4_v1_0(
 	int width_3 = width + 3;
 	char *y8buf;
 	int x_offset = 0;
-	int *err_dist;
 
-	err_dist = kzalloc(width_3 * 3 * sizeof(int), GFP_KERNEL);
-	
 	/* prime a few elements the error distribution array */
 	for (y = 0; y < height; y++) {
 		/* Dithering the Y8 in sbuf to Y4 */
@@ -5612,11 +8606,6 @@ static void do_dithering_processing_Y4_v1_0(
 		}
 		x_offset += stride;
 	}
-
-	kfree(err_dist);
-	
-	flush_cache_all();
-	//outer_flush_all();
 }
 
 static int __init mxc_epdc_fb_init(void)
@@ -5627,7 +8616,16 @@ static int __init mxc_epdc_fb_init(void)
 #ifndef FW_IN_RAM
 late_initcall(mxc_epdc_fb_init);
 #else
-module_init(mxc_epdc_fb_init);
+/*
+ * Waveform and logo are handed over by the bootloader in RAM, so the
+ * panel needs nothing from the root filesystem.  Probe as soon as its
+ * providers are up - PxP and SDMA (subsys_initcall), the i2c buses
+ * (subsys_initcall) and the MSP430/TPS65185 clients behind them
+ * (subsys_initcall_sync) - instead of behind every device_initcall,
+ * so the logo replaces the bootloader screen before the rest of the
+ * drivers probe.
+ */
+fs_initcall(mxc_epdc_fb_init);
 #endif
 
 static void __exit mxc_epdc_fb_exit(void)
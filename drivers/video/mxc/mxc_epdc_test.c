@@ -0,0 +1,368 @@
+/*
+ * E-Ink update pipeline benchmark
+ *
+ * Replays a mix of update sizes, waveform modes, dithering and placements
+ * through mxc_epdc_fb_send_update() and reports throughput, per stage
+ * latency percentiles and the collision rate.  The run starts when the
+ * module is loaded; the results go to the kernel log.  It draws over
+ * whatever is on the panel, and updates sent by others while it runs are
+ * counted along with its own.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/fb.h>
+#include <linux/mxcfb.h>
+#include <linux/mxcfb_epdc_kernel.h>
+
+#define EPDCTEST_MAX_ITERATIONS	4096
+#define EPDCTEST_MAX_INFLIGHT	16
+#define EPDCTEST_MARKER_BASE	0x7e570000
+
+#define EPDCTEST_PLACE_TILE	0	/* consecutive updates don't overlap */
+#define EPDCTEST_PLACE_SAME	1	/* every update at the same spot */
+#define EPDCTEST_PLACE_RANDOM	2
+
+static unsigned int iterations = 200;
+module_param(iterations, uint, S_IRUGO);
+MODULE_PARM_DESC(iterations, "Updates to send (default: 200, max: 4096)");
+
+static unsigned int sizes[8] = { 100, 50, 25, 10 };
+static unsigned int nr_sizes = 4;
+module_param_array(sizes, uint, &nr_sizes, S_IRUGO);
+MODULE_PARM_DESC(sizes,
+		"Update width and height in percent of the panel, cycled "
+		"(default: 100,50,25,10)");
+
+static unsigned int waveforms[8] = { WAVEFORM_MODE_AUTO };
+static unsigned int nr_waveforms = 1;
+module_param_array(waveforms, uint, &nr_waveforms, S_IRUGO);
+MODULE_PARM_DESC(waveforms, "Waveform modes, cycled (default: 257, auto)");
+
+static unsigned int dither[3] = { 0 };
+static unsigned int nr_dither = 1;
+module_param_array(dither, uint, &nr_dither, S_IRUGO);
+MODULE_PARM_DESC(dither, "0: none, 1: Y1, 2: Y4, cycled (default: 0)");
+
+static unsigned int placement = EPDCTEST_PLACE_TILE;
+module_param(placement, uint, S_IRUGO);
+MODULE_PARM_DESC(placement, "0: tiled, 1: same spot, 2: random (default: 0)");
+
+static unsigned int full_every;
+module_param(full_every, uint, S_IRUGO);
+MODULE_PARM_DESC(full_every,
+		"Send every n-th update as a full update (default: 0, never)");
+
+static unsigned int inflight = 4;
+module_param(inflight, uint, S_IRUGO);
+MODULE_PARM_DESC(inflight,
+		"Updates outstanding before waiting for the oldest (default: 4)");
+
+enum {
+	STAGE_SEND,	/* time spent in mxc_epdc_fb_send_update() */
+	STAGE_QUEUE,
+	STAGE_PXP,
+	STAGE_SUBMIT,
+	STAGE_PANEL,
+	STAGE_TOTAL,
+	NR_STAGES
+};
+
+static const char *stage_names[NR_STAGES] = {
+	[STAGE_SEND]	= "send",
+	[STAGE_QUEUE]	= "queue",
+	[STAGE_PXP]	= "pxp",
+	[STAGE_SUBMIT]	= "submit",
+	[STAGE_PANEL]	= "panel",
+	[STAGE_TOTAL]	= "total",
+};
+
+struct epdctest {
+	struct fb_info		*info;
+	struct task_struct	*task;
+	spinlock_t		lock;	/* samples of the observer stages */
+	u32			*samples[NR_STAGES];
+	unsigned int		nr_samples[NR_STAGES];
+};
+
+static struct epdctest *test;
+
+static struct fb_info *epdctest_find_fb(void)
+{
+	int i;
+
+	for (i = 0; i < num_registered_fb; i++)
+		if (registered_fb[i] &&
+		    !strcmp(registered_fb[i]->fix.id, "mxc_epdc_fb"))
+			return registered_fb[i];
+	return NULL;
+}
+
+static void epdctest_add_sample(struct epdctest *t, int stage,
+				ktime_t later, ktime_t earlier)
+{
+	s64 us;
+
+	if (!ktime_to_ns(earlier) || !ktime_to_ns(later))
+		return;
+	us = ktime_us_delta(later, earlier);
+	if (us < 0 || t->nr_samples[stage] >= iterations)
+		return;
+	t->samples[stage][t->nr_samples[stage]++] = us;
+}
+
+static void epdctest_observe(void *data, const struct mxc_epdc_upd_timing *tm)
+{
+	struct epdctest *t = data;
+
+	spin_lock(&t->lock);
+	epdctest_add_sample(t, STAGE_QUEUE, tm->pxp_start, tm->send);
+	epdctest_add_sample(t, STAGE_PXP, tm->pxp_done, tm->pxp_start);
+	epdctest_add_sample(t, STAGE_SUBMIT, tm->submit, tm->pxp_done);
+	epdctest_add_sample(t, STAGE_PANEL, tm->complete, tm->submit);
+	epdctest_add_sample(t, STAGE_TOTAL, tm->complete, tm->send);
+	spin_unlock(&t->lock);
+}
+
+/* Fill the region so that consecutive updates always change the panel */
+static void epdctest_draw(struct fb_info *info, struct mxcfb_rect *r, int n)
+{
+	int bpp = info->var.bits_per_pixel / 8;
+	u8 val = (n & 1) ? 0xff : 0x00;
+	u8 *line;
+	int y;
+
+	if (!info->screen_base || !bpp)
+		return;
+
+	line = info->screen_base + (r->top + info->var.yoffset) *
+		info->fix.line_length + r->left * bpp;
+	for (y = 0; y < r->height; y++, line += info->fix.line_length)
+		memset(line, val, r->width * bpp);
+}
+
+static void epdctest_place(struct fb_info *info, struct mxcfb_rect *r, int n)
+{
+	u32 xres = info->var.xres, yres = info->var.yres;
+	unsigned int pct = sizes[n % nr_sizes];
+	static u32 x, y;
+
+	r->width = clamp(xres * pct / 100, 1U, xres);
+	r->height = clamp(yres * pct / 100, 1U, yres);
+
+	switch (placement) {
+	case EPDCTEST_PLACE_SAME:
+		r->left = 0;
+		r->top = 0;
+		break;
+	case EPDCTEST_PLACE_RANDOM:
+		r->left = random32() % (xres - r->width + 1);
+		r->top = random32() % (yres - r->height + 1);
+		break;
+	default:
+		/* walk a grid of this size, left to right, top to bottom */
+		if (x + r->width > xres) {
+			x = 0;
+			y += r->height;
+		}
+		if (y + r->height > yres)
+			y = 0;
+		r->left = x;
+		r->top = y;
+		x += r->width;
+		break;
+	}
+}
+
+static int epdctest_cmp(const void *a, const void *b)
+{
+	u32 ua = *(const u32 *)a, ub = *(const u32 *)b;
+
+	return ua < ub ? -1 : ua > ub;
+}
+
+static void epdctest_report(struct epdctest *t, unsigned int sent,
+			    unsigned int errors, s64 elapsed_us, u32 collisions)
+{
+	unsigned long flags;
+	u32 rate = 0;	/* updates per 100 seconds */
+	int stage;
+
+	if (elapsed_us > 0)
+		rate = div64_u64((u64)sent * USEC_PER_SEC * 100, elapsed_us);
+	pr_info("epdctest: %u updates in %lld ms, %u.%02u updates/s, "
+		"%u errors, %u collisions (%u%%)\n", sent,
+		div_s64(elapsed_us, 1000), rate / 100, rate % 100,
+		errors, collisions, sent ? collisions * 100 / sent : 0);
+	pr_info("epdctest: %-8s %8s %8s %8s %8s %8s\n",
+		"stage", "samples", "p50_us", "p90_us", "p99_us", "max_us");
+
+	for (stage = 0; stage < NR_STAGES; stage++) {
+		unsigned int n;
+		u32 *v = t->samples[stage];
+
+		spin_lock_irqsave(&t->lock, flags);
+		n = t->nr_samples[stage];
+		spin_unlock_irqrestore(&t->lock, flags);
+		if (!n)
+			continue;
+
+		sort(v, n, sizeof(*v), epdctest_cmp, NULL);
+		pr_info("epdctest: %-8s %8u %8u %8u %8u %8u\n",
+			stage_names[stage], n, v[(n - 1) * 50 / 100],
+			v[(n - 1) * 90 / 100], v[(n - 1) * 99 / 100], v[n - 1]);
+	}
+}
+
+static int epdctest_thread(void *data)
+{
+	struct epdctest *t = data;
+	u32 markers[EPDCTEST_MAX_INFLIGHT];
+	unsigned int head = 0, pending = 0, sent = 0, errors = 0;
+	u32 collisions;
+	ktime_t start;
+	int i, ret;
+
+	ret = mxc_epdc_fb_set_upd_observer(t->info, epdctest_observe, t);
+	if (ret) {
+		pr_err("epdctest: update observer busy\n");
+		goto wait_stop;
+	}
+
+	collisions = mxc_epdc_fb_get_collisions(t->info);
+	start = ktime_get();
+
+	for (i = 0; i < iterations && !kthread_should_stop(); i++) {
+		struct mxcfb_update_data upd;
+		ktime_t before;
+
+		if (pending == inflight) {
+			mxc_epdc_fb_wait_update_complete(markers[head], t->info);
+			head = (head + 1) % inflight;
+			pending--;
+		}
+
+		memset(&upd, 0, sizeof(upd));
+		epdctest_place(t->info, &upd.update_region, i);
+		epdctest_draw(t->info, &upd.update_region, i);
+		upd.waveform_mode = waveforms[i % nr_waveforms];
+		upd.update_mode = (full_every && !((i + 1) % full_every)) ?
+			UPDATE_MODE_FULL : UPDATE_MODE_PARTIAL;
+		upd.update_marker = EPDCTEST_MARKER_BASE + i;
+		upd.temp = TEMP_USE_AMBIENT;
+		switch (dither[i % nr_dither]) {
+		case 1:
+			upd.flags = EPDC_FLAG_USE_DITHERING_Y1;
+			break;
+		case 2:
+			upd.flags = EPDC_FLAG_USE_DITHERING_Y4;
+			break;
+		}
+
+		before = ktime_get();
+		ret = mxc_epdc_fb_send_update(&upd, t->info);
+		if (ret) {
+			errors++;
+			continue;
+		}
+		spin_lock_irq(&t->lock);
+		epdctest_add_sample(t, STAGE_SEND, ktime_get(), before);
+		spin_unlock_irq(&t->lock);
+
+		markers[(head + pending) % inflight] = upd.update_marker;
+		pending++;
+		sent++;
+	}
+
+	while (pending--) {
+		mxc_epdc_fb_wait_update_complete(markers[head], t->info);
+		head = (head + 1) % inflight;
+	}
+
+	mxc_epdc_fb_set_upd_observer(t->info, NULL, NULL);
+	epdctest_report(t, sent, errors, ktime_us_delta(ktime_get(), start),
+			mxc_epdc_fb_get_collisions(t->info) - collisions);
+
+wait_stop:
+	/* stay around for kthread_stop() from module unload */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void epdctest_free(struct epdctest *t)
+{
+	int stage;
+
+	for (stage = 0; stage < NR_STAGES; stage++)
+		vfree(t->samples[stage]);
+	kfree(t);
+}
+
+static int __init epdctest_init(void)
+{
+	struct fb_info *info;
+	int stage;
+
+	info = epdctest_find_fb();
+	if (!info) {
+		pr_err("epdctest: no EPDC framebuffer\n");
+		return -ENODEV;
+	}
+
+	iterations = clamp(iterations, 1U, (unsigned)EPDCTEST_MAX_ITERATIONS);
+	inflight = clamp(inflight, 1U, (unsigned)EPDCTEST_MAX_INFLIGHT);
+	if (!nr_sizes || !nr_waveforms || !nr_dither)
+		return -EINVAL;
+
+	test = kzalloc(sizeof(*test), GFP_KERNEL);
+	if (!test)
+		return -ENOMEM;
+	spin_lock_init(&test->lock);
+	test->info = info;
+	for (stage = 0; stage < NR_STAGES; stage++) {
+		test->samples[stage] = vmalloc(iterations * sizeof(u32));
+		if (!test->samples[stage]) {
+			epdctest_free(test);
+			return -ENOMEM;
+		}
+	}
+
+	test->task = kthread_run(epdctest_thread, test, "epdctest");
+	if (IS_ERR(test->task)) {
+		int ret = PTR_ERR(test->task);
+
+		epdctest_free(test);
+		return ret;
+	}
+
+	return 0;
+}
+/* when compiled-in wait for the framebuffer to be registered */
+late_initcall(epdctest_init);
+
+static void __exit epdctest_exit(void)
+{
+	/* the thread removes its observer before it waits to be stopped */
+	kthread_stop(test->task);
+	epdctest_free(test);
+}
+module_exit(epdctest_exit);
+
+MODULE_DESCRIPTION("E-Ink update pipeline benchmark");
+MODULE_LICENSE("GPL v2");
@@ -54,6 +54,9 @@
 #include <linux/clk.h>
 #include <linux/io.h>
 #include <linux/uaccess.h>
+#include <linux/jiffies.h>
+#include <linux/suspend.h>
+#include <asm/div64.h>
 
 #include "mxc_wdt.h"
 
@@ -70,13 +73,58 @@ static unsigned timer_margin = TIMER_MARGIN_DEFAULT;
 module_param(timer_margin, uint, 0);
 MODULE_PARM_DESC(timer_margin, "initial watchdog timeout (in seconds)");
 
+static unsigned suspend_margin = TIMER_MARGIN_MAX;
+module_param(suspend_margin, uint, 0644);
+MODULE_PARM_DESC(suspend_margin, "watchdog timeout across suspend/resume (in seconds)");
+
 static unsigned dev_num;
 
+/*
+ * Kick bookkeeping.  WCR_WDZST stops the counter in low power modes, so
+ * the time left computed from jiffies is a lower bound: a daemon can use
+ * WDIOC_GETTIMELEFT to kick when it is awake anyway instead of waking up
+ * on a timer of its own just for the watchdog.
+ */
+static unsigned long last_ping;			/* jiffies, 0 when stopped */
+static unsigned int ping_margin;		/* timeout armed by last ping, secs */
+static unsigned long kick_count;
+static u64 kick_interval_ms;			/* sum over kick_count - 1 kicks */
+static unsigned int kick_margin_min_ms = UINT_MAX;
+
 static void mxc_wdt_ping(void *base)
 {
 	/* issue the service sequence instructions */
 	__raw_writew(WDT_MAGIC_1, base + MXC_WDT_WSR);
 	__raw_writew(WDT_MAGIC_2, base + MXC_WDT_WSR);
+	last_ping = jiffies ? : 1;
+	ping_margin = timer_margin;
+}
+
+static int mxc_wdt_time_left(void)
+{
+	long left;
+
+	if (!last_ping)
+		return ping_margin;
+	left = ping_margin * HZ - (long)(jiffies - last_ping);
+	return left > 0 ? left / HZ : 0;
+}
+
+/* a keepalive from user space */
+static void mxc_wdt_kick(void *base)
+{
+	unsigned int since, margin;
+
+	if (last_ping) {
+		since = jiffies_to_msecs(jiffies - last_ping);
+		margin = ping_margin * MSEC_PER_SEC;
+		margin = since < margin ? margin - since : 0;
+		if (kick_count)
+			kick_interval_ms += since;
+		kick_margin_min_ms = min(kick_margin_min_ms, margin);
+	}
+	kick_count++;
+	mxc_wdt_ping(base);
 }
 
 static void mxc_wdt_config(void *base)
@@ -132,14 +180,19 @@ static u16 mxc_wdt_get_bootreason(void *base)
 	return val;
 }
 
-static void mxc_wdt_set_timeout(void *base)
+static unsigned mxc_wdt_write_timeout(void *base, unsigned secs)
 {
 	u16 val;
 	val = __raw_readw(base + MXC_WDT_WCR);
-	val = (val & 0x00FF) | WDOG_SEC_TO_COUNT(timer_margin);
+	val = (val & 0x00FF) | WDOG_SEC_TO_COUNT(secs);
 	__raw_writew(val, base + MXC_WDT_WCR);
 	val = __raw_readw(base + MXC_WDT_WCR);
-	timer_margin = WDOG_COUNT_TO_SEC(val);
+	return WDOG_COUNT_TO_SEC(val);
+}
+
+static void mxc_wdt_set_timeout(void *base)
+{
+	timer_margin = mxc_wdt_write_timeout(base, timer_margin);
 }
 
 /*
@@ -181,7 +234,7 @@ mxc_wdt_write(struct file *file, const char __user *data,
 {
 	/* Refresh LOAD_TIME. */
 	if (len)
-		mxc_wdt_ping(wdt_base_reg);
+		mxc_wdt_kick(wdt_base_reg);
 	return len;
 }
 
@@ -194,7 +247,7 @@ mxc_wdt_ioctl(struct inode *inode, struct file *file,
 
 	static struct watchdog_info ident = {
 		.identity = "MXC Watchdog",
-		.options = WDIOF_SETTIMEOUT,
+		.options = WDIOF_SETTIMEOUT | WDIOF_KEEPALIVEPING,
 		.firmware_version = 0,
 	};
 
@@ -210,7 +263,7 @@ mxc_wdt_ioctl(struct inode *inode, struct file *file,
 		bootr = mxc_wdt_get_bootreason(wdt_base_reg);
 		return put_user(bootr, (int __user *)arg);
 	case WDIOC_KEEPALIVE:
-		mxc_wdt_ping(wdt_base_reg);
+		mxc_wdt_kick(wdt_base_reg);
 		return 0;
 	case WDIOC_SETTIMEOUT:
 		if (get_user(new_margin, (int __user *)arg))
@@ -227,6 +280,9 @@ mxc_wdt_ioctl(struct inode *inode, struct file *file,
 		mxc_wdt_ping(wdt_base_reg);
 		new_margin = mxc_wdt_get_timeout(wdt_base_reg);
 		return put_user(new_margin, (int __user *)arg);
+
+	case WDIOC_GETTIMELEFT:
+		return put_user(mxc_wdt_time_left(), (int __user *)arg);
 	}
 }
 
@@ -244,10 +300,85 @@ static struct miscdevice mxc_wdt_miscdev = {
 	.fops = &mxc_wdt_fops
 };
 
+static ssize_t kicks_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	return sprintf(buf, "%lu\n", kick_count);
+}
+
+static ssize_t kick_interval_ms_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	u64 avg = kick_interval_ms;
+
+	if (kick_count > 1)
+		do_div(avg, kick_count - 1);
+	return sprintf(buf, "%llu\n", (unsigned long long)avg);
+}
+
+static ssize_t kick_margin_min_ms_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	if (kick_margin_min_ms == UINT_MAX)
+		return sprintf(buf, "-1\n");
+	return sprintf(buf, "%u\n", kick_margin_min_ms);
+}
+
+static ssize_t time_left_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", last_ping ? mxc_wdt_time_left() : -1);
+}
+
+static struct device_attribute mxc_wdt_attrs[] = {
+	__ATTR_RO(kicks),
+	__ATTR_RO(kick_interval_ms),
+	__ATTR_RO(kick_margin_min_ms),
+	__ATTR_RO(time_left),
+};
+
+#ifdef CONFIG_PM_SLEEP
+/*
+ * The daemon is frozen well before our suspend callback and thawed well
+ * after resume, and syncing or slow devices can take longer than the
+ * normal timeout.  Arm the long suspend timeout for the whole transition
+ * and go back to the user's once tasks run again.
+ */
+static int mxc_wdt_pm_notify(struct notifier_block *nb, unsigned long event,
+			     void *unused)
+{
+	if (!mxc_wdt_users)
+		return NOTIFY_DONE;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		if (suspend_margin > timer_margin) {
+			mxc_wdt_write_timeout(wdt_base_reg,
+					      min(suspend_margin,
+						  (unsigned)TIMER_MARGIN_MAX));
+			__raw_writew(WDT_MAGIC_1, wdt_base_reg + MXC_WDT_WSR);
+			__raw_writew(WDT_MAGIC_2, wdt_base_reg + MXC_WDT_WSR);
+		}
+		/* a kick interval spanning the suspend says nothing */
+		last_ping = 0;
+		break;
+	case PM_POST_SUSPEND:
+		mxc_wdt_set_timeout(wdt_base_reg);
+		mxc_wdt_ping(wdt_base_reg);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block mxc_wdt_pm_nb = {
+	.notifier_call = mxc_wdt_pm_notify,
+};
+#endif
+
 static int __init mxc_wdt_probe(struct platform_device *pdev)
 {
 	struct resource *res, *mem;
-	int ret;
+	int ret, i;
 
 	/* reserve static register mappings */
 	res = platform_get_resource(pdev, IORESOURCE_MEM, dev_num);
@@ -276,6 +407,14 @@ static int __init mxc_wdt_probe(struct platform_device *pdev)
 	if (ret)
 		goto fail;
 
+	for (i = 0; i < ARRAY_SIZE(mxc_wdt_attrs); i++)
+		if (device_create_file(&pdev->dev, &mxc_wdt_attrs[i]))
+			dev_warn(&pdev->dev, "can't create %s\n",
+				 mxc_wdt_attrs[i].attr.name);
+#ifdef CONFIG_PM_SLEEP
+	register_pm_notifier(&mxc_wdt_pm_nb);
+#endif
+
 	pr_info("MXC Watchdog # %d Timer: initial timeout %d sec\n", dev_num,
 		timer_margin);
 
@@ -297,6 +436,13 @@ static void mxc_wdt_shutdown(struct platform_device *pdev)
 static int __exit mxc_wdt_remove(struct platform_device *pdev)
 {
 	struct resource *mem = platform_get_drvdata(pdev);
+	int i;
+
+#ifdef CONFIG_PM_SLEEP
+	unregister_pm_notifier(&mxc_wdt_pm_nb);
+#endif
+	for (i = 0; i < ARRAY_SIZE(mxc_wdt_attrs); i++)
+		device_remove_file(&pdev->dev, &mxc_wdt_attrs[i]);
 	misc_deregister(&mxc_wdt_miscdev);
 	iounmap(wdt_base_reg);
 	release_resource(mem);
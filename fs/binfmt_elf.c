@@ -76,6 +76,61 @@ static struct linux_binfmt elf_format = {
 
 #define BAD_ADDR(x) ((unsigned long)(x) >= TASK_SIZE)
 
+/*
+ * Read ahead and map the text of executables at exec rather than taking
+ * a fault per page as they start: 0 never, 1 for executables carrying a
+ * "Linux" NT_LINUX_PREFAULT note, 2 for all of them.
+ */
+static int elf_prefault_mode = 1;
+module_param_named(prefault, elf_prefault_mode, int, 0644);
+MODULE_PARM_DESC(prefault, "Prefault executable text: 0 off, 1 if noted, 2 always");
+
+static int elf_has_prefault_note(struct file *file, struct elf_phdr *phdr,
+				 int phnum)
+{
+	u32 buf[32];
+	int i;
+
+	for (i = 0; i < phnum; i++, phdr++) {
+		size_t size, off = 0;
+
+		if (phdr->p_type != PT_NOTE)
+			continue;
+
+		size = min_t(size_t, phdr->p_filesz, sizeof(buf));
+		if (kernel_read(file, phdr->p_offset, (char *)buf, size) != size)
+			continue;
+
+		while (size - off >= sizeof(struct elf_note)) {
+			struct elf_note *note = (void *)buf + off;
+			size_t namesz = ALIGN(note->n_namesz, 4);
+			size_t descsz = ALIGN(note->n_descsz, 4);
+
+			off += sizeof(*note);
+			if (namesz > size - off || descsz > size - off - namesz)
+				break;
+			if (note->n_type == NT_LINUX_PREFAULT &&
+			    note->n_namesz == sizeof("Linux") &&
+			    !memcmp((void *)buf + off, "Linux", sizeof("Linux")))
+				return 1;
+			off += namesz + descsz;
+		}
+	}
+	return 0;
+}
+
+static void elf_prefault(unsigned long addr, struct elf_phdr *eppnt)
+{
+	unsigned long size = eppnt->p_filesz + ELF_PAGEOFFSET(eppnt->p_vaddr);
+
+	if (!size)
+		return;
+
+	down_read(&current->mm->mmap_sem);
+	prefault_file_range(addr, addr + size);
+	up_read(&current->mm->mmap_sem);
+}
+
 static int set_brk(unsigned long start, unsigned long end)
 {
 	start = ELF_PAGEALIGN(start);
@@ -578,6 +633,7 @@ static int load_elf_binary(struct linux_binprm *bprm, struct pt_regs *regs)
 	unsigned long reloc_func_desc = 0;
 	int executable_stack = EXSTACK_DEFAULT;
 	unsigned long def_flags = 0;
+	int prefault;
 	struct {
 		struct elfhdr elf_ex;
 		struct elfhdr interp_elf_ex;
@@ -701,6 +757,11 @@ static int load_elf_binary(struct linux_binprm *bprm, struct pt_regs *regs)
 			break;
 		}
 
+	prefault = elf_prefault_mode > 1 ||
+		   (elf_prefault_mode == 1 &&
+		    elf_has_prefault_note(bprm->file, elf_phdata,
+					  loc->elf_ex.e_phnum));
+
 	/* Some simple consistency checks for the interpreter */
 	if (elf_interpreter) {
 		retval = -ELIBBAD;
@@ -826,6 +887,8 @@ static int load_elf_binary(struct linux_binprm *bprm, struct pt_regs *regs)
 				reloc_func_desc = load_bias;
 			}
 		}
+		if (prefault && (elf_ppnt->p_flags & PF_X))
+			elf_prefault(error, elf_ppnt);
 		k = elf_ppnt->p_vaddr;
 		if (k < start_code)
 			start_code = k;
@@ -0,0 +1,287 @@
+/*
+ * linux/fs/dir_prefetch.c
+ *
+ * Asynchronous metadata prefetch of a directory tree (FIPREFETCH).
+ *
+ * A reader application scanning its library right after boot pays for
+ * every cold ->lookup() and inode read one stat() at a time.  FIPREFETCH
+ * on a directory fd queues a walk of the tree below it on a kernel
+ * thread: each directory is read with a buffered readdir, its names are
+ * looked up in inode number order so the filesystem's inode table reads
+ * (and ext4's inode readahead) stay sequential, and the dentries and
+ * inodes are left in the dcache/icache for the application to find.
+ *
+ * The walk runs with the credentials of the caller, so it only reaches
+ * what the caller could have looked up itself.  It holds a reference to
+ * the mount while it runs and is bounded by PREFETCH_MAX_ENTRIES.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <linux/workqueue.h>
+#include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+
+#include "internal.h"
+
+#define PREFETCH_DEFAULT_DEPTH	8
+#define PREFETCH_MAX_DEPTH	32
+#define PREFETCH_MAX_ENTRIES	65536
+
+struct prefetch_dirent {
+	u64		ino;
+	int		namlen;
+	unsigned int	d_type;
+	char		name[];
+};
+
+#define PREFETCH_MIN_RECLEN \
+	ALIGN(sizeof(struct prefetch_dirent) + 1, sizeof(u64))
+#define PREFETCH_MAX_BATCH	(PAGE_SIZE / PREFETCH_MIN_RECLEN)
+
+struct prefetch_dir {
+	struct list_head	list;
+	struct path		path;
+	int			depth;
+};
+
+struct prefetch_req {
+	struct work_struct	work;
+	const struct cred	*cred;
+	struct list_head	dirs;
+	unsigned long		entries;
+	unsigned long		ndirs;
+	/* one page of buffered dirents and the sorted view of it */
+	char			*dirent;
+	size_t			used;
+	int			full;
+	struct prefetch_dirent	*batch[PREFETCH_MAX_BATCH];
+};
+
+static struct workqueue_struct *prefetch_wq;
+
+static int prefetch_filldir(void *__buf, const char *name, int namlen,
+			    loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct prefetch_req *req = __buf;
+	struct prefetch_dirent *de = (void *)(req->dirent + req->used);
+	unsigned int reclen;
+
+	if (name[0] == '.' && (namlen == 1 ||
+			       (namlen == 2 && name[1] == '.')))
+		return 0;
+
+	reclen = ALIGN(sizeof(struct prefetch_dirent) + namlen, sizeof(u64));
+	if (req->used + reclen > PAGE_SIZE) {
+		req->full = 1;
+		return -EINVAL;
+	}
+
+	de->ino = ino;
+	de->namlen = namlen;
+	de->d_type = d_type;
+	memcpy(de->name, name, namlen);
+	req->used += reclen;
+
+	return 0;
+}
+
+static int prefetch_cmp_ino(const void *a, const void *b)
+{
+	const struct prefetch_dirent *da = *(struct prefetch_dirent **)a;
+	const struct prefetch_dirent *db = *(struct prefetch_dirent **)b;
+
+	if (da->ino < db->ino)
+		return -1;
+	return da->ino > db->ino;
+}
+
+static void prefetch_queue_dir(struct prefetch_req *req, struct vfsmount *mnt,
+			       struct dentry *dentry, int depth)
+{
+	struct prefetch_dir *pd;
+
+	pd = kmalloc(sizeof(*pd), GFP_KERNEL);
+	if (!pd) {
+		dput(dentry);
+		return;
+	}
+	pd->path.mnt = mntget(mnt);
+	pd->path.dentry = dentry;
+	pd->depth = depth;
+	list_add_tail(&pd->list, &req->dirs);
+	req->ndirs++;
+}
+
+/*
+ * Look up one page worth of names under @parent.  Called with the
+ * parent's i_mutex held, as lookup_one_len() expects.
+ */
+static void prefetch_lookup_batch(struct prefetch_req *req,
+				  struct prefetch_dir *pd)
+{
+	struct dentry *parent = pd->path.dentry;
+	struct prefetch_dirent *de;
+	struct dentry *dentry;
+	size_t pos = 0;
+	int n = 0, i;
+
+	while (pos < req->used && n < PREFETCH_MAX_BATCH) {
+		de = (struct prefetch_dirent *)(req->dirent + pos);
+		req->batch[n++] = de;
+		pos += ALIGN(sizeof(*de) + de->namlen, sizeof(u64));
+	}
+	sort(req->batch, n, sizeof(req->batch[0]), prefetch_cmp_ino, NULL);
+
+	for (i = 0; i < n; i++) {
+		if (req->entries >= PREFETCH_MAX_ENTRIES)
+			break;
+		req->entries++;
+
+		de = req->batch[i];
+		dentry = lookup_one_len(de->name, parent, de->namlen);
+		if (IS_ERR(dentry))
+			continue;
+
+		if (pd->depth > 1 && dentry->d_inode &&
+		    S_ISDIR(dentry->d_inode->i_mode) &&
+		    !d_mountpoint(dentry)) {
+			prefetch_queue_dir(req, pd->path.mnt, dentry,
+					   pd->depth - 1);
+			continue;
+		}
+		dput(dentry);
+	}
+}
+
+static void prefetch_one_dir(struct prefetch_req *req, struct prefetch_dir *pd)
+{
+	struct inode *dir = pd->path.dentry->d_inode;
+	struct file *file;
+	int err;
+
+	if (inode_permission(dir, MAY_READ | MAY_EXEC))
+		return;
+
+	file = dentry_open(dget(pd->path.dentry), mntget(pd->path.mnt),
+			   O_RDONLY | O_DIRECTORY | O_NOATIME, req->cred);
+	if (IS_ERR(file))
+		return;
+
+	while (req->entries < PREFETCH_MAX_ENTRIES) {
+		req->used = 0;
+		req->full = 0;
+
+		err = vfs_readdir(file, prefetch_filldir, req);
+		if (req->full)
+			err = 0;
+		if (err < 0 || !req->used)
+			break;
+
+		/* ->lookup() can't be called from filldir, see nfsd */
+		if (mutex_lock_killable(&dir->i_mutex))
+			break;
+		prefetch_lookup_batch(req, pd);
+		mutex_unlock(&dir->i_mutex);
+
+		if (!req->full)
+			break;
+	}
+
+	fput(file);
+}
+
+static void prefetch_work(struct work_struct *work)
+{
+	struct prefetch_req *req = container_of(work, struct prefetch_req, work);
+	const struct cred *old_cred;
+	struct prefetch_dir *pd;
+	ktime_t start = ktime_get();
+
+	old_cred = override_creds(req->cred);
+
+	while (!list_empty(&req->dirs)) {
+		pd = list_first_entry(&req->dirs, struct prefetch_dir, list);
+		list_del(&pd->list);
+
+		if (req->entries < PREFETCH_MAX_ENTRIES)
+			prefetch_one_dir(req, pd);
+
+		path_put(&pd->path);
+		kfree(pd);
+	}
+
+	revert_creds(old_cred);
+
+	pr_debug("dir_prefetch: %lu entries in %lu dirs, %lld usecs\n",
+		 req->entries, req->ndirs,
+		 ktime_to_us(ktime_sub(ktime_get(), start)));
+
+	put_cred(req->cred);
+	free_page((unsigned long)req->dirent);
+	kfree(req);
+}
+
+/**
+ * ioctl_dir_prefetch - queue a metadata prefetch of a directory tree
+ * @filp:	open directory to start from
+ * @argp:	user pointer to the number of levels to walk, 0 for default
+ *
+ * Returns 0 once the walk is queued; it completes in the background.
+ */
+int ioctl_dir_prefetch(struct file *filp, int __user *argp)
+{
+	struct dentry *dentry = filp->f_path.dentry;
+	struct prefetch_req *req;
+	int depth;
+
+	if (!S_ISDIR(dentry->d_inode->i_mode))
+		return -ENOTDIR;
+	if (!prefetch_wq)
+		return -ENOTTY;
+	if (get_user(depth, argp))
+		return -EFAULT;
+	if (depth < 0)
+		return -EINVAL;
+	if (!depth)
+		depth = PREFETCH_DEFAULT_DEPTH;
+	depth = min(depth, PREFETCH_MAX_DEPTH);
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	req->dirent = (char *)__get_free_page(GFP_KERNEL);
+	if (!req->dirent) {
+		kfree(req);
+		return -ENOMEM;
+	}
+	INIT_LIST_HEAD(&req->dirs);
+	INIT_WORK(&req->work, prefetch_work);
+	req->cred = get_current_cred();
+
+	prefetch_queue_dir(req, filp->f_path.mnt, dget(dentry), depth);
+	if (list_empty(&req->dirs)) {
+		put_cred(req->cred);
+		free_page((unsigned long)req->dirent);
+		kfree(req);
+		return -ENOMEM;
+	}
+
+	queue_work(prefetch_wq, &req->work);
+	return 0;
+}
+
+static int __init dir_prefetch_init(void)
+{
+	prefetch_wq = create_singlethread_workqueue("dir_prefetch");
+	return prefetch_wq ? 0 : -ENOMEM;
+}
+fs_initcall(dir_prefetch_init);
@@ -33,6 +33,8 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -86,6 +88,9 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Longest wakeup coalescing window accepted by EPOLL_CTL_COALESCE, in usecs */
+#define EP_MAX_COALESCE_US 100000
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -184,6 +189,15 @@ struct eventpoll {
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
+
+	/*
+	 * Wakeup coalescing window set by EPOLL_CTL_COALESCE (zero means
+	 * every ready event wakes the waiters right away), the time of the
+	 * last wakeup of "wq", and the timer that delivers a deferred one.
+	 */
+	u64 coalesce_ns;
+	ktime_t last_wake;
+	struct hrtimer coalesce_timer;
 };
 
 /* Wait structure used by the poll hooks */
@@ -609,6 +623,7 @@ static void ep_free(struct eventpoll *ep)
 	}
 
 	mutex_unlock(&epmutex);
+	hrtimer_cancel(&ep->coalesce_timer);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	kfree(ep);
@@ -722,6 +737,49 @@ void eventpoll_release_file(struct file *file)
 	mutex_unlock(&epmutex);
 }
 
+/*
+ * Fires at the end of a coalescing window and wakes the sys_epoll_wait()
+ * waiters with whatever piled up on the ready list meanwhile.
+ */
+static enum hrtimer_restart ep_coalesce_timer_fn(struct hrtimer *timer)
+{
+	unsigned long flags;
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    coalesce_timer);
+
+	spin_lock_irqsave(&ep->lock, flags);
+	ep->last_wake = ktime_get();
+	if (waitqueue_active(&ep->wq) && !list_empty(&ep->rdllist))
+		wake_up_locked(&ep->wq);
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Wakes up the sys_epoll_wait() waiters, honouring the coalescing window.
+ * The first event after a quiet period goes out immediately; events that
+ * follow within the window are batched into one wakeup when it expires.
+ * Must be called with "ep->lock" held.
+ */
+static void ep_wake_locked(struct eventpoll *ep)
+{
+	ktime_t now, expires;
+
+	if (!ep->coalesce_ns) {
+		wake_up_locked(&ep->wq);
+		return;
+	}
+
+	now = ktime_get();
+	expires = ktime_add_ns(ep->last_wake, ep->coalesce_ns);
+	if (ktime_to_ns(ktime_sub(now, ep->last_wake)) >= ep->coalesce_ns) {
+		ep->last_wake = now;
+		wake_up_locked(&ep->wq);
+	} else if (!hrtimer_active(&ep->coalesce_timer))
+		hrtimer_start(&ep->coalesce_timer, expires, HRTIMER_MODE_ABS);
+}
+
 static int ep_alloc(struct eventpoll **pep)
 {
 	int error;
@@ -742,6 +800,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ep->coalesce_timer.function = ep_coalesce_timer_fn;
 
 	*pep = ep;
 
@@ -836,7 +896,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * wait list.
 	 */
 	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+		ep_wake_locked(ep);
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -1220,6 +1280,39 @@ SYSCALL_DEFINE1(epoll_create, int, size)
 	return sys_epoll_create1(0);
 }
 
+/*
+ * EPOLL_CTL_COALESCE: sets the wakeup coalescing window of the epoll
+ * instance "epfd" to "usecs" microseconds, zero turning it off again.
+ */
+static int ep_ctl_coalesce(int epfd, u64 usecs)
+{
+	int error;
+	struct file *file;
+	struct eventpoll *ep;
+	unsigned long flags;
+
+	if (usecs > EP_MAX_COALESCE_US)
+		return -EINVAL;
+
+	file = fget(epfd);
+	if (!file)
+		return -EBADF;
+
+	error = -EINVAL;
+	if (!is_file_epoll(file))
+		goto out_fput;
+
+	ep = file->private_data;
+	spin_lock_irqsave(&ep->lock, flags);
+	ep->coalesce_ns = usecs * NSEC_PER_USEC;
+	spin_unlock_irqrestore(&ep->lock, flags);
+	error = 0;
+
+out_fput:
+	fput(file);
+	return error;
+}
+
 /*
  * The following function implements the controller interface for
  * the eventpoll file that enables the insertion/removal/change of
@@ -1239,6 +1332,9 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	    copy_from_user(&epds, event, sizeof(struct epoll_event)))
 		goto error_return;
 
+	if (op == EPOLL_CTL_COALESCE)
+		return ep_ctl_coalesce(epfd, epds.data);
+
 	/* Get the "struct file *" for the eventpoll file */
 	error = -EBADF;
 	file = fget(epfd);
@@ -105,6 +105,8 @@ typedef unsigned int ext4_group_t;
 #define EXT4_MB_DELALLOC_RESERVED	0x0400
 /* We are doing stream allocation */
 #define EXT4_MB_STREAM_ALLOC		0x0800
+/* sequential appender: own goal, window sized preallocation */
+#define EXT4_MB_HINT_STREAM		0x1000
 
 
 struct ext4_allocation_request {
@@ -512,6 +514,8 @@ struct ext4_new_group_data {
  /* note ioctl 11 reserved for filesystem-independent FIEMAP ioctl */
 #define EXT4_IOC_ALLOC_DA_BLKS		_IO('f', 12)
 #define EXT4_IOC_MOVE_EXT		_IOWR('f', 15, struct move_extent)
+#define EXT4_IOC_SET_STREAM		_IOW('f', 20, int)
+#define EXT4_IOC_GET_EXTENT_STATS	_IOR('f', 21, struct ext4_extent_stats)
 
 #if defined(__KERNEL__) && defined(CONFIG_COMPAT)
 /*
@@ -622,6 +626,22 @@ struct move_extent {
 	__u64 moved_len;	/* moved block length */
 };
 
+/*
+ * EXT4_IOC_GET_EXTENT_STATS: allocated blocks of a file, the extents
+ * holding them and the physically contiguous runs those extents form.
+ * Delayed allocation blocks are not counted until written back.
+ */
+#define EXT4_EXTENT_STATS_HINT		0x0001	/* EXT4_IOC_SET_STREAM */
+#define EXT4_EXTENT_STATS_STREAM	0x0002	/* detected appender */
+
+struct ext4_extent_stats {
+	__u32 extents;
+	__u32 fragments;
+	__u64 blocks;
+	__u32 flags;		/* EXT4_EXTENT_STATS_* */
+	__u32 reserved;
+};
+
 #define EXT4_EPOCH_BITS 2
 #define EXT4_EPOCH_MASK ((1 << EXT4_EPOCH_BITS) - 1)
 #define EXT4_NSEC_MASK  (~0UL << EXT4_EPOCH_BITS)
@@ -804,6 +824,10 @@ struct ext4_inode_info {
 	struct list_head i_prealloc_list;
 	spinlock_t i_prealloc_lock;
 
+	/* stream detection, under i_data_sem */
+	ext4_lblk_t	i_stream_next;		/* where an appender continues */
+	unsigned int	i_stream_hits;
+
 	/* ialloc */
 	ext4_group_t	i_last_alloc_group;
 
@@ -881,6 +905,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_FLASH		0x4000000 /* Tune for flash storage */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1110,6 +1135,7 @@ struct ext4_sb_info {
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
 	unsigned int s_max_writeback_mb_bump;
+	unsigned int s_mb_stream_window;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
 	unsigned long s_mb_last_start;
@@ -1130,6 +1156,8 @@ struct ext4_sb_info {
 	atomic_t s_mb_preallocated;
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
+	atomic_t s_mb_streams;		/* appenders detected */
+	atomic_t s_mb_stream_allocs;	/* window sized requests */
 
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
@@ -1181,6 +1209,8 @@ enum {
 	EXT4_STATE_EXT_MIGRATE,		/* Inode is migrating */
 	EXT4_STATE_DIO_UNWRITTEN,	/* need convert on dio done*/
 	EXT4_STATE_NEWENTRY,		/* File just added to dir */
+	EXT4_STATE_STREAM_HINT,		/* EXT4_IOC_SET_STREAM */
+	EXT4_STATE_STREAM,		/* sequential appender detected */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field)					\
@@ -1320,6 +1350,12 @@ EXT4_INODE_BIT_FNS(state, state_flags)
 #define EXT4_DEF_MIN_BATCH_TIME	0
 #define EXT4_DEF_MAX_BATCH_TIME	15000 /* 15ms */
 
+/*
+ * With the flash mount option, a transaction that sees little metadata
+ * traffic may stay open for this many commit intervals.
+ */
+#define EXT4_FLASH_COMMIT_FACTOR	6
+
 /*
  * Minimum number of groups in a flexgroup before we separate out
  * directories into the first block group of a flexgroup
@@ -1558,6 +1594,7 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern int ext4_mb_get_buddy_cache_lock(struct super_block *, ext4_group_t);
 extern void ext4_mb_put_buddy_cache_lock(struct super_block *,
 						ext4_group_t, int);
+extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
 /* inode.c */
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
 						ext4_lblk_t, int, int *);
@@ -1910,6 +1947,8 @@ extern int ext4_get_blocks(handle_t *handle, struct inode *inode,
 			   struct buffer_head *bh, int flags);
 extern int ext4_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 			__u64 start, __u64 len);
+extern int ext4_ext_extent_stats(struct inode *inode,
+				 struct ext4_extent_stats *stats);
 /* move_extent.c */
 extern int ext4_move_extents(struct file *o_filp, struct file *d_filp,
 			     __u64 start_orig, __u64 start_donor,
@@ -3892,6 +3892,56 @@ static int ext4_ext_fiemap_cb(struct inode *inode, struct ext4_ext_path *path,
 	return EXT_CONTINUE;
 }
 
+/*
+ * Callback for ext4_ext_extent_stats(): extents are walked in logical
+ * order, a fragment starts wherever one doesn't follow the previous
+ * physically.
+ */
+struct ext4_ext_stats_walk {
+	struct ext4_extent_stats stats;
+	ext4_fsblk_t next;		/* block after the previous extent */
+};
+
+static int ext4_ext_stats_cb(struct inode *inode, struct ext4_ext_path *path,
+			     struct ext4_ext_cache *newex,
+			     struct ext4_extent *ex, void *data)
+{
+	struct ext4_ext_stats_walk *walk = data;
+
+	if (newex->ec_type != EXT4_EXT_CACHE_EXTENT)
+		return EXT_CONTINUE;
+
+	if (!walk->stats.extents || newex->ec_start != walk->next)
+		walk->stats.fragments++;
+	walk->stats.extents++;
+	walk->stats.blocks += newex->ec_len;
+	walk->next = newex->ec_start + newex->ec_len;
+
+	return EXT_CONTINUE;
+}
+
+int ext4_ext_extent_stats(struct inode *inode, struct ext4_extent_stats *stats)
+{
+	struct ext4_ext_stats_walk walk;
+	int err;
+
+	if (!(ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)))
+		return -EOPNOTSUPP;
+
+	memset(&walk, 0, sizeof(walk));
+	err = ext4_ext_walk_space(inode, 0, EXT_MAX_BLOCK,
+				  ext4_ext_stats_cb, &walk);
+	if (err)
+		return err;
+
+	*stats = walk.stats;
+	if (ext4_test_inode_state(inode, EXT4_STATE_STREAM_HINT))
+		stats->flags |= EXT4_EXTENT_STATS_HINT;
+	if (ext4_test_inode_state(inode, EXT4_STATE_STREAM))
+		stats->flags |= EXT4_EXTENT_STATS_STREAM;
+	return 0;
+}
+
 /* fiemap flags we can handle specified here */
 #define EXT4_FIEMAP_FLAGS	(FIEMAP_FLAG_SYNC|FIEMAP_FLAG_XATTR)
 
@@ -14,6 +14,7 @@
 #include <linux/compat.h>
 #include <linux/mount.h>
 #include <linux/file.h>
+#include <linux/blkdev.h>
 #include <asm/uaccess.h>
 #include "ext4_jbd2.h"
 #include "ext4.h"
@@ -331,6 +332,65 @@ mext_out:
 		return err;
 	}
 
+	case EXT4_IOC_SET_STREAM:
+	{
+		int stream;
+
+		if (!(filp->f_mode & FMODE_WRITE))
+			return -EBADF;
+		if (!S_ISREG(inode->i_mode))
+			return -EINVAL;
+		if (get_user(stream, (int __user *)arg))
+			return -EFAULT;
+
+		if (stream)
+			ext4_set_inode_state(inode, EXT4_STATE_STREAM_HINT);
+		else
+			ext4_clear_inode_state(inode, EXT4_STATE_STREAM_HINT);
+		return 0;
+	}
+
+	case EXT4_IOC_GET_EXTENT_STATS:
+	{
+		struct ext4_extent_stats stats;
+		int err;
+
+		err = ext4_ext_extent_stats(inode, &stats);
+		if (err)
+			return err;
+		if (copy_to_user((struct ext4_extent_stats __user *)arg,
+				 &stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	}
+
+	case FITRIM:
+	{
+		struct super_block *sb = inode->i_sb;
+		struct fstrim_range range;
+		int ret;
+
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+
+		if (!blk_queue_discard(bdev_get_queue(sb->s_bdev)))
+			return -EOPNOTSUPP;
+
+		if (copy_from_user(&range, (struct fstrim_range __user *)arg,
+				   sizeof(range)))
+			return -EFAULT;
+
+		ret = ext4_trim_fs(sb, &range);
+		if (ret < 0)
+			return ret;
+
+		if (copy_to_user((struct fstrim_range __user *)arg, &range,
+				 sizeof(range)))
+			return -EFAULT;
+
+		return 0;
+	}
+
 	default:
 		return -ENOTTY;
 	}
@@ -397,6 +457,8 @@ long ext4_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		return err;
 	}
 	case EXT4_IOC_MOVE_EXT:
+	case EXT4_IOC_SET_STREAM:
+	case EXT4_IOC_GET_EXTENT_STATS:
 		break;
 	default:
 		return -ENOIOCTLCMD;
@@ -63,6 +63,15 @@
  * The main motivation for having small file use group preallocation is to
  * ensure that we have small files closer together on the disk.
  *
+ * Files written sequentially in small pieces, several at a time (parallel
+ * downloads), would interleave in the locality group and then follow one
+ * shared stream goal.  A file set with EXT4_IOC_SET_STREAM, or seen to
+ * allocate where its previous allocation ended MB_STREAM_DETECT times in
+ * a row, instead always uses inode preallocation of at least
+ * /sys/fs/ext4/<partition>/mb_stream_window blocks, aligned to the
+ * window, with the goal next to its own last extent.  A window of 0
+ * turns this off.
+ *
  * First stage the allocator looks at the inode prealloc list,
  * ext4_inode_info->i_prealloc_list, which contains list of prealloc
  * spaces for this particular inode. The inode prealloc space is
@@ -1512,7 +1521,8 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	ac->alloc_semp =  e4b->alloc_semp;
 	e4b->alloc_semp = NULL;
 	/* store last allocated for subsequent stream allocation */
-	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
+	if ((ac->ac_flags & EXT4_MB_STREAM_ALLOC) &&
+	    !(ac->ac_flags & EXT4_MB_HINT_STREAM)) {
 		spin_lock(&sbi->s_md_lock);
 		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
 		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
@@ -2044,7 +2054,8 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	bsbits = ac->ac_sb->s_blocksize_bits;
 
 	/* if stream allocation is enabled, use global goal */
-	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
+	if ((ac->ac_flags & EXT4_MB_STREAM_ALLOC) &&
+	    !(ac->ac_flags & EXT4_MB_HINT_STREAM)) {
 		/* TBD: may be hot point */
 		spin_lock(&sbi->s_md_lock);
 		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
@@ -2456,6 +2467,7 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_stream_window = MB_DEFAULT_STREAM_WINDOW >> sb->s_blocksize_bits;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2624,6 +2636,163 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
+/*
+ * Discard one free extent of a group.  The extent is marked used in the
+ * buddy while the discard is in flight, so that the allocator cannot hand
+ * it out, and the group lock is dropped around the discard itself.
+ */
+static void ext4_trim_extent(struct super_block *sb, int start, int count,
+			     ext4_group_t group, struct ext4_buddy *e4b)
+{
+	struct ext4_free_extent ex;
+	ext4_fsblk_t discard_block;
+
+	assert_spin_locked(ext4_group_lock_ptr(sb, group));
+
+	ex.fe_start = start;
+	ex.fe_group = group;
+	ex.fe_len = count;
+
+	mb_mark_used(e4b, &ex);
+	ext4_unlock_group(sb, group);
+
+	discard_block = ext4_group_first_block_no(sb, group) + start;
+	trace_ext4_discard_blocks(sb, (unsigned long long)discard_block,
+				  count);
+	sb_issue_discard(sb, discard_block, count);
+
+	ext4_lock_group(sb, group);
+	mb_free_blocks(NULL, e4b, start, ex.fe_len);
+}
+
+/*
+ * Discard every free extent of at least minblocks blocks in
+ * [start, max) of a group.  Blocks freed by a transaction that has not
+ * committed yet are still marked used in the buddy, so they are left
+ * alone.  Returns the number of blocks discarded.
+ */
+static ext4_grpblk_t ext4_trim_all_free(struct super_block *sb,
+					struct ext4_buddy *e4b,
+					ext4_grpblk_t start, ext4_grpblk_t max,
+					ext4_grpblk_t minblocks)
+{
+	ext4_group_t group = e4b->bd_group;
+	void *bitmap = e4b->bd_bitmap;
+	ext4_grpblk_t next, count = 0;
+
+	ext4_lock_group(sb, group);
+	if (start < e4b->bd_info->bb_first_free)
+		start = e4b->bd_info->bb_first_free;
+
+	while (start < max) {
+		start = mb_find_next_zero_bit(bitmap, max, start);
+		if (start >= max)
+			break;
+		next = mb_find_next_bit(bitmap, max, start);
+
+		if (next - start >= minblocks) {
+			ext4_trim_extent(sb, start, next - start, group, e4b);
+			count += next - start;
+		}
+		start = next + 1;
+
+		if (fatal_signal_pending(current)) {
+			count = -ERESTARTSYS;
+			break;
+		}
+
+		if (need_resched()) {
+			ext4_unlock_group(sb, group);
+			cond_resched();
+			ext4_lock_group(sb, group);
+		}
+
+		if (e4b->bd_info->bb_free < minblocks)
+			break;
+	}
+	ext4_unlock_group(sb, group);
+
+	return count;
+}
+
+/**
+ * ext4_trim_fs() -- discard the free space of a file system, for FITRIM
+ * @sb:		file system
+ * @range:	byte range to trim and minimum extent length; on return
+ *		range->len is the number of bytes discarded
+ *
+ * This lets a file system mounted without -o discard trim its free
+ * space in one batch, at a convenient time, instead of issuing a
+ * discard for every extent freed by each transaction commit.
+ */
+int ext4_trim_fs(struct super_block *sb, struct fstrim_range *range)
+{
+	struct ext4_buddy e4b;
+	ext4_group_t group, first_group, last_group;
+	ext4_grpblk_t first_block, last_block, cnt;
+	ext4_fsblk_t start, end, blocks_count, first_data_block;
+	ext4_grpblk_t minlen;
+	u64 len, trimmed = 0;
+	int ret = 0;
+
+	blocks_count = ext4_blocks_count(EXT4_SB(sb)->s_es);
+	first_data_block = le32_to_cpu(EXT4_SB(sb)->s_es->s_first_data_block);
+
+	if (range->minlen >> sb->s_blocksize_bits > EXT4_BLOCKS_PER_GROUP(sb))
+		return -EINVAL;
+	minlen = range->minlen >> sb->s_blocksize_bits;
+	if (!minlen)
+		minlen = 1;
+
+	start = range->start >> sb->s_blocksize_bits;
+	len = range->len >> sb->s_blocksize_bits;
+	if (start >= blocks_count) {
+		range->len = 0;
+		return 0;
+	}
+	end = len > blocks_count - start ? blocks_count : start + len;
+	if (start < first_data_block)
+		start = first_data_block;
+	if (start >= end) {
+		range->len = 0;
+		return 0;
+	}
+
+	ext4_get_group_no_and_offset(sb, start, &first_group, &first_block);
+	ext4_get_group_no_and_offset(sb, end - 1, &last_group, &last_block);
+	last_block++;
+
+	for (group = first_group; group <= last_group; group++) {
+		ext4_grpblk_t max = EXT4_BLOCKS_PER_GROUP(sb);
+
+		if (group == last_group)
+			max = last_block;
+
+		ret = ext4_mb_load_buddy(sb, group, &e4b);
+		if (ret) {
+			ext4_error(sb, "Error in loading buddy "
+				   "information for %u", group);
+			break;
+		}
+
+		cnt = 0;
+		if (e4b.bd_info->bb_free >= minlen)
+			cnt = ext4_trim_all_free(sb, &e4b, first_block, max,
+						 minlen);
+		ext4_mb_unload_buddy(&e4b);
+		if (cnt < 0) {
+			ret = cnt;
+			break;
+		}
+
+		trimmed += cnt;
+		first_block = 0;
+	}
+
+	range->len = trimmed << sb->s_blocksize_bits;
+	return ret;
+}
+
 #ifdef CONFIG_EXT4_DEBUG
 u8 mb_enable_debug __read_mostly;
 
@@ -2925,6 +3094,23 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	orig_size = size = size >> bsbits;
 	orig_start = start = start_off >> bsbits;
 
+	/* appenders reserve at least a window, aligned to it */
+	if (ac->ac_flags & EXT4_MB_HINT_STREAM) {
+		struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+		ext4_lblk_t window, wstart;
+
+		window = min_t(ext4_lblk_t, sbi->s_mb_stream_window,
+			       EXT4_BLOCKS_PER_GROUP(ac->ac_sb));
+		wstart = ac->ac_o_ex.fe_logical -
+			 ac->ac_o_ex.fe_logical % window;
+		if (size < window && wstart + window >=
+		    ac->ac_o_ex.fe_logical + ac->ac_o_ex.fe_len) {
+			start = wstart;
+			size = window;
+			atomic_inc(&sbi->s_mb_stream_allocs);
+		}
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -3944,6 +4130,39 @@ static inline void ext4_mb_show_ac(struct ext4_allocation_context *ac)
 }
 #endif
 
+/*
+ * Track whether the file keeps allocating where it last ended.  Returns 1
+ * for an appender, detected or hinted, with the request flagged for its
+ * own stream allocation.  Callers hold i_data_sem.
+ */
+static int ext4_mb_stream_detect(struct ext4_allocation_context *ac)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct inode *inode = ac->ac_inode;
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	if (!sbi->s_mb_stream_window)
+		return 0;
+
+	if (ac->ac_o_ex.fe_logical == ei->i_stream_next) {
+		if (ei->i_stream_hits < MB_STREAM_DETECT &&
+		    ++ei->i_stream_hits == MB_STREAM_DETECT) {
+			ext4_set_inode_state(inode, EXT4_STATE_STREAM);
+			atomic_inc(&sbi->s_mb_streams);
+		}
+	} else {
+		ei->i_stream_hits = 0;
+		ext4_clear_inode_state(inode, EXT4_STATE_STREAM);
+	}
+
+	if (!ext4_test_inode_state(inode, EXT4_STATE_STREAM) &&
+	    !ext4_test_inode_state(inode, EXT4_STATE_STREAM_HINT))
+		return 0;
+
+	ac->ac_flags |= EXT4_MB_STREAM_ALLOC | EXT4_MB_HINT_STREAM;
+	return 1;
+}
+
 /*
  * We use locality group preallocation for small size file. The size of the
  * file is determined by the current size or the resulting size after
@@ -3974,6 +4193,10 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 		return;
 	}
 
+	/* nor for appenders, whatever their size */
+	if (ext4_mb_stream_detect(ac))
+		return;
+
 	/* don't use group allocation for large files */
 	size = max(size, isize);
 	if (size > sbi->s_mb_stream_request) {
@@ -4352,6 +4575,9 @@ repeat:
 		} else {
 			block = ext4_grp_offs_to_block(sb, &ac->ac_b_ex);
 			ar->len = ac->ac_b_ex.fe_len;
+			if (ar->flags & EXT4_MB_HINT_DATA)
+				EXT4_I(ar->inode)->i_stream_next =
+					ar->logical + ar->len;
 		}
 	} else {
 		freed  = ext4_mb_discard_preallocations(sb, ac->ac_o_ex.fe_len);
@@ -94,6 +94,15 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * a file allocated for at the block where its last allocation ended
+ * this many times in a row is a sequential appender, and gets window
+ * sized (bytes, tunable in blocks through mb_stream_window) file
+ * preallocation near its own last extent
+ */
+#define MB_STREAM_DETECT		3
+#define MB_DEFAULT_STREAM_WINDOW	(2 << 20)
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
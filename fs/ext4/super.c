@@ -752,6 +752,8 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	 * jinode.
 	 */
 	jbd2_journal_init_jbd_inode(&ei->jinode, &ei->vfs_inode);
+	ei->i_stream_next = 0;
+	ei->i_stream_hits = 0;
 	ei->i_reserved_data_blocks = 0;
 	ei->i_reserved_meta_blocks = 0;
 	ei->i_allocated_meta_blocks = 0;
@@ -986,6 +988,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DIOREAD_NOLOCK))
 		seq_puts(seq, ",dioread_nolock");
 
+	if (test_opt(sb, FLASH))
+		seq_puts(seq, ",flash");
+
 	ext4_show_quota_options(seq, sb);
 
 	return 0;
@@ -1150,6 +1155,7 @@ enum {
 	Opt_commit, Opt_min_batch_time, Opt_max_batch_time,
 	Opt_journal_update, Opt_journal_dev,
 	Opt_journal_checksum, Opt_journal_async_commit,
+	Opt_nojournal_async_commit,
 	Opt_abort, Opt_data_journal, Opt_data_ordered, Opt_data_writeback,
 	Opt_data_err_abort, Opt_data_err_ignore,
 	Opt_usrjquota, Opt_grpjquota, Opt_offusrjquota, Opt_offgrpjquota,
@@ -1160,7 +1166,7 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
-	Opt_discard, Opt_nodiscard,
+	Opt_discard, Opt_nodiscard, Opt_flash, Opt_noflash,
 };
 
 static const match_table_t tokens = {
@@ -1195,6 +1201,7 @@ static const match_table_t tokens = {
 	{Opt_journal_dev, "journal_dev=%u"},
 	{Opt_journal_checksum, "journal_checksum"},
 	{Opt_journal_async_commit, "journal_async_commit"},
+	{Opt_nojournal_async_commit, "nojournal_async_commit"},
 	{Opt_abort, "abort"},
 	{Opt_data_journal, "data=journal"},
 	{Opt_data_ordered, "data=ordered"},
@@ -1231,6 +1238,8 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_flash, "flash"},
+	{Opt_noflash, "noflash"},
 	{Opt_err, NULL},
 };
 
@@ -1464,6 +1473,9 @@ static int parse_options(char *options, struct super_block *sb,
 			set_opt(sbi->s_mount_opt, JOURNAL_ASYNC_COMMIT);
 			set_opt(sbi->s_mount_opt, JOURNAL_CHECKSUM);
 			break;
+		case Opt_nojournal_async_commit:
+			clear_opt(sbi->s_mount_opt, JOURNAL_ASYNC_COMMIT);
+			break;
 		case Opt_noload:
 			set_opt(sbi->s_mount_opt, NOLOAD);
 			break;
@@ -1699,6 +1711,12 @@ set_qf_format:
 		case Opt_dioread_lock:
 			clear_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
+		case Opt_flash:
+			set_opt(sbi->s_mount_opt, FLASH);
+			break;
+		case Opt_noflash:
+			clear_opt(sbi->s_mount_opt, FLASH);
+			break;
 		default:
 			ext4_msg(sb, KERN_ERR,
 			       "Unrecognized mount option \"%s\" "
@@ -2213,6 +2231,24 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return 0;
 }
 
+/*
+ * With the flash mount option and no stripe configured, align allocations
+ * to the erase unit the device reports as its optimal I/O size, as long
+ * as that fits in a block group.
+ */
+static unsigned long ext4_get_erase_stripe(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned long stripe;
+
+	stripe = queue_io_opt(bdev_get_queue(sb->s_bdev)) >>
+		 sb->s_blocksize_bits;
+	if (stripe <= 1 || stripe > sbi->s_blocks_per_group)
+		return 0;
+
+	return stripe;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2281,6 +2317,14 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t mb_stream_stats_show(struct ext4_attr *a,
+				   struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "streams %u\nwindow_allocs %u\n",
+			atomic_read(&sbi->s_mb_streams),
+			atomic_read(&sbi->s_mb_stream_allocs));
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2321,6 +2365,7 @@ static struct ext4_attr ext4_attr_##name = __ATTR(name, mode, show, store)
 EXT4_RO_ATTR(delayed_allocation_blocks);
 EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
+EXT4_RO_ATTR(mb_stream_stats);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2330,6 +2375,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_stream_window, s_mb_stream_window);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2344,6 +2390,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_stream_window),
+	ATTR_LIST(mb_stream_stats),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -2562,6 +2610,14 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	if (!IS_EXT3_SB(sb))
 		set_opt(sbi->s_mount_opt, DELALLOC);
 
+#ifdef CONFIG_EXT4_DEFAULT_ASYNC_COMMIT
+	/* ext3 can not replay a journal with the async commit feature */
+	if (!IS_EXT3_SB(sb)) {
+		set_opt(sbi->s_mount_opt, JOURNAL_ASYNC_COMMIT);
+		set_opt(sbi->s_mount_opt, JOURNAL_CHECKSUM);
+	}
+#endif
+
 	if (!parse_options((char *) data, sb, &journal_devnum,
 			   &journal_ioprio, NULL, 0))
 		goto failed_mount;
@@ -2800,6 +2856,8 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	spin_lock_init(&sbi->s_next_gen_lock);
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	if (!sbi->s_stripe && test_opt(sb, FLASH))
+		sbi->s_stripe = ext4_get_erase_stripe(sb);
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -3111,6 +3169,11 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	journal->j_max_batch_time = sbi->s_max_batch_time;
 
 	spin_lock(&journal->j_state_lock);
+	if (test_opt(sb, FLASH))
+		journal->j_max_commit_interval =
+			EXT4_FLASH_COMMIT_FACTOR * sbi->s_commit_interval;
+	else
+		journal->j_max_commit_interval = 0;
 	if (test_opt(sb, BARRIER))
 		journal->j_flags |= JBD2_BARRIER;
 	else
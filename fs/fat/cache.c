@@ -16,6 +16,9 @@
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
 
+/* How far fat_bmap() looks ahead for a contiguous run, in clusters */
+#define FAT_MAX_CONTIG	64
+
 struct fat_cache {
 	struct list_head cache_list;
 	int nr_contig;	/* number of contiguous clusters */
@@ -215,7 +218,14 @@ static inline void cache_init(struct fat_cache_id *cid, int fclus, int dclus)
 	cid->nr_contig = 0;
 }
 
-int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
+/*
+ * With @contig set, also report how many clusters starting at *dclus are
+ * contiguous on disk, reading the chain ahead for up to @max_contig of
+ * them.  The run found is kept in the cache, so lookups of the clusters
+ * that follow are satisfied without touching the FAT again.
+ */
+static int __fat_get_cluster(struct inode *inode, int cluster, int *fclus,
+			     int *dclus, int *contig, int max_contig)
 {
 	struct super_block *sb = inode->i_sb;
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
@@ -227,7 +237,9 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 
 	*fclus = 0;
 	*dclus = MSDOS_I(inode)->i_start;
-	if (cluster == 0)
+	if (contig)
+		*contig = 1;
+	if (cluster == 0 && !contig)
 		return 0;
 
 	if (fat_cache_lookup(inode, cluster, &cid, fclus, dclus) < 0) {
@@ -268,6 +280,24 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		if (!cache_contiguous(&cid, *dclus))
 			cache_init(&cid, *fclus, *dclus);
 	}
+
+	if (contig) {
+		int next;
+
+		/* The tracked run ends at or after the target */
+		if (cid.fcluster == -1)
+			cache_init(&cid, *fclus, *dclus);
+		*contig = cid.fcluster + cid.nr_contig - *fclus + 1;
+		next = cid.dcluster + cid.nr_contig;
+		while (*contig < max_contig) {
+			nr = fat_ent_read(inode, &fatent, next);
+			if (nr != next + 1)
+				break;
+			cid.nr_contig++;
+			(*contig)++;
+			next++;
+		}
+	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
 out:
@@ -275,7 +305,13 @@ out:
 	return nr;
 }
 
-static int fat_bmap_cluster(struct inode *inode, int cluster)
+int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
+{
+	return __fat_get_cluster(inode, cluster, fclus, dclus, NULL, 0);
+}
+
+static int fat_bmap_cluster(struct inode *inode, int cluster, int *contig,
+			    int max_contig)
 {
 	struct super_block *sb = inode->i_sb;
 	int ret, fclus, dclus;
@@ -283,7 +319,8 @@ static int fat_bmap_cluster(struct inode *inode, int cluster)
 	if (MSDOS_I(inode)->i_start == 0)
 		return 0;
 
-	ret = fat_get_cluster(inode, cluster, &fclus, &dclus);
+	ret = __fat_get_cluster(inode, cluster, &fclus, &dclus, contig,
+				max_contig);
 	if (ret < 0)
 		return ret;
 	else if (ret == FAT_ENT_EOF) {
@@ -302,7 +339,7 @@ int fat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	const unsigned long blocksize = sb->s_blocksize;
 	const unsigned char blocksize_bits = sb->s_blocksize_bits;
 	sector_t last_block;
-	int cluster, offset;
+	int cluster, offset, contig, max_contig;
 
 	*phys = 0;
 	*mapped_blocks = 0;
@@ -331,12 +368,16 @@ int fat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 
 	cluster = sector >> (sbi->cluster_bits - sb->s_blocksize_bits);
 	offset  = sector & (sbi->sec_per_clus - 1);
-	cluster = fat_bmap_cluster(inode, cluster);
+	/* Clusters up to the last block, so mappings can span whole runs */
+	max_contig = min_t(sector_t, FAT_MAX_CONTIG,
+			   (last_block - sector + offset + sbi->sec_per_clus - 1)
+			   >> (sbi->cluster_bits - blocksize_bits));
+	cluster = fat_bmap_cluster(inode, cluster, &contig, max_contig);
 	if (cluster < 0)
 		return cluster;
 	else if (cluster) {
 		*phys = fat_clus_to_blknr(sbi, cluster) + offset;
-		*mapped_blocks = sbi->sec_per_clus - offset;
+		*mapped_blocks = contig * sbi->sec_per_clus - offset;
 		if (*mapped_blocks > last_block - sector)
 			*mapped_blocks = last_block - sector;
 	}
@@ -18,6 +18,8 @@
 #include <linux/time.h>
 #include <linux/buffer_head.h>
 #include <linux/compat.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 #include <linux/kernel.h>
 #include "fat.h"
@@ -35,6 +37,30 @@
 #define FAT_MAX_UNI_CHARS	((MSDOS_SLOTS - 1) * 13 + 1)
 #define FAT_MAX_UNI_SIZE	(FAT_MAX_UNI_CHARS * sizeof(wchar_t))
 
+/*
+ * Directories at least this large get a name index on their first
+ * lookup, so that later lookups do not scan every entry.
+ */
+#define FAT_DIR_INDEX_MIN	(16 * 1024)
+
+/*
+ * The index holds the hash of every short and long name together with
+ * the offset of the first slot of its entry, sorted by hash.  It is
+ * built by one scan of the directory and dropped whenever an entry is
+ * added or removed.  Callers serialize on lock_super().
+ */
+struct fat_dir_hent {
+	u32 hash;
+	u32 pos;
+};
+
+struct fat_dir_index {
+	unsigned int nr;
+	unsigned int max;
+	int overflow;
+	struct fat_dir_hent ent[0];
+};
+
 static inline loff_t fat_make_i_pos(struct super_block *sb,
 				    struct buffer_head *bh,
 				    struct msdos_dir_entry *de)
@@ -332,12 +358,48 @@ parse_long:
 	return 0;
 }
 
+/* Hash a name so that names fat_name_match() considers equal collide */
+static u32 fat_name_hash(struct msdos_sb_info *sbi, const unsigned char *name,
+			 int len)
+{
+	unsigned long hash = init_name_hash();
+	int i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = name[i];
+
+		if (sbi->options.name_check != 's')
+			c = nls_tolower(sbi->nls_io, c);
+		hash = partial_name_hash(c, hash);
+	}
+	return end_name_hash(hash);
+}
+
+static void fat_dir_index_add(struct msdos_sb_info *sbi,
+			      struct fat_dir_index *index,
+			      const unsigned char *name, int len, loff_t pos)
+{
+	struct fat_dir_hent *ent;
+
+	if (index->nr >= index->max) {
+		index->overflow = 1;
+		return;
+	}
+	ent = &index->ent[index->nr++];
+	ent->hash = fat_name_hash(sbi, name, len);
+	ent->pos = pos;
+}
+
 /*
- * Return values: negative -> error, 0 -> not found, positive -> found,
- * value is the total amount of slots, including the shortname entry.
+ * Scan the entries whose first slot lies in [cpos, end) for @name.  With
+ * @index set, nothing is matched and every name is added to the index
+ * instead.
+ *
+ * Return values: negative -> error, 0 -> found (or index complete).
  */
-int fat_search_long(struct inode *inode, const unsigned char *name,
-		    int name_len, struct fat_slot_info *sinfo)
+static int fat_scan_long(struct inode *inode, const unsigned char *name,
+			 int name_len, struct fat_slot_info *sinfo,
+			 loff_t cpos, loff_t end, struct fat_dir_index *index)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -350,11 +412,14 @@ int fat_search_long(struct inode *inode, const unsigned char *name,
 	unsigned char work[MSDOS_NAME];
 	unsigned char bufname[FAT_MAX_SHORT_SIZE];
 	unsigned short opt_shortname = sbi->options.shortname;
-	loff_t cpos = 0;
 	int chl, i, j, last_u, err, len;
 
 	err = -ENOENT;
 	while (1) {
+		if (cpos >= end) {
+			brelse(bh);
+			goto end_of_dir;
+		}
 		if (fat_get_entry(inode, &cpos, &bh, &de) == -1)
 			goto end_of_dir;
 parse_record:
@@ -420,7 +485,10 @@ parse_record:
 		/* Compare shortname */
 		bufuname[last_u] = 0x0000;
 		len = fat_uni_to_x8(sbi, bufuname, bufname, sizeof(bufname));
-		if (fat_name_match(sbi, name, name_len, bufname, len))
+		if (index)
+			fat_dir_index_add(sbi, index, bufname, len,
+					  cpos - (nr_slots + 1) * sizeof(*de));
+		else if (fat_name_match(sbi, name, name_len, bufname, len))
 			goto found;
 
 		if (nr_slots) {
@@ -429,7 +497,11 @@ parse_record:
 
 			/* Compare longname */
 			len = fat_uni_to_x8(sbi, unicode, longname, size);
-			if (fat_name_match(sbi, name, name_len, longname, len))
+			if (index)
+				fat_dir_index_add(sbi, index, longname, len,
+					cpos - (nr_slots + 1) * sizeof(*de));
+			else if (fat_name_match(sbi, name, name_len,
+						longname, len))
 				goto found;
 		}
 	}
@@ -446,9 +518,99 @@ end_of_dir:
 	if (unicode)
 		__putname(unicode);
 
+	if (index && err == -ENOENT)
+		err = 0;
 	return err;
 }
 
+static int fat_dir_hent_cmp(const void *a, const void *b)
+{
+	const struct fat_dir_hent *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+void fat_dir_index_drop(struct inode *dir)
+{
+	struct msdos_inode_info *ei = MSDOS_I(dir);
+
+	if (ei->i_dir_index) {
+		vfree(ei->i_dir_index);
+		ei->i_dir_index = NULL;
+	}
+}
+
+EXPORT_SYMBOL_GPL(fat_dir_index_drop);
+
+static void fat_dir_index_build(struct inode *dir)
+{
+	struct fat_dir_index *index;
+	unsigned int max;
+
+	/* Every name needs at least one slot of its own */
+	max = dir->i_size / sizeof(struct msdos_dir_entry);
+	index = vmalloc(sizeof(*index) + max * sizeof(index->ent[0]));
+	if (!index)
+		return;
+	index->nr = 0;
+	index->max = max;
+	index->overflow = 0;
+
+	/* A partial index would turn lookups of missing names into misses */
+	if (fat_scan_long(dir, NULL, 0, NULL, 0, dir->i_size, index) ||
+	    index->overflow) {
+		vfree(index);
+		return;
+	}
+	sort(index->ent, index->nr, sizeof(index->ent[0]), fat_dir_hent_cmp,
+	     NULL);
+	MSDOS_I(dir)->i_dir_index = index;
+}
+
+/* Check only the entries whose names hash like @name */
+static int fat_search_index(struct inode *dir, const unsigned char *name,
+			    int name_len, struct fat_slot_info *sinfo)
+{
+	struct fat_dir_index *index = MSDOS_I(dir)->i_dir_index;
+	u32 hash = fat_name_hash(MSDOS_SB(dir->i_sb), name, name_len);
+	unsigned int lo = 0, hi = index->nr;
+	int err;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (index->ent[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < index->nr && index->ent[lo].hash == hash; lo++) {
+		loff_t pos = index->ent[lo].pos;
+
+		err = fat_scan_long(dir, name, name_len, sinfo, pos,
+				    pos + sizeof(struct msdos_dir_entry), NULL);
+		if (err != -ENOENT)
+			return err;
+	}
+	return -ENOENT;
+}
+
+/*
+ * Return values: negative -> error, 0 -> found.
+ */
+int fat_search_long(struct inode *inode, const unsigned char *name,
+		    int name_len, struct fat_slot_info *sinfo)
+{
+	if (!MSDOS_I(inode)->i_dir_index && inode->i_size >= FAT_DIR_INDEX_MIN)
+		fat_dir_index_build(inode);
+	if (MSDOS_I(inode)->i_dir_index)
+		return fat_search_index(inode, name, name_len, sinfo);
+
+	return fat_scan_long(inode, name, name_len, sinfo, 0, LLONG_MAX, NULL);
+}
+
 EXPORT_SYMBOL_GPL(fat_search_long);
 
 struct fat_ioctl_filldir_callback {
@@ -461,8 +623,33 @@ struct fat_ioctl_filldir_callback {
 	int short_len;
 };
 
+/*
+ * The attributes for ->readdir_plus(): those of the inode if it is in
+ * core, it may be newer than its entry; else those of a regular file's
+ * entry.  A directory's size needs a walk of its cluster chain.
+ */
+static struct dirent_attr *fat_dirent_attr(struct msdos_sb_info *sbi,
+					   struct msdos_dir_entry *de,
+					   struct inode *inode,
+					   struct dirent_attr *attr)
+{
+	if (inode) {
+		attr->size = i_size_read(inode);
+		attr->mtime = inode->i_mtime;
+		attr->mode = inode->i_mode;
+	} else if (!(de->attr & ATTR_DIR)) {
+		attr->size = le32_to_cpu(de->size);
+		fat_time_fat2unix(sbi, &attr->mtime, de->time, de->date, 0);
+		attr->mode = fat_file_mode(sbi, de);
+	} else
+		return NULL;
+	return attr;
+}
+
+/* One of @filldir and @filldirplus is set. */
 static int __fat_readdir(struct inode *inode, struct file *filp, void *dirent,
-			 filldir_t filldir, int short_only, int both)
+			 filldir_t filldir, filldirplus_t filldirplus,
+			 int short_only, int both)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -480,9 +667,11 @@ static int __fat_readdir(struct inode *inode, struct file *filp, void *dirent,
 	const char *fill_name = NULL;
 	unsigned long inum;
 	unsigned long lpos, dummy, *furrfu = &lpos;
+	struct inode *tmp;
+	struct dirent_attr attr;
 	loff_t cpos;
 	int chi, chl, i, i2, j, last, last_u, dotoffset = 0, fill_len = 0;
-	int ret = 0;
+	int ret = 0, err;
 
 	lock_super(sb);
 
@@ -490,7 +679,13 @@ static int __fat_readdir(struct inode *inode, struct file *filp, void *dirent,
 	/* Fake . and .. for the root directory. */
 	if (inode->i_ino == MSDOS_ROOT_INO) {
 		while (cpos < 2) {
-			if (filldir(dirent, "..", cpos+1, cpos, MSDOS_ROOT_INO, DT_DIR) < 0)
+			if (filldirplus)
+				err = filldirplus(dirent, "..", cpos+1, cpos,
+						  MSDOS_ROOT_INO, DT_DIR, NULL);
+			else
+				err = filldir(dirent, "..", cpos+1, cpos,
+					      MSDOS_ROOT_INO, DT_DIR);
+			if (err < 0)
 				goto out;
 			cpos++;
 			filp->f_pos++;
@@ -640,22 +835,30 @@ parse_record:
 
 start_filldir:
 	lpos = cpos - (nr_slots + 1) * sizeof(struct msdos_dir_entry);
+	tmp = NULL;
 	if (!memcmp(de->name, MSDOS_DOT, MSDOS_NAME))
 		inum = inode->i_ino;
 	else if (!memcmp(de->name, MSDOS_DOTDOT, MSDOS_NAME)) {
 		inum = parent_ino(filp->f_path.dentry);
 	} else {
 		loff_t i_pos = fat_make_i_pos(sb, bh, de);
-		struct inode *tmp = fat_iget(sb, i_pos);
-		if (tmp) {
+		tmp = fat_iget(sb, i_pos);
+		if (tmp)
 			inum = tmp->i_ino;
-			iput(tmp);
-		} else
+		else
 			inum = iunique(sb, MSDOS_ROOT_INO);
 	}
 
-	if (filldir(dirent, fill_name, fill_len, *furrfu, inum,
-		    (de->attr & ATTR_DIR) ? DT_DIR : DT_REG) < 0)
+	if (filldirplus)
+		err = filldirplus(dirent, fill_name, fill_len, *furrfu, inum,
+				  (de->attr & ATTR_DIR) ? DT_DIR : DT_REG,
+				  fat_dirent_attr(sbi, de, tmp, &attr));
+	else
+		err = filldir(dirent, fill_name, fill_len, *furrfu, inum,
+			      (de->attr & ATTR_DIR) ? DT_DIR : DT_REG);
+	if (tmp)
+		iput(tmp);
+	if (err < 0)
 		goto fill_failed;
 
 record_end:
@@ -676,7 +879,14 @@ out:
 static int fat_readdir(struct file *filp, void *dirent, filldir_t filldir)
 {
 	struct inode *inode = filp->f_path.dentry->d_inode;
-	return __fat_readdir(inode, filp, dirent, filldir, 0, 0);
+	return __fat_readdir(inode, filp, dirent, filldir, NULL, 0, 0);
+}
+
+static int fat_readdir_plus(struct file *filp, void *dirent,
+			    filldirplus_t filldirplus)
+{
+	struct inode *inode = filp->f_path.dentry->d_inode;
+	return __fat_readdir(inode, filp, dirent, NULL, filldirplus, 0, 0);
 }
 
 #define FAT_IOCTL_FILLDIR_FUNC(func, dirent_type)			   \
@@ -744,7 +954,7 @@ static int fat_ioctl_readdir(struct inode *inode, struct file *filp,
 	mutex_lock(&inode->i_mutex);
 	ret = -ENOENT;
 	if (!IS_DEADDIR(inode)) {
-		ret = __fat_readdir(inode, filp, &buf, filldir,
+		ret = __fat_readdir(inode, filp, &buf, filldir, NULL,
 				    short_only, both);
 	}
 	mutex_unlock(&inode->i_mutex);
@@ -832,6 +1042,7 @@ const struct file_operations fat_dir_operations = {
 	.llseek		= generic_file_llseek,
 	.read		= generic_read_dir,
 	.readdir	= fat_readdir,
+	.readdir_plus	= fat_readdir_plus,
 	.unlocked_ioctl	= fat_dir_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl	= fat_compat_dir_ioctl,
@@ -987,6 +1198,8 @@ int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo)
 	 * First stage: Remove the shortname. By this, the directory
 	 * entry is removed.
 	 */
+	fat_dir_index_drop(dir);
+
 	nr_slots = sinfo->nr_slots;
 	de = sinfo->de;
 	sinfo->de = NULL;
@@ -1234,6 +1447,7 @@ int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 	loff_t pos, i_pos;
 
 	sinfo->nr_slots = nr_slots;
+	fat_dir_index_drop(dir);
 
 	/* First stage: search free direcotry entries */
 	free_slots = nr_bhs = 0;
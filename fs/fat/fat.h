@@ -83,6 +83,9 @@ struct msdos_sb_info {
 	struct fatent_operations *fatent_ops;
 	struct inode *fat_inode;
 
+	sector_t fat_ra_next;	     /* FAT block a sequential walk reads next */
+	unsigned int fat_ra_win;     /* current FAT readahead window */
+
 	struct ratelimit_state ratelimit;
 
 	spinlock_t inode_hash_lock;
@@ -94,6 +97,8 @@ struct msdos_sb_info {
 /*
  * MS-DOS file system inode data in memory
  */
+struct fat_dir_index;
+
 struct msdos_inode_info {
 	spinlock_t cache_lru_lock;
 	struct list_head cache_lru;
@@ -109,6 +114,7 @@ struct msdos_inode_info {
 	int i_attrs;		/* unused attribute bits */
 	loff_t i_pos;		/* on-disk position of directory entry or 0 */
 	struct hlist_node i_fat_hash;	/* hash by i_location */
+	struct fat_dir_index *i_dir_index; /* name lookup index, or NULL */
 	struct inode vfs_inode;
 };
 
@@ -250,6 +256,7 @@ extern int fat_alloc_new_dir(struct inode *dir, struct timespec *ts);
 extern int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 			   struct fat_slot_info *sinfo);
 extern int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo);
+extern void fat_dir_index_drop(struct inode *dir);
 
 /* fat/fatent.c */
 struct fat_entry {
@@ -318,6 +325,8 @@ extern void fat_detach(struct inode *inode);
 extern struct inode *fat_iget(struct super_block *sb, loff_t i_pos);
 extern struct inode *fat_build_inode(struct super_block *sb,
 			struct msdos_dir_entry *de, loff_t i_pos);
+extern mode_t fat_file_mode(struct msdos_sb_info *sbi,
+			    struct msdos_dir_entry *de);
 extern int fat_sync_inode(struct inode *inode);
 extern int fat_fill_super(struct super_block *sb, void *data, int silent,
 			const struct inode_operations *fs_dir_inode_ops, int isvfat);
@@ -338,6 +338,46 @@ static inline int fat_ent_update_ptr(struct super_block *sb,
 	return 1;
 }
 
+#define FAT_RA_MIN	4	/* blocks */
+#define FAT_RA_MAX	64
+
+/*
+ * Walking the chain of a large file misses on one FAT block after the
+ * other.  Once two misses in a row hit consecutive blocks, read the
+ * following blocks ahead, doubling the window while the pattern holds.
+ */
+static void fat_ent_chain_reada(struct super_block *sb, sector_t blocknr)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	sector_t fat_end = sbi->fat_start + sbi->fat_length;
+	struct buffer_head *bh;
+	unsigned int win;
+	sector_t blk;
+
+	/* Cached or already being read ahead */
+	bh = sb_find_get_block(sb, blocknr);
+	if (bh) {
+		int busy = buffer_uptodate(bh) || buffer_locked(bh);
+
+		brelse(bh);
+		if (busy)
+			return;
+	}
+
+	if (blocknr != sbi->fat_ra_next) {
+		sbi->fat_ra_win = 0;
+		sbi->fat_ra_next = blocknr + 1;
+		return;
+	}
+
+	win = sbi->fat_ra_win ?
+	      min_t(unsigned int, sbi->fat_ra_win * 2, FAT_RA_MAX) : FAT_RA_MIN;
+	for (blk = blocknr + 1; blk <= blocknr + win && blk < fat_end; blk++)
+		sb_breadahead(sb, blk);
+	sbi->fat_ra_win = win;
+	sbi->fat_ra_next = blocknr + win + 1;
+}
+
 int fat_ent_read(struct inode *inode, struct fat_entry *fatent, int entry)
 {
 	struct super_block *sb = inode->i_sb;
@@ -357,6 +397,7 @@ int fat_ent_read(struct inode *inode, struct fat_entry *fatent, int entry)
 
 	if (!fat_ent_update_ptr(sb, fatent, offset, blocknr)) {
 		fatent_brelse(fatent);
+		fat_ent_chain_reada(sb, blocknr);
 		err = ops->ent_bread(sb, fatent, offset, blocknr);
 		if (err)
 			return err;
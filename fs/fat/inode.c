@@ -336,6 +336,14 @@ static int is_exec(unsigned char *extension)
 	return 0;
 }
 
+/* i_mode of the regular file @de describes */
+mode_t fat_file_mode(struct msdos_sb_info *sbi, struct msdos_dir_entry *de)
+{
+	return fat_make_mode(sbi, de->attr,
+		((sbi->options.showexec && !is_exec(de->name + 8))
+		 ? S_IRUGO|S_IWUGO : S_IRWXUGO));
+}
+
 static int fat_calc_dir_size(struct inode *inode)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
@@ -384,9 +392,7 @@ static int fat_fill_inode(struct inode *inode, struct msdos_dir_entry *de)
 		inode->i_nlink = fat_subdirs(inode);
 	} else { /* not a directory */
 		inode->i_generation |= 1;
-		inode->i_mode = fat_make_mode(sbi, de->attr,
-			((sbi->options.showexec && !is_exec(de->name + 8))
-			 ? S_IRUGO|S_IWUGO : S_IRWXUGO));
+		inode->i_mode = fat_file_mode(sbi, de);
 		MSDOS_I(inode)->i_start = le16_to_cpu(de->start);
 		if (sbi->fat_bits == 32)
 			MSDOS_I(inode)->i_start |= (le16_to_cpu(de->starthi) << 16);
@@ -458,6 +464,7 @@ static void fat_delete_inode(struct inode *inode)
 
 static void fat_clear_inode(struct inode *inode)
 {
+	fat_dir_index_drop(inode);
 	fat_cache_inval_inode(inode);
 	fat_detach(inode);
 }
@@ -534,6 +541,7 @@ static void init_once(void *foo)
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
 	INIT_LIST_HEAD(&ei->cache_lru);
 	INIT_HLIST_NODE(&ei->i_fat_hash);
+	ei->i_dir_index = NULL;
 	inode_init_once(&ei->vfs_inode);
 }
 
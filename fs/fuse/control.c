@@ -10,6 +10,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 
 #define FUSE_CTL_SUPER_MAGIC 0x65735543
 
@@ -176,6 +177,116 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static const char *fuse_opcode_names[FUSE_STATS_NR_OPCODES] = {
+	[FUSE_LOOKUP]		= "lookup",
+	[FUSE_FORGET]		= "forget",
+	[FUSE_GETATTR]		= "getattr",
+	[FUSE_SETATTR]		= "setattr",
+	[FUSE_READLINK]		= "readlink",
+	[FUSE_SYMLINK]		= "symlink",
+	[FUSE_MKNOD]		= "mknod",
+	[FUSE_MKDIR]		= "mkdir",
+	[FUSE_UNLINK]		= "unlink",
+	[FUSE_RMDIR]		= "rmdir",
+	[FUSE_RENAME]		= "rename",
+	[FUSE_LINK]		= "link",
+	[FUSE_OPEN]		= "open",
+	[FUSE_READ]		= "read",
+	[FUSE_WRITE]		= "write",
+	[FUSE_STATFS]		= "statfs",
+	[FUSE_RELEASE]		= "release",
+	[FUSE_FSYNC]		= "fsync",
+	[FUSE_SETXATTR]		= "setxattr",
+	[FUSE_GETXATTR]		= "getxattr",
+	[FUSE_LISTXATTR]	= "listxattr",
+	[FUSE_REMOVEXATTR]	= "removexattr",
+	[FUSE_FLUSH]		= "flush",
+	[FUSE_INIT]		= "init",
+	[FUSE_OPENDIR]		= "opendir",
+	[FUSE_READDIR]		= "readdir",
+	[FUSE_RELEASEDIR]	= "releasedir",
+	[FUSE_FSYNCDIR]		= "fsyncdir",
+	[FUSE_GETLK]		= "getlk",
+	[FUSE_SETLK]		= "setlk",
+	[FUSE_SETLKW]		= "setlkw",
+	[FUSE_ACCESS]		= "access",
+	[FUSE_CREATE]		= "create",
+	[FUSE_BMAP]		= "bmap",
+	[FUSE_DESTROY]		= "destroy",
+	[FUSE_IOCTL]		= "ioctl",
+	[FUSE_POLL]		= "poll",
+	[FUSE_STATS_NR_OPCODES - 1] = "other",
+};
+
+/*
+ * One line per opcode seen so far: name, requests, errors, average and
+ * maximum time in microseconds from queueing to the end of the request.
+ * Writing anything clears the counters.
+ */
+static ssize_t fuse_conn_stats_read(struct file *file, char __user *buf,
+				    size_t len, loff_t *ppos)
+{
+	struct fuse_op_stats *stats;
+	struct fuse_conn *fc;
+	size_t size = 0;
+	ssize_t ret;
+	char *tmp;
+	int i;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	stats = kmalloc(sizeof(fc->stats), GFP_KERNEL);
+	tmp = (char *)__get_free_page(GFP_KERNEL);
+	if (!stats || !tmp) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock(&fc->lock);
+	memcpy(stats, fc->stats, sizeof(fc->stats));
+	spin_unlock(&fc->lock);
+
+	for (i = 0; i < FUSE_STATS_NR_OPCODES; i++) {
+		struct fuse_op_stats *st = &stats[i];
+		u64 avg;
+
+		if (!st->count)
+			continue;
+		avg = st->total_us;
+		do_div(avg, st->count);
+		size += snprintf(tmp + size, PAGE_SIZE - size,
+				 "%-12s %10u %8u %8llu %8u\n",
+				 fuse_opcode_names[i] ? fuse_opcode_names[i] :
+				 "unknown", st->count, st->errors,
+				 (unsigned long long)avg, st->max_us);
+		if (size >= PAGE_SIZE)
+			break;
+	}
+	ret = simple_read_from_buffer(buf, len, ppos, tmp,
+				      min_t(size_t, size, PAGE_SIZE));
+
+ out:
+	free_page((unsigned long)tmp);
+	kfree(stats);
+	fuse_conn_put(fc);
+	return ret;
+}
+
+static ssize_t fuse_conn_stats_write(struct file *file, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+	if (fc) {
+		spin_lock(&fc->lock);
+		memset(fc->stats, 0, sizeof(fc->stats));
+		spin_unlock(&fc->lock);
+		fuse_conn_put(fc);
+	}
+	return count;
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -198,6 +309,12 @@ static const struct file_operations fuse_conn_congestion_threshold_ops = {
 	.write = fuse_conn_congestion_threshold_write,
 };
 
+static const struct file_operations fuse_conn_stats_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_stats_read,
+	.write = fuse_conn_stats_write,
+};
+
 static struct dentry *fuse_ctl_add_dentry(struct dentry *parent,
 					  struct fuse_conn *fc,
 					  const char *name,
@@ -261,7 +378,9 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "stats", S_IFREG | 0600, 1,
+				 NULL, &fuse_conn_stats_ops))
 		goto err;
 
 	return 0;
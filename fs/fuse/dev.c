@@ -244,6 +244,7 @@ static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
 	list_add_tail(&req->list, &fc->pending);
 	req->state = FUSE_REQ_PENDING;
+	req->queued = ktime_get();
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
@@ -265,6 +266,26 @@ static void flush_bg_queue(struct fuse_conn *fc)
 	}
 }
 
+static void fuse_account_request(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_op_stats *st;
+	u32 us;
+
+	if (!req->queued.tv64)
+		return;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), req->queued));
+	req->queued.tv64 = 0;
+
+	st = &fc->stats[min_t(u32, req->in.h.opcode, FUSE_STATS_NR_OPCODES - 1)];
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+	if (req->out.h.error)
+		st->errors++;
+}
+
 /*
  * This function is called when a request is finished.  Either a reply
  * has arrived or it was aborted (and not yet sent) or some error
@@ -283,6 +304,7 @@ __releases(&fc->lock)
 	list_del(&req->list);
 	list_del(&req->intr_entry);
 	req->state = FUSE_REQ_FINISHED;
+	fuse_account_request(fc, req);
 	if (req->background) {
 		if (fc->num_background == fc->max_background) {
 			fc->blocked = 0;
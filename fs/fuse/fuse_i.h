@@ -21,6 +21,7 @@
 #include <linux/rwsem.h>
 #include <linux/rbtree.h>
 #include <linux/poll.h>
+#include <linux/ktime.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -32,7 +33,10 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
+
+/** Opcodes with their own request statistics, the last slot takes the rest */
+#define FUSE_STATS_NR_OPCODES (FUSE_POLL + 2)
 
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
@@ -298,6 +302,20 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Time the request was queued for userspace, zero if it wasn't */
+	ktime_t queued;
+};
+
+/**
+ * Request statistics of one opcode, from queueing for userspace to the
+ * end of the request
+ */
+struct fuse_op_stats {
+	u64 total_us;
+	u32 max_us;
+	u32 count;
+	u32 errors;
 };
 
 /**
@@ -497,6 +515,9 @@ struct fuse_conn {
 
 	/** Read/write semaphore to hold when accessing sb. */
 	struct rw_semaphore killsb;
+
+	/** Request statistics per opcode, protected by the lock */
+	struct fuse_op_stats stats[FUSE_STATS_NR_OPCODES];
 };
 
 static inline struct fuse_conn *get_fuse_conn_super(struct super_block *sb)
@@ -90,6 +90,16 @@ extern int do_remount_sb(struct super_block *, int, void *, int);
 extern void __put_super(struct super_block *sb);
 extern void put_super(struct super_block *sb);
 
+/*
+ * dir_prefetch.c
+ */
+extern int ioctl_dir_prefetch(struct file *, int __user *);
+
+/*
+ * readdir_plus.c
+ */
+extern int ioctl_readdir_plus(struct file *, struct readdir_plus __user *);
+
 /*
  * open.c
  */
@@ -19,6 +19,8 @@
 
 #include <asm/ioctls.h>
 
+#include "internal.h"
+
 /* So that the fiemap access checks can't overflow on 32 bit machines. */
 #define FIEMAP_MAX_EXTENTS	(UINT_MAX / sizeof(struct fiemap_extent))
 
@@ -590,6 +592,15 @@ int do_vfs_ioctl(struct file *filp, unsigned int fd, unsigned int cmd,
 		error = ioctl_fsthaw(filp);
 		break;
 
+	case FIPREFETCH:
+		error = ioctl_dir_prefetch(filp, argp);
+		break;
+
+	case FIREADDIRPLUS:
+		error = ioctl_readdir_plus(filp,
+				(struct readdir_plus __user *)arg);
+		break;
+
 	case FS_IOC_FIEMAP:
 		return ioctl_fiemap(filp, arg);
 
@@ -357,7 +357,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
+	ktime_t start_time, locked_time, log_time, commit_rec_time, end_time;
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_header_t *header;
@@ -413,6 +413,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
 	stats.run.rs_locked = jiffies;
+	locked_time = ktime_get();
 	stats.run.rs_running = jbd2_time_diff(commit_transaction->t_start,
 					      stats.run.rs_locked);
 
@@ -525,6 +526,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	trace_jbd2_commit_logging(journal, commit_transaction);
 	stats.run.rs_logging = jiffies;
+	log_time = ktime_get();
 	stats.run.rs_flushing = jbd2_time_diff(stats.run.rs_flushing,
 					       stats.run.rs_logging);
 	stats.run.rs_blocks = commit_transaction->t_outstanding_credits;
@@ -709,6 +711,20 @@ start_journal_io:
 		}
 	}
 
+	/*
+	 * Ordered data has to be written before the commit record can be,
+	 * even when the commit record does not wait for the log blocks.
+	 */
+	err = journal_finish_inode_data_buffers(journal, commit_transaction);
+	if (err) {
+		printk(KERN_WARNING
+			"JBD2: Detected IO errors while flushing file data "
+		       "on %s\n", journal->j_devname);
+		if (journal->j_flags & JBD2_ABORT_ON_SYNCDATA_ERR)
+			jbd2_journal_abort(journal, err);
+		err = 0;
+	}
+
 	/* 
 	 * If the journal is not located on the file system device,
 	 * then we must flush the file system device before we issue
@@ -720,26 +736,19 @@ start_journal_io:
 		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
 
-	/* Done it all: now write the commit record asynchronously. */
+	/*
+	 * Done it all: now write the commit record asynchronously.  It
+	 * races the log blocks to the disk; the checksum lets recovery
+	 * throw away a transaction whose commit record made it but whose
+	 * log blocks did not.
+	 */
+	commit_rec_time = ktime_get();
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
 						 &cbh, crc32_sum);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
-		if (journal->j_flags & JBD2_BARRIER)
-			blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL,
-				BLKDEV_IFL_WAIT);
-	}
-
-	err = journal_finish_inode_data_buffers(journal, commit_transaction);
-	if (err) {
-		printk(KERN_WARNING
-			"JBD2: Detected IO errors while flushing file data "
-		       "on %s\n", journal->j_devname);
-		if (journal->j_flags & JBD2_ABORT_ON_SYNCDATA_ERR)
-			jbd2_journal_abort(journal, err);
-		err = 0;
 	}
 
 	/* Lo and behold: we have just managed to send a transaction to
@@ -846,6 +855,7 @@ wait_for_iobuf:
 
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		commit_rec_time = ktime_get();
 		err = journal_submit_commit_record(journal, commit_transaction,
 						&cbh, crc32_sum);
 		if (err)
@@ -854,6 +864,17 @@ wait_for_iobuf:
 	if (!err && !is_journal_aborted(journal))
 		err = journal_wait_on_commit_record(journal, cbh);
 
+	/*
+	 * The async commit record went out without a barrier; a single
+	 * flush now covers it together with the log blocks.
+	 */
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT) &&
+	    (journal->j_flags & JBD2_BARRIER))
+		blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL,
+			BLKDEV_IFL_WAIT);
+	end_time = ktime_get();
+
 	if (err)
 		jbd2_journal_abort(journal, err);
 
@@ -1010,6 +1031,7 @@ restart_loop:
 	/*
 	 * Calculate overall stats
 	 */
+	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 	spin_lock(&journal->j_history_lock);
 	journal->j_stats.ts_tid++;
 	journal->j_stats.run.rs_wait += stats.run.rs_wait;
@@ -1020,13 +1042,24 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	if (commit_time > journal->j_stats.ts_commit_time_max)
+		journal->j_stats.ts_commit_time_max = commit_time;
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_LOCKED],
+		      ktime_us_delta(start_time, locked_time));
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_FLUSH],
+		      ktime_us_delta(log_time, start_time));
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_LOGGING],
+		      ktime_us_delta(commit_rec_time, log_time));
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_COMMIT],
+		      ktime_us_delta(end_time, commit_rec_time));
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_TOTAL],
+		      div_u64(commit_time, NSEC_PER_USEC));
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
-	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
 	 * weight the commit time higher than the average time so we don't
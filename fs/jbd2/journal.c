@@ -80,6 +80,7 @@ EXPORT_SYMBOL(jbd2_journal_errno);
 EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
+EXPORT_SYMBOL(jbd2_journal_account_fsync);
 EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
@@ -108,6 +109,42 @@ static void commit_timeout(unsigned long __data)
 	wake_up_process(p);
 }
 
+/*
+ * Every commit costs at least a descriptor and a commit block, which on
+ * flash means another partial erase block rewritten.  When the running
+ * transaction has collected only a few buffers by the time its timer
+ * fires, the write rate is low and pushing the commit out lets more
+ * updates share one journal write.  Commits that somebody asked for
+ * (fsync, a full transaction, unmount) are never deferred, and no
+ * transaction stays open past j_max_commit_interval.
+ */
+static int jbd2_defer_commit(journal_t *journal, transaction_t *transaction)
+{
+	unsigned long expires, limit;
+
+	if (journal->j_max_commit_interval <= journal->j_commit_interval)
+		return 0;
+	if (journal->j_flags & JBD2_UNMOUNT)
+		return 0;
+	if (tid_geq(journal->j_commit_request, transaction->t_tid))
+		return 0;
+	if (transaction->t_nr_buffers >= JBD2_DEFER_COMMIT_BUFFERS)
+		return 0;
+
+	limit = transaction->t_start + journal->j_max_commit_interval;
+	expires = transaction->t_expires + journal->j_commit_interval;
+	if (time_after(expires, limit))
+		expires = limit;
+	if (!time_after(expires, jiffies))
+		return 0;
+
+	transaction->t_expires = expires;
+	mod_timer(&journal->j_commit_timer, round_jiffies_up(expires));
+	journal->j_commits_deferred++;
+	jbd_debug(1, "deferring commit of %d\n", transaction->t_tid);
+	return 1;
+}
+
 /*
  * kjournald2: The main thread function used to manage a logging device
  * journal.
@@ -204,7 +241,8 @@ loop:
 	 * Were we woken up by a commit wakeup event?
 	 */
 	transaction = journal->j_running_transaction;
-	if (transaction && time_after_eq(jiffies, transaction->t_expires)) {
+	if (transaction && time_after_eq(jiffies, transaction->t_expires) &&
+	    !jbd2_defer_commit(journal, transaction)) {
 		journal->j_commit_request = transaction->t_tid;
 		jbd_debug(1, "woke because of timeout\n");
 	}
@@ -594,6 +632,19 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Account the time an fsync caller that started at @start spent getting
+ * its changes committed.
+ */
+void jbd2_journal_account_fsync(journal_t *journal, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	spin_lock(&journal->j_history_lock);
+	jbd2_hist_add(journal->j_stats.ts_hist[JBD2_HIST_FSYNC], us);
+	spin_unlock(&journal->j_history_lock);
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -693,9 +744,19 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 	return NULL;
 }
 
+static const char *const jbd2_hist_names[JBD2_HIST_NR] = {
+	[JBD2_HIST_LOCKED]	= "locked",
+	[JBD2_HIST_FLUSH]	= "flush",
+	[JBD2_HIST_LOGGING]	= "logging",
+	[JBD2_HIST_COMMIT]	= "commit",
+	[JBD2_HIST_TOTAL]	= "total",
+	[JBD2_HIST_FSYNC]	= "fsync",
+};
+
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
+	int i, j;
 
 	if (v != SEQ_START_TOKEN)
 		return 0;
@@ -722,6 +783,22 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%lluus maximum transaction commit time\n",
+		   div_u64(s->stats->ts_commit_time_max, 1000));
+	seq_printf(seq, "%lu commits deferred\n",
+		   s->journal->j_commits_deferred);
+	seq_printf(seq, "latency histogram:\n  %10s", "usecs");
+	for (j = 0; j < JBD2_HIST_NR; j++)
+		seq_printf(seq, " %8s", jbd2_hist_names[j]);
+	for (i = 0; i < JBD2_HIST_SLOTS; i++) {
+		if (i == JBD2_HIST_SLOTS - 1)
+			seq_printf(seq, "\n  >=%8u", 64 << i);
+		else
+			seq_printf(seq, "\n  <%9u", 128 << i);
+		for (j = 0; j < JBD2_HIST_NR; j++)
+			seq_printf(seq, " %8lu", s->stats->ts_hist[j][i]);
+	}
+	seq_putc(seq, '\n');
 	return 0;
 }
 
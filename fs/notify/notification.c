@@ -163,6 +163,46 @@ static bool event_compare(struct fsnotify_event *old, struct fsnotify_event *new
 	return false;
 }
 
+static bool event_same_object(struct fsnotify_event *old, struct fsnotify_event *new)
+{
+	if (old->to_tell != new->to_tell || old->name_len != new->name_len)
+		return false;
+	return !old->name_len || !strcmp(old->file_name, new->file_name);
+}
+
+/*
+ * A bulk copy into a watched directory interleaves IN_MODIFY events for
+ * every file being written, which defeats the tail match in
+ * fsnotify_add_notify_event().  Look a few events further back for an
+ * identical access or modify event still waiting to be read.  The scan
+ * stops at any other event about the same object, and at IN_IGNORED or
+ * overflow, so nothing is reordered across an open, close, rename or a
+ * watch going away.
+ */
+#define FSNOTIFY_MERGE_WINDOW	32
+
+static bool fsnotify_merge_event(struct list_head *list, struct fsnotify_event *event)
+{
+	struct fsnotify_event_holder *holder;
+	struct fsnotify_event *old;
+	int n = 0;
+
+	if (!(event->mask & (FS_ACCESS | FS_MODIFY)))
+		return false;
+
+	list_for_each_entry_reverse(holder, list, event_list) {
+		if (++n > FSNOTIFY_MERGE_WINDOW)
+			break;
+		old = holder->event;
+		if (old->data_type == FSNOTIFY_EVENT_NONE)
+			break;
+		if (!event_same_object(old, event))
+			continue;
+		return event_compare(old, event);
+	}
+	return false;
+}
+
 /*
  * Add an event to the group notification queue.  The group can later pull this
  * event off the queue to deal with.  If the event is successfully added to the
@@ -194,6 +234,14 @@ alloc_holder:
 
 	mutex_lock(&group->notification_mutex);
 
+	/* checked before the overflow test so a full queue still merges */
+	if (fsnotify_merge_event(list, event)) {
+		mutex_unlock(&group->notification_mutex);
+		if (holder)
+			fsnotify_destroy_event_holder(holder);
+		return -EEXIST;
+	}
+
 	if (group->q_len >= group->max_events) {
 		event = &q_overflow_event;
 		ret = -EOVERFLOW;
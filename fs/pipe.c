@@ -35,6 +35,80 @@ unsigned int pipe_max_size = 1048576;
  */
 unsigned int pipe_min_size = PAGE_SIZE;
 
+/*
+ * The size new pipes are created with, rounded to a power-of-2 number of
+ * pages. Can be set by root in /proc/sys/fs/pipe-default-size
+ */
+unsigned int pipe_default_size = PIPE_DEF_BUFFERS * PAGE_SIZE;
+
+/*
+ * Pages released by pipe buffers are kept on a small shared pool, so that
+ * streaming through pipes does not go back to the page allocator for every
+ * PAGE_SIZE written. The pool is bounded by /proc/sys/fs/pipe-page-pool
+ * (in pages) and is emptied by the shrinker under memory pressure.
+ */
+unsigned int pipe_page_pool_max = 32;
+static unsigned int pipe_page_pool_count;
+static LIST_HEAD(pipe_page_pool);
+static DEFINE_SPINLOCK(pipe_page_pool_lock);
+
+static struct page *pipe_alloc_page(void)
+{
+	struct page *page = NULL;
+
+	spin_lock(&pipe_page_pool_lock);
+	if (!list_empty(&pipe_page_pool)) {
+		page = list_first_entry(&pipe_page_pool, struct page, lru);
+		list_del(&page->lru);
+		pipe_page_pool_count--;
+	}
+	spin_unlock(&pipe_page_pool_lock);
+
+	if (!page)
+		page = alloc_page(GFP_HIGHUSER);
+	return page;
+}
+
+/* Only called for pages nobody else holds a reference to */
+static void pipe_free_page(struct page *page)
+{
+	spin_lock(&pipe_page_pool_lock);
+	if (pipe_page_pool_count < pipe_page_pool_max) {
+		list_add(&page->lru, &pipe_page_pool);
+		pipe_page_pool_count++;
+		page = NULL;
+	}
+	spin_unlock(&pipe_page_pool_lock);
+
+	if (page)
+		__free_page(page);
+}
+
+static int pipe_page_pool_shrink(struct shrinker *shrink, int nr_to_scan,
+				 gfp_t gfp_mask)
+{
+	struct page *page;
+
+	spin_lock(&pipe_page_pool_lock);
+	while (nr_to_scan-- > 0 && !list_empty(&pipe_page_pool)) {
+		page = list_first_entry(&pipe_page_pool, struct page, lru);
+		list_del(&page->lru);
+		pipe_page_pool_count--;
+		spin_unlock(&pipe_page_pool_lock);
+		__free_page(page);
+		spin_lock(&pipe_page_pool_lock);
+	}
+	nr_to_scan = pipe_page_pool_count;
+	spin_unlock(&pipe_page_pool_lock);
+
+	return nr_to_scan;
+}
+
+static struct shrinker pipe_page_pool_shrinker = {
+	.shrink = pipe_page_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -203,12 +277,15 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	/*
 	 * If nobody else uses this page, and we don't already have a
 	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
+	 * allocation cache, or hand it to the shared page pool. (Otherwise
+	 * just release our reference to it)
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
+	if (page_count(page) != 1)
+		page_cache_release(page);
+	else if (!pipe->tmp_page)
 		pipe->tmp_page = page;
 	else
-		page_cache_release(page);
+		pipe_free_page(page);
 }
 
 /**
@@ -545,7 +622,7 @@ redo1:
 			int error, atomic = 1;
 
 			if (!page) {
-				page = alloc_page(GFP_HIGHUSER);
+				page = pipe_alloc_page();
 				if (unlikely(!page)) {
 					ret = ret ? : -ENOMEM;
 					break;
@@ -893,15 +970,20 @@ const struct file_operations rdwr_pipefifo_fops = {
 struct pipe_inode_info * alloc_pipe_info(struct inode *inode)
 {
 	struct pipe_inode_info *pipe;
+	unsigned int buffers = pipe_default_size >> PAGE_SHIFT;
 
 	pipe = kzalloc(sizeof(struct pipe_inode_info), GFP_KERNEL);
 	if (pipe) {
-		pipe->bufs = kzalloc(sizeof(struct pipe_buffer) * PIPE_DEF_BUFFERS, GFP_KERNEL);
+		pipe->bufs = kcalloc(buffers, sizeof(struct pipe_buffer), GFP_KERNEL);
+		if (!pipe->bufs && buffers > PIPE_DEF_BUFFERS) {
+			buffers = PIPE_DEF_BUFFERS;
+			pipe->bufs = kcalloc(buffers, sizeof(struct pipe_buffer), GFP_KERNEL);
+		}
 		if (pipe->bufs) {
 			init_waitqueue_head(&pipe->wait);
 			pipe->r_counter = pipe->w_counter = 1;
 			pipe->inode = inode;
-			pipe->buffers = PIPE_DEF_BUFFERS;
+			pipe->buffers = buffers;
 			return pipe;
 		}
 		kfree(pipe);
@@ -920,7 +1002,7 @@ void __free_pipe_info(struct pipe_inode_info *pipe)
 			buf->ops->release(pipe, buf);
 	}
 	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+		pipe_free_page(pipe->tmp_page);
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1194,6 +1276,7 @@ int pipe_proc_fn(struct ctl_table *table, int write, void __user *buf,
 		return ret;
 
 	pipe_max_size = round_pipe_size(pipe_max_size);
+	pipe_default_size = round_pipe_size(pipe_default_size);
 	return ret;
 }
 
@@ -1267,13 +1350,15 @@ static int __init init_pipe_fs(void)
 		if (IS_ERR(pipe_mnt)) {
 			err = PTR_ERR(pipe_mnt);
 			unregister_filesystem(&pipe_fs_type);
-		}
+		} else
+			register_shrinker(&pipe_page_pool_shrinker);
 	}
 	return err;
 }
 
 static void __exit exit_pipe_fs(void)
 {
+	unregister_shrinker(&pipe_page_pool_shrinker);
 	unregister_filesystem(&pipe_fs_type);
 	mntput(pipe_mnt);
 }
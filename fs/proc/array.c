@@ -81,6 +81,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/ptrace.h>
 #include <linux/tracehook.h>
+#include <linux/pidstat.h>
 
 #include <asm/pgtable.h>
 #include <asm/processor.h>
@@ -532,6 +533,71 @@ int proc_tgid_stat(struct seq_file *m, struct pid_namespace *ns,
 	return do_task_stat(m, ns, pid, task, 1);
 }
 
+/*
+ * Fill the /proc/pidstat record of a thread group leader, with the values
+ * proc_tgid_stat() and proc_pid_statm() would print.  Called under
+ * rcu_read_lock(): task->mm is only looked at under task_lock() rather
+ * than pinned, which could need a sleeping mmput().
+ */
+void task_pidstat(struct pid_namespace *ns, struct task_struct *task,
+		  struct pidstat_task *rec)
+{
+	int size = 0, resident = 0, shared = 0, text = 0, data = 0;
+	unsigned long min_flt = 0, maj_flt = 0;
+	cputime_t utime, stime;
+	unsigned long long start_time;
+	struct mm_struct *mm;
+	unsigned long flags;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->pid = task_tgid_nr_ns(task, ns);
+	rec->uid = __task_cred(task)->uid;
+	rec->state = *get_task_state(task);
+	rec->flags = task->flags;
+	rec->nice = task_nice(task);
+	get_task_comm(rec->comm, task);
+
+	utime = stime = cputime_zero;
+	if (lock_task_sighand(task, &flags)) {
+		struct signal_struct *sig = task->signal;
+		struct task_struct *t = task;
+
+		do {
+			min_flt += t->min_flt;
+			maj_flt += t->maj_flt;
+			t = next_thread(t);
+		} while (t != task);
+		min_flt += sig->min_flt;
+		maj_flt += sig->maj_flt;
+		thread_group_times(task, &utime, &stime);
+
+		rec->num_threads = get_nr_threads(task);
+		rec->oom_adj = sig->oom_adj;
+		rec->ppid = task_tgid_nr_ns(task->real_parent, ns);
+		unlock_task_sighand(task, &flags);
+	}
+	rec->utime = cputime_to_clock_t(utime);
+	rec->stime = cputime_to_clock_t(stime);
+	rec->min_flt = min_flt;
+	rec->maj_flt = maj_flt;
+
+	start_time =
+		(unsigned long long)task->real_start_time.tv_sec * NSEC_PER_SEC
+				+ task->real_start_time.tv_nsec;
+	rec->start_time = nsec_to_clock_t(start_time);
+
+	task_lock(task);
+	mm = task->mm;
+	if (mm)
+		size = task_statm(mm, &shared, &text, &data, &resident);
+	task_unlock(task);
+	rec->size = size;
+	rec->resident = resident;
+	rec->shared = shared;
+	rec->text = text;
+	rec->data = data;
+}
+
 int proc_pid_statm(struct seq_file *m, struct pid_namespace *ns,
 			struct pid *pid, struct task_struct *task)
 {
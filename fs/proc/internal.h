@@ -98,6 +98,9 @@ int proc_pid_readdir(struct file * filp, void * dirent, filldir_t filldir);
 unsigned long task_vsize(struct mm_struct *);
 int task_statm(struct mm_struct *, int *, int *, int *, int *);
 void task_mem(struct seq_file *, struct mm_struct *);
+struct pidstat_task;
+void task_pidstat(struct pid_namespace *, struct task_struct *,
+		  struct pidstat_task *);
 
 static inline struct proc_dir_entry *pde_get(struct proc_dir_entry *pde)
 {
@@ -0,0 +1,133 @@
+/*
+ * /proc/pidstat: one binary snapshot of /proc/meminfo and of the common
+ * /proc/<pid>/stat and statm fields of every process, see
+ * <linux/pidstat.h>.  Monitors polling every process every few seconds
+ * this way avoid a text format and parse per process and per field.
+ */
+
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/pid_namespace.h>
+#include <linux/pidstat.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/swap.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+#include <linux/ktime.h>
+#include "internal.h"
+
+/* processes forked between sizing the buffer and walking the list */
+#define PIDSTAT_SLACK	32
+
+struct pidstat_snapshot {
+	size_t			len;
+	struct pidstat_header	hdr;
+	struct pidstat_task	tasks[];
+};
+
+static void pidstat_meminfo(struct pidstat_meminfo *mem)
+{
+	struct sysinfo i;
+	long cached;
+
+#define K(x) ((__u64)(x) << (PAGE_SHIFT - 10))
+	si_meminfo(&i);
+	si_swapinfo(&i);
+
+	cached = global_page_state(NR_FILE_PAGES) -
+			total_swapcache_pages - i.bufferram;
+	if (cached < 0)
+		cached = 0;
+
+	mem->mem_total = K(i.totalram);
+	mem->mem_free = K(i.freeram);
+	mem->buffers = K(i.bufferram);
+	mem->cached = K(cached);
+	mem->swap_cached = K(total_swapcache_pages);
+	mem->active_anon = K(global_page_state(NR_ACTIVE_ANON));
+	mem->inactive_anon = K(global_page_state(NR_INACTIVE_ANON));
+	mem->active_file = K(global_page_state(NR_ACTIVE_FILE));
+	mem->inactive_file = K(global_page_state(NR_INACTIVE_FILE));
+	mem->unevictable = K(global_page_state(NR_UNEVICTABLE));
+	mem->swap_total = K(i.totalswap);
+	mem->swap_free = K(i.freeswap);
+	mem->dirty = K(global_page_state(NR_FILE_DIRTY));
+	mem->writeback = K(global_page_state(NR_WRITEBACK));
+	mem->anon_pages = K(global_page_state(NR_ANON_PAGES));
+	mem->mapped = K(global_page_state(NR_FILE_MAPPED));
+	mem->shmem = K(global_page_state(NR_SHMEM));
+	mem->slab_reclaimable = K(global_page_state(NR_SLAB_RECLAIMABLE));
+	mem->slab_unreclaimable = K(global_page_state(NR_SLAB_UNRECLAIMABLE));
+	mem->page_tables = K(global_page_state(NR_PAGETABLE));
+#undef K
+}
+
+static int pidstat_open(struct inode *inode, struct file *file)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct pidstat_snapshot *snap;
+	struct task_struct *p;
+	int max, n = 0;
+
+	max = nr_processes() + PIDSTAT_SLACK;
+	snap = vmalloc(sizeof(*snap) + max * sizeof(snap->tasks[0]));
+	if (!snap)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (n == max)
+			break;
+		/* not in our namespace */
+		if (!task_tgid_nr_ns(p, ns))
+			continue;
+		task_pidstat(ns, p, &snap->tasks[n++]);
+	}
+	rcu_read_unlock();
+
+	memset(&snap->hdr, 0, sizeof(snap->hdr));
+	snap->hdr.version = PIDSTAT_VERSION;
+	snap->hdr.header_size = sizeof(snap->hdr);
+	snap->hdr.record_size = sizeof(snap->tasks[0]);
+	snap->hdr.nr_tasks = n;
+	snap->hdr.timestamp = ktime_to_ns(ktime_get());
+	snap->hdr.clk_tck = USER_HZ;
+	snap->hdr.page_size = PAGE_SIZE;
+	pidstat_meminfo(&snap->hdr.mem);
+	snap->len = sizeof(snap->hdr) + n * sizeof(snap->tasks[0]);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t pidstat_read(struct file *file, char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct pidstat_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, &snap->hdr, snap->len);
+}
+
+static int pidstat_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations pidstat_proc_fops = {
+	.open		= pidstat_open,
+	.read		= pidstat_read,
+	.llseek		= default_llseek,
+	.release	= pidstat_release,
+};
+
+static int __init proc_pidstat_init(void)
+{
+	proc_create("pidstat", 0, NULL, &pidstat_proc_fops);
+	return 0;
+}
+module_init(proc_pidstat_init);
@@ -1,7 +1,9 @@
 #include <linux/init.h>
 #include <linux/kernel_stat.h>
+#include <linux/math64.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/time.h>
 
 /*
  * /proc/softirqs  ... display the number of softirqs
@@ -36,9 +38,56 @@ static const struct file_operations proc_softirqs_operations = {
 	.release	= single_release,
 };
 
+/*
+ * /proc/softirq_times  ... display the time spent in each softirq, in
+ * usecs, the longest single run and how often ksoftirqd took over
+ */
+static int show_softirq_times(struct seq_file *p, void *v)
+{
+	int i, j;
+
+	seq_printf(p, "                ");
+	for_each_possible_cpu(i)
+		seq_printf(p, "CPU%-10d", i);
+	seq_printf(p, "  max_run\n");
+
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		u32 longest = 0;
+
+		seq_printf(p, "%8s:", softirq_to_name[i]);
+		for_each_possible_cpu(j) {
+			seq_printf(p, " %12llu",
+				   div_u64(kstat_softirq_time_cpu(i, j),
+					   NSEC_PER_USEC));
+			longest = max(longest,
+				      kstat_softirq_time_max_cpu(i, j));
+		}
+		seq_printf(p, " %7u\n", longest / NSEC_PER_USEC);
+	}
+
+	seq_printf(p, "%8s:", "HANDOFF");
+	for_each_possible_cpu(j)
+		seq_printf(p, " %12u", kstat_cpu(j).softirq_handoffs);
+	seq_printf(p, "\n");
+	return 0;
+}
+
+static int softirq_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_softirq_times, NULL);
+}
+
+static const struct file_operations proc_softirq_times_operations = {
+	.open		= softirq_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init proc_softirqs_init(void)
 {
 	proc_create("softirqs", 0, NULL, &proc_softirqs_operations);
+	proc_create("softirq_times", 0, NULL, &proc_softirq_times_operations);
 	return 0;
 }
 module_init(proc_softirqs_init);
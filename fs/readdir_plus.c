@@ -0,0 +1,262 @@
+/*
+ * linux/fs/readdir_plus.c
+ *
+ * Directory listing with attributes (FIREADDIRPLUS).
+ *
+ * A media scanner calls getdents64() and then fstatat() for every entry,
+ * which on VFAT is a second lookup of a name whose size and mtime were
+ * in the directory entry just read.  FIREADDIRPLUS fills dirent_plus
+ * records, getdents64() records with the size, mtime and mode added.
+ *
+ * A filesystem with ->readdir_plus() hands over the attributes it has in
+ * the directory entry itself.  The entries it can't fill, and all of them
+ * on other filesystems, are looked up once the buffer is full: ->lookup()
+ * can't be called from filldir, see nfsd and dir_prefetch.c.  This still
+ * saves a system call and a path walk per entry, and READDIR_PLUS_NOLOOKUP
+ * skips it for callers that would rather stat() what they need.
+ *
+ * "." and "..", mount points and entries that went away meanwhile are
+ * returned without DIRENT_PLUS_ATTR.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/security.h>
+#include <linux/stat.h>
+#include <linux/uaccess.h>
+
+#include "internal.h"
+
+#define DIRENT_PLUS_NAME	offsetof(struct dirent_plus, d_name)
+
+struct readdir_plus_callback {
+	struct dirent_plus __user *current_dir;
+	struct dirent_plus __user *previous;
+	int count;
+	int error;
+	int missing;		/* entries without attributes */
+};
+
+static int filldir_plus(void *__buf, const char *name, int namlen,
+			loff_t offset, u64 ino, unsigned int d_type,
+			const struct dirent_attr *attr)
+{
+	struct dirent_plus __user *dirent;
+	struct readdir_plus_callback *buf = __buf;
+	int reclen = ALIGN(DIRENT_PLUS_NAME + namlen + 1, sizeof(u64));
+	struct dirent_attr none = { };
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count)
+		return -EINVAL;
+	dirent = buf->previous;
+	if (dirent && __put_user(offset, &dirent->d_off))
+		goto efault;
+
+	if (!attr) {
+		attr = &none;
+		buf->missing++;
+	}
+
+	dirent = buf->current_dir;
+	if (__put_user(ino, &dirent->d_ino) ||
+	    __put_user(0, &dirent->d_off) ||
+	    __put_user(attr->size, &dirent->d_size) ||
+	    __put_user(attr->mtime.tv_sec, &dirent->d_mtime) ||
+	    __put_user(attr->mtime.tv_nsec, &dirent->d_mtime_nsec) ||
+	    __put_user(attr->mode, &dirent->d_mode) ||
+	    __put_user(reclen, &dirent->d_reclen) ||
+	    __put_user(d_type, &dirent->d_type) ||
+	    __put_user(attr == &none ? 0 : DIRENT_PLUS_ATTR,
+		       &dirent->d_flags) ||
+	    copy_to_user(dirent->d_name, name, namlen) ||
+	    __put_user(0, dirent->d_name + namlen))
+		goto efault;
+
+	buf->previous = dirent;
+	dirent = (void __user *)dirent + reclen;
+	buf->current_dir = dirent;
+	buf->count -= reclen;
+	return 0;
+efault:
+	buf->error = -EFAULT;
+	return -EFAULT;
+}
+
+/* for filesystems without ->readdir_plus() */
+static int filldir_plus_noattr(void *__buf, const char *name, int namlen,
+			       loff_t offset, u64 ino, unsigned int d_type)
+{
+	return filldir_plus(__buf, name, namlen, offset, ino, d_type, NULL);
+}
+
+/* vfs_readdir(), through ->readdir_plus() where there is one */
+static int vfs_readdir_plus(struct file *file, void *buf)
+{
+	struct inode *inode = file->f_path.dentry->d_inode;
+	const struct file_operations *fop = file->f_op;
+	int res = -ENOTDIR;
+
+	if (!fop || (!fop->readdir_plus && !fop->readdir))
+		goto out;
+
+	res = security_file_permission(file, MAY_READ);
+	if (res)
+		goto out;
+
+	res = mutex_lock_killable(&inode->i_mutex);
+	if (res)
+		goto out;
+
+	res = -ENOENT;
+	if (!IS_DEADDIR(inode)) {
+		if (fop->readdir_plus)
+			res = fop->readdir_plus(file, buf, filldir_plus);
+		else
+			res = fop->readdir(file, buf, filldir_plus_noattr);
+		file_accessed(file);
+	}
+	mutex_unlock(&inode->i_mutex);
+out:
+	return res;
+}
+
+static int fill_one_attr(struct file *file, struct dirent_plus __user *dirent,
+			 const char *name, int namlen)
+{
+	struct dentry *dentry;
+	struct kstat stat;
+	int err;
+
+	dentry = lookup_one_len(name, file->f_path.dentry, namlen);
+	if (IS_ERR(dentry))
+		return 0;
+
+	err = 0;
+	if (dentry->d_inode && !d_mountpoint(dentry) &&
+	    !vfs_getattr(file->f_path.mnt, dentry, &stat)) {
+		if (__put_user(stat.size, &dirent->d_size) ||
+		    __put_user(stat.mtime.tv_sec, &dirent->d_mtime) ||
+		    __put_user(stat.mtime.tv_nsec, &dirent->d_mtime_nsec) ||
+		    __put_user(stat.mode, &dirent->d_mode) ||
+		    __put_user(DIRENT_PLUS_ATTR, &dirent->d_flags))
+			err = -EFAULT;
+	}
+	dput(dentry);
+	return err;
+}
+
+/*
+ * Look up the entries of the @size bytes of records at @dirent that are
+ * still without attributes.  The records are read back from user space,
+ * so nothing in them is trusted beyond what lookup_one_len() checks.
+ */
+static int readdir_plus_lookup(struct file *file,
+			       struct dirent_plus __user *dirent, int size)
+{
+	struct inode *dir = file->f_path.dentry->d_inode;
+	char *name;
+	int err;
+
+	name = __getname();
+	if (!name)
+		return -ENOMEM;
+
+	err = mutex_lock_killable(&dir->i_mutex);
+	if (err)
+		goto out;
+
+	while (size > DIRENT_PLUS_NAME) {
+		unsigned short reclen;
+		unsigned char flags;
+		long namlen;
+
+		err = -EFAULT;
+		if (__get_user(reclen, &dirent->d_reclen) ||
+		    __get_user(flags, &dirent->d_flags))
+			break;
+		err = 0;
+		if (reclen <= DIRENT_PLUS_NAME || reclen > size)
+			break;
+
+		if (!(flags & DIRENT_PLUS_ATTR)) {
+			namlen = strncpy_from_user(name, dirent->d_name,
+				min_t(int, reclen - DIRENT_PLUS_NAME, PATH_MAX));
+			if (namlen < 0) {
+				err = namlen;
+				break;
+			}
+			/* "." and ".." are not looked up */
+			if (namlen && !(name[0] == '.' && (namlen == 1 ||
+				       (namlen == 2 && name[1] == '.')))) {
+				err = fill_one_attr(file, dirent, name, namlen);
+				if (err)
+					break;
+			}
+		}
+
+		dirent = (void __user *)dirent + reclen;
+		size -= reclen;
+	}
+
+	mutex_unlock(&dir->i_mutex);
+out:
+	__putname(name);
+	return err;
+}
+
+/**
+ * ioctl_readdir_plus - read directory entries with their attributes
+ * @file:	open directory
+ * @argp:	user pointer to a struct readdir_plus
+ *
+ * Returns the number of bytes filled in the records buffer, 0 at the end
+ * of the directory, like getdents64().
+ */
+int ioctl_readdir_plus(struct file *file, struct readdir_plus __user *argp)
+{
+	struct readdir_plus_callback buf;
+	struct dirent_plus __user *lastdirent;
+	struct dirent_plus __user *dirent;
+	struct readdir_plus rp;
+	int error;
+
+	if (copy_from_user(&rp, argp, sizeof(rp)))
+		return -EFAULT;
+	if (rp.flags & ~READDIR_PLUS_NOLOOKUP)
+		return -EINVAL;
+	rp.count = min_t(u32, rp.count, INT_MAX);
+
+	dirent = (struct dirent_plus __user *)(unsigned long)rp.buf;
+	if (!access_ok(VERIFY_WRITE, dirent, rp.count))
+		return -EFAULT;
+
+	buf.current_dir = dirent;
+	buf.previous = NULL;
+	buf.count = rp.count;
+	buf.error = 0;
+	buf.missing = 0;
+
+	error = vfs_readdir_plus(file, &buf);
+	if (error >= 0)
+		error = buf.error;
+	lastdirent = buf.previous;
+	if (lastdirent) {
+		typeof(lastdirent->d_off) d_off = file->f_pos;
+
+		if (__put_user(d_off, &lastdirent->d_off))
+			return -EFAULT;
+		error = rp.count - buf.count;
+
+		if (buf.missing && !(rp.flags & READDIR_PLUS_NOLOOKUP)) {
+			int err = readdir_plus_lookup(file, dirent, error);
+
+			if (err == -EFAULT)
+				error = err;
+		}
+	}
+	return error;
+}
@@ -25,6 +25,7 @@
 #include <linux/mm_inline.h>
 #include <linux/swap.h>
 #include <linux/writeback.h>
+#include <linux/backing-dev.h>
 #include <linux/buffer_head.h>
 #include <linux/module.h>
 #include <linux/syscalls.h>
@@ -709,6 +710,48 @@ static int pipe_to_sendpage(struct pipe_inode_info *pipe,
 	return ret;
 }
 
+/*
+ * Try to move the page in @buf into @mapping at @index instead of copying
+ * it. Only whole, exclusively owned pages qualify; socket buffers qualify
+ * once the skb they came from has been freed. Returns 0 with the page in
+ * the page cache, unlocked, or non-zero if the caller must copy.
+ */
+static int pipe_move_to_page_cache(struct pipe_inode_info *pipe,
+				   struct pipe_buffer *buf,
+				   struct address_space *mapping,
+				   pgoff_t index)
+{
+	struct page *page = buf->page;
+	int ret;
+
+	if (buf->offset || buf->len != PAGE_CACHE_SIZE)
+		return 1;
+	if (mapping_cap_swap_backed(mapping))
+		return 1;
+	if (PageHighMem(page) &&
+	    !(mapping_gfp_mask(mapping) & __GFP_HIGHMEM))
+		return 1;
+
+	if (buf->ops->steal(pipe, buf))
+		return 1;
+
+	/* anon pages gifted with vmsplice still carry their anon_vma */
+	if (page->mapping || PageCompound(page) || page_has_private(page) ||
+	    PageDirty(page) || PageWriteback(page)) {
+		unlock_page(page);
+		return 1;
+	}
+
+	SetPageUptodate(page);
+	if (buf->flags & PIPE_BUF_FLAG_LRU)
+		ret = add_to_page_cache(page, mapping, index, GFP_KERNEL);
+	else
+		ret = add_to_page_cache_lru(page, mapping, index, GFP_KERNEL);
+
+	unlock_page(page);
+	return ret;
+}
+
 /*
  * This is a little more tricky than the file -> pipe splicing. There are
  * basically three cases:
@@ -752,6 +795,15 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	if (this_len + offset > PAGE_CACHE_SIZE)
 		this_len = PAGE_CACHE_SIZE - offset;
 
+	/*
+	 * Hand a whole page over to the page cache up front, so that
+	 * ->write_begin() finds it in place and nothing is copied below.
+	 */
+	if ((sd->flags & SPLICE_F_MOVE) && this_len == PAGE_CACHE_SIZE &&
+	    !pipe_move_to_page_cache(pipe, buf, mapping,
+				     sd->pos >> PAGE_CACHE_SHIFT))
+		count_vm_event(SPLICE_PGMOVED);
+
 	ret = pagecache_write_begin(file, mapping, sd->pos, this_len,
 				AOP_FLAG_UNINTERRUPTIBLE, &page, &fsdata);
 	if (unlikely(ret))
@@ -768,6 +820,7 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 		flush_dcache_page(page);
 		kunmap_atomic(dst, KM_USER1);
 		buf->ops->unmap(pipe, buf, src);
+		count_vm_event(SPLICE_PGCOPIED);
 	}
 	ret = pagecache_write_end(file, mapping, sd->pos, this_len, this_len,
 				page, fsdata);
@@ -23,6 +23,9 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/cpumask.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -40,9 +43,12 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
+#ifndef CONFIG_SQUASHFS_LZO
 static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#define squashfs_lzo_comp_ops squashfs_lzo_unsupported_comp_ops
+#endif
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -51,7 +57,7 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
-	&squashfs_lzo_unsupported_comp_ops,
+	&squashfs_lzo_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +72,148 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * Each mounted filesystem has a pool of decompressor streams, so that
+ * blocks can be read and decompressed in parallel rather than one at a
+ * time.  Holding a stream covers waiting for the block's buffers too, so
+ * even on a single CPU one reader can decompress while others wait on
+ * I/O.  One stream is allocated at mount time, further ones on demand up
+ * to two per CPU; if an allocation fails readers wait for an idle stream
+ * instead.
+ */
+struct squashfs_stream {
+	void			*stream;
+	struct list_head	list;
+};
+
+struct squashfs_stream_pool {
+	spinlock_t		lock;
+	struct list_head	idle;
+	int			streams;
+	int			max_streams;
+	wait_queue_head_t	wait;
+};
+
+
+static struct squashfs_stream *squashfs_stream_alloc(
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *s = kmalloc(sizeof(*s), GFP_KERNEL);
+
+	if (s == NULL)
+		return NULL;
+
+	s->stream = msblk->decompressor->init(msblk);
+	if (s->stream == NULL) {
+		kfree(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+
+void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream_pool *pool;
+	struct squashfs_stream *s;
+
+	pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL)
+		return NULL;
+
+	s = squashfs_stream_alloc(msblk);
+	if (s == NULL) {
+		kfree(pool);
+		return NULL;
+	}
+
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->idle);
+	list_add(&s->list, &pool->idle);
+	pool->streams = 1;
+	pool->max_streams = num_online_cpus() * 2;
+	init_waitqueue_head(&pool->wait);
+
+	return pool;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *strm)
+{
+	struct squashfs_stream_pool *pool = strm;
+	struct squashfs_stream *s, *next;
+
+	if (pool == NULL)
+		return;
+
+	list_for_each_entry_safe(s, next, &pool->idle, list) {
+		msblk->decompressor->free(s->stream);
+		kfree(s);
+	}
+	kfree(pool);
+}
+
+
+static struct squashfs_stream *squashfs_get_stream(
+	struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream_pool *pool = msblk->stream;
+	struct squashfs_stream *s;
+
+	while (1) {
+		spin_lock(&pool->lock);
+		if (!list_empty(&pool->idle)) {
+			s = list_entry(pool->idle.next, struct squashfs_stream,
+				list);
+			list_del(&s->list);
+			spin_unlock(&pool->lock);
+			return s;
+		}
+
+		if (pool->streams < pool->max_streams) {
+			pool->streams++;
+			spin_unlock(&pool->lock);
+
+			s = squashfs_stream_alloc(msblk);
+			if (s)
+				return s;
+
+			spin_lock(&pool->lock);
+			pool->streams--;
+		}
+		spin_unlock(&pool->lock);
+
+		/* There is always at least the stream allocated at mount */
+		wait_event(pool->wait, !list_empty(&pool->idle));
+	}
+}
+
+
+static void squashfs_put_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *s)
+{
+	struct squashfs_stream_pool *pool = msblk->stream;
+
+	spin_lock(&pool->lock);
+	list_add(&s->list, &pool->idle);
+	spin_unlock(&pool->lock);
+	wake_up(&pool->wait);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *s = squashfs_get_stream(msblk);
+	int res;
+
+	res = msblk->decompressor->decompress(msblk, s->stream, buffer, bh, b,
+		offset, length, srclength, pages);
+	squashfs_put_stream(msblk, s);
+
+	return res;
+}
@@ -369,6 +369,15 @@ extern struct cpufreq_governor cpufreq_gov_ondemand;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_CONSERVATIVE)
 extern struct cpufreq_governor cpufreq_gov_conservative;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_conservative)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_INPUTBOOST)
+extern struct cpufreq_governor cpufreq_gov_inputboost;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_inputboost)
+#endif
+
+#ifdef CONFIG_CPU_FREQ_GOV_INPUTBOOST
+void cpufreq_inputboost_kick(void);
+#else
+static inline void cpufreq_inputboost_kick(void) { }
 #endif
 
 
@@ -66,8 +66,7 @@ static inline void delayacct_tsk_init(struct task_struct *tsk)
 {
 	/* reinitialize in case parent's non-null pointer was dup'ed*/
 	tsk->delays = NULL;
-	if (delayacct_on)
-		__delayacct_tsk_init(tsk);
+	__delayacct_tsk_init(tsk);
 }
 
 /* Free tsk->delays. Called from bad fork and __put_task_struct
@@ -522,6 +522,34 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+/*
+ * Resume the device asynchronously but keep suspending it in order, for
+ * drivers whose suspend path still depends on devices that are not their
+ * ancestors.  Such a driver must device_pm_wait_for_dev() on them in its
+ * resume callback.
+ */
+static inline void device_enable_async_resume(struct device *dev)
+{
+	if (dev->power.status == DPM_ON)
+		dev->power.async_resume = true;
+}
+
+static inline void device_disable_async_resume(struct device *dev)
+{
+	if (dev->power.status == DPM_ON)
+		dev->power.async_resume = false;
+}
+
+/*
+ * The device keeps its state and keeps working as a wake-up source across a
+ * micro suspend, so none of its system sleep callbacks are run for one.
+ */
+static inline void device_set_retains_state(struct device *dev, bool val)
+{
+	if (dev->power.status == DPM_ON)
+		dev->power.retains_state = val;
+}
+
 static inline void device_lock(struct device *dev)
 {
 	mutex_lock(&dev->mutex);
@@ -29,6 +29,9 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * When the wake-up came from the user (late_resume_fast_wake()), resume
+ * handlers with defer_resume set, e.g. network and storage, are called from a
+ * separate work item after all the others have run.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -46,6 +49,7 @@ struct early_suspend {
 	struct list_head link;
 	int level;
 	int pm_mode;
+	int defer_resume;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
 #endif
@@ -59,5 +63,13 @@ void unregister_early_suspend(struct early_suspend *handler);
 #define unregister_early_suspend(handler) do { } while (0)
 #endif
 
+#ifdef CONFIG_EARLYSUSPEND
+void late_resume_fast_wake(void);
+void late_resume_input_event(void);
+#else
+static inline void late_resume_fast_wake(void) {}
+static inline void late_resume_input_event(void) {}
+#endif
+
 #endif
 
@@ -396,6 +396,9 @@ typedef struct elf64_shdr {
 #define NT_S390_PREFIX	0x305		/* s390 prefix register */
 #define NT_S390_LAST_BREAK	0x306	/* s390 breaking event address */
 
+/* Types of "Linux" notes in executables, as opposed to core dumps */
+#define NT_LINUX_PREFAULT	0x500	/* prefault text at exec, no desc */
+
 
 /* Note header in a PT_NOTE section */
 typedef struct elf32_note {
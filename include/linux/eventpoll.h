@@ -25,6 +25,8 @@
 #define EPOLL_CTL_ADD 1
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
+/* Set the wakeup coalescing window, in usecs, from event->data; fd is ignored */
+#define EPOLL_CTL_COALESCE 4
 
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
@@ -8,6 +8,7 @@
 
 #include <linux/limits.h>
 #include <linux/ioctl.h>
+#include <linux/types.h>
 
 /*
  * It's silly to have NR_OPEN bigger than NR_FILE, but you can change
@@ -44,6 +45,43 @@ struct inodes_stat_t {
 	int dummy[5];		/* padding for sysctl ABI compatibility */
 };
 
+/* FITRIM: discard the free space in [start, start + len), in bytes */
+struct fstrim_range {
+	__u64 start;
+	__u64 len;		/* on return, the number of bytes trimmed */
+	__u64 minlen;		/* skip free extents shorter than this */
+};
+
+/*
+ * FIREADDIRPLUS: getdents64() on a directory fd that also returns the
+ * size, mtime and mode of each entry, as lstat() would report them.
+ * Returns the number of bytes of dirent_plus records filled, 0 at the
+ * end of the directory.
+ */
+struct readdir_plus {
+	__u64 buf;		/* user pointer to the dirent_plus records */
+	__u32 count;		/* size of buf in bytes */
+	__u32 flags;		/* READDIR_PLUS_* */
+};
+
+/* only what the filesystem has at hand, no lookup of the other entries */
+#define READDIR_PLUS_NOLOOKUP	0x1
+
+struct dirent_plus {
+	__u64 d_ino;
+	__s64 d_off;
+	__s64 d_size;
+	__s64 d_mtime;		/* seconds */
+	__u32 d_mtime_nsec;
+	__u32 d_mode;
+	__u16 d_reclen;
+	__u8 d_type;
+	__u8 d_flags;		/* DIRENT_PLUS_ATTR if the above are valid */
+	char d_name[0];
+};
+
+#define DIRENT_PLUS_ATTR	0x1
+
 
 #define NR_FILE  8192	/* this can well be larger on a larger system */
 
@@ -316,6 +354,9 @@ struct inodes_stat_t {
 #define FIGETBSZ   _IO(0x00,2)	/* get the block size used for bmap */
 #define FIFREEZE	_IOWR('X', 119, int)	/* Freeze */
 #define FITHAW		_IOWR('X', 120, int)	/* Thaw */
+#define FITRIM		_IOWR('X', 121, struct fstrim_range)	/* Trim */
+#define FIPREFETCH	_IOW('X', 122, int)	/* Prefetch dir tree metadata */
+#define FIREADDIRPLUS	_IOW('X', 123, struct readdir_plus) /* Readdir+stat */
 
 #define	FS_IOC_GETFLAGS			_IOR('f', 1, long)
 #define	FS_IOC_SETFLAGS			_IOW('f', 2, long)
@@ -638,6 +679,9 @@ struct address_space {
 	spinlock_t		private_lock;	/* for use by the address_space */
 	struct list_head	private_list;	/* ditto */
 	struct address_space	*assoc_mapping;	/* ditto */
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+	struct mem_cgroup	*owner_memcg;	/* nrpages counted there */
+#endif
 } __attribute__((aligned(sizeof(long))));
 	/*
 	 * On most architectures that alignment is already the case; but
@@ -1470,6 +1514,18 @@ int fiemap_check_flags(struct fiemap_extent_info *fieinfo, u32 fs_flags);
  * to have different dirent layouts depending on the binary type.
  */
 typedef int (*filldir_t)(void *, const char *, int, loff_t, u64, unsigned);
+
+/*
+ * ->readdir_plus() passes the attributes of an entry along with it when
+ * they are at hand without a lookup, NULL otherwise.  See FIREADDIRPLUS.
+ */
+struct dirent_attr {
+	loff_t		size;
+	struct timespec	mtime;
+	umode_t		mode;
+};
+typedef int (*filldirplus_t)(void *, const char *, int, loff_t, u64, unsigned,
+			     const struct dirent_attr *);
 struct block_device_operations;
 
 /* These macros are for out of kernel modules to test that
@@ -1491,6 +1547,7 @@ struct file_operations {
 	ssize_t (*aio_read) (struct kiocb *, const struct iovec *, unsigned long, loff_t);
 	ssize_t (*aio_write) (struct kiocb *, const struct iovec *, unsigned long, loff_t);
 	int (*readdir) (struct file *, void *, filldir_t);
+	int (*readdir_plus) (struct file *, void *, filldirplus_t);
 	unsigned int (*poll) (struct file *, struct poll_table_struct *);
 	int (*ioctl) (struct inode *, struct file *, unsigned int, unsigned long);
 	long (*unlocked_ioctl) (struct file *, unsigned int, unsigned long);
@@ -149,6 +149,22 @@ struct fsl_usb2_wakeup_platform_data {
 	bool usb_wakeup_is_pending;
 };
 
+/* What is on the other end of the OTG port's cable */
+enum fsl_usb2_cable {
+	FSL_USB2_CABLE_UNKNOWN,
+	FSL_USB2_CABLE_HOST,
+	FSL_USB2_CABLE_CHARGER,
+};
+
+#ifdef CONFIG_USB_GADGET_FSL_USB2
+extern enum fsl_usb2_cable fsl_udc_detect_cable(void);
+#else
+static inline enum fsl_usb2_cable fsl_udc_detect_cable(void)
+{
+	return FSL_USB2_CABLE_UNKNOWN;
+}
+#endif
+
 struct spi_device;
 
 struct fsl_spi_platform_data {
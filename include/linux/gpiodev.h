@@ -0,0 +1,51 @@
+#ifndef _LINUX_GPIODEV_H
+#define _LINUX_GPIODEV_H
+
+/*
+ * /dev/gpio: batched access to the GPIOs exported through
+ * /sys/class/gpio, and their edge events.
+ *
+ * Only exported GPIOs can be used, with the same rules as their sysfs
+ * "value" attribute: values follow active_low, and only outputs can be
+ * written.  A batch is checked completely before any GPIO is touched,
+ * so it either fails as a whole or is applied as a whole.
+ *
+ * read() returns struct gpiodev_event records for the GPIOs watched
+ * with GPIODEV_WATCH on that file.
+ */
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define GPIODEV_MAX_BATCH	64
+
+struct gpiodev_value {
+	__u32	gpio;
+	__u32	value;
+};
+
+struct gpiodev_batch {
+	__u32	count;		/* entries in values, up to GPIODEV_MAX_BATCH */
+	__u32	pad;
+	__u64	values;		/* user pointer to struct gpiodev_value[] */
+};
+
+#define GPIODEV_EDGE_RISING	(1 << 0)
+#define GPIODEV_EDGE_FALLING	(1 << 1)
+
+struct gpiodev_watch {
+	__u32	gpio;
+	__u32	edges;		/* GPIODEV_EDGE_*, 0 stops watching */
+};
+
+struct gpiodev_event {
+	__u64	timestamp;	/* CLOCK_MONOTONIC, ns */
+	__u32	gpio;
+	__u32	value;		/* value right after the edge */
+};
+
+#define GPIODEV_GET_VALUES	_IOWR(0xB4, 0x01, struct gpiodev_batch)
+#define GPIODEV_SET_VALUES	_IOW(0xB4, 0x02, struct gpiodev_batch)
+#define GPIODEV_WATCH		_IOW(0xB4, 0x03, struct gpiodev_watch)
+
+#endif /* _LINUX_GPIODEV_H */
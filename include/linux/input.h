@@ -1046,6 +1046,7 @@ struct ff_effect {
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/timer.h>
+#include <linux/ktime.h>
 #include <linux/mod_devicetable.h>
 
 /**
@@ -1064,6 +1065,10 @@ struct ff_effect {
  * @sndbit: bitmap of sound effects supported by the device
  * @ffbit: bitmap of force feedback effects supported by the device
  * @swbit: bitmap of switches present on the device
+ * @hint_events_per_packet: average number of events generated by the
+ *	device in a packet (between EV_SYN/SYN_REPORT events). Used by
+ *	event handlers to estimate size of the buffer needed to hold
+ *	events. Estimated by input_register_device() if left 0
  * @keycodemax: size of keycode table
  * @keycodesize: size of elements in keycode table
  * @keycode: map of scancodes to keycodes for this device
@@ -1080,6 +1085,9 @@ struct ff_effect {
  *	software autorepeat
  * @timer: timer for software autorepeat
  * @sync: set to 1 when there were no new events since last EV_SYNC
+ * @timestamp: CLOCK_REALTIME time the current packet was sampled, set
+ *	by input_set_timestamp() and cleared at SYN_REPORT; 0 if the
+ *	events should be stamped when they are delivered
  * @abs: current values for reports from absolute axes
  * @rep: current values for autorepeat parameters (delay, rate)
  * @key: reflects current state of device's keys/buttons
@@ -1141,6 +1149,8 @@ struct input_dev {
 	unsigned long ffbit[BITS_TO_LONGS(FF_CNT)];
 	unsigned long swbit[BITS_TO_LONGS(SW_CNT)];
 
+	unsigned int hint_events_per_packet;
+
 	unsigned int keycodemax;
 	unsigned int keycodesize;
 	void *keycode;
@@ -1155,6 +1165,7 @@ struct input_dev {
 	struct timer_list timer;
 
 	int sync;
+	ktime_t timestamp;
 
 	int abs[ABS_CNT];
 	int rep[REP_MAX + 1];
@@ -1408,6 +1419,22 @@ static inline void input_mt_sync(struct input_dev *dev)
 }
 
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
+void input_set_timestamp(struct input_dev *dev, ktime_t timestamp);
+
+/**
+ * input_set_events_per_packet - tell handlers about the driver event rate
+ * @dev: the input device used by the driver
+ * @n_events: the average number of events between calls to input_sync()
+ *
+ * If the event rate sent from a device is unusually large, use this
+ * function to set the expected event rate. This will allow handlers
+ * to set up an appropriate buffer size for the event stream, in order
+ * to minimize information loss.
+ */
+static inline void input_set_events_per_packet(struct input_dev *dev, int n_events)
+{
+	dev->hint_events_per_packet = n_events;
+}
 
 static inline void input_set_abs_params(struct input_dev *dev, int axis, int min, int max, int fuzz, int flat)
 {
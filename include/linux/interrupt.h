@@ -412,6 +412,12 @@ extern void raise_softirq_irqoff(unsigned int nr);
 extern void raise_softirq(unsigned int nr);
 extern void wakeup_softirqd(void);
 
+extern unsigned int sysctl_softirq_budget_us;
+extern int sysctl_ksoftirqd_nice;
+struct ctl_table;
+extern int proc_ksoftirqd_nice(struct ctl_table *table, int write,
+			       void __user *buffer, size_t *lenp, loff_t *ppos);
+
 /* This is the worklist that queues up per-cpu softirq work.
  *
  * send_remote_sendirq() adds work to these lists, and
@@ -21,6 +21,12 @@
 int __init iram_init(unsigned long base, unsigned long size);
 void *iram_alloc(unsigned int size, unsigned long *dma_addr);
 void iram_free(unsigned long dma_addr, unsigned int size);
+/*
+ * Opportunistic, cacheable IRAM for small hot data; returns NULL unless
+ * a hot pool was set up with "iram_hot=". Release with iram_free().
+ */
+void *iram_alloc_hot(unsigned int size, unsigned long *dma_addr,
+		     const char *name);
 #else
 static inline int __init iram_init(unsigned long base, unsigned long size)
 {
@@ -31,5 +37,10 @@ static inline void *iram_alloc(unsigned int size, unsigned long *dma_addr)
 	return NULL;
 }
 static inline void iram_free(unsigned long base, unsigned long size) {}
+static inline void *iram_alloc_hot(unsigned int size, unsigned long *dma_addr,
+				   const char *name)
+{
+	return NULL;
+}
 #endif
 
@@ -205,6 +205,9 @@ struct irq_desc {
 	wait_queue_head_t       wait_for_threads;
 #ifdef CONFIG_PROC_FS
 	struct proc_dir_entry	*dir;
+#endif
+#ifdef CONFIG_IRQ_STATS
+	struct irq_stats	*stats;		/* /proc/irq/<irq>/stats */
 #endif
 	const char		*name;
 } ____cacheline_internodealigned_in_smp;
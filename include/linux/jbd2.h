@@ -49,6 +49,13 @@
  */
 #define JBD2_DEFAULT_MAX_COMMIT_AGE 5
 
+/*
+ * A running transaction with fewer metadata buffers than this when its
+ * commit timer fires may have its commit pushed out, up to
+ * j_max_commit_interval.
+ */
+#define JBD2_DEFER_COMMIT_BUFFERS 64
+
 #ifdef CONFIG_JBD2_DEBUG
 /*
  * Define JBD2_EXPENSIVE_CHECKING to enable more expensive internal
@@ -657,11 +664,41 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/*
+ * Latency histograms of the commit stages, of whole commits and of the
+ * time fsync callers spend waiting for them.  Slot 0 counts everything
+ * below 128us, slot n the range [64us << n, 128us << n), and the last
+ * slot everything longer.
+ */
+enum {
+	JBD2_HIST_LOCKED,	/* waiting for running handles */
+	JBD2_HIST_FLUSH,	/* submitting ordered data */
+	JBD2_HIST_LOGGING,	/* logging metadata, waiting for data */
+	JBD2_HIST_COMMIT,	/* commit record until it is on disk */
+	JBD2_HIST_TOTAL,	/* flush to commit done */
+	JBD2_HIST_FSYNC,	/* fsync waiting for its commit */
+	JBD2_HIST_NR,
+};
+
+#define JBD2_HIST_SLOTS		16
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+	u64			ts_commit_time_max;	/* ns */
+	unsigned long		ts_hist[JBD2_HIST_NR][JBD2_HIST_SLOTS];
 };
 
+static inline void jbd2_hist_add(unsigned long *hist, s64 us)
+{
+	int slot = 0;
+
+	if (us >= 128)
+		slot = min_t(int, fls(min_t(s64, us, (u32)~0 >> 1)) - 7,
+			     JBD2_HIST_SLOTS - 1);
+	hist[slot]++;
+}
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -725,6 +762,9 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  *     single compound commit transaction
  * @j_commit_interval: What is the maximum transaction lifetime before we begin
  *  a commit?
+ * @j_max_commit_interval: How long a transaction that sees a low write rate
+ *  may be kept open; 0 disables deferring commits
+ * @j_commits_deferred: Number of times a commit was deferred
  * @j_commit_timer:  The timer used to wakeup the commit thread
  * @j_revoke_lock: Protect the revoke table
  * @j_revoke: The revoke table - maintains the list of revoked blocks in the
@@ -921,6 +961,14 @@ struct journal_s
 	 */
 	unsigned long		j_commit_interval;
 
+	/*
+	 * Upper bound on the lifetime of a transaction whose commit is
+	 * deferred because it has collected little metadata, and how often
+	 * that happened.  [j_state_lock]
+	 */
+	unsigned long		j_max_commit_interval;
+	unsigned long		j_commits_deferred;
+
 	/* The timer used to wakeup the commit thread: */
 	struct timer_list	j_commit_timer;
 
@@ -1187,6 +1235,7 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+void jbd2_journal_account_fsync(journal_t *journal, ktime_t start);
 int jbd2_log_do_checkpoint(journal_t *journal);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
@@ -259,6 +259,9 @@ extern bool printk_timed_ratelimit(unsigned long *caller_jiffies,
 				   unsigned int interval_msec);
 
 extern int printk_delay_msec;
+extern int printk_deferred;
+extern int printk_console_ratelimit;
+extern unsigned long printk_console_dropped;
 
 /*
  * Print a one-time message (analogous to WARN_ONCE() et al):
@@ -34,6 +34,9 @@ struct kernel_stat {
        unsigned int irqs[NR_IRQS];
 #endif
 	unsigned int softirqs[NR_SOFTIRQS];
+	u64 softirq_time[NR_SOFTIRQS];		/* ns */
+	u32 softirq_time_max[NR_SOFTIRQS];	/* ns, longest single run */
+	unsigned int softirq_handoffs;		/* runs left to ksoftirqd */
 };
 
 DECLARE_PER_CPU(struct kernel_stat, kstat);
@@ -80,6 +83,23 @@ static inline unsigned int kstat_softirqs_cpu(unsigned int irq, int cpu)
        return kstat_cpu(cpu).softirqs[irq];
 }
 
+static inline void kstat_add_softirq_time_this_cpu(unsigned int irq, u64 ns)
+{
+	kstat_this_cpu.softirq_time[irq] += ns;
+	if (ns > kstat_this_cpu.softirq_time_max[irq])
+		kstat_this_cpu.softirq_time_max[irq] = min_t(u64, ns, ~0U);
+}
+
+static inline u64 kstat_softirq_time_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirq_time[irq];
+}
+
+static inline u32 kstat_softirq_time_max_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirq_time_max[irq];
+}
+
 /*
  * Number of interrupts per specific IRQ source, since bootup
  */
@@ -21,14 +21,27 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+int ksm_merge_any(struct mm_struct *mm, int enable);
+void __ksm_add_vma(struct vm_area_struct *vma);
+void ksm_note_activity(void);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
+	/* PR_SET_MEMORY_MERGE is inherited by fork, but not by exec */
+	if (test_bit(MMF_VM_MERGE_ANY, &oldmm->flags))
+		set_bit(MMF_VM_MERGE_ANY, &mm->flags);
 	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
 		return __ksm_enter(mm);
 	return 0;
 }
 
+/* Called with mmap_sem held for writing on every vma mapped or grown */
+static inline void ksm_add_vma(struct vm_area_struct *vma)
+{
+	if (test_bit(MMF_VM_MERGE_ANY, &vma->vm_mm->flags))
+		__ksm_add_vma(vma);
+}
+
 static inline void ksm_exit(struct mm_struct *mm)
 {
 	if (test_bit(MMF_VM_MERGEABLE, &mm->flags))
@@ -108,6 +121,19 @@ static inline int PageKsm(struct page *page)
 	return 0;
 }
 
+static inline int ksm_merge_any(struct mm_struct *mm, int enable)
+{
+	return -EINVAL;
+}
+
+static inline void ksm_add_vma(struct vm_area_struct *vma)
+{
+}
+
+static inline void ksm_note_activity(void)
+{
+}
+
 #ifdef CONFIG_MMU
 static inline int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
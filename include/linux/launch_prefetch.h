@@ -0,0 +1,42 @@
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+/*
+ * Record-and-replay page cache prefetch for application launches,
+ * see mm/launch_prefetch.c.
+ */
+
+#include <linux/fs.h>
+#include <linux/sched.h>
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+
+/* Thread group being recorded, 0 when no recording is running */
+extern pid_t launch_prefetch_tgid;
+
+extern void __launch_prefetch_record(struct file *filp, pgoff_t start,
+				     unsigned long nr);
+extern void launch_prefetch_exec(void);
+
+static inline void launch_prefetch_record(struct file *filp, pgoff_t start,
+					  unsigned long nr)
+{
+	if (unlikely(launch_prefetch_tgid) &&
+	    current->tgid == launch_prefetch_tgid && filp)
+		__launch_prefetch_record(filp, start, nr);
+}
+
+#else
+
+static inline void launch_prefetch_record(struct file *filp, pgoff_t start,
+					  unsigned long nr)
+{
+}
+
+static inline void launch_prefetch_exec(void)
+{
+}
+
+#endif
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
@@ -27,6 +27,7 @@ enum {
 };
 
 struct loop_func_table;
+struct loop_dmap;
 
 struct loop_device {
 	int		lo_number;
@@ -65,6 +66,10 @@ struct loop_device {
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 	struct list_head	lo_list;
+
+	/* direct mapping of the backing file, see LOOP_SET_DIRECT_IO */
+	struct loop_dmap	*lo_dmap;	/* protected by lo_lock */
+	atomic_t		lo_dmap_users;
 };
 
 #endif /* __KERNEL__ */
@@ -76,6 +81,7 @@ enum {
 	LO_FLAGS_READ_ONLY	= 1,
 	LO_FLAGS_USE_AOPS	= 2,
 	LO_FLAGS_AUTOCLEAR	= 4,
+	LO_FLAGS_DIRECT_IO	= 16,
 };
 
 #include <asm/posix_types.h>	/* for __kernel_old_dev_t */
@@ -160,5 +166,6 @@ int loop_unregister_transfer(int number);
 #define LOOP_GET_STATUS64	0x4C05
 #define LOOP_CHANGE_FD		0x4C06
 #define LOOP_SET_CAPACITY	0x4C07
+#define LOOP_SET_DIRECT_IO	0x4C08
 
 #endif
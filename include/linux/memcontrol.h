@@ -71,6 +71,10 @@ extern void mem_cgroup_uncharge_cache_page(struct page *page);
 extern int mem_cgroup_shmem_charge_fallback(struct page *page,
 			struct mm_struct *mm, gfp_t gfp_mask);
 
+/* Page cache pages by owner of the mapping, under mapping->tree_lock */
+extern void mem_cgroup_add_owned_page(struct address_space *mapping);
+extern void mem_cgroup_del_owned_page(struct address_space *mapping);
+
 extern void mem_cgroup_out_of_memory(struct mem_cgroup *mem, gfp_t gfp_mask);
 int task_in_mem_cgroup(struct task_struct *task, const struct mem_cgroup *mem);
 
@@ -176,6 +180,14 @@ static inline void mem_cgroup_uncharge_cache_page(struct page *page)
 {
 }
 
+static inline void mem_cgroup_add_owned_page(struct address_space *mapping)
+{
+}
+
+static inline void mem_cgroup_del_owned_page(struct address_space *mapping)
+{
+}
+
 static inline int mem_cgroup_shmem_charge_fallback(struct page *page,
 			struct mm_struct *mm, gfp_t gfp_mask)
 {
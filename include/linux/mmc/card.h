@@ -33,6 +33,7 @@ struct mmc_csd {
 	unsigned int		read_blkbits;
 	unsigned int		write_blkbits;
 	unsigned int		capacity;
+	unsigned int		erase_size;		/* In sectors */
 	unsigned int		read_partial:1,
 				read_misalign:1,
 				write_partial:1,
@@ -50,6 +51,13 @@ struct mmc_ext_csd {
 	unsigned char		boot_size_mult;
 	unsigned char		boot_config;
 	unsigned char		boot_bus_width;
+	unsigned int		rel_sectors;		/* reliable write granule */
+	unsigned char		rel_param;		/* WR_REL_PARAM */
+	unsigned int		hc_erase_size;		/* In sectors */
+	unsigned int		hc_erase_timeout;	/* In milliseconds */
+	unsigned int		trim_timeout;		/* In milliseconds */
+	unsigned char		erase_group_def;	/* ERASE_GROUP_DEF */
+	unsigned char		sec_feature_support;
 };
 
 struct sd_scr {
@@ -81,6 +89,15 @@ struct sdio_cis {
 	unsigned int		max_dtr;
 };
 
+struct mmc_erase_stats {
+	spinlock_t		lock;
+	unsigned int		count;		/* erase/trim commands */
+	unsigned int		errors;
+	u64			sectors;
+	u64			total_us;
+	unsigned int		max_us;
+};
+
 struct mmc_host;
 struct sdio_func;
 struct sdio_func_tuple;
@@ -117,6 +134,8 @@ struct mmc_card {
 	struct mmc_ext_csd	ext_csd;	/* mmc v4 extended card specific */
 	struct sd_scr		scr;		/* extra SD information */
 	struct sd_switch_caps	sw_caps;	/* switch (CMD6) caps */
+	unsigned int		erase_size;	/* erase unit, in sectors */
+	struct mmc_erase_stats	erase_stats;	/* discards, see mmc_erase() */
 
 	unsigned int		sdio_funcs;	/* number of SDIO functions */
 	struct sdio_cccr	cccr;		/* common card info */
@@ -84,6 +84,15 @@ struct mmc_host_ops {
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
+	/*
+	 * 'pre_req' may map the data of a request ahead of 'request', while
+	 * the previous request is still on the bus, and should set
+	 * data->host_cookie when it did.  'post_req' undoes it once the
+	 * request has completed or is dropped.  Both are optional.
+	 */
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req);
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
 	/*
 	 * Avoid calling these three functions too often or in a "fast path",
 	 * since underlaying controller might implement them in an expensive
@@ -117,6 +126,22 @@ struct mmc_host_ops {
 struct mmc_card;
 struct device;
 
+/*
+ * Request latency, from mmc_start_request() to mmc_request_done(), split
+ * by direction and transfer size.  Bucket i counts latencies below
+ * 32us << i, the last one everything longer.
+ */
+#define MMC_LAT_DIRS		3	/* no data, read, write */
+#define MMC_LAT_SIZES		4	/* <= 4K, <= 32K, <= 128K, larger */
+#define MMC_LAT_BUCKETS		14
+
+struct mmc_latency_hist {
+	spinlock_t	lock;
+	u32		count[MMC_LAT_DIRS][MMC_LAT_SIZES][MMC_LAT_BUCKETS];
+	u64		total_us[MMC_LAT_DIRS][MMC_LAT_SIZES];
+	u32		max_us[MMC_LAT_DIRS][MMC_LAT_SIZES];
+};
+
 struct mmc_host {
 	struct device		*parent;
 	struct device		class_dev;
@@ -157,6 +182,7 @@ struct mmc_host {
 #define MMC_CAP_NONREMOVABLE	(1 << 8)	/* Nonremovable e.g. eMMC */
 #define MMC_CAP_WAIT_WHILE_BUSY	(1 << 9)	/* Waits while card is busy */
 #define MMC_CAP_DATA_DDR	(1 << 10)	/* Can the host do ddr transfers */
+#define MMC_CAP_CMD23		(1 << 11)	/* Can send mrq->sbc before a transfer */
 
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
@@ -217,6 +243,10 @@ struct mmc_host {
 
 	struct dentry		*debugfs_root;
 
+#ifdef CONFIG_DEBUG_FS
+	struct mmc_latency_hist	latency;	/* see mmc_latency_record() */
+#endif
+
 	unsigned long		private[0] ____cacheline_aligned;
 };
 
@@ -251,6 +251,8 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_WR_REL_PARAM	166	/* RO */
+#define EXT_CSD_ERASE_GROUP_DEF	175	/* R/W */
 #define EXT_CSD_BOOT_BUS_WIDTH 	177	/* R/W */
 #define EXT_CSD_BOOT_CONFIG 	179	/* R/W */
 #define EXT_CSD_BUS_WIDTH	183	/* R/W */
@@ -260,7 +262,12 @@ struct _mmc_csd {
 #define EXT_CSD_SEC_CNT		212	/* RO, 4 bytes */
 #define EXT_CSD_S_A_TIMEOUT	217
 #define EXT_CSD_BOOT_SIZE_MULT	226	/* RO, 1 bytes */
+#define EXT_CSD_REL_WR_SEC_C	222	/* RO */
+#define EXT_CSD_ERASE_TIMEOUT_MULT	223	/* RO */
+#define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_INFO	228	/* RO, 1 bytes */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_TRIM_MULT	232	/* RO */
 
 /*
  * EXT_CSD field definitions
@@ -274,6 +281,16 @@ struct _mmc_csd {
 #define EXT_CSD_CARD_TYPE_52	(1<<1)	/* Card can run at 52MHz */
 #define EXT_CSD_CARD_TYPE_MASK	0x3	/* Mask out reserved and DDR bits */
 
+#define EXT_CSD_WR_REL_PARAM_EN	(1<<2)	/* Reliable writes of any size */
+
+#define EXT_CSD_SEC_GB_CL_EN	(1<<4)	/* TRIM supported */
+
+/* MMC_ERASE arguments */
+#define MMC_ERASE_ARG		0x00000000	/* whole erase groups */
+#define MMC_TRIM_ARG		0x00000001	/* write blocks */
+
+#define MMC_CMD23_ARG_REL_WR	(1<<31)	/* SET_BLOCK_COUNT: reliable write */
+
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
 #define EXT_CSD_BUS_WIDTH_8	2	/* Card is in 8 bit mode */
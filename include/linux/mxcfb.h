@@ -91,6 +91,7 @@ struct mxcfb_rect {
 #define EPDC_FLAG_USE_DITHERING_Y4		0x4000
 
 #define FB_POWERDOWN_DISABLE			-1
+#define FB_POWERDOWN_ADAPTIVE			-2
 
 #define FB_FINISH_RENDER 1;
 #define FB_STILL_RENDERING 0;
@@ -116,6 +117,66 @@ struct mxcfb_update_data {
 	struct mxcfb_alt_buffer_data alt_buffer_data;
 };
 
+/* Maximum number of regions in one MXCFB_SEND_UPDATES request */
+#define MXCFB_MAX_UPDATE_RECTS	16
+
+/*
+ * Several update regions sharing waveform, mode, marker, temperature and
+ * flags. The marker completes once all of the regions have been drawn.
+ * Alternate buffers are not supported.
+ */
+struct mxcfb_update_rects {
+	__u32 waveform_mode;
+	__u32 update_mode;
+	__u32 update_marker;
+	int temp;
+	uint flags;
+	__u32 num_rects;
+	struct mxcfb_rect rects[MXCFB_MAX_UPDATE_RECTS];
+};
+
+/*
+ * Gray level class of an update, from the PxP histogram. Classes
+ * are ordered, so a batch reports the highest class of its regions.
+ */
+#define MXCFB_HIST_CLASS_NONE	0	/* Not known, e.g. PxP not used */
+#define MXCFB_HIST_CLASS_2	1	/* Black and white only */
+#define MXCFB_HIST_CLASS_4	2	/* At most 4 gray levels */
+#define MXCFB_HIST_CLASS_8	3	/* At most 8 gray levels */
+#define MXCFB_HIST_CLASS_16	4	/* At most 16 gray levels */
+#define MXCFB_HIST_CLASS_32	5	/* More than 16 gray levels */
+#define MXCFB_HIST_CLASSES	5
+
+/*
+ * MXCFB_WAIT_FOR_UPDATE_COMPLETE_HIST: update_marker is passed in,
+ * hist_class and the waveform_mode the update ran with are returned.
+ * Both are zero if the marker had already completed before the call
+ * and nobody was waiting on it.
+ */
+struct mxcfb_update_marker_data {
+	__u32 update_marker;
+	__u32 hist_class;
+	__u32 waveform_mode;
+};
+
+/* Largest MXCFB_SEND_DIRECT region, with its lines rounded up to 8 */
+#define MXCFB_DIRECT_MAX_PIXELS	65536
+
+/*
+ * MXCFB_SEND_DIRECT: draw a small black and white region with an explicit
+ * waveform (A2 or DU), for pen input. The region is read from an 8-bit
+ * framebuffer by the CPU, pixels below 0x80 black and the others white,
+ * and handed to the EPDC from the ioctl, bypassing PxP and the update
+ * queue. The first direct update takes a LUT away from queued updates,
+ * so that pen input never waits behind them. There is no update marker.
+ * Only EPDC_FLAG_ENABLE_INVERSION is accepted in flags.
+ */
+struct mxcfb_direct_update {
+	struct mxcfb_rect update_region;
+	__u32 waveform_mode;
+	uint flags;
+};
+
 /*
  * Structure used to define waveform modes for driver
  * Needed for driver to perform auto-waveform selection
@@ -154,6 +215,9 @@ struct mxcfb_waveform_modes {
 #define MXCFB_SET_UPDATE_MODE		_IOW('F', 0x33, int32_t)
 #define MXCFB_GET_UPDATE_MODE		_IOR('F', 0x34, int32_t)
 #define MXCFB_SET_MERGE_ON_WAVEFORM_MISMATCH	_IOW('F', 0x37, int32_t)
+#define MXCFB_SEND_UPDATES		_IOW('F', 0x38, struct mxcfb_update_rects)
+#define MXCFB_WAIT_FOR_UPDATE_COMPLETE_HIST	_IOWR('F', 0x39, struct mxcfb_update_marker_data)
+#define MXCFB_SEND_DIRECT		_IOW('F', 0x3B, struct mxcfb_direct_update)
 
 #ifdef __KERNEL__
 
@@ -19,16 +19,47 @@
 #ifndef _MXCFB_EPDC_KERNEL
 #define _MXCFB_EPDC_KERNEL
 
+#include <linux/ktime.h>
+
 void mxc_epdc_fb_set_waveform_modes(struct mxcfb_waveform_modes *modes,
 						struct fb_info *info);
 int mxc_epdc_fb_set_temperature(int temperature, struct fb_info *info);
 int mxc_epdc_fb_set_auto_update(u32 auto_mode, struct fb_info *info);
 int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 				   struct fb_info *info);
+int mxc_epdc_fb_send_updates(struct mxcfb_update_rects *upd_rects,
+			     struct fb_info *info);
+int mxc_epdc_fb_send_direct(struct mxcfb_direct_update *upd,
+			    struct fb_info *info);
 int mxc_epdc_fb_wait_update_complete(u32 update_marker, struct fb_info *info);
 int mxc_epdc_fb_set_pwrdown_delay(u32 pwrdown_delay,
 					    struct fb_info *info);
 int mxc_epdc_get_pwrdown_delay(struct fb_info *info);
 int mxc_epdc_fb_set_upd_scheme(u32 upd_scheme, struct fb_info *info);
 
+/* Pipeline timestamps of an update the panel has finished drawing */
+struct mxc_epdc_upd_timing {
+	u32 waveform_mode;
+	ktime_t send;		/* Accepted by mxc_epdc_fb_send_update() */
+	ktime_t pxp_start;	/* PxP processing started */
+	ktime_t pxp_done;	/* PxP processing complete */
+	ktime_t submit;		/* Handed to the EPDC on a LUT */
+	ktime_t complete;	/* LUT complete */
+};
+
+/* Called in interrupt context, must not sleep */
+typedef void (*mxc_epdc_upd_observer_t)(void *data,
+					const struct mxc_epdc_upd_timing *tm);
+
+int mxc_epdc_fb_set_upd_observer(struct fb_info *info,
+				 mxc_epdc_upd_observer_t fn, void *data);
+u32 mxc_epdc_fb_get_collisions(struct fb_info *info);
+
+/* Stamp an input event for touch-to-display latency accounting */
+#ifdef CONFIG_FB_MXC_EINK_PANEL
+void mxc_epdc_fb_note_input(ktime_t stamp);
+#else
+static inline void mxc_epdc_fb_note_input(ktime_t stamp) {}
+#endif
+
 #endif
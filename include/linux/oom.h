@@ -14,6 +14,7 @@
 
 struct zonelist;
 struct notifier_block;
+struct task_struct;
 
 /*
  * Types of limitations to the nodes from which allocations may occur
@@ -43,5 +44,20 @@ static inline void oom_killer_enable(void)
 {
 	oom_killer_disabled = false;
 }
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+/* Low memory killer process index, see lowmemorykiller.c */
+extern void lowmem_index_add(struct task_struct *task);
+extern void lowmem_index_del(struct task_struct *task);
+extern void lowmem_index_replace(struct task_struct *old,
+				 struct task_struct *new);
+extern void lowmem_index_update(struct task_struct *task);
+#else
+static inline void lowmem_index_add(struct task_struct *task) { }
+static inline void lowmem_index_del(struct task_struct *task) { }
+static inline void lowmem_index_replace(struct task_struct *old,
+					struct task_struct *new) { }
+static inline void lowmem_index_update(struct task_struct *task) { }
+#endif
 #endif /* __KERNEL__*/
 #endif /* _INCLUDE_LINUX_OOM_H */
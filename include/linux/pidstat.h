@@ -0,0 +1,80 @@
+#ifndef _LINUX_PIDSTAT_H
+#define _LINUX_PIDSTAT_H
+
+/*
+ * /proc/pidstat: the fields monitors usually parse out of /proc/meminfo
+ * and every /proc/<pid>/stat and statm, for all processes, in one binary
+ * snapshot.
+ *
+ * The snapshot is taken at open(); read() returns a struct pidstat_header
+ * followed by nr_tasks records of record_size bytes each.  Newer kernels
+ * may grow either structure, so use header_size and record_size to step
+ * through the buffer rather than sizeof().
+ */
+
+#include <linux/types.h>
+
+#define PIDSTAT_VERSION		1
+
+/* in kB, with the meaning of the /proc/meminfo line of the same name */
+struct pidstat_meminfo {
+	__u64	mem_total;
+	__u64	mem_free;
+	__u64	buffers;
+	__u64	cached;
+	__u64	swap_cached;
+	__u64	active_anon;
+	__u64	inactive_anon;
+	__u64	active_file;
+	__u64	inactive_file;
+	__u64	unevictable;
+	__u64	swap_total;
+	__u64	swap_free;
+	__u64	dirty;
+	__u64	writeback;
+	__u64	anon_pages;
+	__u64	mapped;
+	__u64	shmem;
+	__u64	slab_reclaimable;
+	__u64	slab_unreclaimable;
+	__u64	page_tables;
+};
+
+struct pidstat_header {
+	__u32	version;		/* PIDSTAT_VERSION */
+	__u32	header_size;
+	__u32	record_size;
+	__u32	nr_tasks;
+	__u64	timestamp;		/* CLOCK_MONOTONIC, ns */
+	__u32	clk_tck;		/* unit of the times below, USER_HZ */
+	__u32	page_size;		/* unit of the statm fields */
+	struct pidstat_meminfo	mem;
+};
+
+/* one per thread group, times and faults cover the whole group */
+struct pidstat_task {
+	__s32	pid;
+	__s32	ppid;
+	__u32	uid;
+	__s32	oom_adj;
+	__s32	nice;
+	__u32	num_threads;
+	__u8	state;			/* as in /proc/<pid>/stat */
+	__u8	pad[3];
+	__u32	flags;			/* PF_*, kernel threads have PF_KTHREAD */
+	__u64	utime;
+	__u64	stime;
+	__u64	start_time;		/* since boot */
+	__u64	min_flt;
+	__u64	maj_flt;
+	/* pages, as in /proc/<pid>/statm; 0 for kernel threads */
+	__u32	size;
+	__u32	resident;
+	__u32	shared;
+	__u32	text;
+	__u32	data;
+	__u32	pad2;
+	char	comm[16];
+};
+
+#endif /* _LINUX_PIDSTAT_H */
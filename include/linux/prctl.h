@@ -102,4 +102,20 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Let KSM merge all eligible anonymous memory of the process, present
+ * and future, without madvise(MADV_MERGEABLE).  Inherited across fork.
+ */
+#define PR_SET_MEMORY_MERGE		67
+#define PR_GET_MEMORY_MERGE		68
+
+/*
+ * Mark the calling thread latency sensitive: it preempts other fair
+ * tasks as soon as it wakes up behind them, and runs in short slices.
+ * Setting it needs CAP_SYS_NICE; it is not inherited across fork.
+ * The cpu cgroup's cpu.latency_sensitive does the same for a group.
+ */
+#define PR_SET_SCHED_LATENCY		69
+#define PR_GET_SCHED_LATENCY		70
+
 #endif /* _LINUX_PRCTL_H */
@@ -435,6 +435,7 @@ extern int get_dumpable(struct mm_struct *mm);
 #endif
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
+#define MMF_VM_MERGE_ANY	17	/* KSM may merge all new vmas */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -729,7 +730,7 @@ struct task_delay_info {
 
 	/* For each stat XXX, add following, aligned appropriately
 	 *
-	 * struct timespec XXX_start, XXX_end;
+	 * u64 XXX_start;	(ns, 0 when not in progress)
 	 * u64 XXX_delay;
 	 * u32 XXX_count;
 	 *
@@ -742,7 +743,7 @@ struct task_delay_info {
 	 * associated with the operation is added to XXX_delay.
 	 * XXX_delay contains the accumulated delay time in nanoseconds.
 	 */
-	struct timespec blkio_start, blkio_end;	/* Shared by blkio, swapin */
+	u64 blkio_start;	/* Shared by blkio, swapin */
 	u64 blkio_delay;	/* wait for sync block io completion */
 	u64 swapin_delay;	/* wait for swapin block io completion */
 	u32 blkio_count;	/* total count of the number of sync block */
@@ -750,7 +751,7 @@ struct task_delay_info {
 	u32 swapin_count;	/* total count of the number of swapin block */
 				/* io operations performed */
 
-	struct timespec freepages_start, freepages_end;
+	u64 freepages_start;
 	u64 freepages_delay;	/* wait for memory reclaim */
 	u32 freepages_count;	/* total count of memory reclaim */
 };
@@ -1218,6 +1219,9 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	struct hlist_node lmk_adj_node;	/* leaders only, by oom_adj */
+#endif
 	struct plist_node pushable_tasks;
 
 	struct mm_struct *mm, *active_mm;
@@ -1238,6 +1242,8 @@ struct task_struct {
 
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
+	/* Favour at wakeup, see PR_SET_SCHED_LATENCY */
+	unsigned sched_latency_sensitive:1;
 
 	pid_t pid;
 	pid_t tgid;
@@ -1916,6 +1922,7 @@ static inline int rt_mutex_getprio(struct task_struct *p)
 extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
+extern int sched_set_latency_sensitive(struct task_struct *p, int on);
 extern int can_nice(const struct task_struct *p, const int nice);
 extern int task_curr(const struct task_struct *p);
 extern int idle_cpu(int cpu);
@@ -229,6 +229,7 @@ enum
 	LINUX_MIB_TCPBACKLOGDROP,
 	LINUX_MIB_TCPMINTTLDROP, /* RFC 5082 */
 	LINUX_MIB_TCPDEFERACCEPTDROP,
+	LINUX_MIB_TCPRCVBUDGETCLAMP,		/* TCPRcvBudgetClamp */
 	__LINUX_MIB_MAX
 };
 
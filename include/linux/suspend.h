@@ -6,6 +6,7 @@
 #include <linux/init.h>
 #include <linux/pm.h>
 #include <linux/mm.h>
+#include <linux/ktime.h>
 #include <asm/errno.h>
 
 #if defined(CONFIG_PM_SLEEP) && defined(CONFIG_VT) && defined(CONFIG_VT_CONSOLE)
@@ -273,6 +274,51 @@ static inline void suspend_nvs_save(void) {}
 static inline void suspend_nvs_restore(void) {}
 #endif /* CONFIG_SUSPEND_NVS */
 
+enum suspend_timing_phase {
+	SUSPEND_TIMING_PREPARE,
+	SUSPEND_TIMING_SUSPEND,
+	SUSPEND_TIMING_SUSPEND_NOIRQ,
+	SUSPEND_TIMING_SLEEP,
+	SUSPEND_TIMING_RESUME_NOIRQ,
+	SUSPEND_TIMING_RESUME,
+	SUSPEND_TIMING_COMPLETE,
+	SUSPEND_TIMING_LATE_RESUME,
+	SUSPEND_TIMING_NR
+};
+
+#ifdef CONFIG_SUSPEND_TIMING
+/* kernel/power/suspend_timing.c */
+extern void suspend_timing_begin(void);
+extern void suspend_timing_wake(void);
+extern ktime_t suspend_timing_start(void);
+extern void suspend_timing_phase(enum suspend_timing_phase phase,
+				 ktime_t start);
+extern void suspend_timing_device(struct device *dev,
+				  enum suspend_timing_phase phase,
+				  ktime_t start, int error, bool async);
+extern void suspend_timing_handler(void *fn, enum suspend_timing_phase phase,
+				   ktime_t start);
+#else /* !CONFIG_SUSPEND_TIMING */
+static inline void suspend_timing_begin(void) {}
+static inline void suspend_timing_wake(void) {}
+static inline ktime_t suspend_timing_start(void) { return ktime_set(0, 0); }
+static inline void suspend_timing_phase(enum suspend_timing_phase phase,
+					ktime_t start) {}
+static inline void suspend_timing_device(struct device *dev,
+					 enum suspend_timing_phase phase,
+					 ktime_t start, int error, bool async) {}
+static inline void suspend_timing_handler(void *fn,
+					  enum suspend_timing_phase phase,
+					  ktime_t start) {}
+#endif /* !CONFIG_SUSPEND_TIMING */
+
+#ifdef CONFIG_PM_MICRO_SUSPEND
+/* Set for the duration of a micro suspend, see kernel/power/micro_suspend.c */
+extern bool pm_micro_suspend_active;
+#else
+#define pm_micro_suspend_active	false
+#endif
+
 #ifdef CONFIG_PM_SLEEP
 void save_processor_state(void);
 void restore_processor_state(void);
@@ -165,6 +165,10 @@ struct tcp_info {
 	__u32	tcpi_rcv_space;
 
 	__u32	tcpi_total_retrans;
+
+	__u32	tcpi_rcv_buf;		/* current receive buffer */
+	__u32	tcpi_rcv_budget;	/* bytes of it held against tcp_rmem_budget */
+	__u32	tcpi_rcv_budget_clamps;	/* growths cut short by the budget */
 };
 
 /* for TCP_MD5SIG socket option */
@@ -438,6 +442,8 @@ struct tcp_sock {
 		int	space;
 		u32	seq;
 		u32	time;
+		int	charged;	/* autotuned growth, see tcp_rmem_budget */
+		u32	clamped;
 	} rcvq_space;
 
 /* TCP-specific MTU probe information. */
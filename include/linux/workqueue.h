@@ -9,6 +9,7 @@
 #include <linux/linkage.h>
 #include <linux/bitops.h>
 #include <linux/lockdep.h>
+#include <linux/ktime.h>
 #include <asm/atomic.h>
 
 struct workqueue_struct;
@@ -33,6 +34,9 @@ struct work_struct {
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
+#ifdef CONFIG_WORKQUEUE_STATS
+	ktime_t queued;		/* when it was put on the worklist */
+#endif
 };
 
 #define WORK_DATA_INIT()	ATOMIC_LONG_INIT(0)
@@ -236,6 +236,7 @@ extern int sysctl_tcp_low_latency;
 extern int sysctl_tcp_dma_copybreak;
 extern int sysctl_tcp_nometrics_save;
 extern int sysctl_tcp_moderate_rcvbuf;
+extern int sysctl_tcp_rmem_budget;
 extern int sysctl_tcp_tso_win_divisor;
 extern int sysctl_tcp_abc;
 extern int sysctl_tcp_mtu_probing;
@@ -325,6 +326,7 @@ extern int			tcp_rcv_established(struct sock *sk,
 						    unsigned len);
 
 extern void			tcp_rcv_space_adjust(struct sock *sk);
+extern void			tcp_rcv_budget_release(struct sock *sk);
 
 extern void			tcp_cleanup_rbuf(struct sock *sk, int copied);
 
@@ -0,0 +1,152 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * binder_transaction - transaction or reply queued for its target
+ * @debug_id: transaction id, as in the binder debugfs logs
+ * @reply: nonzero for BC_REPLY
+ * @from_proc: sending process
+ * @from_thread: sending thread
+ * @to_proc: target process
+ * @to_thread: target thread, 0 if any thread of to_proc may take it
+ * @to_node: target node id, 0 for replies
+ * @code: transaction code
+ * @flags: transaction flags (TF_*)
+ */
+TRACE_EVENT(binder_transaction,
+
+	TP_PROTO(int debug_id, int reply, int from_proc, int from_thread,
+		 int to_proc, int to_thread, int to_node,
+		 unsigned int code, unsigned int flags),
+
+	TP_ARGS(debug_id, reply, from_proc, from_thread, to_proc, to_thread,
+		to_node, code, flags),
+
+	TP_STRUCT__entry(
+		__field(	int,		debug_id	)
+		__field(	int,		reply		)
+		__field(	int,		from_proc	)
+		__field(	int,		from_thread	)
+		__field(	int,		to_proc		)
+		__field(	int,		to_thread	)
+		__field(	int,		to_node		)
+		__field(	unsigned int,	code		)
+		__field(	unsigned int,	flags		)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->reply		= reply;
+		__entry->from_proc	= from_proc;
+		__entry->from_thread	= from_thread;
+		__entry->to_proc	= to_proc;
+		__entry->to_thread	= to_thread;
+		__entry->to_node	= to_node;
+		__entry->code		= code;
+		__entry->flags		= flags;
+	),
+
+	TP_printk("transaction=%d %s %d:%d -> %d:%d node=%d code=0x%x flags=0x%x",
+		  __entry->debug_id, __entry->reply ? "reply" : "call",
+		  __entry->from_proc, __entry->from_thread,
+		  __entry->to_proc, __entry->to_thread, __entry->to_node,
+		  __entry->code, __entry->flags)
+);
+
+/**
+ * binder_wakeup - a thread waiting in BINDER_WRITE_READ got work
+ * @proc: process of the thread
+ * @thread: the thread
+ * @proc_work: it was waiting for work for any thread of the process
+ */
+TRACE_EVENT(binder_wakeup,
+
+	TP_PROTO(int proc, int thread, int proc_work),
+
+	TP_ARGS(proc, thread, proc_work),
+
+	TP_STRUCT__entry(
+		__field(	int,	proc		)
+		__field(	int,	thread		)
+		__field(	int,	proc_work	)
+	),
+
+	TP_fast_assign(
+		__entry->proc		= proc;
+		__entry->thread		= thread;
+		__entry->proc_work	= proc_work;
+	),
+
+	TP_printk("thread=%d:%d proc_work=%d",
+		  __entry->proc, __entry->thread, __entry->proc_work)
+);
+
+/**
+ * binder_transaction_received - BR_TRANSACTION or BR_REPLY returned
+ * @debug_id: transaction id
+ * @proc: receiving process
+ * @thread: receiving thread
+ * @latency_ns: time since it was queued
+ */
+TRACE_EVENT(binder_transaction_received,
+
+	TP_PROTO(int debug_id, int proc, int thread, u64 latency_ns),
+
+	TP_ARGS(debug_id, proc, thread, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(	int,	debug_id	)
+		__field(	int,	proc		)
+		__field(	int,	thread		)
+		__field(	u64,	latency_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->proc		= proc;
+		__entry->thread		= thread;
+		__entry->latency_ns	= latency_ns;
+	),
+
+	TP_printk("transaction=%d thread=%d:%d latency_ns=%llu",
+		  __entry->debug_id, __entry->proc, __entry->thread,
+		  (unsigned long long)__entry->latency_ns)
+);
+
+/**
+ * binder_transaction_buffer_free - BC_FREE_BUFFER released a buffer
+ * @debug_id: id of the transaction that delivered the buffer
+ * @proc: process freeing it
+ * @size: data plus offsets size
+ */
+TRACE_EVENT(binder_transaction_buffer_free,
+
+	TP_PROTO(int debug_id, int proc, size_t size),
+
+	TP_ARGS(debug_id, proc, size),
+
+	TP_STRUCT__entry(
+		__field(	int,	debug_id	)
+		__field(	int,	proc		)
+		__field(	size_t,	size		)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id	= debug_id;
+		__entry->proc		= proc;
+		__entry->size		= size;
+	),
+
+	TP_printk("transaction=%d proc=%d size=%zu",
+		  __entry->debug_id, __entry->proc, __entry->size)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,72 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/**
+ * lowmem_kill - the low memory killer sent SIGKILL
+ * @task: victim
+ * @oom_adj: its oom_adj
+ * @tasksize: its rss in pages
+ * @pressure: killed because of reclaim pressure, not a minfree level
+ */
+TRACE_EVENT(lowmem_kill,
+
+	TP_PROTO(struct task_struct *task, int oom_adj, int tasksize,
+		 int pressure),
+
+	TP_ARGS(task, oom_adj, tasksize, pressure),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	int,	oom_adj			)
+		__field(	int,	tasksize		)
+		__field(	int,	pressure		)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+		__entry->pid		= task->pid;
+		__entry->oom_adj	= oom_adj;
+		__entry->tasksize	= tasksize;
+		__entry->pressure	= pressure;
+	),
+
+	TP_printk("pid=%d comm=%s adj=%d size=%d reason=%s",
+		  __entry->pid, __entry->comm, __entry->oom_adj,
+		  __entry->tasksize, __entry->pressure ? "pressure" : "minfree")
+);
+
+/**
+ * lowmem_kill_done - the victim's task_struct was freed
+ * @pid: victim
+ * @latency_us: time since the kill was sent
+ */
+TRACE_EVENT(lowmem_kill_done,
+
+	TP_PROTO(pid_t pid, u32 latency_us),
+
+	TP_ARGS(pid, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,	pid		)
+		__field(	u32,	latency_us	)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= pid;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("pid=%d latency_us=%u", __entry->pid, __entry->latency_us)
+);
+
+#endif /* _TRACE_LOWMEMORYKILLER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,254 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mmc
+
+#if !defined(_TRACE_MMC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MMC_H
+
+#include <linux/mmc/core.h>
+#include <linux/mmc/host.h>
+#include <linux/tracepoint.h>
+
+/**
+ * mmc_request_start - the core handed a request to the host driver
+ * @host: host it was started on
+ * @mrq: the request
+ */
+TRACE_EVENT(mmc_request_start,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_request *mrq),
+
+	TP_ARGS(host, mrq),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		opcode			)
+		__field(	u32,		arg			)
+		__field(	unsigned int,	blocks			)
+		__field(	unsigned int,	blksz			)
+		__field(	unsigned int,	flags			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->opcode	= mrq->cmd->opcode;
+		__entry->arg	= mrq->cmd->arg;
+		__entry->blocks	= mrq->data ? mrq->data->blocks : 0;
+		__entry->blksz	= mrq->data ? mrq->data->blksz : 0;
+		__entry->flags	= mrq->data ? mrq->data->flags : 0;
+	),
+
+	TP_printk("%s: CMD%u arg=%08x blocks=%u blksz=%u %s",
+		  __get_str(name), __entry->opcode, __entry->arg,
+		  __entry->blocks, __entry->blksz,
+		  __entry->flags & MMC_DATA_READ ? "read" :
+		  __entry->flags & MMC_DATA_WRITE ? "write" : "none")
+);
+
+/**
+ * mmc_request_done - the host driver completed a request
+ * @host: host it ran on
+ * @mrq: the request
+ * @latency_us: time since mmc_request_start
+ */
+TRACE_EVENT(mmc_request_done,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_request *mrq,
+		 u32 latency_us),
+
+	TP_ARGS(host, mrq, latency_us),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		opcode			)
+		__field(	int,		cmd_err			)
+		__field(	int,		data_err		)
+		__field(	unsigned int,	bytes			)
+		__field(	u32,		latency_us		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->opcode		= mrq->cmd->opcode;
+		__entry->cmd_err	= mrq->cmd->error;
+		__entry->data_err	= mrq->data ? mrq->data->error : 0;
+		__entry->bytes		= mrq->data ?
+					  mrq->data->bytes_xfered : 0;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("%s: CMD%u err=%d data_err=%d bytes=%u latency_us=%u",
+		  __get_str(name), __entry->opcode, __entry->cmd_err,
+		  __entry->data_err, __entry->bytes, __entry->latency_us)
+);
+
+DECLARE_EVENT_CLASS(mmc_host_cmd,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_command *cmd),
+
+	TP_ARGS(host, cmd),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		opcode			)
+		__field(	u32,		arg			)
+		__field(	u32,		resp			)
+		__field(	int,		error			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->opcode	= cmd->opcode;
+		__entry->arg	= cmd->arg;
+		__entry->resp	= cmd->resp[0];
+		__entry->error	= cmd->error;
+	),
+
+	TP_printk("%s: CMD%u arg=%08x resp=%08x err=%d",
+		  __get_str(name), __entry->opcode, __entry->arg,
+		  __entry->resp, __entry->error)
+);
+
+/**
+ * mmc_cmd_issue - a host driver wrote a command to the controller
+ * @host: host
+ * @cmd: the command
+ */
+DEFINE_EVENT(mmc_host_cmd, mmc_cmd_issue,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_command *cmd),
+
+	TP_ARGS(host, cmd)
+);
+
+/**
+ * mmc_cmd_done - a host driver got the response of a command
+ * @host: host
+ * @cmd: the command
+ */
+DEFINE_EVENT(mmc_host_cmd, mmc_cmd_done,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_command *cmd),
+
+	TP_ARGS(host, cmd)
+);
+
+/**
+ * mmc_data_start - a host driver set up a data transfer
+ * @host: host
+ * @data: the transfer
+ * @mode: how the data is moved, e.g. "pio", "sdma", "adma"
+ */
+TRACE_EVENT(mmc_data_start,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_data *data,
+		 const char *mode),
+
+	TP_ARGS(host, data, mode),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	unsigned int,	blocks			)
+		__field(	unsigned int,	blksz			)
+		__field(	unsigned int,	sg_len			)
+		__field(	int,		write			)
+		__field(	const char *,	mode			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->blocks	= data->blocks;
+		__entry->blksz	= data->blksz;
+		__entry->sg_len	= data->sg_len;
+		__entry->write	= !!(data->flags & MMC_DATA_WRITE);
+		__entry->mode	= mode;
+	),
+
+	TP_printk("%s: %s blocks=%u blksz=%u sg_len=%u mode=%s",
+		  __get_str(name), __entry->write ? "write" : "read",
+		  __entry->blocks, __entry->blksz, __entry->sg_len,
+		  __entry->mode)
+);
+
+/**
+ * mmc_data_done - a host driver finished a data transfer
+ * @host: host
+ * @data: the transfer
+ */
+TRACE_EVENT(mmc_data_done,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_data *data),
+
+	TP_ARGS(host, data),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	unsigned int,	bytes			)
+		__field(	int,		error			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->bytes	= data->bytes_xfered;
+		__entry->error	= data->error;
+	),
+
+	TP_printk("%s: bytes=%u err=%d", __get_str(name), __entry->bytes,
+		  __entry->error)
+);
+
+/**
+ * mmc_dma_done - an external DMA engine reported the end of a transfer
+ * @host: host
+ * @error: what the DMA engine reported
+ * @count: bytes it moved
+ */
+TRACE_EVENT(mmc_dma_done,
+
+	TP_PROTO(struct mmc_host *host, int error, unsigned int count),
+
+	TP_ARGS(host, error, count),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	int,		error			)
+		__field(	unsigned int,	count			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->error	= error;
+		__entry->count	= count;
+	),
+
+	TP_printk("%s: count=%u err=%d", __get_str(name), __entry->count,
+		  __entry->error)
+);
+
+/**
+ * mmc_finish_work - a host driver's completion work started to run
+ * @host: host
+ * @delay_us: time since the interrupt handler queued it
+ */
+TRACE_EVENT(mmc_finish_work,
+
+	TP_PROTO(struct mmc_host *host, u32 delay_us),
+
+	TP_ARGS(host, delay_us),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		delay_us		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->delay_us	= delay_us;
+	),
+
+	TP_printk("%s: delay_us=%u", __get_str(name), __entry->delay_us)
+);
+
+#endif /* _TRACE_MMC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
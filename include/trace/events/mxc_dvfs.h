@@ -0,0 +1,71 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mxc_dvfs
+
+#if !defined(_TRACE_MXC_DVFS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MXC_DVFS_H
+
+#include <linux/tracepoint.h>
+
+/**
+ * dvfs_transition - a DVFS domain moved to another working point
+ * @domain: "core" or "per"
+ * @from: previous working point
+ * @to: new working point, lower is faster
+ * @latency_us: time spent switching clocks and voltage
+ */
+TRACE_EVENT(dvfs_transition,
+
+	TP_PROTO(const char *domain, int from, int to, u32 latency_us),
+
+	TP_ARGS(domain, from, to, latency_us),
+
+	TP_STRUCT__entry(
+		__string(	domain,		domain		)
+		__field(	int,		from		)
+		__field(	int,		to		)
+		__field(	u32,		latency_us	)
+	),
+
+	TP_fast_assign(
+		__assign_str(domain, domain);
+		__entry->from		= from;
+		__entry->to		= to;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("domain=%s wp=%d->%d latency_us=%u", __get_str(domain),
+		  __entry->from, __entry->to, __entry->latency_us)
+);
+
+/**
+ * dvfs_hold - a step-down request was ignored by the hysteresis
+ * @domain: "core" or "per"
+ * @wp: working point being held
+ * @hold_ms: current minimum residency after a step-up
+ */
+TRACE_EVENT(dvfs_hold,
+
+	TP_PROTO(const char *domain, int wp, u32 hold_ms),
+
+	TP_ARGS(domain, wp, hold_ms),
+
+	TP_STRUCT__entry(
+		__string(	domain,		domain		)
+		__field(	int,		wp		)
+		__field(	u32,		hold_ms		)
+	),
+
+	TP_fast_assign(
+		__assign_str(domain, domain);
+		__entry->wp		= wp;
+		__entry->hold_ms	= hold_ms;
+	),
+
+	TP_printk("domain=%s wp=%d hold_ms=%u", __get_str(domain),
+		  __entry->wp, __entry->hold_ms)
+);
+
+#endif /* _TRACE_MXC_DVFS_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,157 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mxc_epdc
+
+#if !defined(_TRACE_MXC_EPDC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MXC_EPDC_H
+
+#include <linux/mxcfb.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(mxc_epdc_update,
+
+	TP_PROTO(u32 id, u32 waveform_mode, u32 update_mode,
+		 struct mxcfb_rect *region),
+
+	TP_ARGS(id, waveform_mode, update_mode, region),
+
+	TP_STRUCT__entry(
+		__field(	u32,	id		)
+		__field(	u32,	waveform_mode	)
+		__field(	u32,	update_mode	)
+		__field(	u32,	left		)
+		__field(	u32,	top		)
+		__field(	u32,	width		)
+		__field(	u32,	height		)
+	),
+
+	TP_fast_assign(
+		__entry->id		= id;
+		__entry->waveform_mode	= waveform_mode;
+		__entry->update_mode	= update_mode;
+		__entry->left		= region->left;
+		__entry->top		= region->top;
+		__entry->width		= region->width;
+		__entry->height		= region->height;
+	),
+
+	TP_printk("id=%u waveform=%u mode=%s region=%ux%u+%u+%u",
+		  __entry->id, __entry->waveform_mode,
+		  __entry->update_mode == UPDATE_MODE_FULL ? "full" : "partial",
+		  __entry->width, __entry->height,
+		  __entry->left, __entry->top)
+);
+
+/**
+ * mxc_epdc_send_update - update request accepted by the driver
+ * @id: update marker supplied by the caller (0 if none)
+ * @waveform_mode: requested waveform, may be WAVEFORM_MODE_AUTO
+ * @update_mode: UPDATE_MODE_FULL or UPDATE_MODE_PARTIAL
+ * @region: update region in framebuffer coordinates
+ */
+DEFINE_EVENT(mxc_epdc_update, mxc_epdc_send_update,
+
+	TP_PROTO(u32 id, u32 waveform_mode, u32 update_mode,
+		 struct mxcfb_rect *region),
+
+	TP_ARGS(id, waveform_mode, update_mode, region)
+);
+
+/**
+ * mxc_epdc_submit_update - update handed to the EPDC
+ * @id: LUT driving the update
+ * @waveform_mode: waveform actually used
+ * @update_mode: UPDATE_MODE_FULL or UPDATE_MODE_PARTIAL
+ * @region: update region in panel coordinates
+ */
+DEFINE_EVENT(mxc_epdc_update, mxc_epdc_submit_update,
+
+	TP_PROTO(u32 id, u32 waveform_mode, u32 update_mode,
+		 struct mxcfb_rect *region),
+
+	TP_ARGS(id, waveform_mode, update_mode, region)
+);
+
+DECLARE_EVENT_CLASS(mxc_epdc_order,
+
+	TP_PROTO(u32 order, u32 arg),
+
+	TP_ARGS(order, arg),
+
+	TP_STRUCT__entry(
+		__field(	u32,	order	)
+		__field(	u32,	arg	)
+	),
+
+	TP_fast_assign(
+		__entry->order	= order;
+		__entry->arg	= arg;
+	),
+
+	TP_printk("order=%u arg=0x%x", __entry->order, __entry->arg)
+);
+
+/**
+ * mxc_epdc_pxp_submit - PxP processing started for an update
+ * @order: update order number
+ * @arg: requested waveform mode
+ */
+DEFINE_EVENT(mxc_epdc_order, mxc_epdc_pxp_submit,
+
+	TP_PROTO(u32 order, u32 arg),
+
+	TP_ARGS(order, arg)
+);
+
+/**
+ * mxc_epdc_pxp_complete - PxP processing finished for an update
+ * @order: update order number
+ * @arg: PxP histogram status
+ */
+DEFINE_EVENT(mxc_epdc_order, mxc_epdc_pxp_complete,
+
+	TP_PROTO(u32 order, u32 arg),
+
+	TP_ARGS(order, arg)
+);
+
+/**
+ * mxc_epdc_lut_assign - LUT chosen for an update
+ * @order: update order number
+ * @arg: LUT number
+ */
+DEFINE_EVENT(mxc_epdc_order, mxc_epdc_lut_assign,
+
+	TP_PROTO(u32 order, u32 arg),
+
+	TP_ARGS(order, arg)
+);
+
+/**
+ * mxc_epdc_lut_complete - LUT complete interrupt
+ * @lut: completed LUT
+ * @latency_us: time since the update on this LUT was sent, or -1
+ */
+TRACE_EVENT(mxc_epdc_lut_complete,
+
+	TP_PROTO(u32 lut, s64 latency_us),
+
+	TP_ARGS(lut, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,	lut		)
+		__field(	s64,	latency_us	)
+	),
+
+	TP_fast_assign(
+		__entry->lut		= lut;
+		__entry->latency_us	= latency_us;
+	),
+
+	TP_printk("lut=%u latency=%lldus", __entry->lut,
+		  (long long)__entry->latency_us)
+);
+
+#endif /* _TRACE_MXC_EPDC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
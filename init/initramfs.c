@@ -8,6 +8,7 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/ktime.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -384,6 +385,8 @@ static int __init write_buffer(char *buf, unsigned len)
 	return len - count;
 }
 
+static unsigned long __initdata unpacked_bytes;
+
 static int __init flush_buffer(void *bufv, unsigned len)
 {
 	char *buf = (char *) bufv;
@@ -391,6 +394,7 @@ static int __init flush_buffer(void *bufv, unsigned len)
 	int origLen = len;
 	if (message)
 		return -1;
+	unpacked_bytes += len;
 	while ((written = write_buffer(buf, len)) < len && !message) {
 		char c = buf[written];
 		if (c == '0') {
@@ -446,10 +450,18 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 		this_header = 0;
 		decompress = decompress_method(buf, len, &compress_name);
 		if (decompress) {
+			ktime_t start = ktime_get();
+
+			unpacked_bytes = 0;
 			res = decompress(buf, len, NULL, flush_buffer, NULL,
 				   &my_inptr, error);
 			if (res)
 				error("decompressor failed");
+			else
+				printk(KERN_INFO "initramfs: %s %u -> %lu bytes "
+				       "in %lld usecs\n", compress_name, my_inptr,
+				       unpacked_bytes,
+				       ktime_to_us(ktime_sub(ktime_get(), start)));
 		} else if (compress_name) {
 			if (!message) {
 				snprintf(msg_buf, sizeof msg_buf,
@@ -21,6 +21,7 @@
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/hrtimer.h>
 
 enum freezer_state {
 	CGROUP_THAWED = 0,
@@ -32,6 +33,15 @@ struct freezer {
 	struct cgroup_subsys_state css;
 	enum freezer_state state;
 	spinlock_t lock; /* protects _writes_ to state */
+
+	/* freezer.stats, protected by lock */
+	ktime_t freeze_start;
+	unsigned long nr_freeze;
+	unsigned long nr_thaw;
+	s64 freeze_last_us;
+	s64 freeze_max_us;
+	s64 thaw_last_us;
+	s64 thaw_max_us;
 };
 
 static inline struct freezer *cgroup_freezer(
@@ -255,9 +265,16 @@ static void update_freezer_state(struct cgroup *cgroup,
 	 * that we never exist in the FROZEN state while there are unfrozen
 	 * tasks.
 	 */
-	if (nfrozen == ntotal)
+	if (nfrozen == ntotal) {
+		if (freezer->state == CGROUP_FREEZING) {
+			/* seen on the first read or write after the fact */
+			freezer->freeze_last_us = ktime_us_delta(ktime_get(),
+						freezer->freeze_start);
+			if (freezer->freeze_last_us > freezer->freeze_max_us)
+				freezer->freeze_max_us = freezer->freeze_last_us;
+		}
 		freezer->state = CGROUP_FROZEN;
-	else if (nfrozen > 0)
+	} else if (nfrozen > 0)
 		freezer->state = CGROUP_FREEZING;
 	else
 		freezer->state = CGROUP_THAWED;
@@ -296,6 +313,10 @@ static int try_to_freeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 	struct task_struct *task;
 	unsigned int num_cant_freeze_now = 0;
 
+	if (freezer->state == CGROUP_THAWED) {
+		freezer->freeze_start = ktime_get();
+		freezer->nr_freeze++;
+	}
 	freezer->state = CGROUP_FREEZING;
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
@@ -315,6 +336,7 @@ static void unfreeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 {
 	struct cgroup_iter it;
 	struct task_struct *task;
+	ktime_t start = ktime_get();
 
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
@@ -323,6 +345,10 @@ static void unfreeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 	cgroup_iter_end(cgroup, &it);
 
 	freezer->state = CGROUP_THAWED;
+	freezer->nr_thaw++;
+	freezer->thaw_last_us = ktime_us_delta(ktime_get(), start);
+	if (freezer->thaw_last_us > freezer->thaw_max_us)
+		freezer->thaw_max_us = freezer->thaw_last_us;
 }
 
 static int freezer_change_state(struct cgroup *cgroup,
@@ -335,7 +361,13 @@ static int freezer_change_state(struct cgroup *cgroup,
 
 	spin_lock_irq(&freezer->lock);
 
-	update_freezer_state(cgroup, freezer);
+	/*
+	 * Only FREEZING is resolved lazily; THAWED and FROZEN can't change
+	 * behind our back (attach and fork are fenced off), so a thaw of a
+	 * frozen group doesn't have to walk its tasks twice.
+	 */
+	if (freezer->state == CGROUP_FREEZING)
+		update_freezer_state(cgroup, freezer);
 	if (goal_state == freezer->state)
 		goto out;
 
@@ -376,12 +408,43 @@ static int freezer_write(struct cgroup *cgroup,
 	return retval;
 }
 
+static int freezer_stats_read(struct cgroup *cgroup, struct cftype *cft,
+			      struct seq_file *m)
+{
+	struct freezer *freezer;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	freezer = cgroup_freezer(cgroup);
+	spin_lock_irq(&freezer->lock);
+	if (freezer->state == CGROUP_FREEZING)
+		update_freezer_state(cgroup, freezer);
+	seq_printf(m, "freezes %lu\n"
+		   "freeze_last_us %lld\n"
+		   "freeze_max_us %lld\n"
+		   "thaws %lu\n"
+		   "thaw_last_us %lld\n"
+		   "thaw_max_us %lld\n",
+		   freezer->nr_freeze, freezer->freeze_last_us,
+		   freezer->freeze_max_us, freezer->nr_thaw,
+		   freezer->thaw_last_us, freezer->thaw_max_us);
+	spin_unlock_irq(&freezer->lock);
+	cgroup_unlock();
+
+	return 0;
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
 	},
+	{
+		.name = "stats",
+		.read_seq_string = freezer_stats_read,
+	},
 };
 
 static int freezer_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
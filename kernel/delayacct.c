@@ -19,8 +19,14 @@
 #include <linux/time.h>
 #include <linux/sysctl.h>
 #include <linux/delayacct.h>
+#include <linux/ktime.h>
 
-int delayacct_on __read_mostly = 1;	/* Delay accounting turned on/off */
+/*
+ * Delay accounting turned on/off, also at run time through the
+ * kernel.task_delayacct sysctl: every task gets its task_delay_info so
+ * turning it on counts the tasks that already run too.
+ */
+int delayacct_on __read_mostly = 1;
 struct kmem_cache *delayacct_cache;
 
 static int __init delayacct_setup_disable(char *str)
@@ -48,26 +54,26 @@ void __delayacct_tsk_init(struct task_struct *tsk)
  * its starting timestamp (@start)
  */
 
-static inline void delayacct_start(struct timespec *start)
+static inline void delayacct_start(u64 *start)
 {
-	do_posix_clock_monotonic_gettime(start);
+	*start = delayacct_on ? ktime_to_ns(ktime_get()) : 0;
 }
 
 /*
- * Finish delay accounting for a statistic using
- * its timestamps (@start, @end), accumalator (@total) and @count
+ * Finish delay accounting for a statistic using its start timestamp
+ * (@start), accumalator (@total) and @count.  Only the aggregates are
+ * kept; a delay that started while accounting was off is not counted.
  */
 
-static void delayacct_end(struct timespec *start, struct timespec *end,
-				u64 *total, u32 *count)
+static void delayacct_end(u64 *start, u64 *total, u32 *count)
 {
-	struct timespec ts;
 	s64 ns;
 	unsigned long flags;
 
-	do_posix_clock_monotonic_gettime(end);
-	ts = timespec_sub(*end, *start);
-	ns = timespec_to_ns(&ts);
+	if (!*start)
+		return;
+	ns = ktime_to_ns(ktime_get()) - *start;
+	*start = 0;
 	if (ns < 0)
 		return;
 
@@ -87,12 +93,10 @@ void __delayacct_blkio_end(void)
 	if (current->delays->flags & DELAYACCT_PF_SWAPIN)
 		/* Swapin block I/O */
 		delayacct_end(&current->delays->blkio_start,
-			&current->delays->blkio_end,
 			&current->delays->swapin_delay,
 			&current->delays->swapin_count);
 	else	/* Other block I/O */
 		delayacct_end(&current->delays->blkio_start,
-			&current->delays->blkio_end,
 			&current->delays->blkio_delay,
 			&current->delays->blkio_count);
 }
@@ -177,7 +181,6 @@ void __delayacct_freepages_start(void)
 void __delayacct_freepages_end(void)
 {
 	delayacct_end(&current->delays->freepages_start,
-			&current->delays->freepages_end,
 			&current->delays->freepages_delay,
 			&current->delays->freepages_count);
 }
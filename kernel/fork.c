@@ -65,6 +65,7 @@
 #include <linux/perf_event.h>
 #include <linux/posix-timers.h>
 #include <linux/user-return-notifier.h>
+#include <linux/oom.h>
 
 #include <asm/pgtable.h>
 #include <asm/pgalloc.h>
@@ -323,6 +324,7 @@ static int dup_mmap(struct mm_struct *mm, struct mm_struct *oldmm)
 	int retval;
 	unsigned long charge;
 	struct mempolicy *pol;
+	ktime_t start = ktime_get();
 
 	down_write(&oldmm->mmap_sem);
 	flush_cache_dup_mm(oldmm);
@@ -431,6 +433,8 @@ out:
 	up_write(&mm->mmap_sem);
 	flush_tlb_mm(oldmm);
 	up_write(&oldmm->mmap_sem);
+	count_vm_event(FORK_MM);
+	count_vm_events(FORK_MM_US, ktime_to_us(ktime_sub(ktime_get(), start)));
 	return retval;
 fail_nomem_anon_vma_fork:
 	mpol_put(pol);
@@ -1025,6 +1029,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 	if (!p)
 		goto fork_out;
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	INIT_HLIST_NODE(&p->lmk_adj_node);
+#endif
 	ftrace_graph_init_task(p);
 
 	rt_mutex_init_task(p);
@@ -1290,6 +1297,7 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 			attach_pid(p, PIDTYPE_SID, task_session(current));
 			list_add_tail(&p->sibling, &p->real_parent->children);
 			list_add_tail_rcu(&p->tasks, &init_task.tasks);
+			lowmem_index_add(p);
 			__get_cpu_var(process_counts)++;
 		}
 		attach_pid(p, PIDTYPE_PID, pid);
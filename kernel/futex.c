@@ -59,6 +59,11 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 
 #include <asm/futex.h>
 
@@ -66,7 +71,12 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * The hash is sized from memory at boot, one bucket per 256KB of lowmem
+ * (2048 on a 512MB board), unless futex_hash_entries= says otherwise.
+ */
+#define FUTEX_HASH_SCALE	18
+#define FUTEX_HASH_MAX		(1 << 14)
 
 /*
  * Priority Inheritance state:
@@ -130,9 +140,106 @@ struct futex_q {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
+#ifdef CONFIG_FUTEX_STATS
+	u32 waits;		/* tasks queued here */
+	u32 wakes;		/* futex_wake calls that woke someone */
+	u32 collisions;		/* queued behind a different futex */
+	u32 contended;		/* lock was busy */
+#endif
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+static struct futex_hash_bucket *futex_queues;
+static unsigned int futex_hashshift;
+static unsigned long futex_hash_entries __initdata;
+
+static int __init set_futex_hash_entries(char *str)
+{
+	if (str)
+		futex_hash_entries = simple_strtoul(str, &str, 0);
+	return 1;
+}
+__setup("futex_hash_entries=", set_futex_hash_entries);
+
+#ifdef CONFIG_FUTEX_STATS
+/*
+ * Contention statistics.  Buckets count waits, wakes, hash collisions
+ * and lock contention.  Waits are also accounted per (process, futex
+ * address) in a small table, so the futexes a process convoys on can
+ * be listed.  When the table is full around a new address, the least
+ * waited on entry nearby is recycled, which keeps the heavy hitters.
+ */
+#define FUTEX_STAT_SLOTS	256
+#define FUTEX_STAT_PROBE	8
+#define FUTEX_STAT_TOP		20
+
+struct futex_stat {
+	pid_t tgid;
+	unsigned long uaddr;
+	u32 waits;
+	u32 pi;			/* waits that blocked on a PI futex */
+	u64 wait_ns;
+	u64 max_ns;
+};
+
+static DEFINE_SPINLOCK(futex_stat_lock);
+static struct futex_stat futex_stats[FUTEX_STAT_SLOTS];
+
+static void futex_stat_wait(u32 __user *uaddr, ktime_t start, int pi)
+{
+	unsigned long addr = (unsigned long)uaddr;
+	pid_t tgid = current->tgid;
+	u32 h = jhash_2words(tgid, addr, 0);
+	struct futex_stat *st, *victim = NULL;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	int i;
+
+	spin_lock(&futex_stat_lock);
+	for (i = 0; i < FUTEX_STAT_PROBE; i++) {
+		st = &futex_stats[(h + i) % FUTEX_STAT_SLOTS];
+		if (st->waits && (st->tgid != tgid || st->uaddr != addr)) {
+			if (!victim || st->waits < victim->waits)
+				victim = st;
+			continue;
+		}
+		if (!st->waits) {
+			memset(st, 0, sizeof(*st));
+			st->tgid = tgid;
+			st->uaddr = addr;
+		}
+		victim = NULL;
+		break;
+	}
+	if (victim) {
+		st = victim;
+		memset(st, 0, sizeof(*st));
+		st->tgid = tgid;
+		st->uaddr = addr;
+	}
+	st->waits++;
+	st->pi += pi;
+	st->wait_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	spin_unlock(&futex_stat_lock);
+}
+
+static inline void futex_hb_lock(struct futex_hash_bucket *hb)
+{
+	if (!spin_trylock(&hb->lock)) {
+		hb->contended++;
+		spin_lock(&hb->lock);
+	}
+}
+#else
+static inline void futex_stat_wait(u32 __user *uaddr, ktime_t start, int pi)
+{
+}
+
+static inline void futex_hb_lock(struct futex_hash_bucket *hb)
+{
+	spin_lock(&hb->lock);
+}
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -142,7 +249,7 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	return &futex_queues[hash & ((1 << futex_hashshift)-1)];
 }
 
 /*
@@ -885,7 +992,7 @@ static int futex_wake(u32 __user *uaddr, int fshared, int nr_wake, u32 bitset)
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 	head = &hb->chain;
 
 	plist_for_each_entry_safe(this, next, head, list) {
@@ -905,6 +1012,10 @@ static int futex_wake(u32 __user *uaddr, int fshared, int nr_wake, u32 bitset)
 		}
 	}
 
+#ifdef CONFIG_FUTEX_STATS
+	if (ret > 0)
+		hb->wakes++;
+#endif
 	spin_unlock(&hb->lock);
 	put_futex_key(fshared, &key);
 out:
@@ -1367,7 +1478,7 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 	hb = hash_futex(&q->key);
 	q->lock_ptr = &hb->lock;
 
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 	return hb;
 }
 
@@ -1407,6 +1518,16 @@ static inline void queue_me(struct futex_q *q, struct futex_hash_bucket *hb)
 	plist_node_init(&q->list, prio);
 #ifdef CONFIG_DEBUG_PI_LIST
 	q->list.plist.spinlock = &hb->lock;
+#endif
+#ifdef CONFIG_FUTEX_STATS
+	hb->waits++;
+	if (!plist_head_empty(&hb->chain)) {
+		struct futex_q *first;
+
+		first = plist_first_entry(&hb->chain, struct futex_q, list);
+		if (!match_futex(&first->key, &q->key))
+			hb->collisions++;
+	}
 #endif
 	plist_add(&q->list, &hb->chain);
 	q->task = current;
@@ -1791,6 +1912,7 @@ static int futex_wait(u32 __user *uaddr, int fshared,
 	struct restart_block *restart;
 	struct futex_hash_bucket *hb;
 	struct futex_q q;
+	ktime_t start;
 	int ret;
 
 	if (!bitset)
@@ -1818,7 +1940,9 @@ retry:
 		goto out;
 
 	/* queue_me and wait for wakeup, timeout, or a signal. */
+	start = ktime_get();
 	futex_wait_queue_me(hb, &q, to);
+	futex_stat_wait(uaddr, start, 0);
 
 	/* If we were woken (and unqueued), we succeeded, whatever. */
 	ret = 0;
@@ -1898,6 +2022,7 @@ static int futex_lock_pi(u32 __user *uaddr, int fshared,
 	struct hrtimer_sleeper timeout, *to = NULL;
 	struct futex_hash_bucket *hb;
 	struct futex_q q;
+	ktime_t start;
 	int res, ret;
 
 	if (refill_pi_state_cache())
@@ -1955,9 +2080,11 @@ retry_private:
 	/*
 	 * Block on the PI mutex:
 	 */
-	if (!trylock)
+	if (!trylock) {
+		start = ktime_get();
 		ret = rt_mutex_timed_lock(&q.pi_state->pi_mutex, to, 1);
-	else {
+		futex_stat_wait(uaddr, start, 1);
+	} else {
 		ret = rt_mutex_trylock(&q.pi_state->pi_mutex);
 		/* Fixup the trylock return value: */
 		ret = ret ? 0 : -EWOULDBLOCK;
@@ -2040,7 +2167,7 @@ retry:
 		goto out;
 
 	hb = hash_futex(&key);
-	spin_lock(&hb->lock);
+	futex_hb_lock(hb);
 
 	/*
 	 * To avoid races, try to do the TID -> 0 atomic transition
@@ -2654,7 +2781,17 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+	if (CONFIG_BASE_SMALL && !futex_hash_entries)
+		futex_hash_entries = 16;
+	futex_queues = alloc_large_system_hash("futex",
+					       sizeof(struct futex_hash_bucket),
+					       futex_hash_entries,
+					       FUTEX_HASH_SCALE, 0,
+					       &futex_hashshift, NULL,
+					       FUTEX_HASH_MAX);
+
+	for (i = 0; i < (1 << futex_hashshift); i++) {
+		memset(&futex_queues[i], 0, sizeof(futex_queues[i]));
 		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -2662,3 +2799,145 @@ static int __init futex_init(void)
 	return 0;
 }
 __initcall(futex_init);
+
+#ifdef CONFIG_FUTEX_STATS
+static int futex_top_cmp(const void *a, const void *b)
+{
+	const struct futex_stat *x = a, *y = b;
+
+	if (x->wait_ns != y->wait_ns)
+		return x->wait_ns < y->wait_ns ? 1 : -1;
+	return 0;
+}
+
+static int futex_top_show(struct seq_file *m, void *v)
+{
+	struct futex_stat *top;
+	struct task_struct *p;
+	int i, n = 0;
+
+	top = vmalloc(sizeof(futex_stats));
+	if (!top)
+		return -ENOMEM;
+
+	spin_lock(&futex_stat_lock);
+	for (i = 0; i < FUTEX_STAT_SLOTS; i++)
+		if (futex_stats[i].waits)
+			top[n++] = futex_stats[i];
+	spin_unlock(&futex_stat_lock);
+
+	sort(top, n, sizeof(*top), futex_top_cmp, NULL);
+
+	seq_printf(m, "%-6s %-16s %-10s %8s %6s %10s %10s\n", "tgid", "comm",
+		   "uaddr", "waits", "pi", "avg_us", "max_us");
+	for (i = 0; i < min(n, FUTEX_STAT_TOP); i++) {
+		char comm[TASK_COMM_LEN] = "-";
+
+		rcu_read_lock();
+		p = find_task_by_pid_ns(top[i].tgid, &init_pid_ns);
+		if (p)
+			get_task_comm(comm, p);
+		rcu_read_unlock();
+
+		seq_printf(m, "%-6d %-16s 0x%08lx %8u %6u %10llu %10llu\n",
+			   top[i].tgid, comm, top[i].uaddr, top[i].waits,
+			   top[i].pi, div_u64(top[i].wait_ns, top[i].waits *
+					      NSEC_PER_USEC),
+			   div_u64(top[i].max_ns, NSEC_PER_USEC));
+	}
+
+	vfree(top);
+	return 0;
+}
+
+static int futex_buckets_show(struct seq_file *m, void *v)
+{
+	u32 waits = 0, wakes = 0, collisions = 0, contended = 0, used = 0;
+	u32 busiest_waits = 0;
+	int i, busiest = -1;
+
+	for (i = 0; i < (1 << futex_hashshift); i++) {
+		struct futex_hash_bucket *hb = &futex_queues[i];
+
+		if (hb->waits)
+			used++;
+		waits += hb->waits;
+		wakes += hb->wakes;
+		collisions += hb->collisions;
+		contended += hb->contended;
+		if (hb->waits > busiest_waits) {
+			busiest_waits = hb->waits;
+			busiest = i;
+		}
+	}
+
+	seq_printf(m, "buckets:    %u (%u used)\n", 1 << futex_hashshift, used);
+	seq_printf(m, "waits:      %u\n", waits);
+	seq_printf(m, "wakes:      %u\n", wakes);
+	seq_printf(m, "collisions: %u\n", collisions);
+	seq_printf(m, "contended:  %u\n", contended);
+	if (busiest >= 0)
+		seq_printf(m, "busiest:    %d (%u waits, %u collisions)\n",
+			   busiest, busiest_waits,
+			   futex_queues[busiest].collisions);
+	return 0;
+}
+
+static int futex_top_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_top_show, NULL);
+}
+
+static int futex_buckets_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_buckets_show, NULL);
+}
+
+/* Any write clears all the statistics */
+static ssize_t futex_stats_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	int i;
+
+	spin_lock(&futex_stat_lock);
+	memset(futex_stats, 0, sizeof(futex_stats));
+	spin_unlock(&futex_stat_lock);
+
+	for (i = 0; i < (1 << futex_hashshift); i++) {
+		struct futex_hash_bucket *hb = &futex_queues[i];
+
+		spin_lock(&hb->lock);
+		hb->waits = hb->wakes = hb->collisions = hb->contended = 0;
+		spin_unlock(&hb->lock);
+	}
+	return count;
+}
+
+static const struct file_operations futex_top_fops = {
+	.open		= futex_top_open,
+	.read		= seq_read,
+	.write		= futex_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations futex_buckets_fops = {
+	.open		= futex_buckets_open,
+	.read		= seq_read,
+	.write		= futex_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init futex_stats_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("futex", NULL);
+
+	if (!dir)
+		return 0;
+	debugfs_create_file("top", 0644, dir, NULL, &futex_top_fops);
+	debugfs_create_file("buckets", 0644, dir, NULL, &futex_buckets_fops);
+	return 0;
+}
+late_initcall(futex_stats_init);
+#endif
@@ -369,6 +369,8 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 {
 	irqreturn_t ret, retval = IRQ_NONE;
 	unsigned int status = 0;
+	struct irq_stats *stats = irq_stats_get(irq_to_desc(irq));
+	u64 start = irq_stats_clock(stats);
 
 	do {
 		trace_irq_handler_entry(irq, action);
@@ -403,6 +405,7 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 			if (likely(!test_bit(IRQTF_DIED,
 					     &action->thread_flags))) {
 				set_bit(IRQTF_RUNTHREAD, &action->thread_flags);
+				irq_stats_woken(stats);
 				wake_up_process(action->thread);
 			}
 
@@ -419,6 +422,8 @@ irqreturn_t handle_IRQ_event(unsigned int irq, struct irqaction *action)
 		action = action->next;
 	} while (action);
 
+	irq_stats_handler(stats, start);
+
 	if (status & IRQF_SAMPLE_RANDOM)
 		add_interrupt_randomness(irq);
 	local_irq_disable();
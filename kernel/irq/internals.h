@@ -38,6 +38,93 @@ static inline void unregister_handler_proc(unsigned int irq,
 
 extern int irq_select_affinity_usr(unsigned int irq);
 
+#ifdef CONFIG_IRQ_STATS
+#include <linux/sched.h>
+
+/*
+ * Handler time, hardirq to thread latency and thread time of an irq,
+ * collected while /proc/irq/<irq>/stats is switched on.
+ */
+#define IRQ_STAT_BUCKETS	16	/* [2^(n-1), 2^n) us, last open */
+
+struct irq_stat_hist {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+	u32 hist[IRQ_STAT_BUCKETS];
+};
+
+struct irq_stats {
+	u64 woken;			/* sched_clock() at thread wakeup */
+	struct irq_stat_hist handler;
+	struct irq_stat_hist thread_latency;
+	struct irq_stat_hist thread_run;
+};
+
+static inline struct irq_stats *irq_stats_get(struct irq_desc *desc)
+{
+	return ACCESS_ONCE(desc->stats);
+}
+
+static inline u64 irq_stats_clock(struct irq_stats *stats)
+{
+	return stats ? sched_clock() : 0;
+}
+
+static inline void irq_stat_add(struct irq_stat_hist *h, u64 start, u64 end)
+{
+	s64 ns = end - start;	/* sched_clock() may wrap */
+	u32 us = ns < 0 ? 0 : (u32)min_t(s64, ns, UINT_MAX) / NSEC_PER_USEC;
+
+	h->hist[min(fls(us), IRQ_STAT_BUCKETS - 1)]++;
+	h->count++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+}
+
+static inline void irq_stats_handler(struct irq_stats *stats, u64 start)
+{
+	if (stats)
+		irq_stat_add(&stats->handler, start, sched_clock());
+}
+
+static inline void irq_stats_woken(struct irq_stats *stats)
+{
+	if (stats)
+		stats->woken = sched_clock();
+}
+
+static inline void irq_stats_thread_start(struct irq_stats *stats, u64 start)
+{
+	if (stats && stats->woken) {
+		irq_stat_add(&stats->thread_latency, stats->woken, start);
+		stats->woken = 0;
+	}
+}
+
+static inline void irq_stats_thread_end(struct irq_stats *stats, u64 start)
+{
+	if (stats)
+		irq_stat_add(&stats->thread_run, start, sched_clock());
+}
+#else
+struct irq_stats;
+
+static inline struct irq_stats *irq_stats_get(struct irq_desc *desc)
+{
+	return NULL;
+}
+
+static inline u64 irq_stats_clock(struct irq_stats *stats) { return 0; }
+static inline void irq_stats_handler(struct irq_stats *stats, u64 start) { }
+static inline void irq_stats_woken(struct irq_stats *stats) { }
+static inline void irq_stats_thread_start(struct irq_stats *stats,
+					  u64 start) { }
+static inline void irq_stats_thread_end(struct irq_stats *stats,
+					u64 start) { }
+#endif
+
 extern void irq_set_thread_affinity(struct irq_desc *desc);
 
 /* Inline functions for support of irq chips on slow busses */
@@ -598,9 +598,14 @@ static int irq_thread(void *data)
 			desc->status |= IRQ_PENDING;
 			raw_spin_unlock_irq(&desc->lock);
 		} else {
+			struct irq_stats *stats = irq_stats_get(desc);
+			u64 start = irq_stats_clock(stats);
+
 			raw_spin_unlock_irq(&desc->lock);
 
+			irq_stats_thread_start(stats, start);
 			action->thread_fn(action->irq, action->dev_id);
+			irq_stats_thread_end(stats, start);
 
 			if (oneshot)
 				irq_finalize_oneshot(action->irq, desc);
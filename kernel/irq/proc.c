@@ -11,6 +11,10 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/interrupt.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/uaccess.h>
 
 #include "internals.h"
 
@@ -224,6 +228,99 @@ static const struct file_operations irq_spurious_proc_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_IRQ_STATS
+static DEFINE_MUTEX(irq_stats_mutex);
+
+static void irq_stats_show_hist(struct seq_file *m, const char *name,
+				struct irq_stat_hist *h)
+{
+	int i;
+
+	seq_printf(m, "%s %u %llu %u\n ", name, h->count,
+		   h->count ? div_u64(h->total_us, h->count) : 0, h->max_us);
+	for (i = 0; i < IRQ_STAT_BUCKETS; i++)
+		seq_printf(m, " %u", h->hist[i]);
+	seq_putc(m, '\n');
+}
+
+static int irq_stats_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+	struct irq_stats *stats;
+
+	mutex_lock(&irq_stats_mutex);
+	stats = desc->stats;
+	if (!stats) {
+		seq_printf(m, "off\n");
+		goto out;
+	}
+
+	seq_printf(m, "# count avg_us max_us\n");
+	seq_printf(m, "# histograms: <1us 1us 2us 4us ... %dus+\n",
+		   1 << (IRQ_STAT_BUCKETS - 2));
+	irq_stats_show_hist(m, "handler", &stats->handler);
+	irq_stats_show_hist(m, "thread_latency", &stats->thread_latency);
+	irq_stats_show_hist(m, "thread_run", &stats->thread_run);
+out:
+	mutex_unlock(&irq_stats_mutex);
+	return 0;
+}
+
+/*
+ * Writing 1 starts collecting, or clears what was collected so far;
+ * writing 0 stops and frees the statistics.
+ */
+static ssize_t irq_stats_proc_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *pos)
+{
+	unsigned int irq = (int)(long)PDE(file->f_path.dentry->d_inode)->data;
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irq_stats *stats, *old;
+	unsigned long flags;
+	char c;
+
+	if (!count || get_user(c, buffer))
+		return -EFAULT;
+	if (c != '0' && c != '1')
+		return -EINVAL;
+
+	stats = NULL;
+	if (c == '1') {
+		stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+		if (!stats)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&irq_stats_mutex);
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	old = desc->stats;
+	desc->stats = stats;
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	/* the handler and threads may still be using the old ones */
+	if (old) {
+		synchronize_irq(irq);
+		kfree(old);
+	}
+	mutex_unlock(&irq_stats_mutex);
+
+	return count;
+}
+
+static int irq_stats_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_stats_proc_show, PDE(inode)->data);
+}
+
+static const struct file_operations irq_stats_proc_fops = {
+	.open		= irq_stats_proc_open,
+	.read		= seq_read,
+	.write		= irq_stats_proc_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 #define MAX_NAMELEN 128
 
 static int name_unique(unsigned int irq, struct irqaction *new_action)
@@ -295,6 +392,11 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 
 	proc_create_data("spurious", 0444, desc->dir,
 			 &irq_spurious_proc_fops, (void *)(long)irq);
+
+#ifdef CONFIG_IRQ_STATS
+	proc_create_data("stats", 0600, desc->dir,
+			 &irq_stats_proc_fops, (void *)(long)irq);
+#endif
 }
 
 #undef MAX_NAMELEN
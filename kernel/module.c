@@ -55,6 +55,7 @@
 #include <linux/async.h>
 #include <linux/percpu.h>
 #include <linux/kmemleak.h>
+#include <linux/hash.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/module.h>
@@ -203,6 +204,26 @@ extern const unsigned long __start___kcrctab_unused_gpl[];
 #define symversion(base, idx) ((base != NULL) ? ((base) + (idx)) : NULL)
 #endif
 
+/* The symbols exported by the kernel itself */
+static const struct symsearch core_syms[] = {
+	{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
+	  NOT_GPL_ONLY, false },
+	{ __start___ksymtab_gpl, __stop___ksymtab_gpl,
+	  __start___kcrctab_gpl,
+	  GPL_ONLY, false },
+	{ __start___ksymtab_gpl_future, __stop___ksymtab_gpl_future,
+	  __start___kcrctab_gpl_future,
+	  WILL_BE_GPL_ONLY, false },
+#ifdef CONFIG_UNUSED_SYMBOLS
+	{ __start___ksymtab_unused, __stop___ksymtab_unused,
+	  __start___kcrctab_unused,
+	  NOT_GPL_ONLY, true },
+	{ __start___ksymtab_unused_gpl, __stop___ksymtab_unused_gpl,
+	  __start___kcrctab_unused_gpl,
+	  GPL_ONLY, true },
+#endif
+};
+
 static bool each_symbol_in_section(const struct symsearch *arr,
 				   unsigned int arrsize,
 				   struct module *owner,
@@ -222,32 +243,13 @@ static bool each_symbol_in_section(const struct symsearch *arr,
 	return false;
 }
 
-/* Returns true as soon as fn returns true, otherwise false. */
-bool each_symbol(bool (*fn)(const struct symsearch *arr, struct module *owner,
-			    unsigned int symnum, void *data), void *data)
+/* The same for the symbols exported by modules only. */
+static bool each_module_symbol(bool (*fn)(const struct symsearch *arr,
+					  struct module *owner,
+					  unsigned int symnum, void *data),
+			       void *data)
 {
 	struct module *mod;
-	const struct symsearch arr[] = {
-		{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
-		  NOT_GPL_ONLY, false },
-		{ __start___ksymtab_gpl, __stop___ksymtab_gpl,
-		  __start___kcrctab_gpl,
-		  GPL_ONLY, false },
-		{ __start___ksymtab_gpl_future, __stop___ksymtab_gpl_future,
-		  __start___kcrctab_gpl_future,
-		  WILL_BE_GPL_ONLY, false },
-#ifdef CONFIG_UNUSED_SYMBOLS
-		{ __start___ksymtab_unused, __stop___ksymtab_unused,
-		  __start___kcrctab_unused,
-		  NOT_GPL_ONLY, true },
-		{ __start___ksymtab_unused_gpl, __stop___ksymtab_unused_gpl,
-		  __start___kcrctab_unused_gpl,
-		  GPL_ONLY, true },
-#endif
-	};
-
-	if (each_symbol_in_section(arr, ARRAY_SIZE(arr), NULL, fn, data))
-		return true;
 
 	list_for_each_entry_rcu(mod, &modules, list) {
 		struct symsearch arr[] = {
@@ -277,6 +279,17 @@ bool each_symbol(bool (*fn)(const struct symsearch *arr, struct module *owner,
 	}
 	return false;
 }
+
+/* Returns true as soon as fn returns true, otherwise false. */
+bool each_symbol(bool (*fn)(const struct symsearch *arr, struct module *owner,
+			    unsigned int symnum, void *data), void *data)
+{
+	if (each_symbol_in_section(core_syms, ARRAY_SIZE(core_syms), NULL,
+				   fn, data))
+		return true;
+
+	return each_module_symbol(fn, data);
+}
 EXPORT_SYMBOL_GPL(each_symbol);
 
 struct find_symbol_arg {
@@ -333,6 +346,81 @@ static bool find_symbol_in_section(const struct symsearch *syms,
 	return true;
 }
 
+/*
+ * Hash index over core_syms[], built at boot: nearly every undefined
+ * symbol of a module is exported by the kernel, and loading one used to
+ * strcmp() its way through all of them for each.  Symbols are numbered
+ * through the core_syms[] sections in order, from 1; chains end at 0.
+ * The few symbols exported by modules are still searched in turn.
+ */
+struct ksym_index {
+	unsigned int bits;
+	unsigned int *next;		/* chain, by symbol number - 1 */
+	unsigned int head[0];		/* 1 << bits buckets */
+};
+
+static struct ksym_index *ksym_index;
+
+static unsigned int ksym_hashfn(const char *name, unsigned int bits)
+{
+	return hash_32(full_name_hash((const unsigned char *)name,
+				      strlen(name)), bits);
+}
+
+static bool find_core_symbol(struct ksym_index *idx,
+			     struct find_symbol_arg *fsa)
+{
+	unsigned int n, i, j, len;
+
+	for (n = idx->head[ksym_hashfn(fsa->name, idx->bits)]; n;
+	     n = idx->next[n - 1]) {
+		i = n - 1;
+		for (j = 0; i >= (len = core_syms[j].stop - core_syms[j].start);
+		     j++)
+			i -= len;
+		/* as the linear search: a licence mismatch keeps looking */
+		if (find_symbol_in_section(&core_syms[j], NULL, i, fsa))
+			return true;
+	}
+	return false;
+}
+
+static int __init ksym_index_init(void)
+{
+	struct ksym_index *idx;
+	unsigned int nsyms = 0, bits, n, i, j;
+
+	for (j = 0; j < ARRAY_SIZE(core_syms); j++)
+		nsyms += core_syms[j].stop - core_syms[j].start;
+	if (!nsyms)
+		return 0;
+
+	/* one or two symbols to a bucket */
+	bits = max_t(unsigned int, ilog2(nsyms), 1);
+	idx = kzalloc(sizeof(*idx) + ((1 << bits) + nsyms) * sizeof(n),
+		      GFP_KERNEL);
+	if (!idx)
+		return -ENOMEM;
+	idx->bits = bits;
+	idx->next = idx->head + (1 << bits);
+
+	n = 0;
+	for (j = 0; j < ARRAY_SIZE(core_syms); j++) {
+		for (i = 0; i < core_syms[j].stop - core_syms[j].start; i++) {
+			unsigned int h = ksym_hashfn(core_syms[j].start[i].name,
+						     bits);
+
+			idx->next[n] = idx->head[h];
+			idx->head[h] = ++n;
+		}
+	}
+
+	smp_wmb();
+	ksym_index = idx;
+	return 0;
+}
+core_initcall(ksym_index_init);
+
 /* Find a symbol and return it, along with, (optional) crc and
  * (optional) module which owns it.  Needs preempt disabled or module_mutex. */
 const struct kernel_symbol *find_symbol(const char *name,
@@ -341,13 +429,22 @@ const struct kernel_symbol *find_symbol(const char *name,
 					bool gplok,
 					bool warn)
 {
+	struct ksym_index *idx = ksym_index;
 	struct find_symbol_arg fsa;
+	bool found;
 
 	fsa.name = name;
 	fsa.gplok = gplok;
 	fsa.warn = warn;
 
-	if (each_symbol(find_symbol_in_section, &fsa)) {
+	smp_read_barrier_depends();
+	if (idx)
+		found = find_core_symbol(idx, &fsa) ||
+			each_module_symbol(find_symbol_in_section, &fsa);
+	else
+		found = each_symbol(find_symbol_in_section, &fsa);
+
+	if (found) {
 		if (owner)
 			*owner = fsa.owner;
 		if (crc)
@@ -14,6 +14,7 @@
  */
 
 #include <linux/earlysuspend.h>
+#include <linux/hrtimer.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
@@ -34,8 +35,10 @@ static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
+static void late_resume_deferred(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
 static DECLARE_WORK(late_resume_work, late_resume);
+static DECLARE_WORK(late_resume_deferred_work, late_resume_deferred);
 static DEFINE_SPINLOCK(state_lock);
 enum {
 	SUSPEND_REQUESTED = 0x1,
@@ -46,6 +49,17 @@ static int state;
 static int mode = EARLY_SUSPEND_MODE_NORMAL;
 static int last_mode = -1;
 
+/* Set by the wake-up source when the user is waiting for the screen */
+static int fast_wake;
+static ktime_t fast_wake_time;
+static int first_touch_pending;
+static struct {
+	unsigned int count;
+	u32 last_us;
+	u32 min_us;
+	u32 max_us;
+} first_touch;
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -87,6 +101,8 @@ static void early_suspend(struct work_struct *work)
 		state |= SUSPENDED;
 	else
 		abort = 1;
+	fast_wake = 0;
+	first_touch_pending = 0;
 	spin_unlock_irqrestore(&state_lock, irqflags);
 
 	if (abort) {
@@ -117,11 +133,33 @@ abort:
 	spin_unlock_irqrestore(&state_lock, irqflags);
 }
 
-static void late_resume(struct work_struct *work)
+/*
+ * Call the resume handlers in reverse level order.  On a fast wake only
+ * those whose defer_resume matches @deferred are called, otherwise all.
+ */
+static void call_late_resume(int fast, int deferred)
 {
 	struct early_suspend *pos;
+	ktime_t calltime;
+
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
+		if (pos->resume == NULL)
+			continue;
+		if (fast && !pos->defer_resume != !deferred)
+			continue;
+		calltime = suspend_timing_start();
+		pos->resume(pos);
+		suspend_timing_handler(pos->resume, SUSPEND_TIMING_LATE_RESUME,
+				       calltime);
+	}
+}
+
+static void late_resume(struct work_struct *work)
+{
 	unsigned long irqflags;
+	ktime_t starttime;
 	int abort = 0;
+	int fast;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -129,6 +167,8 @@ static void late_resume(struct work_struct *work)
 		state &= ~SUSPENDED;
 	else
 		abort = 1;
+	fast = fast_wake;
+	fast_wake = 0;
 	spin_unlock_irqrestore(&state_lock, irqflags);
 
 	if (abort) {
@@ -137,10 +177,18 @@ static void late_resume(struct work_struct *work)
 		goto abort;
 	}
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-		if (pos->resume != NULL)
-			pos->resume(pos);
+		pr_info("late_resume: call handlers%s\n",
+			fast ? ", deferring the rest" : "");
+	starttime = suspend_timing_start();
+	call_late_resume(fast, 0);
+	suspend_timing_phase(SUSPEND_TIMING_LATE_RESUME, starttime);
+
+	/*
+	 * The queue is single threaded, so the deferred handlers still run
+	 * before the early_suspend work of any later suspend request.
+	 */
+	if (fast)
+		queue_work(suspend_work_queue, &late_resume_deferred_work);
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
@@ -148,6 +196,77 @@ abort:
 	mutex_unlock(&early_suspend_lock);
 }
 
+static void late_resume_deferred(struct work_struct *work)
+{
+	mutex_lock(&early_suspend_lock);
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("late_resume: call deferred handlers\n");
+	call_late_resume(1, 1);
+	mutex_unlock(&early_suspend_lock);
+}
+
+/**
+ * late_resume_fast_wake - The system was woken up by the user.
+ *
+ * Called by the power key and touch controller wake-up interrupts.  Once the
+ * screen is turned back on, handlers that do not affect the display or the
+ * input devices are resumed after the others, and the delay until the next
+ * touch is accounted in /sys/power/time_to_first_touch.
+ */
+void late_resume_fast_wake(void)
+{
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&state_lock, irqflags);
+	if (state & SUSPENDED) {
+		fast_wake = 1;
+		fast_wake_time = ktime_get();
+		first_touch_pending = 1;
+	}
+	spin_unlock_irqrestore(&state_lock, irqflags);
+}
+EXPORT_SYMBOL(late_resume_fast_wake);
+
+/**
+ * late_resume_input_event - A touch was reported to the input layer.
+ */
+void late_resume_input_event(void)
+{
+	unsigned long irqflags;
+	u32 usecs;
+
+	if (likely(!first_touch_pending))
+		return;
+
+	spin_lock_irqsave(&state_lock, irqflags);
+	if (first_touch_pending && !(state & SUSPENDED)) {
+		usecs = ktime_to_us(ktime_sub(ktime_get(), fast_wake_time));
+		first_touch_pending = 0;
+		first_touch.last_us = usecs;
+		if (!first_touch.count || usecs < first_touch.min_us)
+			first_touch.min_us = usecs;
+		if (usecs > first_touch.max_us)
+			first_touch.max_us = usecs;
+		first_touch.count++;
+	}
+	spin_unlock_irqrestore(&state_lock, irqflags);
+}
+EXPORT_SYMBOL(late_resume_input_event);
+
+ssize_t time_to_first_touch_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	unsigned long irqflags;
+	ssize_t len;
+
+	spin_lock_irqsave(&state_lock, irqflags);
+	len = sprintf(buf, "last %u us, min %u us, max %u us, count %u\n",
+		      first_touch.last_us, first_touch.min_us,
+		      first_touch.max_us, first_touch.count);
+	spin_unlock_irqrestore(&state_lock, irqflags);
+	return len;
+}
+
 void request_suspend_state(suspend_state_t new_state)
 {
 	unsigned long irqflags;
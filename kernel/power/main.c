@@ -309,6 +309,17 @@ power_attr(wake_lock);
 power_attr(wake_unlock);
 #endif
 
+#ifdef CONFIG_EARLYSUSPEND
+static struct kobj_attribute time_to_first_touch_attr =
+	__ATTR_RO(time_to_first_touch);
+#endif
+
+#ifdef CONFIG_PM_MICRO_SUSPEND
+power_attr(micro_suspend);
+static struct kobj_attribute micro_suspend_stats_attr =
+	__ATTR_RO(micro_suspend_stats);
+#endif
+
 static struct attribute * g[] = {
 	&state_attr.attr,
 #ifdef CONFIG_PM_TRACE
@@ -328,6 +339,13 @@ static struct attribute * g[] = {
 #endif
 #endif
 	&state_extended_attr.attr,
+#ifdef CONFIG_EARLYSUSPEND
+	&time_to_first_touch_attr.attr,
+#endif
+#ifdef CONFIG_PM_MICRO_SUSPEND
+	&micro_suspend_attr.attr,
+	&micro_suspend_stats_attr.attr,
+#endif
 	NULL,
 };
 
@@ -0,0 +1,246 @@
+/*
+ * kernel/power/micro_suspend.c - Short suspend cycles between user actions.
+ *
+ * The EPD keeps its image without power, so the machine can go to sleep
+ * between two page turns as long as getting in and out is cheap.  A micro
+ * suspend is a normal suspend to RAM (DDR in self-refresh) in which devices
+ * marked with device_set_retains_state() keep running: their system sleep
+ * callbacks are skipped, so the touch controller and the display stay as
+ * they are and either a touch or a key press brings the machine back.
+ *
+ * Kernel timers are not allowed to slip: the RTC alarm is armed to wake the
+ * machine before the next pending timer, and the cycle is not attempted at
+ * all when that timer is too close for the one second resolution of the
+ * alarm.  The caller then falls back to a full suspend.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/rtc.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
+#include <linux/timer.h>
+
+#include "power.h"
+
+#define MICRO_SUSPEND_RTC	"rtc0"
+/* The alarm may fire up to a second early, so keep at least a second */
+#define MICRO_SUSPEND_MIN_MS	2000
+/* Wake up once an hour even when no timer is pending */
+#define MICRO_SUSPEND_MAX_MS	(3600 * MSEC_PER_SEC)
+
+bool pm_micro_suspend_active;
+
+static int micro_enabled;
+static struct rtc_device *micro_rtc;
+
+static ktime_t micro_begin;
+static ktime_t micro_sleep;
+static ktime_t micro_wake;
+static bool micro_slept;
+
+static struct {
+	unsigned int	count;
+	unsigned int	skipped;
+	unsigned int	failed;
+	u32		last_enter_us;
+	u32		last_exit_us;
+	u32		max_enter_us;
+	u32		max_exit_us;
+	u64		total_enter_us;
+	u64		total_exit_us;
+} micro_stats;
+
+/* Milliseconds until the next timer that would wake an idle CPU */
+static unsigned long micro_suspend_next_ms(void)
+{
+	unsigned long now, next, delta, ms;
+	ktime_t hr;
+
+	local_irq_disable();
+	now = jiffies;
+	next = get_next_timer_interrupt(now);
+	local_irq_enable();
+
+	if (time_before_eq(next, now))
+		return 0;
+	delta = min_t(unsigned long, next - now,
+		      msecs_to_jiffies(MICRO_SUSPEND_MAX_MS));
+	ms = jiffies_to_msecs(delta);
+
+	hr = hrtimer_get_next_event();
+	if (hr.tv64 != KTIME_MAX)
+		ms = min_t(unsigned long, ms,
+			   max_t(s64, ktime_to_ms(hr), 0));
+	return ms;
+}
+
+/*
+ * Arm the RTC alarm @ms from now, unless an alarm somebody else set goes off
+ * earlier.  The previous alarm is returned in @saved to be put back.
+ */
+static int micro_suspend_arm(unsigned long ms, struct rtc_wkalrm *saved)
+{
+	struct rtc_wkalrm alm;
+	unsigned long now, then;
+	int error;
+
+	if (!micro_rtc)
+		micro_rtc = rtc_class_open(MICRO_SUSPEND_RTC);
+	if (!micro_rtc)
+		return -ENODEV;
+
+	memset(saved, 0, sizeof(*saved));
+	error = rtc_read_alarm(micro_rtc, saved);
+	if (error)
+		return error;
+
+	memset(&alm, 0, sizeof(alm));
+	error = rtc_read_time(micro_rtc, &alm.time);
+	if (error)
+		return error;
+	rtc_tm_to_time(&alm.time, &now);
+	then = now + ms / MSEC_PER_SEC;
+
+	if (saved->enabled) {
+		unsigned long other;
+
+		rtc_tm_to_time(&saved->time, &other);
+		if (other > now && other <= then)
+			return 0;
+	}
+
+	rtc_time_to_tm(then, &alm.time);
+	alm.enabled = 1;
+	return rtc_set_alarm(micro_rtc, &alm);
+}
+
+static void micro_suspend_disarm(struct rtc_wkalrm *saved)
+{
+	if (saved->enabled)
+		rtc_set_alarm(micro_rtc, saved);
+	else
+		rtc_alarm_irq_enable(micro_rtc, 0);
+}
+
+/* Called with interrupts off right before and after the platform sleeps */
+void micro_suspend_sleep(void)
+{
+	if (pm_micro_suspend_active)
+		micro_sleep = ktime_get();
+}
+
+void micro_suspend_wake(void)
+{
+	if (pm_micro_suspend_active) {
+		micro_wake = ktime_get();
+		micro_slept = true;
+	}
+}
+
+static u32 micro_us(ktime_t from, ktime_t to)
+{
+	s64 us = ktime_us_delta(to, from);
+
+	return us > 0 ? (u32)min_t(s64, us, (u32)~0) : 0;
+}
+
+/**
+ * pm_micro_suspend - Sleep until the next user action or kernel timer.
+ * @state: Sleep state to enter.
+ *
+ * Returns -EAGAIN if micro suspend is disabled or not worth it right now,
+ * in which case the caller should do a full suspend instead.
+ */
+int pm_micro_suspend(suspend_state_t state)
+{
+	struct rtc_wkalrm saved;
+	unsigned long ms;
+	ktime_t end;
+	int error;
+
+	if (!micro_enabled)
+		return -EAGAIN;
+
+	ms = micro_suspend_next_ms();
+	if (ms < MICRO_SUSPEND_MIN_MS) {
+		micro_stats.skipped++;
+		return -EAGAIN;
+	}
+
+	error = micro_suspend_arm(ms, &saved);
+	if (error) {
+		pr_debug("PM: micro suspend: cannot arm RTC alarm (%d)\n",
+			 error);
+		micro_stats.skipped++;
+		return -EAGAIN;
+	}
+
+	micro_slept = false;
+	micro_begin = ktime_get();
+	error = enter_micro_state(state);
+	end = ktime_get();
+	micro_suspend_disarm(&saved);
+
+	if (!micro_slept) {
+		micro_stats.failed++;
+		return error;
+	}
+
+	micro_stats.count++;
+	micro_stats.last_enter_us = micro_us(micro_begin, micro_sleep);
+	micro_stats.last_exit_us = micro_us(micro_wake, end);
+	micro_stats.max_enter_us = max(micro_stats.max_enter_us,
+				       micro_stats.last_enter_us);
+	micro_stats.max_exit_us = max(micro_stats.max_exit_us,
+				      micro_stats.last_exit_us);
+	micro_stats.total_enter_us += micro_stats.last_enter_us;
+	micro_stats.total_exit_us += micro_stats.last_exit_us;
+	pr_debug("PM: micro suspend: enter %u us, exit %u us\n",
+		 micro_stats.last_enter_us, micro_stats.last_exit_us);
+	return error;
+}
+
+ssize_t micro_suspend_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf)
+{
+	return sprintf(buf, "%d\n", micro_enabled);
+}
+
+ssize_t micro_suspend_store(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t n)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+	micro_enabled = !!val;
+	return n;
+}
+
+ssize_t micro_suspend_stats_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	u64 avg_enter = micro_stats.total_enter_us;
+	u64 avg_exit = micro_stats.total_exit_us;
+
+	if (micro_stats.count) {
+		do_div(avg_enter, micro_stats.count);
+		do_div(avg_exit, micro_stats.count);
+	}
+
+	return sprintf(buf, "count %u\nskipped %u\nfailed %u\n"
+		       "last_enter_us %u\nlast_exit_us %u\n"
+		       "avg_enter_us %llu\navg_exit_us %llu\n"
+		       "max_enter_us %u\nmax_exit_us %u\n",
+		       micro_stats.count, micro_stats.skipped,
+		       micro_stats.failed, micro_stats.last_enter_us,
+		       micro_stats.last_exit_us,
+		       (unsigned long long)avg_enter,
+		       (unsigned long long)avg_exit,
+		       micro_stats.max_enter_us, micro_stats.max_exit_us);
+}
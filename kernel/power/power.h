@@ -134,6 +134,7 @@ extern int swsusp_swap_in_use(void);
  * the image header.
  */
 #define SF_PLATFORM_MODE	1
+#define SF_NOCOMPRESS_MODE	2
 
 /* kernel/power/hibernate.c */
 extern int swsusp_check(void);
@@ -163,6 +164,7 @@ extern const char *const pm_states[];
 extern bool valid_state(suspend_state_t state);
 extern int suspend_devices_and_enter(suspend_state_t state);
 extern int enter_state(suspend_state_t state);
+extern int enter_micro_state(suspend_state_t state);
 #else /* !CONFIG_SUSPEND */
 static inline int suspend_devices_and_enter(suspend_state_t state)
 {
@@ -252,8 +254,27 @@ ssize_t  wake_unlock_store(struct kobject *kobj, struct kobj_attribute *attr,
 			const char *buf, size_t n);
 #endif
 
+#ifdef CONFIG_PM_MICRO_SUSPEND
+/* kernel/power/micro_suspend.c */
+extern int pm_micro_suspend(suspend_state_t state);
+extern void micro_suspend_sleep(void);
+extern void micro_suspend_wake(void);
+ssize_t micro_suspend_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf);
+ssize_t micro_suspend_store(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t n);
+ssize_t micro_suspend_stats_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf);
+#else
+static inline int pm_micro_suspend(suspend_state_t state) { return -EAGAIN; }
+static inline void micro_suspend_sleep(void) {}
+static inline void micro_suspend_wake(void) {}
+#endif
+
 #ifdef CONFIG_EARLYSUSPEND
 /* kernel/power/earlysuspend.c */
 void request_suspend_state(suspend_state_t state);
 suspend_state_t get_suspend_state(void);
+ssize_t time_to_first_touch_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf);
 #endif
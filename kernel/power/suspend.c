@@ -166,8 +166,15 @@ static int suspend_enter(suspend_state_t state)
 
 	error = sysdev_suspend(PMSG_SUSPEND);
 	if (!error) {
-		if (!suspend_test(TEST_CORE))
+		if (!suspend_test(TEST_CORE)) {
+			ktime_t starttime = suspend_timing_start();
+
+			micro_suspend_sleep();
 			error = suspend_ops->enter(state);
+			micro_suspend_wake();
+			suspend_timing_phase(SUSPEND_TIMING_SLEEP, starttime);
+			suspend_timing_wake();
+		}
 		sysdev_resume();
 	}
 
@@ -212,6 +219,7 @@ int suspend_devices_and_enter(suspend_state_t state)
 	suspend_console();
 	saved_mask = clear_gfp_allowed_mask(GFP_IOFS);
 	suspend_test_start();
+	suspend_timing_begin();
 	error = dpm_suspend_start(PMSG_SUSPEND);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to suspend\n");
@@ -255,8 +263,9 @@ static void suspend_finish(void)
 }
 
 /**
- *	enter_state - Do common work of entering low-power state.
+ *	__enter_state - Do common work of entering low-power state.
  *	@state:		pm_state structure for state we're entering.
+ *	@micro:		skip devices that retain their state.
  *
  *	Make sure we're the only ones trying to enter a sleep state. Fail
  *	if someone has beat us to it, since we don't want anything weird to
@@ -264,7 +273,7 @@ static void suspend_finish(void)
  *	Then, do the setup for suspend, enter the state, and cleaup (after
  *	we've woken up).
  */
-int enter_state(suspend_state_t state)
+static int __enter_state(suspend_state_t state, bool micro)
 {
 	int error;
 
@@ -273,6 +282,9 @@ int enter_state(suspend_state_t state)
 
 	if (!mutex_trylock(&pm_mutex))
 		return -EBUSY;
+#ifdef CONFIG_PM_MICRO_SUSPEND
+	pm_micro_suspend_active = micro;
+#endif
 
 #if 0
 	printk(KERN_INFO "PM: Syncing filesystems ... ");
@@ -295,10 +307,27 @@ int enter_state(suspend_state_t state)
 	pr_debug("PM: Finishing wakeup.\n");
 	suspend_finish();
  Unlock:
+#ifdef CONFIG_PM_MICRO_SUSPEND
+	pm_micro_suspend_active = false;
+#endif
 	mutex_unlock(&pm_mutex);
 	return error;
 }
 
+int enter_state(suspend_state_t state)
+{
+	return __enter_state(state, false);
+}
+
+/*
+ * Same as enter_state(), but devices that retain their state across the
+ * cycle are left alone.
+ */
+int enter_micro_state(suspend_state_t state)
+{
+	return __enter_state(state, true);
+}
+
 /**
  *	pm_suspend - Externally visible function for suspending system.
  *	@state:		Enumerated value of state to enter.
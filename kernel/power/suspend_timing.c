@@ -0,0 +1,307 @@
+/*
+ * kernel/power/suspend_timing.c - Suspend/resume latency history.
+ *
+ * Keeps the phase totals of the last few suspend/resume cycles together with
+ * every device callback and late resume handler that took longer than
+ * min_us, and exports them in debugfs under suspend_timing/.  Suspend side
+ * offsets are relative to the start of the cycle, resume side offsets are
+ * relative to the platform wake-up, so the history shows both how long the
+ * machine took to become responsive and which callbacks overlapped.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
+
+#define SUSPEND_TIMING_CYCLES	8
+#define SUSPEND_TIMING_RECORDS	32
+#define SUSPEND_TIMING_NAME_LEN	24
+
+struct suspend_timing_rec {
+	char	name[SUSPEND_TIMING_NAME_LEN];
+	u32	offset_us;
+	u32	usecs;
+	s16	error;
+	u8	phase;
+	u8	async;
+};
+
+struct suspend_timing_cycle {
+	unsigned int	seq;
+	ktime_t		begin;
+	ktime_t		wake;
+	bool		woken;
+	u32		phase_us[SUSPEND_TIMING_NR];
+	unsigned int	nr;
+	unsigned int	dropped;
+	struct suspend_timing_rec rec[SUSPEND_TIMING_RECORDS];
+};
+
+static const char *const phase_names[SUSPEND_TIMING_NR] = {
+	[SUSPEND_TIMING_PREPARE]	= "prepare",
+	[SUSPEND_TIMING_SUSPEND]	= "suspend",
+	[SUSPEND_TIMING_SUSPEND_NOIRQ]	= "suspend_noirq",
+	[SUSPEND_TIMING_SLEEP]		= "sleep",
+	[SUSPEND_TIMING_RESUME_NOIRQ]	= "resume_noirq",
+	[SUSPEND_TIMING_RESUME]		= "resume",
+	[SUSPEND_TIMING_COMPLETE]	= "complete",
+	[SUSPEND_TIMING_LATE_RESUME]	= "late_resume",
+};
+
+static struct suspend_timing_cycle cycles[SUSPEND_TIMING_CYCLES];
+static unsigned int cycle_seq;
+static u32 min_us = 500;
+static DEFINE_SPINLOCK(timing_lock);
+
+static struct suspend_timing_cycle *current_cycle(void)
+{
+	if (!cycle_seq)
+		return NULL;
+	return &cycles[(cycle_seq - 1) % SUSPEND_TIMING_CYCLES];
+}
+
+static u32 us_since(ktime_t ref, ktime_t t)
+{
+	s64 us = ktime_us_delta(t, ref);
+
+	return us > 0 ? (u32)min_t(s64, us, (u32)~0) : 0;
+}
+
+/**
+ * suspend_timing_begin - Open a new entry in the history.
+ *
+ * Called when devices start being prepared for system sleep; the oldest
+ * cycle is overwritten once the history is full.
+ */
+void suspend_timing_begin(void)
+{
+	struct suspend_timing_cycle *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&timing_lock, flags);
+	c = &cycles[cycle_seq % SUSPEND_TIMING_CYCLES];
+	memset(c, 0, sizeof(*c));
+	c->seq = ++cycle_seq;
+	c->begin = ktime_get();
+	spin_unlock_irqrestore(&timing_lock, flags);
+}
+
+/**
+ * suspend_timing_wake - Note the platform wake-up of the current cycle.
+ *
+ * Offsets of everything recorded later in the cycle are relative to this.
+ */
+void suspend_timing_wake(void)
+{
+	struct suspend_timing_cycle *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&timing_lock, flags);
+	c = current_cycle();
+	if (c) {
+		c->wake = ktime_get();
+		c->woken = true;
+	}
+	spin_unlock_irqrestore(&timing_lock, flags);
+}
+
+ktime_t suspend_timing_start(void)
+{
+	return ktime_get();
+}
+
+/**
+ * suspend_timing_phase - Account a whole suspend/resume phase.
+ * @phase: Phase that has just finished.
+ * @start: When it started.
+ */
+void suspend_timing_phase(enum suspend_timing_phase phase, ktime_t start)
+{
+	struct suspend_timing_cycle *c;
+	unsigned long flags;
+	u32 usecs = us_since(start, ktime_get());
+
+	spin_lock_irqsave(&timing_lock, flags);
+	c = current_cycle();
+	if (c)
+		c->phase_us[phase] += usecs;
+	spin_unlock_irqrestore(&timing_lock, flags);
+}
+
+static void suspend_timing_record(const char *name,
+				  enum suspend_timing_phase phase,
+				  ktime_t start, u32 usecs, int error,
+				  bool async)
+{
+	struct suspend_timing_cycle *c;
+	struct suspend_timing_rec *r;
+	unsigned long flags;
+
+	spin_lock_irqsave(&timing_lock, flags);
+	c = current_cycle();
+	if (!c)
+		goto out;
+	if (c->nr >= SUSPEND_TIMING_RECORDS) {
+		c->dropped++;
+		goto out;
+	}
+	r = &c->rec[c->nr++];
+	strlcpy(r->name, name, sizeof(r->name));
+	r->offset_us = us_since(phase > SUSPEND_TIMING_SLEEP && c->woken ?
+				c->wake : c->begin, start);
+	r->usecs = usecs;
+	r->error = error;
+	r->phase = phase;
+	r->async = async;
+ out:
+	spin_unlock_irqrestore(&timing_lock, flags);
+}
+
+/**
+ * suspend_timing_device - Record the callbacks of a device for one phase.
+ * @dev: Device that has just been handled.
+ * @phase: Phase being carried out.
+ * @start: When its first callback was invoked.
+ * @error: What the callbacks returned.
+ * @async: Whether @dev was handled asynchronously.
+ */
+void suspend_timing_device(struct device *dev,
+			   enum suspend_timing_phase phase,
+			   ktime_t start, int error, bool async)
+{
+	u32 usecs = us_since(start, ktime_get());
+
+	if (usecs < min_us)
+		return;
+	suspend_timing_record(dev_name(dev), phase, start, usecs, error, async);
+}
+
+/**
+ * suspend_timing_handler - Record a handler that is not tied to a device.
+ * @fn: Handler that has just returned, reported by symbol name.
+ * @phase: Phase being carried out.
+ * @start: When @fn was invoked.
+ */
+void suspend_timing_handler(void *fn, enum suspend_timing_phase phase,
+			    ktime_t start)
+{
+	char name[SUSPEND_TIMING_NAME_LEN];
+	u32 usecs = us_since(start, ktime_get());
+
+	if (usecs < min_us)
+		return;
+	snprintf(name, sizeof(name), "%pf", fn);
+	suspend_timing_record(name, phase, start, usecs, 0, false);
+}
+
+static void suspend_timing_show_cycle(struct seq_file *m,
+				      struct suspend_timing_cycle *c)
+{
+	struct timespec ts;
+	int i;
+
+	ts = ktime_to_timespec(c->begin);
+	seq_printf(m, "cycle %u: begin %lu.%06lu", c->seq,
+		   (unsigned long)ts.tv_sec, ts.tv_nsec / NSEC_PER_USEC);
+	if (c->woken) {
+		ts = ktime_to_timespec(c->wake);
+		seq_printf(m, " wake %lu.%06lu",
+			   (unsigned long)ts.tv_sec, ts.tv_nsec / NSEC_PER_USEC);
+	}
+	seq_printf(m, " dropped %u\n", c->dropped);
+
+	for (i = 0; i < SUSPEND_TIMING_NR; i++)
+		seq_printf(m, "  %-14s %10u us\n", phase_names[i],
+			   c->phase_us[i]);
+
+	if (!c->nr)
+		return;
+	seq_printf(m, "  %-14s %10s %10s async error name\n",
+		   "phase", "offset_us", "usecs");
+	for (i = 0; i < c->nr; i++) {
+		struct suspend_timing_rec *r = &c->rec[i];
+
+		seq_printf(m, "  %-14s %10u %10u %5d %5d %s\n",
+			   phase_names[r->phase], r->offset_us, r->usecs,
+			   r->async, r->error, r->name);
+	}
+}
+
+static int suspend_timing_show(struct seq_file *m, void *unused)
+{
+	struct suspend_timing_cycle *c;
+	unsigned long flags;
+	unsigned int seq, n, i;
+
+	c = kmalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&timing_lock, flags);
+	seq = cycle_seq;
+	spin_unlock_irqrestore(&timing_lock, flags);
+
+	n = min_t(unsigned int, seq, SUSPEND_TIMING_CYCLES);
+	for (i = seq - n; i < seq; i++) {
+		spin_lock_irqsave(&timing_lock, flags);
+		memcpy(c, &cycles[i % SUSPEND_TIMING_CYCLES], sizeof(*c));
+		spin_unlock_irqrestore(&timing_lock, flags);
+		/* Overwritten by a newer cycle while we were printing */
+		if (c->seq != i + 1)
+			continue;
+		suspend_timing_show_cycle(m, c);
+	}
+
+	kfree(c);
+	return 0;
+}
+
+static int suspend_timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_timing_show, NULL);
+}
+
+/* Any write clears the history */
+static ssize_t suspend_timing_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&timing_lock, flags);
+	cycle_seq = 0;
+	memset(cycles, 0, sizeof(cycles));
+	spin_unlock_irqrestore(&timing_lock, flags);
+	return count;
+}
+
+static const struct file_operations suspend_timing_fops = {
+	.owner = THIS_MODULE,
+	.open = suspend_timing_open,
+	.read = seq_read,
+	.write = suspend_timing_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init suspend_timing_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("suspend_timing", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+	debugfs_create_file("history", S_IRUGO | S_IWUSR, dir, NULL,
+			    &suspend_timing_fops);
+	debugfs_create_u32("min_us", S_IRUGO | S_IWUSR, dir, &min_us);
+	return 0;
+}
+
+late_initcall(suspend_timing_init);
@@ -24,6 +24,8 @@
 #include <linux/swapops.h>
 #include <linux/pm.h>
 #include <linux/slab.h>
+#include <linux/lzo.h>
+#include <linux/vmalloc.h>
 
 #include "power.h"
 
@@ -404,6 +406,119 @@ static int save_image(struct swap_map_handle *handle,
 	return ret;
 }
 
+/*
+ * Unless SF_NOCOMPRESS_MODE is set, the image data pages are compressed
+ * with LZO, LZO_UNC_PAGES at a time.  Each chunk is stored as its
+ * compressed length followed by the compressed data, padded to a whole
+ * number of pages.
+ */
+#define LZO_HEADER	sizeof(size_t)
+#define LZO_UNC_PAGES	32
+#define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
+#define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
+				     LZO_HEADER, PAGE_SIZE)
+#define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
+
+/* image pages read ahead of the decompressor on resume */
+#define LZO_RA_PAGES	(2 * LZO_CMP_PAGES)
+
+/**
+ *	save_image_lzo - save the suspend image data, LZO compressed
+ */
+
+static int save_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_write)
+{
+	unsigned int m;
+	int ret = 0;
+	int nr_pages;
+	int err2;
+	struct bio *bio;
+	struct timeval start;
+	struct timeval stop;
+	size_t off, unc_len, cmp_len;
+	unsigned char *unc, *cmp, *wrk, *page;
+
+	page = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+	wrk = vmalloc(LZO1X_1_MEM_COMPRESS);
+	unc = vmalloc(LZO_UNC_SIZE);
+	cmp = vmalloc(LZO_CMP_SIZE);
+	if (!page || !wrk || !unc || !cmp) {
+		printk(KERN_ERR "PM: Failed to allocate LZO buffers\n");
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	printk(KERN_INFO
+		"PM: Compressing and saving image data (%u pages) ...     ",
+		nr_to_write);
+	m = nr_to_write / 100;
+	if (!m)
+		m = 1;
+	nr_pages = 0;
+	bio = NULL;
+	do_gettimeofday(&start);
+	for (;;) {
+		for (off = 0; off < LZO_UNC_SIZE; off += PAGE_SIZE) {
+			ret = snapshot_read_next(snapshot);
+			if (ret < 0)
+				goto out_finish;
+			if (!ret)
+				break;
+			memcpy(unc + off, data_of(*snapshot), PAGE_SIZE);
+			if (!(nr_pages % m))
+				printk(KERN_CONT "\b\b\b\b%3d%%", nr_pages / m);
+			nr_pages++;
+		}
+		if (!off)
+			break;
+
+		unc_len = off;
+		ret = lzo1x_1_compress(unc, unc_len, cmp + LZO_HEADER,
+				       &cmp_len, wrk);
+		if (ret < 0) {
+			printk(KERN_ERR "PM: LZO compression failed\n");
+			break;
+		}
+		if (unlikely(!cmp_len ||
+			     cmp_len > lzo1x_worst_compress(unc_len))) {
+			printk(KERN_ERR "PM: Invalid LZO compressed length\n");
+			ret = -EINVAL;
+			break;
+		}
+		*(size_t *)cmp = cmp_len;
+
+		/*
+		 * The tail of the last page is garbage, the reader knows the
+		 * length of the compressed data.
+		 */
+		for (off = 0; off < LZO_HEADER + cmp_len; off += PAGE_SIZE) {
+			memcpy(page, cmp + off, PAGE_SIZE);
+			ret = swap_write_page(handle, page, &bio);
+			if (ret)
+				goto out_finish;
+		}
+	}
+
+out_finish:
+	err2 = hib_wait_on_bio_chain(&bio);
+	do_gettimeofday(&stop);
+	if (!ret)
+		ret = err2;
+	if (!ret)
+		printk(KERN_CONT "\b\b\b\bdone\n");
+	else
+		printk(KERN_CONT "\n");
+	swsusp_show_speed(&start, &stop, nr_to_write, "Wrote");
+out_free:
+	vfree(cmp);
+	vfree(unc);
+	vfree(wrk);
+	free_page((unsigned long)page);
+	return ret;
+}
+
 /**
  *	enough_swap - Make sure we have enough swap to save the image.
  *
@@ -411,12 +526,16 @@ static int save_image(struct swap_map_handle *handle,
  *	space avaiable from the resume partition.
  */
 
-static int enough_swap(unsigned int nr_pages)
+static int enough_swap(unsigned int nr_pages, unsigned int flags)
 {
 	unsigned int free_swap = count_swap_pages(root_swap, 1);
+	unsigned int required;
 
 	pr_debug("PM: Free swap pages: %u\n", free_swap);
-	return free_swap > nr_pages + PAGES_FOR_IO;
+
+	required = PAGES_FOR_IO + ((flags & SF_NOCOMPRESS_MODE) ?
+		nr_pages : (nr_pages * LZO_CMP_PAGES) / LZO_UNC_PAGES + 1);
+	return free_swap > required;
 }
 
 /**
@@ -443,7 +562,7 @@ int swsusp_write(unsigned int flags)
 		printk(KERN_ERR "PM: Cannot get swap writer\n");
 		return error;
 	}
-	if (!enough_swap(pages)) {
+	if (!enough_swap(pages, flags)) {
 		printk(KERN_ERR "PM: Not enough free swap\n");
 		error = -ENOSPC;
 		goto out_finish;
@@ -459,7 +578,9 @@ int swsusp_write(unsigned int flags)
 	header = (struct swsusp_info *)data_of(snapshot);
 	error = swap_write_page(&handle, header, NULL);
 	if (!error)
-		error = save_image(&handle, &snapshot, pages - 1);
+		error = (flags & SF_NOCOMPRESS_MODE) ?
+			save_image(&handle, &snapshot, pages - 1) :
+			save_image_lzo(&handle, &snapshot, pages - 1);
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
 	return error;
@@ -589,6 +710,169 @@ static int load_image(struct swap_map_handle *handle,
 	return error;
 }
 
+/*
+ * Read-ahead for load_image_lzo(): a ring of pages kept filled with the
+ * next pages of the image, so that the device reads the next chunks
+ * while the current one is being decompressed.
+ */
+struct lzo_readahead {
+	void *page[LZO_RA_PAGES];
+	unsigned int head;		/* next page to hand out */
+	unsigned int count;		/* pages read or being read */
+	int error;			/* stopped reading ahead because of */
+	struct bio *bio;
+};
+
+static void lzo_ra_fill(struct swap_map_handle *handle,
+			struct lzo_readahead *ra)
+{
+	while (!ra->error && ra->count < LZO_RA_PAGES) {
+		unsigned int i = (ra->head + ra->count) % LZO_RA_PAGES;
+
+		/* the end of the image shows up as an error, too */
+		ra->error = swap_read_page(handle, ra->page[i], &ra->bio);
+		if (!ra->error)
+			ra->count++;
+	}
+}
+
+/* Copy the next compressed chunk out of the ring into @cmp. */
+static int lzo_ra_get_chunk(struct swap_map_handle *handle,
+			    struct lzo_readahead *ra, unsigned char *cmp,
+			    size_t *cmp_len)
+{
+	unsigned int i, nr;
+	int error;
+
+	error = hib_wait_on_bio_chain(&ra->bio);
+	if (error)
+		return error;
+	if (!ra->count)
+		return ra->error ? ra->error : -EFAULT;
+
+	*cmp_len = *(size_t *)ra->page[ra->head];
+	if (unlikely(!*cmp_len ||
+		     *cmp_len > lzo1x_worst_compress(LZO_UNC_SIZE))) {
+		printk(KERN_ERR "PM: Invalid LZO compressed length\n");
+		return -EINVAL;
+	}
+
+	nr = DIV_ROUND_UP(LZO_HEADER + *cmp_len, PAGE_SIZE);
+	if (nr > ra->count)
+		return ra->error ? ra->error : -EFAULT;
+
+	for (i = 0; i < nr; i++) {
+		memcpy(cmp + i * PAGE_SIZE, ra->page[ra->head], PAGE_SIZE);
+		ra->head = (ra->head + 1) % LZO_RA_PAGES;
+	}
+	ra->count -= nr;
+
+	/* get the next chunks going before this one is decompressed */
+	lzo_ra_fill(handle, ra);
+	return 0;
+}
+
+/**
+ *	load_image_lzo - load the LZO compressed image using the swap map
+ *	handle @handle and the snapshot handle @snapshot
+ *	(assume there are @nr_pages pages to load)
+ */
+
+static int load_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_read)
+{
+	unsigned int m;
+	int error = 0;
+	struct timeval start;
+	struct timeval stop;
+	unsigned nr_pages;
+	size_t i, off, unc_len, cmp_len;
+	unsigned char *unc, *cmp;
+	struct lzo_readahead *ra;
+
+	ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+	unc = vmalloc(LZO_UNC_SIZE);
+	cmp = vmalloc(LZO_CMP_SIZE);
+	if (!ra || !unc || !cmp)
+		goto out_nomem;
+	for (i = 0; i < LZO_RA_PAGES; i++) {
+		ra->page[i] = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+		if (!ra->page[i])
+			goto out_nomem;
+	}
+
+	printk(KERN_INFO
+		"PM: Loading and decompressing image data (%u pages) ...     ",
+		nr_to_read);
+	m = nr_to_read / 100;
+	if (!m)
+		m = 1;
+	nr_pages = 0;
+	do_gettimeofday(&start);
+
+	error = snapshot_write_next(snapshot);
+	if (error <= 0)
+		goto out_finish;
+
+	lzo_ra_fill(handle, ra);
+	for (;;) {
+		error = lzo_ra_get_chunk(handle, ra, cmp, &cmp_len);
+		if (error)
+			break;
+
+		unc_len = LZO_UNC_SIZE;
+		error = lzo1x_decompress_safe(cmp + LZO_HEADER, cmp_len,
+					      unc, &unc_len);
+		if (error < 0) {
+			printk(KERN_ERR "PM: LZO decompression failed\n");
+			break;
+		}
+		if (unlikely(!unc_len || unc_len > LZO_UNC_SIZE ||
+			     unc_len & (PAGE_SIZE - 1))) {
+			printk(KERN_ERR "PM: Invalid LZO uncompressed length\n");
+			error = -EINVAL;
+			break;
+		}
+
+		for (off = 0; off < unc_len; off += PAGE_SIZE) {
+			memcpy(data_of(*snapshot), unc + off, PAGE_SIZE);
+			if (!(nr_pages % m))
+				printk("\b\b\b\b%3d%%", nr_pages / m);
+			nr_pages++;
+			error = snapshot_write_next(snapshot);
+			if (error <= 0)
+				goto out_finish;
+		}
+	}
+
+out_finish:
+	/* nothing may still be reading into the ring when it is freed */
+	hib_wait_on_bio_chain(&ra->bio);
+	do_gettimeofday(&stop);
+	if (!error) {
+		printk("\b\b\b\bdone\n");
+		snapshot_write_finalize(snapshot);
+		if (!snapshot_image_loaded(snapshot))
+			error = -ENODATA;
+	} else
+		printk("\n");
+	swsusp_show_speed(&start, &stop, nr_to_read, "Read");
+	goto out_free;
+
+out_nomem:
+	printk(KERN_ERR "PM: Failed to allocate LZO buffers\n");
+	error = -ENOMEM;
+out_free:
+	if (ra)
+		for (i = 0; i < LZO_RA_PAGES; i++)
+			free_page((unsigned long)ra->page[i]);
+	kfree(ra);
+	vfree(cmp);
+	vfree(unc);
+	return error;
+}
+
 /**
  *	swsusp_read - read the hibernation image.
  *	@flags_p: flags passed by the "frozen" kernel in the image header should
@@ -613,7 +897,9 @@ int swsusp_read(unsigned int *flags_p)
 	if (!error)
 		error = swap_read_page(&handle, header, NULL);
 	if (!error)
-		error = load_image(&handle, &snapshot, header->pages - 1);
+		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
+			load_image(&handle, &snapshot, header->pages - 1) :
+			load_image_lzo(&handle, &snapshot, header->pages - 1);
 	swap_reader_finish(&handle);
 end:
 	if (!error)
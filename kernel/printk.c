@@ -37,6 +37,7 @@
 #include <linux/ratelimit.h>
 #include <linux/kmsg_dump.h>
 #include <linux/syslog.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -687,6 +688,115 @@ static inline void printk_delay(void)
 	}
 }
 
+/*
+ * Deferred console output (printk_deferred=1 on the command line or
+ * kernel.printk_deferred).  printk() only stores into log_buf and the
+ * kconsoled thread, woken from the next tick, writes it to the consoles
+ * a line at a time.  A printk from an irqs-off path then no longer
+ * waits for a slow console, and the irqs-off window of the console
+ * write itself is one line instead of a whole burst.  At most
+ * printk_console_ratelimit lines per second go to the consoles; the
+ * rest stay in the log buffer for dmesg/syslog and are only counted.
+ * Oopses and early boot still print synchronously.
+ */
+int printk_deferred __read_mostly;
+int printk_console_ratelimit __read_mostly = 100;
+unsigned long printk_console_dropped;
+static struct task_struct *printk_thread;
+static DEFINE_PER_CPU(int, printk_console_pending);
+
+static int __init printk_deferred_setup(char *str)
+{
+	printk_deferred = 1;
+	return 1;
+}
+__setup("printk_deferred", printk_deferred_setup);
+
+static inline int printk_deferred_active(void)
+{
+	return printk_deferred && printk_thread && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+static inline void printk_console_kick(void)
+{
+	__raw_get_cpu_var(printk_console_pending) = 1;
+}
+
+/* Only called by kconsoled */
+static int printk_console_admit(void)
+{
+	static unsigned long window;
+	static int lines;
+	static unsigned long dropped;
+
+	if (time_after_eq(jiffies, window + HZ)) {
+		if (printk_console_dropped != dropped)
+			printk(KERN_WARNING "printk: %lu console lines "
+			       "suppressed\n", printk_console_dropped - dropped);
+		window = jiffies;
+		lines = 0;
+		dropped = printk_console_dropped;
+	}
+	if (printk_console_ratelimit && lines >= printk_console_ratelimit) {
+		printk_console_dropped++;
+		return 0;
+	}
+	lines++;
+	return 1;
+}
+
+/* Called with the console semaphore held */
+static void printk_console_drain(void)
+{
+	unsigned long flags;
+	unsigned start, end;
+
+	while (!console_suspended) {
+		spin_lock_irqsave(&logbuf_lock, flags);
+		if (con_start == log_end) {
+			spin_unlock_irqrestore(&logbuf_lock, flags);
+			break;
+		}
+		start = end = con_start;
+		while (end != log_end && LOG_BUF(end++) != '\n')
+			;
+		con_start = end;
+		spin_unlock(&logbuf_lock);
+		if (printk_console_admit())
+			call_console_drivers(start, end);
+		local_irq_restore(flags);
+		cond_resched();
+	}
+}
+
+static int printk_console_thread(void *unused)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		acquire_console_sem();
+		printk_console_drain();
+		release_console_sem();
+	}
+	return 0;
+}
+
+static int __init printk_console_thread_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(printk_console_thread, NULL, "kconsoled");
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+	printk_thread = t;
+	return 0;
+}
+late_initcall(printk_console_thread_init);
+
 asmlinkage int vprintk(const char *fmt, va_list args)
 {
 	int printed_len = 0;
@@ -807,8 +917,14 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The acquire_console_semaphore_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * In deferred mode kconsoled does the printing instead.
 	 */
-	if (acquire_console_semaphore_for_printk(this_cpu))
+	if (printk_deferred_active()) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		printk_console_kick();
+	} else if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
 
 	lockdep_on();
@@ -827,6 +943,18 @@ static void call_console_drivers(unsigned start, unsigned end)
 {
 }
 
+static struct task_struct *printk_thread;
+static DEFINE_PER_CPU(int, printk_console_pending);
+
+static inline int printk_deferred_active(void)
+{
+	return 0;
+}
+
+static inline void printk_console_kick(void)
+{
+}
+
 #endif
 
 static int __add_preferred_console(char *name, int idx, char *options,
@@ -1030,11 +1158,17 @@ void printk_tick(void)
 		__get_cpu_var(printk_pending) = 0;
 		wake_up_interruptible(&log_wait);
 	}
+	if (__get_cpu_var(printk_console_pending)) {
+		__get_cpu_var(printk_console_pending) = 0;
+		if (printk_thread)
+			wake_up_process(printk_thread);
+	}
 }
 
 int printk_needs_cpu(int cpu)
 {
-	return per_cpu(printk_pending, cpu);
+	return per_cpu(printk_pending, cpu) ||
+		per_cpu(printk_console_pending, cpu);
 }
 
 void wake_up_klogd(void)
@@ -1068,6 +1202,20 @@ void release_console_sem(void)
 		return;
 	}
 
+	/* Leave the output to kconsoled, it is rate limited there */
+	if (printk_deferred_active()) {
+		spin_lock_irqsave(&logbuf_lock, flags);
+		wake_klogd = log_start - log_end;
+		if (con_start != log_end && current != printk_thread)
+			printk_console_kick();
+		console_locked = 0;
+		up(&console_sem);
+		spin_unlock_irqrestore(&logbuf_lock, flags);
+		if (wake_klogd)
+			wake_up_klogd();
+		return;
+	}
+
 	console_may_schedule = 0;
 
 	for ( ; ; ) {
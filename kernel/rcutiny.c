@@ -35,12 +35,16 @@
 #include <linux/init.h>
 #include <linux/time.h>
 #include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
 
 /* Global control variables for rcupdate callback mechanism. */
 struct rcu_ctrlblk {
 	struct rcu_head *rcucblist;	/* List of pending callbacks (CBs). */
 	struct rcu_head **donetail;	/* ->next pointer of last "done" CB. */
 	struct rcu_head **curtail;	/* ->next pointer of last CB. */
+	long qlen;			/* Number of pending CBs. */
+	long qlen_max;			/* High-water mark of ->qlen. */
 };
 
 /* Definition for rcupdate control block. */
@@ -54,6 +58,25 @@ static struct rcu_ctrlblk rcu_bh_ctrlblk = {
 	.curtail	= &rcu_bh_ctrlblk.rcucblist,
 };
 
+/*
+ * The RCU softirq invokes at most blimit ready callbacks per run, the
+ * rest is left to rcu_kthread, which works through them in batches of
+ * the same size with bottom halves enabled in between, so that a burst
+ * of callbacks (dentry and file freeing after a large directory scan)
+ * cannot hold off everything else for the whole time it takes.
+ */
+static int blimit = 16;		/* Maximum callbacks per batch. */
+module_param(blimit, int, 0644);
+
+static struct task_struct *rcu_kthread_task;
+static DECLARE_WAIT_QUEUE_HEAD(rcu_kthread_wq);
+static int rcu_kthread_wake;
+
+/* Statistics, reported in debugfs rcu/rcutiny. */
+static unsigned long rcu_cbs_softirq;	/* CBs invoked from the softirq. */
+static unsigned long rcu_cbs_kthread;	/* CBs invoked from rcu_kthread. */
+static unsigned long rcu_kthread_kicks;	/* Softirq runs that deferred CBs. */
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 int rcu_scheduler_active __read_mostly;
 EXPORT_SYMBOL_GPL(rcu_scheduler_active);
@@ -143,26 +166,38 @@ void rcu_check_callbacks(int cpu, int user)
 }
 
 /*
- * Helper function for rcu_process_callbacks() that operates on the
- * specified rcu_ctrlkblk structure.
+ * Helper function for rcu_process_callbacks() and rcu_kthread() that
+ * invokes up to "limit" ready callbacks of the specified rcu_ctrlkblk
+ * structure.  Returns nonzero if ready callbacks are left over.
  */
-static void __rcu_process_callbacks(struct rcu_ctrlblk *rcp)
+static int __rcu_process_callbacks(struct rcu_ctrlblk *rcp, long limit,
+				   unsigned long *invoked)
 {
-	struct rcu_head *next, *list;
+	struct rcu_head *next, *list, **tail;
 	unsigned long flags;
+	long count = 0;
+	int more;
 
 	/* If no RCU callbacks ready to invoke, just return. */
 	if (&rcp->rcucblist == rcp->donetail)
-		return;
+		return 0;
 
-	/* Move the ready-to-invoke callbacks to a local list. */
+	/* Move up to "limit" ready-to-invoke callbacks to a local list. */
 	local_irq_save(flags);
 	list = rcp->rcucblist;
-	rcp->rcucblist = *rcp->donetail;
-	*rcp->donetail = NULL;
-	if (rcp->curtail == rcp->donetail)
+	tail = &rcp->rcucblist;
+	do {
+		tail = &(*tail)->next;
+		count++;
+	} while (tail != rcp->donetail && count < limit);
+	rcp->rcucblist = *tail;
+	*tail = NULL;
+	if (rcp->curtail == tail)
 		rcp->curtail = &rcp->rcucblist;
-	rcp->donetail = &rcp->rcucblist;
+	if (rcp->donetail == tail)
+		rcp->donetail = &rcp->rcucblist;
+	rcp->qlen -= count;
+	more = rcp->donetail != &rcp->rcucblist;
 	local_irq_restore(flags);
 
 	/* Invoke the callbacks on the local list. */
@@ -172,16 +207,71 @@ static void __rcu_process_callbacks(struct rcu_ctrlblk *rcp)
 		list->func(list);
 		list = next;
 	}
+	*invoked += count;
+
+	return more;
 }
 
 /*
- * Invoke any callbacks whose grace period has completed.
+ * Invoke a batch of the callbacks whose grace period has completed, and
+ * leave the rest to rcu_kthread.  Until that thread is running, invoke
+ * them all.
  */
 static void rcu_process_callbacks(struct softirq_action *unused)
 {
-	__rcu_process_callbacks(&rcu_sched_ctrlblk);
-	__rcu_process_callbacks(&rcu_bh_ctrlblk);
+	long limit = rcu_kthread_task ? max(blimit, 1) : LONG_MAX;
+	int more;
+
+	more = __rcu_process_callbacks(&rcu_sched_ctrlblk, limit,
+				       &rcu_cbs_softirq);
+	more |= __rcu_process_callbacks(&rcu_bh_ctrlblk, limit,
+					&rcu_cbs_softirq);
+	if (more) {
+		rcu_kthread_kicks++;
+		rcu_kthread_wake = 1;
+		wake_up(&rcu_kthread_wq);
+	}
+}
+
+/*
+ * Works through the ready callbacks the softirq left behind, one batch
+ * at a time, in the same bottom-half disabled context the softirq would
+ * have invoked them in.
+ */
+static int rcu_kthread(void *arg)
+{
+	int more;
+
+	for (;;) {
+		wait_event_interruptible(rcu_kthread_wq, rcu_kthread_wake);
+		rcu_kthread_wake = 0;
+		do {
+			local_bh_disable();
+			more = __rcu_process_callbacks(&rcu_sched_ctrlblk,
+						       max(blimit, 1),
+						       &rcu_cbs_kthread);
+			more |= __rcu_process_callbacks(&rcu_bh_ctrlblk,
+							max(blimit, 1),
+							&rcu_cbs_kthread);
+			local_bh_enable();
+			cond_resched();
+		} while (more);
+	}
+
+	return 0;
+}
+
+static int __init rcu_spawn_kthread(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(rcu_kthread, NULL, "rcu_kthread");
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+	rcu_kthread_task = t;
+	return 0;
 }
+early_initcall(rcu_spawn_kthread);
 
 /*
  * Wait for a grace period to elapse.  But it is illegal to invoke
@@ -217,6 +307,8 @@ static void __call_rcu(struct rcu_head *head,
 	local_irq_save(flags);
 	*rcp->curtail = head;
 	rcp->curtail = &head->next;
+	if (++rcp->qlen > rcp->qlen_max)
+		rcp->qlen_max = rcp->qlen;
 	local_irq_restore(flags);
 }
 
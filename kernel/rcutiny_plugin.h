@@ -37,3 +37,72 @@ void rcu_scheduler_starting(void)
 }
 
 #endif /* #ifdef CONFIG_DEBUG_LOCK_ALLOC */
+
+#ifdef CONFIG_DEBUG_FS
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static void show_tiny_ctrlblk(struct seq_file *m, const char *name,
+			      struct rcu_ctrlblk *rcp)
+{
+	seq_printf(m, "%s: qlen=%ld qlen_max=%ld\n",
+		   name, rcp->qlen, rcp->qlen_max);
+}
+
+/*
+ * Callback backlog of both flavours, and where the callbacks got invoked.
+ * Writing anything resets the high-water marks.
+ */
+static int show_tiny_stats(struct seq_file *m, void *unused)
+{
+	show_tiny_ctrlblk(m, "rcu_sched", &rcu_sched_ctrlblk);
+	show_tiny_ctrlblk(m, "rcu_bh", &rcu_bh_ctrlblk);
+	seq_printf(m, "blimit=%d softirq=%lu kthread=%lu kthread_kicks=%lu\n",
+		   blimit, rcu_cbs_softirq, rcu_cbs_kthread, rcu_kthread_kicks);
+	return 0;
+}
+
+static int tiny_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_tiny_stats, NULL);
+}
+
+static ssize_t tiny_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rcu_sched_ctrlblk.qlen_max = rcu_sched_ctrlblk.qlen;
+	rcu_bh_ctrlblk.qlen_max = rcu_bh_ctrlblk.qlen;
+	local_irq_restore(flags);
+	return count;
+}
+
+static const struct file_operations tiny_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= tiny_stats_open,
+	.read		= seq_read,
+	.write		= tiny_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init rcutiny_trace_init(void)
+{
+	struct dentry *rcudir;
+
+	rcudir = debugfs_create_dir("rcu", NULL);
+	if (!rcudir)
+		return 1;
+	if (!debugfs_create_file("rcutiny", 0644, rcudir, NULL,
+				 &tiny_stats_fops)) {
+		debugfs_remove_recursive(rcudir);
+		return 1;
+	}
+	return 0;
+}
+late_initcall(rcutiny_trace_init);
+
+#endif /* #ifdef CONFIG_DEBUG_FS */
@@ -252,6 +252,8 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* members get the wakeup and slice treatment of PR_SET_SCHED_LATENCY */
+	int latency_sensitive;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -2473,6 +2475,9 @@ void sched_fork(struct task_struct *p, int clone_flags)
 		p->sched_reset_on_fork = 0;
 	}
 
+	/* Latency sensitivity is asked for per thread, don't leak it */
+	p->sched_latency_sensitive = 0;
+
 	/*
 	 * Make sure we do not leak PI boosting priority to the child.
 	 */
@@ -4327,6 +4332,25 @@ int task_nice(const struct task_struct *p)
 }
 EXPORT_SYMBOL(task_nice);
 
+/**
+ * sched_set_latency_sensitive - favour a task at wakeup
+ * @p: the task in question.
+ * @on: whether it should preempt other fair tasks eagerly.
+ *
+ * The flag shares a word with the other scheduler bits of the task,
+ * so it is only changed under the runqueue lock.
+ */
+int sched_set_latency_sensitive(struct task_struct *p, int on)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+	p->sched_latency_sensitive = !!on;
+	task_rq_unlock(rq, &flags);
+	return 0;
+}
+
 /**
  * idle_cpu - is a given cpu idle currently?
  * @cpu: the processor in question.
@@ -8557,6 +8581,24 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_latency_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				 u64 val)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	/* The root group has nobody to be favoured over */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	tg->latency_sensitive = !!val;
+	return 0;
+}
+
+static u64 cpu_latency_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_sensitive;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -8590,6 +8632,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_sensitive",
+		.read_u64 = cpu_latency_read_u64,
+		.write_u64 = cpu_latency_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
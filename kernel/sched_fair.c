@@ -457,6 +457,36 @@ static u64 __sched_period(unsigned long nr_running)
 	return period;
 }
 
+/*
+ * Latency sensitive tasks (PR_SET_SCHED_LATENCY, or a member of a cpu
+ * cgroup with latency_sensitive set anywhere up the hierarchy) preempt
+ * at wakeup whenever they are behind and are given short slices, so
+ * they get the cpu quickly but don't keep it longer than their share.
+ */
+static int task_latency_sensitive(struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+
+	if (p->sched_latency_sensitive)
+		return 1;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	for_each_sched_entity(se) {
+		if (cfs_rq_of(se)->tg->latency_sensitive)
+			return 1;
+	}
+#endif
+	return 0;
+}
+
+static int entity_latency_sensitive(struct sched_entity *se)
+{
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	if (!entity_is_task(se))
+		return se->my_q->tg->latency_sensitive;
+#endif
+	return task_latency_sensitive(task_of(se));
+}
+
 /*
  * We calculate the wall-time slice from the period by taking a part
  * proportional to the weight.
@@ -466,6 +496,7 @@ static u64 __sched_period(unsigned long nr_running)
 static u64 sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 	u64 slice = __sched_period(cfs_rq->nr_running + !se->on_rq);
+	int latency = entity_latency_sensitive(se);
 
 	for_each_sched_entity(se) {
 		struct load_weight *load;
@@ -482,6 +513,8 @@ static u64 sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		}
 		slice = calc_delta_mine(slice, se->load.weight, load);
 	}
+	if (latency)
+		slice = min_t(u64, slice, sysctl_sched_min_granularity);
 	return slice;
 }
 
@@ -1654,6 +1687,7 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	struct sched_entity *se = &curr->se, *pse = &p->se;
 	struct cfs_rq *cfs_rq = task_cfs_rq(curr);
 	int scale = cfs_rq->nr_running >= sched_nr_latency;
+	int boost;
 
 	if (unlikely(rt_prio(p->prio)))
 		goto preempt;
@@ -1689,11 +1723,22 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 		return;
 
 	update_curr(cfs_rq);
+	boost = task_latency_sensitive(p) && !task_latency_sensitive(curr);
 	find_matching_se(&se, &pse);
 	BUG_ON(!pse);
 	if (wakeup_preempt_entity(se, pse) == 1)
 		goto preempt;
 
+	/*
+	 * A latency sensitive wakee doesn't wait for the wakeup
+	 * granularity; make it the next buddy as well so that it, and not
+	 * just the leftmost task, is what runs next.
+	 */
+	if (boost && (s64)(se->vruntime - pse->vruntime) > 0) {
+		set_next_buddy(&p->se);
+		goto preempt;
+	}
+
 	return;
 
 preempt:
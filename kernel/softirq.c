@@ -24,6 +24,8 @@
 #include <linux/ftrace.h>
 #include <linux/smp.h>
 #include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/sysctl.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/irq.h>
@@ -185,18 +187,30 @@ EXPORT_SYMBOL(local_bh_enable_ip);
  * The two things to balance is latency against fairness -
  * we want to handle softirqs as soon as possible, but they
  * should not be able to lock up the box.
+ *
+ * We also stop restarting once a run has taken softirq_budget_us
+ * (kernel.softirq_budget_us, 0 for no limit) or a task is waiting for
+ * the cpu: on a uniprocessor a burst of NET_RX or SDMA/SDHCI tasklets
+ * would otherwise keep e.g. the input thread off the cpu for the whole
+ * burst.  The rest is left to ksoftirqd, which the scheduler balances
+ * against other tasks at kernel.ksoftirqd_nice.
  */
 #define MAX_SOFTIRQ_RESTART 10
 
+unsigned int sysctl_softirq_budget_us __read_mostly = 2000;
+int sysctl_ksoftirqd_nice __read_mostly;
+
 asmlinkage void __do_softirq(void)
 {
 	struct softirq_action *h;
 	__u32 pending;
 	int max_restart = MAX_SOFTIRQ_RESTART;
+	u64 start, now, prev;
 	int cpu;
 
 	pending = local_softirq_pending();
 	account_system_vtime(current);
+	start = prev = sched_clock();
 
 	__local_bh_disable((unsigned long)__builtin_return_address(0));
 	lockdep_softirq_enter();
@@ -218,6 +232,14 @@ restart:
 			trace_softirq_entry(h, softirq_vec);
 			h->action(h);
 			trace_softirq_exit(h, softirq_vec);
+
+			now = sched_clock();
+			/* sched_clock() may wrap */
+			if ((s64)(now - prev) > 0)
+				kstat_add_softirq_time_this_cpu(h - softirq_vec,
+								now - prev);
+			prev = now;
+
 			if (unlikely(prev_count != preempt_count())) {
 				printk(KERN_ERR "huh, entered softirq %td %s %p"
 				       "with preempt_count %08x,"
@@ -236,11 +258,16 @@ restart:
 	local_irq_disable();
 
 	pending = local_softirq_pending();
-	if (pending && --max_restart)
-		goto restart;
+	if (pending) {
+		u64 budget = (u64)sysctl_softirq_budget_us * NSEC_PER_USEC;
 
-	if (pending)
+		if (--max_restart && !need_resched() &&
+		    (!budget || prev - start < budget))
+			goto restart;
+
+		kstat_this_cpu.softirq_handoffs++;
 		wakeup_softirqd();
+	}
 
 	lockdep_softirq_exit();
 
@@ -692,6 +719,24 @@ void __init softirq_init(void)
 	open_softirq(HI_SOFTIRQ, tasklet_hi_action);
 }
 
+int proc_ksoftirqd_nice(struct ctl_table *table, int write,
+			void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	int ret, cpu;
+
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (ret || !write)
+		return ret;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		if (per_cpu(ksoftirqd, cpu))
+			set_user_nice(per_cpu(ksoftirqd, cpu),
+				      sysctl_ksoftirqd_nice);
+	put_online_cpus();
+	return 0;
+}
+
 static int run_ksoftirqd(void * __bind_cpu)
 {
 	set_current_state(TASK_INTERRUPTIBLE);
@@ -811,6 +856,7 @@ static int __cpuinit cpu_callback(struct notifier_block *nfb,
 			return notifier_from_errno(PTR_ERR(p));
 		}
 		kthread_bind(p, hotcpu);
+		set_user_nice(p, sysctl_ksoftirqd_nice);
   		per_cpu(ksoftirqd, hotcpu) = p;
  		break;
 	case CPU_ONLINE:
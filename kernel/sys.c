@@ -14,6 +14,7 @@
 #include <linux/highuid.h>
 #include <linux/fs.h>
 #include <linux/perf_event.h>
+#include <linux/ksm.h>
 #include <linux/resource.h>
 #include <linux/kernel.h>
 #include <linux/kexec.h>
@@ -1611,6 +1612,30 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			else
 				error = PR_MCE_KILL_DEFAULT;
 			break;
+		case PR_SET_MEMORY_MERGE:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			down_write(&me->mm->mmap_sem);
+			error = ksm_merge_any(me->mm, !!arg2);
+			up_write(&me->mm->mmap_sem);
+			break;
+		case PR_GET_MEMORY_MERGE:
+			if (arg2 | arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = !!test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
+			break;
+		case PR_SET_SCHED_LATENCY:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			if (arg2 && !capable(CAP_SYS_NICE))
+				return -EPERM;
+			error = sched_set_latency_sensitive(me, !!arg2);
+			break;
+		case PR_GET_SCHED_LATENCY:
+			if (arg2 | arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = me->sched_latency_sensitive;
+			break;
 		default:
 			error = -EINVAL;
 			break;
@@ -27,6 +27,7 @@
 #include <linux/cgroup.h>
 #include <linux/fs.h>
 #include <linux/file.h>
+#include <linux/pid_namespace.h>
 #include <net/genetlink.h>
 #include <asm/atomic.h>
 
@@ -492,6 +493,60 @@ err:
 	return rc;
 }
 
+/*
+ * TASKSTATS_CMD_GET with NLM_F_DUMP: the TGID stats of every thread group
+ * in the caller's pid namespace, one TASKSTATS_CMD_NEW message each, so a
+ * monitor gets all of them in a few recvmsg() calls instead of one
+ * request per process.  cb->args[0] is the tgid to resume from.
+ */
+static int taskstats_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct task_struct *tsk;
+	struct taskstats *stats;
+	struct pid *pid;
+	pid_t tgid = cb->args[0];
+	void *reply;
+	int rc;
+
+	rcu_read_lock();
+	for (; (pid = find_ge_pid(tgid, ns)); tgid++) {
+		tgid = pid_nr_ns(pid, ns);
+		tsk = pid_task(pid, PIDTYPE_PID);
+		if (!tsk || !has_group_leader_pid(tsk))
+			continue;
+		get_task_struct(tsk);
+		rcu_read_unlock();
+
+		reply = genlmsg_put(skb, NETLINK_CB(cb->skb).pid,
+				    cb->nlh->nlmsg_seq, &family, NLM_F_MULTI,
+				    TASKSTATS_CMD_NEW);
+		if (!reply)
+			goto full;
+		stats = mk_reply(skb, TASKSTATS_TYPE_TGID, tgid);
+		if (!stats) {
+			genlmsg_cancel(skb, reply);
+			goto full;
+		}
+		rc = fill_tgid(tgid, tsk, stats);
+		put_task_struct(tsk);
+		if (rc < 0)
+			genlmsg_cancel(skb, reply);	/* exited meanwhile */
+		else
+			genlmsg_end(skb, reply);
+
+		rcu_read_lock();
+	}
+	rcu_read_unlock();
+	cb->args[0] = tgid;
+	return skb->len;
+
+full:
+	put_task_struct(tsk);
+	cb->args[0] = tgid;
+	return skb->len;
+}
+
 static struct taskstats *taskstats_tgid_alloc(struct task_struct *tsk)
 {
 	struct signal_struct *sig = tsk->signal;
@@ -581,6 +636,7 @@ err:
 static struct genl_ops taskstats_ops = {
 	.cmd		= TASKSTATS_CMD_GET,
 	.doit		= taskstats_user_cmd,
+	.dumpit		= taskstats_dump,
 	.policy		= taskstats_cmd_get_policy,
 };
 
@@ -33,6 +33,9 @@
 #include <linux/kallsyms.h>
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hash.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
 
@@ -245,10 +248,156 @@ struct cpu_workqueue_struct *get_wq_data(struct work_struct *work)
 	return (void *) (atomic_long_read(&work->data) & WORK_STRUCT_WQ_DATA_MASK);
 }
 
+#ifdef CONFIG_WORKQUEUE_STATS
+/*
+ * Per work function queue delay and execution time.  Delayed work is
+ * stamped when its timer puts it on the worklist, so its queue delay
+ * starts at the time it became due.  Functions that don't fit in the
+ * table are only counted.
+ */
+#define WQ_STAT_HASH_BITS	7
+#define WQ_STAT_BUCKETS		16	/* [2^(n-1), 2^n) us, last open */
+
+struct wq_func_stat {
+	work_func_t func;
+	u32 count;
+	u32 queue_max_us;
+	u32 exec_max_us;
+	u64 queue_total_us;
+	u64 exec_total_us;
+	u32 queue_hist[WQ_STAT_BUCKETS];
+	u32 exec_hist[WQ_STAT_BUCKETS];
+};
+
+static DEFINE_SPINLOCK(wq_stat_lock);
+static struct wq_func_stat wq_stats[1 << WQ_STAT_HASH_BITS];
+static u32 wq_stat_overflow;
+
+static inline void wq_stat_queued(struct work_struct *work)
+{
+	work->queued = ktime_get();
+}
+
+static void wq_stat_hist(u32 *hist, u32 *max, u64 *total, s64 us)
+{
+	u32 v = us < 0 ? 0 : min_t(s64, us, UINT_MAX);
+
+	hist[min(fls(v), WQ_STAT_BUCKETS - 1)]++;
+	*total += v;
+	if (v > *max)
+		*max = v;
+}
+
+static void wq_stat_account(work_func_t f, ktime_t queued, ktime_t start)
+{
+	unsigned long h = hash_ptr((void *)f, WQ_STAT_HASH_BITS);
+	struct wq_func_stat *st = NULL;
+	ktime_t end = ktime_get();
+	int i;
+
+	spin_lock_irq(&wq_stat_lock);
+	for (i = 0; i < ARRAY_SIZE(wq_stats); i++) {
+		st = &wq_stats[(h + i) & (ARRAY_SIZE(wq_stats) - 1)];
+		if (st->func == f)
+			break;
+		if (!st->func) {
+			st->func = f;
+			break;
+		}
+	}
+	if (i == ARRAY_SIZE(wq_stats)) {
+		wq_stat_overflow++;
+	} else {
+		st->count++;
+		wq_stat_hist(st->queue_hist, &st->queue_max_us,
+			     &st->queue_total_us, ktime_us_delta(start, queued));
+		wq_stat_hist(st->exec_hist, &st->exec_max_us,
+			     &st->exec_total_us, ktime_us_delta(end, start));
+	}
+	spin_unlock_irq(&wq_stat_lock);
+}
+
+static void wq_stat_show_hist(struct seq_file *m, const char *name, u32 *hist)
+{
+	int i;
+
+	seq_printf(m, "  %-5s", name);
+	for (i = 0; i < WQ_STAT_BUCKETS; i++)
+		seq_printf(m, " %u", hist[i]);
+	seq_putc(m, '\n');
+}
+
+static int wq_stats_show(struct seq_file *m, void *v)
+{
+	struct wq_func_stat st;
+	int i;
+
+	seq_printf(m, "# count queue_avg_us queue_max_us exec_avg_us exec_max_us function\n");
+	seq_printf(m, "# histograms: <1us 1us 2us 4us ... %dus+\n",
+		   1 << (WQ_STAT_BUCKETS - 2));
+	for (i = 0; i < ARRAY_SIZE(wq_stats); i++) {
+		spin_lock_irq(&wq_stat_lock);
+		st = wq_stats[i];
+		spin_unlock_irq(&wq_stat_lock);
+		if (!st.func || !st.count)
+			continue;
+
+		seq_printf(m, "%u %llu %u %llu %u %pf\n", st.count,
+			   div_u64(st.queue_total_us, st.count),
+			   st.queue_max_us,
+			   div_u64(st.exec_total_us, st.count),
+			   st.exec_max_us, st.func);
+		wq_stat_show_hist(m, "queue", st.queue_hist);
+		wq_stat_show_hist(m, "exec", st.exec_hist);
+	}
+	if (wq_stat_overflow)
+		seq_printf(m, "# %u runs of functions not in the table\n",
+			   wq_stat_overflow);
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_show, NULL);
+}
+
+/* Any write clears the statistics */
+static ssize_t wq_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	spin_lock_irq(&wq_stat_lock);
+	memset(wq_stats, 0, sizeof(wq_stats));
+	wq_stat_overflow = 0;
+	spin_unlock_irq(&wq_stat_lock);
+	return count;
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.write		= wq_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	debugfs_create_file("workqueue_stats", 0644, NULL, NULL,
+			    &wq_stats_fops);
+	return 0;
+}
+late_initcall(wq_stats_init);
+#else
+static inline void wq_stat_queued(struct work_struct *work)
+{
+}
+#endif
+
 static void insert_work(struct cpu_workqueue_struct *cwq,
 			struct work_struct *work, struct list_head *head)
 {
 	trace_workqueue_insertion(cwq->thread, work);
+	wq_stat_queued(work);
 
 	set_wq_data(work, cwq);
 	/*
@@ -399,6 +548,11 @@ static void run_workqueue(struct cpu_workqueue_struct *cwq)
 		 * make a copy and use that here.
 		 */
 		struct lockdep_map lockdep_map = work->lockdep_map;
+#endif
+#ifdef CONFIG_WORKQUEUE_STATS
+		/* The work item may be freed or requeued by f() */
+		ktime_t queued = work->queued;
+		ktime_t start = ktime_get();
 #endif
 		trace_workqueue_execution(cwq->thread, work);
 		debug_work_deactivate(work);
@@ -413,6 +567,9 @@ static void run_workqueue(struct cpu_workqueue_struct *cwq)
 		f(work);
 		lock_map_release(&lockdep_map);
 		lock_map_release(&cwq->wq->lockdep_map);
+#ifdef CONFIG_WORKQUEUE_STATS
+		wq_stat_account(f, queued, start);
+#endif
 
 		if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
 			printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
@@ -0,0 +1,177 @@
+/*
+ * LZ4 decompressor for the Linux kernel.
+ *
+ * Handles the "legacy" stream written by "lz4 -l": a 4 byte magic
+ * followed by blocks, each prefixed with its compressed size and
+ * decompressing to at most 8MB.  Streams may be concatenated, the
+ * magic is accepted again between blocks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+#include <linux/compiler.h>
+
+#include <asm/unaligned.h>
+
+#define LZ4_LEGACY_MAGIC	0x184C2102
+#define LZ4_LEGACY_BLOCK_SIZE	(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+				int (*fill) (void *, unsigned int),
+				int (*flush) (void *, unsigned int),
+				u8 *output, int *posp,
+				void (*error_fn) (char *x))
+{
+	int ret = -1;
+	size_t dest_len;
+	u32 chunksize;
+	long size = in_len;
+	u8 *inp, *outp;
+	u8 *in_buf = NULL, *out_buf = NULL;
+
+	set_error_fn(error_fn);
+
+	if (output) {
+		outp = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit_0;
+	} else {
+		out_buf = large_malloc(LZ4_LEGACY_BLOCK_SIZE);
+		if (!out_buf) {
+			error("Could not allocate output buffer");
+			goto exit_0;
+		}
+		outp = out_buf;
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided, don't know what to do");
+		goto exit_1;
+	} else if (input) {
+		inp = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		in_buf = large_malloc(lz4_compressbound(LZ4_LEGACY_BLOCK_SIZE));
+		if (!in_buf) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+		inp = in_buf;
+	}
+
+	if (posp)
+		*posp = 0;
+
+	if (fill) {
+		size = fill(inp, 4);
+		if (size < 4) {
+			error("data corrupted");
+			goto exit_2;
+		}
+	} else if (size < 4) {
+		error("data corrupted");
+		goto exit_2;
+	}
+	if (get_unaligned_le32(inp) != LZ4_LEGACY_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	if (posp)
+		*posp += 4;
+	if (!fill) {
+		inp += 4;
+		size -= 4;
+	}
+
+	for (;;) {
+		if (fill) {
+			inp = in_buf;
+			size = fill(inp, 4);
+			if (size < 4)
+				break;
+		} else if (size <= 4) {
+			/* end of input, or the size_append tail of a zImage */
+			break;
+		}
+
+		chunksize = get_unaligned_le32(inp);
+		if (chunksize == LZ4_LEGACY_MAGIC) {
+			/* concatenated stream */
+			if (!fill) {
+				inp += 4;
+				size -= 4;
+			}
+			if (posp)
+				*posp += 4;
+			continue;
+		}
+		if (chunksize == 0) {
+			/* padding behind the stream, leave it to the caller */
+			break;
+		}
+
+		if (!fill) {
+			inp += 4;
+			size -= 4;
+		}
+		if (chunksize > lz4_compressbound(LZ4_LEGACY_BLOCK_SIZE)) {
+			error("chunk length is longer than the block size");
+			goto exit_2;
+		}
+		if (fill) {
+			size = fill(inp, chunksize);
+			if (size < (long)chunksize) {
+				error("data corrupted");
+				goto exit_2;
+			}
+		} else if ((long)chunksize > size) {
+			error("data corrupted");
+			goto exit_2;
+		}
+
+		dest_len = LZ4_LEGACY_BLOCK_SIZE;
+		ret = lz4_decompress_unknownoutputsize(inp, chunksize,
+				outp, &dest_len);
+		if (ret < 0) {
+			error("Decoding failed");
+			goto exit_2;
+		}
+		ret = -1;
+
+		if (flush && flush(outp, dest_len) != (long)dest_len)
+			goto exit_2;
+		if (output)
+			outp += dest_len;
+		if (posp)
+			*posp += chunksize + 4;
+		if (!fill) {
+			inp += chunksize;
+			size -= chunksize;
+		}
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(in_buf);
+exit_1:
+	if (!output)
+		large_free(out_buf);
+exit_0:
+	return ret;
+}
+
+#define decompress unlz4
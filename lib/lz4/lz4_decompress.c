@@ -0,0 +1,125 @@
+/*
+ * LZ4 Decompressor for the Linux kernel.
+ *
+ * An LZ4 block is a series of sequences.  Each one starts with a token
+ * byte: the high nibble is the literal length, the low nibble the match
+ * length minus 4, and a nibble of 15 continues in the following bytes
+ * (each 255 adds on, the first byte below 255 ends the length).  Then
+ * come the literals, a 16-bit little endian match offset and the
+ * extra match length bytes.  The last sequence of a block carries
+ * literals only.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#endif
+#include <linux/lz4.h>
+
+#define LZ4_MINMATCH	4
+#define LZ4_ML_BITS	4
+#define LZ4_ML_MASK	((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_MASK	((1U << (8 - LZ4_ML_BITS)) - 1)
+
+/* Extend a 15 length nibble; returns -1 if the input runs out. */
+static inline int lz4_read_length(const unsigned char **ipp,
+		const unsigned char *iend, size_t *length)
+{
+	const unsigned char *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (ip >= iend)
+			return -1;
+		s = *ip++;
+		*length += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char *const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char *const oend = dest + *dest_len;
+	const unsigned char *match;
+	unsigned int token;
+	size_t length, offset, n;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* literals */
+		length = token >> LZ4_ML_BITS;
+		if (length == LZ4_RUN_MASK &&
+		    lz4_read_length(&ip, iend, &length))
+			goto _output_error;
+		if (length > (size_t)(iend - ip) ||
+		    length > (size_t)(oend - op))
+			goto _output_error;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* the last sequence has no match part */
+		if (ip >= iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			goto _output_error;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dest))
+			goto _output_error;
+		match = op - offset;
+
+		length = token & LZ4_ML_MASK;
+		if (length == LZ4_ML_MASK &&
+		    lz4_read_length(&ip, iend, &length))
+			goto _output_error;
+		length += LZ4_MINMATCH;
+		if (length > (size_t)(oend - op))
+			goto _output_error;
+
+		if (offset >= length) {
+			memcpy(op, match, length);
+			op += length;
+		} else if (offset == 1) {
+			/* a run; no memset() in the boot decompressor */
+			while (length--)
+				*op++ = *match;
+		} else {
+			/* overlapping: the pattern repeats every offset bytes */
+			while (length) {
+				n = offset < length ? offset : length;
+				memcpy(op, match, n);
+				op += n;
+				match += n;
+				length -= n;
+			}
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+_output_error:
+	*dest_len = op - dest;
+	return -1;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
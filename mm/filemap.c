@@ -122,6 +122,7 @@ void __remove_from_page_cache(struct page *page)
 	radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
+	mem_cgroup_del_owned_page(mapping);
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	if (PageSwapBacked(page))
 		__dec_zone_page_state(page, NR_SHMEM);
@@ -416,6 +417,7 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 		error = radix_tree_insert(&mapping->page_tree, offset, page);
 		if (likely(!error)) {
 			mapping->nrpages++;
+			mem_cgroup_add_owned_page(mapping);
 			__inc_zone_page_state(page, NR_FILE_PAGES);
 			if (PageSwapBacked(page))
 				__inc_zone_page_state(page, NR_SHMEM);
@@ -1629,8 +1631,68 @@ page_not_uptodate:
 }
 EXPORT_SYMBOL(filemap_fault);
 
+/**
+ * filemap_map_pages - map cached pages around a read fault
+ * @vma:	vma in which the fault was taken
+ * @vmf:	pages vmf->pgoff to vmf->max_pgoff, vmf->pte is that of pgoff
+ *
+ * Maps whatever is already uptodate in the page cache in that range and
+ * not mapped yet.  Pages that are locked, still being read or marked for
+ * async readahead are left to filemap_fault(), so readahead keeps going.
+ * Called with the page table lock held.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	unsigned long address = (unsigned long)vmf->virtual_address;
+	struct page *pages[PAGEVEC_SIZE];
+	pgoff_t index = vmf->pgoff;
+	pgoff_t size;
+	unsigned int i, nr;
+
+	size = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+		PAGE_CACHE_SHIFT;
+
+	while (index <= vmf->max_pgoff) {
+		nr = find_get_pages(mapping, index,
+				    min_t(unsigned long, PAGEVEC_SIZE,
+					  vmf->max_pgoff - index + 1), pages);
+		if (!nr)
+			break;
+		index = pages[nr - 1]->index + 1;
+
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+			unsigned long off = page->index - vmf->pgoff;
+			pte_t *pte = vmf->pte + off;
+
+			if (page->index > vmf->max_pgoff || !pte_none(*pte))
+				goto skip;
+			if (!PageUptodate(page) || PageReadahead(page))
+				goto skip;
+			if (!trylock_page(page))
+				goto skip;
+			if (page->mapping != mapping || !PageUptodate(page))
+				goto unlock;
+			if (page->index >= size || PageHWPoison(page))
+				goto unlock;
+
+			/* the mapping keeps the reference find_get_pages took */
+			do_set_pte(vma, address + (off << PAGE_SHIFT), page, pte);
+			unlock_page(page);
+			continue;
+unlock:
+			unlock_page(page);
+skip:
+			page_cache_release(page);
+		}
+	}
+}
+EXPORT_SYMBOL(filemap_map_pages);
+
 const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -32,6 +32,7 @@
 #include <linux/memory.h>
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
+#include <linux/power_supply.h>
 #include <linux/ksm.h>
 
 #include <asm/tlbflush.h>
@@ -188,8 +189,38 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
+
+#ifdef CONFIG_KSM_BACKGROUND
+static unsigned int ksm_run = KSM_RUN_MERGE;
+static unsigned int ksm_thread_idle_millisecs = 5000;
+static unsigned int ksm_thread_charger_only = 1;
+static unsigned int ksm_thread_max_cpu_percent = 10;
+#else
 static unsigned int ksm_run = KSM_RUN_STOP;
 
+/* Milliseconds since ksm_note_activity() before ksmd may scan, 0 for any */
+static unsigned int ksm_thread_idle_millisecs;
+
+/* Whether ksmd only scans while on external power */
+static unsigned int ksm_thread_charger_only;
+
+/* Share of a CPU that ksmd may use, averaged over a batch and its sleep */
+static unsigned int ksm_thread_max_cpu_percent = 100;
+#endif
+
+/* Last time someone told us the device is in use */
+static unsigned long ksm_last_activity = INITIAL_JIFFIES;
+
+/* Pages looked at by ksmd, and batches put off until the device is idle */
+static unsigned long ksm_pages_scanned;
+static unsigned long ksm_scans_deferred;
+
+static struct task_struct *ksm_thread;
+
+/* Wakes ksmd to check again whether it may scan, see ksmd_defer() */
+static struct timer_list ksm_recheck_timer;
+static int ksm_recheck;
+
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
@@ -1377,6 +1408,7 @@ static void ksm_do_scan(unsigned int scan_npages)
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		ksm_pages_scanned++;
 	}
 }
 
@@ -1385,19 +1417,95 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/**
+ * ksm_note_activity - the device is in use
+ *
+ * Called by drivers on user visible activity, such as a display update.
+ * ksmd does not scan until idle_millisecs have passed since.
+ */
+void ksm_note_activity(void)
+{
+	ksm_last_activity = jiffies;
+}
+EXPORT_SYMBOL_GPL(ksm_note_activity);
+
+/*
+ * When ksmd may not scan yet, return how long to wait before looking
+ * again; 0 if it may scan now.
+ */
+static unsigned long ksmd_defer(void)
+{
+	if (ksm_thread_idle_millisecs) {
+		unsigned long idle = ksm_last_activity +
+			msecs_to_jiffies(ksm_thread_idle_millisecs);
+
+		if (time_before(jiffies, idle))
+			return idle - jiffies;
+	}
+#ifdef CONFIG_POWER_SUPPLY
+	if (ksm_thread_charger_only && power_supply_is_system_supplied() <= 0)
+		return 5 * HZ;
+#endif
+	return 0;
+}
+
+/*
+ * Stretch the sleep after a batch that cost cpu_ns of CPU time, so that
+ * ksmd uses no more than max_cpu_percent of the CPU.
+ */
+static unsigned long ksmd_throttle(unsigned long sleep, u64 cpu_ns)
+{
+	unsigned int pct = ksm_thread_max_cpu_percent;
+	u64 ms;
+
+	if (pct >= 100)
+		return sleep;
+
+	ms = cpu_ns * (100 - pct);
+	do_div(ms, pct * NSEC_PER_MSEC);
+	return max_t(unsigned long, sleep, msecs_to_jiffies(ms));
+}
+
+static void ksm_recheck_timer_fn(unsigned long data)
+{
+	ksm_recheck = 1;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
 static int ksm_scan_thread(void *nothing)
 {
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		unsigned long sleep = msecs_to_jiffies(ksm_thread_sleep_millisecs);
+		unsigned long defer = 0;
+
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			defer = ksmd_defer();
+			if (!defer) {
+				u64 cpu = task_sched_runtime(current);
+
+				ksm_do_scan(ksm_thread_pages_to_scan);
+				sleep = ksmd_throttle(sleep,
+					task_sched_runtime(current) - cpu);
+			} else
+				ksm_scans_deferred++;
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
-		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+		if (defer) {
+			/*
+			 * Waiting for the device to become idle or to be put
+			 * on charge: a deferrable timer does not wake the CPU
+			 * just to find that out.
+			 */
+			ksm_recheck = 0;
+			mod_timer(&ksm_recheck_timer, jiffies + defer);
+			wait_event_interruptible(ksm_thread_wait,
+				ksm_recheck || kthread_should_stop());
+		} else if (ksmd_should_run()) {
+			schedule_timeout_interruptible(sleep);
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1406,6 +1514,14 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+/*
+ * Be somewhat over-protective for now!
+ */
+#define KSM_UNMERGEABLE_FLAGS	(VM_SHARED  | VM_MAYSHARE   | VM_PFNMAP    | \
+				 VM_IO      | VM_DONTEXPAND | VM_RESERVED  | \
+				 VM_HUGETLB | VM_INSERTPAGE | VM_NONLINEAR | \
+				 VM_MIXEDMAP | VM_SAO)
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1414,13 +1530,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
-		/*
-		 * Be somewhat over-protective for now!
-		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
-				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
+		if (*vm_flags & (VM_MERGEABLE | KSM_UNMERGEABLE_FLAGS))
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
@@ -1449,6 +1559,50 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+void __ksm_add_vma(struct vm_area_struct *vma)
+{
+	if (!(vma->vm_flags & KSM_UNMERGEABLE_FLAGS))
+		vma->vm_flags |= VM_MERGEABLE;
+}
+
+/*
+ * PR_SET_MEMORY_MERGE: make all eligible vmas of mm mergeable, now and as
+ * they are mapped, or undo that.  Called with mmap_sem held for writing.
+ */
+int ksm_merge_any(struct mm_struct *mm, int enable)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (!enable) {
+		if (!test_and_clear_bit(MMF_VM_MERGE_ANY, &mm->flags))
+			return 0;
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (!(vma->vm_flags & VM_MERGEABLE))
+				continue;
+			if (vma->anon_vma) {
+				err = unmerge_ksm_pages(vma, vma->vm_start,
+							vma->vm_end);
+				if (err)
+					return err;
+			}
+			vma->vm_flags &= ~VM_MERGEABLE;
+		}
+		return 0;
+	}
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			return err;
+	}
+
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	for (vma = mm->mmap; vma; vma = vma->vm_next)
+		__ksm_add_vma(vma);
+	return 0;
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1916,6 +2070,99 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t idle_millisecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_idle_millisecs);
+}
+
+static ssize_t idle_millisecs_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	ksm_thread_idle_millisecs = msecs;
+
+	return count;
+}
+KSM_ATTR(idle_millisecs);
+
+static ssize_t charger_only_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_charger_only);
+}
+
+static ssize_t charger_only_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	ksm_thread_charger_only = val;
+
+	return count;
+}
+KSM_ATTR(charger_only);
+
+static ssize_t max_cpu_percent_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_max_cpu_percent);
+}
+
+static ssize_t max_cpu_percent_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long pct;
+	int err;
+
+	err = strict_strtoul(buf, 10, &pct);
+	if (err || pct < 1 || pct > 100)
+		return -EINVAL;
+
+	ksm_thread_max_cpu_percent = pct;
+
+	return count;
+}
+KSM_ATTR(max_cpu_percent);
+
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+static ssize_t scans_deferred_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_scans_deferred);
+}
+KSM_ATTR_RO(scans_deferred);
+
+static ssize_t cpu_time_ms_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	u64 ns = task_sched_runtime(ksm_thread);
+
+	do_div(ns, NSEC_PER_MSEC);
+	return sprintf(buf, "%llu\n", (unsigned long long)ns);
+}
+KSM_ATTR_RO(cpu_time_ms);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1925,6 +2172,12 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&idle_millisecs_attr.attr,
+	&charger_only_attr.attr,
+	&max_cpu_percent_attr.attr,
+	&pages_scanned_attr.attr,
+	&scans_deferred_attr.attr,
+	&cpu_time_ms_attr.attr,
 	NULL,
 };
 
@@ -1936,7 +2189,6 @@ static struct attribute_group ksm_attr_group = {
 
 static int __init ksm_init(void)
 {
-	struct task_struct *ksm_thread;
 	int err;
 
 	err = ksm_slab_init();
@@ -1947,6 +2199,8 @@ static int __init ksm_init(void)
 	if (err)
 		goto out_free1;
 
+	init_timer_deferrable(&ksm_recheck_timer);
+	ksm_recheck_timer.function = ksm_recheck_timer_fn;
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
@@ -0,0 +1,546 @@
+/*
+ * mm/launch_prefetch.c - Record-and-replay prefetch for application launches
+ *
+ * Readahead only ever sees one file and one access stream at a time, so a
+ * cold application launch turns into hundreds of small synchronous reads
+ * spread over its binaries, libraries, APKs and dex files.  The access
+ * pattern is however much the same from one launch to the next.  This
+ * records the page ranges readahead had to read from disk during the first
+ * record_ms of a launch, keeps them as a named profile and, on the next
+ * launch under that name, reads them all back in one go from a worker
+ * thread while the application is still starting up.
+ *
+ * A launch is either the exec of a binary whose comm matches a profile, or
+ * a process the launcher points at explicitly (a zygote child never execs).
+ * Everything is driven through /proc/launch_prefetch:
+ *
+ *   exec <comm>                    record the next exec of <comm>, replay
+ *                                  the profile on every exec after that
+ *   launch <pid> <name>            replay <name> if it exists, else record
+ *                                  <pid>'s thread group under <name>
+ *   add <name> <start> <nr> <path> add pages [start, start + nr) of <path>
+ *   drop <name>                    forget a profile
+ *   clear                          forget all profiles
+ *
+ * Reading the file prints the profiles back as exec and add commands, so
+ * they can be saved before shutdown and fed back in at boot.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/file.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/launch_prefetch.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mount.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/namei.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#define LP_MAX_FILES	128
+#define LP_MAX_EXTENTS	512
+#define LP_CMD_MAX	(PATH_MAX + 64)
+
+struct lp_extent {
+	pgoff_t		start;
+	unsigned int	nr;
+	unsigned short	file;
+};
+
+struct lp_profile {
+	struct list_head	list;
+	char			name[TASK_COMM_LEN];
+	bool			record;		/* armed by "exec", not recorded yet */
+	unsigned int		users;		/* the list and running replays */
+	unsigned int		launches;
+	unsigned long		replayed;	/* pages read by replays */
+	unsigned int		dropped;	/* ranges that did not fit */
+	unsigned int		nr_files;
+	unsigned int		nr_ext;
+	struct path		files[LP_MAX_FILES];
+	struct lp_extent	ext[LP_MAX_EXTENTS];
+};
+
+struct lp_replay {
+	struct work_struct	work;
+	char			name[TASK_COMM_LEN];
+};
+
+static unsigned int record_ms = 5000;
+module_param(record_ms, uint, 0644);
+MODULE_PARM_DESC(record_ms, "How long a launch is recorded for");
+
+static unsigned int max_profiles = 32;
+module_param(max_profiles, uint, 0644);
+MODULE_PARM_DESC(max_profiles, "Profiles kept before the least recently launched is dropped");
+
+pid_t launch_prefetch_tgid;
+
+/* lp_lock protects the recording, lp_mutex the profile list */
+static DEFINE_SPINLOCK(lp_lock);
+static struct lp_profile *lp_rec;
+static DEFINE_MUTEX(lp_mutex);
+static LIST_HEAD(lp_profiles);	/* most recently launched first */
+static unsigned int lp_nr_profiles;
+
+static struct workqueue_struct *lp_wq;
+static void lp_finish_record(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lp_finish_work, lp_finish_record);
+
+static struct lp_profile *lp_alloc(const char *name)
+{
+	struct lp_profile *p;
+
+	p = vmalloc(sizeof(*p));
+	if (!p)
+		return NULL;
+	memset(p, 0, offsetof(struct lp_profile, files));
+	INIT_LIST_HEAD(&p->list);
+	p->users = 1;
+	strlcpy(p->name, name, sizeof(p->name));
+	return p;
+}
+
+static void lp_free(struct lp_profile *p)
+{
+	unsigned int i;
+
+	for (i = 0; i < p->nr_files; i++)
+		path_put(&p->files[i]);
+	vfree(p);
+}
+
+static void lp_put(struct lp_profile *p)
+{
+	if (!--p->users)
+		lp_free(p);
+}
+
+static void lp_unlink(struct lp_profile *p)
+{
+	list_del_init(&p->list);
+	lp_nr_profiles--;
+	lp_put(p);
+}
+
+/*
+ * Add a page range to a profile, merging it into the previous range when
+ * the two overlap or touch.  Never sleeps: called under lp_lock while
+ * recording.
+ */
+static void lp_add(struct lp_profile *p, struct path *path, pgoff_t start,
+		   unsigned long nr)
+{
+	struct lp_extent *e;
+	unsigned int f;
+
+	for (f = 0; f < p->nr_files; f++)
+		if (p->files[f].dentry == path->dentry &&
+		    p->files[f].mnt == path->mnt)
+			break;
+	if (f == p->nr_files) {
+		if (f == LP_MAX_FILES)
+			goto drop;
+		p->files[f] = *path;
+		path_get(path);
+		p->nr_files++;
+	}
+
+	if (p->nr_ext) {
+		e = &p->ext[p->nr_ext - 1];
+		if (e->file == f && start >= e->start &&
+		    start <= e->start + e->nr) {
+			e->nr = max_t(unsigned long, e->nr,
+				      start + nr - e->start);
+			return;
+		}
+	}
+	if (p->nr_ext == LP_MAX_EXTENTS)
+		goto drop;
+	e = &p->ext[p->nr_ext++];
+	e->start = start;
+	e->nr = nr;
+	e->file = f;
+	return;
+drop:
+	p->dropped++;
+}
+
+void __launch_prefetch_record(struct file *filp, pgoff_t start,
+			      unsigned long nr)
+{
+	spin_lock(&lp_lock);
+	if (lp_rec && current->tgid == launch_prefetch_tgid)
+		lp_add(lp_rec, &filp->f_path, start, nr);
+	spin_unlock(&lp_lock);
+}
+
+static struct lp_profile *lp_find(const char *name)
+{
+	struct lp_profile *p;
+
+	list_for_each_entry(p, &lp_profiles, list)
+		if (!strncmp(p->name, name, TASK_COMM_LEN))
+			return p;
+	return NULL;
+}
+
+/* Replace any profile of the same name, evicting the coldest if full */
+static void lp_insert(struct lp_profile *p)
+{
+	struct lp_profile *old = lp_find(p->name);
+
+	if (old)
+		lp_unlink(old);
+	while (lp_nr_profiles && lp_nr_profiles >= max_profiles)
+		lp_unlink(list_entry(lp_profiles.prev, struct lp_profile, list));
+	list_add(&p->list, &lp_profiles);
+	lp_nr_profiles++;
+}
+
+static int lp_start_record(const char *name, pid_t tgid)
+{
+	struct lp_profile *p = lp_alloc(name);
+
+	if (!p)
+		return -ENOMEM;
+
+	spin_lock(&lp_lock);
+	if (lp_rec) {
+		spin_unlock(&lp_lock);
+		vfree(p);
+		return -EBUSY;
+	}
+	lp_rec = p;
+	launch_prefetch_tgid = tgid;
+	spin_unlock(&lp_lock);
+
+	schedule_delayed_work(&lp_finish_work, msecs_to_jiffies(record_ms));
+	return 0;
+}
+
+static void lp_finish_record(struct work_struct *work)
+{
+	struct lp_profile *p;
+
+	spin_lock(&lp_lock);
+	p = lp_rec;
+	lp_rec = NULL;
+	launch_prefetch_tgid = 0;
+	spin_unlock(&lp_lock);
+
+	if (!p)
+		return;
+	/* Nothing had to be read: keep whatever was there before */
+	if (!p->nr_ext) {
+		lp_free(p);
+		return;
+	}
+	p->launches = 1;
+	mutex_lock(&lp_mutex);
+	lp_insert(p);
+	mutex_unlock(&lp_mutex);
+}
+
+static void lp_replay_work(struct work_struct *work)
+{
+	struct lp_replay *r = container_of(work, struct lp_replay, work);
+	unsigned int i, nr_files, nr_ext;
+	struct file **filps;
+	struct lp_profile *p;
+
+	/*
+	 * Hold a reference rather than lp_mutex while reading, so that execs
+	 * are not held up.  "add" may append to the profile meanwhile; what
+	 * was there when we started is all we look at.
+	 */
+	mutex_lock(&lp_mutex);
+	p = lp_find(r->name);
+	if (!p || !p->nr_ext) {
+		mutex_unlock(&lp_mutex);
+		goto out;
+	}
+	p->users++;
+	nr_files = p->nr_files;
+	nr_ext = p->nr_ext;
+	mutex_unlock(&lp_mutex);
+
+	filps = kcalloc(nr_files, sizeof(*filps), GFP_KERNEL);
+	if (!filps)
+		goto put;
+
+	for (i = 0; i < nr_ext; i++) {
+		struct lp_extent *e = &p->ext[i];
+		struct path *path = &p->files[e->file];
+		struct file *filp = filps[e->file];
+		int ret;
+
+		if (IS_ERR(filp))
+			continue;
+		if (!filp) {
+			/* Deleted or replaced since it was recorded */
+			if (!path->dentry->d_inode || d_unhashed(path->dentry)) {
+				filps[e->file] = ERR_PTR(-ENOENT);
+				continue;
+			}
+			filp = dentry_open(dget(path->dentry), mntget(path->mnt),
+					   O_RDONLY | O_LARGEFILE, current_cred());
+			filps[e->file] = filp;
+			if (IS_ERR(filp))
+				continue;
+		}
+		ret = force_page_cache_readahead(filp->f_mapping, filp,
+						 e->start, e->nr);
+		if (ret > 0)
+			p->replayed += ret;
+	}
+
+	for (i = 0; i < nr_files; i++)
+		if (!IS_ERR_OR_NULL(filps[i]))
+			fput(filps[i]);
+	kfree(filps);
+put:
+	mutex_lock(&lp_mutex);
+	lp_put(p);
+	mutex_unlock(&lp_mutex);
+out:
+	kfree(r);
+}
+
+static void lp_queue_replay(const char *name)
+{
+	struct lp_replay *r = kmalloc(sizeof(*r), GFP_KERNEL);
+
+	if (!r)
+		return;
+	INIT_WORK(&r->work, lp_replay_work);
+	strlcpy(r->name, name, sizeof(r->name));
+	queue_work(lp_wq, &r->work);
+}
+
+/*
+ * Replay the profile of @name if there is one, record it if it was only
+ * armed.  Returns 1 when neither applies.
+ */
+static int lp_launch(const char *name, pid_t tgid)
+{
+	struct lp_profile *p;
+	bool record;
+
+	mutex_lock(&lp_mutex);
+	p = lp_find(name);
+	if (!p) {
+		mutex_unlock(&lp_mutex);
+		return 1;
+	}
+	record = p->record;
+	if (!record) {
+		list_move(&p->list, &lp_profiles);
+		p->launches++;
+	}
+	mutex_unlock(&lp_mutex);
+
+	if (record)
+		return lp_start_record(name, tgid);
+	lp_queue_replay(name);
+	return 0;
+}
+
+/**
+ * launch_prefetch_exec - Called after a successful exec.
+ *
+ * Replays or records the profile named after the new comm of current.
+ */
+void launch_prefetch_exec(void)
+{
+	if (list_empty(&lp_profiles))
+		return;
+	lp_launch(current->comm, current->tgid);
+}
+
+static int lp_cmd_launch(pid_t pid, const char *name)
+{
+	struct task_struct *task;
+	pid_t tgid = 0;
+	int ret;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(pid);
+	if (task)
+		tgid = task->tgid;
+	rcu_read_unlock();
+	if (!tgid)
+		return -ESRCH;
+
+	ret = lp_launch(name, tgid);
+	if (ret == 1)
+		ret = lp_start_record(name, tgid);
+	return ret;
+}
+
+static int lp_cmd_exec(const char *name)
+{
+	struct lp_profile *p;
+
+	mutex_lock(&lp_mutex);
+	p = lp_find(name);
+	if (!p) {
+		p = lp_alloc(name);
+		if (!p) {
+			mutex_unlock(&lp_mutex);
+			return -ENOMEM;
+		}
+		p->record = true;
+		lp_insert(p);
+	}
+	mutex_unlock(&lp_mutex);
+	return 0;
+}
+
+static int lp_cmd_add(const char *name, pgoff_t start, unsigned long nr,
+		      const char *pathname)
+{
+	struct lp_profile *p;
+	struct path path;
+	int ret;
+
+	if (!nr)
+		return -EINVAL;
+	ret = kern_path(pathname, LOOKUP_FOLLOW, &path);
+	if (ret)
+		return ret;
+
+	mutex_lock(&lp_mutex);
+	p = lp_find(name);
+	if (!p) {
+		p = lp_alloc(name);
+		if (!p) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		lp_insert(p);
+	}
+	p->record = false;
+	lp_add(p, &path, start, nr);
+out:
+	mutex_unlock(&lp_mutex);
+	path_put(&path);
+	return ret;
+}
+
+static void lp_cmd_drop(const char *name)
+{
+	struct lp_profile *p, *n;
+
+	mutex_lock(&lp_mutex);
+	list_for_each_entry_safe(p, n, &lp_profiles, list) {
+		if (name && strncmp(p->name, name, TASK_COMM_LEN))
+			continue;
+		lp_unlink(p);
+	}
+	mutex_unlock(&lp_mutex);
+}
+
+static ssize_t lp_write(struct file *file, const char __user *ubuf,
+			size_t count, loff_t *ppos)
+{
+	char name[TASK_COMM_LEN];
+	unsigned long start, nr;
+	char *buf, *cmd;
+	int pid, off = 0;
+	int ret;
+
+	if (count >= LP_CMD_MAX)
+		return -EINVAL;
+	buf = kmalloc(count + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[count] = '\0';
+	cmd = strim(buf);
+
+	if (!cmd[0] || cmd[0] == '#')
+		ret = 0;
+	else if (sscanf(cmd, "exec %15s", name) == 1)
+		ret = lp_cmd_exec(name);
+	else if (sscanf(cmd, "launch %d %15s", &pid, name) == 2)
+		ret = lp_cmd_launch(pid, name);
+	else if (sscanf(cmd, "add %15s %lu %lu %n", name, &start, &nr,
+			&off) == 3 && off)
+		ret = lp_cmd_add(name, start, nr, cmd + off);
+	else if (sscanf(cmd, "drop %15s", name) == 1) {
+		lp_cmd_drop(name);
+		ret = 0;
+	} else if (!strcmp(cmd, "clear")) {
+		lp_cmd_drop(NULL);
+		ret = 0;
+	} else
+		ret = -EINVAL;
+out:
+	kfree(buf);
+	return ret ? ret : count;
+}
+
+static int lp_show(struct seq_file *m, void *unused)
+{
+	struct lp_profile *p;
+	unsigned int i;
+
+	mutex_lock(&lp_mutex);
+	list_for_each_entry(p, &lp_profiles, list) {
+		if (p->record) {
+			seq_printf(m, "exec %s\n", p->name);
+			continue;
+		}
+		seq_printf(m, "# %s launches %u replayed %lu dropped %u\n",
+			   p->name, p->launches, p->replayed, p->dropped);
+		for (i = 0; i < p->nr_ext; i++) {
+			struct lp_extent *e = &p->ext[i];
+
+			seq_printf(m, "add %s %lu %u ", p->name, e->start, e->nr);
+			seq_path(m, &p->files[e->file], "\n");
+			seq_putc(m, '\n');
+		}
+	}
+	mutex_unlock(&lp_mutex);
+	return 0;
+}
+
+static int lp_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lp_show, NULL);
+}
+
+static const struct file_operations lp_fops = {
+	.owner = THIS_MODULE,
+	.open = lp_open,
+	.read = seq_read,
+	.write = lp_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init launch_prefetch_init(void)
+{
+	lp_wq = create_singlethread_workqueue("launch_prefetch");
+	if (!lp_wq)
+		return -ENOMEM;
+	proc_create("launch_prefetch", S_IRUSR | S_IWUSR, NULL, &lp_fops);
+	return 0;
+}
+
+module_init(launch_prefetch_init);
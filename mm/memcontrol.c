@@ -63,6 +63,9 @@ static int really_do_swap_account __initdata = 1; /* for remember boot option*/
 #define do_swap_account		(0)
 #endif
 
+/* Cleared by "nocacheaccount": page cache is then only counted by owner */
+static int do_cache_account __read_mostly = 1;
+
 /*
  * Per memcg event counter is incremented at every pagein/pageout. This counter
  * is used for trigger some periodic events. This is straightforward and better
@@ -87,6 +90,8 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
 	MEM_CGROUP_STAT_SWAPOUT, /* # of pages, swapped out */
 	MEM_CGROUP_EVENTS,	/* incremented at every  pagein/pageout */
+	MEM_CGROUP_STAT_OWNED_FILE, /* # of page cache pages owned */
+	MEM_CGROUP_OWNED_EVENTS, /* incremented as owned pages come and go */
 
 	MEM_CGROUP_STAT_NSTATS,
 };
@@ -177,6 +182,7 @@ struct mem_cgroup_eventfd_list {
 };
 
 static void mem_cgroup_threshold(struct mem_cgroup *mem);
+static void __mem_cgroup_threshold(struct mem_cgroup *mem, int type);
 static void mem_cgroup_oom_notify(struct mem_cgroup *mem);
 
 /*
@@ -241,6 +247,9 @@ struct mem_cgroup {
 	/* thresholds for mem+swap usage. RCU-protected */
 	struct mem_cgroup_thresholds memsw_thresholds;
 
+	/* thresholds for owned page cache. RCU-protected */
+	struct mem_cgroup_thresholds owned_thresholds;
+
 	/* For oom notifier event fd */
 	struct list_head oom_notify;
 
@@ -319,6 +328,7 @@ enum charge_type {
 #define _MEM			(0)
 #define _MEMSWAP		(1)
 #define _OOM_TYPE		(2)
+#define _OWNED			(3)
 #define MEMFILE_PRIVATE(x, val)	(((x) << 16) | (val))
 #define MEMFILE_TYPE(val)	(((val) >> 16) & 0xffff)
 #define MEMFILE_ATTR(val)	((val) & 0xffff)
@@ -656,6 +666,70 @@ static struct mem_cgroup *try_get_mem_cgroup_from_mm(struct mm_struct *mm)
 	return mem;
 }
 
+/*
+ * Page cache by owner.
+ *
+ * Charging every page cache page is what makes memcg expensive, and
+ * it attributes each page to whoever happened to fault it in.  As a
+ * cheap alternative each mapping is owned by the memcg of the task that
+ * added its first page, and all of the mapping's pages are counted
+ * there until it is empty again.  Nothing is charged or limited; the
+ * count shows in memory.owned_file_in_bytes, which takes thresholds.
+ */
+static u64 mem_cgroup_owned_file(struct mem_cgroup *mem)
+{
+	s64 val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_OWNED_FILE);
+
+	/* Per-cpu counts may be transiently negative in sum */
+	return val > 0 ? (u64)val * PAGE_SIZE : 0;
+}
+
+static void mem_cgroup_owned_event(struct mem_cgroup *mem, int val)
+{
+	__this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_OWNED_FILE], val);
+	__this_cpu_inc(mem->stat->count[MEM_CGROUP_OWNED_EVENTS]);
+	if (unlikely(!(__this_cpu_read(
+		mem->stat->count[MEM_CGROUP_OWNED_EVENTS]) &
+			((1 << THRESHOLDS_EVENTS_THRESH) - 1))))
+		__mem_cgroup_threshold(mem, _OWNED);
+}
+
+void mem_cgroup_add_owned_page(struct address_space *mapping)
+{
+	struct mem_cgroup *mem = mapping->owner_memcg;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	if (!mem) {
+		/* Pages added while nobody owned the mapping are not counted */
+		if (mapping->nrpages != 1)
+			return;
+		mem = try_get_mem_cgroup_from_mm(current->mm);
+		if (!mem)
+			return;
+		/* Like a swap record: does not hold off rmdir */
+		mem_cgroup_get(mem);
+		css_put(&mem->css);
+		mapping->owner_memcg = mem;
+	}
+	mem_cgroup_owned_event(mem, 1);
+}
+
+void mem_cgroup_del_owned_page(struct address_space *mapping)
+{
+	struct mem_cgroup *mem = mapping->owner_memcg;
+
+	if (!mem)
+		return;
+
+	mem_cgroup_owned_event(mem, -1);
+	if (!mapping->nrpages) {
+		mapping->owner_memcg = NULL;
+		mem_cgroup_put(mem);
+	}
+}
+
 /*
  * Call callback function against all cgroup under hierarchy tree.
  */
@@ -1530,6 +1604,33 @@ static void refill_stock(struct mem_cgroup *mem, int val)
 	put_cpu_var(memcg_stock);
 }
 
+/*
+ * Give freed charge of @mem back to the local stock rather than to the
+ * res_counter, if the stock is caching @mem already: a task faulting in
+ * pages again right after freeing some then charges nothing up the
+ * hierarchy.  The stock never grows beyond CHARGE_SIZE this way, so at
+ * most that much usage is hidden, as after a refill.  Only charges freed
+ * from both res and memsw can go there.  Returns what is left to
+ * uncharge.
+ */
+static unsigned long uncharge_to_stock(struct mem_cgroup *mem,
+				       unsigned long bytes)
+{
+	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+
+	if (stock->cached == mem && stock->charge < CHARGE_SIZE &&
+	    !atomic_read(&memcg_drain_count)) {
+		unsigned long room = CHARGE_SIZE - stock->charge;
+
+		if (room > bytes)
+			room = bytes;
+		stock->charge += room;
+		bytes -= room;
+	}
+	put_cpu_var(memcg_stock);
+	return bytes;
+}
+
 /*
  * Tries to drain stocked charges in other cpus. This function is asynchronous
  * and just put a work per cpu for draining localy on each cpu. Caller can
@@ -2033,7 +2134,7 @@ int mem_cgroup_cache_charge(struct page *page, struct mm_struct *mm,
 	struct mem_cgroup *mem = NULL;
 	int ret;
 
-	if (mem_cgroup_disabled())
+	if (mem_cgroup_disabled() || !do_cache_account)
 		return 0;
 	if (PageCompound(page))
 		return 0;
@@ -2229,9 +2330,13 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 		batch->memsw_bytes += PAGE_SIZE;
 	return;
 direct_uncharge:
+	if ((!do_swap_account || uncharge_memsw) &&
+	    !test_thread_flag(TIF_MEMDIE) && !uncharge_to_stock(mem, PAGE_SIZE))
+		goto stocked;
 	res_counter_uncharge(&mem->res, PAGE_SIZE);
 	if (uncharge_memsw)
 		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
+stocked:
 	if (unlikely(batch->memcg != mem))
 		memcg_oom_recover(mem);
 	return;
@@ -2367,6 +2472,17 @@ void mem_cgroup_uncharge_end(void)
 	 * This "batch->memcg" is valid without any css_get/put etc...
 	 * bacause we hide charges behind us.
 	 */
+	if (!test_thread_flag(TIF_MEMDIE)) {
+		unsigned long both = batch->bytes;
+		unsigned long left;
+
+		if (do_swap_account && batch->memsw_bytes < both)
+			both = batch->memsw_bytes;
+		left = uncharge_to_stock(batch->memcg, both);
+		batch->bytes -= both - left;
+		if (do_swap_account)
+			batch->memsw_bytes -= both - left;
+	}
 	if (batch->bytes)
 		res_counter_uncharge(&batch->memcg->res, batch->bytes);
 	if (batch->memsw_bytes)
@@ -3134,6 +3250,9 @@ static u64 mem_cgroup_read(struct cgroup *cont, struct cftype *cft)
 		else
 			val = res_counter_read_u64(&mem->memsw, name);
 		break;
+	case _OWNED:
+		val = mem_cgroup_owned_file(mem);
+		break;
 	default:
 		BUG();
 		break;
@@ -3286,6 +3405,7 @@ enum {
 	MCS_PGPGIN,
 	MCS_PGPGOUT,
 	MCS_SWAP,
+	MCS_OWNED_FILE,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -3308,6 +3428,7 @@ struct {
 	{"pgpgin", "total_pgpgin"},
 	{"pgpgout", "total_pgpgout"},
 	{"swap", "total_swap"},
+	{"owned_file", "total_owned_file"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -3336,6 +3457,8 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 		val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_SWAPOUT);
 		s->stat[MCS_SWAP] += val * PAGE_SIZE;
 	}
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_OWNED_FILE);
+	s->stat[MCS_OWNED_FILE] += val * PAGE_SIZE;
 
 	/* per zone stat */
 	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON);
@@ -3461,22 +3584,37 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
-static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
+static struct mem_cgroup_thresholds *
+mem_cgroup_thresholds_of(struct mem_cgroup *memcg, int type)
+{
+	if (type == _MEM)
+		return &memcg->thresholds;
+	else if (type == _MEMSWAP)
+		return &memcg->memsw_thresholds;
+	else if (type == _OWNED)
+		return &memcg->owned_thresholds;
+	BUG();
+}
+
+static u64 mem_cgroup_threshold_usage(struct mem_cgroup *memcg, int type)
+{
+	if (type == _OWNED)
+		return mem_cgroup_owned_file(memcg);
+	return mem_cgroup_usage(memcg, type == _MEMSWAP);
+}
+
+static void __mem_cgroup_threshold(struct mem_cgroup *memcg, int type)
 {
 	struct mem_cgroup_threshold_ary *t;
 	u64 usage;
 	int i;
 
 	rcu_read_lock();
-	if (!swap)
-		t = rcu_dereference(memcg->thresholds.primary);
-	else
-		t = rcu_dereference(memcg->memsw_thresholds.primary);
-
+	t = rcu_dereference(mem_cgroup_thresholds_of(memcg, type)->primary);
 	if (!t)
 		goto unlock;
 
-	usage = mem_cgroup_usage(memcg, swap);
+	usage = mem_cgroup_threshold_usage(memcg, type);
 
 	/*
 	 * current_threshold points to threshold just below usage.
@@ -3514,9 +3652,9 @@ unlock:
 
 static void mem_cgroup_threshold(struct mem_cgroup *memcg)
 {
-	__mem_cgroup_threshold(memcg, false);
+	__mem_cgroup_threshold(memcg, _MEM);
 	if (do_swap_account)
-		__mem_cgroup_threshold(memcg, true);
+		__mem_cgroup_threshold(memcg, _MEMSWAP);
 }
 
 static int compare_thresholds(const void *a, const void *b)
@@ -3557,18 +3695,12 @@ static int mem_cgroup_usage_register_event(struct cgroup *cgrp,
 
 	mutex_lock(&memcg->thresholds_lock);
 
-	if (type == _MEM)
-		thresholds = &memcg->thresholds;
-	else if (type == _MEMSWAP)
-		thresholds = &memcg->memsw_thresholds;
-	else
-		BUG();
-
-	usage = mem_cgroup_usage(memcg, type == _MEMSWAP);
+	thresholds = mem_cgroup_thresholds_of(memcg, type);
+	usage = mem_cgroup_threshold_usage(memcg, type);
 
 	/* Check if a threshold crossed before adding a new one */
 	if (thresholds->primary)
-		__mem_cgroup_threshold(memcg, type == _MEMSWAP);
+		__mem_cgroup_threshold(memcg, type);
 
 	size = thresholds->primary ? thresholds->primary->size + 1 : 1;
 
@@ -3634,12 +3766,7 @@ static void mem_cgroup_usage_unregister_event(struct cgroup *cgrp,
 	int i, j, size;
 
 	mutex_lock(&memcg->thresholds_lock);
-	if (type == _MEM)
-		thresholds = &memcg->thresholds;
-	else if (type == _MEMSWAP)
-		thresholds = &memcg->memsw_thresholds;
-	else
-		BUG();
+	thresholds = mem_cgroup_thresholds_of(memcg, type);
 
 	/*
 	 * Something went wrong if we trying to unregister a threshold
@@ -3647,10 +3774,10 @@ static void mem_cgroup_usage_unregister_event(struct cgroup *cgrp,
 	 */
 	BUG_ON(!thresholds);
 
-	usage = mem_cgroup_usage(memcg, type == _MEMSWAP);
+	usage = mem_cgroup_threshold_usage(memcg, type);
 
 	/* Check if a threshold crossed before removing */
-	__mem_cgroup_threshold(memcg, type == _MEMSWAP);
+	__mem_cgroup_threshold(memcg, type);
 
 	/* Calculate new number of threshold */
 	size = 0;
@@ -3850,6 +3977,13 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "owned_file_in_bytes",
+		.private = MEMFILE_PRIVATE(_OWNED, RES_USAGE),
+		.read_u64 = mem_cgroup_read,
+		.register_event = mem_cgroup_usage_register_event,
+		.unregister_event = mem_cgroup_usage_unregister_event,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -4646,6 +4780,13 @@ struct cgroup_subsys mem_cgroup_subsys = {
 	.use_id = 1,
 };
 
+static int __init disable_cache_account(char *s)
+{
+	do_cache_account = 0;
+	return 1;
+}
+__setup("nocacheaccount", disable_cache_account);
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 
 static int __init disable_swap_account(char *s)
@@ -57,6 +57,8 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/debugfs.h>
+#include <linux/log2.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -721,6 +723,37 @@ out_set_pte:
 	return 0;
 }
 
+/*
+ * With vm.fork_skip_file_ptes set, the page cache ptes of a private file
+ * mapping are left behind at fork: the child faults them back in from
+ * the page cache (and fault-around maps their neighbours with them)
+ * when it touches them.  This is for a parent such as Android's zygote,
+ * which forks every application with lots of big file mappings that
+ * most children hardly use.  Only its anonymous (COWed) pages, swap and
+ * migration entries have to be copied, they are not in the page cache.
+ */
+int sysctl_fork_skip_file_ptes __read_mostly;
+
+static inline int fork_can_skip_file_ptes(struct vm_area_struct *vma)
+{
+	if (!sysctl_fork_skip_file_ptes || !vma->vm_file)
+		return 0;
+	return !(vma->vm_flags & (VM_SHARED | VM_NONLINEAR | VM_PFNMAP |
+				  VM_MIXEDMAP | VM_INSERTPAGE));
+}
+
+/* a present pte of a page cache page, the child can fault it in again */
+static inline int fork_skip_pte(struct vm_area_struct *vma,
+				unsigned long addr, pte_t pte)
+{
+	struct page *page;
+
+	if (!pte_present(pte))
+		return 0;
+	page = vm_normal_page(vma, addr, pte);
+	return page && !PageAnon(page);
+}
+
 static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
 		unsigned long addr, unsigned long end)
@@ -731,6 +764,8 @@ static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	int progress = 0;
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
+	int skip_file = fork_can_skip_file_ptes(vma);
+	unsigned long copied = 0, skipped = 0;
 
 again:
 	init_rss_vec(rss);
@@ -760,10 +795,16 @@ again:
 			progress++;
 			continue;
 		}
+		if (skip_file && fork_skip_pte(vma, addr, *src_pte)) {
+			skipped++;
+			progress++;
+			continue;
+		}
 		entry.val = copy_one_pte(dst_mm, src_mm, dst_pte, src_pte,
 							vma, addr, rss);
 		if (entry.val)
 			break;
+		copied++;
 		progress += 8;
 	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != end);
 
@@ -781,6 +822,9 @@ again:
 	}
 	if (addr != end)
 		goto again;
+
+	count_vm_events(FORK_PTE_COPY, copied);
+	count_vm_events(FORK_PTE_SKIP, skipped);
 	return 0;
 }
 
@@ -2648,7 +2692,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
 		page = swapin_readahead(entry,
@@ -3038,6 +3082,115 @@ unwritable_page:
 	return ret;
 }
 
+/**
+ * do_set_pte - map an uptodate page cache page read-only
+ * @vma: vma the page is mapped in
+ * @address: user virtual address
+ * @page: locked page, whose reference is taken over by the mapping
+ * @pte: none pte for @address, with the page table lock held
+ *
+ * This is the read fault case of __do_fault(), for ->map_pages().
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	flush_icache_page(vma, page);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, mk_pte(page, vma->vm_page_prot));
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+/*
+ * Read faults also map up to fault_around_bytes of neighbouring pages that
+ * are already in the page cache, aligned to that size and within the vma
+ * and the page table, so that walking through a mapped file does not take
+ * a fault per page.  Tunable in debugfs; below two pages it is off.
+ */
+static unsigned long fault_around_bytes = 65536;
+
+static inline unsigned long fault_around_pages(void)
+{
+	return fault_around_bytes >> PAGE_SHIFT;
+}
+
+static inline unsigned long fault_around_mask(void)
+{
+	return ~(fault_around_bytes - 1) & PAGE_MASK;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
+			    &fault_around_bytes_fops);
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & fault_around_mask(), vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * max_pgoff is either the end of the page table, the end of the vma
+	 * or fault_around_pages() from pgoff, whichever is nearest.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1);
+	max_pgoff = min(max_pgoff, pgoff + fault_around_pages() - 1);
+
+	/* Skip what is mapped already, there may be nothing left to do */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vmf.page = NULL;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags, pte_t orig_pte)
@@ -3046,6 +3199,22 @@ static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
 	pte_unmap(page_table);
+
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    fault_around_pages() > 1) {
+		spinlock_t *ptl;
+
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address & PAGE_MASK, page_table, pgoff,
+				flags);
+		/* The faulting page was in the cache and has been mapped */
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
@@ -3254,6 +3423,75 @@ int make_pages_present(unsigned long addr, unsigned long end)
 	return ret == len ? 0 : -EFAULT;
 }
 
+/* map what ->map_pages() finds in the page cache, one page table at a time */
+static void map_cached_pages(struct vm_area_struct *vma, unsigned long addr,
+		unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long next;
+	struct vm_fault vmf;
+	spinlock_t *ptl;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	for (; addr < end; addr = next) {
+		next = pmd_addr_end(addr, end);
+		pgd = pgd_offset(mm, addr);
+		pud = pud_alloc(mm, pgd, addr);
+		if (!pud)
+			return;
+		pmd = pmd_alloc(mm, pud, addr);
+		if (!pmd)
+			return;
+		pte = pte_alloc_map_lock(mm, pmd, addr, &ptl);
+		if (!pte)
+			return;
+
+		vmf.virtual_address = (void __user *)addr;
+		vmf.pte = pte;
+		vmf.pgoff = linear_page_index(vma, addr);
+		vmf.max_pgoff = vmf.pgoff + ((next - addr) >> PAGE_SHIFT) - 1;
+		vmf.flags = 0;
+		vmf.page = NULL;
+		vma->vm_ops->map_pages(vma, &vmf);
+
+		pte_unmap_unlock(pte, ptl);
+	}
+}
+
+/*
+ * Start readahead of the file pages behind [addr, end) of current->mm and
+ * map those of them that are in the page cache already, as read
+ * fault-around does; nothing waits for I/O, the rest is left to faults.
+ * Only linear file mappings with ->map_pages() are handled.  The caller
+ * holds mmap_sem.
+ */
+void prefault_file_range(unsigned long addr, unsigned long end)
+{
+	struct vm_area_struct *vma;
+
+	addr &= PAGE_MASK;
+	end = PAGE_ALIGN(end);
+
+	for (vma = find_vma(current->mm, addr); vma && vma->vm_start < end;
+	     vma = vma->vm_next) {
+		unsigned long start = max(addr, vma->vm_start);
+		unsigned long stop = min(end, vma->vm_end);
+		struct file *file = vma->vm_file;
+
+		if (!file || !vma->vm_ops || !vma->vm_ops->map_pages ||
+		    (vma->vm_flags & (VM_NONLINEAR | VM_PFNMAP | VM_MIXEDMAP)))
+			continue;
+
+		force_page_cache_readahead(file->f_mapping, file,
+					   linear_page_index(vma, start),
+					   (stop - start) >> PAGE_SHIFT);
+		map_cached_pages(vma, start, stop);
+	}
+}
+
 #if !defined(__HAVE_ARCH_GATE_AREA)
 
 #if defined(AT_SYSINFO_EHDR)
@@ -27,6 +27,7 @@
 #include <linux/mempolicy.h>
 #include <linux/rmap.h>
 #include <linux/mmu_notifier.h>
+#include <linux/ksm.h>
 #include <linux/perf_event.h>
 
 #include <asm/uaccess.h>
@@ -1320,6 +1321,7 @@ munmap_back:
 	if (correct_wcount)
 		atomic_inc(&inode->i_writecount);
 out:
+	ksm_add_vma(vma);
 	perf_event_mmap(vma);
 
 	mm->total_vm += len >> PAGE_SHIFT;
@@ -2184,6 +2186,10 @@ unsigned long do_brk(unsigned long addr, unsigned long len)
 	if (security_vm_enough_memory(len >> PAGE_SHIFT))
 		return -ENOMEM;
 
+	/* Before the merge, so that a mergeable heap keeps growing in place */
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		flags |= VM_MERGEABLE;
+
 	/* Can we just expand an old private anonymous mapping? */
 	vma = vma_merge(mm, prev, addr, addr + len, flags,
 					NULL, NULL, pgoff, NULL);
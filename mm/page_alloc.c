@@ -50,6 +50,7 @@
 #include <linux/kmemleak.h>
 #include <linux/memory.h>
 #include <linux/compaction.h>
+#include <linux/ktime.h>
 #include <trace/events/kmem.h>
 #include <linux/ftrace_event.h>
 
@@ -92,6 +93,7 @@ EXPORT_SYMBOL(node_states);
 unsigned long totalram_pages __read_mostly;
 unsigned long totalreserve_pages __read_mostly;
 int percpu_pagelist_fraction;
+int percpu_pagelist_batch;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
 #ifdef CONFIG_PM_SLEEP
@@ -590,6 +592,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int batch_free = 0;
 
 	spin_lock(&zone->lock);
+	__count_vm_event(ZONE_LOCK_FREE);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -628,6 +631,7 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
 	spin_lock(&zone->lock);
+	__count_vm_event(ZONE_LOCK_FREE);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -1017,6 +1021,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	int i;
 	
 	spin_lock(&zone->lock);
+	__count_vm_event(ZONE_LOCK_ALLOC);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype);
 		if (unlikely(page == NULL))
@@ -1323,6 +1328,7 @@ again:
 			WARN_ON_ONCE(order > 1);
 		}
 		spin_lock_irqsave(&zone->lock, flags);
+		__count_vm_event(ZONE_LOCK_ALLOC);
 		page = __rmqueue(zone, order, migratetype);
 		spin_unlock(&zone->lock);
 		if (!page)
@@ -1843,6 +1849,7 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	struct page *page = NULL;
 	struct reclaim_state reclaim_state;
 	struct task_struct *p = current;
+	ktime_t start;
 
 	cond_resched();
 
@@ -1853,7 +1860,9 @@ __alloc_pages_direct_reclaim(gfp_t gfp_mask, unsigned int order,
 	reclaim_state.reclaimed_slab = 0;
 	p->reclaim_state = &reclaim_state;
 
+	start = ktime_get();
 	*did_some_progress = try_to_free_pages(zonelist, order, gfp_mask, nodemask);
+	count_vm_events(ALLOCSTALL_US, ktime_to_us(ktime_sub(ktime_get(), start)));
 
 	p->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
@@ -3285,6 +3294,9 @@ static int zone_batchsize(struct zone *zone)
 #ifdef CONFIG_MMU
 	int batch;
 
+	if (percpu_pagelist_batch)
+		return percpu_pagelist_batch;
+
 	/*
 	 * The per-cpu-pages pools are set to around 1000th of the
 	 * size of the zone.  But no more than 1/2 of a meg.
@@ -3360,6 +3372,9 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	if (percpu_pagelist_batch)
+		pcp->batch = min_t(unsigned long, percpu_pagelist_batch,
+				   max(1UL, high));
 }
 
 static __meminit void setup_zone_pageset(struct zone *zone)
@@ -5068,6 +5083,50 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * percpu_pagelist_batch - sets pcp->batch of every zone on every cpu, and
+ * pcp->high to six times that unless percpu_pagelist_fraction is in use.
+ * Zero goes back to the batch sized from the zone.
+ */
+int percpu_pagelist_batch_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	unsigned int cpu;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || (ret == -EINVAL))
+		return ret;
+	for_each_populated_zone(zone) {
+		unsigned long batch = zone_batchsize(zone);
+
+		for_each_possible_cpu(cpu) {
+			struct per_cpu_pageset *p = per_cpu_ptr(zone->pageset, cpu);
+
+			if (percpu_pagelist_fraction) {
+				setup_pagelist_highmark(p, zone->present_pages /
+						percpu_pagelist_fraction);
+				continue;
+			}
+			p->pcp.high = 6 * batch;
+			p->pcp.batch = max(1UL, batch);
+		}
+	}
+	return 0;
+}
+
+static int __init set_percpu_pagelist_batch(char *str)
+{
+	unsigned long batch;
+
+	if (strict_strtoul(str, 0, &batch) || batch > PERCPU_PAGELIST_BATCH_MAX)
+		return 0;
+	percpu_pagelist_batch = batch;
+	return 1;
+}
+__setup("percpu_pagelist_batch=", set_percpu_pagelist_batch);
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
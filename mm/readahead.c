@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/launch_prefetch.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -189,8 +190,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
 		read_pages(mapping, filp, &page_pool, ret);
+		launch_prefetch_record(filp, offset, page_idx);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
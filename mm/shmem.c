@@ -59,10 +59,12 @@ static struct vfsmount *shm_mnt;
 #include <linux/highmem.h>
 #include <linux/seq_file.h>
 #include <linux/magic.h>
+#include <linux/rmap.h>
 
 #include <asm/uaccess.h>
 #include <asm/div64.h>
 #include <asm/pgtable.h>
+#include <asm/tlbflush.h>
 
 /*
  * The maximum size of a shmem/tmpfs file is limited by the maximum size of
@@ -1161,6 +1163,7 @@ static struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 	pvma.vm_pgoff = idx;
 	pvma.vm_ops = NULL;
 	pvma.vm_policy = spol;
+	atomic_set(&pvma.swap_readahead_info, 0);
 	page = swapin_readahead(entry, gfp, &pvma, 0);
 	return page;
 }
@@ -1272,7 +1275,7 @@ repeat:
 
 	if (swap.val) {
 		/* Look it up and read it in.. */
-		swappage = lookup_swap_cache(swap);
+		swappage = lookup_swap_cache(swap, NULL);
 		if (!swappage) {
 			shmem_swp_unmap(entry);
 			/* here we actually do the io */
@@ -1479,9 +1482,81 @@ failed:
 	return error;
 }
 
+/*
+ * Number of pages mapped ahead of a sequential fault.  Objects like the
+ * reader's prerendered page bitmaps are written front to back straight
+ * after mmap, and without this every 4k of them takes its own trip
+ * through the fault path.
+ */
+#define SHMEM_FAULT_AROUND	16
+
+/*
+ * Populate and map the pages following a fault at @address, stopping at
+ * the first one that is already mapped, at the end of the vma or page
+ * table, at i_size, or wherever shmem_getpage() can't provide a page.
+ * Pages are held locked until their ptes are in, so a racing truncate
+ * either sees them mapped or has already removed them from the cache.
+ */
+static void shmem_fault_around(struct vm_area_struct *vma,
+			       unsigned long address, pgoff_t pgoff)
+{
+	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *pages[SHMEM_FAULT_AROUND];
+	unsigned long addr, end;
+	pgoff_t size;
+	spinlock_t *ptl;
+	pte_t *start_pte, *pte;
+	int nr = 0, mapped = 0, i;
+
+	end = min(vma->vm_end, (address & PMD_MASK) + PMD_SIZE);
+	size = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+
+	for (addr = address + PAGE_SIZE; addr < end && nr < SHMEM_FAULT_AROUND;
+	     addr += PAGE_SIZE) {
+		struct page *page = NULL;
+
+		if (pgoff + nr + 1 >= size)
+			break;
+		if (shmem_getpage(inode, pgoff + nr + 1, &page, SGP_CACHE, NULL))
+			break;
+		pages[nr++] = page;
+	}
+	if (!nr)
+		goto out;
+
+	start_pte = get_locked_pte(mm, address + PAGE_SIZE, &ptl);
+	if (!start_pte)
+		goto release;
+	for (pte = start_pte, addr = address + PAGE_SIZE; mapped < nr;
+	     pte++, addr += PAGE_SIZE) {
+		struct page *page = pages[mapped];
+
+		if (!pte_none(*pte) || page->mapping != inode->i_mapping)
+			break;
+		get_page(page);
+		inc_mm_counter(mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+		set_pte_at(mm, addr, pte, mk_pte(page, vma->vm_page_prot));
+		update_mmu_cache(vma, addr, pte);
+		mapped++;
+	}
+	pte_unmap_unlock(start_pte, ptl);
+release:
+	for (i = 0; i < nr; i++) {
+		unlock_page(pages[i]);
+		page_cache_release(pages[i]);
+	}
+out:
+	/* where the next fault of a sequential writer is expected */
+	vma->vm_file->f_ra.prev_pos =
+		(loff_t)(pgoff + mapped + 1) << PAGE_CACHE_SHIFT;
+}
+
 static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	struct file_ra_state *ra = &vma->vm_file->f_ra;
 	int error;
 	int ret;
 
@@ -1492,6 +1567,11 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (error)
 		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
 
+	if (!(vma->vm_flags & VM_NONLINEAR) && (vmf->pgoff == vma->vm_pgoff ||
+	    vmf->pgoff == ra->prev_pos >> PAGE_CACHE_SHIFT))
+		shmem_fault_around(vma, (unsigned long)vmf->virtual_address,
+				   vmf->pgoff);
+
 	return ret | VM_FAULT_LOCKED;
 }
 
@@ -28,6 +28,8 @@
 #include <linux/memory.h>
 #include <linux/math64.h>
 #include <linux/fault-inject.h>
+#include <linux/debugfs.h>
+#include <linux/hash.h>
 
 /*
  * Lock order:
@@ -217,6 +219,143 @@ static inline void stat(struct kmem_cache *s, enum stat_item si)
 #endif
 }
 
+#ifdef CONFIG_SLUB_ALLOC_SAMPLING
+/*
+ * Allocation sampling: every slub_sample_interval'th allocation on a cpu
+ * records its call site and cache in a fixed table, shown in
+ * /sys/kernel/debug/slub_sample/sites.  With the interval at 0 the fast
+ * path only tests one variable, so this can stay built in.
+ */
+#define SLUB_SAMPLE_SITES_SHIFT	9
+#define SLUB_SAMPLE_SITES	(1 << SLUB_SAMPLE_SITES_SHIFT)
+
+struct slub_sample_site {
+	unsigned long		caller;
+	struct kmem_cache	*cache;
+	unsigned long		samples;
+};
+
+static unsigned int slub_sample_interval;
+static u32 slub_sample_dropped;
+static DEFINE_PER_CPU(unsigned int, slub_sample_countdown);
+static struct slub_sample_site slub_sample_sites[SLUB_SAMPLE_SITES];
+static DEFINE_SPINLOCK(slub_sample_lock);
+
+static int __init setup_slub_sample(char *str)
+{
+	get_option(&str, &slub_sample_interval);
+	return 1;
+}
+__setup("slub_sample=", setup_slub_sample);
+
+/* Called with interrupts disabled */
+static __always_inline int slub_sample_due(void)
+{
+	unsigned int *count;
+
+	if (likely(!slub_sample_interval))
+		return 0;
+
+	count = __this_cpu_ptr(&slub_sample_countdown);
+	if (likely(*count > 1)) {
+		(*count)--;
+		return 0;
+	}
+	*count = slub_sample_interval;
+	return 1;
+}
+
+/* Called with slub_sample_lock held */
+static void __slub_sample_add(struct kmem_cache *s, unsigned long caller,
+			      unsigned long samples)
+{
+	unsigned long h = hash_long(caller ^ (unsigned long)s,
+				    SLUB_SAMPLE_SITES_SHIFT);
+	int i;
+
+	for (i = 0; i < SLUB_SAMPLE_SITES; i++) {
+		struct slub_sample_site *site =
+			&slub_sample_sites[(h + i) & (SLUB_SAMPLE_SITES - 1)];
+
+		if (!site->caller) {
+			site->caller = caller;
+			site->cache = s;
+		}
+		if (site->caller == caller && site->cache == s) {
+			site->samples += samples;
+			return;
+		}
+	}
+	slub_sample_dropped++;
+}
+
+static noinline void slub_sample_record(struct kmem_cache *s,
+					unsigned long caller)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&slub_sample_lock, flags);
+	__slub_sample_add(s, caller, 1);
+	spin_unlock_irqrestore(&slub_sample_lock, flags);
+}
+
+static int slub_sample_has_cache(struct kmem_cache *s)
+{
+	unsigned long flags;
+	int i, found = 0;
+
+	spin_lock_irqsave(&slub_sample_lock, flags);
+	for (i = 0; i < SLUB_SAMPLE_SITES && !found; i++)
+		found = slub_sample_sites[i].cache == s;
+	spin_unlock_irqrestore(&slub_sample_lock, flags);
+
+	return found;
+}
+
+/*
+ * The table refers to caches by pointer: forget a cache that is going
+ * away.  Open addressing cannot just clear its slots, so the rest is
+ * hashed again; without memory for that the samples are all dropped.
+ */
+static void slub_sample_forget(struct kmem_cache *s)
+{
+	struct slub_sample_site *old;
+	unsigned long flags;
+	int i;
+
+	if (!slub_sample_has_cache(s))
+		return;
+
+	old = kmalloc(sizeof(slub_sample_sites), GFP_KERNEL);
+
+	spin_lock_irqsave(&slub_sample_lock, flags);
+	if (old)
+		memcpy(old, slub_sample_sites, sizeof(slub_sample_sites));
+	memset(slub_sample_sites, 0, sizeof(slub_sample_sites));
+	for (i = 0; old && i < SLUB_SAMPLE_SITES; i++)
+		if (old[i].caller && old[i].cache != s)
+			__slub_sample_add(old[i].cache, old[i].caller,
+					  old[i].samples);
+	spin_unlock_irqrestore(&slub_sample_lock, flags);
+
+	kfree(old);
+}
+#else
+static inline int slub_sample_due(void)
+{
+	return 0;
+}
+
+static inline void slub_sample_record(struct kmem_cache *s,
+				      unsigned long caller)
+{
+}
+
+static inline void slub_sample_forget(struct kmem_cache *s)
+{
+}
+#endif /* CONFIG_SLUB_ALLOC_SAMPLING */
+
 /********************************************************************
  * 			Core slab cache functions
  *******************************************************************/
@@ -1694,6 +1833,7 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	void **object;
 	struct kmem_cache_cpu *c;
 	unsigned long flags;
+	int sample;
 
 	gfpflags &= gfp_allowed_mask;
 
@@ -1714,8 +1854,12 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 		c->freelist = get_freepointer(s, object);
 		stat(s, ALLOC_FASTPATH);
 	}
+	sample = slub_sample_due();
 	local_irq_restore(flags);
 
+	if (unlikely(sample) && object)
+		slub_sample_record(s, addr);
+
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->objsize);
 
@@ -2498,6 +2642,7 @@ void kmem_cache_destroy(struct kmem_cache *s)
 		}
 		if (s->flags & SLAB_DESTROY_BY_RCU)
 			rcu_barrier();
+		slub_sample_forget(s);
 		sysfs_slab_remove(s);
 	} else
 		up_write(&slub_lock);
@@ -4679,3 +4824,88 @@ static int __init slab_proc_init(void)
 }
 module_init(slab_proc_init);
 #endif /* CONFIG_SLABINFO */
+
+#ifdef CONFIG_SLUB_ALLOC_SAMPLING
+static void *slub_sample_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos == 0)
+		seq_puts(m, "# samples   objsize cache                caller\n");
+	return *pos < SLUB_SAMPLE_SITES ? pos : NULL;
+}
+
+static void *slub_sample_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+	return *pos < SLUB_SAMPLE_SITES ? pos : NULL;
+}
+
+static void slub_sample_stop(struct seq_file *m, void *v)
+{
+}
+
+static int slub_sample_show(struct seq_file *m, void *v)
+{
+	struct slub_sample_site *site = &slub_sample_sites[*(loff_t *)v];
+	unsigned long flags;
+
+	/* The lock keeps slub_sample_forget() and the cache away */
+	spin_lock_irqsave(&slub_sample_lock, flags);
+	if (site->caller)
+		seq_printf(m, "%9lu %9d %-20s %pS\n", site->samples,
+			   site->cache->objsize, site->cache->name,
+			   (void *)site->caller);
+	spin_unlock_irqrestore(&slub_sample_lock, flags);
+	return 0;
+}
+
+static const struct seq_operations slub_sample_op = {
+	.start = slub_sample_start,
+	.next = slub_sample_next,
+	.stop = slub_sample_stop,
+	.show = slub_sample_show,
+};
+
+static int slub_sample_sites_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &slub_sample_op);
+}
+
+/* Any write clears the table */
+static ssize_t slub_sample_sites_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&slub_sample_lock, flags);
+	memset(slub_sample_sites, 0, sizeof(slub_sample_sites));
+	slub_sample_dropped = 0;
+	spin_unlock_irqrestore(&slub_sample_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations slub_sample_sites_fops = {
+	.open		= slub_sample_sites_open,
+	.read		= seq_read,
+	.write		= slub_sample_sites_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init slub_sample_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("slub_sample", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_u32("interval", S_IRUGO | S_IWUSR, dir,
+			   &slub_sample_interval);
+	debugfs_create_u32("dropped", S_IRUGO, dir, &slub_sample_dropped);
+	debugfs_create_file("sites", S_IRUGO | S_IWUSR, dir, NULL,
+			    &slub_sample_sites_fops);
+	return 0;
+}
+late_initcall(slub_sample_debugfs_init);
+#endif /* CONFIG_SLUB_ALLOC_SAMPLING */
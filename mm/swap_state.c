@@ -50,6 +50,23 @@ struct address_space swapper_space = {
 
 #define INC_CACHE_INFO(x)	do { swap_cache_info.x++; } while (0)
 
+/*
+ * Swapin readahead state, kept in each vma and globally for callers
+ * without one: the number of read-ahead pages that were later found by
+ * a fault (hits) and the window used last, as order + 1 so that a
+ * fresh vma (0) starts out with the full page_cluster window.
+ */
+#define SWAP_RA_HITS_MASK	0xffff
+#define SWAP_RA_ORDER_SHIFT	16
+
+static atomic_t swap_readahead_info;
+static unsigned long swap_ra_prev_offset;
+
+static inline atomic_t *swap_ra_info(struct vm_area_struct *vma)
+{
+	return vma ? &vma->swap_readahead_info : &swap_readahead_info;
+}
+
 static struct {
 	unsigned long add_total;
 	unsigned long del_total;
@@ -257,14 +274,19 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page * lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			atomic_inc(swap_ra_info(vma));
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -349,6 +371,50 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Pick the readahead window for a swapin fault from how well the last
+ * one did: grow it to cover the hits seen since (rounded up to a power
+ * of two, plus a little), shrink it by at most half at a time, and with
+ * no hits at all only read around when the fault is next to the last
+ * one.  Swap on flash has no seek cost to amortise, so a window that
+ * isn't being used is just memory taken from the foreground app.
+ */
+static int swapin_ra_order(swp_entry_t entry, struct vm_area_struct *vma)
+{
+	atomic_t *info = swap_ra_info(vma);
+	unsigned long offset = swp_offset(entry);
+	int old, hits, last, order;
+
+	if (!page_cluster)
+		return 0;
+
+	old = atomic_xchg(info, 0);
+	hits = old & SWAP_RA_HITS_MASK;
+	last = old >> SWAP_RA_ORDER_SHIFT;
+
+	if (!last) {
+		order = page_cluster;
+	} else {
+		last--;
+		if (hits) {
+			order = fls(hits + 1);
+		} else {
+			order = 0;
+			if (offset == swap_ra_prev_offset + 1 ||
+			    offset == swap_ra_prev_offset - 1)
+				order = 1;
+		}
+		if (order < last - 1)
+			order = last - 1;
+	}
+	if (order > page_cluster)
+		order = page_cluster;
+
+	swap_ra_prev_offset = offset;
+	atomic_add((order + 1) << SWAP_RA_ORDER_SHIFT, info);
+	return order;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -359,9 +425,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * up to (1 << page_cluster) entries in the swap area, sized by
+ * swapin_ra_order(). This method is chosen because it doesn't cost us
+ * any seek time.  We also make sure to queue the 'original' request
+ * together with the readahead ones...
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -383,13 +450,18 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 * more likely that neighbouring swap pages came from the same node:
 	 * so use the same "addr" to choose the same node for each swap read.
 	 */
-	nr_pages = valid_swaphandles(entry, &offset);
+	nr_pages = valid_swaphandles(entry, &offset,
+				     swapin_ra_order(entry, vma));
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
 		/* Ok, do the async read-ahead now */
 		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
 						gfp_mask, vma, addr);
 		if (!page)
 			break;
+		if (offset != swp_offset(entry)) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
@@ -2233,11 +2233,12 @@ int swapcache_prepare(swp_entry_t entry)
 /*
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
+ * @order selects the aligned block of 1 << order slots to look at.
  */
-int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
+int valid_swaphandles(swp_entry_t entry, unsigned long *offset, int order)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
+	int our_page_cluster = order;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
@@ -26,6 +26,7 @@
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
+#include <linux/sort.h>
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
@@ -497,18 +498,45 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
  * a less aggressive log scale. It will still be an improvement over the old
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
+ *
+ * Lazily freed areas still occupy address space, so they are never allowed
+ * to hold more than an eighth of it.  Each time an allocation only fits
+ * after a forced purge the limit is halved (lazy_max_shift), and it grows
+ * back by one step on every purge that the limit itself triggers.
  */
+#define LAZY_MAX_SHIFT_MAX	4
+
+static unsigned int lazy_max_shift;
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
+	unsigned long pages;
 
 	log = fls(num_online_cpus());
 
-	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
+	pages = log * (32UL * 1024 * 1024 / PAGE_SIZE);
+	pages = min(pages, (VMALLOC_END - VMALLOC_START) >> (PAGE_SHIFT + 3));
+
+	return pages >> lazy_max_shift;
 }
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
 
+/* statistics for /proc/vmallocstat */
+static unsigned long nr_vmap_purges;
+static unsigned long nr_vmap_purged_pages;
+static unsigned long nr_vmap_full_flushes;
+static unsigned long nr_vmap_alloc_purges;
+
+/*
+ * Past this many pages, flushing the kernel range one entry at a time
+ * costs far more than refilling the whole TLB.  Purged ranges span from
+ * the lowest to the highest lazy area and easily reach the full size of
+ * the vmalloc space.
+ */
+#define VMAP_FLUSH_ALL_PAGES	256
+
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
@@ -561,11 +589,19 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	}
 	rcu_read_unlock();
 
-	if (nr)
+	if (nr) {
 		atomic_sub(nr, &vmap_lazy_nr);
+		nr_vmap_purges++;
+		nr_vmap_purged_pages += nr;
+	}
 
-	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+	if (nr || force_flush) {
+		if ((*end - *start) >> PAGE_SHIFT > VMAP_FLUSH_ALL_PAGES) {
+			flush_tlb_all();
+			nr_vmap_full_flushes++;
+		} else
+			flush_tlb_kernel_range(*start, *end);
+	}
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
@@ -584,16 +620,22 @@ static void try_purge_vmap_area_lazy(void)
 {
 	unsigned long start = ULONG_MAX, end = 0;
 
+	if (lazy_max_shift)
+		lazy_max_shift--;
 	__purge_vmap_area_lazy(&start, &end, 0, 0);
 }
 
 /*
- * Kick off a purge of the outstanding lazy areas.
+ * Kick off a purge of the outstanding lazy areas.  Only called when an
+ * allocation found no room, so also purge earlier from now on.
  */
 static void purge_vmap_area_lazy(void)
 {
 	unsigned long start = ULONG_MAX, end = 0;
 
+	if (lazy_max_shift < LAZY_MAX_SHIFT_MAX)
+		lazy_max_shift++;
+	nr_vmap_alloc_purges++;
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
 }
 
@@ -2455,9 +2497,123 @@ static const struct file_operations proc_vmalloc_operations = {
 	.release	= seq_release_private,
 };
 
+/*
+ * vmallocstat: the state of the vmalloc space and who is using it, with
+ * the areas of /proc/vmallocinfo summed up per caller.
+ */
+#define VMALLOCSTAT_CALLERS	64
+
+struct vmalloc_caller {
+	const void	*caller;
+	unsigned long	size;
+	unsigned int	count;
+};
+
+static int vmalloc_caller_cmp(const void *a, const void *b)
+{
+	const struct vmalloc_caller *ca = a, *cb = b;
+
+	if (ca->size != cb->size)
+		return ca->size > cb->size ? -1 : 1;
+	return 0;
+}
+
+static int vmallocstat_show(struct seq_file *m, void *p)
+{
+	struct vmalloc_caller *callers, other = { .caller = NULL };
+	unsigned long used = 0, lazy = 0, largest = 0;
+	unsigned long prev_end = VMALLOC_START;
+	char buff[KSYM_SYMBOL_LEN];
+	struct vmap_area *va;
+	struct vm_struct *v;
+	int nr = 0, i;
+
+	callers = kcalloc(VMALLOCSTAT_CALLERS, sizeof(*callers), GFP_KERNEL);
+	if (!callers)
+		return -ENOMEM;
+
+	spin_lock(&vmap_area_lock);
+	list_for_each_entry(va, &vmap_area_list, list) {
+		if (va->va_end <= VMALLOC_START || va->va_start >= VMALLOC_END)
+			continue;
+		if (va->flags & (VM_LAZY_FREE | VM_LAZY_FREEING))
+			lazy += va->va_end - va->va_start;
+		else
+			used += va->va_end - va->va_start;
+		if (va->va_start > prev_end)
+			largest = max(largest, va->va_start - prev_end);
+		prev_end = max(prev_end, va->va_end);
+	}
+	spin_unlock(&vmap_area_lock);
+	if (VMALLOC_END > prev_end)
+		largest = max(largest, VMALLOC_END - prev_end);
+
+	read_lock(&vmlist_lock);
+	for (v = vmlist; v; v = v->next) {
+		for (i = 0; i < nr; i++)
+			if (callers[i].caller == v->caller)
+				break;
+		if (i == nr) {
+			if (nr == VMALLOCSTAT_CALLERS) {
+				other.size += v->size;
+				other.count++;
+				continue;
+			}
+			callers[nr++].caller = v->caller;
+		}
+		callers[i].size += v->size;
+		callers[i].count++;
+	}
+	read_unlock(&vmlist_lock);
+
+	sort(callers, nr, sizeof(*callers), vmalloc_caller_cmp, NULL);
+
+	seq_printf(m, "total:        %8lu kB\n"
+		      "used:         %8lu kB\n"
+		      "largest_free: %8lu kB\n"
+		      "lazy:         %8lu kB\n"
+		      "lazy_max:     %8lu kB\n"
+		      "purges:       %8lu\n"
+		      "purged:       %8lu kB\n"
+		      "full_flushes: %8lu\n"
+		      "alloc_purges: %8lu\n\n",
+		   (VMALLOC_END - VMALLOC_START) >> 10, used >> 10,
+		   largest >> 10, lazy >> 10,
+		   lazy_max_pages() << (PAGE_SHIFT - 10),
+		   nr_vmap_purges, nr_vmap_purged_pages << (PAGE_SHIFT - 10),
+		   nr_vmap_full_flushes, nr_vmap_alloc_purges);
+
+	for (i = 0; i < nr; i++) {
+		if (callers[i].caller)
+			sprint_symbol(buff, (unsigned long)callers[i].caller);
+		else
+			strcpy(buff, "unknown");
+		seq_printf(m, "%10lu %5u %s\n",
+			   callers[i].size, callers[i].count, buff);
+	}
+	if (other.count)
+		seq_printf(m, "%10lu %5u other\n", other.size, other.count);
+
+	kfree(callers);
+	return 0;
+}
+
+static int vmallocstat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vmallocstat_show, NULL);
+}
+
+static const struct file_operations proc_vmallocstat_operations = {
+	.open		= vmallocstat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init proc_vmalloc_init(void)
 {
 	proc_create("vmallocinfo", S_IRUSR, NULL, &proc_vmalloc_operations);
+	proc_create("vmallocstat", S_IRUSR, NULL, &proc_vmallocstat_operations);
 	return 0;
 }
 module_init(proc_vmalloc_init);
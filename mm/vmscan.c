@@ -632,6 +632,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 	cond_resched();
 
 	pagevec_init(&freed_pvec, 1);
+	/* Pages of one isolated batch are mostly of one memcg, too */
+	mem_cgroup_uncharge_start();
 	while (!list_empty(page_list)) {
 		enum page_references references;
 		struct address_space *mapping;
@@ -832,6 +834,7 @@ keep:
 		list_add(&page->lru, &ret_pages);
 		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
 	}
+	mem_cgroup_uncharge_end();
 	list_splice(&ret_pages, page_list);
 	if (pagevec_count(&freed_pvec))
 		__pagevec_free(&freed_pvec);
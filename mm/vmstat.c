@@ -773,9 +773,25 @@ static const char * const vmstat_text[] = {
 	"kswapd_skip_congestion_wait",
 	"pageoutrun",
 	"allocstall",
+	"allocstall_us",
 
 	"pgrotated",
 
+	"splice_pgmoved",
+	"splice_pgcopied",
+
+	"zone_lock_alloc",
+	"zone_lock_free",
+	"fork_mm",
+	"fork_mm_us",
+	"fork_pte_copy",
+	"fork_pte_skip",
+
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -85,10 +85,15 @@ static void sock_pipe_buf_get(struct pipe_inode_info *pipe,
 	get_page(buf->page);
 }
 
+/*
+ * Frag pages are only ours once the skb they were spliced from is gone,
+ * which leaves the pipe holding the last reference. Pages that linear data
+ * was copied into stay shared with the socket and never qualify.
+ */
 static int sock_pipe_buf_steal(struct pipe_inode_info *pipe,
 			       struct pipe_buffer *buf)
 {
-	return 1;
+	return generic_pipe_buf_steal(pipe, buf);
 }
 
 
@@ -154,6 +154,16 @@ static unsigned int ipv4_conntrack_local(unsigned int hooknum,
 	if (skb->len < sizeof(struct iphdr) ||
 	    ip_hdrlen(skb) < sizeof(struct iphdr))
 		return NF_ACCEPT;
+
+	/* 127/8 to 127/8 never leaves the box and there is nothing to NAT,
+	 * so by default don't pay for a lookup and an entry per flow.
+	 * The loopback receive side finds the skb already marked. */
+	if (!nf_conntrack_loopback && !skb->nfct &&
+	    ipv4_is_loopback(ip_hdr(skb)->saddr) &&
+	    ipv4_is_loopback(ip_hdr(skb)->daddr)) {
+		nf_ct_set_untracked(skb);
+		return NF_ACCEPT;
+	}
 	return nf_conntrack_in(dev_net(out), PF_INET, hooknum, skb);
 }
 
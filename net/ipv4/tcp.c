@@ -2483,6 +2483,10 @@ void tcp_get_info(struct sock *sk, struct tcp_info *info)
 	info->tcpi_rcv_space = tp->rcvq_space.space;
 
 	info->tcpi_total_retrans = tp->total_retrans;
+
+	info->tcpi_rcv_buf = sk->sk_rcvbuf;
+	info->tcpi_rcv_budget = tp->rcvq_space.charged;
+	info->tcpi_rcv_budget_clamps = tp->rcvq_space.clamped;
 }
 
 EXPORT_SYMBOL_GPL(tcp_get_info);
@@ -93,6 +93,7 @@ int sysctl_tcp_nometrics_save __read_mostly;
 int sysctl_tcp_thin_dupack __read_mostly;
 
 int sysctl_tcp_moderate_rcvbuf __read_mostly = 1;
+int sysctl_tcp_rmem_budget __read_mostly;
 int sysctl_tcp_abc __read_mostly;
 
 #define FLAG_DATA		0x01 /* Incoming frame contained data.		*/
@@ -491,6 +492,43 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
  * This function should be called every time data is copied to user space.
  * It calculates the appropriate TCP receive buffer space.
  */
+/* Receive buffer growth handed out by autotuning, all sockets together */
+static atomic_t tcp_rcvbuf_autotuned = ATOMIC_INIT(0);
+
+/* Let the receive buffer grow to @space bytes, as far as the budget
+ * allows.  Growth is charged to the socket until it is destroyed.  The
+ * check is not atomic with the charge, so concurrent growth can overshoot
+ * the budget by a few segments' worth.
+ */
+static int tcp_rcv_budget_grow(struct sock *sk, int space)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	int grow = space - sk->sk_rcvbuf;
+
+	if (sysctl_tcp_rmem_budget) {
+		int avail = sysctl_tcp_rmem_budget -
+			    atomic_read(&tcp_rcvbuf_autotuned);
+
+		if (grow > avail) {
+			grow = max(avail, 0);
+			tp->rcvq_space.clamped++;
+			NET_INC_STATS(sock_net(sk), LINUX_MIB_TCPRCVBUDGETCLAMP);
+		}
+	}
+
+	atomic_add(grow, &tcp_rcvbuf_autotuned);
+	tp->rcvq_space.charged += grow;
+	return sk->sk_rcvbuf + grow;
+}
+
+void tcp_rcv_budget_release(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	atomic_sub(tp->rcvq_space.charged, &tcp_rcvbuf_autotuned);
+	tp->rcvq_space.charged = 0;
+}
+
 void tcp_rcv_space_adjust(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
@@ -530,11 +568,14 @@ void tcp_rcv_space_adjust(struct sock *sk)
 				rcvmem += 128;
 			space *= rcvmem;
 			space = min(space, sysctl_tcp_rmem[2]);
+			if (space > sk->sk_rcvbuf)
+				space = tcp_rcv_budget_grow(sk, space);
 			if (space > sk->sk_rcvbuf) {
 				sk->sk_rcvbuf = space;
 
 				/* Make the window clamp follow along.  */
-				tp->window_clamp = new_clamp;
+				tp->window_clamp = min(new_clamp,
+						       tcp_win_from_space(space));
 			}
 		}
 	}
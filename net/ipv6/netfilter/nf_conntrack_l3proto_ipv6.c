@@ -283,6 +283,14 @@ static unsigned int ipv6_conntrack_local(unsigned int hooknum,
 			pr_notice("ipv6_conntrack_local: packet too short\n");
 		return NF_ACCEPT;
 	}
+
+	/* ::1 to ::1, see ipv4_conntrack_local() */
+	if (!nf_conntrack_loopback && !skb->nfct &&
+	    ipv6_addr_loopback(&ipv6_hdr(skb)->saddr) &&
+	    ipv6_addr_loopback(&ipv6_hdr(skb)->daddr)) {
+		nf_ct_set_untracked(skb);
+		return NF_ACCEPT;
+	}
 	return __ipv6_conntrack_in(dev_net(out), hooknum, skb, okfn);
 }
 
@@ -59,6 +59,14 @@ EXPORT_SYMBOL_GPL(nf_conntrack_lock);
 unsigned int nf_conntrack_htable_size __read_mostly;
 EXPORT_SYMBOL_GPL(nf_conntrack_htable_size);
 
+/* Track packets that go from a loopback address to a loopback address? */
+#ifdef CONFIG_NF_CONNTRACK_SKIP_LOOPBACK
+int nf_conntrack_loopback __read_mostly;
+#else
+int nf_conntrack_loopback __read_mostly = 1;
+#endif
+EXPORT_SYMBOL_GPL(nf_conntrack_loopback);
+
 unsigned int nf_conntrack_max __read_mostly;
 EXPORT_SYMBOL_GPL(nf_conntrack_max);
 
@@ -1334,6 +1342,13 @@ static int nf_conntrack_init_init_net(void)
 			   / sizeof(struct hlist_head));
 		if (totalram_pages > (1024 * 1024 * 1024 / PAGE_SIZE))
 			nf_conntrack_htable_size = 16384;
+#ifdef CONFIG_NF_CONNTRACK_SMALL_TABLE
+		/* A handset tracks tens of connections, a few hundred
+		 * when tethering, not the thousands the RAM based size
+		 * allows for. */
+		if (nf_conntrack_htable_size > 1024)
+			nf_conntrack_htable_size = 1024;
+#endif
 		if (nf_conntrack_htable_size < 32)
 			nf_conntrack_htable_size = 32;
 
@@ -0,0 +1,723 @@
+/*
+ * $(CROSS_COMPILE)cc -Wall -O2 -I../../drivers/staging/android \
+ *	-o binderbench binderbench.c -lpthread
+ */
+
+/*
+ * binderbench - binder transaction throughput and latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * A server process exports one binder object and answers every call on
+ * a pool of looper threads.  The client process calls it from a number
+ * of threads, with a configurable payload, one-way or synchronously and
+ * optionally passing a file descriptor in each call, and times every
+ * ioctl with CLOCK_MONOTONIC.
+ *
+ * The server becomes the context manager if it can.  On a running
+ * Android system servicemanager already is, so the object is published
+ * there as "binderbench" instead, which needs root.
+ *
+ * The result is a single "key=value" line.  With -l the driver's
+ * transaction log is printed afterwards; its entries carry
+ * CLOCK_MONOTONIC timestamps, so the last calls of a run can be lined
+ * up with the client's own samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+
+/*-------------------------------------------------------------------------*/
+
+#define BINDER_DEV		"/dev/binder"
+#define BINDER_MAP_SIZE		(1024 * 1024)
+#define TRANSACTION_LOG		"/sys/kernel/debug/binder/transaction_log"
+
+#define SERVICE_NAME		"binderbench"
+#define SVCMGR_ID		"android.os.IServiceManager"
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+
+/* calls the benchmark object answers */
+#define BENCH_GET_OBJECT	1	/* to the context manager only */
+#define BENCH_CALL		2
+
+#define MAX_PAYLOAD		(64 * 1024)
+#define MAX_THREADS		64
+
+static unsigned	payload = 128;
+static unsigned	threads = 1;
+static unsigned	server_threads = 2;
+static unsigned	iterations = 10000;
+static int	oneway;
+static int	pass_fd;
+static int	show_log;
+static int	verbose;
+
+struct binder {
+	int	fd;
+	void	*map;
+};
+
+/*-------------------------------------------------------------------------*/
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int binder_open(struct binder *b)
+{
+	struct binder_version vers;
+
+	b->fd = open(BINDER_DEV, O_RDWR);
+	if (b->fd < 0) {
+		perror(BINDER_DEV);
+		return -1;
+	}
+	if (ioctl(b->fd, BINDER_VERSION, &vers) < 0 ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder protocol version mismatch\n");
+		return -1;
+	}
+	b->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0);
+	if (b->map == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	return 0;
+}
+
+static int binder_write(struct binder *b, void *data, size_t len)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = len;
+	bwr.write_buffer = (unsigned long)data;
+	while (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0) {
+		if (errno != EINTR) {
+			perror("BINDER_WRITE_READ");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void binder_free_buffer(struct binder *b, const void *buffer)
+{
+	struct {
+		uint32_t	cmd;
+		const void	*buffer;
+	} __attribute__((packed)) free_cmd = { BC_FREE_BUFFER, buffer };
+
+	binder_write(b, &free_cmd, sizeof(free_cmd));
+}
+
+/*
+ * Answer the reference counting the driver asks of a local object so
+ * it doesn't hold references back waiting for us.
+ */
+static void binder_ack_ref(struct binder *b, uint32_t cmd, void *ptr)
+{
+	struct {
+		uint32_t			cmd;
+		struct binder_ptr_cookie	pc;
+	} __attribute__((packed)) ack;
+
+	ack.cmd = cmd == BR_INCREFS ? BC_INCREFS_DONE : BC_ACQUIRE_DONE;
+	memcpy(&ack.pc, ptr, sizeof(ack.pc));
+	binder_write(b, &ack, sizeof(ack));
+}
+
+/*
+ * Read until one of the BR_* codes in @want arrives, handling the ones
+ * that aren't for us on the way.  Returns that code, with its
+ * transaction in @tr, or -1.
+ */
+static int binder_wait(struct binder *b, const uint32_t *want, int nwant,
+		       struct binder_transaction_data *tr)
+{
+	uint32_t buf[128];
+	struct binder_write_read bwr;
+	char *p, *end;
+	uint32_t cmd;
+	int i;
+
+	for (;;) {
+		memset(&bwr, 0, sizeof(bwr));
+		bwr.read_size = sizeof(buf);
+		bwr.read_buffer = (unsigned long)buf;
+		if (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("BINDER_WRITE_READ");
+			return -1;
+		}
+
+		p = (char *)buf;
+		end = p + bwr.read_consumed;
+		while (p < end) {
+			memcpy(&cmd, p, sizeof(cmd));
+			p += sizeof(cmd);
+
+			for (i = 0; i < nwant; i++)
+				if (cmd == want[i])
+					break;
+			if (i < nwant) {
+				if (tr && _IOC_SIZE(cmd) == sizeof(*tr))
+					memcpy(tr, p, sizeof(*tr));
+				/*
+				 * Anything queued behind it is a BR_NOOP or
+				 * another completion we don't need.
+				 */
+				return cmd;
+			}
+
+			switch (cmd) {
+			case BR_NOOP:
+			case BR_SPAWN_LOOPER:
+			case BR_TRANSACTION_COMPLETE:
+			case BR_RELEASE:
+			case BR_DECREFS:
+				break;
+			case BR_INCREFS:
+			case BR_ACQUIRE:
+				binder_ack_ref(b, cmd, p);
+				break;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+				return cmd;
+			default:
+				fprintf(stderr, "unexpected binder command "
+					"0x%08x\n", cmd);
+				return -1;
+			}
+			p += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+/*
+ * Send one transaction.  With @has_obj, @data starts with a flat
+ * binder object.
+ */
+static int binder_call(struct binder *b, uint32_t cmd, size_t handle,
+		       uint32_t code, uint32_t flags, void *data, size_t len,
+		       int has_obj)
+{
+	static const size_t offsets[1] = { 0 };
+	struct {
+		uint32_t			cmd;
+		struct binder_transaction_data	tr;
+	} __attribute__((packed)) call;
+
+	memset(&call, 0, sizeof(call));
+	call.cmd = cmd;
+	call.tr.target.handle = handle;
+	call.tr.code = code;
+	call.tr.flags = flags;
+	call.tr.data_size = len;
+	call.tr.data.ptr.buffer = data;
+	if (has_obj) {
+		call.tr.offsets_size = sizeof(offsets);
+		call.tr.data.ptr.offsets = offsets;
+	}
+	return binder_write(b, &call, sizeof(call));
+}
+
+/* A sync call, returning the reply to be freed by the caller */
+static int binder_transact(struct binder *b, size_t handle, uint32_t code,
+			   void *data, size_t len, int has_obj,
+			   struct binder_transaction_data *reply)
+{
+	static const uint32_t want[] = { BR_REPLY };
+
+	if (binder_call(b, BC_TRANSACTION, handle, code, TF_ACCEPT_FDS,
+			data, len, has_obj))
+		return -1;
+	return binder_wait(b, want, 1, reply) == BR_REPLY ? 0 : -1;
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* Parcel helpers, just enough to talk to servicemanager */
+
+struct parcel {
+	char	data[256];
+	size_t	len;
+};
+
+static void parcel_u32(struct parcel *p, uint32_t v)
+{
+	memcpy(p->data + p->len, &v, 4);
+	p->len += 4;
+}
+
+static void parcel_str16(struct parcel *p, const char *s)
+{
+	size_t n = strlen(s), i;
+	uint16_t *d;
+
+	parcel_u32(p, n);
+	d = (uint16_t *)(p->data + p->len);
+	for (i = 0; i <= n; i++)
+		d[i] = s[i];
+	p->len += ((n + 1) * 2 + 3) & ~3;
+}
+
+static void parcel_obj(struct parcel *p, struct flat_binder_object *obj)
+{
+	memcpy(p->data + p->len, obj, sizeof(*obj));
+	p->len += sizeof(*obj);
+}
+
+/*-------------------------------------------------------------------------*/
+
+static struct binder server;
+static struct flat_binder_object bench_obj = {
+	.type	= BINDER_TYPE_BINDER,
+	.flags	= 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS,
+	.binder	= &bench_obj,
+	.cookie	= &bench_obj,
+};
+
+static void server_reply(struct binder_transaction_data *tr)
+{
+	static const size_t offsets[1] = { 0 };
+	struct {
+		uint32_t			free_cmd;
+		const void			*buffer;
+		uint32_t			reply_cmd;
+		struct binder_transaction_data	tr;
+	} __attribute__((packed)) cmds;
+	struct flat_binder_object obj = bench_obj;
+	uint32_t status = 0;
+
+	memset(&cmds, 0, sizeof(cmds));
+	cmds.free_cmd = BC_FREE_BUFFER;
+	cmds.buffer = tr->data.ptr.buffer;
+	cmds.reply_cmd = BC_REPLY;
+	if (tr->code == BENCH_GET_OBJECT) {
+		cmds.tr.data_size = sizeof(obj);
+		cmds.tr.data.ptr.buffer = &obj;
+		cmds.tr.offsets_size = sizeof(offsets);
+		cmds.tr.data.ptr.offsets = offsets;
+	} else {
+		cmds.tr.data_size = sizeof(status);
+		cmds.tr.data.ptr.buffer = &status;
+	}
+	binder_write(&server, &cmds, sizeof(cmds));
+}
+
+static void *server_loop(void *unused)
+{
+	static const uint32_t want[] = { BR_TRANSACTION };
+	struct binder_transaction_data tr;
+	struct flat_binder_object obj;
+	uint32_t cmd = BC_ENTER_LOOPER;
+
+	binder_write(&server, &cmd, sizeof(cmd));
+	for (;;) {
+		if (binder_wait(&server, want, 1, &tr) != BR_TRANSACTION)
+			continue;
+
+		/* the driver installed a descriptor for us, drop it */
+		if (tr.offsets_size) {
+			memcpy(&obj, tr.data.ptr.buffer, sizeof(obj));
+			if (obj.type == BINDER_TYPE_FD)
+				close(obj.handle);
+		}
+
+		if (tr.flags & TF_ONE_WAY)
+			binder_free_buffer(&server, tr.data.ptr.buffer);
+		else
+			server_reply(&tr);
+	}
+	return NULL;
+}
+
+static int server_publish(void)
+{
+	struct binder_transaction_data reply;
+	struct parcel p = { .len = 0 };
+
+	if (ioctl(server.fd, BINDER_SET_CONTEXT_MGR, 0) == 0)
+		return 0;
+
+	parcel_u32(&p, 0);			/* strict mode policy */
+	parcel_str16(&p, SVCMGR_ID);
+	parcel_str16(&p, SERVICE_NAME);
+	parcel_obj(&p, &bench_obj);
+
+	/* the object is the last thing in the parcel */
+	{
+		size_t offsets[1] = { p.len - sizeof(bench_obj) };
+		struct {
+			uint32_t			cmd;
+			struct binder_transaction_data	tr;
+		} __attribute__((packed)) call;
+		static const uint32_t want[] = { BR_REPLY };
+
+		memset(&call, 0, sizeof(call));
+		call.cmd = BC_TRANSACTION;
+		call.tr.target.handle = 0;
+		call.tr.code = SVC_MGR_ADD_SERVICE;
+		call.tr.data_size = p.len;
+		call.tr.data.ptr.buffer = p.data;
+		call.tr.offsets_size = sizeof(offsets);
+		call.tr.data.ptr.offsets = offsets;
+		if (binder_write(&server, &call, sizeof(call)) ||
+		    binder_wait(&server, want, 1, &reply) != BR_REPLY) {
+			fprintf(stderr, "can't add " SERVICE_NAME
+				" to servicemanager\n");
+			return -1;
+		}
+	}
+	binder_free_buffer(&server, reply.data.ptr.buffer);
+	return 1;
+}
+
+/* Returns through @ready: 0 as context manager, 1 in servicemanager */
+static void server_main(int ready)
+{
+	pthread_t thread;
+	char mode;
+	int ret;
+	unsigned i;
+
+	if (binder_open(&server))
+		exit(1);
+	ret = server_publish();
+	if (ret < 0)
+		exit(1);
+	/* one looper in this thread, the rest in new ones */
+	for (i = 1; i < server_threads; i++)
+		pthread_create(&thread, NULL, server_loop, NULL);
+
+	mode = '0' + ret;
+	write(ready, &mode, 1);
+	close(ready);
+
+	server_loop(NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+
+static struct binder client;
+static size_t bench_handle;
+static int null_fd;
+
+struct client_thread {
+	pthread_t	thread;
+	uint32_t	*lat_ns;
+	unsigned	count;
+	unsigned	errors;
+	int		ret;
+};
+
+static int client_lookup(int ctxmgr)
+{
+	struct binder_transaction_data reply;
+	struct flat_binder_object obj;
+	struct parcel p = { .len = 0 };
+	uint32_t code = BENCH_GET_OBJECT;
+
+	if (!ctxmgr) {
+		parcel_u32(&p, 0);
+		parcel_str16(&p, SVCMGR_ID);
+		parcel_str16(&p, SERVICE_NAME);
+		code = SVC_MGR_CHECK_SERVICE;
+	}
+	if (binder_transact(&client, 0, code, p.data, p.len, 0, &reply))
+		return -1;
+
+	if (reply.data_size < sizeof(obj) || !reply.offsets_size) {
+		fprintf(stderr, "no " SERVICE_NAME " object in reply\n");
+		return -1;
+	}
+	memcpy(&obj, (const char *)reply.data.ptr.buffer +
+	       *(const size_t *)reply.data.ptr.offsets, sizeof(obj));
+	/* the reference the driver took for us is kept until exit */
+	bench_handle = obj.handle;
+	binder_free_buffer(&client, reply.data.ptr.buffer);
+
+	return obj.type == BINDER_TYPE_HANDLE ? 0 : -1;
+}
+
+static void *client_loop(void *arg)
+{
+	static const uint32_t want_reply[] = { BR_REPLY };
+	static const uint32_t want_complete[] = { BR_TRANSACTION_COMPLETE };
+	struct client_thread *ct = arg;
+	struct binder_transaction_data reply;
+	struct flat_binder_object *obj;
+	char *data;
+	uint64_t start;
+	unsigned i;
+	int cmd;
+
+	data = calloc(1, payload + sizeof(*obj));
+	if (!data) {
+		ct->ret = -1;
+		return NULL;
+	}
+	obj = (struct flat_binder_object *)data;
+	obj->type = BINDER_TYPE_FD;
+	obj->flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+	obj->handle = null_fd;
+
+	for (i = 0; i < iterations; i++) {
+		start = now_ns();
+		if (binder_call(&client, BC_TRANSACTION, bench_handle,
+				BENCH_CALL, oneway ? TF_ONE_WAY : 0,
+				pass_fd ? data : data + sizeof(*obj),
+				payload + (pass_fd ? sizeof(*obj) : 0),
+				pass_fd)) {
+			ct->ret = -1;
+			break;
+		}
+		if (oneway)
+			cmd = binder_wait(&client, want_complete, 1, NULL);
+		else
+			cmd = binder_wait(&client, want_reply, 1, &reply);
+		if (cmd < 0) {
+			ct->ret = -1;
+			break;
+		}
+		/* one-way calls fail once the server's async space is full */
+		if (cmd == BR_FAILED_REPLY || cmd == BR_DEAD_REPLY) {
+			ct->errors++;
+			if (cmd == BR_DEAD_REPLY)
+				break;
+			sched_yield();
+			continue;
+		}
+		ct->lat_ns[ct->count++] = now_ns() - start;
+		if (!oneway)
+			binder_free_buffer(&client, reply.data.ptr.buffer);
+	}
+
+	free(data);
+	return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(uint32_t *v, unsigned n, unsigned permille)
+{
+	unsigned i;
+
+	if (!n)
+		return 0;
+	i = (uint64_t)n * permille / 1000;
+	if (i >= n)
+		i = n - 1;
+	return v[i] / 1000.0;
+}
+
+static void dump_transaction_log(void)
+{
+	char line[256];
+	FILE *f = fopen(TRANSACTION_LOG, "r");
+
+	if (!f) {
+		perror(TRANSACTION_LOG);
+		return;
+	}
+	while (fgets(line, sizeof(line), f))
+		fputs(line, stdout);
+	fclose(f);
+}
+
+static int client_main(int ctxmgr)
+{
+	struct client_thread ct[MAX_THREADS];
+	uint64_t start, elapsed, total_ns = 0;
+	uint32_t *all;
+	unsigned i, j, n = 0, errors = 0;
+	struct timespec ts;
+	int ret = 0;
+
+	if (binder_open(&client))
+		return 1;
+	null_fd = open("/dev/null", O_RDONLY);
+	if (null_fd < 0) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	/* servicemanager may not have seen the add yet */
+	for (i = 0; client_lookup(ctxmgr); i++) {
+		if (i == 10)
+			return 1;
+		usleep(100000);
+	}
+
+	memset(ct, 0, sizeof(ct));
+	for (i = 0; i < threads; i++) {
+		ct[i].lat_ns = malloc(iterations * sizeof(uint32_t));
+		if (!ct[i].lat_ns) {
+			perror("malloc");
+			return 1;
+		}
+	}
+
+	start = now_ns();
+	for (i = 0; i < threads; i++)
+		pthread_create(&ct[i].thread, NULL, client_loop, &ct[i]);
+	for (i = 0; i < threads; i++)
+		pthread_join(ct[i].thread, NULL);
+	elapsed = now_ns() - start;
+
+	all = malloc((size_t)threads * iterations * sizeof(uint32_t));
+	if (!all) {
+		perror("malloc");
+		return 1;
+	}
+	for (i = 0; i < threads; i++) {
+		for (j = 0; j < ct[i].count; j++) {
+			all[n++] = ct[i].lat_ns[j];
+			total_ns += ct[i].lat_ns[j];
+		}
+		errors += ct[i].errors;
+		if (ct[i].ret)
+			ret = 1;
+	}
+	qsort(all, n, sizeof(all[0]), cmp_u32);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	printf("binderbench: size=%u threads=%u server_threads=%u oneway=%d "
+	       "fd=%d count=%u errors=%u time=%.3f tps=%.0f "
+	       "avg_us=%.1f p50_us=%.1f p99_us=%.1f p999_us=%.1f "
+	       "max_us=%.1f end=%ld.%06ld\n",
+	       payload, threads, server_threads, oneway, pass_fd, n, errors,
+	       elapsed / 1e9, elapsed ? n * 1e9 / elapsed : 0,
+	       n ? total_ns / 1000.0 / n : 0,
+	       percentile_us(all, n, 500), percentile_us(all, n, 990),
+	       percentile_us(all, n, 999), n ? all[n - 1] / 1000.0 : 0,
+	       (long)ts.tv_sec, ts.tv_nsec / 1000);
+
+	if (verbose)
+		for (i = 0; i < n; i++)
+			printf("%u\n", all[i]);
+	if (show_log)
+		dump_transaction_log();
+
+	return ret;
+}
+
+/*-------------------------------------------------------------------------*/
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-s size] [-t threads] [-w server threads] "
+		"[-n iterations] [-o] [-f] [-l] [-v]\n"
+		"\t-s payload bytes per call (default %u, max %u)\n"
+		"\t-t client threads (default %u, max %u)\n"
+		"\t-w server looper threads (default %u)\n"
+		"\t-n calls per client thread (default %u)\n"
+		"\t-o one-way calls\n"
+		"\t-f pass a file descriptor in every call\n"
+		"\t-l print the driver's transaction log afterwards\n"
+		"\t-v print every latency sample, in ns\n",
+		name, payload, MAX_PAYLOAD, threads, MAX_THREADS,
+		server_threads, iterations);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c, pipefd[2], status, ret;
+	char mode;
+	pid_t pid;
+
+	while ((c = getopt(argc, argv, "s:t:w:n:oflv")) != -1) {
+		switch (c) {
+		case 's':
+			payload = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			server_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			oneway = 1;
+			break;
+		case 'f':
+			pass_fd = 1;
+			break;
+		case 'l':
+			show_log = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (payload > MAX_PAYLOAD || !threads || threads > MAX_THREADS ||
+	    !server_threads || !iterations)
+		usage(argv[0]);
+
+	if (pipe(pipefd) < 0) {
+		perror("pipe");
+		return 1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid) {
+		close(pipefd[0]);
+		server_main(pipefd[1]);
+		exit(0);
+	}
+
+	close(pipefd[1]);
+	if (read(pipefd[0], &mode, 1) != 1) {
+		fprintf(stderr, "server failed to start\n");
+		waitpid(pid, &status, 0);
+		return 1;
+	}
+
+	ret = client_main(mode == '0');
+
+	kill(pid, SIGTERM);
+	waitpid(pid, &status, 0);
+	return ret;
+}
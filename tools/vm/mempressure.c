@@ -0,0 +1,709 @@
+/*
+ * $(CROSS_COMPILE)cc -Wall -O2 -o mempressure mempressure.c
+ */
+
+/*
+ * mempressure - record and replay memory pressure for lowmemorykiller
+ * and vmscan tuning
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * "mempressure -r [-d seconds] [-i ms] > trace" samples every process in
+ * /proc and writes a trace of how each one's resident set, file reads
+ * and oom_adj change:
+ *
+ *	<ms> spawn <id> <oom_adj> <comm>
+ *	<ms> alloc <id> <kB>
+ *	<ms> free <id> <kB>
+ *	<ms> read <id> <kB>
+ *	<ms> adj <id> <oom_adj>
+ *	<ms> exit <id>
+ *
+ * "mempressure [options] trace" replays it: every id becomes a child
+ * process that maps and touches, unmaps, or reads a file as the trace
+ * says, with its oom_adj set to match, so lowmemorykiller and reclaim
+ * see the same profile on every run.  Options:
+ *
+ *	-f file		file the read events read, circularly
+ *	-c cgroup	run in this cgroup (a directory with a "tasks" file)
+ *	-t percent	replay speed, 200 runs twice as fast
+ *	-m percent	scale every allocation and read
+ *
+ * Each kill of a replayed process is logged as it happens.  At the end
+ * one "key=value" line reports the time to the first kill, the number
+ * of kills, kswapd CPU time, direct reclaim stalls and how long they
+ * took (allocstall_us), and the major fault and page-in counts, which
+ * stand in for page cache refaults, along with the lowmemorykiller
+ * settings of the run.  Runs under candidate settings can then be
+ * compared offline.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+#include <ctype.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/*-------------------------------------------------------------------------*/
+
+#define MAX_PROCS	512
+#define CHUNK_KB	256
+#define LMK_PARAMS	"/sys/module/lowmemorykiller/parameters/"
+
+static unsigned	interval_ms = 100;
+static unsigned	duration_s = 60;
+static unsigned	speed = 100;
+static unsigned	mem_scale = 100;
+static const char *read_file;
+
+static long page_kb;
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(unsigned ms)
+{
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+static int read_str(const char *path, char *buf, size_t len)
+{
+	int fd, n;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+	buf[n] = 0;
+	return n;
+}
+
+static long read_long(const char *path, long def)
+{
+	char buf[64];
+
+	if (read_str(path, buf, sizeof(buf)) < 0)
+		return def;
+	return strtol(buf, NULL, 0);
+}
+
+static int write_str(const char *path, const char *s)
+{
+	int fd, ret;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, s, strlen(s)) < 0 ? -1 : 0;
+	close(fd);
+	return ret;
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* Recording */
+
+struct proc_sample {
+	int		pid;
+	int		adj;
+	long		rss_kb;
+	long		read_kb;
+	int		seen;
+};
+
+static struct proc_sample samples[MAX_PROCS];
+
+static struct proc_sample *sample_find(int pid, int create)
+{
+	int i, free_slot = -1;
+
+	for (i = 0; i < MAX_PROCS; i++) {
+		if (samples[i].pid == pid)
+			return &samples[i];
+		if (!samples[i].pid && free_slot < 0)
+			free_slot = i;
+	}
+	if (!create || free_slot < 0)
+		return NULL;
+	memset(&samples[free_slot], 0, sizeof(samples[0]));
+	samples[free_slot].pid = pid;
+	return &samples[free_slot];
+}
+
+/* Anonymous memory, near enough: resident less shared */
+static long proc_rss_kb(int pid)
+{
+	char path[64], buf[128];
+	long size, resident, shared;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+	if (read_str(path, buf, sizeof(buf)) < 0 ||
+	    sscanf(buf, "%ld %ld %ld", &size, &resident, &shared) != 3)
+		return -1;
+	return (resident - shared) * page_kb;
+}
+
+static long proc_read_kb(int pid)
+{
+	char path[64], buf[512], *p;
+
+	snprintf(path, sizeof(path), "/proc/%d/io", pid);
+	if (read_str(path, buf, sizeof(buf)) < 0)
+		return 0;
+	p = strstr(buf, "read_bytes:");
+	if (!p)
+		return 0;
+	return strtoll(p + 11, NULL, 10) / 1024;
+}
+
+static void proc_comm(int pid, char *comm, size_t len)
+{
+	char path[64];
+	int n;
+
+	snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+	n = read_str(path, comm, len);
+	if (n <= 0) {
+		snprintf(comm, len, "?");
+		return;
+	}
+	if (comm[n - 1] == '\n')
+		comm[n - 1] = 0;
+	for (; *comm; comm++)
+		if (isspace(*comm))
+			*comm = '_';
+}
+
+static void record_sample(unsigned long long t)
+{
+	struct proc_sample *s;
+	struct dirent *de;
+	char path[64], comm[32];
+	long rss, rd;
+	int i, pid, adj;
+	DIR *d;
+
+	for (i = 0; i < MAX_PROCS; i++)
+		samples[i].seen = 0;
+
+	d = opendir("/proc");
+	if (!d)
+		return;
+	while ((de = readdir(d))) {
+		pid = atoi(de->d_name);
+		if (pid <= 0)
+			continue;
+		rss = proc_rss_kb(pid);
+		/* kernel threads have nothing to replay */
+		if (rss <= 0)
+			continue;
+		snprintf(path, sizeof(path), "/proc/%d/oom_adj", pid);
+		adj = read_long(path, 0);
+		rd = proc_read_kb(pid);
+
+		s = sample_find(pid, 0);
+		if (!s) {
+			s = sample_find(pid, 1);
+			if (!s)
+				continue;
+			proc_comm(pid, comm, sizeof(comm));
+			printf("%llu spawn %d %d %s\n", t, pid, adj, comm);
+			s->adj = adj;
+			s->read_kb = rd;
+		}
+		s->seen = 1;
+
+		if (adj != s->adj)
+			printf("%llu adj %d %d\n", t, pid, adj);
+		if (rss > s->rss_kb)
+			printf("%llu alloc %d %ld\n", t, pid, rss - s->rss_kb);
+		else if (rss < s->rss_kb)
+			printf("%llu free %d %ld\n", t, pid, s->rss_kb - rss);
+		if (rd > s->read_kb)
+			printf("%llu read %d %ld\n", t, pid, rd - s->read_kb);
+
+		s->adj = adj;
+		s->rss_kb = rss;
+		s->read_kb = rd;
+	}
+	closedir(d);
+
+	for (i = 0; i < MAX_PROCS; i++) {
+		if (samples[i].pid && !samples[i].seen) {
+			printf("%llu exit %d\n", t, samples[i].pid);
+			samples[i].pid = 0;
+		}
+	}
+	fflush(stdout);
+}
+
+static int record(void)
+{
+	unsigned long long start = now_ms(), t;
+
+	do {
+		t = now_ms() - start;
+		record_sample(t);
+		sleep_ms(interval_ms);
+	} while (t < duration_s * 1000ULL);
+
+	return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* Replay: one child per traced process, driven over a pipe */
+
+enum { CMD_ALLOC, CMD_FREE, CMD_READ };
+
+struct cmd {
+	int	op;
+	long	kb;
+};
+
+struct replay_proc {
+	int		id;
+	pid_t		pid;
+	int		fd;		/* command pipe */
+	int		adj;
+	long		rss_kb;
+	int		killed;
+};
+
+static struct replay_proc procs[MAX_PROCS];
+static unsigned long long replay_start;
+static unsigned long long first_kill_ms;
+static unsigned kills, dropped;
+
+struct chunk {
+	struct chunk	*next;
+};
+
+static void child_main(int fd)
+{
+	struct chunk *chunks = NULL, *c;
+	long chunk_bytes = CHUNK_KB * 1024L, want = 0, have = 0;
+	char *buf = malloc(CHUNK_KB * 1024);
+	int file = read_file ? open(read_file, O_RDONLY) : -1;
+	struct cmd cmd;
+	long i;
+
+	while (read(fd, &cmd, sizeof(cmd)) == sizeof(cmd)) {
+		switch (cmd.op) {
+		case CMD_ALLOC:
+			want += cmd.kb;
+			break;
+		case CMD_FREE:
+			want -= cmd.kb;
+			if (want < 0)
+				want = 0;
+			break;
+		case CMD_READ:
+			if (file < 0 || !buf)
+				break;
+			for (i = cmd.kb * 1024; i > 0; i -= chunk_bytes) {
+				if (read(file, buf, chunk_bytes) <= 0)
+					lseek(file, 0, SEEK_SET);
+			}
+			break;
+		}
+
+		/* anonymous memory moves in whole chunks, touched */
+		while (have + CHUNK_KB <= want) {
+			c = mmap(NULL, chunk_bytes, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (c == MAP_FAILED)
+				break;
+			for (i = 0; i < chunk_bytes; i += page_kb * 1024)
+				((char *)c)[i] = 1;
+			c->next = chunks;
+			chunks = c;
+			have += CHUNK_KB;
+		}
+		while (have > want && chunks) {
+			c = chunks;
+			chunks = c->next;
+			munmap(c, chunk_bytes);
+			have -= CHUNK_KB;
+		}
+	}
+	exit(0);
+}
+
+static struct replay_proc *replay_find(int id)
+{
+	int i;
+
+	for (i = 0; i < MAX_PROCS; i++)
+		if (procs[i].pid && procs[i].id == id)
+			return &procs[i];
+	return NULL;
+}
+
+static void replay_set_adj(struct replay_proc *p, int adj)
+{
+	char path[64], val[16];
+
+	snprintf(path, sizeof(path), "/proc/%d/oom_adj", p->pid);
+	snprintf(val, sizeof(val), "%d", adj);
+	write_str(path, val);
+	p->adj = adj;
+}
+
+static void replay_spawn(int id, int adj)
+{
+	struct replay_proc *p = NULL;
+	int i, pipefd[2];
+	pid_t pid;
+
+	for (i = 0; i < MAX_PROCS; i++) {
+		if (!procs[i].pid) {
+			p = &procs[i];
+			break;
+		}
+	}
+	if (!p || pipe(pipefd) < 0)
+		return;
+
+	pid = fork();
+	if (pid < 0) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return;
+	}
+	if (!pid) {
+		/* only our own pipe, so the others see EOF when released */
+		close(pipefd[1]);
+		for (i = 0; i < MAX_PROCS; i++)
+			if (procs[i].pid)
+				close(procs[i].fd);
+		child_main(pipefd[0]);
+	}
+	close(pipefd[0]);
+	/* a child stuck in reclaim mustn't stall the replay */
+	fcntl(pipefd[1], F_SETFL, O_NONBLOCK);
+
+	memset(p, 0, sizeof(*p));
+	p->id = id;
+	p->pid = pid;
+	p->fd = pipefd[1];
+	replay_set_adj(p, adj);
+}
+
+static void replay_send(struct replay_proc *p, int op, long kb)
+{
+	struct cmd cmd = { op, kb * mem_scale / 100 };
+
+	if (!cmd.kb)
+		return;
+	if (write(p->fd, &cmd, sizeof(cmd)) != sizeof(cmd)) {
+		dropped++;
+		return;
+	}
+	if (op == CMD_ALLOC)
+		p->rss_kb += cmd.kb;
+	else if (op == CMD_FREE)
+		p->rss_kb = p->rss_kb > cmd.kb ? p->rss_kb - cmd.kb : 0;
+}
+
+static void replay_release(struct replay_proc *p)
+{
+	close(p->fd);
+	if (!p->killed)
+		kill(p->pid, SIGTERM);
+	p->pid = 0;
+}
+
+static void replay_reap(void)
+{
+	unsigned long long t;
+	int i, status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGKILL)
+			continue;
+		t = now_ms() - replay_start;
+		for (i = 0; i < MAX_PROCS; i++) {
+			if (procs[i].pid != pid)
+				continue;
+			if (!kills)
+				first_kill_ms = t;
+			kills++;
+			printf("kill t=%llu id=%d adj=%d rss_kb=%ld\n",
+			       t, procs[i].id, procs[i].adj, procs[i].rss_kb);
+			procs[i].killed = 1;
+			replay_release(&procs[i]);
+			break;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------*/
+
+/* System counters sampled around a replay */
+
+static const char *vmstat_names[] = {
+	"allocstall", "allocstall_us", "pgmajfault", "pgpgin",
+	"pgscan_kswapd_", "pgscan_direct_", "pgsteal_", "pageoutrun",
+	"kswapd_steal",
+};
+#define NR_VMSTAT (sizeof(vmstat_names) / sizeof(vmstat_names[0]))
+
+struct snapshot {
+	unsigned long long	vm[NR_VMSTAT];
+	unsigned long long	kswapd_ticks;
+	long			lmk_kills;
+};
+
+/* Sums the per-zone counters for names ending in '_' */
+static void read_vmstat(unsigned long long *vm)
+{
+	char name[64];
+	unsigned long long val;
+	size_t i, len;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(vm, 0, NR_VMSTAT * sizeof(*vm));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %llu", name, &val) == 2) {
+		for (i = 0; i < NR_VMSTAT; i++) {
+			len = strlen(vmstat_names[i]);
+			if (vmstat_names[i][len - 1] == '_' ?
+			    !strncmp(name, vmstat_names[i], len) :
+			    !strcmp(name, vmstat_names[i]))
+				vm[i] += val;
+		}
+	}
+	fclose(f);
+}
+
+static unsigned long long kswapd_ticks(void)
+{
+	unsigned long long total = 0, utime, stime;
+	char path[300], buf[512], *p;
+	struct dirent *de;
+	DIR *d = opendir("/proc");
+
+	if (!d)
+		return 0;
+	while ((de = readdir(d))) {
+		if (atoi(de->d_name) <= 0)
+			continue;
+		snprintf(path, sizeof(path), "/proc/%s/stat", de->d_name);
+		if (read_str(path, buf, sizeof(buf)) < 0 ||
+		    !strstr(buf, "(kswapd"))
+			continue;
+		/* utime and stime are the 12th and 13th fields after comm */
+		p = strrchr(buf, ')');
+		if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u "
+				"%*u %*u %llu %llu", &utime, &stime) == 2)
+			total += utime + stime;
+	}
+	closedir(d);
+	return total;
+}
+
+static void snapshot(struct snapshot *s)
+{
+	read_vmstat(s->vm);
+	s->kswapd_ticks = kswapd_ticks();
+	s->lmk_kills = read_long(LMK_PARAMS "kill_count", 0);
+}
+
+static void print_lmk_param(const char *name)
+{
+	char path[128], buf[128];
+	int n;
+
+	snprintf(path, sizeof(path), LMK_PARAMS "%s", name);
+	n = read_str(path, buf, sizeof(buf));
+	if (n <= 0)
+		return;
+	if (buf[n - 1] == '\n')
+		buf[n - 1] = 0;
+	printf(" %s=%s", name, buf);
+}
+
+/*-------------------------------------------------------------------------*/
+
+static int replay(const char *trace)
+{
+	struct snapshot before, after;
+	unsigned long long t, due, elapsed;
+	char line[256], op[16];
+	struct replay_proc *p;
+	unsigned events = 0;
+	long clk_tck = sysconf(_SC_CLK_TCK);
+	long arg;
+	int id;
+	size_t i;
+	FILE *f;
+
+	f = fopen(trace, "r");
+	if (!f) {
+		perror(trace);
+		return 1;
+	}
+
+	snapshot(&before);
+	replay_start = now_ms();
+
+	while (fgets(line, sizeof(line), f)) {
+		arg = 0;
+		if (sscanf(line, "%llu %15s %d %ld", &t, op, &id, &arg) < 3)
+			continue;
+
+		due = t * 100 / speed;
+		for (;;) {
+			replay_reap();
+			elapsed = now_ms() - replay_start;
+			if (elapsed >= due)
+				break;
+			sleep_ms(due - elapsed < 10 ? due - elapsed : 10);
+		}
+
+		events++;
+		if (!strcmp(op, "spawn")) {
+			if (!replay_find(id))
+				replay_spawn(id, arg);
+			continue;
+		}
+		p = replay_find(id);
+		if (!p)
+			continue;
+		if (!strcmp(op, "alloc"))
+			replay_send(p, CMD_ALLOC, arg);
+		else if (!strcmp(op, "free"))
+			replay_send(p, CMD_FREE, arg);
+		else if (!strcmp(op, "read"))
+			replay_send(p, CMD_READ, arg);
+		else if (!strcmp(op, "adj"))
+			replay_set_adj(p, arg);
+		else if (!strcmp(op, "exit"))
+			replay_release(p);
+	}
+	fclose(f);
+
+	/* let the last commands and any kills they cause land */
+	sleep_ms(1000);
+	replay_reap();
+	elapsed = now_ms() - replay_start;
+	snapshot(&after);
+
+	for (i = 0; i < MAX_PROCS; i++)
+		if (procs[i].pid)
+			replay_release(&procs[i]);
+	while (wait(NULL) > 0)
+		;
+
+	printf("mempressure: time_ms=%llu events=%u dropped=%u kills=%u "
+	       "first_kill_ms=%lld lmk_kills=%ld kswapd_cpu_ms=%llu",
+	       elapsed, events, dropped, kills,
+	       kills ? (long long)first_kill_ms : -1LL,
+	       after.lmk_kills - before.lmk_kills,
+	       (after.kswapd_ticks - before.kswapd_ticks) * 1000 / clk_tck);
+	for (i = 0; i < NR_VMSTAT; i++) {
+		size_t len = strlen(vmstat_names[i]);
+
+		printf(" %.*s=%llu", (int)(vmstat_names[i][len - 1] == '_' ?
+					  len - 1 : len), vmstat_names[i],
+		       after.vm[i] - before.vm[i]);
+	}
+	print_lmk_param("minfree");
+	print_lmk_param("adj");
+	print_lmk_param("pressure");
+	printf("\n");
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s -r [-d seconds] [-i ms] > trace\n"
+		"       %s [-f file] [-c cgroup] [-t percent] [-m percent] "
+		"trace\n", name, name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *cgroup = NULL;
+	char path[256], pid[16];
+	int c, rec = 0;
+
+	page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+	while ((c = getopt(argc, argv, "rd:i:f:c:t:m:")) != -1) {
+		switch (c) {
+		case 'r':
+			rec = 1;
+			break;
+		case 'd':
+			duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			read_file = optarg;
+			break;
+		case 'c':
+			cgroup = optarg;
+			break;
+		case 't':
+			speed = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			mem_scale = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (rec)
+		return record();
+
+	if (optind != argc - 1 || !speed || !interval_ms)
+		usage(argv[0]);
+
+	if (cgroup) {
+		snprintf(path, sizeof(path), "%s/tasks", cgroup);
+		snprintf(pid, sizeof(pid), "%d", getpid());
+		if (write_str(path, pid)) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	/* the harness itself must outlive what it replays */
+	write_str("/proc/self/oom_adj", "-16");
+	signal(SIGPIPE, SIG_IGN);
+
+	return replay(argv[optind]);
+}